@@ -153,8 +153,7 @@ Button::Button(const SharedBasicContext& context,
                float viewport_aspect_ratio,
                const ButtonsInfo& buttons_info)
     : viewport_aspect_ratio_{viewport_aspect_ratio},
-      button_half_size_ndc_{buttons_info.button_size * kNdcDim / 2.0f},
-      all_buttons_{ExtractDrawButtonRenderInfos(buttons_info)} {
+      button_half_size_ndc_{buttons_info.button_size * kNdcDim / 2.0f} {
   const int num_buttons = buttons_info.button_infos.size();
   buttons_to_render_.reserve(num_buttons);
 
@@ -169,22 +168,14 @@ Button::Button(const SharedBasicContext& context,
       kBackgroundImageWidth, background_image_height,
       common::image::kBwImageChannel, background_image_pixels.data(),
       /*flip_y=*/false};
-  const glm::vec2 background_image_size{background_image.width(),
-                                        background_image.height()};
-
-  // On the all buttons texture, if buttons are too close to each other, when
-  // sampling one button, pixels of another button might be included due to
-  // numeric error. There should be intervals between rendered buttons.
-  constexpr float kButtonDimensionToIntervalRatio = 100.0f;
-  const glm::vec2 interval_candidates =
-      background_image_size / kButtonDimensionToIntervalRatio;
-  const float button_interval = std::max(interval_candidates.x,
-                                         interval_candidates.y);
-  const glm::vec2& button_uv_scale =
-      background_image_size / (background_image_size + button_interval);
-
-  const auto render_infos = CreateMakeButtonRenderInfos(buttons_info);
-  const auto text_pos = CreateMakeButtonTextPos(buttons_info);
+  const auto layout = ButtonMaker::PackButtons(
+      context, num_buttons,
+      VkExtent2D{static_cast<uint32_t>(background_image.width()),
+                 static_cast<uint32_t>(background_image.height())});
+  all_buttons_ = ExtractDrawButtonRenderInfos(buttons_info, layout);
+
+  const auto render_infos = CreateMakeButtonRenderInfos(buttons_info, layout);
+  const auto text_pos = CreateMakeButtonTextPos(buttons_info, layout);
   std::vector<make_button::ButtonInfo> button_infos;
   button_infos.reserve(num_buttons);
   for (int button = 0; button < num_buttons; ++button) {
@@ -192,6 +183,7 @@ Button::Button(const SharedBasicContext& context,
     button_infos.push_back(make_button::ButtonInfo{
         buttons_info.button_infos[button].text,
         {render_infos[index_base], render_infos[index_base + 1]},
+        {text_pos[index_base].base_x, text_pos[index_base + 1].base_x},
         {text_pos[index_base].base_y, text_pos[index_base + 1].base_y},
         {text_pos[index_base].height, text_pos[index_base + 1].height},
     });
@@ -199,109 +191,93 @@ Button::Button(const SharedBasicContext& context,
   auto buttons_image = ButtonMaker::CreateButtonsImage(
       context, buttons_info.font, buttons_info.font_height,
       buttons_info.text_color, background_image,
-      CreateMakeButtonVerticesInfo(num_buttons, button_uv_scale), button_infos);
+      CreateMakeButtonVerticesInfo(layout), layout, button_infos);
 
   button_renderer_ = std::make_unique<ButtonRenderer>(
-      context, num_buttons,
-      CreateDrawButtonVerticesInfo(buttons_info, button_uv_scale),
+      context, num_buttons, CreateDrawButtonVerticesInfo(buttons_info, layout),
       std::move(buttons_image));
 }
 
 std::vector<make_button::RenderInfo> Button::CreateMakeButtonRenderInfos(
-    const ButtonsInfo& buttons_info) const {
+    const ButtonsInfo& buttons_info,
+    const make_button::ButtonsLayout& layout) const {
   const int num_buttons = buttons_info.button_infos.size();
-  const float button_height_ndc =
-      kNdcDim / static_cast<float>(num_buttons * button::kNumStates);
-  float offset_y_ndc = -1.0f + button_height_ndc / 2.0f;
   std::vector<make_button::RenderInfo> render_infos;
   render_infos.reserve(num_buttons * button::kNumStates);
-  for (const auto& info : buttons_info.button_infos) {
+  for (int button = 0; button < num_buttons; ++button) {
     for (int state = 0; state < button::kNumStates; ++state) {
+      const glm::vec2& center_uv =
+          layout.button_centers[button * button::kNumStates + state];
       render_infos.push_back(make_button::RenderInfo{
-          info.colors[state],
-          /*center=*/glm::vec2{0.0f, offset_y_ndc},
+          buttons_info.button_infos[button].colors[state],
+          /*center=*/center_uv * kNdcDim - 1.0f,
       });
-      offset_y_ndc += button_height_ndc;
     }
   }
   return render_infos;
 }
 
 button::VerticesInfo Button::CreateMakeButtonVerticesInfo(
-    int num_buttons, const glm::vec2& button_scale) const {
-  const float button_height_ndc =
-      kNdcDim / static_cast<float>(num_buttons * button::kNumStates);
-  const auto button_size_ndc =
-      glm::vec2{kNdcDim, button_height_ndc} * button_scale;
-
+    const make_button::ButtonsLayout& layout) const {
   button::VerticesInfo vertices_info{};
-  SetVerticesPositions(button_size_ndc, &vertices_info);
+  SetVerticesPositions(/*size_ndc=*/layout.button_size * kNdcDim,
+                       &vertices_info);
   SetVerticesTexCoords(/*center_uv=*/glm::vec2{kUvDim} / 2.0f,
                        /*size_uv=*/glm::vec2{kUvDim}, &vertices_info);
   return vertices_info;
 }
 
 std::vector<Button::TextPos> Button::CreateMakeButtonTextPos(
-    const ButtonsInfo& buttons_info) const {
-  const int num_buttons = buttons_info.button_infos.size();
-  const float button_height =
-      kUvDim / static_cast<float>(num_buttons * button::kNumStates);
+    const ButtonsInfo& buttons_info,
+    const make_button::ButtonsLayout& layout) const {
+  const float button_height = layout.button_size.y;
   const float text_height =
       (buttons_info.top_y - buttons_info.base_y) * button_height;
 
-  float offset_y = 0.0f;
   std::vector<TextPos> text_pos;
-  text_pos.reserve(num_buttons);
-  for (int button = 0; button < num_buttons; ++button) {
-    for (int state = 0; state < button::kNumStates; ++state) {
-      const float base_y = offset_y + buttons_info.base_y * button_height;
-      text_pos.push_back(TextPos{base_y, text_height});
-      offset_y += button_height;
-    }
+  text_pos.reserve(layout.button_centers.size());
+  for (const auto& center : layout.button_centers) {
+    const float offset_y = center.y - button_height / 2.0f;
+    const float base_y = offset_y + buttons_info.base_y * button_height;
+    text_pos.push_back(TextPos{center.x, base_y, text_height});
   }
   return text_pos;
 }
 
 Button::DrawButtonRenderInfos Button::ExtractDrawButtonRenderInfos(
-    const ButtonsInfo& buttons_info) const {
+    const ButtonsInfo& buttons_info,
+    const make_button::ButtonsLayout& layout) const {
   const int num_buttons = buttons_info.button_infos.size();
-  const float button_tex_height =
-      kUvDim / static_cast<float>(num_buttons * button::kNumStates);
-  constexpr float kTexCenterOffsetX = kUvDim / 2.0f;
-  float tex_center_offset_y = button_tex_height / 2.0f;
-
   DrawButtonRenderInfos render_infos;
   render_infos.reserve(num_buttons);
-  for (const auto& info : buttons_info.button_infos) {
+  for (int button = 0; button < num_buttons; ++button) {
+    const auto& info = buttons_info.button_infos[button];
     const auto& pos_center_ndc = info.center * 2.0f - 1.0f;
+    const int index_base = button * button::kNumStates;
     render_infos.push_back(
         std::array<draw_button::RenderInfo, button::kNumStates>{
             draw_button::RenderInfo{
                 buttons_info.button_alphas[button::kSelectedState],
                 pos_center_ndc,
-                glm::vec2{kTexCenterOffsetX, tex_center_offset_y}},
+                layout.button_centers[index_base + button::kSelectedState]},
             draw_button::RenderInfo{
                 buttons_info.button_alphas[button::kUnselectedState],
                 pos_center_ndc,
-                glm::vec2{kTexCenterOffsetX,
-                          tex_center_offset_y + button_tex_height}},
+                layout.button_centers[index_base + button::kUnselectedState]},
         });
-    tex_center_offset_y += 2 * button_tex_height;
   }
   return render_infos;
 }
 
 button::VerticesInfo Button::CreateDrawButtonVerticesInfo(
-    const ButtonsInfo& buttons_info, const glm::vec2& button_uv_scale) const {
+    const ButtonsInfo& buttons_info,
+    const make_button::ButtonsLayout& layout) const {
   const glm::vec2 button_size_ndc = buttons_info.button_size * kNdcDim;
-  const int num_buttons = buttons_info.button_infos.size();
-  const float button_tex_height =
-      kUvDim / static_cast<float>(num_buttons * button::kNumStates);
-  const auto size_uv = glm::vec2{kUvDim, button_tex_height} * button_uv_scale;
 
   button::VerticesInfo vertices_info{};
   SetVerticesPositions(button_size_ndc, &vertices_info);
-  SetVerticesTexCoords(/*center_uv*/glm::vec2{0.0f}, size_uv, &vertices_info);
+  SetVerticesTexCoords(/*center_uv*/glm::vec2{0.0f}, layout.button_size,
+                       &vertices_info);
   return vertices_info;
 }
 
@@ -165,34 +165,39 @@ class Button {
   using DrawButtonRenderInfos =
       std::vector<std::array<draw_button::RenderInfo, button::kNumStates>>;
 
-  // Describes the vertical position of text.
+  // Describes the position of text.
   struct TextPos {
+    float base_x;
     float base_y;
     float height;
   };
 
   // Returns a vector of make_button::RenderInfo for all buttons in all states.
   std::vector<make_button::RenderInfo> CreateMakeButtonRenderInfos(
-      const ButtonsInfo& buttons_info) const;
+      const ButtonsInfo& buttons_info,
+      const make_button::ButtonsLayout& layout) const;
 
   // Returns a button::VerticesInfo that stores the position and texture
   // coordinate of each vertex.
   button::VerticesInfo CreateMakeButtonVerticesInfo(
-      int num_buttons, const glm::vec2& button_scale) const;
+      const make_button::ButtonsLayout& layout) const;
 
   // Returns a vector of TextPos to describe where to put each text when
   // generating the buttons image.
   std::vector<TextPos> CreateMakeButtonTextPos(
-      const ButtonsInfo& buttons_info) const;
+      const ButtonsInfo& buttons_info,
+      const make_button::ButtonsLayout& layout) const;
 
   // Extracts draw_button::RenderInfo from 'buttons_info'.
   DrawButtonRenderInfos ExtractDrawButtonRenderInfos(
-      const ButtonsInfo& buttons_info) const;
+      const ButtonsInfo& buttons_info,
+      const make_button::ButtonsLayout& layout) const;
 
   // Returns a button::VerticesInfo that stores the position and texture
   // coordinate of each vertex.
   button::VerticesInfo CreateDrawButtonVerticesInfo(
-      const ButtonsInfo& buttons_info, const glm::vec2& button_uv_scale) const;
+      const ButtonsInfo& buttons_info,
+      const make_button::ButtonsLayout& layout) const;
 
   // Aspect ratio of the viewport. This is used to make sure the aspect ratio of
   // buttons does not change when the size of framebuffers changes.
@@ -202,7 +207,7 @@ class Button {
   const glm::vec2 button_half_size_ndc_;
 
   // Rendering information for all buttons in all states.
-  const DrawButtonRenderInfos all_buttons_;
+  DrawButtonRenderInfos all_buttons_;
 
   // Contains rendering information for buttons that will be rendered.
   std::vector<draw_button::RenderInfo> buttons_to_render_;
@@ -7,8 +7,11 @@
 
 #include "lighter/application/vulkan/aurora/editor/button_maker.h"
 
+#include <algorithm>
+
 #include "lighter/application/vulkan/util.h"
 #include "lighter/common/image.h"
+#include "lighter/common/rect_packer.h"
 #include "lighter/common/util.h"
 #include "lighter/renderer/ir/image_usage.h"
 #include "lighter/renderer/vulkan/extension/graphics_pass.h"
@@ -45,12 +48,7 @@ constexpr uint32_t kPerInstanceBufferBindingPoint = 0;
 // this image.
 std::unique_ptr<OffscreenImage> CreateTargetImage(
     const SharedBasicContext& context,
-    int num_buttons, const VkExtent2D& background_image_extent) {
-  const VkExtent2D buttons_image_extent{
-      background_image_extent.width,
-      static_cast<uint32_t>(background_image_extent.height *
-                            num_buttons * button::kNumStates),
-  };
+    const VkExtent2D& buttons_image_extent) {
   const auto image_usages = {
       ImageUsage::GetRenderTargetUsage(/*attachment_location=*/0),
       ImageUsage::GetSampledInFragmentShaderUsage()};
@@ -131,10 +129,9 @@ std::unique_ptr<DynamicText> CreateTextRenderer(
       target_image.extent(), target_image.sample_count(),
       render_pass, kTextSubpassIndex, /*flip_y=*/false);
 
-  constexpr float kTextBaseX = kUvDim / 2.0f;
   for (const auto& info : button_infos) {
     for (int state = 0; state < button::kNumStates; ++state) {
-      text_renderer->AddText(info.text, info.height[state], kTextBaseX,
+      text_renderer->AddText(info.text, info.height[state], info.base_x[state],
                              info.base_y[state], Text::Align::kCenter);
     }
   }
@@ -157,10 +154,41 @@ std::vector<common::VertexAttribute> RenderInfo::GetVertexAttributes() {
 
 } /* namespace make_button */
 
+make_button::ButtonsLayout ButtonMaker::PackButtons(
+    const SharedBasicContext& context, int num_buttons,
+    const VkExtent2D& button_image_extent) {
+  constexpr int kButtonDimensionToIntervalRatio = 100;
+  const glm::ivec2 button_size{static_cast<int>(button_image_extent.width),
+                               static_cast<int>(button_image_extent.height)};
+  const int padding = std::max(
+      std::max(button_size.x, button_size.y) / kButtonDimensionToIntervalRatio,
+      1);
+  const std::vector<glm::ivec2> button_sizes(num_buttons * button::kNumStates,
+                                             button_size);
+  const common::SinglePagePacking packing = common::PackIntoSinglePage(
+      button_sizes, padding,
+      context->physical_device_limits().maxImageDimension2D);
+
+  const glm::vec2 ratio = kUvDim / glm::vec2{packing.page_size};
+  make_button::ButtonsLayout layout{
+      VkExtent2D{static_cast<uint32_t>(packing.page_size.x),
+                 static_cast<uint32_t>(packing.page_size.y)},
+      /*button_size=*/glm::vec2{button_size} * ratio,
+      /*button_centers=*/{},
+  };
+  layout.button_centers.reserve(packing.placements.size());
+  for (const auto& placement : packing.placements) {
+    layout.button_centers.push_back(
+        (glm::vec2{placement.offset} + glm::vec2{button_size} / 2.0f) * ratio);
+  }
+  return layout;
+}
+
 std::unique_ptr<OffscreenImage> ButtonMaker::CreateButtonsImage(
     const SharedBasicContext& context, Text::Font font, int font_height,
     const glm::vec3& text_color, const common::Image& button_background,
     const button::VerticesInfo& vertices_info,
+    const make_button::ButtonsLayout& layout,
     absl::Span<const make_button::ButtonInfo> button_infos) {
   ASSERT_TRUE(button_background.channel() == common::image::kBwImageChannel,
               "Expecting a single-channel button background image");
@@ -170,8 +198,7 @@ std::unique_ptr<OffscreenImage> ButtonMaker::CreateButtonsImage(
       ImageSampler::Config{});
 
   const int num_buttons = button_infos.size();
-  auto buttons_image = CreateTargetImage(context, num_buttons,
-                                         background_image->extent());
+  auto buttons_image = CreateTargetImage(context, layout.image_extent);
 
   const auto per_instance_buffer =
       CreatePerInstanceBuffer(context, button_infos);
@@ -231,10 +258,10 @@ std::unique_ptr<OffscreenImage> ButtonMaker::CreateButtonsImage(
   };
 
   const OneTimeCommand command{context, &context->queues().graphics_queue()};
-  command.Run(
-      [&render_pass, &render_ops](const VkCommandBuffer& command_buffer) {
-        render_pass->Run(command_buffer, /*framebuffer_index=*/0, render_ops);
-      });
+  command.Run([&](const VkCommandBuffer& command_buffer) {
+    text_renderer->Upload(command_buffer, /*frame=*/0);
+    render_pass->Run(command_buffer, /*framebuffer_index=*/0, render_ops);
+  });
 
   return buttons_image;
 }
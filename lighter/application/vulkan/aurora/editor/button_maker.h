@@ -44,10 +44,21 @@ struct RenderInfo {
 struct ButtonInfo {
   std::string text;
   RenderInfo render_info[button::kNumStates];
+  float base_x[button::kNumStates];
   float base_y[button::kNumStates];
   float height[button::kNumStates];
 };
 
+// Describes where buttons are on the buttons image. All numbers are in the
+// texture coordinate.
+struct ButtonsLayout {
+  VkExtent2D image_extent;
+  glm::vec2 button_size;
+
+  // Center of button 'i' in state 's' is at index 'i * button::kNumStates + s'.
+  std::vector<glm::vec2> button_centers;
+};
+
 } /* namespace make_button */
 
 // This class is used to render multiple buttons onto a big texture, so that
@@ -55,26 +66,25 @@ struct ButtonInfo {
 // render call.
 class ButtonMaker {
  public:
-  // Returns a texture that contains all buttons in all states. Layout:
-  //
-  //   |--------------------|
-  //   |       ......       |
-  //   |--------------------|
-  //   | Button1 unselected |
-  //   |--------------------|
-  //   | Button1 selected   |
-  //   |--------------------|
-  //   | Button0 unselected |
-  //   |--------------------|
-  //   | Button0 selected   |
-  //   |--------------------|
-  //
-  // Also note that buttons are opaque on this texture.
+  // Packs 'num_buttons' buttons in all states onto the buttons image with
+  // common::RectPacker, so that the image stays within the limit of image
+  // dimension even if there are many buttons. Each button has the same size as
+  // 'button_image_extent'. There are intervals between buttons, so that when
+  // sampling one button, pixels of another button will not be included due to
+  // numeric errors.
+  static make_button::ButtonsLayout PackButtons(
+      const renderer::vulkan::SharedBasicContext& context, int num_buttons,
+      const VkExtent2D& button_image_extent);
+
+  // Returns a texture that contains all buttons in all states, which are placed
+  // as described by 'layout'. Also note that buttons are opaque on this
+  // texture.
   static std::unique_ptr<renderer::vulkan::OffscreenImage> CreateButtonsImage(
       const renderer::vulkan::SharedBasicContext& context,
       renderer::vulkan::Text::Font font, int font_height,
       const glm::vec3& text_color, const common::Image& button_background,
       const button::VerticesInfo& vertices_info,
+      const make_button::ButtonsLayout& layout,
       absl::Span<const make_button::ButtonInfo> button_infos);
 };
 
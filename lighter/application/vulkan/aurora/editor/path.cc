@@ -7,7 +7,10 @@
 
 #include "lighter/application/vulkan/aurora/editor/path.h"
 
+#include <algorithm>
+
 #include "lighter/application/vulkan/util.h"
+#include "lighter/common/bounds.h"
 #include "lighter/common/file.h"
 #include "lighter/renderer/util.h"
 #include "lighter/renderer/vulkan/wrapper/pipeline_util.h"
@@ -84,9 +87,11 @@ PathRenderer3D::PathRenderer3D(const SharedBasicContext& context,
   const common::ObjFilePosOnly sphere_file{
       common::file::GetResourcePath("model/small_sphere.obj"),
       /*index_base=*/1};
+  const common::Indices sphere_indices = common::NarrowIndices(
+      sphere_file.indices, sphere_file.vertices.size());
   PerVertexBuffer::NoShareIndicesDataInfo sphere_vertices_info{
       /*per_mesh_infos=*/{{
-          PerVertexBuffer::VertexDataInfo{sphere_file.indices},
+          PerVertexBuffer::VertexDataInfo{sphere_indices},
           PerVertexBuffer::VertexDataInfo{sphere_file.vertices},
       }},
   };
@@ -322,6 +327,7 @@ AuroraPath::AuroraPath(const SharedBasicContext& context,
       path_renderer_{context, num_frames_in_flight, num_paths_} {
   path_color_alphas_.reserve(num_paths_);
   spline_editors_.reserve(num_paths_);
+  control_point_bvhs_.resize(num_paths_);
   for (int path = 0; path < num_paths_; ++path) {
     path_color_alphas_.push_back(std::array<glm::vec4, button::kNumStates>{
         glm::vec4{info.path_colors[path][button::kSelectedState],
@@ -400,9 +406,19 @@ void AuroraPath::Draw(const VkCommandBuffer& command_buffer, int frame,
 }
 
 void AuroraPath::UpdatePath(int path_index) {
-  path_renderer_.UpdatePath(path_index,
-                            spline_editors_[path_index]->control_points(),
+  const auto& control_points = spline_editors_[path_index]->control_points();
+  path_renderer_.UpdatePath(path_index, control_points,
                             spline_editors_[path_index]->spline_points());
+
+  // Control points are indexed as points, since their radius in the object
+  // space changes with the camera. Clicks are then queried as spheres.
+  std::vector<common::Aabb> control_point_bounds;
+  control_point_bounds.reserve(control_points.size());
+  for (const auto& point : control_points) {
+    control_point_bounds.push_back(common::Aabb{point, point});
+  }
+  control_point_bvhs_[path_index] =
+      std::make_unique<common::Bvh>(control_point_bounds);
 }
 
 std::optional<int> AuroraPath::ProcessClick(
@@ -478,15 +494,13 @@ std::optional<int> AuroraPath::ProcessClick(
 std::optional<int> AuroraPath::FindClickedControlPoint(
     int path_index, const glm::vec3& click_object_space,
     float control_point_radius_object_space) {
-  const auto& control_points =
-      spline_editors_[path_index]->control_points();
-  for (int i = 0; i < control_points.size(); ++i) {
-    if (glm::distance(control_points[i], click_object_space) <=
-        control_point_radius_object_space) {
-      return i;
-    }
+  std::vector<int> candidates;
+  control_point_bvhs_[path_index]->QuerySphere(
+      click_object_space, control_point_radius_object_space, &candidates);
+  if (candidates.empty()) {
+    return std::nullopt;
   }
-  return std::nullopt;
+  return *std::min_element(candidates.begin(), candidates.end());
 }
 
 bool AuroraPath::InsertControlPoint(
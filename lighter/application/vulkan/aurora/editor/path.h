@@ -15,6 +15,7 @@
 #include <vector>
 
 #include "lighter/application/vulkan/aurora/editor/button_util.h"
+#include "lighter/common/bvh.h"
 #include "lighter/common/camera.h"
 #include "lighter/common/spline.h"
 #include "lighter/renderer/vulkan/wrapper/basic_context.h"
@@ -181,7 +182,8 @@ class AuroraPath {
   const glm::vec3& viewpoint_position() const { return viewpoint_pos_; }
 
  private:
-  // Updates the vertex data of aurora path at 'path_index'.
+  // Updates the vertex data and the spatial index of aurora path at
+  // 'path_index'.
   void UpdatePath(int path_index);
 
   // Processes user click and returns the new value of
@@ -191,7 +193,8 @@ class AuroraPath {
                                    const glm::vec3& model_center,
                                    const std::optional<ClickInfo>& click_info);
 
-  // Returns the index of the clicked control point. If no control point is hit,
+  // Returns the index of the clicked control point. If multiple control points
+  // are hit, returns the one with the lowest index. If no control point is hit,
   // returns std::nullopt.
   std::optional<int> FindClickedControlPoint(
       int path_index, const glm::vec3& click_object_space,
@@ -239,6 +242,10 @@ class AuroraPath {
 
   // Editors of aurora paths.
   std::vector<std::unique_ptr<common::SplineEditor>> spline_editors_;
+
+  // Each element indexes control points of the aurora path at the same index.
+  // These are rebuilt whenever control points change.
+  std::vector<std::unique_ptr<common::Bvh>> control_point_bvhs_;
 };
 
 } /* namespace aurora */
@@ -8,7 +8,9 @@
 #include "lighter/application/vulkan/aurora/viewer/air_transmit_table.h"
 
 #include <limits>
+#include <utility>
 
+#include "lighter/common/memory_pool.h"
 #include "lighter/common/util.h"
 
 #define M_PI 3.14159265358979323846
@@ -181,7 +183,8 @@ float GetAtmosphereThickness(const Ray& ray, const SpanT& span) {
 std::unique_ptr<common::Image> GenerateAirTransmitTable(float sample_step) {
   constexpr int kImageWidth = 1;
   const int image_height = glm::floor(1.0f / sample_step);
-  auto* image_data = new unsigned char[kImageWidth * image_height];
+  auto image_data = common::memory_pool::AllocateBuffer(kImageWidth *
+                                                        image_height);
 
   for (int i = 0; i < image_height; ++i) {
     const float angle = glm::acos(sample_step * static_cast<float>(i));
@@ -197,11 +200,9 @@ std::unique_ptr<common::Image> GenerateAirTransmitTable(float sample_step) {
     image_data[i] = glm::round(air_transmit);
   }
 
-  auto table = std::make_unique<common::Image>(
-      kImageWidth, image_height, common::image::kBwImageChannel, image_data,
-      /*flip_y=*/false);
-  delete[] image_data;
-  return table;
+  return std::make_unique<common::Image>(
+      kImageWidth, image_height, common::image::kBwImageChannel,
+      std::move(image_data));
 }
 
 } /* namespace aurora */
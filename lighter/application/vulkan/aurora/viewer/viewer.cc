@@ -87,7 +87,7 @@ ViewerRenderer::ViewerRenderer(const WindowContext* window_context,
       VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE};
   aurora_deposition_image_ = std::make_unique<SharedTexture>(
       context, common::file::GetResourcePath("texture/aurora_deposition.jpg"),
-      image_usages, sampler_config);
+      image_usages, sampler_config, /*is_srgb=*/false);
 
   const auto air_transmit_table =
       GenerateAirTransmitTable(air_transmit_sample_step);
@@ -106,7 +106,8 @@ ViewerRenderer::ViewerRenderer(const WindowContext* window_context,
       },
   };
   universe_skybox_image_ = std::make_unique<SharedTexture>(
-      context, skybox_path, image_usages, ImageSampler::Config{});
+      context, skybox_path, image_usages, ImageSampler::Config{},
+      /*is_srgb=*/true);
 
   /* Descriptor */
   std::vector<Descriptor::Info::Binding> image_bindings;
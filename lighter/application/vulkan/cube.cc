@@ -112,9 +112,13 @@ CubeApp::CubeApp(const WindowContext::Config& window_config)
   static_text_ = std::make_unique<StaticText>(
       context(), kNumFramesInFlight, original_aspect_ratio,
       std::vector<std::string>{"FPS: "}, kFont, kFontHeight);
+  // Distance fields stay crisp when scaled up, hence glyphs can be loaded at a
+  // smaller size.
+  constexpr int kSdfFontHeight = 32;
   dynamic_text_ = std::make_unique<DynamicText>(
       context(), kNumFramesInFlight, original_aspect_ratio,
-      std::vector<std::string>{"01234567890"}, kFont, kFontHeight);
+      std::vector<std::string>{"01234567890"}, kFont, kSdfFontHeight,
+      Text::GlyphMode::kSignedDistanceField);
 
   /* Render pass */
   render_pass_manager_ = std::make_unique<OnScreenRenderPassManager>(
@@ -190,6 +194,7 @@ void CubeApp::MainLoop() {
         current_frame_, window_context().swapchain(), update_data,
         [this, &render_ops](const VkCommandBuffer& command_buffer,
                             uint32_t framebuffer_index) {
+          dynamic_text_->Upload(command_buffer, current_frame_);
           render_pass().Run(command_buffer, framebuffer_index, render_ops);
         });
 
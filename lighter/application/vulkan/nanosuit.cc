@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "lighter/application/vulkan/util.h"
+#include "lighter/renderer/vulkan/wrapper/texture_streamer.h"
 
 namespace lighter {
 namespace application {
@@ -24,12 +25,17 @@ enum SubpassIndex {
 constexpr int kNumFramesInFlight = 2;
 constexpr int kObjFileIndexBase = 1;
 
+// The skybox covers the whole frame, hence it is streamed first.
+constexpr TextureStreamer::Priority kSkyboxTexturePriority = 1;
+
 /* BEGIN: Consistent with uniform blocks defined in shaders. */
 
 struct NanosuitVertTrans {
   ALIGN_MAT4 glm::mat4 view_model;
   ALIGN_MAT4 glm::mat4 proj_view_model;
   ALIGN_MAT4 glm::mat4 view_model_inv_trs;
+  ALIGN_VEC4 glm::vec4 pos_scale;
+  ALIGN_VEC4 glm::vec4 pos_bias;
 };
 
 struct NanosuitFragTrans {
@@ -73,6 +79,7 @@ class NanosuitApp : public Application {
   std::unique_ptr<UniformBuffer> nanosuit_vert_uniform_;
   std::unique_ptr<PushConstant> nanosuit_frag_constant_;
   std::unique_ptr<PushConstant> skybox_constant_;
+  std::unique_ptr<TextureStreamer> texture_streamer_;
   std::unique_ptr<Model> nanosuit_model_;
   std::unique_ptr<Model> skybox_model_;
   std::unique_ptr<OnScreenRenderPassManager> render_pass_manager_;
@@ -144,6 +151,9 @@ NanosuitApp::NanosuitApp(const WindowContext::Config& window_config)
   skybox_constant_ = std::make_unique<PushConstant>(
       context(), sizeof(SkyboxTrans), kNumFramesInFlight);
 
+  /* Texture streamer */
+  texture_streamer_ = std::make_unique<TextureStreamer>(context());
+
   /* Model */
   const SharedTexture::CubemapPath skybox_path{
       /*directory=*/
@@ -162,7 +172,9 @@ NanosuitApp::NanosuitApp(const WindowContext::Config& window_config)
           /*model_path=*/GetResourcePath("model/nanosuit/nanosuit.obj"),
           /*texture_dir=*/
           GetResourcePath("model/nanosuit/nanosuit.obj",
-                          /*want_directory_path=*/true)}}
+                          /*want_directory_path=*/true),
+          /*optimize_meshes=*/false, ModelBuilder::VertexFormat::kQuantized},
+      texture_streamer_.get()}
       .AddSharedTexture(TextureType::kCubemap, skybox_path)
       .AddTextureBindingPoint(TextureType::kDiffuse, /*binding_point=*/1)
       .AddTextureBindingPoint(TextureType::kSpecular, /*binding_point=*/2)
@@ -185,7 +197,8 @@ NanosuitApp::NanosuitApp(const WindowContext::Config& window_config)
       ModelBuilder::SingleMeshResource{
           GetResourcePath("model/skybox.obj"), kObjFileIndexBase,
           /*tex_source_map=*/{{TextureType::kCubemap, {skybox_path}}},
-      }}
+      },
+      texture_streamer_.get(), kSkyboxTexturePriority}
       .AddTextureBindingPoint(TextureType::kCubemap, /*binding_point=*/1)
       .SetPushConstantShaderStage(VK_SHADER_STAGE_VERTEX_BIT)
       .AddPushConstant(skybox_constant_.get(), /*target_offset=*/0)
@@ -233,10 +246,14 @@ void NanosuitApp::UpdateData(int frame) {
   const glm::mat4 proj = camera.GetProjectionMatrix();
   const glm::mat4 view_model = view * model;
 
+  const common::PositionQuantization& position_quantization =
+      nanosuit_model_->position_quantization();
   *nanosuit_vert_uniform_->HostData<NanosuitVertTrans>(frame) = {
       view_model,
       proj * view_model,
       glm::transpose(glm::inverse(view_model)),
+      glm::vec4{position_quantization.scale, 0.0f},
+      glm::vec4{position_quantization.bias, 0.0f},
   };
   nanosuit_vert_uniform_->Flush(frame);
 
@@ -252,6 +269,7 @@ void NanosuitApp::MainLoop() {
   Recreate();
   while (!should_quit_ && mutable_window_context()->CheckEvents()) {
     timer_.Tick();
+    texture_streamer_->Update();
 
     const auto draw_result = command_->Run(
         current_frame_, window_context().swapchain(), update_data,
@@ -5,6 +5,7 @@
 //  Copyright © 2019 Pujun Lun. All rights reserved.
 //
 
+#include <algorithm>
 #include <array>
 #include <memory>
 #include <numeric>
@@ -13,6 +14,8 @@
 #include <vector>
 
 #include "lighter/application/vulkan/util.h"
+#include "lighter/common/frustum_culling.h"
+#include "lighter/common/mesh_simplifier.h"
 
 namespace lighter {
 namespace application {
@@ -30,6 +33,13 @@ constexpr int kNumAsteroidRings = 3;
 constexpr int kNumFramesInFlight = 2;
 constexpr int kObjFileIndexBase = 1;
 
+// Asteroids are rendered with the coarsest level of detail whose error on the
+// screen does not exceed this.
+constexpr float kMaxAsteroidPixelError = 1.0f;
+
+// Distances to asteroids are clamped to this to avoid dividing by zero.
+constexpr float kMinAsteroidDistance = 0.1f;
+
 /* BEGIN: Consistent with vertex input attributes defined in shaders. */
 
 struct Asteroid {
@@ -84,9 +94,21 @@ class PlanetApp : public Application {
   // Recreates the swapchain and associated resources.
   void Recreate();
 
-  // Populates 'num_asteroids_' and 'per_asteroid_data_'.
+  // Populates 'num_asteroids_', 'asteroids_', 'asteroid_scales_' and
+  // 'per_asteroid_data_'.
   void GenerateAsteroidModels();
 
+  // Populates 'asteroid_spheres_'. This should be called after
+  // 'asteroid_model_' is built.
+  void ComputeAsteroidBoundingSpheres();
+
+  // Culls asteroids outside of the view frustum, selects the level of detail
+  // of each visible asteroid based on its size on the screen, and sends
+  // per-asteroid data sorted by the level of detail to the range of
+  // 'per_asteroid_data_' that belongs to 'frame'. 'num_asteroids_per_lod_'
+  // will be updated.
+  void UpdateVisibleAsteroids(int frame, float elapsed_time);
+
   // Updates per-frame data.
   void UpdateData(int frame);
 
@@ -101,7 +123,13 @@ class PlanetApp : public Application {
   common::FrameTimer timer_;
   std::unique_ptr<common::UserControlledCamera> camera_;
   std::unique_ptr<PerFrameCommand> command_;
-  std::unique_ptr<StaticPerInstanceBuffer> per_asteroid_data_;
+  std::vector<Asteroid> asteroids_;
+  std::vector<float> asteroid_scales_;
+  std::vector<Asteroid> sorted_asteroids_;
+  std::vector<int> visible_asteroids_;
+  std::vector<int> num_asteroids_per_lod_;
+  common::frustum_culling::SphereBatch asteroid_spheres_;
+  std::unique_ptr<DynamicPerInstanceBuffer> per_asteroid_data_;
   std::unique_ptr<UniformBuffer> light_uniform_;
   std::unique_ptr<PushConstant> planet_constant_;
   std::unique_ptr<PushConstant> skybox_constant_;
@@ -201,7 +229,10 @@ PlanetApp::PlanetApp(const WindowContext::Config& window_config)
       ModelBuilder::MultiMeshResource{
           /*model_path=*/GetResourcePath("model/rock/rock.obj"),
           /*texture_dir=*/
-          GetResourcePath("model/rock/rock.obj", /*want_directory_path=*/true)}}
+          GetResourcePath("model/rock/rock.obj", /*want_directory_path=*/true),
+          /*optimize_meshes=*/false, ModelBuilder::VertexFormat::kFull,
+          /*lod_ratios=*/{std::begin(common::mesh_simplifier::kDefaultLodRatios),
+                          std::end(common::mesh_simplifier::kDefaultLodRatios)}}}
       .AddTextureBindingPoint(TextureType::kDiffuse, /*binding_point=*/2)
       .AddPerInstanceBuffer(per_asteroid_data_.get())
       .AddUniformBinding(
@@ -215,6 +246,7 @@ PlanetApp::PlanetApp(const WindowContext::Config& window_config)
       .SetShader(VK_SHADER_STAGE_FRAGMENT_BIT,
                  GetShaderBinaryPath("planet/planet.frag"))
       .Build();
+  ComputeAsteroidBoundingSpheres();
 
   const SharedTexture::CubemapPath skybox_path{
       /*directory=*/
@@ -283,27 +315,104 @@ void PlanetApp::GenerateAsteroidModels() {
 
   num_asteroids_ = static_cast<int>(std::accumulate(
       num_asteroid.begin(), num_asteroid.end(), 0));
-  std::vector<Asteroid> asteroids;
-  asteroids.reserve(num_asteroids_.value());
+  asteroids_.reserve(num_asteroids_.value());
+  asteroid_scales_.reserve(num_asteroids_.value());
 
   for (int ring = 0; ring < kNumAsteroidRings; ++ring) {
     for (int i = 0; i < num_asteroid[ring]; ++i) {
+      const float scale = scale_gen(rand_gen) * 0.02f;
       glm::mat4 model{1.0f};
       model = glm::rotate(model, glm::radians(angle_gen(rand_gen)),
                           glm::vec3{axis_gen(rand_gen), axis_gen(rand_gen),
                                     axis_gen(rand_gen)});
-      model = glm::scale(model, glm::vec3{scale_gen(rand_gen) * 0.02f});
+      model = glm::scale(model, glm::vec3{scale});
 
-      asteroids.push_back(Asteroid{
+      asteroids_.push_back(Asteroid{
           /*theta=*/glm::radians(angle_gen(rand_gen)),
           /*radius=*/radii[ring] + radius_gen(rand_gen),
           model,
       });
+      asteroid_scales_.push_back(scale);
     }
   }
 
-  per_asteroid_data_ = std::make_unique<StaticPerInstanceBuffer>(
-      context(), asteroids, pipeline::GetVertexAttributes<Asteroid>());
+  // Visible asteroids are reordered by the level of detail in every frame.
+  // Each frame in flight has its own range of 'per_asteroid_data_', so that we
+  // don't overwrite data that the device may still be reading for other frames.
+  sorted_asteroids_.resize(num_asteroids_.value());
+  per_asteroid_data_ = std::make_unique<DynamicPerInstanceBuffer>(
+      context(), sizeof(Asteroid), num_asteroids_.value() * kNumFramesInFlight,
+      pipeline::GetVertexAttributes<Asteroid>());
+}
+
+void PlanetApp::ComputeAsteroidBoundingSpheres() {
+  // All asteroids revolve around the planet at the same angular speed, hence
+  // they are static relative to each other. We compute bounding spheres in the
+  // space where asteroids are at their initial positions, so that they never
+  // need to be updated. Consistent with asteroid.vert.
+  const common::Aabb& model_bounds = asteroid_model_->bounds();
+  const float model_radius = glm::length(model_bounds.extent()) / 2.0f;
+  for (int i = 0; i < num_asteroids_.value(); ++i) {
+    const Asteroid& asteroid = asteroids_[i];
+    const glm::vec3 center{glm::sin(asteroid.theta) * asteroid.radius, 0.0f,
+                           glm::cos(asteroid.theta) * asteroid.radius};
+    asteroid_spheres_.Add(
+        center + glm::vec3{asteroid.model *
+                           glm::vec4{model_bounds.center(), 1.0f}},
+        model_radius * asteroid_scales_[i]);
+  }
+}
+
+void PlanetApp::UpdateVisibleAsteroids(int frame, float elapsed_time) {
+  const common::Camera& camera = camera_->camera();
+  // Consistent with asteroid.vert.
+  const float extra_angle = elapsed_time * 0.1f;
+  const float sin_ea = glm::sin(extra_angle), cos_ea = glm::cos(extra_angle);
+  const glm::mat4 to_world{glm::vec4{cos_ea, 0.0f, -sin_ea, 0.0f},
+                           glm::vec4{0.0f, 1.0f, 0.0f, 0.0f},
+                           glm::vec4{sin_ea, 0.0f, cos_ea, 0.0f},
+                           glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}};
+
+  // Frustum planes are transformed to the space where 'asteroid_spheres_' are
+  // computed.
+  common::frustum_culling::CullSpheres(camera.GetFrustumPlanes(to_world),
+                                       asteroid_spheres_, &visible_asteroids_);
+
+  // Number of pixels covered by one unit of the world space, at the distance of
+  // one unit from the camera.
+  const float pixels_per_unit = camera.GetProjectionMatrix()[1][1] *
+                                window_context().frame_size().height / 2.0f;
+
+  num_asteroids_per_lod_.assign(asteroid_model_->num_levels_of_detail(), 0);
+  std::vector<int> asteroid_lods(visible_asteroids_.size());
+  for (int i = 0; i < visible_asteroids_.size(); ++i) {
+    const int index = visible_asteroids_[i];
+    const Asteroid& asteroid = asteroids_[index];
+    const float angle = asteroid.theta + extra_angle;
+    const glm::vec3 center{glm::sin(angle) * asteroid.radius, 0.0f,
+                           glm::cos(angle) * asteroid.radius};
+    const float distance = std::max(glm::distance(center, camera.position()),
+                                    kMinAsteroidDistance);
+    asteroid_lods[i] = asteroid_model_->SelectLevelOfDetail(
+        pixels_per_unit * asteroid_scales_[index] / distance,
+        kMaxAsteroidPixelError);
+    ++num_asteroids_per_lod_[asteroid_lods[i]];
+  }
+
+  // Store asteroids that use the same level of detail contiguously.
+  std::vector<int> next_index(num_asteroids_per_lod_.size(), 0);
+  for (int lod = 1; lod < next_index.size(); ++lod) {
+    next_index[lod] = next_index[lod - 1] + num_asteroids_per_lod_[lod - 1];
+  }
+  for (int i = 0; i < visible_asteroids_.size(); ++i) {
+    sorted_asteroids_[next_index[asteroid_lods[i]]++] =
+        asteroids_[visible_asteroids_[i]];
+  }
+  if (!visible_asteroids_.empty()) {
+    per_asteroid_data_->CopyHostData(
+        sorted_asteroids_.data(), visible_asteroids_.size(),
+        /*first_instance=*/frame * num_asteroids_.value());
+  }
 }
 
 void PlanetApp::UpdateData(int frame) {
@@ -315,6 +424,8 @@ void PlanetApp::UpdateData(int frame) {
       {glm::vec4{light_dir, elapsed_time}};
   light_uniform_->Flush(frame);
 
+  UpdateVisibleAsteroids(frame, elapsed_time);
+
   glm::mat4 model{1.0f};
   model = glm::rotate(model, elapsed_time * glm::radians(5.0f),
                       glm::vec3{0.0f, 1.0f, 0.0f});
@@ -337,8 +448,16 @@ void PlanetApp::MainLoop() {
         [this](const VkCommandBuffer& command_buffer) {
           planet_model_->Draw(command_buffer, current_frame_,
                               /*instance_count=*/1);
-          asteroid_model_->Draw(command_buffer, current_frame_,
-                                static_cast<uint32_t>(num_asteroids_.value()));
+          int first_asteroid = current_frame_ * num_asteroids_.value();
+          for (int lod = 0; lod < num_asteroids_per_lod_.size(); ++lod) {
+            const int num_asteroids = num_asteroids_per_lod_[lod];
+            if (num_asteroids > 0) {
+              asteroid_model_->Draw(command_buffer, current_frame_,
+                                    static_cast<uint32_t>(num_asteroids), lod,
+                                    first_asteroid);
+            }
+            first_asteroid += num_asteroids;
+          }
           skybox_model_->Draw(command_buffer, current_frame_,
                               /*instance_count=*/1);
         },
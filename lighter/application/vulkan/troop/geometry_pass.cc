@@ -10,6 +10,7 @@
 #include <vector>
 
 #include "lighter/application/vulkan/util.h"
+#include "lighter/common/bounds.h"
 #include "lighter/common/file.h"
 #include "lighter/renderer/ir/image_usage.h"
 #include "lighter/renderer/util.h"
@@ -67,18 +68,21 @@ GeometryPass::GeometryPass(const WindowContext* window_context,
   const auto context = window_context_.basic_context();
 
   /* Vertex buffer */
-  std::vector<glm::vec3> centers;
-  centers.reserve(num_soldiers_);
+  centers_.reserve(num_soldiers_);
   for (int x = 0; x < num_soldiers.x; ++x) {
     for (int z = 0; z < num_soldiers.y; ++z) {
-      centers.push_back(glm::vec3{
+      centers_.push_back(glm::vec3{
           interval_between_soldiers.x * static_cast<float>(x), 0.0f,
           interval_between_soldiers.y * static_cast<float>(z),
       });
     }
   }
-  center_data_ = std::make_unique<StaticPerInstanceBuffer>(
-      context, centers,
+  // Centers of visible soldiers are copied to the device in every frame. Each
+  // frame in flight has its own range of 'center_data_', so that we don't
+  // overwrite data that the device may still be reading for other frames.
+  visible_centers_.reserve(num_soldiers_);
+  center_data_ = std::make_unique<DynamicPerInstanceBuffer>(
+      context, sizeof(glm::vec3), num_soldiers_ * num_frames_in_flight,
       pipeline::GetVertexAttributes<common::Vertex3DPosOnly>());
 
   /* Uniform buffer */
@@ -120,6 +124,17 @@ GeometryPass::GeometryPass(const WindowContext* window_context,
       .SetShader(VK_SHADER_STAGE_FRAGMENT_BIT,
                  GetShaderBinaryPath("troop/geometry_pass.frag"))
       .Build();
+
+  /* Spatial index */
+  // Soldiers never move, hence the BVH is built only once.
+  const common::Aabb model_bounds = nanosuit_model_->bounds().Transform(model);
+  std::vector<common::Aabb> soldier_bounds;
+  soldier_bounds.reserve(num_soldiers_);
+  for (const auto& center : centers_) {
+    soldier_bounds.push_back(
+        common::Aabb{model_bounds.min + center, model_bounds.max + center});
+  }
+  soldier_bvh_ = std::make_unique<common::Bvh>(soldier_bounds);
 }
 
 void GeometryPass::UpdateFramebuffer(const Image& depth_stencil_image,
@@ -156,18 +171,34 @@ void GeometryPass::UpdateFramebuffer(const Image& depth_stencil_image,
 }
 
 void GeometryPass::UpdatePerFrameData(int frame, const common::Camera& camera) {
-  trans_uniform_->HostData<Transformation>(frame)->proj_view =
+  const glm::mat4 proj_view =
       camera.GetProjectionMatrix() * camera.GetViewMatrix();
+  trans_uniform_->HostData<Transformation>(frame)->proj_view = proj_view;
   trans_uniform_->Flush(frame, sizeof(Transformation::proj_view),
                         offsetof(Transformation, proj_view));
+
+  visible_soldiers_.clear();
+  soldier_bvh_->QueryFrustum(camera.GetFrustumPlanes(), &visible_soldiers_);
+  visible_centers_.clear();
+  for (int index : visible_soldiers_) {
+    visible_centers_.push_back(centers_[index]);
+  }
+  if (!visible_centers_.empty()) {
+    center_data_->CopyHostData(visible_centers_,
+                               /*first_instance=*/frame * num_soldiers_);
+  }
 }
 
 void GeometryPass::Draw(const VkCommandBuffer& command_buffer,
                         uint32_t framebuffer_index, int current_frame) const {
   render_pass_->Run(command_buffer, framebuffer_index, /*render_ops=*/{
           [this, current_frame](const VkCommandBuffer& command_buffer) {
-            nanosuit_model_->Draw(command_buffer, current_frame,
-                                  /*instance_count=*/num_soldiers_);
+            if (!visible_centers_.empty()) {
+              nanosuit_model_->Draw(
+                  command_buffer, current_frame,
+                  /*instance_count=*/visible_centers_.size(), /*lod=*/0,
+                  /*first_instance=*/current_frame * num_soldiers_);
+            }
           },
       });
 }
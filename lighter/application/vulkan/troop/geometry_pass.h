@@ -12,7 +12,9 @@
 #include <string>
 #include <string_view>
 #include <optional>
+#include <vector>
 
+#include "lighter/common/bvh.h"
 #include "lighter/common/camera.h"
 #include "lighter/common/util.h"
 #include "lighter/renderer/vulkan/extension/graphics_pass.h"
@@ -51,7 +53,8 @@ class GeometryPass {
                          const renderer::vulkan::Image& normal_image,
                          const renderer::vulkan::Image& diffuse_specular_image);
 
-  // Updates per-frame data.
+  // Updates per-frame data. Soldiers outside of the view frustum of 'camera'
+  // will not be rendered.
   void UpdatePerFrameData(int frame, const common::Camera& camera);
 
   // Runs the geometry pass.
@@ -87,13 +90,23 @@ class GeometryPass {
   // Number of soldiers to render.
   const int num_soldiers_;
 
+  // Centers of all soldiers in the world space.
+  std::vector<glm::vec3> centers_;
+
+  // Indexes bounding boxes of soldiers in the world space.
+  std::unique_ptr<common::Bvh> soldier_bvh_;
+
+  // Indices and centers of soldiers that are visible in the current frame.
+  std::vector<int> visible_soldiers_;
+  std::vector<glm::vec3> visible_centers_;
+
   // Objects used for rendering.
   const renderer::vulkan::WindowContext& window_context_;
   std::optional<int> depth_stencil_attachment_index_;
   std::optional<int> position_color_attachment_index_;
   std::optional<int> normal_color_attachment_index_;
   std::optional<int> diffuse_specular_color_attachment_index_;
-  std::unique_ptr<renderer::vulkan::StaticPerInstanceBuffer> center_data_;
+  std::unique_ptr<renderer::vulkan::DynamicPerInstanceBuffer> center_data_;
   std::unique_ptr<renderer::vulkan::UniformBuffer> trans_uniform_;
   std::unique_ptr<renderer::vulkan::Model> nanosuit_model_;
   std::unique_ptr<renderer::vulkan::RenderPassBuilder> render_pass_builder_;
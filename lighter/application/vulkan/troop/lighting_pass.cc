@@ -220,9 +220,11 @@ LightingPass::LightingPass(const WindowContext* window_context,
   /* Vertex buffer */
   const common::ObjFilePosOnly cube_file{
       common::file::GetResourcePath("model/cube.obj"), /*index_base=*/1};
+  const common::Indices cube_indices = common::NarrowIndices(
+      cube_file.indices, cube_file.vertices.size());
   PerVertexBuffer::NoShareIndicesDataInfo cube_vertex_data_info{
       /*per_mesh_infos=*/{{
-          PerVertexBuffer::VertexDataInfo{cube_file.indices},
+          PerVertexBuffer::VertexDataInfo{cube_indices},
           PerVertexBuffer::VertexDataInfo{cube_file.vertices},
       }},
   };
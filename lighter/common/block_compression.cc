@@ -0,0 +1,1093 @@
+//
+//  block_compression.cc
+//
+//  Created by Pujun Lun on 6/24/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/block_compression.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "lighter/common/image.h"
+#include "lighter/common/util.h"
+#include "third_party/absl/strings/str_format.h"
+
+namespace lighter::common::block_compression {
+namespace {
+
+// Blocks are encoded in tasks that process at least this number of blocks,
+// since the overhead of threads outweighs the benefit for small images.
+constexpr int kMinBlocksPerTask = 1024;
+
+// Number of iterations for finding the principal axis.
+constexpr int kNumPowerIterations = 8;
+
+// Number of iterations for refining endpoints with least squares in
+// Quality::kHigh.
+constexpr int kNumRefinements = 2;
+
+// Interpolation weights of BC7 indices, out of 64.
+constexpr int kBc7Weights2[]{0, 21, 43, 64};
+constexpr int kBc7Weights4[]{0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51,
+                             55, 60, 64};
+
+// 4x4 texels with up to 4 channels, converted to floats in range [0, 255].
+using FloatTexels = std::array<std::array<float, 4>, kNumTexelsPerBlock>;
+
+// Endpoints of a line segment in the color space.
+using Endpoints = std::array<std::array<float, 4>, 2>;
+
+// Writes bits to a zero-initialized block, starting from the least significant
+// bit of the first byte.
+class BitWriter {
+ public:
+  explicit BitWriter(uint8_t* block) : block_{block} {}
+
+  // This class is neither copyable nor movable.
+  BitWriter(const BitWriter&) = delete;
+  BitWriter& operator=(const BitWriter&) = delete;
+
+  // Writes the lowest 'num_bits' bits of 'value'.
+  void Write(uint32_t value, int num_bits) {
+    for (int i = 0; i < num_bits; ++i, ++offset_) {
+      if ((value >> i) & 1) {
+        block_[offset_ / 8] |= static_cast<uint8_t>(1 << (offset_ % 8));
+      }
+    }
+  }
+
+ private:
+  // Pointer to the block.
+  uint8_t* block_;
+
+  // Offset of the next bit to write.
+  int offset_ = 0;
+};
+
+// Reads bits from a block in the same order as BitWriter.
+class BitReader {
+ public:
+  explicit BitReader(const uint8_t* block) : block_{block} {}
+
+  // This class is neither copyable nor movable.
+  BitReader(const BitReader&) = delete;
+  BitReader& operator=(const BitReader&) = delete;
+
+  // Reads 'num_bits' bits as an unsigned integer.
+  uint32_t Read(int num_bits) {
+    uint32_t value = 0;
+    for (int i = 0; i < num_bits; ++i, ++offset_) {
+      value |= static_cast<uint32_t>((block_[offset_ / 8] >> (offset_ % 8)) & 1)
+               << i;
+    }
+    return value;
+  }
+
+ private:
+  // Pointer to the block.
+  const uint8_t* block_;
+
+  // Offset of the next bit to read.
+  int offset_ = 0;
+};
+
+// Converts the first 'num_channels' channels of 'texels' to floats.
+FloatTexels ToFloatTexels(const uint8_t* texels, int channel,
+                          int num_channels) {
+  FloatTexels float_texels{};
+  for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+    for (int c = 0; c < num_channels; ++c) {
+      float_texels[i][c] = texels[i * channel + c];
+    }
+  }
+  return float_texels;
+}
+
+// Returns the squared distance between 'a' and 'b' in the first 'N' channels.
+template <int N, typename T>
+float SquaredDistance(const std::array<float, 4>& a, const T& b) {
+  float distance = 0.0f;
+  for (int c = 0; c < N; ++c) {
+    const float diff = a[c] - static_cast<float>(b[c]);
+    distance += diff * diff;
+  }
+  return distance;
+}
+
+// Fits a line to 'texels' in the first 'N' channels, and returns the endpoints
+// of the line segment that covers projections of all texels. The direction of
+// the line is the principal axis of texels, found by power iteration.
+template <int N>
+Endpoints FitEndpoints(const FloatTexels& texels) {
+  std::array<float, 4> mean{};
+  for (const auto& texel : texels) {
+    for (int c = 0; c < N; ++c) {
+      mean[c] += texel[c];
+    }
+  }
+  for (int c = 0; c < N; ++c) {
+    mean[c] /= kNumTexelsPerBlock;
+  }
+
+  float covariance[N][N]{};
+  for (const auto& texel : texels) {
+    for (int i = 0; i < N; ++i) {
+      for (int j = 0; j < N; ++j) {
+        covariance[i][j] += (texel[i] - mean[i]) * (texel[j] - mean[j]);
+      }
+    }
+  }
+
+  // Start from the row with the largest variance, which can't be orthogonal
+  // to the principal axis unless all texels are the same.
+  int start = 0;
+  for (int c = 1; c < N; ++c) {
+    if (covariance[c][c] > covariance[start][start]) {
+      start = c;
+    }
+  }
+  std::array<float, 4> axis{};
+  for (int c = 0; c < N; ++c) {
+    axis[c] = covariance[start][c];
+  }
+  for (int iteration = 0; iteration < kNumPowerIterations; ++iteration) {
+    std::array<float, 4> next{};
+    float max_component = 0.0f;
+    for (int i = 0; i < N; ++i) {
+      for (int j = 0; j < N; ++j) {
+        next[i] += covariance[i][j] * axis[j];
+      }
+      max_component = std::max(max_component, std::abs(next[i]));
+    }
+    if (max_component == 0.0f) {
+      break;
+    }
+    for (int c = 0; c < N; ++c) {
+      axis[c] = next[c] / max_component;
+    }
+  }
+
+  float length_squared = 0.0f;
+  for (int c = 0; c < N; ++c) {
+    length_squared += axis[c] * axis[c];
+  }
+  float min_t = 0.0f, max_t = 0.0f;
+  if (length_squared > 0.0f) {
+    min_t = std::numeric_limits<float>::max();
+    max_t = std::numeric_limits<float>::lowest();
+    for (const auto& texel : texels) {
+      float t = 0.0f;
+      for (int c = 0; c < N; ++c) {
+        t += (texel[c] - mean[c]) * axis[c];
+      }
+      t /= length_squared;
+      min_t = std::min(min_t, t);
+      max_t = std::max(max_t, t);
+    }
+  }
+
+  Endpoints endpoints{};
+  for (int c = 0; c < N; ++c) {
+    endpoints[0][c] = std::clamp(mean[c] + min_t * axis[c], 0.0f, 255.0f);
+    endpoints[1][c] = std::clamp(mean[c] + max_t * axis[c], 0.0f, 255.0f);
+  }
+  return endpoints;
+}
+
+// Refines endpoints in the first 'N' channels with least squares, so that
+// interpolating them with 'weights' of each texel (in range [0, 1], from the
+// first endpoint to the second one) best approximates 'texels'. Returns false
+// if the system is degenerate, in which case 'endpoints' is not modified.
+template <int N>
+bool RefineEndpoints(const FloatTexels& texels, const float* weights,
+                     Endpoints& endpoints) {
+  float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+  std::array<float, 4> ax{}, bx{};
+  for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+    const float b = weights[i];
+    const float a = 1.0f - b;
+    aa += a * a;
+    ab += a * b;
+    bb += b * b;
+    for (int c = 0; c < N; ++c) {
+      ax[c] += a * texels[i][c];
+      bx[c] += b * texels[i][c];
+    }
+  }
+  const float determinant = aa * bb - ab * ab;
+  if (std::abs(determinant) < 1e-6f) {
+    return false;
+  }
+  for (int c = 0; c < N; ++c) {
+    endpoints[0][c] = std::clamp((bb * ax[c] - ab * bx[c]) / determinant,
+                                 0.0f, 255.0f);
+    endpoints[1][c] = std::clamp((aa * bx[c] - ab * ax[c]) / determinant,
+                                 0.0f, 255.0f);
+  }
+  return true;
+}
+
+// Returns the index of the entry in 'palette' closest to 'texel' in the first
+// 'N' channels. The squared distance is added to 'error'.
+template <int N, typename Palette>
+int FindClosestEntry(const std::array<float, 4>& texel, const Palette& palette,
+                     int palette_size, float& error) {
+  int best_index = 0;
+  float best_distance = std::numeric_limits<float>::max();
+  for (int i = 0; i < palette_size; ++i) {
+    const float distance = SquaredDistance<N>(texel, palette[i]);
+    if (distance < best_distance) {
+      best_distance = distance;
+      best_index = i;
+    }
+  }
+  error += best_distance;
+  return best_index;
+}
+
+// Returns the position of 'texel' projected on the line from 'start' to 'end'
+// in the first 'N' channels, where 0 and 1 are the two ends.
+template <int N, typename T>
+float Project(const std::array<float, 4>& texel, const T& start,
+              const T& end) {
+  float dot = 0.0f, length_squared = 0.0f;
+  for (int c = 0; c < N; ++c) {
+    const float direction = static_cast<float>(end[c] - start[c]);
+    dot += (texel[c] - start[c]) * direction;
+    length_squared += direction * direction;
+  }
+  return length_squared > 0.0f ? std::clamp(dot / length_squared, 0.0f, 1.0f)
+                               : 0.0f;
+}
+
+// BC1 color block with a 4-color palette.
+struct ColorBlock {
+  uint16_t colors[2];
+  int indices[kNumTexelsPerBlock] = {};
+  float error = 0.0f;
+};
+
+// Expands 5-bit and 6-bit values to 8 bits.
+int Expand5(int value) { return (value << 3) | (value >> 2); }
+int Expand6(int value) { return (value << 2) | (value >> 4); }
+
+// Unpacks an RGB565 color to 8-bit channels.
+std::array<int, 3> UnpackRgb565(uint16_t color) {
+  return {Expand5(color >> 11), Expand6((color >> 5) & 0x3F),
+          Expand5(color & 0x1F)};
+}
+
+// Packs 8-bit channels to an RGB565 color with rounding.
+uint16_t PackRgb565(const std::array<float, 4>& color) {
+  const auto quantize = [](float value, int max) {
+    return static_cast<int>(std::lround(value * max / 255.0f));
+  };
+  return static_cast<uint16_t>((quantize(color[0], 31) << 11) |
+                               (quantize(color[1], 63) << 5) |
+                               quantize(color[2], 31));
+}
+
+// Returns the 4-color palette of BC1. Entries are ordered as encoded indices,
+// hence the third and fourth entries are interpolated ones.
+std::array<std::array<int, 3>, 4> GetBc1Palette(uint16_t color0,
+                                                uint16_t color1) {
+  std::array<std::array<int, 3>, 4> palette;
+  palette[0] = UnpackRgb565(color0);
+  palette[1] = UnpackRgb565(color1);
+  for (int c = 0; c < 3; ++c) {
+    palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+    palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+  }
+  return palette;
+}
+
+// Best pair of 5-bit or 6-bit endpoints for each 8-bit value, such that the
+// interpolated entry at index 2 of the palette is closest to the value. This
+// makes solid blocks much more accurate than quantizing the value directly.
+struct SingleColorTables {
+  using Table = std::array<std::array<uint8_t, 2>, 256>;
+
+  SingleColorTables() {
+    Build(/*num_bits=*/5, table5);
+    Build(/*num_bits=*/6, table6);
+  }
+
+  static void Build(int num_bits, Table& table) {
+    const int max = (1 << num_bits) - 1;
+    const auto expand = num_bits == 5 ? Expand5 : Expand6;
+    for (int value = 0; value < 256; ++value) {
+      int best_error = std::numeric_limits<int>::max();
+      for (int a = 0; a <= max; ++a) {
+        for (int b = 0; b <= max; ++b) {
+          const int error =
+              std::abs((2 * expand(a) + expand(b)) / 3 - value);
+          if (error < best_error) {
+            best_error = error;
+            table[value] = {static_cast<uint8_t>(a), static_cast<uint8_t>(b)};
+          }
+        }
+      }
+    }
+  }
+
+  Table table5;
+  Table table6;
+};
+
+// Returns the singleton of SingleColorTables.
+const SingleColorTables& GetSingleColorTables() {
+  static const auto* tables = new SingleColorTables{};
+  return *tables;
+}
+
+// Assigns indices of 'block' for 'texels' and updates its error.
+void AssignBc1Indices(const FloatTexels& texels, Quality quality,
+                      ColorBlock& block) {
+  const auto palette = GetBc1Palette(block.colors[0], block.colors[1]);
+  block.error = 0.0f;
+  for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+    if (quality == Quality::kFast) {
+      // Positions 0, 1/3, 2/3 and 1 on the line map to indices 0, 2, 3, 1.
+      constexpr int kIndices[]{0, 2, 3, 1};
+      const float t = Project<3>(texels[i], palette[0], palette[1]);
+      block.indices[i] = kIndices[static_cast<int>(std::lround(t * 3.0f))];
+      block.error += SquaredDistance<3>(texels[i], palette[block.indices[i]]);
+    } else {
+      block.indices[i] = FindClosestEntry<3>(texels[i], palette,
+                                             /*palette_size=*/4, block.error);
+    }
+  }
+}
+
+// Returns the BC1 block for 'texels' whose colors are all the same.
+ColorBlock EncodeSingleColor(const std::array<float, 4>& texel) {
+  const auto& tables = GetSingleColorTables();
+  const int r = static_cast<int>(texel[0]);
+  const int g = static_cast<int>(texel[1]);
+  const int b = static_cast<int>(texel[2]);
+  ColorBlock block{};
+  for (int i = 0; i < 2; ++i) {
+    block.colors[i] = static_cast<uint16_t>((tables.table5[r][i] << 11) |
+                                            (tables.table6[g][i] << 5) |
+                                            tables.table5[b][i]);
+  }
+  std::fill(std::begin(block.indices), std::end(block.indices), 2);
+  return block;
+}
+
+// Returns the BC1 block that best encodes 'texels'.
+ColorBlock FindColorBlock(const FloatTexels& texels, Quality quality) {
+  bool is_solid = true;
+  for (int i = 1; i < kNumTexelsPerBlock && is_solid; ++i) {
+    is_solid = SquaredDistance<3>(texels[i], texels[0]) == 0.0f;
+  }
+  if (is_solid) {
+    return EncodeSingleColor(texels[0]);
+  }
+
+  Endpoints endpoints = FitEndpoints<3>(texels);
+  // The first color is the larger one in 4-color mode.
+  ColorBlock best_block{{PackRgb565(endpoints[1]), PackRgb565(endpoints[0])}};
+  AssignBc1Indices(texels, quality, best_block);
+  if (quality == Quality::kFast) {
+    return best_block;
+  }
+
+  ColorBlock block = best_block;
+  for (int iteration = 0; iteration < kNumRefinements; ++iteration) {
+    // Weights of indices from the first color to the second one.
+    constexpr float kWeights[]{0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+    float weights[kNumTexelsPerBlock];
+    for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+      weights[i] = kWeights[block.indices[i]];
+    }
+    if (!RefineEndpoints<3>(texels, weights, endpoints)) {
+      break;
+    }
+    block.colors[0] = PackRgb565(endpoints[0]);
+    block.colors[1] = PackRgb565(endpoints[1]);
+    AssignBc1Indices(texels, quality, block);
+    if (block.error < best_block.error) {
+      best_block = block;
+    }
+  }
+  return best_block;
+}
+
+// Encodes the first 3 channels of 'texels' into a BC1 color block, which is
+// always decoded in 4-color mode.
+void EncodeColorBlock(const FloatTexels& texels, Quality quality,
+                      uint8_t* output) {
+  ColorBlock block = FindColorBlock(texels, quality);
+  uint16_t color0 = block.colors[0], color1 = block.colors[1];
+  if (color0 < color1) {
+    // Swapping colors swaps indices 0 and 1, as well as 2 and 3.
+    std::swap(color0, color1);
+    for (int& index : block.indices) {
+      index ^= 1;
+    }
+  } else if (color0 == color1) {
+    // 3-color mode is used if colors are equal, where the index 3 means
+    // transparent black, hence we only use the index 0.
+    std::fill(std::begin(block.indices), std::end(block.indices), 0);
+  }
+
+  uint32_t indices = 0;
+  for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+    indices |= static_cast<uint32_t>(block.indices[i]) << (2 * i);
+  }
+  std::memcpy(output, &color0, sizeof(color0));
+  std::memcpy(output + 2, &color1, sizeof(color1));
+  std::memcpy(output + 4, &indices, sizeof(indices));
+}
+
+// Decodes a BC1 color block into the first 3 channels of 'texels'. If
+// 'allow_three_color_mode' is false, the block is always decoded in 4-color
+// mode, which is the case for BC3.
+void DecodeColorBlock(const uint8_t* block, bool allow_three_color_mode,
+                      int channel, uint8_t* texels) {
+  uint16_t color0, color1;
+  uint32_t indices;
+  std::memcpy(&color0, block, sizeof(color0));
+  std::memcpy(&color1, block + 2, sizeof(color1));
+  std::memcpy(&indices, block + 4, sizeof(indices));
+
+  auto palette = GetBc1Palette(color0, color1);
+  if (allow_three_color_mode && color0 <= color1) {
+    for (int c = 0; c < 3; ++c) {
+      palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+      palette[3][c] = 0;
+    }
+  }
+  for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+    const auto& color = palette[(indices >> (2 * i)) & 3];
+    for (int c = 0; c < 3; ++c) {
+      texels[i * channel + c] = static_cast<uint8_t>(color[c]);
+    }
+  }
+}
+
+// Returns the 8-entry palette of a BC4 block. The block is in 8-value mode if
+// 'value0' is larger than 'value1', otherwise in 6-value mode with two extra
+// entries 0 and 255.
+std::array<int, 8> GetBc4Palette(int value0, int value1) {
+  std::array<int, 8> palette{value0, value1};
+  if (value0 > value1) {
+    for (int i = 1; i < 7; ++i) {
+      palette[i + 1] = ((7 - i) * value0 + i * value1 + 3) / 7;
+    }
+  } else {
+    for (int i = 1; i < 5; ++i) {
+      palette[i + 1] = ((5 - i) * value0 + i * value1 + 2) / 5;
+    }
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+  return palette;
+}
+
+// BC4 block with endpoints and 3-bit indices.
+struct ValueBlock {
+  int values[2];
+  int indices[kNumTexelsPerBlock] = {};
+  int error = 0;
+};
+
+// Assigns indices of 'block' for 'values' and updates its error.
+void AssignBc4Indices(const int* values, ValueBlock& block) {
+  const auto palette = GetBc4Palette(block.values[0], block.values[1]);
+  block.error = 0;
+  if (block.values[0] > block.values[1]) {
+    // Entries of 8-value mode are evenly spaced, hence we only need to check
+    // the entries around the projection, which may differ due to rounding.
+    // Position 0 on the line maps to index 1, 7 maps to index 0, and others
+    // map to 8 - position.
+    constexpr int kIndices[]{1, 7, 6, 5, 4, 3, 2, 0};
+    const int range = block.values[0] - block.values[1];
+    for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+      const int position = std::clamp(
+          ((values[i] - block.values[1]) * 7 + range / 2) / range, 0, 7);
+      int best_distance = std::numeric_limits<int>::max();
+      for (int p = std::max(position - 1, 0); p <= std::min(position + 1, 7);
+           ++p) {
+        const int distance = std::abs(values[i] - palette[kIndices[p]]);
+        if (distance < best_distance) {
+          best_distance = distance;
+          block.indices[i] = kIndices[p];
+        }
+      }
+      block.error += best_distance * best_distance;
+    }
+    return;
+  }
+
+  for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+    int best_distance = std::numeric_limits<int>::max();
+    for (int j = 0; j < 8; ++j) {
+      const int distance = std::abs(values[i] - palette[j]);
+      if (distance < best_distance) {
+        best_distance = distance;
+        block.indices[i] = j;
+      }
+    }
+    block.error += best_distance * best_distance;
+  }
+}
+
+// Encodes 'values' of 16 texels into a BC4 block.
+void EncodeValueBlock(const int* values, Quality quality, uint8_t* output) {
+  const auto [min_iter, max_iter] =
+      std::minmax_element(values, values + kNumTexelsPerBlock);
+  const int min = *min_iter, max = *max_iter;
+
+  ValueBlock best_block{{max, min}};
+  AssignBc4Indices(values, best_block);
+  if (quality == Quality::kHigh && best_block.error > 0) {
+    // Try endpoints around the range in 8-value mode, since interpolated
+    // entries may fit better if the range is slightly enlarged or shrunk.
+    constexpr int kSearchRadius = 1;
+    for (int d0 = -kSearchRadius; d0 <= kSearchRadius; ++d0) {
+      for (int d1 = -kSearchRadius; d1 <= kSearchRadius; ++d1) {
+        ValueBlock block{{std::clamp(max + d0, 0, 255),
+                          std::clamp(min + d1, 0, 255)}};
+        if (block.values[0] <= block.values[1]) {
+          continue;
+        }
+        AssignBc4Indices(values, block);
+        if (block.error < best_block.error) {
+          best_block = block;
+        }
+      }
+    }
+
+    // Try 6-value mode, where extreme values are represented exactly, and the
+    // range of other values is covered by endpoints.
+    int inner_min = 255, inner_max = 0;
+    for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+      if (values[i] != 0 && values[i] != 255) {
+        inner_min = std::min(inner_min, values[i]);
+        inner_max = std::max(inner_max, values[i]);
+      }
+    }
+    if (inner_min <= inner_max) {
+      ValueBlock block{{inner_min, inner_max}};
+      AssignBc4Indices(values, block);
+      if (block.error < best_block.error) {
+        best_block = block;
+      }
+    }
+  }
+
+  output[0] = static_cast<uint8_t>(best_block.values[0]);
+  output[1] = static_cast<uint8_t>(best_block.values[1]);
+  uint64_t indices = 0;
+  for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+    indices |= static_cast<uint64_t>(best_block.indices[i]) << (3 * i);
+  }
+  for (int i = 0; i < 6; ++i) {
+    output[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+  }
+}
+
+// Encodes channel 'c' of 'texels' with 'channel' channels into a BC4 block.
+void EncodeChannel(const uint8_t* texels, int channel, int c, Quality quality,
+                   uint8_t* output) {
+  int values[kNumTexelsPerBlock];
+  for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+    values[i] = texels[i * channel + c];
+  }
+  EncodeValueBlock(values, quality, output);
+}
+
+// Decodes a BC4 block into channel 'c' of 'texels' with 'channel' channels.
+void DecodeChannel(const uint8_t* block, int channel, int c,
+                   uint8_t* texels) {
+  const auto palette = GetBc4Palette(block[0], block[1]);
+  uint64_t indices = 0;
+  for (int i = 0; i < 6; ++i) {
+    indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+  }
+  for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+    texels[i * channel + c] =
+        static_cast<uint8_t>(palette[(indices >> (3 * i)) & 7]);
+  }
+}
+
+// BC7 block in mode 6, which has one subset with 7-bit RGBA endpoints, a
+// p-bit (least significant bit shared by all channels) for each endpoint, and
+// 4-bit indices.
+struct Bc7Mode6Block {
+  int quantized[2][4];
+  int p_bits[2];
+  int indices[kNumTexelsPerBlock];
+  float error;
+};
+
+// BC7 block in mode 5 without rotation, which has 7-bit RGB endpoints and
+// 8-bit alpha endpoints, each with 2-bit indices.
+struct Bc7Mode5Block {
+  int color_quantized[2][3];
+  int color_indices[kNumTexelsPerBlock];
+  int alpha[2];
+  int alpha_indices[kNumTexelsPerBlock];
+  float error;
+};
+
+// Interpolates 'value0' and 'value1' with 'weight' out of 64.
+int InterpolateBc7(int value0, int value1, int weight) {
+  return ((64 - weight) * value0 + weight * value1 + 32) >> 6;
+}
+
+// Quantizes 'endpoint' to 7 bits per channel plus a p-bit, choosing the p-bit
+// with the smaller error.
+void QuantizeWithPBit(const std::array<float, 4>& endpoint, int* quantized,
+                      int& p_bit) {
+  float best_error = std::numeric_limits<float>::max();
+  for (int p = 0; p < 2; ++p) {
+    int candidate[4];
+    float error = 0.0f;
+    for (int c = 0; c < 4; ++c) {
+      candidate[c] = std::clamp(
+          static_cast<int>(std::lround((endpoint[c] - p) / 2.0f)), 0, 127);
+      const float diff = static_cast<float>(candidate[c] * 2 + p) -
+                         endpoint[c];
+      error += diff * diff;
+    }
+    if (error < best_error) {
+      best_error = error;
+      p_bit = p;
+      std::copy(std::begin(candidate), std::end(candidate), quantized);
+    }
+  }
+}
+
+// Returns the 16-entry palette of mode 6.
+std::array<std::array<int, 4>, 16> GetBc7Mode6Palette(
+    const int (&quantized)[2][4], const int (&p_bits)[2]) {
+  std::array<std::array<int, 4>, 16> palette;
+  for (int i = 0; i < 16; ++i) {
+    for (int c = 0; c < 4; ++c) {
+      palette[i][c] = InterpolateBc7(quantized[0][c] * 2 + p_bits[0],
+                                     quantized[1][c] * 2 + p_bits[1],
+                                     kBc7Weights4[i]);
+    }
+  }
+  return palette;
+}
+
+// Quantizes 'endpoints' into 'block', and assigns its indices for 'texels'.
+void BuildBc7Mode6Block(const FloatTexels& texels, const Endpoints& endpoints,
+                        Quality quality, Bc7Mode6Block& block) {
+  for (int i = 0; i < 2; ++i) {
+    QuantizeWithPBit(endpoints[i], block.quantized[i], block.p_bits[i]);
+  }
+  const auto palette = GetBc7Mode6Palette(block.quantized, block.p_bits);
+  block.error = 0.0f;
+  for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+    if (quality == Quality::kFast) {
+      // Weights are nearly uniform, hence the projection is a good estimate.
+      const float t = Project<4>(texels[i], palette[0], palette[15]);
+      block.indices[i] = static_cast<int>(std::lround(t * 15.0f));
+      block.error += SquaredDistance<4>(texels[i], palette[block.indices[i]]);
+    } else {
+      block.indices[i] = FindClosestEntry<4>(texels[i], palette,
+                                             /*palette_size=*/16, block.error);
+    }
+  }
+}
+
+// Returns the mode 6 block that best encodes 'texels'.
+Bc7Mode6Block FindBc7Mode6Block(const FloatTexels& texels, Quality quality) {
+  Endpoints endpoints = FitEndpoints<4>(texels);
+  Bc7Mode6Block best_block;
+  BuildBc7Mode6Block(texels, endpoints, quality, best_block);
+  if (quality == Quality::kFast) {
+    return best_block;
+  }
+
+  Bc7Mode6Block block = best_block;
+  for (int iteration = 0; iteration < kNumRefinements; ++iteration) {
+    float weights[kNumTexelsPerBlock];
+    for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+      weights[i] = kBc7Weights4[block.indices[i]] / 64.0f;
+    }
+    if (!RefineEndpoints<4>(texels, weights, endpoints)) {
+      break;
+    }
+    BuildBc7Mode6Block(texels, endpoints, quality, block);
+    if (block.error < best_block.error) {
+      best_block = block;
+    }
+  }
+  return best_block;
+}
+
+// Writes 'block' in mode 6. The most significant bit of the index of the first
+// texel is implicitly 0, hence endpoints are swapped if necessary.
+void WriteBc7Mode6Block(Bc7Mode6Block block, uint8_t* output) {
+  if (block.indices[0] >= 8) {
+    std::swap(block.quantized[0], block.quantized[1]);
+    std::swap(block.p_bits[0], block.p_bits[1]);
+    for (int& index : block.indices) {
+      index = 15 - index;
+    }
+  }
+
+  std::memset(output, 0, GetBlockSize(Format::kBc7));
+  BitWriter writer{output};
+  writer.Write(1 << 6, /*num_bits=*/7);
+  for (int c = 0; c < 4; ++c) {
+    writer.Write(block.quantized[0][c], /*num_bits=*/7);
+    writer.Write(block.quantized[1][c], /*num_bits=*/7);
+  }
+  writer.Write(block.p_bits[0], /*num_bits=*/1);
+  writer.Write(block.p_bits[1], /*num_bits=*/1);
+  for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+    writer.Write(block.indices[i], /*num_bits=*/i == 0 ? 3 : 4);
+  }
+}
+
+// Expands a 7-bit value to 8 bits.
+int Expand7(int value) { return (value << 1) | (value >> 6); }
+
+// Returns the mode 5 block that best encodes 'texels'. Colors and alpha are
+// fitted separately, which suits blocks whose alpha is not correlated with
+// colors.
+Bc7Mode5Block FindBc7Mode5Block(const FloatTexels& texels) {
+  Bc7Mode5Block block{};
+  Endpoints endpoints = FitEndpoints<3>(texels);
+  for (int iteration = 0; iteration <= kNumRefinements; ++iteration) {
+    Bc7Mode5Block candidate{};
+    std::array<std::array<int, 3>, 4> palette;
+    for (int i = 0; i < 2; ++i) {
+      for (int c = 0; c < 3; ++c) {
+        candidate.color_quantized[i][c] = std::clamp(
+            static_cast<int>(std::lround(endpoints[i][c] * 127.0f / 255.0f)),
+            0, 127);
+      }
+    }
+    for (int i = 0; i < 4; ++i) {
+      for (int c = 0; c < 3; ++c) {
+        palette[i][c] = InterpolateBc7(
+            Expand7(candidate.color_quantized[0][c]),
+            Expand7(candidate.color_quantized[1][c]), kBc7Weights2[i]);
+      }
+    }
+    for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+      candidate.color_indices[i] = FindClosestEntry<3>(
+          texels[i], palette, /*palette_size=*/4, candidate.error);
+    }
+    if (iteration == 0 || candidate.error < block.error) {
+      block = candidate;
+    }
+
+    float weights[kNumTexelsPerBlock];
+    for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+      weights[i] = kBc7Weights2[candidate.color_indices[i]] / 64.0f;
+    }
+    if (!RefineEndpoints<3>(texels, weights, endpoints)) {
+      break;
+    }
+  }
+
+  float min_alpha = 255.0f, max_alpha = 0.0f;
+  for (const auto& texel : texels) {
+    min_alpha = std::min(min_alpha, texel[3]);
+    max_alpha = std::max(max_alpha, texel[3]);
+  }
+  block.alpha[0] = static_cast<int>(min_alpha);
+  block.alpha[1] = static_cast<int>(max_alpha);
+  for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+    float best_distance = std::numeric_limits<float>::max();
+    for (int j = 0; j < 4; ++j) {
+      const float diff = static_cast<float>(InterpolateBc7(
+          block.alpha[0], block.alpha[1], kBc7Weights2[j])) - texels[i][3];
+      if (diff * diff < best_distance) {
+        best_distance = diff * diff;
+        block.alpha_indices[i] = j;
+      }
+    }
+    block.error += best_distance;
+  }
+  return block;
+}
+
+// Writes 'block' in mode 5. The most significant bit of indices of the first
+// texel is implicitly 0, hence endpoints are swapped if necessary.
+void WriteBc7Mode5Block(Bc7Mode5Block block, uint8_t* output) {
+  if (block.color_indices[0] >= 2) {
+    std::swap(block.color_quantized[0], block.color_quantized[1]);
+    for (int& index : block.color_indices) {
+      index = 3 - index;
+    }
+  }
+  if (block.alpha_indices[0] >= 2) {
+    std::swap(block.alpha[0], block.alpha[1]);
+    for (int& index : block.alpha_indices) {
+      index = 3 - index;
+    }
+  }
+
+  std::memset(output, 0, GetBlockSize(Format::kBc7));
+  BitWriter writer{output};
+  writer.Write(1 << 5, /*num_bits=*/6);
+  writer.Write(/*rotation=*/0, /*num_bits=*/2);
+  for (int c = 0; c < 3; ++c) {
+    writer.Write(block.color_quantized[0][c], /*num_bits=*/7);
+    writer.Write(block.color_quantized[1][c], /*num_bits=*/7);
+  }
+  writer.Write(block.alpha[0], /*num_bits=*/8);
+  writer.Write(block.alpha[1], /*num_bits=*/8);
+  for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+    writer.Write(block.color_indices[i], /*num_bits=*/i == 0 ? 1 : 2);
+  }
+  for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+    writer.Write(block.alpha_indices[i], /*num_bits=*/i == 0 ? 1 : 2);
+  }
+}
+
+// Encodes RGBA 'texels' into a BC7 block. Mode 6 is always tried, and mode 5
+// is also tried for Quality::kHigh.
+void EncodeBc7Block(const uint8_t* texels, Quality quality, uint8_t* output) {
+  const FloatTexels float_texels =
+      ToFloatTexels(texels, image::kRgbaImageChannel, /*num_channels=*/4);
+  const Bc7Mode6Block mode6_block = FindBc7Mode6Block(float_texels, quality);
+  if (quality == Quality::kHigh) {
+    const Bc7Mode5Block mode5_block = FindBc7Mode5Block(float_texels);
+    if (mode5_block.error < mode6_block.error) {
+      WriteBc7Mode5Block(mode5_block, output);
+      return;
+    }
+  }
+  WriteBc7Mode6Block(mode6_block, output);
+}
+
+// Decodes a BC7 block in mode 5 or 6 into RGBA 'texels'.
+void DecodeBc7Block(const uint8_t* block, uint8_t* texels) {
+  BitReader reader{block};
+  int mode = 0;
+  while (mode < 8 && reader.Read(/*num_bits=*/1) == 0) {
+    ++mode;
+  }
+
+  switch (mode) {
+    case 5: {
+      const int rotation = static_cast<int>(reader.Read(/*num_bits=*/2));
+      int colors[2][3], alpha[2];
+      for (int c = 0; c < 3; ++c) {
+        colors[0][c] = Expand7(static_cast<int>(reader.Read(/*num_bits=*/7)));
+        colors[1][c] = Expand7(static_cast<int>(reader.Read(/*num_bits=*/7)));
+      }
+      alpha[0] = static_cast<int>(reader.Read(/*num_bits=*/8));
+      alpha[1] = static_cast<int>(reader.Read(/*num_bits=*/8));
+      int color_indices[kNumTexelsPerBlock], alpha_indices[kNumTexelsPerBlock];
+      for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+        color_indices[i] = static_cast<int>(reader.Read(i == 0 ? 1 : 2));
+      }
+      for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+        alpha_indices[i] = static_cast<int>(reader.Read(i == 0 ? 1 : 2));
+      }
+      for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+        uint8_t* texel = texels + i * image::kRgbaImageChannel;
+        for (int c = 0; c < 3; ++c) {
+          texel[c] = static_cast<uint8_t>(InterpolateBc7(
+              colors[0][c], colors[1][c], kBc7Weights2[color_indices[i]]));
+        }
+        texel[3] = static_cast<uint8_t>(InterpolateBc7(
+            alpha[0], alpha[1], kBc7Weights2[alpha_indices[i]]));
+        if (rotation != 0) {
+          std::swap(texel[3], texel[rotation - 1]);
+        }
+      }
+      return;
+    }
+
+    case 6: {
+      int quantized[2][4], p_bits[2];
+      for (int c = 0; c < 4; ++c) {
+        quantized[0][c] = static_cast<int>(reader.Read(/*num_bits=*/7));
+        quantized[1][c] = static_cast<int>(reader.Read(/*num_bits=*/7));
+      }
+      p_bits[0] = static_cast<int>(reader.Read(/*num_bits=*/1));
+      p_bits[1] = static_cast<int>(reader.Read(/*num_bits=*/1));
+      const auto palette = GetBc7Mode6Palette(quantized, p_bits);
+      for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+        const auto& color = palette[reader.Read(i == 0 ? 3 : 4)];
+        for (int c = 0; c < 4; ++c) {
+          texels[i * image::kRgbaImageChannel + c] =
+              static_cast<uint8_t>(color[c]);
+        }
+      }
+      return;
+    }
+
+    default:
+      FATAL(absl::StrFormat("Unsupported BC7 mode: %d", mode));
+  }
+}
+
+}  // namespace
+
+int GetBlockSize(Format format) {
+  switch (format) {
+    case Format::kBc1:
+    case Format::kBc4:
+      return 8;
+    case Format::kBc3:
+    case Format::kBc5:
+    case Format::kBc7:
+      return 16;
+  }
+  FATAL("Unrecognized format");
+}
+
+int GetNumChannels(Format format) {
+  return format == Format::kBc4 ? image::kBwImageChannel
+                                : image::kRgbaImageChannel;
+}
+
+size_t GetEncodedSize(Format format, int width, int height) {
+  const size_t num_blocks_x = (width + kBlockDim - 1) / kBlockDim;
+  const size_t num_blocks_y = (height + kBlockDim - 1) / kBlockDim;
+  return num_blocks_x * num_blocks_y * GetBlockSize(format);
+}
+
+void EncodeBlock(Format format, Quality quality, const uint8_t* texels,
+                 uint8_t* block) {
+  constexpr int kRgba = image::kRgbaImageChannel;
+  switch (format) {
+    case Format::kBc1:
+      EncodeColorBlock(ToFloatTexels(texels, kRgba, /*num_channels=*/3),
+                       quality, block);
+      return;
+
+    case Format::kBc3:
+      EncodeChannel(texels, kRgba, /*c=*/3, quality, block);
+      EncodeColorBlock(ToFloatTexels(texels, kRgba, /*num_channels=*/3),
+                       quality, block + 8);
+      return;
+
+    case Format::kBc4:
+      EncodeChannel(texels, image::kBwImageChannel, /*c=*/0, quality, block);
+      return;
+
+    case Format::kBc5:
+      EncodeChannel(texels, kRgba, /*c=*/0, quality, block);
+      EncodeChannel(texels, kRgba, /*c=*/1, quality, block + 8);
+      return;
+
+    case Format::kBc7:
+      EncodeBc7Block(texels, quality, block);
+      return;
+  }
+  FATAL("Unrecognized format");
+}
+
+void DecodeBlock(Format format, const uint8_t* block, uint8_t* texels) {
+  constexpr int kRgba = image::kRgbaImageChannel;
+  switch (format) {
+    case Format::kBc1:
+      DecodeColorBlock(block, /*allow_three_color_mode=*/true, kRgba, texels);
+      for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+        texels[i * kRgba + 3] = 255;
+      }
+      return;
+
+    case Format::kBc3:
+      DecodeChannel(block, kRgba, /*c=*/3, texels);
+      DecodeColorBlock(block + 8, /*allow_three_color_mode=*/false, kRgba,
+                       texels);
+      return;
+
+    case Format::kBc4:
+      DecodeChannel(block, image::kBwImageChannel, /*c=*/0, texels);
+      return;
+
+    case Format::kBc5:
+      DecodeChannel(block, kRgba, /*c=*/0, texels);
+      DecodeChannel(block + 8, kRgba, /*c=*/1, texels);
+      for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+        texels[i * kRgba + 2] = 0;
+        texels[i * kRgba + 3] = 255;
+      }
+      return;
+
+    case Format::kBc7:
+      DecodeBc7Block(block, texels);
+      return;
+  }
+  FATAL("Unrecognized format");
+}
+
+void Encode(Format format, Quality quality, int width, int height,
+            const uint8_t* src, uint8_t* dst) {
+  const int channel = GetNumChannels(format);
+  const int block_size = GetBlockSize(format);
+  const int num_blocks_x = (width + kBlockDim - 1) / kBlockDim;
+  const int num_blocks_y = (height + kBlockDim - 1) / kBlockDim;
+
+  // Rows of blocks are split into tasks.
+  const int max_num_tasks = std::max(num_blocks_x * num_blocks_y /
+                                     kMinBlocksPerTask, 1);
+  const int num_tasks = std::min({max_num_tasks, num_blocks_y,
+                                  util::GetNumHardwareThreads()});
+  const int rows_per_task = (num_blocks_y + num_tasks - 1) / num_tasks;
+  util::ParallelFor(num_tasks, [&](int task) {
+    const int begin = task * rows_per_task;
+    const int end = std::min(begin + rows_per_task, num_blocks_y);
+    uint8_t texels[kNumTexelsPerBlock * image::kRgbaImageChannel];
+    for (int block_y = begin; block_y < end; ++block_y) {
+      for (int block_x = 0; block_x < num_blocks_x; ++block_x) {
+        // Texels outside the image are clamped to the edge.
+        for (int y = 0; y < kBlockDim; ++y) {
+          const int src_y = std::min(block_y * kBlockDim + y, height - 1);
+          for (int x = 0; x < kBlockDim; ++x) {
+            const int src_x = std::min(block_x * kBlockDim + x, width - 1);
+            std::memcpy(texels + (y * kBlockDim + x) * channel,
+                        src + (static_cast<size_t>(src_y) * width + src_x) *
+                                  channel,
+                        channel);
+          }
+        }
+        EncodeBlock(format, quality, texels,
+                    dst + (static_cast<size_t>(block_y) * num_blocks_x +
+                           block_x) * block_size);
+      }
+    }
+  });
+}
+
+void Decode(Format format, int width, int height, const uint8_t* src,
+            uint8_t* dst) {
+  const int channel = GetNumChannels(format);
+  const int block_size = GetBlockSize(format);
+  const int num_blocks_x = (width + kBlockDim - 1) / kBlockDim;
+  const int num_blocks_y = (height + kBlockDim - 1) / kBlockDim;
+  uint8_t texels[kNumTexelsPerBlock * image::kRgbaImageChannel];
+  for (int block_y = 0; block_y < num_blocks_y; ++block_y) {
+    for (int block_x = 0; block_x < num_blocks_x; ++block_x) {
+      DecodeBlock(format,
+                  src + (static_cast<size_t>(block_y) * num_blocks_x +
+                         block_x) * block_size,
+                  texels);
+      for (int y = 0; y < kBlockDim; ++y) {
+        const int dst_y = block_y * kBlockDim + y;
+        const int num_texels = std::min(kBlockDim,
+                                        width - block_x * kBlockDim);
+        if (dst_y >= height) {
+          break;
+        }
+        std::memcpy(dst + (static_cast<size_t>(dst_y) * width +
+                           block_x * kBlockDim) * channel,
+                    texels + y * kBlockDim * channel, num_texels * channel);
+      }
+    }
+  }
+}
+
+}  // namespace lighter::common::block_compression
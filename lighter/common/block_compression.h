@@ -0,0 +1,72 @@
+//
+//  block_compression.h
+//
+//  Created by Pujun Lun on 6/24/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#ifndef LIGHTER_COMMON_BLOCK_COMPRESSION_H
+#define LIGHTER_COMMON_BLOCK_COMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace lighter::common::block_compression {
+
+// Block-compressed formats that GPUs can sample directly. Each format encodes
+// 4x4 texels into one block of fixed size:
+//   - kBc1: RGB, 8 bytes per block. Alpha is ignored.
+//   - kBc3: RGBA, 16 bytes per block. Alpha is encoded like kBc4.
+//   - kBc4: single channel, 8 bytes per block.
+//   - kBc5: two channels (red and green), 16 bytes per block. Suitable for
+//           tangent space normal maps.
+//   - kBc7: RGBA, 16 bytes per block. Higher quality than kBc1 and kBc3.
+enum class Format { kBc1, kBc3, kBc4, kBc5, kBc7 };
+
+// kFast fits endpoints along the principal axis of texels and picks indices by
+// projection. kHigh also refines endpoints with least squares, picks indices by
+// exhaustive search, and tries more encoding modes where available.
+enum class Quality { kFast, kHigh };
+
+// Width and height of each block in texels.
+constexpr int kBlockDim = 4;
+
+// Number of texels in each block.
+constexpr int kNumTexelsPerBlock = kBlockDim * kBlockDim;
+
+// Returns the size of each block of 'format' in bytes.
+int GetBlockSize(Format format);
+
+// Returns the number of channels of uncompressed texels that 'format' encodes
+// from and decodes to. This is 1 for kBc4 and 4 for others. kBc5 only reads the
+// first two channels, and kBc1 ignores the last one.
+int GetNumChannels(Format format);
+
+// Returns the size of an image of 'width' x 'height' texels encoded in
+// 'format'. Partial blocks at edges occupy full blocks.
+size_t GetEncodedSize(Format format, int width, int height);
+
+// Encodes 'texels', which are 4x4 texels with GetNumChannels('format')
+// channels stored row by row, into one 'block'.
+void EncodeBlock(Format format, Quality quality, const uint8_t* texels,
+                 uint8_t* block);
+
+// Decodes one 'block' into 4x4 'texels' with GetNumChannels('format')
+// channels. Channels that are not encoded are set to 0, except that alpha is
+// set to 255. For kBc7, only modes produced by EncodeBlock() are supported.
+void DecodeBlock(Format format, const uint8_t* block, uint8_t* texels);
+
+// Encodes an image of 'width' x 'height' texels with GetNumChannels('format')
+// channels into 'dst', which must have GetEncodedSize() bytes. Texels outside
+// the image are clamped to the edge. Blocks are encoded in parallel.
+void Encode(Format format, Quality quality, int width, int height,
+            const uint8_t* src, uint8_t* dst);
+
+// Decodes 'src' encoded by Encode() into 'dst'. This is mainly used for
+// measuring the quality of encoding.
+void Decode(Format format, int width, int height, const uint8_t* src,
+            uint8_t* dst);
+
+}  // namespace lighter::common::block_compression
+
+#endif  // LIGHTER_COMMON_BLOCK_COMPRESSION_H
@@ -0,0 +1,165 @@
+//
+//  block_compression_benchmark.cc
+//
+//  Created by Pujun Lun on 6/24/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "lighter/common/block_compression.h"
+#include "lighter/common/image.h"
+#include "third_party/absl/flags/flag.h"
+#include "third_party/absl/flags/parse.h"
+#include "third_party/absl/strings/str_cat.h"
+#include "third_party/benchmark/benchmark.h"
+
+ABSL_FLAG(std::string, image_path, "",
+          "Path to the image to encode. If empty, a synthetic image is used");
+ABSL_FLAG(int, image_size, 1024, "Width and height of the synthetic image");
+
+namespace lighter::common::block_compression {
+namespace {
+
+// Uncompressed image in both RGBA and single-channel forms.
+struct SourceImage {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> rgba_pixels = {};
+  std::vector<uint8_t> bw_pixels = {};
+
+  const std::vector<uint8_t>& GetPixels(Format format) const {
+    return GetNumChannels(format) == image::kBwImageChannel ? bw_pixels
+                                                            : rgba_pixels;
+  }
+};
+
+// Creates a smooth image with some noise, which resembles natural textures.
+SourceImage CreateSyntheticImage(int size) {
+  SourceImage image{size, size};
+  std::mt19937 rand_gen{/*seed=*/0};
+  std::uniform_int_distribution<int> noise{-6, 6};
+  for (int y = 0; y < size; ++y) {
+    for (int x = 0; x < size; ++x) {
+      const double wave = std::sin(0.05 * x) * std::cos(0.03 * y);
+      const int values[]{
+          static_cast<int>(128.0 + 100.0 * wave),
+          static_cast<int>(100.0 + 80.0 * wave * wave),
+          static_cast<int>(60.0 + 50.0 * std::sin(0.02 * x + 0.01 * y)),
+          255,
+      };
+      for (int c = 0; c < image::kRgbaImageChannel; ++c) {
+        const int value = c == 3 ? values[c] : values[c] + noise(rand_gen);
+        image.rgba_pixels.push_back(
+            static_cast<uint8_t>(std::clamp(value, 0, 255)));
+      }
+      image.bw_pixels.push_back(image.rgba_pixels[image.rgba_pixels.size() -
+                                                  image::kRgbaImageChannel]);
+    }
+  }
+  return image;
+}
+
+// Loads the image at 'path', and extracts the red channel as the
+// single-channel image.
+SourceImage LoadImage(const std::string& path) {
+  const Image image{path};
+  SourceImage source{image.width(), image.height()};
+  const auto* pixels = static_cast<const uint8_t*>(image.data_ptrs()[0]);
+  const int num_pixels = image.width() * image.height();
+  if (image.channel() == image::kRgbaImageChannel) {
+    source.rgba_pixels.assign(pixels, pixels + num_pixels * image.channel());
+    for (int i = 0; i < num_pixels; ++i) {
+      source.bw_pixels.push_back(pixels[i * image::kRgbaImageChannel]);
+    }
+  } else {
+    source.bw_pixels.assign(pixels, pixels + num_pixels);
+    for (int i = 0; i < num_pixels; ++i) {
+      source.rgba_pixels.insert(source.rgba_pixels.end(),
+                                {pixels[i], pixels[i], pixels[i], 255});
+    }
+  }
+  return source;
+}
+
+// Returns the peak signal-to-noise ratio of 'decoded' against 'original' in
+// channels that 'format' encodes.
+double ComputePsnr(Format format, const std::vector<uint8_t>& original,
+                   const std::vector<uint8_t>& decoded) {
+  const int channel = GetNumChannels(format);
+  const int num_encoded_channels =
+      format == Format::kBc1 ? 3 : (format == Format::kBc5 ? 2 : channel);
+  double squared_error = 0.0;
+  size_t count = 0;
+  for (size_t i = 0; i < original.size(); i += channel) {
+    for (int c = 0; c < num_encoded_channels; ++c) {
+      const double diff = static_cast<double>(original[i + c]) - decoded[i + c];
+      squared_error += diff * diff;
+      ++count;
+    }
+  }
+  return squared_error == 0.0
+             ? INFINITY
+             : 10.0 * std::log10(255.0 * 255.0 * count / squared_error);
+}
+
+void BM_Encode(benchmark::State& state, const SourceImage* image,
+               Format format, Quality quality) {
+  const std::vector<uint8_t>& pixels = image->GetPixels(format);
+  std::vector<uint8_t> encoded(GetEncodedSize(format, image->width,
+                                              image->height));
+  for (auto _ : state) {
+    Encode(format, quality, image->width, image->height, pixels.data(),
+           encoded.data());
+    benchmark::DoNotOptimize(encoded.data());
+  }
+
+  std::vector<uint8_t> decoded(pixels.size());
+  Decode(format, image->width, image->height, encoded.data(), decoded.data());
+  const double num_megapixels = image->width * image->height / 1e6;
+  state.counters["MP/s"] = benchmark::Counter(
+      num_megapixels * state.iterations(), benchmark::Counter::kIsRate);
+  state.counters["PSNR"] = ComputePsnr(format, pixels, decoded);
+}
+
+}  // namespace
+}  // namespace lighter::common::block_compression
+
+int main(int argc, char* argv[]) {
+  using namespace lighter::common::block_compression;
+
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+
+  const std::string image_path = absl::GetFlag(FLAGS_image_path);
+  const SourceImage image =
+      image_path.empty() ? CreateSyntheticImage(absl::GetFlag(FLAGS_image_size))
+                         : LoadImage(image_path);
+  const struct {
+    const char* name;
+    Format format;
+  } formats[]{
+      {"BC1", Format::kBc1},
+      {"BC3", Format::kBc3},
+      {"BC4", Format::kBc4},
+      {"BC5", Format::kBc5},
+      {"BC7", Format::kBc7},
+  };
+  for (const auto& [name, format] : formats) {
+    for (const Quality quality : {Quality::kFast, Quality::kHigh}) {
+      benchmark::RegisterBenchmark(
+          absl::StrCat("BM_Encode/", name,
+                       quality == Quality::kFast ? "/Fast" : "/High").c_str(),
+          BM_Encode, &image, format, quality)
+          ->Unit(benchmark::kMillisecond)
+          ->UseRealTime();
+    }
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
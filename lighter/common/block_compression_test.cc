@@ -0,0 +1,152 @@
+//
+//  block_compression_test.cc
+//
+//  Created by Pujun Lun on 6/24/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/block_compression.h"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#ifdef ASSERT_TRUE
+#undef ASSERT_TRUE
+#endif
+#ifdef ASSERT_FALSE
+#undef ASSERT_FALSE
+#endif
+#include "third_party/gtest/gtest.h"
+
+namespace lighter::common::block_compression {
+namespace {
+
+constexpr Format kFormats[]{Format::kBc1, Format::kBc3, Format::kBc4,
+                            Format::kBc5, Format::kBc7};
+constexpr Quality kQualities[]{Quality::kFast, Quality::kHigh};
+
+// Returns the peak signal-to-noise ratio of 'decoded' against 'original',
+// measured in channels that 'format' encodes.
+double ComputePsnr(Format format, const std::vector<uint8_t>& original,
+                   const std::vector<uint8_t>& decoded) {
+  const int channel = GetNumChannels(format);
+  const int num_encoded_channels =
+      format == Format::kBc1 ? 3 : (format == Format::kBc5 ? 2 : channel);
+  double squared_error = 0.0;
+  size_t count = 0;
+  for (size_t i = 0; i < original.size(); i += channel) {
+    for (int c = 0; c < num_encoded_channels; ++c) {
+      const double diff = static_cast<double>(original[i + c]) - decoded[i + c];
+      squared_error += diff * diff;
+      ++count;
+    }
+  }
+  if (squared_error == 0.0) {
+    return INFINITY;
+  }
+  return 10.0 * std::log10(255.0 * 255.0 * count / squared_error);
+}
+
+// Returns a smooth image with some noise, which resembles natural textures.
+// Channels are correlated, as they usually are in practice.
+std::vector<uint8_t> CreateTestImage(int width, int height, int channel) {
+  std::mt19937 rand_gen{/*seed=*/0};
+  std::uniform_int_distribution<int> noise{-8, 8};
+  std::vector<uint8_t> pixels;
+  pixels.reserve(width * height * channel);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      const double wave = std::sin(0.1 * x) * std::cos(0.07 * y);
+      for (int c = 0; c < channel; ++c) {
+        const int value = static_cast<int>(128.0 + (100.0 - 20.0 * c) * wave) +
+                          noise(rand_gen);
+        pixels.push_back(static_cast<uint8_t>(std::clamp(value, 0, 255)));
+      }
+    }
+  }
+  return pixels;
+}
+
+// Encodes and decodes 'pixels', and returns the decoded image.
+std::vector<uint8_t> RoundTrip(Format format, Quality quality, int width,
+                               int height, const std::vector<uint8_t>& pixels) {
+  std::vector<uint8_t> encoded(GetEncodedSize(format, width, height));
+  Encode(format, quality, width, height, pixels.data(), encoded.data());
+  std::vector<uint8_t> decoded(pixels.size());
+  Decode(format, width, height, encoded.data(), decoded.data());
+  return decoded;
+}
+
+TEST(BlockCompressionTest, EncodedSize) {
+  EXPECT_EQ(GetEncodedSize(Format::kBc1, 4, 4), 8);
+  EXPECT_EQ(GetEncodedSize(Format::kBc4, 5, 3), 16);
+  EXPECT_EQ(GetEncodedSize(Format::kBc7, 1, 1), 16);
+  EXPECT_EQ(GetEncodedSize(Format::kBc3, 1024, 512), 256 * 128 * 16);
+}
+
+TEST(BlockCompressionTest, SolidBlocksAreAccurate) {
+  std::mt19937 rand_gen{/*seed=*/0};
+  std::uniform_int_distribution<int> dist{0, 255};
+  for (const auto format : kFormats) {
+    const int channel = GetNumChannels(format);
+    for (int trial = 0; trial < 64; ++trial) {
+      std::vector<uint8_t> texel(channel);
+      for (auto& value : texel) {
+        value = static_cast<uint8_t>(dist(rand_gen));
+      }
+      std::vector<uint8_t> pixels;
+      for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+        pixels.insert(pixels.end(), texel.begin(), texel.end());
+      }
+      for (const auto quality : kQualities) {
+        const auto decoded = RoundTrip(format, quality, kBlockDim, kBlockDim,
+                                       pixels);
+        // BC4 and BC5 represent solid values exactly. BC1 may lose a bit due
+        // to interpolation of 5-bit and 6-bit endpoints.
+        const int tolerance = format == Format::kBc4 ||
+                              format == Format::kBc5 ? 0 : 3;
+        const int num_encoded_channels = format == Format::kBc1 ? 3 :
+            (format == Format::kBc5 ? 2 : channel);
+        for (int i = 0; i < kNumTexelsPerBlock; ++i) {
+          for (int c = 0; c < num_encoded_channels; ++c) {
+            ASSERT_NEAR(decoded[i * channel + c], texel[c], tolerance)
+                << "Format " << static_cast<int>(format) << " channel " << c;
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(BlockCompressionTest, QualityOfSmoothImages) {
+  constexpr int kWidth = 64, kHeight = 48;
+  for (const auto format : kFormats) {
+    const auto pixels = CreateTestImage(kWidth, kHeight,
+                                        GetNumChannels(format));
+    const double fast_psnr = ComputePsnr(
+        format, pixels,
+        RoundTrip(format, Quality::kFast, kWidth, kHeight, pixels));
+    const double high_psnr = ComputePsnr(
+        format, pixels,
+        RoundTrip(format, Quality::kHigh, kWidth, kHeight, pixels));
+    EXPECT_GT(fast_psnr, 30.0) << "Format " << static_cast<int>(format);
+    EXPECT_GE(high_psnr, fast_psnr) << "Format " << static_cast<int>(format);
+  }
+}
+
+TEST(BlockCompressionTest, PartialBlocks) {
+  constexpr int kWidth = 6, kHeight = 3;
+  for (const auto format : kFormats) {
+    const auto pixels = CreateTestImage(kWidth, kHeight,
+                                        GetNumChannels(format));
+    const auto decoded = RoundTrip(format, Quality::kHigh, kWidth, kHeight,
+                                   pixels);
+    EXPECT_GT(ComputePsnr(format, pixels, decoded), 30.0)
+        << "Format " << static_cast<int>(format);
+  }
+}
+
+}  // namespace
+}  // namespace lighter::common::block_compression
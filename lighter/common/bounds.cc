@@ -0,0 +1,114 @@
+//
+//  bounds.cc
+//
+//  Created by Pujun Lun on 6/20/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/bounds.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace lighter::common {
+
+Aabb Aabb::FromPoints(absl::Span<const glm::vec3> points) {
+  Aabb aabb = Empty();
+  for (const glm::vec3& point : points) {
+    aabb.Expand(point);
+  }
+  return aabb;
+}
+
+Aabb Aabb::Transform(const glm::mat4& transform) const {
+  if (IsEmpty()) {
+    return Empty();
+  }
+
+  // Transform the center and extent separately (Arvo, "Transforming
+  // Axis-Aligned Bounding Boxes"), which avoids transforming all 8 corners.
+  const glm::vec3 center_transformed{transform * glm::vec4{center(), 1.0f}};
+  const glm::vec3 half_extent = extent() * 0.5f;
+  glm::vec3 half_extent_transformed{0.0f};
+  for (int col = 0; col < 3; ++col) {
+    half_extent_transformed +=
+        glm::abs(glm::vec3{transform[col]}) * half_extent[col];
+  }
+  return Aabb{center_transformed - half_extent_transformed,
+              center_transformed + half_extent_transformed};
+}
+
+std::optional<float> IntersectRay(const Ray& ray, const Aabb& aabb,
+                                  float max_distance) {
+  // Slab test. Division by zero yields infinities, which are handled correctly
+  // unless the origin lies exactly on a slab boundary.
+  const glm::vec3 inv_direction = 1.0f / ray.direction;
+  const glm::vec3 t0 = (aabb.min - ray.origin) * inv_direction;
+  const glm::vec3 t1 = (aabb.max - ray.origin) * inv_direction;
+  const glm::vec3 t_near = glm::min(t0, t1);
+  const glm::vec3 t_far = glm::max(t0, t1);
+  const float t_enter = std::max({t_near.x, t_near.y, t_near.z, 0.0f});
+  const float t_exit = std::min({t_far.x, t_far.y, t_far.z, max_distance});
+  if (t_enter > t_exit) {
+    return std::nullopt;
+  }
+  return t_enter;
+}
+
+std::optional<float> IntersectRay(const Ray& ray, const glm::vec3& center,
+                                  float radius, float max_distance) {
+  // Solve |origin + t * direction - center|^2 = radius^2 for 't'.
+  const glm::vec3 offset = ray.origin - center;
+  const float a = glm::dot(ray.direction, ray.direction);
+  const float half_b = glm::dot(offset, ray.direction);
+  const float c = glm::dot(offset, offset) - radius * radius;
+  if (c <= 0.0f) {
+    return 0.0f;
+  }
+  const float discriminant = half_b * half_b - a * c;
+  if (half_b > 0.0f || discriminant < 0.0f) {
+    return std::nullopt;
+  }
+  const float distance = (-half_b - std::sqrt(discriminant)) / a;
+  if (distance > max_distance) {
+    return std::nullopt;
+  }
+  return distance;
+}
+
+FrustumPlanes ExtractFrustumPlanes(const glm::mat4& transform,
+                                   bool is_depth_zero_to_one) {
+  // Note that glm matrices are column-major.
+  std::array<glm::vec4, 4> rows;
+  for (int row = 0; row < 4; ++row) {
+    rows[row] = glm::vec4{transform[0][row], transform[1][row],
+                          transform[2][row], transform[3][row]};
+  }
+  FrustumPlanes planes{
+      rows[3] + rows[0], rows[3] - rows[0],  // Left and right.
+      rows[3] + rows[1], rows[3] - rows[1],  // Bottom and top.
+      is_depth_zero_to_one ? rows[2] : rows[3] + rows[2],  // Near.
+      rows[3] - rows[2],                                     // Far.
+  };
+  for (glm::vec4& plane : planes) {
+    plane /= glm::length(glm::vec3{plane});
+  }
+  return planes;
+}
+
+bool IsOutsideFrustum(const FrustumPlanes& planes, const Aabb& aabb) {
+  const glm::vec3 center = aabb.center();
+  const glm::vec3 half_extent = aabb.extent() * 0.5f;
+  for (const glm::vec4& plane : planes) {
+    // Distance from the center to the plane, and the projected radius of the
+    // box onto the plane normal.
+    const float distance = glm::dot(glm::vec3{plane}, center) + plane.w;
+    const float radius = glm::dot(glm::abs(glm::vec3{plane}), half_extent);
+    if (distance < -radius) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace lighter::common
@@ -0,0 +1,124 @@
+//
+//  bounds.h
+//
+//  Created by Pujun Lun on 6/20/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#ifndef LIGHTER_COMMON_BOUNDS_H
+#define LIGHTER_COMMON_BOUNDS_H
+
+#include <array>
+#include <limits>
+#include <optional>
+
+#include "third_party/absl/types/span.h"
+#include "third_party/glm/glm.hpp"
+
+namespace lighter::common {
+
+// Axis-aligned bounding box. A box is empty if any component of 'min' is
+// greater than that of 'max'.
+struct Aabb {
+  // Returns an empty box, which can be expanded to contain points or boxes.
+  static Aabb Empty() {
+    constexpr float kMax = std::numeric_limits<float>::max();
+    return Aabb{glm::vec3{kMax}, glm::vec3{-kMax}};
+  }
+
+  // Returns the box that tightly contains 'points'.
+  static Aabb FromPoints(absl::Span<const glm::vec3> points);
+
+  // Returns the box that tightly contains 'pos' of 'vertices'.
+  template <typename VertexType>
+  static Aabb FromVertices(absl::Span<const VertexType> vertices) {
+    Aabb aabb = Empty();
+    for (const auto& vertex : vertices) {
+      aabb.Expand(vertex.pos);
+    }
+    return aabb;
+  }
+
+  // Returns the box that tightly contains the sphere.
+  static Aabb FromSphere(const glm::vec3& center, float radius) {
+    return Aabb{center - radius, center + radius};
+  }
+
+  // Expands the box to contain 'point' or 'other'.
+  void Expand(const glm::vec3& point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+  void Expand(const Aabb& other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+  }
+
+  // Returns the box that contains this box transformed by 'transform', which
+  // should be an affine transformation.
+  Aabb Transform(const glm::mat4& transform) const;
+
+  bool IsEmpty() const {
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+  }
+
+  // Returns the surface area, which is used by the surface area heuristic.
+  float SurfaceArea() const {
+    const glm::vec3 extent = max - min;
+    return 2.0f * (extent.x * extent.y + extent.y * extent.z +
+                   extent.z * extent.x);
+  }
+
+  glm::vec3 center() const { return (min + max) * 0.5f; }
+  glm::vec3 extent() const { return max - min; }
+
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+// Ray starting from 'origin'. 'direction' need not be normalized, and distances
+// along the ray are measured in the length of 'direction'.
+struct Ray {
+  glm::vec3 AtDistance(float distance) const {
+    return origin + direction * distance;
+  }
+
+  glm::vec3 origin;
+  glm::vec3 direction;
+};
+
+// Returns the distance along 'ray' at which it enters 'aabb', or zero if the
+// origin is inside of it. Returns std::nullopt if 'ray' misses 'aabb' or the
+// distance is greater than 'max_distance'.
+std::optional<float> IntersectRay(const Ray& ray, const Aabb& aabb,
+                                  float max_distance);
+
+// Returns the distance along 'ray' at which it enters the sphere. Other than
+// that, this is the same as the function above.
+std::optional<float> IntersectRay(const Ray& ray, const glm::vec3& center,
+                                  float radius, float max_distance);
+
+// Frustum planes. A point 'p' is inside the frustum if dot(plane, vec4(p, 1))
+// >= 0 for all planes. Planes are normalized so that dot products give signed
+// distances. They are ordered as left, right, bottom, top, near and far.
+using FrustumPlanes = std::array<glm::vec4, 6>;
+
+// Extracts frustum planes from 'transform', which is usually the product of
+// projection, view and model matrices (Gribb and Hartmann, "Fast Extraction of
+// Viewing Frustum Planes from the World-View-Projection Matrix"). Planes are in
+// the space that 'transform' transforms from. 'is_depth_zero_to_one' should
+// match the depth range of the projection matrix. If it is false while the
+// depth range is actually [0, 1], the near plane is behind the real one, which
+// is still conservative. Camera::GetFrustumPlanes() should be preferred
+// since it knows the depth range.
+FrustumPlanes ExtractFrustumPlanes(const glm::mat4& transform,
+                                   bool is_depth_zero_to_one = false);
+
+// Returns whether 'aabb' is completely outside of any plane of the frustum.
+// This is conservative, i.e. boxes that are near corners of the frustum may be
+// considered intersecting even if they are actually outside.
+bool IsOutsideFrustum(const FrustumPlanes& planes, const Aabb& aabb);
+
+}  // namespace lighter::common
+
+#endif  // LIGHTER_COMMON_BOUNDS_H
@@ -0,0 +1,352 @@
+//
+//  bvh.cc
+//
+//  Created by Pujun Lun on 6/20/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/bvh.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+#include "lighter/common/util.h"
+#include "third_party/absl/strings/str_format.h"
+
+namespace lighter::common {
+namespace {
+
+// Result of testing a box against frustum planes.
+enum class FrustumTestResult { kOutside, kIntersecting, kInside };
+
+// Returns the spatial relationship between 'aabb' and the frustum.
+FrustumTestResult TestFrustum(const FrustumPlanes& planes, const Aabb& aabb) {
+  const glm::vec3 center = aabb.center();
+  const glm::vec3 half_extent = aabb.extent() * 0.5f;
+  auto result = FrustumTestResult::kInside;
+  for (const glm::vec4& plane : planes) {
+    const float distance = glm::dot(glm::vec3{plane}, center) + plane.w;
+    const float radius = glm::dot(glm::abs(glm::vec3{plane}), half_extent);
+    if (distance < -radius) {
+      return FrustumTestResult::kOutside;
+    }
+    if (distance < radius) {
+      result = FrustumTestResult::kIntersecting;
+    }
+  }
+  return result;
+}
+
+// Returns whether 'aabb' overlaps with the sphere.
+bool OverlapsSphere(const Aabb& aabb, const glm::vec3& center, float radius) {
+  const glm::vec3 closest = glm::clamp(center, aabb.min, aabb.max);
+  const glm::vec3 offset = closest - center;
+  return glm::dot(offset, offset) <= radius * radius;
+}
+
+}  // namespace
+
+Bvh::Bvh(absl::Span<const Aabb> bounds, const Options& options)
+    : object_bounds_{bounds.begin(), bounds.end()},
+      object_indices_(bounds.size()) {
+  ASSERT_TRUE(options.max_leaf_size > 0 && options.num_buckets > 1,
+              absl::StrFormat("Invalid options: max_leaf_size=%d, "
+                              "num_buckets=%d",
+                              options.max_leaf_size, options.num_buckets));
+  std::iota(object_indices_.begin(), object_indices_.end(), 0);
+  if (object_bounds_.empty()) {
+    return;
+  }
+
+  std::vector<glm::vec3> centroids;
+  centroids.reserve(object_bounds_.size());
+  for (const Aabb& aabb : object_bounds_) {
+    centroids.push_back(aabb.center());
+  }
+  nodes_.reserve(object_bounds_.size() * 2 - 1);
+  BuildNode(options, centroids, /*begin=*/0, /*end=*/num_objects());
+}
+
+int Bvh::BuildNode(const Options& options,
+                   absl::Span<const glm::vec3> centroids, int begin, int end) {
+  const int node_index = nodes_.size();
+  const int num_objects = end - begin;
+  Aabb node_bounds = Aabb::Empty();
+  Aabb centroid_bounds = Aabb::Empty();
+  for (int i = begin; i < end; ++i) {
+    node_bounds.Expand(object_bounds_[object_indices_[i]]);
+    centroid_bounds.Expand(centroids[object_indices_[i]]);
+  }
+  nodes_.push_back(Node{node_bounds, /*first_object=*/begin, num_objects,
+                        Node::kNoChild});
+  if (num_objects <= options.max_leaf_size) {
+    return node_index;
+  }
+
+  // Find the split with the lowest SAH cost. Objects are assigned to buckets
+  // by their centroids, and we only consider splitting between buckets.
+  struct Bucket {
+    Aabb bounds = Aabb::Empty();
+    int num_objects = 0;
+  };
+  std::vector<Bucket> buckets(options.num_buckets);
+  std::vector<float> right_costs(options.num_buckets);
+  const glm::vec3 centroid_extent = centroid_bounds.extent();
+  const auto get_bucket = [&](int axis, int object_index) {
+    const float offset =
+        (centroids[object_index][axis] - centroid_bounds.min[axis]) /
+        centroid_extent[axis];
+    return std::min(static_cast<int>(offset * options.num_buckets),
+                    options.num_buckets - 1);
+  };
+
+  float best_cost = std::numeric_limits<float>::max();
+  int best_axis = -1;
+  int best_bucket = -1;
+  for (int axis = 0; axis < 3; ++axis) {
+    if (centroid_extent[axis] <= 0.0f) {
+      continue;
+    }
+
+    std::fill(buckets.begin(), buckets.end(), Bucket{});
+    for (int i = begin; i < end; ++i) {
+      Bucket& bucket = buckets[get_bucket(axis, object_indices_[i])];
+      bucket.bounds.Expand(object_bounds_[object_indices_[i]]);
+      ++bucket.num_objects;
+    }
+
+    // 'right_costs[b]' is the cost of the right side if splitting before
+    // bucket 'b'.
+    Aabb right_bounds = Aabb::Empty();
+    int right_count = 0;
+    for (int b = options.num_buckets - 1; b > 0; --b) {
+      right_bounds.Expand(buckets[b].bounds);
+      right_count += buckets[b].num_objects;
+      right_costs[b] =
+          right_count > 0 ? right_count * right_bounds.SurfaceArea() : 0.0f;
+    }
+
+    Aabb left_bounds = Aabb::Empty();
+    int left_count = 0;
+    for (int b = 0; b < options.num_buckets - 1; ++b) {
+      left_bounds.Expand(buckets[b].bounds);
+      left_count += buckets[b].num_objects;
+      if (left_count == 0 || left_count == num_objects) {
+        continue;
+      }
+      const float cost =
+          left_count * left_bounds.SurfaceArea() + right_costs[b + 1];
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_axis = axis;
+        best_bucket = b;
+      }
+    }
+  }
+
+  int mid;
+  if (best_axis == -1) {
+    // All centroids coincide, hence we can only split objects arbitrarily.
+    mid = begin + num_objects / 2;
+  } else {
+    mid = std::partition(
+        object_indices_.begin() + begin, object_indices_.begin() + end,
+        [&](int object_index) {
+          return get_bucket(best_axis, object_index) <= best_bucket;
+        }) - object_indices_.begin();
+  }
+
+  BuildNode(options, centroids, begin, mid);
+  const int right_child = BuildNode(options, centroids, mid, end);
+  nodes_[node_index].right_child = right_child;
+  return node_index;
+}
+
+void Bvh::Refit(absl::Span<const Aabb> bounds) {
+  ASSERT_TRUE(bounds.size() == object_bounds_.size(),
+              absl::StrFormat("Number of bounds mismatch (%d vs %d)",
+                              bounds.size(), object_bounds_.size()));
+  std::copy(bounds.begin(), bounds.end(), object_bounds_.begin());
+
+  // Children always come after parents, hence we can update nodes in reverse.
+  for (int i = static_cast<int>(nodes_.size()) - 1; i >= 0; --i) {
+    Node& node = nodes_[i];
+    if (node.is_leaf()) {
+      node.bounds = Aabb::Empty();
+      for (int j = 0; j < node.num_objects; ++j) {
+        node.bounds.Expand(
+            object_bounds_[object_indices_[node.first_object + j]]);
+      }
+    } else {
+      node.bounds = nodes_[i + 1].bounds;
+      node.bounds.Expand(nodes_[node.right_child].bounds);
+    }
+  }
+}
+
+void Bvh::QueryFrustum(const FrustumPlanes& planes,
+                       std::vector<int>* indices) const {
+  if (nodes_.empty()) {
+    return;
+  }
+
+  std::vector<int> stack{0};
+  while (!stack.empty()) {
+    const int node_index = stack.back();
+    const Node& node = nodes_[node_index];
+    stack.pop_back();
+    switch (TestFrustum(planes, node.bounds)) {
+      case FrustumTestResult::kOutside:
+        break;
+      case FrustumTestResult::kInside:
+        AppendObjects(node, indices);
+        break;
+      case FrustumTestResult::kIntersecting:
+        if (node.is_leaf()) {
+          for (int i = 0; i < node.num_objects; ++i) {
+            const int object_index = object_indices_[node.first_object + i];
+            if (!IsOutsideFrustum(planes, object_bounds_[object_index])) {
+              indices->push_back(object_index);
+            }
+          }
+        } else {
+          stack.push_back(node.right_child);
+          stack.push_back(node_index + 1);
+        }
+        break;
+    }
+  }
+}
+
+void Bvh::QueryRay(const Ray& ray, float max_distance,
+                   std::vector<int>* indices) const {
+  if (nodes_.empty()) {
+    return;
+  }
+
+  std::vector<int> stack{0};
+  while (!stack.empty()) {
+    const int node_index = stack.back();
+    const Node& node = nodes_[node_index];
+    stack.pop_back();
+    if (!IntersectRay(ray, node.bounds, max_distance).has_value()) {
+      continue;
+    }
+    if (node.is_leaf()) {
+      for (int i = 0; i < node.num_objects; ++i) {
+        const int object_index = object_indices_[node.first_object + i];
+        if (IntersectRay(ray, object_bounds_[object_index], max_distance)
+                .has_value()) {
+          indices->push_back(object_index);
+        }
+      }
+    } else {
+      stack.push_back(node.right_child);
+      stack.push_back(node_index + 1);
+    }
+  }
+}
+
+void Bvh::QuerySphere(const glm::vec3& center, float radius,
+                      std::vector<int>* indices) const {
+  if (nodes_.empty()) {
+    return;
+  }
+
+  std::vector<int> stack{0};
+  while (!stack.empty()) {
+    const int node_index = stack.back();
+    const Node& node = nodes_[node_index];
+    stack.pop_back();
+    if (!OverlapsSphere(node.bounds, center, radius)) {
+      continue;
+    }
+    if (node.is_leaf()) {
+      for (int i = 0; i < node.num_objects; ++i) {
+        const int object_index = object_indices_[node.first_object + i];
+        if (OverlapsSphere(object_bounds_[object_index], center, radius)) {
+          indices->push_back(object_index);
+        }
+      }
+    } else {
+      stack.push_back(node.right_child);
+      stack.push_back(node_index + 1);
+    }
+  }
+}
+
+std::optional<Bvh::Hit> Bvh::FindNearestHit(
+    const Ray& ray, float max_distance, const IntersectFunc& intersect) const {
+  if (nodes_.empty()) {
+    return std::nullopt;
+  }
+  const std::optional<float> root_distance =
+      IntersectRay(ray, nodes_[0].bounds, max_distance);
+  if (!root_distance.has_value()) {
+    return std::nullopt;
+  }
+
+  // Each entry holds a node index and the distance at which the ray enters it.
+  struct Entry {
+    int node_index;
+    float distance;
+  };
+  std::vector<Entry> stack{{/*node_index=*/0, root_distance.value()}};
+  std::optional<Hit> nearest_hit;
+  float nearest_distance = max_distance;
+  while (!stack.empty()) {
+    const Entry entry = stack.back();
+    stack.pop_back();
+    if (entry.distance > nearest_distance) {
+      continue;
+    }
+
+    const Node& node = nodes_[entry.node_index];
+    if (node.is_leaf()) {
+      for (int i = 0; i < node.num_objects; ++i) {
+        const int object_index = object_indices_[node.first_object + i];
+        if (!IntersectRay(ray, object_bounds_[object_index], nearest_distance)
+                 .has_value()) {
+          continue;
+        }
+        const std::optional<float> distance =
+            intersect(object_index, nearest_distance);
+        if (distance.has_value() && distance.value() <= nearest_distance) {
+          nearest_distance = distance.value();
+          nearest_hit = Hit{object_index, nearest_distance};
+        }
+      }
+      continue;
+    }
+
+    // Push the further child first, so that the nearer one is visited first.
+    const int left_child = entry.node_index + 1;
+    const int right_child = node.right_child;
+    const std::optional<float> left_distance =
+        IntersectRay(ray, nodes_[left_child].bounds, nearest_distance);
+    const std::optional<float> right_distance =
+        IntersectRay(ray, nodes_[right_child].bounds, nearest_distance);
+    if (left_distance.has_value() && right_distance.has_value()) {
+      if (left_distance.value() <= right_distance.value()) {
+        stack.push_back({right_child, right_distance.value()});
+        stack.push_back({left_child, left_distance.value()});
+      } else {
+        stack.push_back({left_child, left_distance.value()});
+        stack.push_back({right_child, right_distance.value()});
+      }
+    } else if (left_distance.has_value()) {
+      stack.push_back({left_child, left_distance.value()});
+    } else if (right_distance.has_value()) {
+      stack.push_back({right_child, right_distance.value()});
+    }
+  }
+  return nearest_hit;
+}
+
+const Aabb& Bvh::bounds() const {
+  static const Aabb* empty_bounds = new Aabb{Aabb::Empty()};
+  return nodes_.empty() ? *empty_bounds : nodes_[0].bounds;
+}
+
+}  // namespace lighter::common
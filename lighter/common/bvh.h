@@ -0,0 +1,127 @@
+//
+//  bvh.h
+//
+//  Created by Pujun Lun on 6/20/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#ifndef LIGHTER_COMMON_BVH_H
+#define LIGHTER_COMMON_BVH_H
+
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "lighter/common/bounds.h"
+#include "third_party/absl/types/span.h"
+#include "third_party/glm/glm.hpp"
+
+namespace lighter::common {
+
+// Bounding volume hierarchy over a set of objects, each of which is represented
+// by its axis-aligned bounding box, and identified by the index of the box.
+// The tree is built with the surface area heuristic (SAH). If objects move,
+// Refit() can be called to update boxes without changing the tree topology,
+// which is much cheaper than rebuilding, but the tree quality degrades if
+// objects move too far from where they were when the tree was built.
+class Bvh {
+ public:
+  struct Options {
+    // Nodes with no more objects than this are not split further.
+    int max_leaf_size = 4;
+    // Number of buckets used to approximate SAH along each axis.
+    int num_buckets = 12;
+  };
+
+  // Describes where a ray hits an object.
+  struct Hit {
+    int index;
+    float distance;
+  };
+
+  // Returns the distance along the ray at which it hits the object at 'index',
+  // or std::nullopt if it misses or the distance is greater than
+  // 'max_distance'.
+  using IntersectFunc =
+      std::function<std::optional<float>(int index, float max_distance)>;
+
+  Bvh(absl::Span<const Aabb> bounds, const Options& options);
+  explicit Bvh(absl::Span<const Aabb> bounds) : Bvh{bounds, Options{}} {}
+
+  // This class is only movable.
+  Bvh(Bvh&&) noexcept = default;
+  Bvh& operator=(Bvh&&) noexcept = default;
+
+  // Updates bounding boxes of objects. 'bounds' must have the same size as the
+  // one used for building this tree.
+  void Refit(absl::Span<const Aabb> bounds);
+
+  // Appends indices of objects whose bounding boxes are not outside of the
+  // frustum to 'indices'. Objects within nodes that are completely inside of
+  // the frustum are appended without further tests.
+  void QueryFrustum(const FrustumPlanes& planes,
+                    std::vector<int>* indices) const;
+
+  // Appends indices of objects whose bounding boxes intersect with 'ray' within
+  // 'max_distance' to 'indices'.
+  void QueryRay(const Ray& ray, float max_distance,
+                std::vector<int>* indices) const;
+
+  // Appends indices of objects whose bounding boxes overlap with the sphere to
+  // 'indices'.
+  void QuerySphere(const glm::vec3& center, float radius,
+                   std::vector<int>* indices) const;
+
+  // Returns the closest hit along 'ray' within 'max_distance'. 'intersect' is
+  // called for objects whose bounding boxes are hit, and nodes are visited
+  // from near to far, so that subtrees further than the closest hit found so
+  // far are skipped. Returns std::nullopt if nothing is hit.
+  std::optional<Hit> FindNearestHit(const Ray& ray, float max_distance,
+                                    const IntersectFunc& intersect) const;
+
+  // Accessors.
+  int num_objects() const { return static_cast<int>(object_bounds_.size()); }
+  const Aabb& bounds() const;
+
+ private:
+  // Nodes are stored in depth-first order, hence the left child of an inner
+  // node immediately follows it, and objects within each subtree occupy a
+  // contiguous range of 'object_indices_'.
+  struct Node {
+    static constexpr int kNoChild = -1;
+
+    bool is_leaf() const { return right_child == kNoChild; }
+
+    Aabb bounds;
+    int first_object;
+    int num_objects;
+    int right_child;
+  };
+
+  // Builds the subtree containing objects in 'object_indices_' within range
+  // ['begin', 'end'), and returns the index of its root node.
+  int BuildNode(const Options& options, absl::Span<const glm::vec3> centroids,
+                int begin, int end);
+
+  // Appends indices of all objects in the subtree rooted at 'node'.
+  void AppendObjects(const Node& node, std::vector<int>* indices) const {
+    indices->insert(indices->end(),
+                    object_indices_.begin() + node.first_object,
+                    object_indices_.begin() + node.first_object +
+                        node.num_objects);
+  }
+
+  // Bounding boxes of objects.
+  std::vector<Aabb> object_bounds_;
+
+  // Indices of objects, reordered so that each leaf node refers to a
+  // contiguous range.
+  std::vector<int> object_indices_;
+
+  // Nodes of the tree. The first one is the root, if any.
+  std::vector<Node> nodes_;
+};
+
+}  // namespace lighter::common
+
+#endif  // LIGHTER_COMMON_BVH_H
@@ -0,0 +1,162 @@
+//
+//  bvh_test.cc
+//
+//  Created by Pujun Lun on 6/20/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/bvh.h"
+
+#include <algorithm>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "lighter/common/bounds.h"
+#include "third_party/glm/gtc/matrix_transform.hpp"
+
+#ifdef ASSERT_TRUE
+#undef ASSERT_TRUE
+#endif
+#ifdef ASSERT_FALSE
+#undef ASSERT_FALSE
+#endif
+#include "third_party/gtest/gtest.h"
+
+namespace lighter::common {
+namespace {
+
+constexpr int kNumSpheres = 1000;
+constexpr float kSphereRadius = 0.5f;
+
+// Spheres randomly distributed in range [-20, 20].
+struct Spheres {
+  explicit Spheres(int seed) {
+    std::mt19937 rand_gen{static_cast<unsigned int>(seed)};
+    std::uniform_real_distribution<float> dist{-20.0f, 20.0f};
+    for (int i = 0; i < kNumSpheres; ++i) {
+      centers.push_back({dist(rand_gen), dist(rand_gen), dist(rand_gen)});
+      bounds.push_back(Aabb::FromSphere(centers.back(), kSphereRadius));
+    }
+  }
+
+  std::vector<glm::vec3> centers;
+  std::vector<Aabb> bounds;
+};
+
+std::vector<int> Sorted(std::vector<int> indices) {
+  std::sort(indices.begin(), indices.end());
+  return indices;
+}
+
+TEST(BvhTest, EmptyTree) {
+  const Bvh bvh{{}};
+  std::vector<int> indices;
+  bvh.QuerySphere(glm::vec3{0.0f}, 1.0f, &indices);
+  EXPECT_TRUE(indices.empty());
+  EXPECT_FALSE(bvh.FindNearestHit(
+      Ray{glm::vec3{0.0f}, glm::vec3{1.0f, 0.0f, 0.0f}}, 100.0f,
+      [](int, float) { return 0.0f; }).has_value());
+}
+
+TEST(BvhTest, QueryFrustumMatchesBruteForce) {
+  const Spheres spheres{/*seed=*/0};
+  const Bvh bvh{spheres.bounds};
+  const glm::mat4 proj = glm::perspective(glm::radians(45.0f),
+                                          /*aspect=*/1.5f, 0.1f, 30.0f);
+  const glm::mat4 view = glm::lookAt(glm::vec3{5.0f, 2.0f, 25.0f},
+                                     /*center=*/glm::vec3{0.0f},
+                                     /*up=*/glm::vec3{0.0f, 1.0f, 0.0f});
+  const FrustumPlanes planes = ExtractFrustumPlanes(proj * view);
+
+  std::vector<int> expected;
+  for (int i = 0; i < kNumSpheres; ++i) {
+    if (!IsOutsideFrustum(planes, spheres.bounds[i])) {
+      expected.push_back(i);
+    }
+  }
+  std::vector<int> indices;
+  bvh.QueryFrustum(planes, &indices);
+  EXPECT_FALSE(expected.empty());
+  EXPECT_LT(expected.size(), kNumSpheres);
+  EXPECT_EQ(Sorted(indices), expected);
+}
+
+TEST(BvhTest, QueryRayAndSphereMatchBruteForce) {
+  const Spheres spheres{/*seed=*/1};
+  const Bvh bvh{spheres.bounds};
+  const Ray ray{glm::vec3{-25.0f, 0.3f, -0.2f}, glm::vec3{1.0f, 0.05f, 0.02f}};
+  constexpr float kMaxDistance = 40.0f;
+  const glm::vec3 center{3.0f, -2.0f, 1.0f};
+  constexpr float kRadius = 6.0f;
+
+  std::vector<int> expected_ray, expected_sphere;
+  for (int i = 0; i < kNumSpheres; ++i) {
+    if (IntersectRay(ray, spheres.bounds[i], kMaxDistance).has_value()) {
+      expected_ray.push_back(i);
+    }
+    const glm::vec3 closest =
+        glm::clamp(center, spheres.bounds[i].min, spheres.bounds[i].max);
+    if (glm::distance(closest, center) <= kRadius) {
+      expected_sphere.push_back(i);
+    }
+  }
+
+  std::vector<int> indices;
+  bvh.QueryRay(ray, kMaxDistance, &indices);
+  EXPECT_EQ(Sorted(indices), expected_ray);
+  indices.clear();
+  bvh.QuerySphere(center, kRadius, &indices);
+  EXPECT_EQ(Sorted(indices), expected_sphere);
+}
+
+TEST(BvhTest, FindNearestHitMatchesBruteForce) {
+  const Spheres spheres{/*seed=*/2};
+  const Bvh bvh{spheres.bounds};
+  std::mt19937 rand_gen{/*seed=*/3};
+  std::uniform_real_distribution<float> dist{-1.0f, 1.0f};
+  constexpr float kMaxDistance = 100.0f;
+  for (int i = 0; i < 100; ++i) {
+    const Ray ray{glm::vec3{0.0f},
+                  glm::vec3{dist(rand_gen), dist(rand_gen), dist(rand_gen)}};
+    std::optional<Bvh::Hit> expected;
+    for (int j = 0; j < kNumSpheres; ++j) {
+      const std::optional<float> distance = IntersectRay(
+          ray, spheres.centers[j], kSphereRadius, kMaxDistance);
+      if (distance.has_value() &&
+          (!expected.has_value() || distance.value() < expected->distance)) {
+        expected = Bvh::Hit{j, distance.value()};
+      }
+    }
+
+    const std::optional<Bvh::Hit> hit = bvh.FindNearestHit(
+        ray, kMaxDistance, [&](int index, float max_distance) {
+          return IntersectRay(ray, spheres.centers[index], kSphereRadius,
+                              max_distance);
+        });
+    ASSERT_EQ(hit.has_value(), expected.has_value());
+    if (hit.has_value()) {
+      EXPECT_EQ(hit->index, expected->index);
+      EXPECT_FLOAT_EQ(hit->distance, expected->distance);
+    }
+  }
+}
+
+TEST(BvhTest, RefitFollowsMovedObjects) {
+  Spheres spheres{/*seed=*/4};
+  Bvh bvh{spheres.bounds};
+  const glm::vec3 offset{100.0f, 0.0f, 0.0f};
+  for (Aabb& aabb : spheres.bounds) {
+    aabb = Aabb{aabb.min + offset, aabb.max + offset};
+  }
+  bvh.Refit(spheres.bounds);
+
+  std::vector<int> indices;
+  bvh.QuerySphere(glm::vec3{0.0f}, 25.0f, &indices);
+  EXPECT_TRUE(indices.empty());
+  bvh.QuerySphere(offset, 50.0f, &indices);
+  EXPECT_EQ(indices.size(), kNumSpheres);
+}
+
+}  // namespace
+}  // namespace lighter::common
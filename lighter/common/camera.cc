@@ -38,6 +38,16 @@ glm::mat4 Camera::GetViewMatrix() const {
   return glm::lookAt(pos_, pos_ + front_, up_);
 }
 
+FrustumPlanes Camera::GetFrustumPlanes(const glm::mat4& model) const {
+#ifdef GLM_FORCE_DEPTH_ZERO_TO_ONE
+  constexpr bool kIsDepthZeroToOne = true;
+#else
+  constexpr bool kIsDepthZeroToOne = false;
+#endif  // GLM_FORCE_DEPTH_ZERO_TO_ONE
+  return ExtractFrustumPlanes(GetProjectionMatrix() * GetViewMatrix() * model,
+                              kIsDepthZeroToOne);
+}
+
 PerspectiveCamera& PerspectiveCamera::SetFieldOfViewY(float fovy) {
   fovy_ = fovy;
   return *this;
@@ -11,10 +11,12 @@
 #include <memory>
 #include <optional>
 
-#include "third_party/absl/functional/function_ref.h"
+// This must be defined before glm is included for the first time.
 #ifdef USE_VULKAN
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #endif  // USE_VULKAN
+#include "lighter/common/bounds.h"
+#include "third_party/absl/functional/function_ref.h"
 #include "third_party/glm/glm.hpp"
 
 namespace lighter::common {
@@ -60,6 +62,11 @@ class Camera {
   // Returns the projection matrix.
   virtual glm::mat4 GetProjectionMatrix() const = 0;
 
+  // Returns frustum planes in the space that 'model' transforms from, i.e. in
+  // the world space if 'model' is the identity matrix.
+  FrustumPlanes GetFrustumPlanes(
+      const glm::mat4& model = glm::mat4{1.0f}) const;
+
   // Accessors.
   const glm::vec3& position() const { return pos_; }
   const glm::vec3& up() const { return up_; }
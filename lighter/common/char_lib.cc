@@ -7,50 +7,356 @@
 
 #include "lighter/common/char_lib.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "lighter/common/font_face_cache.h"
+#include "lighter/common/memory_pool.h"
+#include "lighter/common/pixel_conversion.h"
 #include "lighter/common/util.h"
+#include "third_party/absl/container/flat_hash_set.h"
+#include "third_party/absl/strings/str_format.h"
+#include FT_OUTLINE_H
 
 namespace lighter::common {
+namespace {
 
-CharLib::CharLib(absl::Span<const std::string> texts,
-                 const std::string& font_path, int font_height, bool flip_y) {
-  FT_Library lib;
-  FT_Face face;
-  ASSERT_FALSE(FT_Init_FreeType(&lib), "Failed to init FreeType library");
-  ASSERT_FALSE(FT_New_Face(lib, font_path.c_str(), /*face_index=*/0, &face),
-               "Failed to load font");
-  FT_Set_Pixel_Sizes(face, /*pixel_width=*/0, font_height);
+// Ratio of font height to the range of distances represented by signed distance
+// fields, and the minimum range in number of pixels.
+constexpr int kFontHeightToSdfSpreadRatio = 8;
+constexpr int kMinSdfSpread = 2;
+
+// Number of line segments that each Bezier curve is flattened into.
+constexpr int kNumSegmentsPerCurve = 8;
+
+// Number of glyphs loaded by each task in the bitmap mode. Rasterizing one
+// glyph is cheap, hence glyphs are batched so that few workers are started for
+// small texts. In the signed distance field mode, each task loads one glyph.
+constexpr int kNumBitmapGlyphsPerTask = 16;
+
+// A line segment of glyph outlines in the pixel space, where Y-axis points up.
+struct Segment {
+  glm::vec2 start;
+  glm::vec2 end;
+};
+
+// Outline of a glyph that is flattened into line segments.
+struct GlyphOutline {
+  char32_t codepoint;
+  glm::ivec2 bearing;
+  glm::ivec2 advance;
+  glm::ivec2 image_size;
+  std::vector<Segment> segments;
+};
+
+// Accumulates line segments while decomposing an outline with FreeType.
+struct OutlineFlattener {
+  // Closes the current contour if it is not closed yet.
+  void CloseContour() {
+    if (current != contour_start) {
+      segments.push_back({current, contour_start});
+    }
+  }
+
+  void LineTo(const glm::vec2& point) {
+    segments.push_back({current, point});
+    current = point;
+  }
+
+  std::vector<Segment> segments;
+  glm::vec2 contour_start{0.0f};
+  glm::vec2 current{0.0f};
+};
+
+// Converts a point in 26.6 fixed point format to pixels.
+glm::vec2 ToPixels(const FT_Vector* vector) {
+  return glm::vec2{static_cast<float>(vector->x),
+                   static_cast<float>(vector->y)} / 64.0f;
+}
+
+int MoveTo(const FT_Vector* to, void* user) {
+  auto* flattener = static_cast<OutlineFlattener*>(user);
+  flattener->CloseContour();
+  flattener->contour_start = flattener->current = ToPixels(to);
+  return 0;
+}
+
+int LineTo(const FT_Vector* to, void* user) {
+  static_cast<OutlineFlattener*>(user)->LineTo(ToPixels(to));
+  return 0;
+}
+
+int ConicTo(const FT_Vector* control, const FT_Vector* to, void* user) {
+  auto* flattener = static_cast<OutlineFlattener*>(user);
+  const glm::vec2 p0 = flattener->current;
+  const glm::vec2 p1 = ToPixels(control);
+  const glm::vec2 p2 = ToPixels(to);
+  for (int i = 1; i <= kNumSegmentsPerCurve; ++i) {
+    const float t = static_cast<float>(i) / kNumSegmentsPerCurve;
+    const float s = 1.0f - t;
+    flattener->LineTo(s * s * p0 + 2.0f * s * t * p1 + t * t * p2);
+  }
+  return 0;
+}
+
+int CubicTo(const FT_Vector* control1, const FT_Vector* control2,
+            const FT_Vector* to, void* user) {
+  auto* flattener = static_cast<OutlineFlattener*>(user);
+  const glm::vec2 p0 = flattener->current;
+  const glm::vec2 p1 = ToPixels(control1);
+  const glm::vec2 p2 = ToPixels(control2);
+  const glm::vec2 p3 = ToPixels(to);
+  for (int i = 1; i <= kNumSegmentsPerCurve; ++i) {
+    const float t = static_cast<float>(i) / kNumSegmentsPerCurve;
+    const float s = 1.0f - t;
+    flattener->LineTo(s * s * s * p0 + 3.0f * s * s * t * p1 +
+                      3.0f * s * t * t * p2 + t * t * t * p3);
+  }
+  return 0;
+}
+
+// Returns the advance of 'glyph' in number of pixels.
+glm::ivec2 GetAdvance(const FT_GlyphSlot& glyph) {
+  // Advance is measured in number of 1/64 pixels.
+  return {
+      static_cast<int>(static_cast<unsigned int>(glyph->advance.x) >> 6U),
+      static_cast<int>(static_cast<unsigned int>(glyph->advance.y) >> 6U),
+  };
+}
+
+// Copies the glyph bitmap of 'glyph' into a pooled buffer and returns an image
+// that adopts it. Glyph bitmaps are small, hence this avoids going to the
+// system allocator for each character.
+Image CreateGlyphImage(const FT_GlyphSlot& glyph, bool flip_y) {
+  const FT_Bitmap& bitmap = glyph->bitmap;
+  const int width = static_cast<int>(bitmap.width);
+  const int height = static_cast<int>(bitmap.rows);
+  const size_t data_size = static_cast<size_t>(width) * height;
+  auto data = memory_pool::AllocateBuffer(data_size);
+  if (data_size > 0) {
+    if (flip_y) {
+      pixel_conversion::FlipVertically(bitmap.buffer, /*row_size=*/width,
+                                       /*num_rows=*/height, data.get());
+    } else {
+      std::memcpy(data.get(), bitmap.buffer, data_size);
+    }
+  }
+  return Image{width, height, image::kBwImageChannel, std::move(data)};
+}
+
+// Flattens the outline of 'glyph', which must have been loaded without being
+// rendered, and computes the extent of the image that encloses the outline
+// padded by 'padding' pixels on each side.
+GlyphOutline FlattenGlyphOutline(char32_t codepoint, const FT_GlyphSlot& glyph,
+                                 int padding) {
+  ASSERT_TRUE(glyph->format == FT_GLYPH_FORMAT_OUTLINE,
+              absl::StrFormat("Glyph of U+%04X is not an outline",
+                              static_cast<uint32_t>(codepoint)));
+  GlyphOutline outline{codepoint, /*bearing=*/glm::ivec2{0},
+                       GetAdvance(glyph), /*image_size=*/glm::ivec2{0},
+                       /*segments=*/{}};
+  if (glyph->outline.n_points == 0) {
+    return outline;
+  }
+
+  const FT_Outline_Funcs funcs{&MoveTo, &LineTo, &ConicTo, &CubicTo,
+                               /*shift=*/0, /*delta=*/0};
+  OutlineFlattener flattener;
+  ASSERT_FALSE(FT_Outline_Decompose(&glyph->outline, &funcs, &flattener),
+               absl::StrFormat("Failed to decompose outline of U+%04X",
+                               static_cast<uint32_t>(codepoint)));
+  flattener.CloseContour();
+  outline.segments = std::move(flattener.segments);
 
+  FT_BBox box;
+  FT_Outline_Get_CBox(&glyph->outline, &box);
+  const glm::ivec2 min{static_cast<int>(std::floor(box.xMin / 64.0f)),
+                       static_cast<int>(std::floor(box.yMin / 64.0f))};
+  const glm::ivec2 max{static_cast<int>(std::ceil(box.xMax / 64.0f)),
+                       static_cast<int>(std::ceil(box.yMax / 64.0f))};
+  outline.bearing = glm::ivec2{min.x - padding, max.y + padding};
+  outline.image_size = max - min + padding * 2;
+  return outline;
+}
+
+// Returns the signed distance from 'point' to 'segments', which is positive if
+// 'point' is inside. The absolute value is clamped to 'max_distance'. Whether
+// 'point' is inside is determined with the non-zero winding rule, which works
+// for both TrueType and PostScript outlines.
+float GetSignedDistance(const glm::vec2& point,
+                        absl::Span<const Segment> segments,
+                        float max_distance) {
+  float min_distance_sq = max_distance * max_distance;
+  int winding = 0;
+  for (const auto& segment : segments) {
+    const glm::vec2& start = segment.start;
+    const glm::vec2& end = segment.end;
+
+    // Count crossings of the ray from 'point' towards +X.
+    const glm::vec2 edge = end - start;
+    const glm::vec2 to_point = point - start;
+    const float cross = edge.x * to_point.y - edge.y * to_point.x;
+    if (start.y <= point.y) {
+      if (end.y > point.y && cross > 0.0f) {
+        ++winding;
+      }
+    } else if (end.y <= point.y && cross < 0.0f) {
+      --winding;
+    }
+
+    // Skip segments whose bounding box is farther than the closest one.
+    const glm::vec2 box_distance = glm::max(
+        glm::max(glm::min(start, end) - point, point - glm::max(start, end)),
+        glm::vec2{0.0f});
+    if (glm::dot(box_distance, box_distance) >= min_distance_sq) {
+      continue;
+    }
+    const float edge_length_sq = glm::dot(edge, edge);
+    const float t = edge_length_sq > 0.0f
+        ? glm::clamp(glm::dot(to_point, edge) / edge_length_sq, 0.0f, 1.0f)
+        : 0.0f;
+    const glm::vec2 offset = to_point - edge * t;
+    min_distance_sq = std::min(min_distance_sq, glm::dot(offset, offset));
+  }
+
+  const float distance = std::sqrt(min_distance_sq);
+  return winding != 0 ? distance : -distance;
+}
+
+// Returns a signed distance field image of 'outline'. See the comments of
+// CharLib::GlyphMode::kSignedDistanceField for how distances are stored.
+Image CreateSdfGlyphImage(const GlyphOutline& outline, int spread,
+                          bool flip_y) {
+  const int width = outline.image_size.x;
+  const int height = outline.image_size.y;
+  auto data =
+      memory_pool::AllocateBuffer(static_cast<size_t>(width) * height);
+  const auto max_distance = static_cast<float>(spread);
+  for (int row = 0; row < height; ++row) {
+    // Unless flipped, the first row is the top one.
+    const int row_from_top = flip_y ? height - 1 - row : row;
+    const float y = static_cast<float>(outline.bearing.y - row_from_top) - 0.5f;
+    unsigned char* row_data = data.get() + static_cast<size_t>(row) * width;
+    for (int col = 0; col < width; ++col) {
+      const glm::vec2 point{outline.bearing.x + col + 0.5f, y};
+      const float distance =
+          GetSignedDistance(point, outline.segments, max_distance);
+      const float value = 0.5f + distance / (2.0f * max_distance);
+      row_data[col] = static_cast<unsigned char>(
+          std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+  }
+  return Image{width, height, image::kBwImageChannel, std::move(data)};
+}
+
+// Loads the glyph of 'codepoint' from 'face'. See CharLib::LoadGlyphs() for
+// details.
+CharLib::CharInfo LoadGlyph(FT_Face face, char32_t codepoint, bool flip_y,
+                            CharLib::GlyphMode glyph_mode, int glyph_padding) {
+  if (glyph_mode == CharLib::GlyphMode::kBitmap) {
+    ASSERT_FALSE(FT_Load_Char(face, codepoint, FT_LOAD_RENDER),
+                 absl::StrFormat("Failed to load glyph of U+%04X",
+                                 static_cast<uint32_t>(codepoint)));
+    return CharLib::CharInfo{
+        .bearing = {
+            face->glyph->bitmap_left,
+            face->glyph->bitmap_top,
+        },
+        .advance = GetAdvance(face->glyph),
+        .image = CreateGlyphImage(face->glyph, flip_y),
+    };
+  }
+
+  // Hinting would distort outlines for sizes other than the one of 'face'.
+  ASSERT_FALSE(FT_Load_Char(face, codepoint,
+                            FT_LOAD_NO_BITMAP | FT_LOAD_NO_HINTING),
+               absl::StrFormat("Failed to load glyph of U+%04X",
+                               static_cast<uint32_t>(codepoint)));
+  const GlyphOutline outline =
+      FlattenGlyphOutline(codepoint, face->glyph, glyph_padding);
+  return CharLib::CharInfo{
+      .bearing = outline.bearing,
+      .advance = outline.advance,
+      .image = CreateSdfGlyphImage(outline, glyph_padding, flip_y),
+  };
+}
+
+}  // namespace
+
+CharLib::CharLib(absl::Span<const std::string> texts,
+                 const std::string& font_path, int font_height, bool flip_y,
+                 GlyphMode glyph_mode)
+    : glyph_mode_{glyph_mode},
+      glyph_padding_{GetGlyphPadding(glyph_mode, font_height)} {
+  absl::flat_hash_set<char> seen_chars;
+  std::vector<char> chars;
+  std::vector<char32_t> codepoints;
   for (const auto& text : texts) {
     for (const auto character : text) {
-      if (char_info_map_.contains(character)) {
-        continue;
+      if (seen_chars.insert(character).second) {
+        chars.push_back(character);
+        codepoints.push_back(static_cast<unsigned char>(character));
       }
-
-      ASSERT_FALSE(FT_Load_Char(face, character, FT_LOAD_RENDER),
-                   "Failed to load glyph");
-      char_info_map_.insert({character, CharInfo{
-          .bearing = {
-              face->glyph->bitmap_left,
-              face->glyph->bitmap_top,
-          },
-          // Advance is measured in number of 1/64 pixels.
-          .advance = {
-              static_cast<unsigned int>(face->glyph->advance.x) >> 6U,
-              static_cast<unsigned int>(face->glyph->advance.y) >> 6U,
-          },
-          .image = std::make_unique<Image>(
-              /*width=*/face->glyph->bitmap.width,
-              /*height=*/face->glyph->bitmap.rows,
-              image::kBwImageChannel,
-              /*raw_data=*/face->glyph->bitmap.buffer,
-              flip_y
-          ),
-      }});
     }
   }
 
-  FT_Done_Face(face);
-  FT_Done_FreeType(lib);
+  std::vector<CharInfo> char_infos =
+      LoadGlyphs(font_path, font_height, codepoints, flip_y, glyph_mode_);
+  for (int i = 0; i < chars.size(); ++i) {
+    char_info_map_.insert({chars[i], std::move(char_infos[i])});
+  }
+}
+
+int CharLib::GetGlyphPadding(GlyphMode glyph_mode, int font_height) {
+  switch (glyph_mode) {
+    case GlyphMode::kBitmap:
+      return 0;
+    case GlyphMode::kSignedDistanceField:
+      return std::max(font_height / kFontHeightToSdfSpreadRatio,
+                      kMinSdfSpread);
+  }
+}
+
+std::vector<CharLib::CharInfo> CharLib::LoadGlyphs(
+    const std::string& font_path, int font_height,
+    absl::Span<const char32_t> codepoints, bool flip_y, GlyphMode glyph_mode) {
+  const int glyph_padding = GetGlyphPadding(glyph_mode, font_height);
+  const int num_glyphs = static_cast<int>(codepoints.size());
+  const int num_glyphs_per_task = glyph_mode == GlyphMode::kBitmap
+                                      ? kNumBitmapGlyphsPerTask : 1;
+  const int num_tasks =
+      (num_glyphs + num_glyphs_per_task - 1) / num_glyphs_per_task;
+
+  // Each worker checks out its own face once, and keeps taking the next task
+  // until none is left.
+  const int num_workers = std::min(num_tasks, util::GetNumHardwareThreads());
+  std::atomic<int> next_task_index{0};
+  std::vector<std::optional<CharInfo>> char_infos(num_glyphs);
+  util::ParallelFor(num_workers, [&](int /*worker*/) {
+    font_face_cache::ScopedFaceSet face_set;
+    const FT_Face face = face_set.GetFace(font_path, font_height);
+    for (int task_index = next_task_index++; task_index < num_tasks;
+         task_index = next_task_index++) {
+      const int begin = task_index * num_glyphs_per_task;
+      const int end = std::min(begin + num_glyphs_per_task, num_glyphs);
+      for (int i = begin; i < end; ++i) {
+        char_infos[i] =
+            LoadGlyph(face, codepoints[i], flip_y, glyph_mode, glyph_padding);
+      }
+    }
+  });
+
+  std::vector<CharInfo> loaded_char_infos;
+  loaded_char_infos.reserve(num_glyphs);
+  for (auto& char_info : char_infos) {
+    loaded_char_infos.push_back(std::move(char_info).value());
+  }
+  return loaded_char_infos;
 }
 
 }  // namespace lighter::common
@@ -8,15 +8,13 @@
 #ifndef LIGHTER_COMMON_CHAR_LIB_H
 #define LIGHTER_COMMON_CHAR_LIB_H
 
-#include <memory>
 #include <string>
+#include <vector>
 
 #include "lighter/common/image.h"
 #include "lighter/common/file.h"
 #include "third_party/absl/container/flat_hash_map.h"
 #include "third_party/absl/types/span.h"
-#include "third_party/freetype2/ft2build.h"
-#include FT_FREETYPE_H
 #include "third_party/glm/glm.hpp"
 
 namespace lighter::common {
@@ -24,29 +22,71 @@ namespace lighter::common {
 // Character library backed by FreeType.
 class CharLib {
  public:
+  // Determines how glyph images are generated.
+  enum class GlyphMode {
+    // Each pixel stores the coverage of the glyph rasterized by FreeType.
+    kBitmap,
+
+    // Each pixel stores the signed distance from its center to the glyph
+    // outline, which is computed on the CPU from the outline. Distances are
+    // mapped so that 0.5 is on the outline, larger values are inside, and 0.0
+    // and 1.0 are 'glyph_padding()' pixels away from the outline. Since
+    // distances interpolate well, glyphs can be rendered crisply at sizes other
+    // than 'font_height' by thresholding sampled values at 0.5.
+    kSignedDistanceField,
+  };
+
   // Information related to drawing the character. For details, see:
   // https://learnopengl.com/img/in-practice/glyph.png
   struct CharInfo {
     glm::ivec2 bearing;
     glm::ivec2 advance;
-    std::unique_ptr<Image> image;
+    Image image;
   };
 
   // We will load all characters in 'texts' from the library. All of them will
   // be of height 'font_height', while the width is self-adjusted.
+  // In the signed distance field mode, glyph images are padded on each side.
+  // Glyphs are loaded on multiple threads with LoadGlyphs().
   CharLib(absl::Span<const std::string> texts,
-          const std::string& font_path, int font_height, bool flip_y);
+          const std::string& font_path, int font_height, bool flip_y,
+          GlyphMode glyph_mode = GlyphMode::kBitmap);
 
   // This class is neither copyable nor movable.
   CharLib(const CharLib&) = delete;
   CharLib& operator=(const CharLib&) = delete;
 
+  // Returns the number of pixels padded on each side of glyph images loaded in
+  // 'glyph_mode' with 'font_height'.
+  static int GetGlyphPadding(GlyphMode glyph_mode, int font_height);
+
+  // Loads glyphs of 'codepoints' from the font at 'font_path' with
+  // 'font_height', and returns them in the same order. This is shared with
+  // other glyph caches that load characters on demand.
+  // Glyphs are loaded on multiple threads, each of which uses FreeType faces
+  // owned by itself. Faces are cached, hence they are not created again when
+  // loading more glyphs later on the same thread.
+  static std::vector<CharInfo> LoadGlyphs(
+      const std::string& font_path, int font_height,
+      absl::Span<const char32_t> codepoints, bool flip_y,
+      GlyphMode glyph_mode);
+
   // Accessors.
   const absl::flat_hash_map<char, CharInfo>& char_info_map() const {
     return char_info_map_;
   }
+  GlyphMode glyph_mode() const { return glyph_mode_; }
+  int glyph_padding() const { return glyph_padding_; }
 
  private:
+  // Determines how glyph images are generated.
+  const GlyphMode glyph_mode_;
+
+  // Number of pixels padded on each side of glyph images. Bearings take it into
+  // account. In the signed distance field mode, this is also the range of
+  // distances that can be represented.
+  const int glyph_padding_;
+
   // Holds information about loaded characters. Only those characters loaded
   // via the constructor will be in this map.
   absl::flat_hash_map<char, CharInfo> char_info_map_;
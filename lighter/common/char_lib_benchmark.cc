@@ -0,0 +1,175 @@
+//
+//  char_lib_benchmark.cc
+//
+//  Created by Pujun Lun on 6/30/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include <string>
+#include <vector>
+
+#include "lighter/common/char_lib.h"
+#include "lighter/common/file.h"
+#include "lighter/common/glyph_cache.h"
+#include "lighter/common/utf8.h"
+#include "lighter/common/util.h"
+#include "third_party/absl/container/flat_hash_set.h"
+#include "third_party/absl/flags/flag.h"
+#include "third_party/absl/flags/parse.h"
+#include "third_party/absl/strings/str_format.h"
+#include "third_party/benchmark/benchmark.h"
+#include "third_party/freetype2/ft2build.h"
+#include FT_FREETYPE_H
+
+ABSL_FLAG(std::string, font_path, "",
+          "Path to the font file. The Georgia font in the resource folder will "
+          "be used if not specified");
+ABSL_FLAG(int, num_texts, 300, "Number of texts to load");
+
+namespace lighter::common {
+namespace {
+
+using GlyphMode = CharLib::GlyphMode;
+
+// Words that texts are made of. They cover all letters in both cases, digits
+// and common punctuations, as user interfaces would.
+const char* const kWords[]{
+    "The", "quick", "brown", "fox", "jumps", "over", "a", "lazy", "dog.",
+    "PACK", "MY", "BOX", "WITH", "FIVE", "DOZEN", "LIQUOR", "JUGS!",
+    "Frame", "time:", "(ms)", "0123456789", "Vertex", "#42", "[x,", "y]",
+    "50%", "Quit?", "Resume", "Settings", "@home", "$price", "a+b=c",
+};
+
+// Returns 'num_texts' texts composed of kWords, similar to labels of user
+// interfaces.
+std::vector<std::string> GenerateTexts(int num_texts) {
+  constexpr int kNumWords = sizeof(kWords) / sizeof(kWords[0]);
+  std::vector<std::string> texts(num_texts);
+  for (int i = 0; i < num_texts; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      if (j > 0) {
+        texts[i] += ' ';
+      }
+      texts[i] += kWords[(i * 7 + j * 5) % kNumWords];
+    }
+    texts[i] += absl::StrFormat(" %d", i);
+  }
+  return texts;
+}
+
+// Returns the glyph mode and font height specified by benchmark arguments.
+GlyphMode GetGlyphMode(const benchmark::State& state) {
+  return static_cast<GlyphMode>(state.range(0));
+}
+int GetFontHeight(const benchmark::State& state) {
+  return static_cast<int>(state.range(1));
+}
+
+// Loads texts as CharLib did before FreeType faces were cached, which creates
+// a FreeType library and a face for each construction and renders glyphs on
+// the calling thread. This serves as the baseline of the bitmap mode.
+void BM_LoadTexts_Baseline(benchmark::State& state,
+                           const std::string* font_path,
+                           const std::vector<std::string>* texts) {
+  const int font_height = GetFontHeight(state);
+  for (auto _ : state) {
+    absl::flat_hash_set<char> chars;
+    for (const auto& text : *texts) {
+      chars.insert(text.begin(), text.end());
+    }
+
+    FT_Library lib;
+    FT_Face face;
+    ASSERT_FALSE(FT_Init_FreeType(&lib), "Failed to init FreeType library");
+    ASSERT_FALSE(FT_New_Face(lib, font_path->c_str(), /*face_index=*/0, &face),
+                 "Failed to load font");
+    FT_Set_Pixel_Sizes(face, /*pixel_width=*/0, font_height);
+    for (const auto character : chars) {
+      ASSERT_FALSE(FT_Load_Char(face, static_cast<unsigned char>(character),
+                                FT_LOAD_RENDER),
+                   "Failed to load glyph");
+      const FT_Bitmap& bitmap = face->glyph->bitmap;
+      std::vector<unsigned char> image(
+          bitmap.buffer, bitmap.buffer + bitmap.width * bitmap.rows);
+      benchmark::DoNotOptimize(image.data());
+    }
+    FT_Done_Face(face);
+    FT_Done_FreeType(lib);
+  }
+  state.SetItemsProcessed(
+      static_cast<int64_t>(state.iterations() * texts->size()));
+}
+
+// Loads texts with CharLib, as StaticText does when constructed.
+void BM_LoadTexts_CharLib(benchmark::State& state,
+                          const std::string* font_path,
+                          const std::vector<std::string>* texts) {
+  for (auto _ : state) {
+    const CharLib char_lib{*texts, *font_path, GetFontHeight(state),
+                           /*flip_y=*/true, GetGlyphMode(state)};
+    benchmark::DoNotOptimize(char_lib.char_info_map().size());
+  }
+  state.SetItemsProcessed(
+      static_cast<int64_t>(state.iterations() * texts->size()));
+}
+
+// Preloads texts into GlyphCache, as DynamicText does when constructed.
+void BM_LoadTexts_GlyphCache(benchmark::State& state,
+                             const std::string* font_path,
+                             const std::vector<std::string>* texts) {
+  for (auto _ : state) {
+    GlyphCache glyph_cache{*font_path, GetFontHeight(state),
+                           GetGlyphMode(state), GlyphCache::Config{}};
+    std::vector<char32_t> codepoints;
+    for (const auto& text : *texts) {
+      const std::u32string decoded = utf8::Decode(text);
+      codepoints.insert(codepoints.end(), decoded.begin(), decoded.end());
+    }
+    glyph_cache.LoadGlyphs(codepoints);
+    benchmark::DoNotOptimize(glyph_cache.FlushDirtyRegions().size());
+  }
+  state.SetItemsProcessed(
+      static_cast<int64_t>(state.iterations() * texts->size()));
+}
+
+}  // namespace
+}  // namespace lighter::common
+
+int main(int argc, char* argv[]) {
+  using namespace lighter::common;
+
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+
+  std::string font_path = absl::GetFlag(FLAGS_font_path);
+  if (font_path.empty()) {
+    file::EnableRunfileLookup(argv[0]);
+    font_path = file::GetResourcePath("font/georgia.ttf");
+  }
+  const std::vector<std::string> texts =
+      GenerateTexts(absl::GetFlag(FLAGS_num_texts));
+
+  // Arguments are the glyph mode and the font height. Font heights are those
+  // used by the cube example.
+  const auto bitmap = static_cast<int64_t>(GlyphMode::kBitmap);
+  const auto sdf = static_cast<int64_t>(GlyphMode::kSignedDistanceField);
+  benchmark::RegisterBenchmark("BM_LoadTexts/Baseline",
+                               BM_LoadTexts_Baseline, &font_path, &texts)
+      ->Args({bitmap, 100})
+      ->Unit(benchmark::kMillisecond)
+      ->UseRealTime();
+  benchmark::RegisterBenchmark("BM_LoadTexts/CharLib",
+                               BM_LoadTexts_CharLib, &font_path, &texts)
+      ->Args({bitmap, 100})
+      ->Args({sdf, 32})
+      ->Unit(benchmark::kMillisecond)
+      ->UseRealTime();
+  benchmark::RegisterBenchmark("BM_LoadTexts/GlyphCache",
+                               BM_LoadTexts_GlyphCache, &font_path, &texts)
+      ->Args({bitmap, 100})
+      ->Args({sdf, 32})
+      ->Unit(benchmark::kMillisecond)
+      ->UseRealTime();
+  benchmark::RunSpecifiedBenchmarks();
+  return EXIT_SUCCESS;
+}
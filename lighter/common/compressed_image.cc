@@ -0,0 +1,334 @@
+//
+//  compressed_image.cc
+//
+//  Created by Pujun Lun on 6/24/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/compressed_image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "lighter/common/util.h"
+#include "third_party/absl/strings/str_format.h"
+#include "third_party/absl/strings/str_join.h"
+#include "third_party/picosha2/picosha2.h"
+
+namespace lighter::common {
+namespace {
+
+namespace stdfs = std::filesystem;
+
+using Format = CompressedImage::Format;
+
+// "BCIM" in little endian. This also helps detect caches written on platforms
+// of different endianness.
+constexpr uint32_t kMagic = 0x4D494342;
+
+// Must be bumped whenever the layout of cache files or the output of encoders
+// changes.
+constexpr uint32_t kVersion = 1;
+
+// Offset of each level is aligned to this, which also satisfies the alignment
+// required for copying data from buffers to images.
+constexpr size_t kLevelAlignment = 16;
+
+// Header of cache files. Levels are stored after 'data_offset' in order, and
+// the offset of each level is aligned to kLevelAlignment.
+struct Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t layer;
+  uint32_t num_levels;
+  uint32_t padding;
+  CompressedImage::SourceHash source_hash;
+  uint64_t data_offset;
+  uint64_t file_size;
+};
+
+// Returns 'offset' rounded up to the next multiple of kLevelAlignment.
+size_t AlignOffset(size_t offset) {
+  return (offset + kLevelAlignment - 1) / kLevelAlignment * kLevelAlignment;
+}
+
+// Returns the first 'num_levels' levels of an image encoded in 'format'.
+std::vector<CompressedImage::Level> ComputeLevels(Format format, int width,
+                                                  int height, int num_levels) {
+  std::vector<CompressedImage::Level> levels;
+  levels.reserve(num_levels);
+  for (int level = 0; level < num_levels; ++level) {
+    levels.push_back({width, height,
+                      block_compression::GetEncodedSize(format, width,
+                                                        height)});
+    width = std::max(width / 2, 1);
+    height = std::max(height / 2, 1);
+  }
+  return levels;
+}
+
+// Returns offsets of 'levels' relative to the beginning of level data, and the
+// total size of level data as the last element.
+std::vector<size_t> ComputeLevelOffsets(
+    absl::Span<const CompressedImage::Level> levels, int layer) {
+  std::vector<size_t> offsets;
+  offsets.reserve(levels.size() + 1);
+  size_t offset = 0;
+  for (const auto& level : levels) {
+    offsets.push_back(offset);
+    offset = AlignOffset(offset + level.layer_size * layer);
+  }
+  offsets.push_back(offset);
+  return offsets;
+}
+
+// Returns the format used for 'options' and images with 'channel' channels.
+Format ResolveFormat(const CompressedImage::Options& options, int channel) {
+  return options.format.value_or(CompressedImage::GetDefaultFormat(channel));
+}
+
+}  // namespace
+
+Format CompressedImage::GetDefaultFormat(int channel) {
+  return channel == image::kBwImageChannel ? Format::kBc4 : Format::kBc7;
+}
+
+std::unique_ptr<CompressedImage> CompressedImage::LoadImageFiles(
+    absl::Span<const std::string> paths,
+    const std::optional<MipChain::Options>& mip_options,
+    const Options& options) {
+  const SourceHash source_hash = ComputeSourceHash(paths, mip_options,
+                                                   options);
+  const std::string cache_path = GetDefaultCachePath(paths);
+  if (auto compressed_image = LoadFromFile(cache_path, source_hash)) {
+    return compressed_image;
+  }
+
+  LOG_INFO << absl::StreamFormat("Compressing image '%s'", paths[0]);
+  const Image image{paths};
+  std::unique_ptr<CompressedImage> compressed_image;
+  if (mip_options.has_value()) {
+    const auto mip_chain = MipChain::Generate(image, mip_options.value());
+    compressed_image = Encode(*mip_chain, options, source_hash);
+  } else {
+    compressed_image = Encode(image, options, source_hash);
+  }
+  compressed_image->WriteToFile(cache_path);
+  return compressed_image;
+}
+
+CompressedImage::SourceHash CompressedImage::ComputeSourceHash(
+    absl::Span<const std::string> source_paths,
+    const std::optional<MipChain::Options>& mip_options,
+    const Options& options) {
+  picosha2::hash256_one_by_one hasher;
+  for (const auto& path : source_paths) {
+    const RawData source_data{path, RawData::Mode::kMemoryMapped};
+    hasher.process(source_data.data, source_data.data + source_data.size);
+  }
+  std::string options_string = absl::StrFormat(
+      "CompressedImage format=%d quality=%d",
+      options.format.has_value() ? static_cast<int>(options.format.value())
+                                 : -1,
+      static_cast<int>(options.quality));
+  if (mip_options.has_value()) {
+    absl::StrAppendFormat(&options_string, " filter=%d srgb=%d",
+                          static_cast<int>(mip_options->filter),
+                          mip_options->is_srgb);
+  }
+  hasher.process(options_string.begin(), options_string.end());
+  hasher.finish();
+
+  SourceHash hash;
+  hasher.get_hash_bytes(hash.begin(), hash.end());
+  return hash;
+}
+
+std::string CompressedImage::GetDefaultCachePath(
+    absl::Span<const std::string> source_paths) {
+  // Different source files may have the same name, hence we also append the
+  // hash of absolute paths.
+  std::vector<std::string> absolute_paths;
+  absolute_paths.reserve(source_paths.size());
+  for (const auto& path : source_paths) {
+    absolute_paths.push_back(stdfs::absolute(path).string());
+  }
+  const std::string path_hash =
+      picosha2::hash256_hex_string(absl::StrJoin(absolute_paths, "\n"));
+  const stdfs::path cache_path =
+      stdfs::temp_directory_path() / "lighter" / "texture_cache" /
+      absl::StrFormat("%s.%s.bcim",
+                      stdfs::path{source_paths[0]}.filename().string(),
+                      path_hash.substr(/*pos=*/0, /*n=*/16));
+  return cache_path.string();
+}
+
+std::unique_ptr<CompressedImage> CompressedImage::LoadFromFile(
+    std::string_view cache_path, const SourceHash& source_hash) {
+  std::error_code error_code;
+  if (!stdfs::is_regular_file(cache_path, error_code)) {
+    return nullptr;
+  }
+
+  std::unique_ptr<CompressedImage> compressed_image{new CompressedImage};
+  compressed_image->file_data_ =
+      std::make_unique<RawData>(cache_path, RawData::Mode::kMemoryMapped);
+  if (!compressed_image->Parse(compressed_image->file_data_->GetSpan(),
+                               source_hash)) {
+    LOG_INFO << absl::StreamFormat("Compressed image cache '%s' is stale",
+                                   cache_path);
+    return nullptr;
+  }
+  return compressed_image;
+}
+
+std::unique_ptr<CompressedImage> CompressedImage::Encode(
+    const MipChain& mip_chain, const Options& options,
+    const SourceHash& source_hash) {
+  const Image::Dimension dimension{mip_chain.width(), mip_chain.height(),
+                                   mip_chain.channel(), mip_chain.layer()};
+  return Encode(dimension, mip_chain.num_levels(), mip_chain.data_ptrs(),
+                options, source_hash);
+}
+
+std::unique_ptr<CompressedImage> CompressedImage::Encode(
+    const Image& image, const Options& options,
+    const SourceHash& source_hash) {
+  return Encode(image.dimension(), /*num_levels=*/1, image.data_ptrs(),
+                options, source_hash);
+}
+
+std::unique_ptr<CompressedImage> CompressedImage::Encode(
+    const Image::Dimension& dimension, int num_levels,
+    absl::Span<const void* const> datas, const Options& options,
+    const SourceHash& source_hash) {
+  const Format format = ResolveFormat(options, dimension.channel);
+  const int layer = dimension.layer;
+  ASSERT_TRUE(dimension.channel == block_compression::GetNumChannels(format),
+              absl::StrFormat("Format %d does not support images with %d "
+                              "channels", static_cast<int>(format),
+                              dimension.channel));
+  ASSERT_TRUE(layer == image::kSingleImageLayer
+                  || layer == image::kCubemapImageLayer,
+              absl::StrFormat("Unsupported number of images: %d", layer));
+  ASSERT_TRUE(datas.size() == static_cast<size_t>(num_levels) * layer,
+              absl::StrFormat("Expecting %d images, while %d provided",
+                              num_levels * layer, datas.size()));
+
+  const std::vector<Level> levels = ComputeLevels(
+      format, dimension.width, dimension.height, num_levels);
+  const std::vector<size_t> offsets = ComputeLevelOffsets(levels, layer);
+
+  Header header{};
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.format = static_cast<uint32_t>(format);
+  header.width = dimension.width;
+  header.height = dimension.height;
+  header.layer = layer;
+  header.num_levels = num_levels;
+  header.source_hash = source_hash;
+  header.data_offset = AlignOffset(sizeof(Header));
+  header.file_size = header.data_offset + offsets.back();
+
+  // Paddings between levels are zero.
+  std::unique_ptr<CompressedImage> compressed_image{new CompressedImage};
+  std::vector<char>& buffer = compressed_image->buffer_;
+  buffer.resize(header.file_size);
+  std::memcpy(buffer.data(), &header, sizeof(header));
+  for (int level = 0; level < num_levels; ++level) {
+    for (int layer_index = 0; layer_index < layer; ++layer_index) {
+      block_compression::Encode(
+          format, options.quality, levels[level].width, levels[level].height,
+          static_cast<const uint8_t*>(datas[level * layer + layer_index]),
+          reinterpret_cast<uint8_t*>(buffer.data()) + header.data_offset +
+              offsets[level] + levels[level].layer_size * layer_index);
+    }
+  }
+
+  ASSERT_TRUE(compressed_image->Parse(buffer, source_hash),
+              "Failed to parse the compressed image just encoded");
+  return compressed_image;
+}
+
+bool CompressedImage::WriteToFile(std::string_view cache_path) const {
+  // Caching is only an optimization, hence we don't throw exceptions here.
+  const stdfs::path path{cache_path};
+  const stdfs::path temp_path = path.string() + ".tmp";
+  std::error_code error_code;
+  stdfs::create_directories(path.parent_path(), error_code);
+  {
+    std::ofstream file{temp_path,
+                       std::ios::out | std::ios::binary | std::ios::trunc};
+    if (file) {
+      file.write(data_.data(), data_.size());
+    }
+    if (!file) {
+      LOG_ERROR << absl::StreamFormat(
+          "Failed to write compressed image cache '%s'", temp_path.string());
+      return false;
+    }
+  }
+  stdfs::rename(temp_path, path, error_code);
+  if (error_code) {
+    LOG_ERROR << absl::StreamFormat("Failed to rename '%s' to '%s': %s",
+                                    temp_path.string(), path.string(),
+                                    error_code.message());
+    stdfs::remove(temp_path, error_code);
+    return false;
+  }
+  return true;
+}
+
+bool CompressedImage::Parse(absl::Span<const char> data,
+                            const SourceHash& source_hash) {
+  if (data.size() < sizeof(Header)) {
+    return false;
+  }
+  Header header;
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != kMagic || header.version != kVersion ||
+      header.source_hash != source_hash || header.file_size != data.size() ||
+      header.format > static_cast<uint32_t>(Format::kBc7) ||
+      header.width == 0 || header.height == 0 ||
+      (header.layer != image::kSingleImageLayer &&
+       header.layer != image::kCubemapImageLayer) ||
+      header.num_levels == 0 ||
+      static_cast<int>(header.num_levels) >
+          MipChain::GetNumLevels(header.width, header.height)) {
+    return false;
+  }
+
+  const auto format = static_cast<Format>(header.format);
+  std::vector<Level> levels = ComputeLevels(format, header.width,
+                                            header.height, header.num_levels);
+  const std::vector<size_t> offsets = ComputeLevelOffsets(levels,
+                                                          header.layer);
+  if (header.data_offset != AlignOffset(sizeof(Header)) ||
+      header.file_size != header.data_offset + offsets.back()) {
+    return false;
+  }
+
+  std::vector<const void*> data_ptrs;
+  data_ptrs.reserve(levels.size() * header.layer);
+  for (int level = 0; level < levels.size(); ++level) {
+    for (int layer = 0; layer < header.layer; ++layer) {
+      data_ptrs.push_back(data.data() + header.data_offset + offsets[level] +
+                          levels[level].layer_size * layer);
+    }
+  }
+
+  data_ = data;
+  format_ = format;
+  layer_ = header.layer;
+  levels_ = std::move(levels);
+  data_ptrs_ = std::move(data_ptrs);
+  return true;
+}
+
+}  // namespace lighter::common
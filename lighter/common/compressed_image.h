@@ -0,0 +1,154 @@
+//
+//  compressed_image.h
+//
+//  Created by Pujun Lun on 6/24/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#ifndef LIGHTER_COMMON_COMPRESSED_IMAGE_H
+#define LIGHTER_COMMON_COMPRESSED_IMAGE_H
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lighter/common/block_compression.h"
+#include "lighter/common/file.h"
+#include "lighter/common/image.h"
+#include "lighter/common/mip_chain.h"
+#include "third_party/absl/types/span.h"
+
+namespace lighter::common {
+
+// Image encoded in a block-compressed format, which takes 1/8 (kBc1 and kBc4)
+// or 1/4 (others) of the memory of 8-bit RGBA texels, and can be sampled by
+// GPUs directly. It may contain a full mip chain.
+// All levels of all layers are stored in one contiguous blob, ordered by level
+// and then by layer, which can be written to and memory mapped from cache
+// files. Each cache file records the hash of its source, and it will be
+// treated as stale if the source or options change.
+class CompressedImage {
+ public:
+  using SourceHash = MipChain::SourceHash;
+  using Format = block_compression::Format;
+  using Quality = block_compression::Quality;
+
+  struct Options {
+    // If not specified, kBc4 is used for single-channel images, and kBc7 is
+    // used for others.
+    std::optional<Format> format;
+
+    Quality quality = Quality::kFast;
+  };
+
+  // Describes one level. 'layer_size' is the size of encoded data of each
+  // layer in bytes, which are tightly packed.
+  struct Level {
+    int width;
+    int height;
+    size_t layer_size;
+  };
+
+  // Returns the default format for images with 'channel' channels.
+  static Format GetDefaultFormat(int channel);
+
+  // Loads images from files with common::Image, generates the mip chain if
+  // 'mip_options' has value, and encodes all levels, or loads the result from
+  // the cache if it is up-to-date. 'paths' has the same requirement as the
+  // constructor of common::Image.
+  static std::unique_ptr<CompressedImage> LoadImageFiles(
+      absl::Span<const std::string> paths,
+      const std::optional<MipChain::Options>& mip_options,
+      const Options& options);
+
+  // Returns the hash of files at 'source_paths' and options.
+  static SourceHash ComputeSourceHash(
+      absl::Span<const std::string> source_paths,
+      const std::optional<MipChain::Options>& mip_options,
+      const Options& options);
+
+  // Returns the default path to the cache file of 'source_paths', which is
+  // located in the temporary directory.
+  static std::string GetDefaultCachePath(
+      absl::Span<const std::string> source_paths);
+
+  // Loads the image from the cache file at 'cache_path'. Returns nullptr if the
+  // file does not exist, or it is not valid for the source with 'source_hash'.
+  static std::unique_ptr<CompressedImage> LoadFromFile(
+      std::string_view cache_path, const SourceHash& source_hash);
+
+  // Encodes all levels of 'mip_chain', or the only level of 'image'. The number
+  // of channels must match the format. Blocks of each level are encoded in
+  // parallel.
+  static std::unique_ptr<CompressedImage> Encode(
+      const MipChain& mip_chain, const Options& options,
+      const SourceHash& source_hash = {});
+  static std::unique_ptr<CompressedImage> Encode(
+      const Image& image, const Options& options,
+      const SourceHash& source_hash = {});
+
+  // This class is neither copyable nor movable.
+  CompressedImage(const CompressedImage&) = delete;
+  CompressedImage& operator=(const CompressedImage&) = delete;
+
+  // Writes the image to 'cache_path'. The file is first written to a temporary
+  // path and then renamed, so readers never see a partially written file.
+  // Returns false if failed, in which case the cache file is left unchanged.
+  bool WriteToFile(std::string_view cache_path) const;
+
+  // Returns the pointer to data of 'layer' of 'level'.
+  const void* GetData(int level, int layer) const {
+    return data_ptrs_[level * this->layer() + layer];
+  }
+
+  // Accessors.
+  Format format() const { return format_; }
+  int width() const { return levels_[0].width; }
+  int height() const { return levels_[0].height; }
+  int layer() const { return layer_; }
+  int num_levels() const { return static_cast<int>(levels_.size()); }
+  const std::vector<Level>& levels() const { return levels_; }
+  // Pointers to data of each layer of each level, ordered by level and then by
+  // layer.
+  const std::vector<const void*>& data_ptrs() const { return data_ptrs_; }
+
+ private:
+  // Encodes 'num_levels' levels of images described by 'dimension'. 'datas'
+  // holds pointers to uncompressed data, ordered in the same way as
+  // 'data_ptrs_'.
+  static std::unique_ptr<CompressedImage> Encode(
+      const Image::Dimension& dimension, int num_levels,
+      absl::Span<const void* const> datas, const Options& options,
+      const SourceHash& source_hash);
+
+  // Interprets 'data' as the content of a cache file. Returns false if it is
+  // malformed or not valid for the source with 'source_hash'.
+  bool Parse(absl::Span<const char> data, const SourceHash& source_hash);
+
+  CompressedImage() = default;
+
+  // Holds the content of the cache file if loaded from disk.
+  std::unique_ptr<RawData> file_data_;
+
+  // Holds the content of the cache file if encoded in memory.
+  std::vector<char> buffer_;
+
+  // Content of the cache file, pointing to either 'file_data_' or 'buffer_'.
+  absl::Span<const char> data_;
+
+  // Encoded format.
+  Format format_ = Format::kBc7;
+
+  // Number of layers.
+  int layer_ = 0;
+
+  // Views into 'data_'.
+  std::vector<Level> levels_;
+  std::vector<const void*> data_ptrs_;
+};
+
+}  // namespace lighter::common
+
+#endif  // LIGHTER_COMMON_COMPRESSED_IMAGE_H
@@ -0,0 +1,95 @@
+//
+//  compressed_image_test.cc
+//
+//  Created by Pujun Lun on 6/24/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/compressed_image.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include "lighter/common/image.h"
+#include "lighter/common/mip_chain.h"
+
+#ifdef ASSERT_TRUE
+#undef ASSERT_TRUE
+#endif
+#ifdef ASSERT_FALSE
+#undef ASSERT_FALSE
+#endif
+#include "third_party/gtest/gtest.h"
+
+namespace lighter::common {
+namespace {
+
+using block_compression::Format;
+
+// Returns a cubemap mip chain of 'size' x 'size' texels with 'channel'
+// channels.
+std::unique_ptr<MipChain> CreateMipChain(int size, int channel) {
+  std::vector<std::vector<uint8_t>> layers;
+  std::vector<const void*> layer_datas;
+  for (int layer = 0; layer < image::kCubemapImageLayer; ++layer) {
+    auto& pixels = layers.emplace_back();
+    for (int i = 0; i < size * size * channel; ++i) {
+      pixels.push_back(static_cast<uint8_t>(i * (layer + 1)));
+    }
+    layer_datas.push_back(pixels.data());
+  }
+  return MipChain::Generate(
+      Image::Dimension{size, size, channel, image::kCubemapImageLayer},
+      layer_datas, MipChain::Options{});
+}
+
+TEST(CompressedImageTest, EncodeAllLevels) {
+  const auto mip_chain = CreateMipChain(/*size=*/30, image::kRgbaImageChannel);
+  const auto compressed_image =
+      CompressedImage::Encode(*mip_chain, CompressedImage::Options{});
+  EXPECT_EQ(compressed_image->format(), Format::kBc7);
+  ASSERT_EQ(compressed_image->num_levels(), mip_chain->num_levels());
+  EXPECT_EQ(compressed_image->layer(), image::kCubemapImageLayer);
+  for (int level = 0; level < compressed_image->num_levels(); ++level) {
+    const auto& extent = compressed_image->levels()[level];
+    EXPECT_EQ(extent.width, mip_chain->levels()[level].width);
+    EXPECT_EQ(extent.height, mip_chain->levels()[level].height);
+    EXPECT_EQ(extent.layer_size, block_compression::GetEncodedSize(
+        Format::kBc7, extent.width, extent.height));
+    // Levels must be aligned for copying to images.
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(
+                  compressed_image->GetData(level, 0)) % 16, 0);
+  }
+}
+
+TEST(CompressedImageTest, CacheRoundTrip) {
+  const auto mip_chain = CreateMipChain(/*size=*/16, image::kBwImageChannel);
+  const CompressedImage::SourceHash source_hash{4, 5, 6};
+  const auto compressed_image = CompressedImage::Encode(
+      *mip_chain, CompressedImage::Options{}, source_hash);
+  EXPECT_EQ(compressed_image->format(), Format::kBc4);
+  const std::string cache_path =
+      (std::filesystem::temp_directory_path() / "compressed_image_test.bcim")
+          .string();
+  ASSERT_TRUE(compressed_image->WriteToFile(cache_path));
+
+  EXPECT_EQ(CompressedImage::LoadFromFile(cache_path, /*source_hash=*/{}),
+            nullptr);
+  const auto loaded = CompressedImage::LoadFromFile(cache_path, source_hash);
+  ASSERT_NE(loaded, nullptr);
+  EXPECT_EQ(loaded->format(), Format::kBc4);
+  ASSERT_EQ(loaded->num_levels(), compressed_image->num_levels());
+  for (int level = 0; level < loaded->num_levels(); ++level) {
+    for (int layer = 0; layer < loaded->layer(); ++layer) {
+      EXPECT_EQ(std::memcmp(loaded->GetData(level, layer),
+                            compressed_image->GetData(level, layer),
+                            loaded->levels()[level].layer_size), 0);
+    }
+  }
+  std::filesystem::remove(cache_path);
+}
+
+}  // namespace
+}  // namespace lighter::common
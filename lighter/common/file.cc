@@ -7,16 +7,28 @@
 
 #include "lighter/common/file.h"
 
+#include <algorithm>
+#include <charconv>
 #include <cstdlib>
-#include <exception>
+#include <cstring>
 #include <fstream>
+#include <optional>
 
+#if defined(__linux__) || defined(__APPLE__)
+#define SUPPORT_MEMORY_MAPPING
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // __linux__ || __APPLE__
+
+#include "lighter/common/packing.h"
 #include "lighter/common/util.h"
 #include "lighter/shader_compiler/util.h"
 #include "third_party/absl/container/flat_hash_map.h"
+#include "third_party/absl/functional/function_ref.h"
 #include "third_party/absl/strings/str_format.h"
 #include "third_party/absl/strings/str_replace.h"
-#include "third_party/absl/strings/str_split.h"
 #include "tools/cpp/runfiles/runfiles.h"
 
 #undef VULKAN_FOLDER
@@ -66,17 +78,588 @@ std::ifstream OpenFile(std::string_view path) {
   return file;
 }
 
-// Splits the given 'text' by 'delimiter', while 'num_segments' is the expected
-// length of results. An exception will be thrown if the length does not match.
-std::vector<std::string> SplitText(std::string_view text, char delimiter,
-                                   int num_segments) {
-  const std::vector<std::string> segments =
-      absl::StrSplit(text, delimiter, absl::SkipWhitespace{});
-  ASSERT_TRUE(
-      segments.size() == num_segments,
-      absl::StrFormat("Invalid number of segments (expected %d, but get %d)",
-                      num_segments, segments.size()));
-  return segments;
+// Indices of attributes used by one vertex of a face, which are 0-based. If an
+// attribute is not specified, its index will be kNoIndex.
+struct ObjFaceVertex {
+  static constexpr int kNoIndex = -1;
+
+  // Enables using this struct as the key of absl hash containers.
+  template <typename H>
+  friend H AbslHashValue(H hash, const ObjFaceVertex& vertex) {
+    return H::combine(std::move(hash),
+                      vertex.pos, vertex.tex_coord, vertex.norm);
+  }
+
+  friend bool operator==(const ObjFaceVertex& lhs, const ObjFaceVertex& rhs) {
+    return lhs.pos == rhs.pos && lhs.tex_coord == rhs.tex_coord &&
+           lhs.norm == rhs.norm;
+  }
+
+  int pos = kNoIndex;
+  int tex_coord = kNoIndex;
+  int norm = kNoIndex;
+};
+
+// Numbers of each kind of vertex attributes.
+struct ObjAttributeCounts {
+  int positions = 0;
+  int tex_coords = 0;
+  int normals = 0;
+};
+
+// Parses a chunk of Wavefront .obj file, which consists of complete lines. The
+// chunk is scanned only once, and numbers are parsed in place with
+// std::from_chars, so that no memory is allocated per line. Only data used for
+// building meshes ('v', 'vt', 'vn' and 'f') is parsed, while grouping and
+// material statements are ignored.
+// Since chunks may be parsed in parallel, relative (i.e. negative) indices can
+// only be resolved after we know how many attributes are defined in preceding
+// chunks. Hence, ResolveIndices() must be called after Parse().
+class ObjChunkParser {
+ public:
+  // 'file_begin' is only used for computing line numbers in error messages.
+  // If 'pos_only' is true, texture coordinates and normals will be skipped.
+  ObjChunkParser(std::string_view path, const char* file_begin,
+                 int index_base, bool pos_only)
+      : path_{path}, file_begin_{file_begin}, index_base_{index_base},
+        pos_only_{pos_only} {}
+
+  // This class is only move-constructible.
+  ObjChunkParser(ObjChunkParser&&) noexcept = default;
+  ObjChunkParser& operator=(ObjChunkParser&&) = delete;
+
+  // Parses lines in range ['begin', 'end').
+  void Parse(const char* begin, const char* end) {
+    chunk_begin_ = begin;
+    const char* line_begin = begin;
+    for (line_index_ = 0; line_begin < end; ++line_index_) {
+      const char* line_end = static_cast<const char*>(
+          std::memchr(line_begin, '\n', end - line_begin));
+      if (line_end == nullptr) {
+        line_end = end;
+      }
+      ParseLine(line_begin, line_end);
+      line_begin = line_end + 1;
+    }
+  }
+
+  // Converts relative indices of face vertices to absolute indices, given the
+  // number of attributes defined in preceding chunks, and checks whether all
+  // indices are in range given the total number of attributes in the file.
+  void ResolveIndices(const ObjAttributeCounts& num_preceding_attributes,
+                      const ObjAttributeCounts& num_total_attributes) {
+    for (const auto& [index, flags] : relative_face_vertices_) {
+      ObjFaceVertex& vertex = face_vertices_[index];
+      if (flags & kPosRelative) {
+        vertex.pos += num_preceding_attributes.positions;
+        CheckRelativeIndex(vertex.pos);
+      }
+      if (flags & kTexCoordRelative) {
+        vertex.tex_coord += num_preceding_attributes.tex_coords;
+        CheckRelativeIndex(vertex.tex_coord);
+      }
+      if (flags & kNormRelative) {
+        vertex.norm += num_preceding_attributes.normals;
+        CheckRelativeIndex(vertex.norm);
+      }
+    }
+
+    // Unspecified indices are kNoIndex, which never exceeds the upper bound.
+    for (const ObjFaceVertex& vertex : face_vertices_) {
+      CheckUpperBound(vertex.pos, num_total_attributes.positions, "position");
+      CheckUpperBound(vertex.tex_coord, num_total_attributes.tex_coords,
+                      "texture coordinates");
+      CheckUpperBound(vertex.norm, num_total_attributes.normals, "normal");
+    }
+  }
+
+  // Returns the number of each kind of attributes defined in this chunk.
+  ObjAttributeCounts GetAttributeCounts() const {
+    return {static_cast<int>(positions_.size()),
+            static_cast<int>(tex_coords_.size()),
+            static_cast<int>(normals_.size())};
+  }
+
+  // Accessors.
+  const std::vector<glm::vec3>& positions() const { return positions_; }
+  const std::vector<glm::vec3>& normals() const { return normals_; }
+  const std::vector<glm::vec2>& tex_coords() const { return tex_coords_; }
+  const std::vector<ObjFaceVertex>& face_vertices() const {
+    return face_vertices_;
+  }
+
+ private:
+  // Flags indicating which indices of a face vertex are relative to the number
+  // of attributes defined in this chunk.
+  enum RelativeIndexFlag {
+    kPosRelative = 1U << 0,
+    kTexCoordRelative = 1U << 1,
+    kNormRelative = 1U << 2,
+  };
+
+  // Face vertex that contains relative indices.
+  struct RelativeFaceVertex {
+    // Index into 'face_vertices_'.
+    size_t index;
+    // Bitwise OR of RelativeIndexFlag.
+    unsigned int flags;
+  };
+
+  // Returns true if 'c' separates tokens within a line.
+  static bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+  // Returns the first non-space character starting from 'ptr'.
+  static const char* SkipSpaces(const char* ptr, const char* end) {
+    while (ptr < end && IsSpace(*ptr)) {
+      ++ptr;
+    }
+    return ptr;
+  }
+
+  // Returns the end of the token starting from 'ptr'.
+  static const char* FindTokenEnd(const char* ptr, const char* end) {
+    while (ptr < end && !IsSpace(*ptr)) {
+      ++ptr;
+    }
+    return ptr;
+  }
+
+  // Throws a runtime exception with the line number and 'error'.
+  [[noreturn]] void ReportError(std::string_view error) const {
+    // Line numbers are only computed when needed, since we have to count
+    // lines in all preceding chunks.
+    const auto line_num = std::count(file_begin_, chunk_begin_, '\n') +
+                          line_index_ + 1;
+    FATAL(absl::StrFormat("Failed to parse line %d of '%s': %s",
+                          line_num, path_, error));
+  }
+
+  // Throws a runtime exception if a relative index is resolved to be negative.
+  void CheckRelativeIndex(int index) const {
+    if (index < 0) {
+      FATAL(absl::StrFormat("Relative index out of range in '%s'", path_));
+    }
+  }
+
+  // Throws a runtime exception if 'index' is not less than 'num_attributes'.
+  void CheckUpperBound(int index, int num_attributes,
+                       std::string_view attribute_name) const {
+    if (index >= num_attributes) {
+      FATAL(absl::StrFormat(
+          "Index of %s out of range in '%s' (%d, but only %d defined)",
+          attribute_name, path_, index + index_base_, num_attributes));
+    }
+  }
+
+  // Parses one number starting from 'ptr' and moves 'ptr' past it.
+  template <typename NumberType>
+  NumberType ParseNumber(const char*& ptr, const char* end) const {
+    if (ptr < end && *ptr == '+') {
+      // std::from_chars() does not accept the leading plus sign.
+      ++ptr;
+    }
+    NumberType number;
+    const auto [parsed_end, error_code] = std::from_chars(ptr, end, number);
+    if (error_code != std::errc{}) {
+      ReportError(absl::StrFormat(
+          "Expecting a number, but get '%s'",
+          std::string_view{ptr, static_cast<size_t>(
+                                    FindTokenEnd(ptr, end) - ptr)}));
+    }
+    ptr = parsed_end;
+    return number;
+  }
+
+  // Parses a vector of floats from space-separated numbers. Extra numbers
+  // (such as the optional 'w' component of positions) are ignored.
+  template <typename VectorType>
+  VectorType ParseVector(const char* ptr, const char* end) const {
+    VectorType vector;
+    for (int i = 0; i < VectorType::length(); ++i) {
+      ptr = SkipSpaces(ptr, end);
+      vector[i] = ParseNumber<float>(ptr, end);
+    }
+    return vector;
+  }
+
+  // Parses one index of a face vertex and converts it to be 0-based. If it is
+  // a relative index, 'relative_flag' will be added to 'relative_flags', and
+  // the index is resolved against 'num_attributes' defined in this chunk.
+  int ParseIndex(const char*& ptr, const char* end, size_t num_attributes,
+                 RelativeIndexFlag relative_flag,
+                 unsigned int& relative_flags) const {
+    const int index = ParseNumber<int>(ptr, end);
+    if (index < 0) {
+      relative_flags |= relative_flag;
+      return static_cast<int>(num_attributes) + index;
+    }
+    if (index < index_base_) {
+      ReportError(absl::StrFormat("Index %d is less than index base %d",
+                                  index, index_base_));
+    }
+    return index - index_base_;
+  }
+
+  // Parses the text of one vertex of a face, which can be in any of these
+  // forms: "v", "v/vt", "v//vn" and "v/vt/vn". If 'pos_only_' is true, only the
+  // index of position will be parsed.
+  ObjFaceVertex ParseFaceVertex(std::string_view text,
+                                unsigned int& relative_flags) const {
+    const char* ptr = text.data();
+    const char* const end = ptr + text.size();
+    ObjFaceVertex vertex;
+    vertex.pos = ParseIndex(ptr, end, positions_.size(), kPosRelative,
+                            relative_flags);
+    if (pos_only_ || ptr == end || *ptr != '/') {
+      return vertex;
+    }
+    if (++ptr < end && *ptr == '/') {
+      // "v//vn".
+      ++ptr;
+    } else {
+      vertex.tex_coord = ParseIndex(ptr, end, tex_coords_.size(),
+                                    kTexCoordRelative, relative_flags);
+      if (ptr == end || *ptr != '/') {
+        return vertex;
+      }
+      ++ptr;
+    }
+    vertex.norm = ParseIndex(ptr, end, normals_.size(), kNormRelative,
+                             relative_flags);
+    return vertex;
+  }
+
+  // Parses the line in range ['line_begin', 'line_end').
+  void ParseLine(const char* line_begin, const char* line_end) {
+    const char* ptr = SkipSpaces(line_begin, line_end);
+    if (ptr == line_end || *ptr == '#') {
+      // Skip blank lines and comments.
+      return;
+    }
+
+    const char* keyword_end = FindTokenEnd(ptr, line_end);
+    const std::string_view keyword{ptr,
+                                   static_cast<size_t>(keyword_end - ptr)};
+    if (keyword == "v") {
+      positions_.push_back(ParseVector<glm::vec3>(keyword_end, line_end));
+    } else if (keyword == "vn") {
+      if (!pos_only_) {
+        normals_.push_back(ParseVector<glm::vec3>(keyword_end, line_end));
+      }
+    } else if (keyword == "vt") {
+      if (!pos_only_) {
+        tex_coords_.push_back(ParseVector<glm::vec2>(keyword_end, line_end));
+      }
+    } else if (keyword == "f") {
+      ParseFace(keyword_end, line_end);
+    } else if (keyword != "o" && keyword != "g" && keyword != "s" &&
+               keyword != "usemtl" && keyword != "mtllib") {
+      ReportError(absl::StrFormat("Unexpected keyword '%s'", keyword));
+    }
+  }
+
+  // Parses vertices of a face, and triangulates it as a triangle fan if it has
+  // more than 3 vertices.
+  void ParseFace(const char* ptr, const char* end) {
+    int num_vertices = 0;
+    ObjFaceVertex first_vertex, prev_vertex;
+    unsigned int first_flags = 0, prev_flags = 0;
+    while ((ptr = SkipSpaces(ptr, end)) < end) {
+      const char* token_end = FindTokenEnd(ptr, end);
+      unsigned int flags = 0;
+      const ObjFaceVertex vertex = ParseFaceVertex(
+          std::string_view{ptr, static_cast<size_t>(token_end - ptr)}, flags);
+      ptr = token_end;
+
+      if (num_vertices >= 2) {
+        AddFaceVertex(first_vertex, first_flags);
+        AddFaceVertex(prev_vertex, prev_flags);
+        AddFaceVertex(vertex, flags);
+      } else if (num_vertices == 0) {
+        first_vertex = vertex;
+        first_flags = flags;
+      }
+      prev_vertex = vertex;
+      prev_flags = flags;
+      ++num_vertices;
+    }
+    if (num_vertices < 3) {
+      ReportError(absl::StrFormat(
+          "Expecting at least 3 vertices for a face, but get %d",
+          num_vertices));
+    }
+  }
+
+  // Appends 'vertex' to 'face_vertices_', and records it if it contains any
+  // relative index.
+  void AddFaceVertex(const ObjFaceVertex& vertex, unsigned int relative_flags) {
+    if (relative_flags != 0) {
+      relative_face_vertices_.push_back({face_vertices_.size(),
+                                         relative_flags});
+    }
+    face_vertices_.push_back(vertex);
+  }
+
+  // Path to the file, used for error messages.
+  const std::string_view path_;
+
+  // Beginning of the whole file and this chunk, used for error messages.
+  const char* const file_begin_;
+  const char* chunk_begin_ = nullptr;
+
+  // Index of the first element in the file.
+  const int index_base_;
+
+  // Whether to skip texture coordinates and normals.
+  const bool pos_only_;
+
+  // Index of the line being parsed within this chunk.
+  int line_index_ = 0;
+
+  // Attributes defined in this chunk.
+  std::vector<glm::vec3> positions_;
+  std::vector<glm::vec3> normals_;
+  std::vector<glm::vec2> tex_coords_;
+
+  // Vertices of triangles. Every 3 consecutive vertices form one triangle.
+  std::vector<ObjFaceVertex> face_vertices_;
+
+  // Face vertices that contain relative indices.
+  std::vector<RelativeFaceVertex> relative_face_vertices_;
+};
+
+// Parses Wavefront .obj files. The file content is split into chunks at line
+// boundaries, and chunks are parsed in parallel if more than one thread is
+// allowed. Attributes of all chunks are concatenated afterwards, and indices of
+// face vertices are resolved to index into them.
+class ObjParser {
+ public:
+  // Each chunk should be large enough to make spawning a thread worthwhile.
+  static constexpr size_t kMinChunkSize = 1 << 20;
+
+  ObjParser(std::string_view path, int index_base, bool pos_only,
+            int num_threads)
+      : raw_data_{path, RawData::Mode::kMemoryMapped} {
+    ASSERT_TRUE(num_threads > 0,
+                absl::StrFormat("Invalid number of threads: %d", num_threads));
+    const char* const file_begin = raw_data_.data;
+    const char* const file_end = file_begin + raw_data_.size;
+    const int num_chunks = static_cast<int>(std::clamp<size_t>(
+        raw_data_.size / kMinChunkSize, 1, num_threads));
+
+    // Move each boundary to the beginning of the next line.
+    std::vector<const char*> boundaries{file_begin};
+    for (int i = 1; i < num_chunks; ++i) {
+      const char* target = std::max(
+          file_begin + raw_data_.size * i / num_chunks, boundaries.back());
+      const auto* line_end = static_cast<const char*>(
+          std::memchr(target, '\n', file_end - target));
+      boundaries.push_back(line_end == nullptr ? file_end : line_end + 1);
+    }
+    boundaries.push_back(file_end);
+
+    chunks_.reserve(num_chunks);
+    for (int i = 0; i < num_chunks; ++i) {
+      chunks_.emplace_back(path, file_begin, index_base, pos_only);
+    }
+    util::ParallelFor(num_chunks, [this, &boundaries](int chunk) {
+      chunks_[chunk].Parse(boundaries[chunk], boundaries[chunk + 1]);
+    });
+
+    std::vector<ObjAttributeCounts> num_preceding_attributes(num_chunks);
+    ObjAttributeCounts num_total_attributes;
+    for (int i = 0; i < num_chunks; ++i) {
+      num_preceding_attributes[i] = num_total_attributes;
+      const ObjAttributeCounts counts = chunks_[i].GetAttributeCounts();
+      num_total_attributes.positions += counts.positions;
+      num_total_attributes.tex_coords += counts.tex_coords;
+      num_total_attributes.normals += counts.normals;
+    }
+
+    positions_.reserve(num_total_attributes.positions);
+    tex_coords_.reserve(num_total_attributes.tex_coords);
+    normals_.reserve(num_total_attributes.normals);
+    for (const auto& chunk : chunks_) {
+      positions_.insert(positions_.end(),
+                        chunk.positions().begin(), chunk.positions().end());
+      tex_coords_.insert(tex_coords_.end(),
+                         chunk.tex_coords().begin(), chunk.tex_coords().end());
+      normals_.insert(normals_.end(),
+                      chunk.normals().begin(), chunk.normals().end());
+    }
+
+    util::ParallelFor(num_chunks, [&](int chunk) {
+      chunks_[chunk].ResolveIndices(num_preceding_attributes[chunk],
+                                    num_total_attributes);
+    });
+  }
+
+  // This class is neither copyable nor movable.
+  ObjParser(const ObjParser&) = delete;
+  ObjParser& operator=(const ObjParser&) = delete;
+
+  // Returns face vertices of the chunk at 'chunk_index'.
+  const std::vector<ObjFaceVertex>& GetFaceVertices(int chunk_index) const {
+    return chunks_[chunk_index].face_vertices();
+  }
+
+  // Returns the number of each kind of attributes defined in the file.
+  ObjAttributeCounts GetAttributeCounts() const {
+    return {static_cast<int>(positions_.size()),
+            static_cast<int>(tex_coords_.size()),
+            static_cast<int>(normals_.size())};
+  }
+
+  // Returns the number of chunks.
+  int num_chunks() const { return chunks_.size(); }
+
+  // Accessors.
+  const std::vector<glm::vec3>& positions() const { return positions_; }
+  const std::vector<glm::vec3>& normals() const { return normals_; }
+  const std::vector<glm::vec2>& tex_coords() const { return tex_coords_; }
+
+ private:
+  // Content of the file.
+  const RawData raw_data_;
+
+  // Parsers of chunks.
+  std::vector<ObjChunkParser> chunks_;
+
+  // Attributes defined in the whole file.
+  std::vector<glm::vec3> positions_;
+  std::vector<glm::vec3> normals_;
+  std::vector<glm::vec2> tex_coords_;
+};
+
+// Packs indices of a face vertex into one 64-bit integer, which is much cheaper
+// to hash and compare than separate indices. Each index is stored plus one, so
+// that kNoIndex becomes 0, and the number of bits used for each kind of index
+// is determined by the number of attributes in the file.
+class ObjFaceVertexPacker {
+ public:
+  // Returns std::nullopt if indices can't fit in 64 bits in total.
+  static std::optional<ObjFaceVertexPacker> Create(
+      const ObjAttributeCounts& num_attributes) {
+    const int pos_bits = GetNumBits(num_attributes.positions);
+    const int tex_coord_bits = GetNumBits(num_attributes.tex_coords);
+    const int norm_bits = GetNumBits(num_attributes.normals);
+    if (pos_bits + tex_coord_bits + norm_bits > 64) {
+      return std::nullopt;
+    }
+    return ObjFaceVertexPacker{/*pos_shift=*/tex_coord_bits + norm_bits,
+                               /*tex_coord_shift=*/norm_bits};
+  }
+
+  // Returns the packed key of 'vertex'.
+  uint64_t Pack(const ObjFaceVertex& vertex) const {
+    return (static_cast<uint64_t>(vertex.pos + 1) << pos_shift_) |
+           (static_cast<uint64_t>(vertex.tex_coord + 1) << tex_coord_shift_) |
+           static_cast<uint64_t>(vertex.norm + 1);
+  }
+
+ private:
+  ObjFaceVertexPacker(int pos_shift, int tex_coord_shift)
+      : pos_shift_{pos_shift}, tex_coord_shift_{tex_coord_shift} {}
+
+  // Returns the number of bits needed to store values in range [0, 'count'].
+  static int GetNumBits(int count) {
+    int num_bits = 0;
+    for (auto value = static_cast<unsigned int>(count); value != 0;
+         value >>= 1) {
+      ++num_bits;
+    }
+    return num_bits;
+  }
+
+  // Offsets of each kind of index within the packed key.
+  int pos_shift_;
+  int tex_coord_shift_;
+};
+
+// Deduplicates face vertices of all chunks parsed by 'parser'. Face vertices
+// are identified by the key returned by 'get_key', and 'make_vertex' is called
+// with the first occurrence of each unique face vertex. Each chunk is first
+// deduplicated on its own in parallel, and then local tables are merged in
+// chunk order, so results are always the same as if all face vertices are
+// deduplicated sequentially. 'num_unique_vertices_hint' is the estimated number
+// of unique vertices in the file, which is used to reserve space for hash maps
+// in order to avoid rehashing.
+template <typename KeyType, typename VertexType, typename GetKey>
+void DeduplicateVertices(
+    const ObjParser& parser, const GetKey& get_key,
+    absl::FunctionRef<VertexType(const ObjFaceVertex&)> make_vertex,
+    size_t num_unique_vertices_hint,
+    std::vector<uint32_t>& indices, std::vector<VertexType>& vertices) {
+  struct ChunkVertices {
+    // Unique face vertices in the order of first occurrence.
+    std::vector<const ObjFaceVertex*> unique_vertices;
+    // Indices into 'unique_vertices'.
+    std::vector<uint32_t> indices;
+  };
+
+  const int num_chunks = parser.num_chunks();
+  std::vector<ChunkVertices> chunks(num_chunks);
+  util::ParallelFor(num_chunks, [&](int chunk_index) {
+    ChunkVertices& chunk = chunks[chunk_index];
+    const auto& face_vertices = parser.GetFaceVertices(chunk_index);
+    absl::flat_hash_map<KeyType, uint32_t> loaded_vertices;
+    loaded_vertices.reserve(
+        std::min(face_vertices.size(), num_unique_vertices_hint));
+    chunk.unique_vertices.reserve(loaded_vertices.capacity());
+    chunk.indices.reserve(face_vertices.size());
+    for (const ObjFaceVertex& vertex : face_vertices) {
+      const auto [iter, inserted] = loaded_vertices.insert(
+          {get_key(vertex), static_cast<uint32_t>(
+                                chunk.unique_vertices.size())});
+      if (inserted) {
+        chunk.unique_vertices.push_back(&vertex);
+      }
+      chunk.indices.push_back(iter->second);
+    }
+  });
+
+  // If there is only one chunk, local indices are already final.
+  if (num_chunks == 1) {
+    indices = std::move(chunks[0].indices);
+    vertices.reserve(chunks[0].unique_vertices.size());
+    for (const ObjFaceVertex* vertex : chunks[0].unique_vertices) {
+      vertices.push_back(make_vertex(*vertex));
+    }
+    return;
+  }
+
+  // Merge sequentially, so that new vertices are numbered in the order of first
+  // occurrence in the whole file. Local indices are remapped afterwards.
+  absl::flat_hash_map<KeyType, uint32_t> loaded_vertices;
+  loaded_vertices.reserve(num_unique_vertices_hint);
+  vertices.reserve(num_unique_vertices_hint);
+  std::vector<std::vector<uint32_t>> remaps(num_chunks);
+  std::vector<size_t> index_offsets(num_chunks);
+  size_t num_indices = 0;
+  for (int i = 0; i < num_chunks; ++i) {
+    const ChunkVertices& chunk = chunks[i];
+    remaps[i].reserve(chunk.unique_vertices.size());
+    for (const ObjFaceVertex* vertex : chunk.unique_vertices) {
+      const auto [iter, inserted] = loaded_vertices.insert(
+          {get_key(*vertex), static_cast<uint32_t>(vertices.size())});
+      if (inserted) {
+        vertices.push_back(make_vertex(*vertex));
+      }
+      remaps[i].push_back(iter->second);
+    }
+    index_offsets[i] = num_indices;
+    num_indices += chunk.indices.size();
+  }
+
+  indices.resize(num_indices);
+  util::ParallelFor(num_chunks, [&](int chunk_index) {
+    const std::vector<uint32_t>& remap = remaps[chunk_index];
+    const std::vector<uint32_t>& local_indices = chunks[chunk_index].indices;
+    uint32_t* dst = indices.data() + index_offsets[chunk_index];
+    for (size_t i = 0; i < local_indices.size(); ++i) {
+      dst[i] = remap[local_indices[i]];
+    }
+  });
 }
 
 }  // namespace
@@ -118,7 +701,66 @@ std::string GetVulkanSdkPath(std::string_view relative_path) {
 
 }  // namespace file
 
-RawData::RawData(std::string_view path) {
+RawData::RawData(std::string_view path, Mode mode) {
+  if (mode == Mode::kMemoryMapped && MapFile(path)) {
+    return;
+  }
+  CopyFile(path);
+}
+
+RawData::~RawData() {
+#ifdef SUPPORT_MEMORY_MAPPING
+  if (is_memory_mapped_) {
+    munmap(const_cast<char*>(data), size);
+    return;
+  }
+#endif  // SUPPORT_MEMORY_MAPPING
+  delete[] data;
+}
+
+bool RawData::MapFile(std::string_view path) {
+#ifdef SUPPORT_MEMORY_MAPPING
+  const int fd = open(std::string{path}.c_str(), O_RDONLY);
+  ASSERT_TRUE(fd >= 0, absl::StrFormat("Failed to open file '%s'", path));
+
+  struct stat file_stat{};
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+    // mmap() does not accept zero length, so empty files are read instead.
+    close(fd);
+    return false;
+  }
+
+  // On Linux, MAP_POPULATE prefaults the page tables, so that we don't take a
+  // page fault on each page when the data is parsed sequentially afterwards.
+  int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+  flags |= MAP_POPULATE;
+#endif  // MAP_POPULATE
+  const auto file_size = static_cast<size_t>(file_stat.st_size);
+  void* mapped = mmap(/*addr=*/nullptr, file_size, PROT_READ, flags, fd,
+                      /*offset=*/0);
+  // The mapping stays valid after the file descriptor is closed.
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    return false;
+  }
+
+  // Readers always consume the whole file from the beginning, so let the
+  // kernel read ahead aggressively. These are hints only, hence we don't care
+  // if they fail.
+  madvise(mapped, file_size, MADV_SEQUENTIAL);
+  madvise(mapped, file_size, MADV_WILLNEED);
+
+  data = static_cast<const char*>(mapped);
+  size = file_size;
+  is_memory_mapped_ = true;
+  return true;
+#else  // !SUPPORT_MEMORY_MAPPING
+  return false;
+#endif  // SUPPORT_MEMORY_MAPPING
+}
+
+void RawData::CopyFile(std::string_view path) {
   std::ifstream file = OpenFile(path);
   file.seekg(0, std::ios::end);
   size = file.tellg();
@@ -127,6 +769,7 @@ RawData::RawData(std::string_view path) {
   file.read(content, size);
   ASSERT_TRUE(file, absl::StrFormat("Failed to read file '%s'", path));
   data = content;
+  is_memory_mapped_ = false;
 }
 
 #define APPEND_ATTRIBUTES(attributes, type, member) \
@@ -167,8 +810,136 @@ std::vector<VertexAttribute> Vertex3DWithTex::GetVertexAttributes() {
   return attributes;
 }
 
+std::vector<VertexAttribute> Vertex3DNormTex::GetVertexAttributes() {
+  std::vector<VertexAttribute> attributes;
+  APPEND_ATTRIBUTES(attributes, Vertex3DNormTex, norm);
+  APPEND_ATTRIBUTES(attributes, Vertex3DNormTex, tex_coord);
+  return attributes;
+}
+
+std::vector<VertexAttribute> Vertex3DCompressed::GetVertexAttributes() {
+  std::vector<VertexAttribute> attributes;
+  APPEND_ATTRIBUTES(attributes, Vertex3DCompressed, pos);
+  APPEND_ATTRIBUTES(attributes, Vertex3DCompressed, norm);
+  APPEND_ATTRIBUTES(attributes, Vertex3DCompressed, tex_coord);
+  return attributes;
+}
+
+std::vector<VertexAttribute> Vertex3DQuantized::GetVertexAttributes() {
+  std::vector<VertexAttribute> attributes;
+  APPEND_ATTRIBUTES(attributes, Vertex3DQuantized, pos);
+  APPEND_ATTRIBUTES(attributes, Vertex3DQuantized, norm);
+  APPEND_ATTRIBUTES(attributes, Vertex3DQuantized, tex_coord);
+  return attributes;
+}
+
 #undef APPEND_ATTRIBUTES
 
+namespace {
+
+// Returns the octahedral-encoded 'normal'. Zero normals are encoded as if they
+// are pointing to +Z.
+Snorm16Vec2 EncodeNormal(const glm::vec3& normal) {
+  const float length = glm::length(normal);
+  const glm::vec2 encoded = length > 0.0f
+      ? packing::EncodeOctahedral(normal / length)
+      : glm::vec2{0.0f};
+  return {packing::FloatToSnorm16(encoded.x),
+          packing::FloatToSnorm16(encoded.y)};
+}
+
+HalfVec2 EncodeTexCoord(const glm::vec2& tex_coord) {
+  return {packing::FloatToHalf(tex_coord.x), packing::FloatToHalf(tex_coord.y)};
+}
+
+}  // namespace
+
+Vertex3DCompressed Vertex3DCompressed::Create(const Vertex3DWithTex& vertex) {
+  return {vertex.pos, EncodeNormal(vertex.norm),
+          EncodeTexCoord(vertex.tex_coord)};
+}
+
+PositionQuantization PositionQuantization::Create(
+    absl::Span<const Vertex3DWithTex> vertices) {
+  if (vertices.empty()) {
+    return {/*scale=*/glm::vec3{1.0f}, /*bias=*/glm::vec3{0.0f}};
+  }
+
+  glm::vec3 min_pos = vertices[0].pos, max_pos = vertices[0].pos;
+  for (const auto& vertex : vertices) {
+    min_pos = glm::min(min_pos, vertex.pos);
+    max_pos = glm::max(max_pos, vertex.pos);
+  }
+  return Create(min_pos, max_pos);
+}
+
+PositionQuantization PositionQuantization::Create(const glm::vec3& min_pos,
+                                                  const glm::vec3& max_pos) {
+  // Avoid dividing by zero if the mesh is flat along any axis.
+  const glm::vec3 half_extent = glm::max((max_pos - min_pos) / 2.0f,
+                                         glm::vec3{1e-20f});
+  return {/*scale=*/half_extent, /*bias=*/(min_pos + max_pos) / 2.0f};
+}
+
+Vertex3DQuantized Vertex3DQuantized::Create(
+    const Vertex3DWithTex& vertex, const PositionQuantization& quantization) {
+  const glm::vec3 pos = (vertex.pos - quantization.bias) / quantization.scale;
+  return {
+      /*pos=*/{packing::FloatToSnorm16(pos.x), packing::FloatToSnorm16(pos.y),
+               packing::FloatToSnorm16(pos.z), packing::FloatToSnorm16(1.0f)},
+      EncodeNormal(vertex.norm),
+      EncodeTexCoord(vertex.tex_coord),
+  };
+}
+
+std::vector<Vertex3DCompressed> CompressVertices(
+    absl::Span<const Vertex3DWithTex> vertices) {
+  std::vector<Vertex3DCompressed> compressed;
+  compressed.reserve(vertices.size());
+  for (const auto& vertex : vertices) {
+    compressed.push_back(Vertex3DCompressed::Create(vertex));
+  }
+  return compressed;
+}
+
+std::vector<Vertex3DQuantized> QuantizeVertices(
+    absl::Span<const Vertex3DWithTex> vertices,
+    PositionQuantization* quantization) {
+  *quantization = PositionQuantization::Create(vertices);
+  std::vector<Vertex3DQuantized> quantized;
+  quantized.reserve(vertices.size());
+  for (const auto& vertex : vertices) {
+    quantized.push_back(Vertex3DQuantized::Create(vertex, *quantization));
+  }
+  return quantized;
+}
+
+SplitVertexStreams SplitVertices(absl::Span<const Vertex3DWithTex> vertices) {
+  SplitVertexStreams streams;
+  streams.positions.resize(vertices.size());
+  streams.attributes.resize(vertices.size());
+  for (int i = 0; i < vertices.size(); ++i) {
+    streams.positions[i].pos = vertices[i].pos;
+    streams.attributes[i] = {vertices[i].norm, vertices[i].tex_coord};
+  }
+  return streams;
+}
+
+std::vector<Vertex3DWithTex> InterleaveVertices(
+    absl::Span<const Vertex3DPosOnly> positions,
+    absl::Span<const Vertex3DNormTex> attributes) {
+  ASSERT_TRUE(positions.size() == attributes.size(),
+              absl::StrFormat("Streams have different number of vertices "
+                              "(%d vs %d)", positions.size(),
+                              attributes.size()));
+  std::vector<Vertex3DWithTex> vertices(positions.size());
+  for (int i = 0; i < vertices.size(); ++i) {
+    vertices[i] = {positions[i].pos, attributes[i].norm,
+                   attributes[i].tex_coord};
+  }
+  return vertices;
+}
+
 namespace file {
 
 template <>
@@ -216,98 +987,62 @@ std::array<Vertex2D, 6> Vertex2D::GetFullScreenSquadVertices(bool flip_y) {
   }
 }
 
-ObjFile::ObjFile(std::string_view path, int index_base) {
-  std::ifstream file = OpenFile(path);
-
-  std::vector<glm::vec3> positions;
-  std::vector<glm::vec3> normals;
-  std::vector<glm::vec2> tex_coords;
-  absl::flat_hash_map<std::string, uint32_t> loaded_vertices;
-
-  const auto parse_line = [&](std::string_view line) {
-    const size_t non_space = line.find_first_not_of(' ');
-    if (non_space == std::string::npos || line[0] == '#') {
-      // Skip blank lines and comments.
-      return;
-    }
+Indices NarrowIndices(absl::Span<const uint32_t> indices,
+                      size_t num_vertices) {
+  if (!CanUse16BitIndices(num_vertices)) {
+    return std::vector<uint32_t>{indices.begin(), indices.end()};
+  }
+  std::vector<uint16_t> narrowed(indices.size());
+  std::transform(indices.begin(), indices.end(), narrowed.begin(),
+                 [](uint32_t index) { return static_cast<uint16_t>(index); });
+  return narrowed;
+}
 
-    switch (line[non_space]) {
-      case 'v': {
-        // Either position, normal or texture coordinates.
-        switch (line[non_space + 1]) {
-          case ' ': {
-            // Position.
-            const auto nums = SplitText(line.substr(non_space + 2), ' ',
-                                        /*num_segments=*/3);
-            positions.push_back(
-                glm::vec3{stof(nums[0]), stof(nums[1]), stof(nums[2])});
-            break;
-          }
-          case 'n': {
-            // Normal.
-            const auto nums = SplitText(line.substr(non_space + 3), ' ',
-                                        /*num_segments=*/3);
-            normals.push_back(
-                glm::vec3{stof(nums[0]), stof(nums[1]), stof(nums[2])});
-            break;
-          }
-          case 't': {
-            // Texture coordinates.
-            const auto nums = SplitText(line.substr(non_space + 3), ' ',
-                                        /*num_segments=*/2);
-            tex_coords.push_back(glm::vec2{stof(nums[0]), stof(nums[1])});
-            break;
-          }
-          default:
-            FATAL(absl::StrFormat("Unexpected symbol '%c'",
-                                  line[non_space + 1]));
-        }
-        break;
-      }
-      case 'f': {
-        // Face.
-        for (const auto& seg : SplitText(line.substr(non_space + 2), ' ',
-                                         /*num_segments=*/3)) {
-          const auto iter = loaded_vertices.find(seg);
-          if (iter != loaded_vertices.end()) {
-            indices.push_back(iter->second);
-          } else {
-            indices.push_back(vertices.size());
-            loaded_vertices[seg] = vertices.size();
-            const auto idxs = SplitText(seg, '/', /*num_segments=*/3);
-            vertices.push_back(Vertex3DWithTex{
-                positions.at(stoi(idxs[0]) - index_base),
-                normals.at(stoi(idxs[2]) - index_base),
-                tex_coords.at(stoi(idxs[1]) - index_base),
-            });
-          }
-        }
-        break;
-      }
-      default:
-        FATAL(absl::StrFormat("Unexpected symbol '%c'", line[non_space]));
-    }
+ObjFile::ObjFile(std::string_view path, int index_base, int num_threads) {
+  const ObjParser parser{path, index_base, /*pos_only=*/false, num_threads};
+  const auto make_vertex = [&parser](const ObjFaceVertex& vertex) {
+    // Normals and texture coordinates default to zero if not specified.
+    return Vertex3DWithTex{
+        parser.positions()[vertex.pos],
+        vertex.norm == ObjFaceVertex::kNoIndex
+            ? glm::vec3{0.0f} : parser.normals()[vertex.norm],
+        vertex.tex_coord == ObjFaceVertex::kNoIndex
+            ? glm::vec2{0.0f} : parser.tex_coords()[vertex.tex_coord],
+    };
   };
+  // Most vertices are usually shared by faces with the same texture
+  // coordinates and normals, hence the number of unique vertices is expected
+  // to be close to the number of positions.
+  const size_t num_unique_vertices_hint = parser.positions().size();
 
-  std::string line;
-  int line_num = 1;
-  try {
-    for (; std::getline(file, line); ++line_num) {
-      parse_line(line);
-    }
-  } catch (const std::exception& e) {
-    FATAL(absl::StrFormat("Failed to parse line %d: %s\n%s",
-                          line_num, line, e.what()));
+  const std::optional<ObjFaceVertexPacker> packer =
+      ObjFaceVertexPacker::Create(parser.GetAttributeCounts());
+  if (packer.has_value()) {
+    DeduplicateVertices<uint64_t, Vertex3DWithTex>(
+        parser, /*get_key=*/[&packer](const ObjFaceVertex& vertex) {
+          return packer->Pack(vertex);
+        },
+        make_vertex, num_unique_vertices_hint, indices, vertices);
+  } else {
+    DeduplicateVertices<ObjFaceVertex, Vertex3DWithTex>(
+        parser, /*get_key=*/[](const ObjFaceVertex& vertex) { return vertex; },
+        make_vertex, num_unique_vertices_hint, indices, vertices);
   }
+  bounds = Aabb::FromVertices<Vertex3DWithTex>(vertices);
 }
 
-ObjFilePosOnly::ObjFilePosOnly(std::string_view path, int index_base) {
-  ObjFile file(path, index_base);
-  indices = std::move(file.indices);
-  vertices.reserve(file.vertices.size());
-  for (const auto& vertex : file.vertices) {
-    vertices.push_back({vertex.pos});
-  }
+ObjFilePosOnly::ObjFilePosOnly(std::string_view path, int index_base,
+                               int num_threads) {
+  const ObjParser parser{path, index_base, /*pos_only=*/true, num_threads};
+  DeduplicateVertices<int, Vertex3DPosOnly>(
+      parser,
+      /*get_key=*/[](const ObjFaceVertex& vertex) { return vertex.pos; },
+      /*make_vertex=*/[&parser](const ObjFaceVertex& vertex) {
+        return Vertex3DPosOnly{parser.positions()[vertex.pos]};
+      },
+      /*num_unique_vertices_hint=*/parser.positions().size(),
+      indices, vertices);
+  bounds = Aabb::FromVertices<Vertex3DPosOnly>(vertices);
 }
 
 }  // namespace lighter::common
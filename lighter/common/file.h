@@ -9,11 +9,16 @@
 #define LIGHTER_COMMON_FILE_H
 
 #include <array>
+#include <cstdint>
 #include <filesystem>
+#include <limits>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <variant>
 #include <vector>
 
+#include "lighter/common/bounds.h"
 #include "lighter/common/graphics_api.h"
 #include "third_party/absl/types/span.h"
 #include "third_party/absl/strings/str_cat.h"
@@ -45,34 +50,83 @@ std::string GetVulkanSdkPath(std::string_view relative_path);
 
 // Reads raw data from file.
 struct RawData {
-  explicit RawData(std::string_view path);
+  // Determines how the file content is brought into memory.
+  enum class Mode {
+    // Reads the whole file into a buffer allocated on the heap.
+    kCopy,
+    // Maps the file into the address space, so that no copy is made and pages
+    // are shared with the OS page cache. If memory mapping is not supported on
+    // the platform or fails, we fall back to kCopy.
+    kMemoryMapped,
+  };
+
+  explicit RawData(std::string_view path, Mode mode = Mode::kCopy);
 
   // This class is neither copyable nor movable.
   RawData(const RawData&) = delete;
   RawData& operator=(const RawData&) = delete;
 
-  ~RawData() { delete[] data; }
+  ~RawData();
 
   // Returns the whole data span, which lives as long as this `RawData` object.
   absl::Span<const char> GetSpan() const { return {data, size}; }
 
+  // Returns true if 'data' points to a memory mapping of the file.
+  bool is_memory_mapped() const { return is_memory_mapped_; }
+
   // Pointer to data.
   const char* data;
 
   // Data size.
   size_t size;
+
+ private:
+  // Maps the file at 'path' into memory and populates 'data' and 'size'.
+  // Returns false if memory mapping is not supported or fails.
+  bool MapFile(std::string_view path);
+
+  // Reads the file at 'path' into a heap buffer and populates 'data' and
+  // 'size'.
+  void CopyFile(std::string_view path);
+
+  // Whether 'data' points to a memory mapping rather than a heap buffer.
+  bool is_memory_mapped_ = false;
 };
 
 // TODO: Remove this struct and related methods.
 // Describes a vertex input attribute.
 struct VertexAttribute {
-  enum class DataType { kFloat };
+  // Types of values stored in the vertex buffer. They are always converted to
+  // floats when read in shaders. Normalized integers (snorm and unorm) are
+  // mapped to range [-1, 1] and [0, 1] respectively.
+  enum class DataType { kFloat, kHalfFloat, kSnorm8, kSnorm16, kUnorm16 };
 
   int offset;
   DataType data_type;
   int length;
 };
 
+// Vector of 'kLength' values of 'kDataType', stored as integers of 'ValueType'.
+// This is used for vertex attributes that are not full floats. Use functions
+// in packing.h to convert from floats.
+template <typename ValueType, int kLength, VertexAttribute::DataType kDataType>
+struct PackedVec {
+  static constexpr VertexAttribute::DataType data_type = kDataType;
+  static constexpr int length() { return kLength; }
+
+  std::array<ValueType, kLength> values;
+};
+
+using HalfVec2 = PackedVec<uint16_t, 2, VertexAttribute::DataType::kHalfFloat>;
+using HalfVec4 = PackedVec<uint16_t, 4, VertexAttribute::DataType::kHalfFloat>;
+using Snorm8Vec4 = PackedVec<int8_t, 4, VertexAttribute::DataType::kSnorm8>;
+using Snorm16Vec2 = PackedVec<int16_t, 2, VertexAttribute::DataType::kSnorm16>;
+using Snorm16Vec4 = PackedVec<int16_t, 4, VertexAttribute::DataType::kSnorm16>;
+using Unorm16Vec2 =
+    PackedVec<uint16_t, 2, VertexAttribute::DataType::kUnorm16>;
+using Unorm16Vec4 =
+    PackedVec<uint16_t, 4, VertexAttribute::DataType::kUnorm16>;
+
 // 2D vertex data, including only position.
 struct Vertex2DPosOnly {
   // Returns vertex input attributes.
@@ -130,15 +184,119 @@ struct Vertex3DWithTex {
   glm::vec2 tex_coord;
 };
 
+// 3D vertex data, consisting of normal and texture coordinates. This holds
+// attributes of Vertex3DWithTex other than position, which is used when
+// positions are stored in a separate stream of Vertex3DPosOnly, so that
+// position-only passes only need to fetch 12 bytes per vertex.
+struct Vertex3DNormTex {
+  // Returns vertex input attributes.
+  static std::vector<VertexAttribute> GetVertexAttributes();
+
+  // Vertex data.
+  glm::vec3 norm;
+  glm::vec2 tex_coord;
+};
+
+// Compressed version of Vertex3DWithTex, which takes 20 bytes instead of 32.
+// The normal is octahedral-encoded, and should be decoded in shaders with:
+//   vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+//   if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0,
+//                                                  n.y >= 0.0 ? 1.0 : -1.0);
+//   n = normalize(n);
+struct Vertex3DCompressed {
+  // Returns vertex input attributes.
+  static std::vector<VertexAttribute> GetVertexAttributes();
+
+  // Converts 'vertex' to the compressed form.
+  static Vertex3DCompressed Create(const Vertex3DWithTex& vertex);
+
+  // Vertex data.
+  glm::vec3 pos;
+  Snorm16Vec2 norm;
+  HalfVec2 tex_coord;
+};
+
+// Maps quantized positions in range [-1, 1] back to the original range:
+//   original = quantized * scale + bias
+struct PositionQuantization {
+  // Returns the quantization that covers the bounding box of 'vertices'.
+  static PositionQuantization Create(
+      absl::Span<const Vertex3DWithTex> vertices);
+
+  // Returns the quantization that covers the box from 'min_pos' to 'max_pos'.
+  static PositionQuantization Create(const glm::vec3& min_pos,
+                                     const glm::vec3& max_pos);
+
+  glm::vec3 scale;
+  glm::vec3 bias;
+};
+
+// Same as Vertex3DCompressed, except that the position is also quantized to
+// snorm16, which makes a vertex only take 16 bytes. The w component of the
+// position is always 1. Positions should be restored in shaders with
+// PositionQuantization, which is usually provided per mesh or per model.
+struct Vertex3DQuantized {
+  // Returns vertex input attributes.
+  static std::vector<VertexAttribute> GetVertexAttributes();
+
+  // Converts 'vertex' to the quantized form.
+  static Vertex3DQuantized Create(const Vertex3DWithTex& vertex,
+                                  const PositionQuantization& quantization);
+
+  // Vertex data.
+  Snorm16Vec4 pos;
+  Snorm16Vec2 norm;
+  HalfVec2 tex_coord;
+};
+
+// Converts all 'vertices' to Vertex3DCompressed.
+std::vector<Vertex3DCompressed> CompressVertices(
+    absl::Span<const Vertex3DWithTex> vertices);
+
+// Converts all 'vertices' to Vertex3DQuantized. The quantization used will be
+// written to 'quantization'.
+std::vector<Vertex3DQuantized> QuantizeVertices(
+    absl::Span<const Vertex3DWithTex> vertices,
+    PositionQuantization* quantization);
+
+// Vertex3DWithTex split into a position stream and an attribute stream.
+// Elements at the same index of both streams belong to the same vertex.
+struct SplitVertexStreams {
+  std::vector<Vertex3DPosOnly> positions;
+  std::vector<Vertex3DNormTex> attributes;
+};
+
+// Splits 'vertices' into two streams.
+SplitVertexStreams SplitVertices(absl::Span<const Vertex3DWithTex> vertices);
+
+// Interleaves 'positions' and 'attributes' back into Vertex3DWithTex. Both
+// streams must have the same number of vertices.
+std::vector<Vertex3DWithTex> InterleaveVertices(
+    absl::Span<const Vertex3DPosOnly> positions,
+    absl::Span<const Vertex3DNormTex> attributes);
+
 namespace file {
 
+// Returns the type of values in DataType. This is kFloat for glm vector types,
+// and the declared type for PackedVec.
+template <typename DataType, typename = void>
+struct VertexAttributeDataType {
+  static constexpr auto value = VertexAttribute::DataType::kFloat;
+};
+
+template <typename DataType>
+struct VertexAttributeDataType<DataType,
+                               std::void_t<decltype(DataType::data_type)>> {
+  static constexpr auto value = DataType::data_type;
+};
+
 // Appends vertex input attributes of DataType to 'attributes'. This is used for
-// vector types with floating point values, such as glm::vec3 and glm::vec4.
+// vector types, such as glm::vec3, glm::vec4 and PackedVec.
 template <typename DataType>
 void AppendVertexAttributes(std::vector<VertexAttribute>& attributes,
                             int offset_bytes) {
-  attributes.push_back(
-      {offset_bytes, VertexAttribute::DataType::kFloat, DataType::length()});
+  attributes.push_back({offset_bytes, VertexAttributeDataType<DataType>::value,
+                        DataType::length()});
 }
 
 // Appends vertex input attributes of glm::mat4 to 'attributes'.
@@ -157,9 +315,31 @@ std::vector<VertexAttribute> CreateVertexAttributes() {
 
 }  // namespace file
 
-// Loads Wavefront .obj file.
+// Indices of a mesh, stored in 16-bit integers if possible, which halves the
+// memory and bandwidth used for index data.
+using Indices = std::variant<std::vector<uint16_t>, std::vector<uint32_t>>;
+using IndicesView =
+    std::variant<absl::Span<const uint16_t>, absl::Span<const uint32_t>>;
+
+// Returns whether indices of a mesh with 'num_vertices' vertices can be stored
+// in 16-bit integers.
+constexpr bool CanUse16BitIndices(size_t num_vertices) {
+  return num_vertices <= size_t{std::numeric_limits<uint16_t>::max()} + 1;
+}
+
+// Returns 'indices' of a mesh with 'num_vertices' vertices, converted to 16-bit
+// integers if CanUse16BitIndices() returns true.
+Indices NarrowIndices(absl::Span<const uint32_t> indices, size_t num_vertices);
+
+// Loads Wavefront .obj file. Faces with more than 3 vertices are triangulated,
+// and vertices of faces can be in any of these forms: "v", "v/vt", "v//vn" and
+// "v/vt/vn". Normals and texture coordinates that are not specified will be
+// zero.
+// If 'num_threads' is greater than 1, large files will be split into chunks at
+// line boundaries, which are parsed and deduplicated in parallel. Results are
+// always the same as loading with a single thread.
 struct ObjFile {
-  ObjFile(std::string_view path, int index_base);
+  ObjFile(std::string_view path, int index_base, int num_threads = 1);
 
   // This class is neither copyable nor movable.
   ObjFile(const ObjFile&) = delete;
@@ -168,11 +348,16 @@ struct ObjFile {
   // Vertex data, populated with data loaded from the file.
   std::vector<uint32_t> indices;
   std::vector<Vertex3DWithTex> vertices;
+
+  // Bounding box of 'vertices'.
+  Aabb bounds;
 };
 
-// Loads Wavefront .obj file but only preserves vertex positions.
+// Loads Wavefront .obj file but only preserves vertex positions. Normals and
+// texture coordinates are skipped while parsing, and vertices are deduplicated
+// by positions only. 'num_threads' is used in the same way as ObjFile.
 struct ObjFilePosOnly {
-  ObjFilePosOnly(std::string_view path, int index_base);
+  ObjFilePosOnly(std::string_view path, int index_base, int num_threads = 1);
 
   // This class is neither copyable nor movable.
   ObjFilePosOnly(const ObjFilePosOnly&) = delete;
@@ -181,6 +366,9 @@ struct ObjFilePosOnly {
   // Vertex data, populated with data loaded from the file.
   std::vector<uint32_t> indices;
   std::vector<Vertex3DPosOnly> vertices;
+
+  // Bounding box of 'vertices'.
+  Aabb bounds;
 };
 
 }  // namespace lighter::common
@@ -0,0 +1,99 @@
+//
+//  file_benchmark.cc
+//
+//  Created by Pujun Lun on 6/12/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "lighter/common/file.h"
+#include "lighter/common/util.h"
+#include "third_party/absl/flags/flag.h"
+#include "third_party/absl/flags/parse.h"
+#include "third_party/absl/strings/str_format.h"
+#include "third_party/absl/types/span.h"
+#include "third_party/benchmark/benchmark.h"
+
+ABSL_FLAG(std::string, asset_dir, "",
+          "Path to the directory of assets to load. The resource folder will "
+          "be used if not specified");
+
+namespace lighter::common {
+namespace {
+
+namespace stdfs = std::filesystem;
+
+// Consumers of RawData read the whole file, so we touch one byte of each page
+// to make sure pages of memory mapped files are actually faulted in.
+constexpr size_t kPageSize = 4096;
+
+// Returns paths to all regular files in 'directory' and its subdirectories.
+std::vector<std::string> ListFiles(const stdfs::path& directory) {
+  std::vector<std::string> paths;
+  for (const stdfs::directory_entry& entry :
+           stdfs::recursive_directory_iterator(directory)) {
+    if (entry.is_regular_file()) {
+      paths.push_back(entry.path().string());
+    }
+  }
+  return paths;
+}
+
+// Returns the sum of the first byte of each page in 'data'.
+int TouchPages(absl::Span<const char> data) {
+  int sum = 0;
+  for (size_t offset = 0; offset < data.size(); offset += kPageSize) {
+    sum += data[offset];
+  }
+  return sum;
+}
+
+// Loads all files in 'paths' with the given 'mode'.
+void BM_LoadRawData(benchmark::State& state, RawData::Mode mode,
+                    const std::vector<std::string>* paths) {
+  size_t total_size = 0;
+  for (auto _ : state) {
+    for (const auto& path : *paths) {
+      const RawData raw_data{path, mode};
+      benchmark::DoNotOptimize(TouchPages(raw_data.GetSpan()));
+      total_size += raw_data.size;
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(total_size));
+  state.SetItemsProcessed(
+      static_cast<int64_t>(state.iterations() * paths->size()));
+}
+
+}  // namespace
+}  // namespace lighter::common
+
+int main(int argc, char* argv[]) {
+  namespace stdfs = std::filesystem;
+  using namespace lighter::common;
+
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+
+  stdfs::path asset_dir{absl::GetFlag(FLAGS_asset_dir)};
+  if (asset_dir.empty()) {
+    file::EnableRunfileLookup(argv[0]);
+    asset_dir = stdfs::path{file::GetResourcePath(
+        "model/cube.obj", /*want_directory_path=*/true)}.parent_path();
+  }
+  ASSERT_TRUE(stdfs::is_directory(asset_dir),
+              absl::StrFormat("'%s' is not a directory", asset_dir.string()));
+
+  const std::vector<std::string> paths = ListFiles(asset_dir);
+  LOG_INFO << absl::StreamFormat("Found %d files in '%s'",
+                                 paths.size(), asset_dir.string());
+
+  benchmark::RegisterBenchmark("BM_LoadRawData/Copy", BM_LoadRawData,
+                               RawData::Mode::kCopy, &paths);
+  benchmark::RegisterBenchmark("BM_LoadRawData/MemoryMapped", BM_LoadRawData,
+                               RawData::Mode::kMemoryMapped, &paths);
+  benchmark::RunSpecifiedBenchmarks();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,144 @@
+//
+//  font_face_cache.cc
+//
+//  Created by Pujun Lun on 6/30/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/font_face_cache.h"
+
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "lighter/common/file.h"
+#include "lighter/common/util.h"
+#include "third_party/absl/container/flat_hash_map.h"
+#include "third_party/absl/strings/str_format.h"
+
+namespace lighter::common::font_face_cache {
+namespace internal {
+namespace {
+
+// Returns the content of the font file at 'font_path', which is read on the
+// first call and lives as long as the process. This is thread-safe.
+const RawData& GetFontData(const std::string& font_path) {
+  static std::mutex mutex;
+  static absl::flat_hash_map<std::string, std::unique_ptr<RawData>> data_map;
+
+  const std::lock_guard<std::mutex> lock{mutex};
+  auto& data = data_map[font_path];
+  if (data == nullptr) {
+    data = std::make_unique<RawData>(font_path, RawData::Mode::kMemoryMapped);
+  }
+  return *data;
+}
+
+}  // namespace
+
+class FaceSet {
+ public:
+  FaceSet() {
+    ASSERT_FALSE(FT_Init_FreeType(&library_),
+                 "Failed to init FreeType library");
+  }
+
+  // This class is neither copyable nor movable.
+  FaceSet(const FaceSet&) = delete;
+  FaceSet& operator=(const FaceSet&) = delete;
+
+  ~FaceSet() {
+    for (const auto& pair : faces_) {
+      FT_Done_Face(pair.second);
+    }
+    FT_Done_FreeType(library_);
+  }
+
+  // Returns the face of 'font_path' with 'font_height', which is created if
+  // not cached yet. Faces are not shared by different heights, since setting
+  // the pixel size may run the hinting program of the font.
+  FT_Face GetFace(const std::string& font_path, int font_height) {
+    auto key = std::make_pair(font_path, font_height);
+    const auto iter = faces_.find(key);
+    if (iter != faces_.end()) {
+      return iter->second;
+    }
+
+    const RawData& font_data = GetFontData(font_path);
+    FT_Face face;
+    ASSERT_FALSE(
+        FT_New_Memory_Face(library_,
+                           reinterpret_cast<const FT_Byte*>(font_data.data),
+                           static_cast<FT_Long>(font_data.size),
+                           /*face_index=*/0, &face),
+        absl::StrFormat("Failed to load font '%s'", font_path));
+    FT_Set_Pixel_Sizes(face, /*pixel_width=*/0, font_height);
+    faces_.insert({std::move(key), face});
+    return face;
+  }
+
+ private:
+  // FreeType library used for creating all faces in this set.
+  FT_Library library_;
+
+  // Maps font paths and heights to faces.
+  absl::flat_hash_map<std::pair<std::string, int>, FT_Face> faces_;
+};
+
+}  // namespace internal
+
+namespace {
+
+using internal::FaceSet;
+
+// Face sets that are not checked out by any worker. They live as long as the
+// process, and the number of them is at most the peak number of concurrent
+// workers.
+class IdleFaceSets {
+ public:
+  // Returns an idle face set, or a new one if none is idle.
+  std::unique_ptr<FaceSet> CheckOut() {
+    {
+      const std::lock_guard<std::mutex> lock{mutex_};
+      if (!face_sets_.empty()) {
+        auto face_set = std::move(face_sets_.back());
+        face_sets_.pop_back();
+        return face_set;
+      }
+    }
+    return std::make_unique<FaceSet>();
+  }
+
+  // Puts 'face_set' back so that it can be reused.
+  void Return(std::unique_ptr<FaceSet>&& face_set) {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    face_sets_.push_back(std::move(face_set));
+  }
+
+ private:
+  // Guards 'face_sets_'.
+  std::mutex mutex_;
+
+  // Idle face sets.
+  std::vector<std::unique_ptr<FaceSet>> face_sets_;
+};
+
+IdleFaceSets& GetIdleFaceSets() {
+  static auto* idle_face_sets = new IdleFaceSets;
+  return *idle_face_sets;
+}
+
+}  // namespace
+
+ScopedFaceSet::ScopedFaceSet() : face_set_{GetIdleFaceSets().CheckOut()} {}
+
+ScopedFaceSet::~ScopedFaceSet() {
+  GetIdleFaceSets().Return(std::move(face_set_));
+}
+
+FT_Face ScopedFaceSet::GetFace(const std::string& font_path, int font_height) {
+  return face_set_->GetFace(font_path, font_height);
+}
+
+}  // namespace lighter::common::font_face_cache
@@ -0,0 +1,55 @@
+//
+//  font_face_cache.h
+//
+//  Created by Pujun Lun on 6/30/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#ifndef LIGHTER_COMMON_FONT_FACE_CACHE_H
+#define LIGHTER_COMMON_FONT_FACE_CACHE_H
+
+#include <memory>
+#include <string>
+
+#include "third_party/freetype2/ft2build.h"
+#include FT_FREETYPE_H
+
+namespace lighter::common::font_face_cache {
+
+namespace internal {
+
+// FreeType library and faces created with it.
+class FaceSet;
+
+}  // namespace internal
+
+// Since FreeType libraries and faces must not be used on multiple threads
+// concurrently, each worker that loads glyphs should construct an instance of
+// this class, which checks out a FT_Library and faces created with it from a
+// process-wide cache. They are returned to the cache on destruction and reused
+// by the next instance, so that FreeType objects outlive the worker threads and
+// are not recreated whenever glyphs are loaded. The font file is read only once
+// per process, and its content is shared by all faces.
+class ScopedFaceSet {
+ public:
+  ScopedFaceSet();
+
+  // This class is neither copyable nor movable.
+  ScopedFaceSet(const ScopedFaceSet&) = delete;
+  ScopedFaceSet& operator=(const ScopedFaceSet&) = delete;
+
+  ~ScopedFaceSet();
+
+  // Returns a face of the font at 'font_path' whose pixel height is set to
+  // 'font_height'. The returned face must only be used while this instance is
+  // alive, and the user must not change its pixel size.
+  FT_Face GetFace(const std::string& font_path, int font_height);
+
+ private:
+  // Checked out from the cache.
+  std::unique_ptr<internal::FaceSet> face_set_;
+};
+
+}  // namespace lighter::common::font_face_cache
+
+#endif  // LIGHTER_COMMON_FONT_FACE_CACHE_H
@@ -0,0 +1,378 @@
+//
+//  frustum_culling.cc
+//
+//  Created by Pujun Lun on 6/21/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/frustum_culling.h"
+
+#include <array>
+#include <cstdint>
+
+#include "lighter/common/util.h"
+
+#if defined(__AVX2__)
+#define LIGHTER_USE_AVX2
+#include <immintrin.h>
+#endif  // __AVX2__
+
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LIGHTER_USE_SSE
+#include <xmmintrin.h>
+#endif  // __SSE__ || _M_X64 || _M_IX86_FP
+
+namespace lighter::common::frustum_culling {
+namespace {
+
+constexpr int kNumPlanes = std::tuple_size<FrustumPlanes>::value;
+
+// Returns the absolute values of plane normals, which are used for projecting
+// half extents of boxes onto normals.
+FrustumPlanes GetAbsNormals(const FrustumPlanes& planes) {
+  FrustumPlanes abs_normals;
+  for (int p = 0; p < kNumPlanes; ++p) {
+    abs_normals[p] = glm::vec4{glm::abs(glm::vec3{planes[p]}), 0.0f};
+  }
+  return abs_normals;
+}
+
+// Scalar implementations. They start from 'begin', so that they can also be
+// used for the remainders of SIMD implementations. Each returns the number of
+// visible objects written to 'output'. Indices are written unconditionally
+// and the count is advanced only if the object is visible, which avoids
+// unpredictable branches.
+
+int CullSpheresScalar(const FrustumPlanes& planes, const SphereBatch& spheres,
+                      int begin, int* output) {
+  int num_visible = 0;
+  for (int i = begin; i < spheres.size(); ++i) {
+    bool is_visible = true;
+    for (const glm::vec4& plane : planes) {
+      const float distance = plane.x * spheres.center_x[i] +
+                             plane.y * spheres.center_y[i] +
+                             plane.z * spheres.center_z[i] + plane.w;
+      is_visible &= distance >= -spheres.radii[i];
+    }
+    output[num_visible] = i;
+    num_visible += is_visible;
+  }
+  return num_visible;
+}
+
+int CullAabbsScalar(const FrustumPlanes& planes, const AabbBatch& aabbs,
+                    int begin, int* output) {
+  const FrustumPlanes abs_normals = GetAbsNormals(planes);
+  int num_visible = 0;
+  for (int i = begin; i < aabbs.size(); ++i) {
+    bool is_visible = true;
+    for (int p = 0; p < kNumPlanes; ++p) {
+      const glm::vec4& plane = planes[p];
+      const glm::vec4& abs_normal = abs_normals[p];
+      const float distance = plane.x * aabbs.center_x[i] +
+                             plane.y * aabbs.center_y[i] +
+                             plane.z * aabbs.center_z[i] + plane.w;
+      const float radius = abs_normal.x * aabbs.half_extent_x[i] +
+                           abs_normal.y * aabbs.half_extent_y[i] +
+                           abs_normal.z * aabbs.half_extent_z[i];
+      is_visible &= distance >= -radius;
+    }
+    output[num_visible] = i;
+    num_visible += is_visible;
+  }
+  return num_visible;
+}
+
+// SIMD implementations. Each processes objects in groups of the SIMD width, and
+// returns the number of visible objects written to 'output'. Objects that do
+// not fill a group are left to scalar implementations, and '*num_processed'
+// will be set to the number of objects processed.
+
+#ifdef LIGHTER_USE_SSE
+
+constexpr int kSseWidth = 4;
+
+// Writes indices of visible lanes to 'output' given the result of
+// _mm_movemask_ps(), and returns the number of them.
+inline int CompactSse(int mask, int base_index, int* output) {
+  int num_visible = 0;
+  for (int lane = 0; lane < kSseWidth; ++lane) {
+    output[num_visible] = base_index + lane;
+    num_visible += (mask >> lane) & 1;
+  }
+  return num_visible;
+}
+
+int CullSpheresSse(const FrustumPlanes& planes, const SphereBatch& spheres,
+                   int* output, int* num_processed) {
+  const int end = spheres.size() / kSseWidth * kSseWidth;
+  int num_visible = 0;
+  for (int i = 0; i < end; i += kSseWidth) {
+    const __m128 center_x = _mm_loadu_ps(&spheres.center_x[i]);
+    const __m128 center_y = _mm_loadu_ps(&spheres.center_y[i]);
+    const __m128 center_z = _mm_loadu_ps(&spheres.center_z[i]);
+    const __m128 neg_radii =
+        _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radii[i]));
+    __m128 is_visible;
+    for (int p = 0; p < kNumPlanes; ++p) {
+      const glm::vec4& plane = planes[p];
+      const __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), center_x),
+                     _mm_mul_ps(_mm_set1_ps(plane.y), center_y)),
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), center_z),
+                     _mm_set1_ps(plane.w)));
+      const __m128 is_inside = _mm_cmpge_ps(distance, neg_radii);
+      is_visible = p == 0 ? is_inside : _mm_and_ps(is_visible, is_inside);
+    }
+    num_visible += CompactSse(_mm_movemask_ps(is_visible), i,
+                              output + num_visible);
+  }
+  *num_processed = end;
+  return num_visible;
+}
+
+int CullAabbsSse(const FrustumPlanes& planes, const AabbBatch& aabbs,
+                 int* output, int* num_processed) {
+  const FrustumPlanes abs_normals = GetAbsNormals(planes);
+  const int end = aabbs.size() / kSseWidth * kSseWidth;
+  int num_visible = 0;
+  for (int i = 0; i < end; i += kSseWidth) {
+    const __m128 center_x = _mm_loadu_ps(&aabbs.center_x[i]);
+    const __m128 center_y = _mm_loadu_ps(&aabbs.center_y[i]);
+    const __m128 center_z = _mm_loadu_ps(&aabbs.center_z[i]);
+    const __m128 half_extent_x = _mm_loadu_ps(&aabbs.half_extent_x[i]);
+    const __m128 half_extent_y = _mm_loadu_ps(&aabbs.half_extent_y[i]);
+    const __m128 half_extent_z = _mm_loadu_ps(&aabbs.half_extent_z[i]);
+    __m128 is_visible;
+    for (int p = 0; p < kNumPlanes; ++p) {
+      const glm::vec4& plane = planes[p];
+      const glm::vec4& abs_normal = abs_normals[p];
+      const __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), center_x),
+                     _mm_mul_ps(_mm_set1_ps(plane.y), center_y)),
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), center_z),
+                     _mm_set1_ps(plane.w)));
+      const __m128 radius = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(abs_normal.x), half_extent_x),
+                     _mm_mul_ps(_mm_set1_ps(abs_normal.y), half_extent_y)),
+          _mm_mul_ps(_mm_set1_ps(abs_normal.z), half_extent_z));
+      const __m128 is_inside =
+          _mm_cmpge_ps(distance, _mm_sub_ps(_mm_setzero_ps(), radius));
+      is_visible = p == 0 ? is_inside : _mm_and_ps(is_visible, is_inside);
+    }
+    num_visible += CompactSse(_mm_movemask_ps(is_visible), i,
+                              output + num_visible);
+  }
+  *num_processed = end;
+  return num_visible;
+}
+
+#endif  // LIGHTER_USE_SSE
+
+#ifdef LIGHTER_USE_AVX2
+
+constexpr int kAvxWidth = 8;
+
+// Maps the result of _mm256_movemask_ps() to indices of visible lanes packed
+// in 4-bit fields, so that they can be unpacked with one variable shift.
+struct CompactionTable {
+  constexpr CompactionTable() : packed_lanes{}, num_lanes{} {
+    for (int mask = 0; mask < (1 << kAvxWidth); ++mask) {
+      uint32_t packed = 0;
+      int count = 0;
+      for (int lane = 0; lane < kAvxWidth; ++lane) {
+        if ((mask >> lane) & 1) {
+          packed |= static_cast<uint32_t>(lane) << (count * 4);
+          ++count;
+        }
+      }
+      packed_lanes[mask] = packed;
+      num_lanes[mask] = count;
+    }
+  }
+
+  uint32_t packed_lanes[1 << kAvxWidth];
+  int num_lanes[1 << kAvxWidth];
+};
+
+constexpr CompactionTable kCompactionTable{};
+
+// Writes indices of visible lanes to 'output' given the result of
+// _mm256_movemask_ps(), and returns the number of them. Note that this always
+// writes 8 integers to 'output'.
+inline int CompactAvx2(int mask, int base_index, int* output) {
+  const __m256i shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+  const __m256i lanes = _mm256_and_si256(
+      _mm256_srlv_epi32(
+          _mm256_set1_epi32(
+              static_cast<int>(kCompactionTable.packed_lanes[mask])),
+          shifts),
+      _mm256_set1_epi32(0xF));
+  _mm256_storeu_si256(
+      reinterpret_cast<__m256i*>(output),
+      _mm256_add_epi32(lanes, _mm256_set1_epi32(base_index)));
+  return kCompactionTable.num_lanes[mask];
+}
+
+int CullSpheresAvx2(const FrustumPlanes& planes, const SphereBatch& spheres,
+                    int* output, int* num_processed) {
+  const int end = spheres.size() / kAvxWidth * kAvxWidth;
+  int num_visible = 0;
+  for (int i = 0; i < end; i += kAvxWidth) {
+    const __m256 center_x = _mm256_loadu_ps(&spheres.center_x[i]);
+    const __m256 center_y = _mm256_loadu_ps(&spheres.center_y[i]);
+    const __m256 center_z = _mm256_loadu_ps(&spheres.center_z[i]);
+    const __m256 neg_radii =
+        _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&spheres.radii[i]));
+    __m256 is_visible;
+    for (int p = 0; p < kNumPlanes; ++p) {
+      const glm::vec4& plane = planes[p];
+      const __m256 distance = _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), center_x),
+                        _mm256_mul_ps(_mm256_set1_ps(plane.y), center_y)),
+          _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), center_z),
+                        _mm256_set1_ps(plane.w)));
+      const __m256 is_inside = _mm256_cmp_ps(distance, neg_radii, _CMP_GE_OQ);
+      is_visible = p == 0 ? is_inside : _mm256_and_ps(is_visible, is_inside);
+    }
+    num_visible += CompactAvx2(_mm256_movemask_ps(is_visible), i,
+                               output + num_visible);
+  }
+  *num_processed = end;
+  return num_visible;
+}
+
+int CullAabbsAvx2(const FrustumPlanes& planes, const AabbBatch& aabbs,
+                  int* output, int* num_processed) {
+  const FrustumPlanes abs_normals = GetAbsNormals(planes);
+  const int end = aabbs.size() / kAvxWidth * kAvxWidth;
+  int num_visible = 0;
+  for (int i = 0; i < end; i += kAvxWidth) {
+    const __m256 center_x = _mm256_loadu_ps(&aabbs.center_x[i]);
+    const __m256 center_y = _mm256_loadu_ps(&aabbs.center_y[i]);
+    const __m256 center_z = _mm256_loadu_ps(&aabbs.center_z[i]);
+    const __m256 half_extent_x = _mm256_loadu_ps(&aabbs.half_extent_x[i]);
+    const __m256 half_extent_y = _mm256_loadu_ps(&aabbs.half_extent_y[i]);
+    const __m256 half_extent_z = _mm256_loadu_ps(&aabbs.half_extent_z[i]);
+    __m256 is_visible;
+    for (int p = 0; p < kNumPlanes; ++p) {
+      const glm::vec4& plane = planes[p];
+      const glm::vec4& abs_normal = abs_normals[p];
+      const __m256 distance = _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), center_x),
+                        _mm256_mul_ps(_mm256_set1_ps(plane.y), center_y)),
+          _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), center_z),
+                        _mm256_set1_ps(plane.w)));
+      const __m256 radius = _mm256_add_ps(
+          _mm256_add_ps(
+              _mm256_mul_ps(_mm256_set1_ps(abs_normal.x), half_extent_x),
+              _mm256_mul_ps(_mm256_set1_ps(abs_normal.y), half_extent_y)),
+          _mm256_mul_ps(_mm256_set1_ps(abs_normal.z), half_extent_z));
+      const __m256 is_inside = _mm256_cmp_ps(
+          distance, _mm256_sub_ps(_mm256_setzero_ps(), radius), _CMP_GE_OQ);
+      is_visible = p == 0 ? is_inside : _mm256_and_ps(is_visible, is_inside);
+    }
+    num_visible += CompactAvx2(_mm256_movemask_ps(is_visible), i,
+                               output + num_visible);
+  }
+  *num_processed = end;
+  return num_visible;
+}
+
+#endif  // LIGHTER_USE_AVX2
+
+// Returns the best available instruction set that is no better than
+// 'requested'.
+InstructionSet GetAvailableInstructionSet(InstructionSet requested) {
+  const InstructionSet best = GetBestInstructionSet();
+  return static_cast<int>(requested) < static_cast<int>(best) ? requested
+                                                              : best;
+}
+
+// Culls objects in 'batch' with the implementation for 'instruction_set'.
+// Functions passed in are the implementations defined above.
+template <typename Batch, typename ScalarFunc, typename SimdFunc>
+void Cull(const FrustumPlanes& planes, const Batch& batch,
+          InstructionSet instruction_set, ScalarFunc&& cull_scalar,
+          SimdFunc&& cull_simd, std::vector<int>* visible_indices) {
+  // Implementations may write up to the number of objects.
+  visible_indices->resize(batch.size());
+  int* output = visible_indices->data();
+  int num_processed = 0;
+  int num_visible = cull_simd(GetAvailableInstructionSet(instruction_set),
+                              planes, batch, output, &num_processed);
+  num_visible += cull_scalar(planes, batch, num_processed,
+                             output + num_visible);
+  visible_indices->resize(num_visible);
+}
+
+}  // namespace
+
+InstructionSet GetBestInstructionSet() {
+#if defined(LIGHTER_USE_AVX2)
+  return InstructionSet::kAvx2;
+#elif defined(LIGHTER_USE_SSE)
+  return InstructionSet::kSse;
+#else
+  return InstructionSet::kScalar;
+#endif
+}
+
+void CullSpheres(const FrustumPlanes& planes, const SphereBatch& spheres,
+                 std::vector<int>* visible_indices,
+                 InstructionSet instruction_set) {
+  ASSERT_TRUE(spheres.center_y.size() == spheres.radii.size() &&
+                  spheres.center_z.size() == spheres.radii.size() &&
+                  spheres.center_x.size() == spheres.radii.size(),
+              "Sizes of sphere attributes mismatch");
+  Cull(planes, spheres, instruction_set, CullSpheresScalar,
+       [](InstructionSet instruction_set, const FrustumPlanes& planes,
+          const SphereBatch& spheres, int* output, int* num_processed) {
+         switch (instruction_set) {
+#ifdef LIGHTER_USE_AVX2
+           case InstructionSet::kAvx2:
+             return CullSpheresAvx2(planes, spheres, output, num_processed);
+#endif  // LIGHTER_USE_AVX2
+#ifdef LIGHTER_USE_SSE
+           case InstructionSet::kSse:
+             return CullSpheresSse(planes, spheres, output, num_processed);
+#endif  // LIGHTER_USE_SSE
+           default:
+             *num_processed = 0;
+             return 0;
+         }
+       },
+       visible_indices);
+}
+
+void CullAabbs(const FrustumPlanes& planes, const AabbBatch& aabbs,
+               std::vector<int>* visible_indices,
+               InstructionSet instruction_set) {
+  const size_t size = aabbs.center_x.size();
+  ASSERT_TRUE(aabbs.center_y.size() == size && aabbs.center_z.size() == size &&
+                  aabbs.half_extent_x.size() == size &&
+                  aabbs.half_extent_y.size() == size &&
+                  aabbs.half_extent_z.size() == size,
+              "Sizes of box attributes mismatch");
+  Cull(planes, aabbs, instruction_set, CullAabbsScalar,
+       [](InstructionSet instruction_set, const FrustumPlanes& planes,
+          const AabbBatch& aabbs, int* output, int* num_processed) {
+         switch (instruction_set) {
+#ifdef LIGHTER_USE_AVX2
+           case InstructionSet::kAvx2:
+             return CullAabbsAvx2(planes, aabbs, output, num_processed);
+#endif  // LIGHTER_USE_AVX2
+#ifdef LIGHTER_USE_SSE
+           case InstructionSet::kSse:
+             return CullAabbsSse(planes, aabbs, output, num_processed);
+#endif  // LIGHTER_USE_SSE
+           default:
+             *num_processed = 0;
+             return 0;
+         }
+       },
+       visible_indices);
+}
+
+}  // namespace lighter::common::frustum_culling
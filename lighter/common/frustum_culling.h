@@ -0,0 +1,84 @@
+//
+//  frustum_culling.h
+//
+//  Created by Pujun Lun on 6/21/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#ifndef LIGHTER_COMMON_FRUSTUM_CULLING_H
+#define LIGHTER_COMMON_FRUSTUM_CULLING_H
+
+#include <vector>
+
+#include "lighter/common/bounds.h"
+#include "third_party/glm/glm.hpp"
+
+namespace lighter::common::frustum_culling {
+
+// Instruction sets that can be used for batch culling. kAvx2 is available if
+// the code is compiled with AVX2 enabled (e.g. 'bazel build --config=avx2'),
+// and kSse is available on all x86-64 processors. If an instruction set that is
+// not available is requested, the best available one will be used instead.
+enum class InstructionSet { kScalar, kSse, kAvx2 };
+
+// Returns the best instruction set available.
+InstructionSet GetBestInstructionSet();
+
+// Bounding spheres stored as a structure of arrays, so that multiple spheres
+// can be tested at once with SIMD instructions.
+struct SphereBatch {
+  void Add(const glm::vec3& center, float radius) {
+    center_x.push_back(center.x);
+    center_y.push_back(center.y);
+    center_z.push_back(center.z);
+    radii.push_back(radius);
+  }
+
+  int size() const { return static_cast<int>(radii.size()); }
+
+  std::vector<float> center_x;
+  std::vector<float> center_y;
+  std::vector<float> center_z;
+  std::vector<float> radii;
+};
+
+// Axis-aligned bounding boxes stored as a structure of arrays, in the form of
+// centers and half extents.
+struct AabbBatch {
+  void Add(const Aabb& aabb) {
+    const glm::vec3 center = aabb.center();
+    const glm::vec3 half_extent = aabb.extent() * 0.5f;
+    center_x.push_back(center.x);
+    center_y.push_back(center.y);
+    center_z.push_back(center.z);
+    half_extent_x.push_back(half_extent.x);
+    half_extent_y.push_back(half_extent.y);
+    half_extent_z.push_back(half_extent.z);
+  }
+
+  int size() const { return static_cast<int>(center_x.size()); }
+
+  std::vector<float> center_x;
+  std::vector<float> center_y;
+  std::vector<float> center_z;
+  std::vector<float> half_extent_x;
+  std::vector<float> half_extent_y;
+  std::vector<float> half_extent_z;
+};
+
+// Tests all 'spheres' against the frustum, and writes indices of ones that are
+// not completely outside of any plane to 'visible_indices' in ascending order.
+// Previous content of 'visible_indices' is discarded.
+void CullSpheres(const FrustumPlanes& planes, const SphereBatch& spheres,
+                 std::vector<int>* visible_indices,
+                 InstructionSet instruction_set = GetBestInstructionSet());
+
+// Same as CullSpheres(), but tests axis-aligned bounding boxes. The test is the
+// same as IsOutsideFrustum().
+void CullAabbs(const FrustumPlanes& planes, const AabbBatch& aabbs,
+               std::vector<int>* visible_indices,
+               InstructionSet instruction_set = GetBestInstructionSet());
+
+}  // namespace lighter::common::frustum_culling
+
+#endif  // LIGHTER_COMMON_FRUSTUM_CULLING_H
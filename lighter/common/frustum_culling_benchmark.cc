@@ -0,0 +1,111 @@
+//
+//  frustum_culling_benchmark.cc
+//
+//  Created by Pujun Lun on 6/21/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include <random>
+#include <vector>
+
+#include "lighter/common/bounds.h"
+#include "lighter/common/frustum_culling.h"
+#include "third_party/absl/flags/flag.h"
+#include "third_party/absl/flags/parse.h"
+#include "third_party/absl/strings/str_cat.h"
+#include "third_party/benchmark/benchmark.h"
+#include "third_party/glm/glm.hpp"
+#include "third_party/glm/gtc/matrix_transform.hpp"
+
+ABSL_FLAG(int, num_objects, 1 << 16, "Number of objects to cull");
+
+namespace lighter::common::frustum_culling {
+namespace {
+
+// Objects are randomly distributed in a cube, and about half of them are within
+// the frustum.
+struct Scene {
+  explicit Scene(int num_objects) {
+    std::mt19937 rand_gen{/*seed=*/0};
+    std::uniform_real_distribution<float> pos_dist{-50.0f, 50.0f};
+    std::uniform_real_distribution<float> size_dist{0.1f, 1.0f};
+    for (int i = 0; i < num_objects; ++i) {
+      const glm::vec3 center{pos_dist(rand_gen), pos_dist(rand_gen),
+                             pos_dist(rand_gen)};
+      const float size = size_dist(rand_gen);
+      spheres.Add(center, size);
+      aabbs.Add(Aabb{center - size, center + size});
+    }
+
+    const glm::mat4 proj = glm::perspective(glm::radians(60.0f),
+                                            /*aspect=*/1.5f, 0.1f, 100.0f);
+    const glm::mat4 view = glm::lookAt(glm::vec3{0.0f, 0.0f, 50.0f},
+                                       /*center=*/glm::vec3{0.0f},
+                                       /*up=*/glm::vec3{0.0f, 1.0f, 0.0f});
+    planes = ExtractFrustumPlanes(proj * view);
+  }
+
+  SphereBatch spheres;
+  AabbBatch aabbs;
+  FrustumPlanes planes;
+};
+
+void BM_CullSpheres(benchmark::State& state, const Scene* scene,
+                    InstructionSet instruction_set) {
+  std::vector<int> visible_indices;
+  for (auto _ : state) {
+    CullSpheres(scene->planes, scene->spheres, &visible_indices,
+                instruction_set);
+    benchmark::DoNotOptimize(visible_indices.data());
+  }
+  state.SetItemsProcessed(state.iterations() * scene->spheres.size());
+  state.counters["visible"] = visible_indices.size();
+}
+
+void BM_CullAabbs(benchmark::State& state, const Scene* scene,
+                  InstructionSet instruction_set) {
+  std::vector<int> visible_indices;
+  for (auto _ : state) {
+    CullAabbs(scene->planes, scene->aabbs, &visible_indices, instruction_set);
+    benchmark::DoNotOptimize(visible_indices.data());
+  }
+  state.SetItemsProcessed(state.iterations() * scene->aabbs.size());
+  state.counters["visible"] = visible_indices.size();
+}
+
+}  // namespace
+}  // namespace lighter::common::frustum_culling
+
+int main(int argc, char* argv[]) {
+  using namespace lighter::common::frustum_culling;
+
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+
+  const Scene scene{absl::GetFlag(FLAGS_num_objects)};
+  const struct {
+    const char* name;
+    InstructionSet instruction_set;
+  } instruction_sets[]{
+      {"Scalar", InstructionSet::kScalar},
+      {"Sse", InstructionSet::kSse},
+      {"Avx2", InstructionSet::kAvx2},
+  };
+  for (const auto& [name, instruction_set] : instruction_sets) {
+    // Skip instruction sets that are not compiled in.
+    if (static_cast<int>(instruction_set) >
+        static_cast<int>(GetBestInstructionSet())) {
+      continue;
+    }
+    benchmark::RegisterBenchmark(
+        absl::StrCat("BM_CullSpheres/", name).c_str(), BM_CullSpheres,
+        &scene, instruction_set)
+        ->Unit(benchmark::kMicrosecond);
+    benchmark::RegisterBenchmark(
+        absl::StrCat("BM_CullAabbs/", name).c_str(), BM_CullAabbs,
+        &scene, instruction_set)
+        ->Unit(benchmark::kMicrosecond);
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,114 @@
+//
+//  frustum_culling_test.cc
+//
+//  Created by Pujun Lun on 6/21/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/frustum_culling.h"
+
+#include <random>
+#include <vector>
+
+#include "lighter/common/bounds.h"
+#include "third_party/glm/gtc/matrix_transform.hpp"
+
+#ifdef ASSERT_TRUE
+#undef ASSERT_TRUE
+#endif
+#ifdef ASSERT_FALSE
+#undef ASSERT_FALSE
+#endif
+#include "third_party/gtest/gtest.h"
+
+namespace lighter::common::frustum_culling {
+namespace {
+
+// Not a multiple of any SIMD width, so that remainders are also tested.
+constexpr int kNumObjects = 1003;
+
+constexpr InstructionSet kInstructionSets[]{
+    InstructionSet::kScalar, InstructionSet::kSse, InstructionSet::kAvx2};
+
+FrustumPlanes GetTestFrustumPlanes() {
+  const glm::mat4 proj = glm::perspective(glm::radians(60.0f),
+                                          /*aspect=*/1.5f, 0.1f, 40.0f);
+  const glm::mat4 view = glm::lookAt(glm::vec3{3.0f, 4.0f, 30.0f},
+                                     /*center=*/glm::vec3{0.0f},
+                                     /*up=*/glm::vec3{0.0f, 1.0f, 0.0f});
+  return ExtractFrustumPlanes(proj * view);
+}
+
+TEST(FrustumCullingTest, CullSpheres) {
+  std::mt19937 rand_gen{/*seed=*/0};
+  std::uniform_real_distribution<float> pos_dist{-30.0f, 30.0f};
+  std::uniform_real_distribution<float> radius_dist{0.1f, 3.0f};
+  SphereBatch spheres;
+  for (int i = 0; i < kNumObjects; ++i) {
+    spheres.Add({pos_dist(rand_gen), pos_dist(rand_gen), pos_dist(rand_gen)},
+                radius_dist(rand_gen));
+  }
+
+  const FrustumPlanes planes = GetTestFrustumPlanes();
+  std::vector<int> expected;
+  for (int i = 0; i < kNumObjects; ++i) {
+    const glm::vec4 center{spheres.center_x[i], spheres.center_y[i],
+                           spheres.center_z[i], 1.0f};
+    bool is_visible = true;
+    for (const glm::vec4& plane : planes) {
+      is_visible &= glm::dot(plane, center) >= -spheres.radii[i];
+    }
+    if (is_visible) {
+      expected.push_back(i);
+    }
+  }
+  ASSERT_FALSE(expected.empty());
+  ASSERT_LT(expected.size(), kNumObjects);
+
+  for (const InstructionSet instruction_set : kInstructionSets) {
+    std::vector<int> visible_indices{-1};
+    CullSpheres(planes, spheres, &visible_indices, instruction_set);
+    EXPECT_EQ(visible_indices, expected);
+  }
+}
+
+TEST(FrustumCullingTest, CullAabbs) {
+  std::mt19937 rand_gen{/*seed=*/1};
+  std::uniform_real_distribution<float> pos_dist{-30.0f, 30.0f};
+  std::uniform_real_distribution<float> extent_dist{0.1f, 3.0f};
+  std::vector<Aabb> boxes;
+  AabbBatch aabbs;
+  for (int i = 0; i < kNumObjects; ++i) {
+    const glm::vec3 min{pos_dist(rand_gen), pos_dist(rand_gen),
+                        pos_dist(rand_gen)};
+    const glm::vec3 extent{extent_dist(rand_gen), extent_dist(rand_gen),
+                           extent_dist(rand_gen)};
+    boxes.push_back(Aabb{min, min + extent});
+    aabbs.Add(boxes.back());
+  }
+
+  const FrustumPlanes planes = GetTestFrustumPlanes();
+  std::vector<int> expected;
+  for (int i = 0; i < kNumObjects; ++i) {
+    if (!IsOutsideFrustum(planes, boxes[i])) {
+      expected.push_back(i);
+    }
+  }
+  ASSERT_FALSE(expected.empty());
+  ASSERT_LT(expected.size(), kNumObjects);
+
+  for (const InstructionSet instruction_set : kInstructionSets) {
+    std::vector<int> visible_indices;
+    CullAabbs(planes, aabbs, &visible_indices, instruction_set);
+    EXPECT_EQ(visible_indices, expected);
+  }
+}
+
+TEST(FrustumCullingTest, EmptyBatch) {
+  std::vector<int> visible_indices{0, 1, 2};
+  CullSpheres(GetTestFrustumPlanes(), SphereBatch{}, &visible_indices);
+  EXPECT_TRUE(visible_indices.empty());
+}
+
+}  // namespace
+}  // namespace lighter::common::frustum_culling
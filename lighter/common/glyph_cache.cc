@@ -0,0 +1,201 @@
+//
+//  glyph_cache.cc
+//
+//  Created by Pujun Lun on 6/30/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/glyph_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <utility>
+
+#include "lighter/common/util.h"
+#include "third_party/absl/container/flat_hash_set.h"
+#include "third_party/absl/strings/str_format.h"
+
+namespace lighter::common {
+namespace {
+
+// Number of pixels between glyphs on pages. We add this padding so that when
+// sampling one glyph, other glyphs will not affect the result due to linear
+// filtering or numeric errors.
+constexpr int kPaddingBetweenGlyphs = 2;
+
+}  // namespace
+
+GlyphCache::GlyphCache(const std::string& font_path, int font_height,
+                       GlyphMode glyph_mode, const Config& config)
+    : GlyphCache{
+          // Glyphs are flipped so that the bottom row comes first.
+          [font_path, font_height, glyph_mode](
+              absl::Span<const char32_t> codepoints) {
+            return CharLib::LoadGlyphs(font_path, font_height, codepoints,
+                                       /*flip_y=*/true, glyph_mode);
+          },
+          glyph_mode, CharLib::GetGlyphPadding(glyph_mode, font_height),
+          config} {}
+
+GlyphCache::GlyphCache(GlyphLoader&& glyph_loader, GlyphMode glyph_mode,
+                       int glyph_padding, const Config& config)
+    : config_{config},
+      glyph_mode_{glyph_mode},
+      glyph_padding_{glyph_padding},
+      glyph_loader_{std::move(glyph_loader)},
+      rect_packer_{RectPacker::Config{config_.page_size, kPaddingBetweenGlyphs,
+                                      config_.max_num_pages}} {
+  ASSERT_TRUE(config_.max_num_pages > 0,
+              absl::StrFormat("Maximum number of pages must be positive, while "
+                              "%d provided", config_.max_num_pages));
+}
+
+void GlyphCache::LoadGlyphs(absl::Span<const char32_t> codepoints) {
+  absl::flat_hash_set<char32_t> codepoints_to_load_set;
+  std::vector<char32_t> codepoints_to_load;
+  for (const auto codepoint : codepoints) {
+    if (!glyph_info_map_.contains(codepoint) &&
+        codepoints_to_load_set.insert(codepoint).second) {
+      codepoints_to_load.push_back(codepoint);
+    }
+  }
+  if (codepoints_to_load.empty()) {
+    return;
+  }
+
+  const std::vector<CharLib::CharInfo> char_infos =
+      glyph_loader_(codepoints_to_load);
+  for (int i = 0; i < codepoints_to_load.size(); ++i) {
+    AddGlyph(codepoints_to_load[i], char_infos[i]);
+  }
+}
+
+GlyphCache::GlyphInfo GlyphCache::GetGlyph(char32_t codepoint) {
+  auto iter = glyph_info_map_.find(codepoint);
+  if (iter == glyph_info_map_.end()) {
+    LoadGlyphs(absl::MakeConstSpan(&codepoint, 1));
+    iter = glyph_info_map_.find(codepoint);
+  }
+  const GlyphInfo& glyph_info = iter->second;
+  if (glyph_info.page != kNoPage) {
+    pages_[glyph_info.page].last_used_frame = frame_;
+  }
+  return glyph_info;
+}
+
+std::vector<GlyphCache::DirtyRegion> GlyphCache::FlushDirtyRegions() {
+  std::vector<DirtyRegion> regions;
+  for (int page_index = 0; page_index < pages_.size(); ++page_index) {
+    Page& page = pages_[page_index];
+    if (!glm::all(glm::lessThan(page.dirty_min, page.dirty_max))) {
+      continue;
+    }
+
+    const glm::ivec2 extent = page.dirty_max - page.dirty_min;
+    std::vector<uint8_t> pixels(static_cast<size_t>(extent.x) * extent.y);
+    for (int row = 0; row < extent.y; ++row) {
+      const size_t page_offset =
+          static_cast<size_t>(page.dirty_min.y + row) * config_.page_size.x +
+          page.dirty_min.x;
+      std::memcpy(pixels.data() + static_cast<size_t>(row) * extent.x,
+                  page.pixels.data() + page_offset, extent.x);
+    }
+    regions.push_back(
+        DirtyRegion{page_index, page.dirty_min, extent, std::move(pixels)});
+    page.dirty_min = config_.page_size;
+    page.dirty_max = glm::ivec2{0};
+  }
+  return regions;
+}
+
+void GlyphCache::AddGlyph(char32_t codepoint,
+                          const CharLib::CharInfo& char_info) {
+  const glm::ivec2 size{char_info.image.width(), char_info.image.height()};
+  if (size.x == 0 || size.y == 0) {
+    glyph_info_map_.insert({codepoint, GlyphInfo{
+        size, char_info.bearing, char_info.advance, kNoPage,
+        /*offset=*/glm::ivec2{0},
+    }});
+    return;
+  }
+
+  // Check this before evicting any page, since RectPacker would not be able to
+  // pack the glyph anyway.
+  ASSERT_TRUE(glm::all(glm::lessThanEqual(size + kPaddingBetweenGlyphs * 2,
+                                          config_.page_size)),
+              absl::StrFormat("Glyph of U+%04X has size (%d, %d), which does "
+                              "not fit in pages of size (%d, %d) with padding "
+                              "%d", static_cast<uint32_t>(codepoint), size.x,
+                              size.y, config_.page_size.x, config_.page_size.y,
+                              kPaddingBetweenGlyphs));
+  std::optional<RectPacker::Placement> placement = rect_packer_.Insert(size);
+  if (!placement.has_value()) {
+    EvictPage();
+    placement = rect_packer_.Insert(size);
+  }
+  const auto [page_index, offset] = placement.value();
+  if (page_index == pages_.size()) {
+    pages_.push_back(CreatePage());
+  }
+  glyph_info_map_.insert({codepoint, GlyphInfo{
+      size, char_info.bearing, char_info.advance, page_index, offset,
+  }});
+
+  Page& page = pages_[page_index];
+  page.codepoints.push_back(codepoint);
+  page.last_used_frame = frame_;
+  const auto* image_data =
+      static_cast<const uint8_t*>(char_info.image.data_ptrs()[0]);
+  for (int row = 0; row < size.y; ++row) {
+    std::memcpy(page.pixels.data() +
+                    static_cast<size_t>(offset.y + row) * config_.page_size.x +
+                    offset.x,
+                image_data + static_cast<size_t>(row) * size.x, size.x);
+  }
+
+  // Padding around the glyph is included, so that pixels left by evicted
+  // glyphs are also cleared on the device.
+  page.dirty_min = glm::max(
+      glm::min(page.dirty_min, offset - kPaddingBetweenGlyphs), glm::ivec2{0});
+  page.dirty_max =
+      glm::min(glm::max(page.dirty_max, offset + size + kPaddingBetweenGlyphs),
+               config_.page_size);
+}
+
+int GlyphCache::EvictPage() {
+  int page_to_evict = kNoPage;
+  uint64_t least_recent_frame = std::numeric_limits<uint64_t>::max();
+  for (int i = 0; i < pages_.size(); ++i) {
+    const uint64_t last_used_frame = pages_[i].last_used_frame;
+    if (last_used_frame + config_.num_frames_to_retain <= frame_ &&
+        last_used_frame < least_recent_frame) {
+      page_to_evict = i;
+      least_recent_frame = last_used_frame;
+    }
+  }
+  ASSERT_TRUE(page_to_evict != kNoPage,
+              absl::StrFormat("All %d pages are used in the latest %d frames, "
+                              "consider increasing the number of pages",
+                              pages_.size(), config_.num_frames_to_retain));
+
+  for (const auto codepoint : pages_[page_to_evict].codepoints) {
+    glyph_info_map_.erase(codepoint);
+  }
+  rect_packer_.ClearPage(page_to_evict);
+  pages_[page_to_evict] = CreatePage();
+  ++num_evictions_;
+  return page_to_evict;
+}
+
+GlyphCache::Page GlyphCache::CreatePage() const {
+  Page page;
+  page.pixels.resize(
+      static_cast<size_t>(config_.page_size.x) * config_.page_size.y, 0);
+  page.dirty_min = config_.page_size;
+  page.dirty_max = glm::ivec2{0};
+  return page;
+}
+
+}  // namespace lighter::common
@@ -0,0 +1,176 @@
+//
+//  glyph_cache.h
+//
+//  Created by Pujun Lun on 6/30/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#ifndef LIGHTER_COMMON_GLYPH_CACHE_H
+#define LIGHTER_COMMON_GLYPH_CACHE_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "lighter/common/char_lib.h"
+#include "lighter/common/rect_packer.h"
+#include "third_party/absl/container/flat_hash_map.h"
+#include "third_party/absl/types/span.h"
+#include "third_party/glm/glm.hpp"
+
+namespace lighter::common {
+
+// Loads glyphs of Unicode codepoints on demand, and packs them into pages of a
+// fixed size with RectPacker. Pixels of pages are kept on the host, and regions
+// that have been modified are reported by FlushDirtyRegions(), so that the user
+// only needs to upload those regions to the device.
+// If all pages are full, the least recently used page is evicted, i.e. all
+// glyphs on it are dropped and it is reused for new glyphs. Pages used in the
+// latest 'num_frames_to_retain' frames are never evicted, since the device may
+// still be reading them. The user should call NextFrame() once per frame.
+// Glyph images are stored with the bottom row first, hence a glyph occupies
+// rows ['offset.y', 'offset.y' + 'size.y') of its page from bottom to top.
+class GlyphCache {
+ public:
+  using GlyphMode = CharLib::GlyphMode;
+
+  // Page index of glyphs that are not packed into any page.
+  static constexpr int kNoPage = -1;
+
+  struct Config {
+    glm::ivec2 page_size{512, 512};
+    int max_num_pages = 4;
+    int num_frames_to_retain = 2;
+  };
+
+  // Information about a glyph that has been packed into a page. 'size' and
+  // 'offset' are in number of pixels on the page. 'bearing' and 'advance' are
+  // in number of pixels in the layout, and 'bearing' takes the glyph padding
+  // into account, same as CharLib::CharInfo. Glyphs with zero area, such as
+  // the space character, are not packed, and their 'page' is kNoPage.
+  struct GlyphInfo {
+    glm::ivec2 size;
+    glm::ivec2 bearing;
+    glm::ivec2 advance;
+    int page;
+    glm::ivec2 offset;
+  };
+
+  // A rectangular region of a page that has been modified. 'pixels' holds
+  // 'extent.x' * 'extent.y' tightly packed single-channel pixels.
+  struct DirtyRegion {
+    int page;
+    glm::ivec2 offset;
+    glm::ivec2 extent;
+    std::vector<uint8_t> pixels;
+  };
+
+  // Loads glyphs of all codepoints in 'codepoints', and returns them in the
+  // same order. Glyph images should be stored with the bottom row first.
+  using GlyphLoader = std::function<std::vector<CharLib::CharInfo>(
+      absl::Span<const char32_t> codepoints)>;
+
+  // Glyphs are loaded from the font at 'font_path' with CharLib.
+  GlyphCache(const std::string& font_path, int font_height,
+             GlyphMode glyph_mode, const Config& config);
+
+  // Glyphs are loaded with 'glyph_loader', and images are padded by
+  // 'glyph_padding' pixels on each side. This is mainly used for testing.
+  GlyphCache(GlyphLoader&& glyph_loader, GlyphMode glyph_mode,
+             int glyph_padding, const Config& config);
+
+  // This class is neither copyable nor movable.
+  GlyphCache(const GlyphCache&) = delete;
+  GlyphCache& operator=(const GlyphCache&) = delete;
+
+  // Loads glyphs of all codepoints in 'codepoints' that are not cached yet.
+  // Loading many glyphs with one call is faster, since glyphs are loaded on
+  // multiple threads.
+  void LoadGlyphs(absl::Span<const char32_t> codepoints);
+
+  // Returns the glyph of 'codepoint', which will be loaded if not cached yet,
+  // and marks its page as used in the current frame. The returned information
+  // stays valid until the page is evicted, which will not happen within
+  // 'num_frames_to_retain' frames.
+  GlyphInfo GetGlyph(char32_t codepoint);
+
+  // Marks 'page' as used in the current frame. This is useful if the user keeps
+  // glyph information returned by GetGlyph() across frames.
+  void MarkPageUsed(int page) { pages_.at(page).last_used_frame = frame_; }
+
+  // Returns regions modified since the last call, at most one for each page.
+  std::vector<DirtyRegion> FlushDirtyRegions();
+
+  // Advances the frame counter used for determining the least recently used
+  // page.
+  void NextFrame() { ++frame_; }
+
+  // Accessors.
+  const Config& config() const { return config_; }
+  GlyphMode glyph_mode() const { return glyph_mode_; }
+  int glyph_padding() const { return glyph_padding_; }
+  int num_evictions() const { return num_evictions_; }
+
+ private:
+  // Information about each page.
+  struct Page {
+    // Single-channel pixels, from the bottom row to the top row.
+    std::vector<uint8_t> pixels;
+
+    // Codepoints of glyphs on this page.
+    std::vector<char32_t> codepoints;
+
+    // Frame in which any glyph on this page was used for the last time.
+    uint64_t last_used_frame = 0;
+
+    // Bounding box of modified pixels, where 'dirty_min' is inclusive and
+    // 'dirty_max' is exclusive. Empty if 'dirty_min' is not less than
+    // 'dirty_max'.
+    glm::ivec2 dirty_min;
+    glm::ivec2 dirty_max;
+  };
+
+  // Packs 'char_info' of 'codepoint' into a page, evicting the least recently
+  // used page if needed, and copies its image to that page. The image must fit
+  // in an empty page, otherwise this will throw a runtime exception.
+  void AddGlyph(char32_t codepoint, const CharLib::CharInfo& char_info);
+
+  // Evicts the least recently used page that is not retained, and returns its
+  // index. If all pages are retained, this will throw a runtime exception.
+  int EvictPage();
+
+  // Returns a page with all pixels cleared and nothing dirty.
+  Page CreatePage() const;
+
+  // Configurations of the cache.
+  const Config config_;
+
+  // Determines how glyph images are generated.
+  const GlyphMode glyph_mode_;
+
+  // Number of pixels padded on each side of glyph images.
+  const int glyph_padding_;
+
+  // Loads glyphs that are not cached yet.
+  const GlyphLoader glyph_loader_;
+
+  // Packs glyphs into pages.
+  RectPacker rect_packer_;
+
+  // Pages that have been opened by 'rect_packer_'.
+  std::vector<Page> pages_;
+
+  // Maps codepoints to glyphs in 'pages_'.
+  absl::flat_hash_map<char32_t, GlyphInfo> glyph_info_map_;
+
+  // Current frame.
+  uint64_t frame_ = 0;
+
+  // Number of pages evicted so far.
+  int num_evictions_ = 0;
+};
+
+}  // namespace lighter::common
+
+#endif  // LIGHTER_COMMON_GLYPH_CACHE_H
@@ -0,0 +1,192 @@
+//
+//  glyph_cache_test.cc
+//
+//  Created by Pujun Lun on 6/30/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/glyph_cache.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "lighter/common/char_lib.h"
+#include "lighter/common/image.h"
+#include "lighter/common/memory_pool.h"
+#include "third_party/absl/types/span.h"
+#include "third_party/glm/glm.hpp"
+#include "third_party/gtest/gtest.h"
+
+namespace lighter::common {
+namespace {
+
+using GlyphInfo = GlyphCache::GlyphInfo;
+
+// Must be consistent with the padding used by GlyphCache.
+constexpr int kPadding = 2;
+
+// With this page size, only one glyph of kLargeGlyphSize fits in each page.
+const glm::ivec2 kPageSize{64, 64};
+const glm::ivec2 kLargeGlyphSize{40, 40};
+
+// Loads fake glyphs, and records how many glyphs have been loaded. Every pixel
+// of a glyph stores the lower 8 bits of its codepoint.
+class FakeGlyphLoader {
+ public:
+  explicit FakeGlyphLoader(const glm::ivec2& glyph_size)
+      : glyph_size_{glyph_size} {}
+
+  GlyphCache::GlyphLoader GetLoader() {
+    return [this](absl::Span<const char32_t> codepoints) {
+      std::vector<CharLib::CharInfo> char_infos;
+      for (const auto codepoint : codepoints) {
+        ++num_loaded_glyphs_;
+        const size_t data_size =
+            static_cast<size_t>(glyph_size_.x) * glyph_size_.y;
+        auto data = memory_pool::AllocateBuffer(data_size);
+        std::memset(data.get(), static_cast<int>(codepoint & 0xFF), data_size);
+        char_infos.push_back(CharLib::CharInfo{
+            /*bearing=*/glm::ivec2{0, glyph_size_.y},
+            /*advance=*/glm::ivec2{glyph_size_.x, 0},
+            Image{glyph_size_.x, glyph_size_.y, image::kBwImageChannel,
+                  std::move(data)},
+        });
+      }
+      return char_infos;
+    };
+  }
+
+  int num_loaded_glyphs() const { return num_loaded_glyphs_; }
+
+ private:
+  const glm::ivec2 glyph_size_;
+  int num_loaded_glyphs_ = 0;
+};
+
+// Returns a cache that holds at most 'max_num_pages' pages of kPageSize.
+GlyphCache CreateCache(FakeGlyphLoader* loader, int max_num_pages,
+                       int num_frames_to_retain) {
+  GlyphCache::Config config;
+  config.page_size = kPageSize;
+  config.max_num_pages = max_num_pages;
+  config.num_frames_to_retain = num_frames_to_retain;
+  return GlyphCache{loader->GetLoader(), CharLib::GlyphMode::kBitmap,
+                    /*glyph_padding=*/0, config};
+}
+
+TEST(GlyphCacheTest, ReportDirtyRegions) {
+  const glm::ivec2 kGlyphSize{10, 12};
+  FakeGlyphLoader loader{kGlyphSize};
+  GlyphCache cache = CreateCache(&loader, /*max_num_pages=*/1,
+                                 /*num_frames_to_retain=*/1);
+  const std::vector<char32_t> codepoints{'a', 'b', 'c'};
+  cache.LoadGlyphs(codepoints);
+  cache.LoadGlyphs(codepoints);
+  EXPECT_EQ(loader.num_loaded_glyphs(), 3);
+
+  glm::ivec2 glyphs_min{kPageSize};
+  glm::ivec2 glyphs_max{0};
+  std::vector<GlyphInfo> glyph_infos;
+  for (const auto codepoint : codepoints) {
+    const GlyphInfo glyph_info = cache.GetGlyph(codepoint);
+    EXPECT_EQ(glyph_info.page, 0);
+    EXPECT_EQ(glyph_info.size, kGlyphSize);
+    glyphs_min = glm::min(glyphs_min, glyph_info.offset);
+    glyphs_max = glm::max(glyphs_max, glyph_info.offset + glyph_info.size);
+    glyph_infos.push_back(glyph_info);
+  }
+
+  // One region encloses all glyphs and the padding around them.
+  const std::vector<GlyphCache::DirtyRegion> regions =
+      cache.FlushDirtyRegions();
+  ASSERT_EQ(regions.size(), 1);
+  const GlyphCache::DirtyRegion& region = regions[0];
+  EXPECT_EQ(region.page, 0);
+  EXPECT_EQ(region.offset, glm::max(glyphs_min - kPadding, glm::ivec2{0}));
+  EXPECT_EQ(region.offset + region.extent,
+            glm::min(glyphs_max + kPadding, kPageSize));
+  ASSERT_EQ(region.pixels.size(),
+            static_cast<size_t>(region.extent.x) * region.extent.y);
+  for (int i = 0; i < codepoints.size(); ++i) {
+    const glm::ivec2 offset = glyph_infos[i].offset - region.offset;
+    for (int y = 0; y < kGlyphSize.y; ++y) {
+      for (int x = 0; x < kGlyphSize.x; ++x) {
+        ASSERT_EQ(region.pixels[(offset.y + y) * region.extent.x + offset.x + x],
+                  codepoints[i]);
+      }
+    }
+  }
+
+  // Nothing is dirty until more glyphs are loaded.
+  EXPECT_TRUE(cache.FlushDirtyRegions().empty());
+  const GlyphInfo glyph_info = cache.GetGlyph('d');
+  const std::vector<GlyphCache::DirtyRegion> new_regions =
+      cache.FlushDirtyRegions();
+  ASSERT_EQ(new_regions.size(), 1);
+  EXPECT_EQ(new_regions[0].offset, glyph_info.offset - kPadding);
+  EXPECT_EQ(new_regions[0].extent, kGlyphSize + kPadding * 2);
+}
+
+TEST(GlyphCacheTest, EvictLeastRecentlyUsedPage) {
+  FakeGlyphLoader loader{kLargeGlyphSize};
+  GlyphCache cache = CreateCache(&loader, /*max_num_pages=*/3,
+                                 /*num_frames_to_retain=*/1);
+  // Glyph 'a', 'b' and 'c' are used in frame 0, 1 and 2 respectively.
+  for (const char32_t codepoint : {'a', 'b', 'c'}) {
+    EXPECT_EQ(cache.GetGlyph(codepoint).page, codepoint - 'a');
+    cache.NextFrame();
+  }
+  cache.FlushDirtyRegions();
+
+  // Glyph 'a' is used again, hence the page of 'b' is the least recently used.
+  cache.GetGlyph('a');
+  EXPECT_EQ(cache.GetGlyph('d').page, 1);
+  EXPECT_EQ(cache.num_evictions(), 1);
+
+  // The evicted page is cleared on the device as well.
+  const std::vector<GlyphCache::DirtyRegion> regions =
+      cache.FlushDirtyRegions();
+  ASSERT_EQ(regions.size(), 1);
+  EXPECT_EQ(regions[0].page, 1);
+
+  // Glyph 'a' and 'd' are still cached, while 'b' has to be loaded again,
+  // evicting the page of 'c'.
+  const int num_loaded_glyphs = loader.num_loaded_glyphs();
+  cache.GetGlyph('a');
+  cache.GetGlyph('d');
+  EXPECT_EQ(loader.num_loaded_glyphs(), num_loaded_glyphs);
+  cache.NextFrame();
+  EXPECT_EQ(cache.GetGlyph('b').page, 2);
+  EXPECT_EQ(loader.num_loaded_glyphs(), num_loaded_glyphs + 1);
+  EXPECT_EQ(cache.num_evictions(), 2);
+}
+
+TEST(GlyphCacheTest, KeepRetainedPages) {
+  FakeGlyphLoader loader{kLargeGlyphSize};
+  GlyphCache cache = CreateCache(&loader, /*max_num_pages=*/2,
+                                 /*num_frames_to_retain=*/2);
+  cache.GetGlyph('a');
+  cache.NextFrame();
+  cache.GetGlyph('b');
+
+  // Both pages are used in the latest 2 frames.
+  EXPECT_THROW(cache.GetGlyph('c'), std::runtime_error);
+  EXPECT_EQ(cache.num_evictions(), 0);
+
+  // The page of 'a' is no longer retained.
+  cache.NextFrame();
+  EXPECT_EQ(cache.GetGlyph('c').page, 0);
+  EXPECT_EQ(cache.num_evictions(), 1);
+}
+
+TEST(GlyphCacheTest, RejectOversizedGlyph) {
+  FakeGlyphLoader loader{kPageSize};
+  GlyphCache cache = CreateCache(&loader, /*max_num_pages=*/2,
+                                 /*num_frames_to_retain=*/1);
+  EXPECT_THROW(cache.GetGlyph('a'), std::runtime_error);
+  EXPECT_EQ(cache.num_evictions(), 0);
+}
+
+}  // namespace
+}  // namespace lighter::common
@@ -7,11 +7,20 @@
 
 #include "lighter/common/image.h"
 
-#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <utility>
 
 #include "lighter/common/file.h"
+#include "lighter/common/pixel_conversion.h"
 #include "lighter/common/util.h"
 #include "third_party/absl/strings/str_cat.h"
+// Let stb allocate memory from the pool, so that decoded images can be adopted
+// without copying.
+#define STBI_MALLOC(size) ::lighter::common::memory_pool::Allocate(size)
+#define STBI_REALLOC(data, size) \
+    ::lighter::common::memory_pool::Reallocate(data, size)
+#define STBI_FREE(data) ::lighter::common::memory_pool::Free(data)
 #define STB_IMAGE_IMPLEMENTATION
 #include "third_party/stb/stb_image.h"
 
@@ -30,6 +39,69 @@ std::vector<std::string> GetFullPaths(
   return paths;
 }
 
+// Decodes image from 'raw_data' without converting the number of channels.
+stbi_uc* DecodeImage(const RawData& raw_data, int* width, int* height,
+                     int* channel) {
+  return stbi_load_from_memory(
+      reinterpret_cast<const stbi_uc*>(raw_data.data),
+      static_cast<int>(raw_data.size), width, height, channel, STBI_default);
+}
+
+// Expands image data of 'num_pixels' RGB pixels to RGBA in place. stb allocates
+// memory from memory_pool, hence the buffer can be enlarged with
+// memory_pool::Reallocate() instead of decoding the image again. The original
+// buffer is invalidated after this call.
+stbi_uc* ExpandToRgba(stbi_uc* data, int num_pixels) {
+  auto* expanded = static_cast<stbi_uc*>(
+      memory_pool::Reallocate(data, static_cast<size_t>(num_pixels) *
+                                        image::kRgbaImageChannel));
+  pixel_conversion::ExpandRgbToRgba(expanded, num_pixels, expanded);
+  return expanded;
+}
+
+// Image decoded by stb.
+struct DecodedImage {
+  stbi_uc* data = nullptr;
+  int width = 0;
+  int height = 0;
+  int channel = 0;
+};
+
+// Converts 'decoded' in place to have the same number of channels as
+// 'dimension', and checks that it has the same width and height. 'raw_data' is
+// the content of the file at 'path', which may be decoded again if stb needs to
+// convert channels.
+void ConvertToDimension(const Image::Dimension& dimension,
+                        std::string_view path, const RawData& raw_data,
+                        DecodedImage* decoded) {
+  if (decoded->data != nullptr && decoded->channel != dimension.channel) {
+    if (decoded->channel == image::kRgbImageChannel
+            && dimension.channel == image::kRgbaImageChannel) {
+      decoded->data = ExpandToRgba(decoded->data,
+                                   decoded->width * decoded->height);
+    } else {
+      // Let stb convert other combinations of channels, which is rare.
+      stbi_image_free(decoded->data);
+      decoded->data = stbi_load_from_memory(
+          reinterpret_cast<const stbi_uc*>(raw_data.data),
+          static_cast<int>(raw_data.size), &decoded->width, &decoded->height,
+          &decoded->channel, /*desired_channels=*/dimension.channel);
+    }
+    decoded->channel = dimension.channel;
+  }
+
+  ASSERT_NON_NULL(decoded->data,
+                  absl::StrFormat("Failed to read image from '%s'", path));
+  ASSERT_TRUE(decoded->width == dimension.width,
+              absl::StrFormat("Image loaded from '%s' has different width (%d "
+                              "vs %d from first image)",
+                              path, decoded->width, dimension.width));
+  ASSERT_TRUE(decoded->height == dimension.height,
+              absl::StrFormat("Image loaded from '%s' has different height (%d "
+                              "vs %d from first image)",
+                              path, decoded->height, dimension.height));
+}
+
 }  // namespace
 
 Image::Image(absl::Span<const std::string> paths) {
@@ -38,44 +110,57 @@ Image::Image(absl::Span<const std::string> paths) {
               absl::StrFormat("Unsupported number of images: %d",
                               paths.size()));
 
-  // Load the first image. The rest of images are expected to have the same
-  // dimension to it.
-  const auto raw_data = std::make_unique<RawData>(paths[0]);
-  stbi_uc* data = stbi_load_from_memory(
-      reinterpret_cast<const stbi_uc*>(raw_data->data),
-      static_cast<int>(raw_data->size),
-      &dimension_.width, &dimension_.height, &dimension_.channel, STBI_default);
-  ASSERT_NON_NULL(
-      data, absl::StrFormat("Failed to read image from '%s'", paths[0]));
-
-  // If the image has 3 channels, reload it so that it has 4 channels.
-  switch (channel()) {
-    case image::kBwImageChannel:
-    case image::kRgbaImageChannel:
-      break;
-
-    case image::kRgbImageChannel: {
-      stbi_image_free(data);
-      data = stbi_load_from_memory(
-          reinterpret_cast<const stbi_uc*>(raw_data->data),
-          static_cast<int>(raw_data->size),
-          &dimension_.width, &dimension_.height, &dimension_.channel,
-          STBI_rgb_alpha);
-      dimension_.channel = STBI_rgb_alpha;
-      break;
+  // Decode all images concurrently, since decoding dominates the loading time.
+  // Dimensions are validated afterwards.
+  const int num_images = static_cast<int>(paths.size());
+  std::vector<std::unique_ptr<RawData>> raw_datas(num_images);
+  std::vector<DecodedImage> decoded_images(num_images);
+  try {
+    util::ParallelFor(num_images, [&](int index) {
+      raw_datas[index] = std::make_unique<RawData>(
+          paths[index], RawData::Mode::kMemoryMapped);
+      auto& decoded = decoded_images[index];
+      decoded.data = DecodeImage(*raw_datas[index], &decoded.width,
+                                 &decoded.height, &decoded.channel);
+    });
+
+    // The first image determines the dimension. The rest of images are
+    // expected to have the same dimension to it.
+    const DecodedImage& first_image = decoded_images[0];
+    ASSERT_NON_NULL(first_image.data, absl::StrFormat(
+        "Failed to read image from '%s'", paths[0]));
+    dimension_ = {first_image.width, first_image.height, first_image.channel,
+                  num_images};
+
+    // If the image has 3 channels, expand it so that it has 4 channels.
+    switch (channel()) {
+      case image::kBwImageChannel:
+      case image::kRgbaImageChannel:
+        break;
+
+      case image::kRgbImageChannel:
+        dimension_.channel = image::kRgbaImageChannel;
+        break;
+
+      default:
+        FATAL(absl::StrFormat("Unsupported number of channels: %d",
+                              dimension_.channel));
     }
 
-    default:
-      FATAL(absl::StrFormat("Unsupported number of channels: %d",
-                            dimension_.channel));
+    for (int index = 0; index < num_images; ++index) {
+      ConvertToDimension(dimension_, paths[index], *raw_datas[index],
+                         &decoded_images[index]);
+    }
+  } catch (...) {
+    for (const auto& decoded : decoded_images) {
+      stbi_image_free(decoded.data);
+    }
+    throw;
   }
 
-  // Load the rest of images.
-  data_ptrs_.reserve(paths.size());
-  data_ptrs_.push_back(data);
-  paths.remove_prefix(1);
-  for (const auto& path : paths) {
-    data_ptrs_.push_back(LoadImageFromFile(path));
+  data_ptrs_.reserve(num_images);
+  for (const auto& decoded : decoded_images) {
+    data_ptrs_.push_back(decoded.data);
   }
 }
 
@@ -85,27 +170,16 @@ Image::Image(std::string_view directory,
 
 Image::Image(int width, int height, int channel,
              absl::Span<const void* const> raw_data_ptrs, bool flip_y) {
-  ASSERT_TRUE(channel == image::kBwImageChannel
-                  || channel == image::kRgbaImageChannel,
-              absl::StrFormat("Unsupported number of channels: %d", channel));
-  ASSERT_TRUE(raw_data_ptrs.size() == image::kSingleImageLayer
-                  || raw_data_ptrs.size() == image::kCubemapImageLayer,
-              absl::StrFormat("Unsupported number of images: %d",
-                              raw_data_ptrs.size()));
+  ValidateDimension(channel, static_cast<int>(raw_data_ptrs.size()));
   dimension_ = {width, height, channel, static_cast<int>(raw_data_ptrs.size())};
   data_ptrs_.reserve(layer());
 
   const size_t data_size_per_layer = width * height * channel;
   for (const auto* raw_data : raw_data_ptrs) {
-    void* data = std::malloc(data_size_per_layer);
+    void* data = memory_pool::Allocate(data_size_per_layer);
     if (flip_y) {
-      const size_t stride = width * channel;
-      for (int row = 0; row < height; ++row) {
-        std::memcpy(
-            static_cast<char*>(data) + stride * row,
-            static_cast<const char*>(raw_data) + stride * (height - row - 1),
-            stride);
-      }
+      pixel_conversion::FlipVertically(raw_data, /*row_size=*/width * channel,
+                                       /*num_rows=*/height, data);
     } else {
       std::memcpy(data, raw_data, data_size_per_layer);
     }
@@ -113,31 +187,49 @@ Image::Image(int width, int height, int channel,
   }
 }
 
-Image::~Image() {
-  for (const auto* data : data_ptrs_) {
-    std::free(const_cast<void*>(data));
+Image::Image(int width, int height, int channel,
+             std::vector<memory_pool::Buffer>&& layer_datas) {
+  ValidateDimension(channel, static_cast<int>(layer_datas.size()));
+  dimension_ = {width, height, channel, static_cast<int>(layer_datas.size())};
+  data_ptrs_.reserve(layer());
+  for (auto& data : layer_datas) {
+    ASSERT_NON_NULL(data.get(), "Layer data is null");
+    data_ptrs_.push_back(data.release());
   }
 }
 
-const void* Image::LoadImageFromFile(std::string_view path) const {
-  const auto raw_data = std::make_unique<RawData>(path);
-  int width, height, channel;
-  stbi_uc* data = stbi_load_from_memory(
-      reinterpret_cast<const stbi_uc*>(raw_data->data),
-      static_cast<int>(raw_data->size),
-      &width, &height, &channel, /*desired_channels=*/this->channel());
+Image::Image(int width, int height, int channel, memory_pool::Buffer&& data)
+    : Image{width, height, channel, [&data] {
+              std::vector<memory_pool::Buffer> layer_datas;
+              layer_datas.push_back(std::move(data));
+              return layer_datas;
+            }()} {}
+
+Image::Image(Image&& rhs) noexcept
+    : dimension_{rhs.dimension_}, data_ptrs_{std::move(rhs.data_ptrs_)} {
+  rhs.dimension_ = {};
+  rhs.data_ptrs_.clear();
+}
 
-  ASSERT_NON_NULL(data, absl::StrFormat("Failed to read image from '%s'", path));
-  ASSERT_TRUE(width == this->width(),
-              absl::StrFormat("Image loaded from '%s' has different width (%d "
-                              "vs %d from first image)",
-                              path, width, this->width()));
-  ASSERT_TRUE(height == this->height(),
-              absl::StrFormat("Image loaded from '%s' has different height (%d "
-                              "vs %d from first image)",
-                              path, height, this->height()));
+Image& Image::operator=(Image&& rhs) noexcept {
+  std::swap(dimension_, rhs.dimension_);
+  std::swap(data_ptrs_, rhs.data_ptrs_);
+  return *this;
+}
 
-  return data;
+Image::~Image() {
+  for (const auto* data : data_ptrs_) {
+    memory_pool::Free(const_cast<void*>(data));
+  }
+}
+
+void Image::ValidateDimension(int channel, int layer) {
+  ASSERT_TRUE(channel == image::kBwImageChannel
+                  || channel == image::kRgbaImageChannel,
+              absl::StrFormat("Unsupported number of channels: %d", channel));
+  ASSERT_TRUE(layer == image::kSingleImageLayer
+                  || layer == image::kCubemapImageLayer,
+              absl::StrFormat("Unsupported number of images: %d", layer));
 }
 
 }  // namespace lighter::common
@@ -12,6 +12,7 @@
 #include <string_view>
 #include <vector>
 
+#include "lighter/common/memory_pool.h"
 #include "third_party/absl/types/span.h"
 
 namespace lighter::common {
@@ -27,7 +28,8 @@ constexpr int kRgbaImageChannel = 4;
 
 }  // namespace image
 
-// Loads image from file or memory.
+// Loads image from file or memory. Pixel data is allocated from memory_pool,
+// and each layer is aligned to memory_pool::kAlignment.
 class Image {
  public:
   // Dimension of image data.
@@ -42,6 +44,7 @@ class Image {
   // height and channel. The number of channels may be either 1, 3 or 4. If it
   // is 3, we will create the 4th channel internally.
   // The length of 'paths' and 'relative_paths' must be either 1 or 6 (cubemap).
+  // Images are decoded concurrently.
   explicit Image(absl::Span<const std::string> paths);
   explicit Image(const std::string& path) : Image{{&path, 1}} {}
   explicit Image(std::string_view path) : Image{std::string{path}} {}
@@ -49,7 +52,8 @@ class Image {
         absl::Span<const std::string> relative_paths);
 
   // Loads images from the memory. The data will be copied, hence the caller may
-  // free the original data once the constructor returns.
+  // free the original data once the constructor returns. If the data is already
+  // allocated from memory_pool, prefer the constructors below to avoid copying.
   // Images may have either 1 or 4 channels.
   // The length of 'raw_data_ptrs' must be either 1 or 6.
   Image(int width, int height, int channel,
@@ -57,9 +61,17 @@ class Image {
   Image(int width, int height, int channel, const void* raw_data, bool flip_y)
       : Image{width, height, channel, {&raw_data, 1}, flip_y} {}
 
-  // This class is neither copyable nor movable.
-  Image(const Image&) = delete;
-  Image& operator=(const Image&) = delete;
+  // Takes ownership of 'layer_datas' without copying. Each buffer must hold
+  // 'width' * 'height' * 'channel' bytes.
+  // Images may have either 1 or 4 channels.
+  // The length of 'layer_datas' must be either 1 or 6.
+  Image(int width, int height, int channel,
+        std::vector<memory_pool::Buffer>&& layer_datas);
+  Image(int width, int height, int channel, memory_pool::Buffer&& data);
+
+  // This class is only movable.
+  Image(Image&& rhs) noexcept;
+  Image& operator=(Image&& rhs) noexcept;
 
   ~Image();
 
@@ -72,9 +84,8 @@ class Image {
   const std::vector<const void*>& data_ptrs() const { return data_ptrs_; }
 
  private:
-  // Loads image from 'path' and returns the pointer to image data. It also
-  // checks that the dimension of image matches 'dimension_'.
-  const void* LoadImageFromFile(std::string_view path) const;
+  // Checks that the number of channels and layers are supported.
+  static void ValidateDimension(int channel, int layer);
 
   // Dimension of image data.
   Dimension dimension_{};
@@ -0,0 +1,168 @@
+//
+//  image_benchmark.cc
+//
+//  Created by Pujun Lun on 6/26/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "lighter/common/file.h"
+#include "lighter/common/image.h"
+#include "lighter/common/mip_chain.h"
+#include "lighter/common/util.h"
+#include "third_party/absl/flags/flag.h"
+#include "third_party/absl/flags/parse.h"
+#include "third_party/absl/strings/ascii.h"
+#include "third_party/absl/strings/str_format.h"
+#include "third_party/benchmark/benchmark.h"
+
+ABSL_FLAG(std::string, skybox_dir, "",
+          "Path to the directory of skybox faces. The tidepool skybox in the "
+          "resource folder will be used if not specified");
+ABSL_FLAG(std::string, texture_dir, "",
+          "Path to the directory of model textures. Textures of the nanosuit "
+          "model in the resource folder will be used if not specified");
+
+namespace lighter::common {
+namespace {
+
+namespace stdfs = std::filesystem;
+
+// Names of skybox faces in the order of PosX, NegX, PosY, NegY, PosZ, NegZ.
+const char* const kSkyboxFaces[]{
+    "right.tga", "left.tga", "top.tga", "bottom.tga", "back.tga", "front.tga",
+};
+
+// Returns paths to all images in 'directory'.
+std::vector<std::string> ListImages(const stdfs::path& directory) {
+  std::vector<std::string> paths;
+  for (const stdfs::directory_entry& entry :
+           stdfs::directory_iterator(directory)) {
+    const std::string extension =
+        absl::AsciiStrToLower(entry.path().extension().string());
+    if (entry.is_regular_file() &&
+        (extension == ".png" || extension == ".jpg" || extension == ".jpeg" ||
+         extension == ".tga")) {
+      paths.push_back(entry.path().string());
+    }
+  }
+  std::sort(paths.begin(), paths.end());
+  return paths;
+}
+
+// Loads the texture at 'path' on the host as SharedTexture does when the
+// texture is not cached, which decodes the image and generates the mip chain.
+void LoadTexture(const std::string& path) {
+  const Image image{path};
+  const auto mip_chain = MipChain::Generate(image, MipChain::Options{});
+  benchmark::DoNotOptimize(mip_chain->data_ptrs().data());
+}
+
+// Loads the skybox by decoding faces one after another.
+void BM_LoadSkybox_Sequential(benchmark::State& state,
+                              const std::vector<std::string>* paths) {
+  for (auto _ : state) {
+    for (const auto& path : *paths) {
+      const Image image{path};
+      benchmark::DoNotOptimize(image.data_ptrs().data());
+    }
+  }
+  state.SetItemsProcessed(
+      static_cast<int64_t>(state.iterations() * paths->size()));
+}
+
+// Loads the skybox with the constructor of Image, which decodes faces
+// concurrently.
+void BM_LoadSkybox_Parallel(benchmark::State& state,
+                            const std::vector<std::string>* paths) {
+  for (auto _ : state) {
+    const Image image{*paths};
+    benchmark::DoNotOptimize(image.data_ptrs().data());
+  }
+  state.SetItemsProcessed(
+      static_cast<int64_t>(state.iterations() * paths->size()));
+}
+
+// Loads textures one after another, as if constructing SharedTexture one by
+// one.
+void BM_LoadModelTextures_Sequential(benchmark::State& state,
+                                     const std::vector<std::string>* paths) {
+  for (auto _ : state) {
+    for (const auto& path : *paths) {
+      LoadTexture(path);
+    }
+  }
+  state.SetItemsProcessed(
+      static_cast<int64_t>(state.iterations() * paths->size()));
+}
+
+// Loads textures on a pool of worker threads, as SharedTexture::LoadTextures()
+// does.
+void BM_LoadModelTextures_Parallel(benchmark::State& state,
+                                   const std::vector<std::string>* paths) {
+  for (auto _ : state) {
+    util::ParallelForWithWorkers(
+        static_cast<int>(paths->size()), util::GetNumHardwareThreads(),
+        [paths](int index) { LoadTexture((*paths)[index]); });
+  }
+  state.SetItemsProcessed(
+      static_cast<int64_t>(state.iterations() * paths->size()));
+}
+
+}  // namespace
+}  // namespace lighter::common
+
+int main(int argc, char* argv[]) {
+  namespace stdfs = std::filesystem;
+  using namespace lighter::common;
+
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+
+  std::string skybox_dir = absl::GetFlag(FLAGS_skybox_dir);
+  std::string texture_dir = absl::GetFlag(FLAGS_texture_dir);
+  if (skybox_dir.empty() || texture_dir.empty()) {
+    file::EnableRunfileLookup(argv[0]);
+  }
+  if (skybox_dir.empty()) {
+    skybox_dir = file::GetResourcePath("texture/tidepool/right.tga",
+                                       /*want_directory_path=*/true);
+  }
+  if (texture_dir.empty()) {
+    texture_dir = file::GetResourcePath("model/nanosuit/nanosuit.obj",
+                                        /*want_directory_path=*/true);
+  }
+
+  std::vector<std::string> skybox_paths;
+  for (const char* face : kSkyboxFaces) {
+    skybox_paths.push_back((stdfs::path{skybox_dir} / face).string());
+  }
+  const std::vector<std::string> texture_paths = ListImages(texture_dir);
+  ASSERT_FALSE(texture_paths.empty(),
+               absl::StrFormat("No image found in '%s'", texture_dir));
+  LOG_INFO << absl::StreamFormat("Found %d textures in '%s'",
+                                 texture_paths.size(), texture_dir);
+
+  benchmark::RegisterBenchmark("BM_LoadSkybox/Sequential",
+                               BM_LoadSkybox_Sequential, &skybox_paths)
+      ->Unit(benchmark::kMillisecond)
+      ->UseRealTime();
+  benchmark::RegisterBenchmark("BM_LoadSkybox/Parallel",
+                               BM_LoadSkybox_Parallel, &skybox_paths)
+      ->Unit(benchmark::kMillisecond)
+      ->UseRealTime();
+  benchmark::RegisterBenchmark("BM_LoadModelTextures/Sequential",
+                               BM_LoadModelTextures_Sequential, &texture_paths)
+      ->Unit(benchmark::kMillisecond)
+      ->UseRealTime();
+  benchmark::RegisterBenchmark("BM_LoadModelTextures/Parallel",
+                               BM_LoadModelTextures_Parallel, &texture_paths)
+      ->Unit(benchmark::kMillisecond)
+      ->UseRealTime();
+  benchmark::RunSpecifiedBenchmarks();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,263 @@
+//
+//  memory_pool.cc
+//
+//  Created by Pujun Lun on 6/27/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/memory_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace lighter::common::memory_pool {
+namespace {
+
+// Size of the smallest size class.
+constexpr size_t kMinPooledSize = kAlignment;
+
+// Number of size classes, from kMinPooledSize to kMaxPooledSize.
+constexpr int kNumSizeClasses = 11;
+
+static_assert(kMinPooledSize << (kNumSizeClasses - 1) == kMaxPooledSize,
+              "Size classes don't cover kMaxPooledSize");
+
+// Size class of allocations that are not pooled.
+constexpr int kUnpooledSizeClass = -1;
+
+// Each slab holds at least this number of blocks, and takes at least
+// kMinSlabSize bytes.
+constexpr int kMinBlocksPerSlab = 4;
+constexpr size_t kMinSlabSize = 64 * 1024;
+
+// Precedes each allocation, so that Free() and Reallocate() know where the
+// allocation comes from without requiring the size. Its size is kAlignment,
+// which keeps allocations aligned.
+struct alignas(kAlignment) BlockHeader {
+  // Index of the size class, or kUnpooledSizeClass.
+  int size_class;
+
+  // Number of usable bytes after the header.
+  size_t capacity;
+
+  // Only used by unpooled blocks. Distance in bytes from the start of the
+  // memory returned by the system to the header, which is padded to keep the
+  // header aligned.
+  size_t offset;
+};
+
+static_assert(sizeof(BlockHeader) == kAlignment,
+              "Unexpected size of BlockHeader");
+
+// Allocates 'size' bytes aligned to kAlignment from the system.
+void* AllocateFromSystem(size_t size) {
+  return ::operator new(size, std::align_val_t{kAlignment});
+}
+
+// Releases memory allocated by AllocateFromSystem().
+void FreeToSystem(void* data) {
+  ::operator delete(data, std::align_val_t{kAlignment});
+}
+
+// Unpooled blocks are allocated with std::malloc() rather than aligned operator
+// new, so that they can be grown with std::realloc(), which extends large
+// blocks in place or remaps their pages without copying when possible. Since
+// std::malloc() only guarantees fundamental alignment, this many extra bytes
+// are requested for aligning the header.
+constexpr size_t kUnpooledPadding = kAlignment;
+
+// Returns the number of bytes to request from the system for an unpooled block
+// that can hold 'size' bytes.
+size_t GetUnpooledAllocationSize(size_t size) {
+  return kUnpooledPadding + sizeof(BlockHeader) + size;
+}
+
+// Returns the distance in bytes from 'base' to the next address aligned to
+// kAlignment.
+size_t GetAlignmentOffset(const void* base) {
+  const auto address = reinterpret_cast<uintptr_t>(base);
+  return (kAlignment - address % kAlignment) % kAlignment;
+}
+
+// Allocates an unpooled block that can hold 'size' bytes.
+BlockHeader* AllocateUnpooled(size_t size) {
+  auto* base = static_cast<char*>(
+      std::malloc(GetUnpooledAllocationSize(size)));
+  if (base == nullptr) {
+    throw std::bad_alloc{};
+  }
+  const size_t offset = GetAlignmentOffset(base);
+  auto* header = reinterpret_cast<BlockHeader*>(base + offset);
+  header->size_class = kUnpooledSizeClass;
+  header->capacity = size;
+  header->offset = offset;
+  return header;
+}
+
+// Grows the unpooled block 'header' to hold 'size' bytes, and returns the new
+// header. Contents are moved only if the system relocates the block to an
+// address with a different alignment.
+BlockHeader* ReallocateUnpooled(BlockHeader* header, size_t size) {
+  const size_t old_offset = header->offset;
+  const size_t old_capacity = header->capacity;
+  char* old_base = reinterpret_cast<char*>(header) - old_offset;
+  auto* base = static_cast<char*>(
+      std::realloc(old_base, GetUnpooledAllocationSize(size)));
+  if (base == nullptr) {
+    throw std::bad_alloc{};
+  }
+  const size_t offset = GetAlignmentOffset(base);
+  if (offset != old_offset) {
+    std::memmove(base + offset, base + old_offset,
+                 sizeof(BlockHeader) + old_capacity);
+  }
+  header = reinterpret_cast<BlockHeader*>(base + offset);
+  header->capacity = size;
+  header->offset = offset;
+  return header;
+}
+
+// Releases the unpooled block 'header'.
+void FreeUnpooled(BlockHeader* header) {
+  std::free(reinterpret_cast<char*>(header) - header->offset);
+}
+
+// Returns the index of the smallest size class that can hold 'size' bytes.
+int GetSizeClass(size_t size) {
+  int size_class = 0;
+  while ((kMinPooledSize << size_class) < size) {
+    ++size_class;
+  }
+  return size_class;
+}
+
+// Returns the number of usable bytes of blocks in 'size_class'.
+size_t GetCapacity(int size_class) {
+  return kMinPooledSize << size_class;
+}
+
+// Returns the pointer to usable memory of 'header'.
+void* GetData(BlockHeader* header) {
+  return header + 1;
+}
+
+// Returns the header of usable memory 'data'.
+BlockHeader* GetHeader(void* data) {
+  return static_cast<BlockHeader*>(data) - 1;
+}
+
+// Free lists of all size classes. Each size class is guarded by its own mutex,
+// so that threads allocating different sizes don't contend.
+class Pool {
+ public:
+  // Returns the pool shared by the whole program. It is never destroyed, so
+  // that memory can still be released during static destruction.
+  static Pool& Get() {
+    static Pool* pool = new Pool;
+    return *pool;
+  }
+
+  // This class is neither copyable nor movable.
+  Pool(const Pool&) = delete;
+  Pool& operator=(const Pool&) = delete;
+
+  // Returns a free block of 'size_class'. If there is none, a new slab will be
+  // allocated.
+  BlockHeader* Allocate(int size_class) {
+    SizeClass& target = size_classes_[size_class];
+    const std::lock_guard<std::mutex> lock{target.mutex};
+    if (target.free_blocks.empty()) {
+      AllocateSlab(size_class, &target);
+    }
+    BlockHeader* header = target.free_blocks.back();
+    target.free_blocks.pop_back();
+    return header;
+  }
+
+  // Puts 'header' back to the free list of its size class.
+  void Free(BlockHeader* header) {
+    SizeClass& target = size_classes_[header->size_class];
+    const std::lock_guard<std::mutex> lock{target.mutex};
+    target.free_blocks.push_back(header);
+  }
+
+ private:
+  struct SizeClass {
+    std::mutex mutex;
+    std::vector<BlockHeader*> free_blocks;
+    // Slabs are kept until the program exits.
+    std::vector<void*> slabs;
+  };
+
+  Pool() = default;
+
+  // Allocates a slab and splits it into free blocks of 'size_class'.
+  static void AllocateSlab(int size_class, SizeClass* target) {
+    const size_t block_size = sizeof(BlockHeader) + GetCapacity(size_class);
+    const auto num_blocks = static_cast<int>(
+        std::max(kMinSlabSize / block_size,
+                 static_cast<size_t>(kMinBlocksPerSlab)));
+    auto* slab = static_cast<char*>(AllocateFromSystem(block_size *
+                                                       num_blocks));
+    target->slabs.push_back(slab);
+    target->free_blocks.reserve(target->free_blocks.size() + num_blocks);
+    // Push in reverse order, so that blocks are handed out in address order.
+    for (int i = num_blocks - 1; i >= 0; --i) {
+      auto* header = reinterpret_cast<BlockHeader*>(slab + block_size * i);
+      header->size_class = size_class;
+      header->capacity = GetCapacity(size_class);
+      target->free_blocks.push_back(header);
+    }
+  }
+
+  std::array<SizeClass, kNumSizeClasses> size_classes_;
+};
+
+}  // namespace
+
+void* Allocate(size_t size) {
+  if (size > kMaxPooledSize) {
+    return GetData(AllocateUnpooled(size));
+  }
+  return GetData(Pool::Get().Allocate(GetSizeClass(size)));
+}
+
+void* Reallocate(void* data, size_t size) {
+  if (data == nullptr) {
+    return Allocate(size);
+  }
+  BlockHeader* header = GetHeader(data);
+  if (size <= header->capacity) {
+    return data;
+  }
+  if (header->size_class == kUnpooledSizeClass) {
+    return GetData(ReallocateUnpooled(header, size));
+  }
+
+  // Pooled blocks can't grow beyond their size class, hence contents are copied
+  // to a larger block.
+  void* new_data = Allocate(size);
+  std::memcpy(new_data, data, header->capacity);
+  Free(data);
+  return new_data;
+}
+
+void Free(void* data) {
+  if (data == nullptr) {
+    return;
+  }
+  BlockHeader* header = GetHeader(data);
+  if (header->size_class == kUnpooledSizeClass) {
+    FreeUnpooled(header);
+  } else {
+    Pool::Get().Free(header);
+  }
+}
+
+}  // namespace lighter::common::memory_pool
@@ -0,0 +1,57 @@
+//
+//  memory_pool.h
+//
+//  Created by Pujun Lun on 6/27/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#ifndef LIGHTER_COMMON_MEMORY_POOL_H
+#define LIGHTER_COMMON_MEMORY_POOL_H
+
+#include <cstddef>
+#include <memory>
+
+namespace lighter::common::memory_pool {
+
+// Alignment of all allocations. This is the size of cache lines on most
+// platforms, and satisfies the alignment required by SIMD instructions.
+constexpr size_t kAlignment = 64;
+
+// Allocations of at most this size are served from free lists of power-of-two
+// size classes, which are refilled with large slabs. Larger ones are allocated
+// from the system directly, and can be grown without copying when the system
+// is able to extend them in place.
+constexpr size_t kMaxPooledSize = 64 * 1024;
+
+// Allocates at least 'size' bytes aligned to kAlignment. The returned pointer
+// must be released with Free(). This is thread-safe.
+void* Allocate(size_t size);
+
+// Resizes the allocation 'data' to 'size' bytes, and returns the pointer to the
+// resized allocation, which may be different from 'data'. Contents are
+// preserved up to the smaller of the old and new sizes. 'data' may be nullptr,
+// in which case this is equivalent to Allocate(). Growing an allocation larger
+// than kMaxPooledSize is backed by std::realloc(), hence contents are usually
+// not copied. This is thread-safe.
+void* Reallocate(void* data, size_t size);
+
+// Releases 'data' allocated by Allocate() or Reallocate(). Pooled blocks are
+// put back to free lists for reuse. 'data' may be nullptr. This is thread-safe.
+void Free(void* data);
+
+// Releases memory with Free().
+struct Deleter {
+  void operator()(void* data) const { Free(data); }
+};
+
+// Buffer allocated from the pool with unique ownership.
+using Buffer = std::unique_ptr<unsigned char[], Deleter>;
+
+// Returns a buffer of at least 'size' bytes.
+inline Buffer AllocateBuffer(size_t size) {
+  return Buffer{static_cast<unsigned char*>(Allocate(size))};
+}
+
+}  // namespace lighter::common::memory_pool
+
+#endif  // LIGHTER_COMMON_MEMORY_POOL_H
@@ -0,0 +1,109 @@
+//
+//  memory_pool_test.cc
+//
+//  Created by Pujun Lun on 6/27/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/memory_pool.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "third_party/gtest/gtest.h"
+
+namespace lighter::common::memory_pool {
+namespace {
+
+bool IsAligned(const void* data) {
+  return reinterpret_cast<uintptr_t>(data) % kAlignment == 0;
+}
+
+TEST(MemoryPoolTest, Alignment) {
+  for (const size_t size : {size_t{1}, size_t{63}, size_t{64}, size_t{100},
+                            size_t{4096}, kMaxPooledSize,
+                            kMaxPooledSize + 1}) {
+    void* data = Allocate(size);
+    EXPECT_TRUE(IsAligned(data));
+    // Must be writable up to 'size'.
+    std::memset(data, 0xFF, size);
+    Free(data);
+  }
+}
+
+TEST(MemoryPoolTest, ReuseFreedBlocks) {
+  void* data = Allocate(/*size=*/200);
+  Free(data);
+  // The most recently freed block of the same size class is handed out first.
+  void* reused = Allocate(/*size=*/256);
+  EXPECT_EQ(reused, data);
+  Free(reused);
+}
+
+TEST(MemoryPoolTest, DistinctBlocks) {
+  std::vector<void*> datas;
+  for (int i = 0; i < 100; ++i) {
+    datas.push_back(Allocate(/*size=*/100));
+    std::memset(datas.back(), i, 100);
+  }
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(static_cast<const unsigned char*>(datas[i])[99], i);
+    Free(datas[i]);
+  }
+}
+
+TEST(MemoryPoolTest, ReallocatePreservesData) {
+  auto* data = static_cast<unsigned char*>(Allocate(/*size=*/16));
+  for (int i = 0; i < 16; ++i) {
+    data[i] = static_cast<unsigned char>(i);
+  }
+  // Grow within the pool and then beyond it.
+  for (const size_t size : {size_t{32}, size_t{1000}, kMaxPooledSize * 2}) {
+    data = static_cast<unsigned char*>(Reallocate(data, size));
+    EXPECT_TRUE(IsAligned(data));
+    for (int i = 0; i < 16; ++i) {
+      EXPECT_EQ(data[i], i);
+    }
+  }
+  Free(data);
+}
+
+TEST(MemoryPoolTest, ReallocateUnpooledPreservesData) {
+  size_t size = kMaxPooledSize + 1;
+  auto* data = static_cast<unsigned char*>(Allocate(size));
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = static_cast<unsigned char>(i % 251);
+  }
+  // Unpooled blocks are grown by the system, which may move them to addresses
+  // with different alignment.
+  for (const size_t new_size : {kMaxPooledSize * 2, kMaxPooledSize * 16,
+                                kMaxPooledSize * 100}) {
+    data = static_cast<unsigned char*>(Reallocate(data, new_size));
+    EXPECT_TRUE(IsAligned(data));
+    for (size_t i = 0; i < size; ++i) {
+      ASSERT_EQ(data[i], i % 251);
+    }
+    for (size_t i = size; i < new_size; ++i) {
+      data[i] = static_cast<unsigned char>(i % 251);
+    }
+    size = new_size;
+  }
+  Free(data);
+}
+
+TEST(MemoryPoolTest, ReallocateNull) {
+  void* data = Reallocate(nullptr, /*size=*/10);
+  EXPECT_NE(data, nullptr);
+  Free(data);
+  Free(nullptr);
+}
+
+TEST(MemoryPoolTest, Buffer) {
+  Buffer buffer = AllocateBuffer(/*size=*/128);
+  EXPECT_TRUE(IsAligned(buffer.get()));
+  buffer[127] = 1;
+}
+
+}  // namespace
+}  // namespace lighter::common::memory_pool
@@ -0,0 +1,543 @@
+//
+//  mesh_cache.cc
+//
+//  Created by Pujun Lun on 6/14/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/mesh_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <type_traits>
+#include <variant>
+
+#include "lighter/common/mesh_optimizer.h"
+#include "lighter/common/mesh_simplifier.h"
+#include "lighter/common/util.h"
+#include "third_party/absl/strings/match.h"
+#include "third_party/absl/strings/str_format.h"
+#include "third_party/absl/strings/str_join.h"
+#include "third_party/picosha2/picosha2.h"
+
+namespace lighter::common {
+namespace {
+
+namespace stdfs = std::filesystem;
+
+// "MESH" in little endian. This also helps detect caches written on platforms
+// of different endianness.
+constexpr uint32_t kMagic = 0x4853454D;
+
+// Must be bumped whenever the layout of cache files changes.
+constexpr uint32_t kVersion = 3;
+
+// Offset of each section is aligned to this, so that data can be used in place.
+constexpr size_t kSectionAlignment = 16;
+
+static_assert(std::tuple_size_v<MeshCache::SourceHash> ==
+                  picosha2::k_digest_size,
+              "Unexpected size of SHA256 digest");
+
+// Header of cache files. Offsets are relative to the beginning of the file.
+struct Header {
+  uint32_t magic;
+  uint32_t version;
+  // Cache files become stale if the layout of vertices changes.
+  uint32_t vertex_size;
+  uint32_t num_meshes;
+  MeshCache::SourceHash source_hash;
+  uint64_t meshes_offset;
+  uint64_t vertices_offset;
+  uint64_t indices16_offset;
+  uint64_t indices32_offset;
+  uint64_t lods_offset;
+  uint64_t textures_offset;
+  uint64_t strings_offset;
+  uint64_t file_size;
+};
+
+// Ranges of data used by one mesh, which are indices into the vertex, index,
+// level of detail and texture sections respectively. Indices are stored in the
+// 16-bit index section if 'index_size' is 2, or the 32-bit index section if it
+// is 4.
+struct MeshRange {
+  uint32_t first_vertex;
+  uint32_t num_vertices;
+  uint32_t index_size;
+  uint32_t first_index;
+  uint32_t num_indices;
+  uint32_t first_lod;
+  uint32_t num_lods;
+  uint32_t first_texture;
+  uint32_t num_textures;
+};
+
+// Describes one level of detail. Indices are stored in the same index section
+// as the mesh that it belongs to.
+struct LodRecord {
+  uint32_t first_index;
+  uint32_t num_indices;
+  float error;
+};
+
+// Describes one texture reference. 'path_offset' is relative to the beginning
+// of the string section.
+struct TextureRecord {
+  uint32_t type;
+  uint32_t path_offset;
+  uint32_t path_length;
+};
+
+static_assert(std::is_trivially_copyable_v<Vertex3DWithTex>,
+              "Vertices must be trivially copyable to be cached");
+
+// Returns 'offset' rounded up to the next multiple of kSectionAlignment.
+size_t AlignOffset(size_t offset) {
+  return (offset + kSectionAlignment - 1) / kSectionAlignment *
+         kSectionAlignment;
+}
+
+// Returns a span of 'count' elements of DataType starting at 'offset' within
+// 'data'. Returns std::nullopt if out of range.
+template <typename DataType>
+std::optional<absl::Span<const DataType>> GetSection(
+    absl::Span<const char> data, uint64_t offset, uint64_t count) {
+  if (offset % alignof(DataType) != 0 || offset > data.size() ||
+      count > (data.size() - offset) / sizeof(DataType)) {
+    return std::nullopt;
+  }
+  return absl::MakeConstSpan(
+      reinterpret_cast<const DataType*>(data.data() + offset), count);
+}
+
+// Returns a string that describes 'lod_ratios', which is used for computing
+// the source hash.
+std::string GetLodOptions(absl::Span<const float> lod_ratios) {
+  return absl::StrFormat("lods=%s", absl::StrJoin(lod_ratios, ","));
+}
+
+// Generates levels of detail for the mesh with 'indices' and 'vertices'. If
+// 'optimize' is true, triangles of each level will be reordered for the vertex
+// cache. Vertices are shared by all levels, hence they are not reordered.
+std::vector<mesh_simplifier::LevelOfDetail> GenerateLods(
+    absl::Span<const uint32_t> indices,
+    absl::Span<const Vertex3DWithTex> vertices,
+    absl::Span<const float> lod_ratios, bool optimize) {
+  if (lod_ratios.empty()) {
+    return {};
+  }
+  auto lods = mesh_simplifier::GenerateLodChain(indices, vertices, lod_ratios);
+  if (optimize) {
+    for (auto& lod : lods) {
+      mesh_optimizer::OptimizeVertexCache(absl::MakeSpan(lod.indices),
+                                          vertices.size());
+    }
+  }
+  return lods;
+}
+
+// Returns views into 'lods'.
+std::vector<MeshCache::LevelOfDetail> GetLodViews(
+    absl::Span<const mesh_simplifier::LevelOfDetail> lods) {
+  std::vector<MeshCache::LevelOfDetail> views;
+  views.reserve(lods.size());
+  for (const auto& lod : lods) {
+    views.push_back({absl::MakeConstSpan(lod.indices), lod.error});
+  }
+  return views;
+}
+
+// Returns the number of indices in 'indices'.
+uint32_t GetNumIndices(const IndicesView& indices) {
+  return static_cast<uint32_t>(std::visit(
+      [](const auto& indices) { return indices.size(); }, indices));
+}
+
+}  // namespace
+
+std::unique_ptr<MeshCache> MeshCache::LoadModel(
+    const std::string& model_path, const std::string& texture_dir,
+    bool optimize_meshes, absl::Span<const float> lod_ratios) {
+  const std::string loader_options = absl::StrFormat(
+      "ModelLoader optimize=%d %s", optimize_meshes, GetLodOptions(lod_ratios));
+  const SourceHash source_hash = ComputeSourceHash(model_path, loader_options);
+  const std::string cache_path =
+      GetDefaultCachePath(model_path, loader_options);
+  if (auto cache = LoadFromFile(cache_path, source_hash)) {
+    return cache;
+  }
+
+  LOG_INFO << absl::StreamFormat("Building mesh cache for '%s'", model_path);
+  const ModelLoader loader{model_path, texture_dir, optimize_meshes};
+  const std::string texture_prefix = absl::StrFormat("%s/", texture_dir);
+  std::vector<Mesh> meshes;
+  meshes.reserve(loader.mesh_datas().size());
+  // Holds indices of levels of detail until they are copied into the cache.
+  std::vector<std::vector<mesh_simplifier::LevelOfDetail>> lods;
+  lods.reserve(loader.mesh_datas().size());
+  for (const auto& mesh_data : loader.mesh_datas()) {
+    Mesh& mesh = meshes.emplace_back();
+    mesh.vertices = mesh_data.vertices;
+    mesh.indices = absl::MakeConstSpan(mesh_data.indices);
+    lods.push_back(GenerateLods(mesh_data.indices, mesh.vertices, lod_ratios,
+                                optimize_meshes));
+    mesh.lods = GetLodViews(lods.back());
+    mesh.textures.reserve(mesh_data.textures.size());
+    for (const auto& texture : mesh_data.textures) {
+      std::string_view path = texture.path;
+      if (absl::StartsWith(path, texture_prefix)) {
+        path.remove_prefix(texture_prefix.size());
+      }
+      mesh.textures.push_back({texture.texture_type, path});
+    }
+  }
+
+  auto cache = Create(meshes, source_hash);
+  cache->WriteToFile(cache_path);
+  return cache;
+}
+
+std::unique_ptr<MeshCache> MeshCache::LoadObjFile(
+    const std::string& obj_path, int index_base, bool optimize_mesh,
+    absl::Span<const float> lod_ratios) {
+  const std::string loader_options = absl::StrFormat(
+      "ObjFile index_base=%d optimize=%d %s", index_base, optimize_mesh,
+      GetLodOptions(lod_ratios));
+  const SourceHash source_hash = ComputeSourceHash(obj_path, loader_options);
+  const std::string cache_path = GetDefaultCachePath(obj_path, loader_options);
+  if (auto cache = LoadFromFile(cache_path, source_hash)) {
+    return cache;
+  }
+
+  LOG_INFO << absl::StreamFormat("Building mesh cache for '%s'", obj_path);
+  ObjFile file{obj_path, index_base};
+  if (optimize_mesh) {
+    mesh_optimizer::OptimizeMesh(
+        mesh_optimizer::Options{.optimize_overdraw = true},
+        file.indices, file.vertices);
+  }
+  const auto lods = GenerateLods(file.indices, file.vertices, lod_ratios,
+                                optimize_mesh);
+  const Mesh mesh{file.vertices, absl::MakeConstSpan(file.indices),
+                  /*textures=*/{}, GetLodViews(lods)};
+  auto cache = Create({&mesh, 1}, source_hash);
+  cache->WriteToFile(cache_path);
+  return cache;
+}
+
+MeshCache::SourceHash MeshCache::ComputeSourceHash(
+    std::string_view source_path, std::string_view loader_options) {
+  const RawData source_data{source_path, RawData::Mode::kMemoryMapped};
+  picosha2::hash256_one_by_one hasher;
+  hasher.process(source_data.data, source_data.data + source_data.size);
+  hasher.process(loader_options.begin(), loader_options.end());
+  hasher.finish();
+
+  SourceHash hash;
+  hasher.get_hash_bytes(hash.begin(), hash.end());
+  return hash;
+}
+
+std::string MeshCache::GetDefaultCachePath(std::string_view source_path,
+                                           std::string_view loader_options) {
+  // Different source files may have the same name, hence we also append the
+  // hash of the absolute path and loader options.
+  const stdfs::path path = stdfs::absolute(source_path);
+  const std::string path_hash = picosha2::hash256_hex_string(
+      absl::StrFormat("%s\n%s", path.string(), loader_options));
+  const stdfs::path cache_path =
+      stdfs::temp_directory_path() / "lighter" / "mesh_cache" /
+      absl::StrFormat("%s.%s.mesh", path.filename().string(),
+                      path_hash.substr(/*pos=*/0, /*n=*/16));
+  return cache_path.string();
+}
+
+std::unique_ptr<MeshCache> MeshCache::LoadFromFile(
+    std::string_view cache_path, const SourceHash& source_hash) {
+  std::error_code error_code;
+  if (!stdfs::is_regular_file(cache_path, error_code)) {
+    return nullptr;
+  }
+
+  std::unique_ptr<MeshCache> cache{new MeshCache};
+  cache->file_data_ =
+      std::make_unique<RawData>(cache_path, RawData::Mode::kMemoryMapped);
+  if (!cache->Parse(cache->file_data_->GetSpan(), source_hash)) {
+    LOG_INFO << absl::StreamFormat("Mesh cache '%s' is stale", cache_path);
+    return nullptr;
+  }
+  return cache;
+}
+
+std::unique_ptr<MeshCache> MeshCache::Create(absl::Span<const Mesh> meshes,
+                                             const SourceHash& source_hash) {
+  Header header{};
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.vertex_size = sizeof(Vertex3DWithTex);
+  header.num_meshes = meshes.size();
+  header.source_hash = source_hash;
+
+  // Compute ranges of each mesh and the layout of the file.
+  std::vector<MeshRange> ranges;
+  ranges.reserve(meshes.size());
+  std::vector<LodRecord> lod_records;
+  MeshRange total{};
+  uint32_t total_num_indices16 = 0, total_num_indices32 = 0;
+  size_t strings_size = 0;
+  for (const Mesh& mesh : meshes) {
+    const bool use_16_bit_indices =
+        std::holds_alternative<absl::Span<const uint16_t>>(mesh.indices) ||
+        CanUse16BitIndices(mesh.vertices.size());
+    uint32_t& total_num_indices =
+        use_16_bit_indices ? total_num_indices16 : total_num_indices32;
+    const uint32_t num_indices = GetNumIndices(mesh.indices);
+    ranges.push_back({
+        total.num_vertices, static_cast<uint32_t>(mesh.vertices.size()),
+        use_16_bit_indices ? uint32_t{sizeof(uint16_t)}
+                           : uint32_t{sizeof(uint32_t)},
+        total_num_indices, num_indices,
+        static_cast<uint32_t>(lod_records.size()),
+        static_cast<uint32_t>(mesh.lods.size()),
+        total.num_textures, static_cast<uint32_t>(mesh.textures.size()),
+    });
+    total.num_vertices += mesh.vertices.size();
+    total_num_indices += num_indices;
+    for (const auto& lod : mesh.lods) {
+      const uint32_t num_lod_indices = GetNumIndices(lod.indices);
+      lod_records.push_back({total_num_indices, num_lod_indices, lod.error});
+      total_num_indices += num_lod_indices;
+    }
+    total.num_textures += mesh.textures.size();
+    for (const auto& texture : mesh.textures) {
+      strings_size += texture.path.size();
+    }
+  }
+  header.meshes_offset = AlignOffset(sizeof(Header));
+  header.vertices_offset =
+      AlignOffset(header.meshes_offset + sizeof(MeshRange) * ranges.size());
+  header.indices16_offset = AlignOffset(
+      header.vertices_offset + sizeof(Vertex3DWithTex) * total.num_vertices);
+  header.indices32_offset = AlignOffset(
+      header.indices16_offset + sizeof(uint16_t) * total_num_indices16);
+  header.lods_offset = AlignOffset(
+      header.indices32_offset + sizeof(uint32_t) * total_num_indices32);
+  header.textures_offset = AlignOffset(
+      header.lods_offset + sizeof(LodRecord) * lod_records.size());
+  header.strings_offset = AlignOffset(
+      header.textures_offset + sizeof(TextureRecord) * total.num_textures);
+  header.file_size = header.strings_offset + strings_size;
+
+  // Copy data into the buffer. Paddings between sections are zero.
+  std::unique_ptr<MeshCache> cache{new MeshCache};
+  std::vector<char>& buffer = cache->buffer_;
+  buffer.resize(header.file_size);
+  const auto copy_to = [&buffer](uint64_t offset, const void* data,
+                                 size_t size) {
+    if (size > 0) {
+      std::memcpy(buffer.data() + offset, data, size);
+    }
+  };
+  // Indices are converted to the type determined by 'index_size'.
+  const auto copy_indices = [&buffer, &header](const IndicesView& indices,
+                                               uint32_t index_size,
+                                               uint32_t first_index) {
+    std::visit([&](const auto& source) {
+      if (index_size == sizeof(uint16_t)) {
+        auto* target = reinterpret_cast<uint16_t*>(
+            buffer.data() + header.indices16_offset) + first_index;
+        std::transform(source.begin(), source.end(), target,
+                       [](uint32_t index) {
+                         return static_cast<uint16_t>(index);
+                       });
+      } else {
+        auto* target = reinterpret_cast<uint32_t*>(
+            buffer.data() + header.indices32_offset) + first_index;
+        std::copy(source.begin(), source.end(), target);
+      }
+    }, indices);
+  };
+  copy_to(/*offset=*/0, &header, sizeof(header));
+  copy_to(header.meshes_offset, ranges.data(),
+          sizeof(MeshRange) * ranges.size());
+  copy_to(header.lods_offset, lod_records.data(),
+          sizeof(LodRecord) * lod_records.size());
+
+  uint32_t texture_index = 0;
+  uint32_t string_offset = 0;
+  for (int i = 0; i < meshes.size(); ++i) {
+    const Mesh& mesh = meshes[i];
+    const MeshRange& range = ranges[i];
+    copy_to(header.vertices_offset +
+                sizeof(Vertex3DWithTex) * range.first_vertex,
+            mesh.vertices.data(), sizeof(Vertex3DWithTex) * range.num_vertices);
+    copy_indices(mesh.indices, range.index_size, range.first_index);
+    for (int lod = 0; lod < mesh.lods.size(); ++lod) {
+      copy_indices(mesh.lods[lod].indices, range.index_size,
+                   lod_records[range.first_lod + lod].first_index);
+    }
+    for (const auto& texture : mesh.textures) {
+      const TextureRecord record{
+          static_cast<uint32_t>(texture.type), string_offset,
+          static_cast<uint32_t>(texture.path.size()),
+      };
+      copy_to(header.textures_offset + sizeof(TextureRecord) * texture_index++,
+              &record, sizeof(record));
+      copy_to(header.strings_offset + string_offset,
+              texture.path.data(), texture.path.size());
+      string_offset += texture.path.size();
+    }
+  }
+
+  ASSERT_TRUE(cache->Parse(buffer, source_hash),
+              "Failed to parse the mesh cache just created");
+  return cache;
+}
+
+bool MeshCache::WriteToFile(std::string_view cache_path) const {
+  // Caching is only an optimization, hence we don't throw exceptions here.
+  const stdfs::path path{cache_path};
+  const stdfs::path temp_path = path.string() + ".tmp";
+  std::error_code error_code;
+  stdfs::create_directories(path.parent_path(), error_code);
+  {
+    std::ofstream file{temp_path,
+                       std::ios::out | std::ios::binary | std::ios::trunc};
+    if (file) {
+      file.write(data_.data(), data_.size());
+    }
+    if (!file) {
+      LOG_ERROR << absl::StreamFormat("Failed to write mesh cache '%s'",
+                                      temp_path.string());
+      return false;
+    }
+  }
+  stdfs::rename(temp_path, path, error_code);
+  if (error_code) {
+    LOG_ERROR << absl::StreamFormat("Failed to rename '%s' to '%s': %s",
+                                    temp_path.string(), path.string(),
+                                    error_code.message());
+    stdfs::remove(temp_path, error_code);
+    return false;
+  }
+  return true;
+}
+
+bool MeshCache::Parse(absl::Span<const char> data,
+                      const SourceHash& source_hash) {
+  if (data.size() < sizeof(Header)) {
+    return false;
+  }
+  Header header;
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != kMagic || header.version != kVersion ||
+      header.vertex_size != sizeof(Vertex3DWithTex) ||
+      header.source_hash != source_hash || header.file_size != data.size()) {
+    return false;
+  }
+
+  const auto ranges = GetSection<MeshRange>(data, header.meshes_offset,
+                                            header.num_meshes);
+  if (!ranges.has_value()) {
+    return false;
+  }
+  // Use 64-bit integers to avoid overflow if the file is corrupted.
+  uint64_t num_vertices = 0, num_lods = 0, num_textures = 0;
+  uint64_t num_indices16 = 0, num_indices32 = 0;
+  for (const MeshRange& range : *ranges) {
+    uint64_t* num_indices;
+    switch (range.index_size) {
+      case sizeof(uint16_t):
+        num_indices = &num_indices16;
+        break;
+      case sizeof(uint32_t):
+        num_indices = &num_indices32;
+        break;
+      default:
+        return false;
+    }
+    num_vertices = std::max(
+        num_vertices, uint64_t{range.first_vertex} + range.num_vertices);
+    *num_indices = std::max(
+        *num_indices, uint64_t{range.first_index} + range.num_indices);
+    num_lods = std::max(num_lods, uint64_t{range.first_lod} + range.num_lods);
+    num_textures = std::max(
+        num_textures, uint64_t{range.first_texture} + range.num_textures);
+  }
+  const auto lods = GetSection<LodRecord>(data, header.lods_offset, num_lods);
+  if (!lods.has_value()) {
+    return false;
+  }
+  // Indices of levels of detail follow indices of the mesh in the same index
+  // section, hence they also determine the size of that section.
+  for (const MeshRange& range : *ranges) {
+    uint64_t& num_indices = range.index_size == sizeof(uint16_t)
+                                ? num_indices16 : num_indices32;
+    for (const LodRecord& record :
+             lods->subspan(range.first_lod, range.num_lods)) {
+      num_indices = std::max(
+          num_indices, uint64_t{record.first_index} + record.num_indices);
+    }
+  }
+  const auto vertices = GetSection<Vertex3DWithTex>(
+      data, header.vertices_offset, num_vertices);
+  const auto indices16 = GetSection<uint16_t>(
+      data, header.indices16_offset, num_indices16);
+  const auto indices32 = GetSection<uint32_t>(
+      data, header.indices32_offset, num_indices32);
+  const auto textures = GetSection<TextureRecord>(
+      data, header.textures_offset, num_textures);
+  if (!vertices.has_value() || !indices16.has_value() ||
+      !indices32.has_value() || !textures.has_value() ||
+      header.strings_offset > data.size()) {
+    return false;
+  }
+  const std::string_view strings{data.data() + header.strings_offset,
+                                 data.size() - header.strings_offset};
+
+  std::vector<Mesh> meshes;
+  meshes.reserve(ranges->size());
+  for (const MeshRange& range : *ranges) {
+    Mesh& mesh = meshes.emplace_back();
+    mesh.vertices = vertices->subspan(range.first_vertex, range.num_vertices);
+    // All ranges of indices have been validated by the loops above.
+    const auto get_indices = [&range, &indices16, &indices32](
+        uint32_t first_index, uint32_t count) -> IndicesView {
+      if (range.index_size == sizeof(uint16_t)) {
+        return indices16->subspan(first_index, count);
+      }
+      return indices32->subspan(first_index, count);
+    };
+    mesh.indices = get_indices(range.first_index, range.num_indices);
+    mesh.lods.reserve(range.num_lods);
+    for (const LodRecord& record :
+             lods->subspan(range.first_lod, range.num_lods)) {
+      mesh.lods.push_back({get_indices(record.first_index, record.num_indices),
+                           record.error});
+    }
+    mesh.textures.reserve(range.num_textures);
+    for (const TextureRecord& record :
+             textures->subspan(range.first_texture, range.num_textures)) {
+      if (record.type >= static_cast<uint32_t>(
+                             ModelLoader::TextureType::kNumTypes) ||
+          record.path_offset > strings.size() ||
+          record.path_length > strings.size() - record.path_offset) {
+        return false;
+      }
+      mesh.textures.push_back({
+          static_cast<ModelLoader::TextureType>(record.type),
+          strings.substr(record.path_offset, record.path_length),
+      });
+    }
+  }
+
+  data_ = data;
+  meshes_ = std::move(meshes);
+  return true;
+}
+
+}  // namespace lighter::common
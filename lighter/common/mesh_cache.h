@@ -0,0 +1,135 @@
+//
+//  mesh_cache.h
+//
+//  Created by Pujun Lun on 6/14/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#ifndef LIGHTER_COMMON_MESH_CACHE_H
+#define LIGHTER_COMMON_MESH_CACHE_H
+
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lighter/common/file.h"
+#include "lighter/common/model_loader.h"
+#include "third_party/absl/types/span.h"
+
+namespace lighter::common {
+
+// Binary cache of mesh data, so that model files don't need to be parsed every
+// time the application starts. Vertices and indices of all meshes are stored in
+// contiguous blobs, which can be used directly after the cache file is memory
+// mapped. Each cache file records the hash of its source, and it will be
+// treated as stale if the source changes, or if it was written by a different
+// version of this class.
+class MeshCache {
+ public:
+  // SHA256 of the source file and options used for loading it.
+  using SourceHash = std::array<unsigned char, 32>;
+
+  // Reference to a texture used by a mesh.
+  struct TextureRef {
+    ModelLoader::TextureType type;
+    std::string_view path;
+  };
+
+  // A simplified level of detail of a mesh, which shares vertices with it.
+  // 'error' is the same as mesh_simplifier::LevelOfDetail::error.
+  struct LevelOfDetail {
+    IndicesView indices;
+    float error;
+  };
+
+  // Views into data of one mesh. If they are obtained from a MeshCache object,
+  // they live as long as that object. Indices are cached in 16-bit integers if
+  // CanUse16BitIndices() returns true for the mesh, regardless of the type of
+  // indices passed to Create(). 'lods' holds coarser levels of detail, ordered
+  // from the most detailed one, and indices of them are stored in the same
+  // type as 'indices'.
+  struct Mesh {
+    absl::Span<const Vertex3DWithTex> vertices;
+    IndicesView indices;
+    std::vector<TextureRef> textures;
+    std::vector<LevelOfDetail> lods;
+  };
+
+  // Loads meshes from the model file at 'model_path' using ModelLoader, or from
+  // the cache if it is up-to-date. Paths of textures will be relative to
+  // 'texture_dir', if they are located in that directory. 'optimize_meshes' is
+  // passed to ModelLoader. If 'lod_ratios' is not empty, levels of detail will
+  // be generated with mesh_simplifier::GenerateLodChain() for each mesh.
+  static std::unique_ptr<MeshCache> LoadModel(
+      const std::string& model_path, const std::string& texture_dir,
+      bool optimize_meshes = false, absl::Span<const float> lod_ratios = {});
+
+  // Loads the mesh from the Wavefront .obj file at 'obj_path' using ObjFile, or
+  // from the cache if it is up-to-date. The loaded mesh has no textures. If
+  // 'optimize_mesh' is true, the mesh will be optimized with
+  // mesh_optimizer::OptimizeMesh() before being cached. 'lod_ratios' is used
+  // the same way as LoadModel().
+  static std::unique_ptr<MeshCache> LoadObjFile(
+      const std::string& obj_path, int index_base, bool optimize_mesh = false,
+      absl::Span<const float> lod_ratios = {});
+
+  // Returns the hash of the file at 'source_path'. 'loader_options' should
+  // describe how the file is loaded, so that the cache becomes stale if any
+  // option that affects loaded data changes.
+  static SourceHash ComputeSourceHash(std::string_view source_path,
+                                      std::string_view loader_options);
+
+  // Returns the default path to the cache file of 'source_path' loaded with
+  // 'loader_options', which is located in the temporary directory. Caches of
+  // the same source loaded with different options have different paths, so
+  // that they don't overwrite each other.
+  static std::string GetDefaultCachePath(std::string_view source_path,
+                                         std::string_view loader_options);
+
+  // Loads meshes from the cache file at 'cache_path'. Returns nullptr if the
+  // file does not exist, or it is not valid for the source with 'source_hash'.
+  static std::unique_ptr<MeshCache> LoadFromFile(std::string_view cache_path,
+                                                 const SourceHash& source_hash);
+
+  // Serializes 'meshes' into a new cache held in memory. Data is copied, hence
+  // 'meshes' don't need to outlive the returned object.
+  static std::unique_ptr<MeshCache> Create(absl::Span<const Mesh> meshes,
+                                           const SourceHash& source_hash);
+
+  // This class is neither copyable nor movable.
+  MeshCache(const MeshCache&) = delete;
+  MeshCache& operator=(const MeshCache&) = delete;
+
+  // Writes the cache to 'cache_path'. The file is first written to a temporary
+  // path and then renamed, so readers never see a partially written file.
+  // Returns false if failed, in which case the cache file is left unchanged.
+  bool WriteToFile(std::string_view cache_path) const;
+
+  // Accessors.
+  const std::vector<Mesh>& meshes() const { return meshes_; }
+
+ private:
+  // Interprets 'data' as the content of a cache file. Returns false if it is
+  // malformed or not valid for the source with 'source_hash'.
+  bool Parse(absl::Span<const char> data, const SourceHash& source_hash);
+
+  MeshCache() = default;
+
+  // Holds the content of the cache file if loaded from disk.
+  std::unique_ptr<RawData> file_data_;
+
+  // Holds the content of the cache file if created in memory.
+  std::vector<char> buffer_;
+
+  // Content of the cache file, pointing to either 'file_data_' or 'buffer_'.
+  absl::Span<const char> data_;
+
+  // Views into 'data_'.
+  std::vector<Mesh> meshes_;
+};
+
+}  // namespace lighter::common
+
+#endif  // LIGHTER_COMMON_MESH_CACHE_H
@@ -0,0 +1,212 @@
+//
+//  mesh_cache_test.cc
+//
+//  Created by Pujun Lun on 6/14/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/mesh_cache.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#ifdef ASSERT_TRUE
+#undef ASSERT_TRUE
+#endif
+#ifdef ASSERT_FALSE
+#undef ASSERT_FALSE
+#endif
+#include "third_party/gtest/gtest.h"
+
+namespace lighter::common {
+namespace {
+
+using TextureType = ModelLoader::TextureType;
+
+// Returns a path in the temporary directory.
+std::string GetTempPath(const std::string& file_name) {
+  return (std::filesystem::temp_directory_path() / file_name).string();
+}
+
+// Returns the content of the file at 'path'.
+std::vector<char> ReadFile(const std::string& path) {
+  std::ifstream file{path, std::ios::binary};
+  return {std::istreambuf_iterator<char>{file},
+          std::istreambuf_iterator<char>{}};
+}
+
+// Overwrites the file at 'path' with 'content'.
+void WriteFile(const std::string& path, const std::vector<char>& content) {
+  std::ofstream file{path, std::ios::binary | std::ios::trunc};
+  file.write(content.data(), content.size());
+}
+
+// Returns vertices whose attributes are derived from their indices.
+std::vector<Vertex3DWithTex> CreateVertices(int num_vertices) {
+  std::vector<Vertex3DWithTex> vertices;
+  vertices.reserve(num_vertices);
+  for (int i = 0; i < num_vertices; ++i) {
+    const auto value = static_cast<float>(i);
+    vertices.push_back({/*pos=*/{value, value + 0.5f, -value},
+                        /*norm=*/{0.0f, 0.0f, 1.0f},
+                        /*tex_coord=*/{value / num_vertices, 0.25f}});
+  }
+  return vertices;
+}
+
+// Returns the indices held by 'indices' as 32-bit integers, and whether they
+// are 16-bit integers.
+std::pair<std::vector<uint32_t>, bool> GetIndices(const IndicesView& indices) {
+  return std::visit([](const auto& span) {
+    using IndexType = typename std::decay_t<decltype(span)>::value_type;
+    return std::make_pair(std::vector<uint32_t>(span.begin(), span.end()),
+                          std::is_same_v<IndexType, uint16_t>);
+  }, indices);
+}
+
+void ExpectSameVertices(absl::Span<const Vertex3DWithTex> lhs,
+                        absl::Span<const Vertex3DWithTex> rhs) {
+  ASSERT_EQ(lhs.size(), rhs.size());
+  for (size_t i = 0; i < lhs.size(); ++i) {
+    EXPECT_EQ(lhs[i].pos, rhs[i].pos) << "Vertex " << i;
+    EXPECT_EQ(lhs[i].norm, rhs[i].norm) << "Vertex " << i;
+    EXPECT_EQ(lhs[i].tex_coord, rhs[i].tex_coord) << "Vertex " << i;
+  }
+}
+
+// Meshes that cover both 16-bit and 32-bit indices, levels of detail and
+// texture references.
+class MeshCacheTest : public testing::Test {
+ protected:
+  MeshCacheTest()
+      : small_vertices_{CreateVertices(4)},
+        large_vertices_{CreateVertices(70000)} {
+    meshes_.push_back(MeshCache::Mesh{
+        small_vertices_, absl::MakeConstSpan(small_indices_),
+        /*textures=*/{{TextureType::kDiffuse, "diffuse.png"},
+                      {TextureType::kSpecular, "specular/rock.png"}},
+        /*lods=*/{{absl::MakeConstSpan(small_lod_indices_), 0.5f}},
+    });
+    meshes_.push_back(MeshCache::Mesh{
+        large_vertices_, absl::MakeConstSpan(large_indices_),
+        /*textures=*/{},
+        /*lods=*/{{absl::MakeConstSpan(large_lod_indices_[0]), 0.25f},
+                  {absl::MakeConstSpan(large_lod_indices_[1]), 2.0f}},
+    });
+    meshes_.push_back(MeshCache::Mesh{
+        small_vertices_, absl::MakeConstSpan(narrow_indices_),
+        /*textures=*/{{TextureType::kCubemap, "skybox"}},
+        /*lods=*/{},
+    });
+  }
+
+  const MeshCache::SourceHash source_hash_{4, 8, 15, 16, 23, 42};
+  const std::vector<Vertex3DWithTex> small_vertices_;
+  const std::vector<Vertex3DWithTex> large_vertices_;
+  // Passed as 32-bit integers, but cached as 16-bit integers.
+  const std::vector<uint32_t> small_indices_{0, 1, 2, 0, 2, 3};
+  const std::vector<uint32_t> small_lod_indices_{0, 1, 3};
+  const std::vector<uint32_t> large_indices_{0, 69999, 1, 2, 65536, 69998};
+  const std::vector<uint32_t> large_lod_indices_[2]{{0, 69999, 65536},
+                                                    {2, 69998, 1}};
+  const std::vector<uint16_t> narrow_indices_{3, 2, 1};
+  std::vector<MeshCache::Mesh> meshes_;
+};
+
+TEST_F(MeshCacheTest, RoundTrip) {
+  const std::string cache_path = GetTempPath("mesh_cache_test_round_trip.mesh");
+  ASSERT_TRUE(MeshCache::Create(meshes_, source_hash_)
+                  ->WriteToFile(cache_path));
+  const auto cache = MeshCache::LoadFromFile(cache_path, source_hash_);
+  ASSERT_NE(cache, nullptr);
+  std::filesystem::remove(cache_path);
+
+  const std::vector<MeshCache::Mesh>& loaded_meshes = cache->meshes();
+  ASSERT_EQ(loaded_meshes.size(), meshes_.size());
+  const bool expected_16_bit_indices[]{true, false, true};
+  for (size_t i = 0; i < meshes_.size(); ++i) {
+    const MeshCache::Mesh& expected = meshes_[i];
+    const MeshCache::Mesh& loaded = loaded_meshes[i];
+    ExpectSameVertices(loaded.vertices, expected.vertices);
+
+    const auto [indices, is_16_bit] = GetIndices(loaded.indices);
+    EXPECT_EQ(indices, GetIndices(expected.indices).first) << "Mesh " << i;
+    EXPECT_EQ(is_16_bit, expected_16_bit_indices[i]) << "Mesh " << i;
+
+    ASSERT_EQ(loaded.lods.size(), expected.lods.size()) << "Mesh " << i;
+    for (size_t lod = 0; lod < loaded.lods.size(); ++lod) {
+      const auto [lod_indices, is_lod_16_bit] =
+          GetIndices(loaded.lods[lod].indices);
+      EXPECT_EQ(lod_indices, GetIndices(expected.lods[lod].indices).first);
+      EXPECT_EQ(is_lod_16_bit, is_16_bit);
+      EXPECT_EQ(loaded.lods[lod].error, expected.lods[lod].error);
+    }
+
+    ASSERT_EQ(loaded.textures.size(), expected.textures.size());
+    for (size_t texture = 0; texture < loaded.textures.size(); ++texture) {
+      EXPECT_EQ(loaded.textures[texture].type,
+                expected.textures[texture].type);
+      EXPECT_EQ(loaded.textures[texture].path,
+                expected.textures[texture].path);
+    }
+  }
+}
+
+TEST_F(MeshCacheTest, RejectInvalidFiles) {
+  const std::string cache_path = GetTempPath("mesh_cache_test_invalid.mesh");
+  EXPECT_EQ(MeshCache::LoadFromFile(cache_path, source_hash_), nullptr);
+
+  ASSERT_TRUE(MeshCache::Create(meshes_, source_hash_)
+                  ->WriteToFile(cache_path));
+  const std::vector<char> content = ReadFile(cache_path);
+  ASSERT_NE(MeshCache::LoadFromFile(cache_path, source_hash_), nullptr);
+
+  // Different source hash.
+  MeshCache::SourceHash other_source_hash = source_hash_;
+  other_source_hash.back() ^= 1;
+  EXPECT_EQ(MeshCache::LoadFromFile(cache_path, other_source_hash), nullptr);
+
+  // The header starts with the magic number and the version, both of which are
+  // 32-bit integers.
+  constexpr size_t kMagicOffset = 0;
+  constexpr size_t kVersionOffset = 4;
+  for (const size_t offset : {kMagicOffset, kVersionOffset}) {
+    std::vector<char> corrupted = content;
+    ++corrupted[offset];
+    WriteFile(cache_path, corrupted);
+    EXPECT_EQ(MeshCache::LoadFromFile(cache_path, source_hash_), nullptr)
+        << "Offset " << offset;
+  }
+
+  // File size does not match the one recorded in the header.
+  std::vector<char> extended = content;
+  extended.push_back(0);
+  WriteFile(cache_path, extended);
+  EXPECT_EQ(MeshCache::LoadFromFile(cache_path, source_hash_), nullptr);
+  const std::vector<char> truncated{content.begin(), content.end() - 1};
+  WriteFile(cache_path, truncated);
+  EXPECT_EQ(MeshCache::LoadFromFile(cache_path, source_hash_), nullptr);
+
+  WriteFile(cache_path, content);
+  EXPECT_NE(MeshCache::LoadFromFile(cache_path, source_hash_), nullptr);
+  std::filesystem::remove(cache_path);
+}
+
+TEST(MeshCachePathTest, DependOnLoaderOptions) {
+  EXPECT_EQ(MeshCache::GetDefaultCachePath("model.obj", "optimize=1"),
+            MeshCache::GetDefaultCachePath("model.obj", "optimize=1"));
+  EXPECT_NE(MeshCache::GetDefaultCachePath("model.obj", "optimize=1"),
+            MeshCache::GetDefaultCachePath("model.obj", "optimize=0"));
+  EXPECT_NE(MeshCache::GetDefaultCachePath("a/model.obj", "optimize=1"),
+            MeshCache::GetDefaultCachePath("b/model.obj", "optimize=1"));
+}
+
+}  // namespace
+}  // namespace lighter::common
@@ -0,0 +1,372 @@
+//
+//  mesh_optimizer.cc
+//
+//  Created by Pujun Lun on 6/15/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/mesh_optimizer.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "lighter/common/util.h"
+#include "third_party/absl/strings/str_format.h"
+
+namespace lighter::common::mesh_optimizer {
+namespace {
+
+// Simulates a FIFO vertex cache. Instead of storing cached vertices, we record
+// the time when each vertex enters the cache. A vertex is in the cache iff no
+// more than 'cache_size' vertices have entered the cache since then.
+class FifoCache {
+ public:
+  FifoCache(size_t num_vertices, int cache_size)
+      : cache_size_{cache_size}, time_{cache_size + 1},
+        entry_times_(num_vertices, 0) {}
+
+  // Makes sure 'vertex' is in the cache. Returns true if it was not.
+  bool Access(uint32_t vertex) {
+    if (time_ - entry_times_[vertex] > cache_size_) {
+      entry_times_[vertex] = time_++;
+      return true;
+    }
+    return false;
+  }
+
+  // Evicts all vertices.
+  void Reset() { time_ += cache_size_ + 1; }
+
+ private:
+  const int64_t cache_size_;
+  int64_t time_;
+  std::vector<int64_t> entry_times_;
+};
+
+// Checks that 'indices' form triangles and all of them are in range.
+void ValidateIndices(absl::Span<const uint32_t> indices, size_t num_vertices) {
+  ASSERT_TRUE(indices.size() % 3 == 0,
+              absl::StrFormat("Number of indices (%d) is not a multiple of 3",
+                              indices.size()));
+  for (uint32_t index : indices) {
+    ASSERT_TRUE(index < num_vertices,
+                absl::StrFormat("Index %d out of range (%d vertices)",
+                                index, num_vertices));
+  }
+}
+
+// State of the Tipsify algorithm. Variable names in the paper are noted in
+// comments of member variables.
+class Tipsifier {
+ public:
+  Tipsifier(absl::Span<const uint32_t> indices, size_t num_vertices,
+            int cache_size)
+      : indices_{indices}, cache_size_{cache_size},
+        live_counts_(num_vertices, 0), adjacency_offsets_(num_vertices + 1),
+        adjacency_(indices.size()), cache_times_(num_vertices, 0),
+        emitted_(indices.size() / 3, false), time_{cache_size + 1} {
+    // Build the vertex-triangle adjacency in the compressed sparse row form.
+    for (uint32_t index : indices_) {
+      ++live_counts_[index];
+    }
+    std::partial_sum(live_counts_.begin(), live_counts_.end(),
+                     adjacency_offsets_.begin() + 1);
+    std::vector<uint32_t> cursors{adjacency_offsets_.begin(),
+                                  adjacency_offsets_.end() - 1};
+    for (size_t i = 0; i < indices_.size(); ++i) {
+      adjacency_[cursors[indices_[i]]++] = i / 3;
+    }
+  }
+
+  // This class is neither copyable nor movable.
+  Tipsifier(const Tipsifier&) = delete;
+  Tipsifier& operator=(const Tipsifier&) = delete;
+
+  // Returns reordered indices.
+  std::vector<uint32_t> Run() {
+    std::vector<uint32_t> output;
+    output.reserve(indices_.size());
+    int64_t fanning_vertex =
+        indices_.empty() ? -1 : static_cast<int64_t>(indices_[0]);
+    while (fanning_vertex >= 0) {
+      candidates_.clear();
+      const auto vertex = static_cast<uint32_t>(fanning_vertex);
+      for (uint32_t i = adjacency_offsets_[vertex];
+           i < adjacency_offsets_[vertex + 1]; ++i) {
+        const uint32_t triangle = adjacency_[i];
+        if (emitted_[triangle]) {
+          continue;
+        }
+        for (int corner = 0; corner < 3; ++corner) {
+          const uint32_t index = indices_[triangle * 3 + corner];
+          output.push_back(index);
+          dead_end_stack_.push_back(index);
+          candidates_.push_back(index);
+          --live_counts_[index];
+          if (time_ - cache_times_[index] > cache_size_) {
+            cache_times_[index] = time_++;
+          }
+        }
+        emitted_[triangle] = true;
+      }
+      fanning_vertex = GetNextVertex();
+    }
+    return output;
+  }
+
+ private:
+  // Returns the next fanning vertex, or -1 if all triangles are emitted.
+  // Prefers the candidate that will still be in the cache after its remaining
+  // triangles are emitted, and among them the one that entered the cache
+  // earliest.
+  int64_t GetNextVertex() {
+    int64_t best_vertex = -1;
+    int64_t best_priority = -1;
+    for (uint32_t vertex : candidates_) {
+      if (live_counts_[vertex] == 0) {
+        continue;
+      }
+      int64_t priority = 0;
+      const int64_t age = time_ - cache_times_[vertex];
+      if (age + 2 * live_counts_[vertex] <= cache_size_) {
+        priority = age;
+      }
+      if (priority > best_priority) {
+        best_priority = priority;
+        best_vertex = vertex;
+      }
+    }
+    return best_vertex >= 0 ? best_vertex : SkipDeadEnd();
+  }
+
+  // Returns a vertex that still has live triangles, or -1 if there is none.
+  // Recently used vertices are tried first.
+  int64_t SkipDeadEnd() {
+    while (!dead_end_stack_.empty()) {
+      const uint32_t vertex = dead_end_stack_.back();
+      dead_end_stack_.pop_back();
+      if (live_counts_[vertex] > 0) {
+        return vertex;
+      }
+    }
+    for (; next_vertex_ < live_counts_.size(); ++next_vertex_) {
+      if (live_counts_[next_vertex_] > 0) {
+        return next_vertex_;
+      }
+    }
+    return -1;
+  }
+
+  // Input indices (I).
+  const absl::Span<const uint32_t> indices_;
+
+  // Size of the simulated vertex cache (k).
+  const int64_t cache_size_;
+
+  // Number of triangles not yet emitted that use each vertex (L).
+  std::vector<uint32_t> live_counts_;
+
+  // Triangles that use each vertex (A). Triangles using vertex 'v' are stored
+  // in range ['adjacency_offsets_[v]', 'adjacency_offsets_[v + 1]').
+  std::vector<uint32_t> adjacency_offsets_;
+  std::vector<uint32_t> adjacency_;
+
+  // Time when each vertex entered the cache (C).
+  std::vector<int64_t> cache_times_;
+
+  // Whether each triangle has been emitted (E).
+  std::vector<bool> emitted_;
+
+  // Vertices of recently emitted triangles (D).
+  std::vector<uint32_t> dead_end_stack_;
+
+  // Vertices of triangles emitted in the current fan (N).
+  std::vector<uint32_t> candidates_;
+
+  // Current time (s).
+  int64_t time_;
+
+  // Cursor for iterating through all vertices when the dead-end stack is
+  // exhausted (i).
+  uint32_t next_vertex_ = 0;
+};
+
+// A group of consecutive triangles, which are moved as a whole when optimizing
+// overdraw.
+struct Cluster {
+  // Range of triangles.
+  size_t first_triangle;
+  size_t num_triangles;
+
+  // Clusters with larger values are drawn first.
+  float sort_key;
+};
+
+// Splits triangles into clusters. Hard boundaries are placed where the cache
+// is cold (i.e. all vertices of a triangle miss the cache), and each hard
+// cluster is further split where the ACMR of the current cluster, simulated
+// from a cold cache, is within 'threshold' times the ACMR of the hard cluster.
+std::vector<Cluster> GenerateClusters(absl::Span<const uint32_t> indices,
+                                      size_t num_vertices, float threshold,
+                                      int cache_size) {
+  const size_t num_triangles = indices.size() / 3;
+
+  // Find hard boundaries.
+  std::vector<size_t> hard_boundaries;
+  FifoCache cache{num_vertices, cache_size};
+  for (size_t triangle = 0; triangle < num_triangles; ++triangle) {
+    int num_misses = 0;
+    for (int corner = 0; corner < 3; ++corner) {
+      num_misses += cache.Access(indices[triangle * 3 + corner]);
+    }
+    if (num_misses == 3) {
+      hard_boundaries.push_back(triangle);
+    }
+  }
+  hard_boundaries.push_back(num_triangles);
+
+  // Find soft boundaries within each hard cluster.
+  std::vector<Cluster> clusters;
+  for (size_t i = 0; i + 1 < hard_boundaries.size(); ++i) {
+    const size_t begin = hard_boundaries[i];
+    const size_t end = hard_boundaries[i + 1];
+    const VertexCacheStatistics hard_stats = AnalyzeVertexCache(
+        indices.subspan(begin * 3, (end - begin) * 3), num_vertices,
+        cache_size);
+    const float max_acmr = hard_stats.acmr * threshold;
+
+    cache.Reset();
+    size_t cluster_begin = begin;
+    int num_misses = 0;
+    for (size_t triangle = begin; triangle < end; ++triangle) {
+      for (int corner = 0; corner < 3; ++corner) {
+        num_misses += cache.Access(indices[triangle * 3 + corner]);
+      }
+      const size_t num_cluster_triangles = triangle + 1 - cluster_begin;
+      if (triangle + 1 < end &&
+          num_misses <= max_acmr * num_cluster_triangles) {
+        clusters.push_back({cluster_begin, num_cluster_triangles,
+                            /*sort_key=*/0.0f});
+        cluster_begin = triangle + 1;
+        num_misses = 0;
+        cache.Reset();
+      }
+    }
+    clusters.push_back({cluster_begin, end - cluster_begin,
+                        /*sort_key=*/0.0f});
+  }
+  return clusters;
+}
+
+}  // namespace
+
+VertexCacheStatistics AnalyzeVertexCache(absl::Span<const uint32_t> indices,
+                                         size_t num_vertices, int cache_size) {
+  ValidateIndices(indices, num_vertices);
+  FifoCache cache{num_vertices, cache_size};
+  std::vector<bool> used(num_vertices, false);
+  int num_transformed_vertices = 0;
+  int num_used_vertices = 0;
+  for (uint32_t index : indices) {
+    num_transformed_vertices += cache.Access(index);
+    if (!used[index]) {
+      used[index] = true;
+      ++num_used_vertices;
+    }
+  }
+
+  const size_t num_triangles = indices.size() / 3;
+  return VertexCacheStatistics{
+      num_transformed_vertices,
+      /*acmr=*/num_triangles == 0 ? 0.0f
+          : static_cast<float>(num_transformed_vertices) / num_triangles,
+      /*atvr=*/num_used_vertices == 0 ? 0.0f
+          : static_cast<float>(num_transformed_vertices) / num_used_vertices,
+  };
+}
+
+void OptimizeVertexCache(absl::Span<uint32_t> indices, size_t num_vertices,
+                         int cache_size) {
+  ValidateIndices(indices, num_vertices);
+  const std::vector<uint32_t> reordered =
+      Tipsifier{indices, num_vertices, cache_size}.Run();
+  std::copy(reordered.begin(), reordered.end(), indices.begin());
+}
+
+void OptimizeOverdraw(absl::Span<uint32_t> indices,
+                      absl::Span<const glm::vec3> positions,
+                      float threshold, int cache_size) {
+  ValidateIndices(indices, positions.size());
+  std::vector<Cluster> clusters =
+      GenerateClusters(indices, positions.size(), threshold, cache_size);
+  if (clusters.size() <= 1) {
+    return;
+  }
+
+  // Compute the area-weighted centroid and normal of each cluster. Since the
+  // length of cross product is twice the area, we don't need to normalize it.
+  std::vector<glm::vec3> cluster_centroids, cluster_normals;
+  cluster_centroids.reserve(clusters.size());
+  cluster_normals.reserve(clusters.size());
+  glm::vec3 mesh_centroid{0.0f};
+  float mesh_area = 0.0f;
+  for (const Cluster& cluster : clusters) {
+    glm::vec3 centroid{0.0f}, normal{0.0f};
+    float area = 0.0f;
+    for (size_t i = 0; i < cluster.num_triangles; ++i) {
+      const size_t base = (cluster.first_triangle + i) * 3;
+      const glm::vec3& p0 = positions[indices[base]];
+      const glm::vec3& p1 = positions[indices[base + 1]];
+      const glm::vec3& p2 = positions[indices[base + 2]];
+      const glm::vec3 weighted_normal = glm::cross(p1 - p0, p2 - p0);
+      const float weight = glm::length(weighted_normal);
+      centroid += (p0 + p1 + p2) * (weight / 3.0f);
+      normal += weighted_normal;
+      area += weight;
+    }
+    mesh_centroid += centroid;
+    mesh_area += area;
+    cluster_centroids.push_back(area > 0.0f ? centroid / area : centroid);
+    cluster_normals.push_back(normal);
+  }
+  if (mesh_area > 0.0f) {
+    mesh_centroid /= mesh_area;
+  }
+
+  for (size_t i = 0; i < clusters.size(); ++i) {
+    const float normal_length = glm::length(cluster_normals[i]);
+    clusters[i].sort_key =
+        normal_length > 0.0f
+            ? glm::dot(cluster_centroids[i] - mesh_centroid,
+                       cluster_normals[i] / normal_length)
+            : 0.0f;
+  }
+  std::stable_sort(clusters.begin(), clusters.end(),
+                   [](const Cluster& lhs, const Cluster& rhs) {
+                     return lhs.sort_key > rhs.sort_key;
+                   });
+
+  std::vector<uint32_t> reordered;
+  reordered.reserve(indices.size());
+  for (const Cluster& cluster : clusters) {
+    const auto begin = indices.begin() + cluster.first_triangle * 3;
+    reordered.insert(reordered.end(), begin,
+                     begin + cluster.num_triangles * 3);
+  }
+  std::copy(reordered.begin(), reordered.end(), indices.begin());
+}
+
+std::vector<uint32_t> GenerateVertexFetchRemap(
+    absl::Span<const uint32_t> indices, size_t num_vertices) {
+  ValidateIndices(indices, num_vertices);
+  std::vector<uint32_t> remap(num_vertices, kUnusedVertex);
+  uint32_t next_location = 0;
+  for (uint32_t index : indices) {
+    if (remap[index] == kUnusedVertex) {
+      remap[index] = next_location++;
+    }
+  }
+  return remap;
+}
+
+}  // namespace lighter::common::mesh_optimizer
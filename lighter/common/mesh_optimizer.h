@@ -0,0 +1,125 @@
+//
+//  mesh_optimizer.h
+//
+//  Created by Pujun Lun on 6/15/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#ifndef LIGHTER_COMMON_MESH_OPTIMIZER_H
+#define LIGHTER_COMMON_MESH_OPTIMIZER_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "third_party/absl/types/span.h"
+#include "third_party/glm/glm.hpp"
+
+namespace lighter::common::mesh_optimizer {
+
+// Size of the simulated post-transform vertex cache. GPUs usually have larger
+// caches, but optimizing for a smaller one works well for larger ones too.
+constexpr int kDefaultCacheSize = 16;
+
+// Options for OptimizeMesh().
+struct Options {
+  // Size of the simulated post-transform vertex cache.
+  int cache_size = kDefaultCacheSize;
+
+  // Whether to also reorder triangles to reduce overdraw.
+  bool optimize_overdraw = false;
+
+  // Overdraw optimization may increase ACMR by at most this factor.
+  float overdraw_threshold = 1.05f;
+};
+
+// Statistics of a simulated FIFO post-transform vertex cache.
+struct VertexCacheStatistics {
+  // Number of vertices transformed, i.e. cache misses.
+  int num_transformed_vertices;
+
+  // Average cache miss ratio, i.e. transformed vertices per triangle. The best
+  // possible value is around 0.5 for regular meshes.
+  float acmr;
+
+  // Average transformed vertex ratio, i.e. transformed vertices per unique
+  // vertex. The best possible value is 1.
+  float atvr;
+};
+
+// Simulates a FIFO vertex cache of 'cache_size' while rendering triangles in
+// 'indices', and returns statistics.
+VertexCacheStatistics AnalyzeVertexCache(absl::Span<const uint32_t> indices,
+                                         size_t num_vertices,
+                                         int cache_size = kDefaultCacheSize);
+
+// Reorders triangles in 'indices' to improve the hit rate of the
+// post-transform vertex cache, using the Tipsify algorithm (Sander et al.,
+// "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw").
+// Vertices within each triangle keep their order, hence the winding is kept.
+void OptimizeVertexCache(absl::Span<uint32_t> indices, size_t num_vertices,
+                         int cache_size = kDefaultCacheSize);
+
+// Reorders triangles in 'indices' to reduce overdraw. 'indices' should have
+// been optimized with OptimizeVertexCache(). Triangles are grouped into
+// clusters at points where the vertex cache is cold, and clusters are further
+// split as long as ACMR does not increase by more than 'threshold' times.
+// Clusters that face outwards are then moved to the front, since they are more
+// likely to occlude others.
+void OptimizeOverdraw(absl::Span<uint32_t> indices,
+                      absl::Span<const glm::vec3> positions,
+                      float threshold, int cache_size = kDefaultCacheSize);
+
+// Returns a table that maps each vertex to its new location, so that vertices
+// are ordered by their first use in 'indices'. Vertices that are not used will
+// be mapped to kUnusedVertex.
+constexpr uint32_t kUnusedVertex = ~0U;
+std::vector<uint32_t> GenerateVertexFetchRemap(
+    absl::Span<const uint32_t> indices, size_t num_vertices);
+
+// Reorders 'vertices' by their first use in 'indices' to improve the locality
+// of vertex fetching, and updates 'indices' accordingly. Unused vertices are
+// removed.
+template <typename VertexType>
+void OptimizeVertexFetch(std::vector<uint32_t>& indices,
+                         std::vector<VertexType>& vertices) {
+  const std::vector<uint32_t> remap =
+      GenerateVertexFetchRemap(indices, vertices.size());
+  std::vector<VertexType> reordered_vertices(vertices.size());
+  size_t num_used_vertices = 0;
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    if (remap[i] != kUnusedVertex) {
+      reordered_vertices[remap[i]] = vertices[i];
+      ++num_used_vertices;
+    }
+  }
+  reordered_vertices.resize(num_used_vertices);
+  vertices = std::move(reordered_vertices);
+  for (uint32_t& index : indices) {
+    index = remap[index];
+  }
+}
+
+// Convenience function to apply all optimizations enabled in 'options' to a
+// mesh. VertexType must have a 'pos' member of type glm::vec3 if overdraw
+// optimization is enabled.
+template <typename VertexType>
+void OptimizeMesh(const Options& options, std::vector<uint32_t>& indices,
+                  std::vector<VertexType>& vertices) {
+  OptimizeVertexCache(absl::MakeSpan(indices), vertices.size(),
+                      options.cache_size);
+  if (options.optimize_overdraw) {
+    std::vector<glm::vec3> positions;
+    positions.reserve(vertices.size());
+    for (const auto& vertex : vertices) {
+      positions.push_back(vertex.pos);
+    }
+    OptimizeOverdraw(absl::MakeSpan(indices), positions,
+                     options.overdraw_threshold, options.cache_size);
+  }
+  OptimizeVertexFetch(indices, vertices);
+}
+
+}  // namespace lighter::common::mesh_optimizer
+
+#endif  // LIGHTER_COMMON_MESH_OPTIMIZER_H
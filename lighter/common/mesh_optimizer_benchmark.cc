@@ -0,0 +1,183 @@
+//
+//  mesh_optimizer_benchmark.cc
+//
+//  Created by Pujun Lun on 6/15/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lighter/common/file.h"
+#include "lighter/common/mesh_optimizer.h"
+#include "lighter/common/util.h"
+#include "third_party/absl/flags/flag.h"
+#include "third_party/absl/flags/parse.h"
+#include "third_party/absl/strings/str_format.h"
+#include "third_party/benchmark/benchmark.h"
+#include "third_party/glm/glm.hpp"
+
+ABSL_FLAG(std::string, obj_path, "",
+          "Path to the .obj file to optimize. If not specified, a grid mesh "
+          "with shuffled triangles will be generated");
+ABSL_FLAG(int, grid_size, 256,
+          "Number of vertices on each side of the generated grid mesh");
+
+namespace lighter::common {
+namespace {
+
+// Index base used by .obj files.
+constexpr int kObjFileIndexBase = 1;
+
+// Mesh data to optimize.
+struct Mesh {
+  std::vector<uint32_t> indices;
+  std::vector<Vertex3DWithTex> vertices;
+};
+
+// Returns a grid mesh with 'grid_size' * 'grid_size' vertices, whose triangles
+// are shuffled to simulate a poorly ordered mesh.
+Mesh GenerateShuffledGridMesh(int grid_size) {
+  Mesh mesh;
+  mesh.vertices.reserve(grid_size * grid_size);
+  for (int y = 0; y < grid_size; ++y) {
+    for (int x = 0; x < grid_size; ++x) {
+      const glm::vec2 tex_coord = glm::vec2{x, y} / (grid_size - 1.0f);
+      mesh.vertices.push_back({/*pos=*/glm::vec3{tex_coord, 0.0f},
+                               /*norm=*/glm::vec3{0.0f, 0.0f, 1.0f},
+                               tex_coord});
+    }
+  }
+
+  using Triangle = std::array<uint32_t, 3>;
+  std::vector<Triangle> triangles;
+  triangles.reserve((grid_size - 1) * (grid_size - 1) * 2);
+  for (int y = 0; y < grid_size - 1; ++y) {
+    for (int x = 0; x < grid_size - 1; ++x) {
+      const uint32_t index = y * grid_size + x;
+      triangles.push_back({index, index + 1, index + grid_size + 1});
+      triangles.push_back({index, index + grid_size + 1, index + grid_size});
+    }
+  }
+  // Use a fixed seed so that results are comparable across runs.
+  std::shuffle(triangles.begin(), triangles.end(), std::mt19937{0});
+
+  mesh.indices.reserve(triangles.size() * 3);
+  for (const Triangle& triangle : triangles) {
+    mesh.indices.insert(mesh.indices.end(), triangle.begin(), triangle.end());
+  }
+  return mesh;
+}
+
+// Reports ACMR and ATVR of 'indices' with the given 'prefix'.
+void ReportVertexCacheStatistics(benchmark::State& state,
+                                 const std::string& prefix,
+                                 absl::Span<const uint32_t> indices,
+                                 size_t num_vertices) {
+  const auto stats = mesh_optimizer::AnalyzeVertexCache(indices, num_vertices);
+  state.counters[prefix + "_acmr"] = stats.acmr;
+  state.counters[prefix + "_atvr"] = stats.atvr;
+}
+
+void BM_OptimizeVertexCache(benchmark::State& state, const Mesh* mesh) {
+  std::vector<uint32_t> indices;
+  for (auto _ : state) {
+    state.PauseTiming();
+    indices = mesh->indices;
+    state.ResumeTiming();
+
+    mesh_optimizer::OptimizeVertexCache(absl::MakeSpan(indices),
+                                        mesh->vertices.size());
+  }
+  ReportVertexCacheStatistics(state, "before", mesh->indices,
+                              mesh->vertices.size());
+  ReportVertexCacheStatistics(state, "after", indices, mesh->vertices.size());
+  state.counters["triangles"] = benchmark::Counter(
+      mesh->indices.size() / 3, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void BM_OptimizeOverdraw(benchmark::State& state, const Mesh* mesh) {
+  std::vector<glm::vec3> positions;
+  positions.reserve(mesh->vertices.size());
+  for (const auto& vertex : mesh->vertices) {
+    positions.push_back(vertex.pos);
+  }
+  std::vector<uint32_t> cache_optimized_indices = mesh->indices;
+  mesh_optimizer::OptimizeVertexCache(absl::MakeSpan(cache_optimized_indices),
+                                      mesh->vertices.size());
+
+  const float threshold = state.range(0) / 100.0f;
+  std::vector<uint32_t> indices;
+  for (auto _ : state) {
+    state.PauseTiming();
+    indices = cache_optimized_indices;
+    state.ResumeTiming();
+
+    mesh_optimizer::OptimizeOverdraw(absl::MakeSpan(indices), positions,
+                                     threshold);
+  }
+  ReportVertexCacheStatistics(state, "before", cache_optimized_indices,
+                              mesh->vertices.size());
+  ReportVertexCacheStatistics(state, "after", indices, mesh->vertices.size());
+}
+
+void BM_OptimizeVertexFetch(benchmark::State& state, const Mesh* mesh) {
+  std::vector<uint32_t> cache_optimized_indices = mesh->indices;
+  mesh_optimizer::OptimizeVertexCache(absl::MakeSpan(cache_optimized_indices),
+                                      mesh->vertices.size());
+
+  std::vector<uint32_t> indices;
+  std::vector<Vertex3DWithTex> vertices;
+  for (auto _ : state) {
+    state.PauseTiming();
+    indices = cache_optimized_indices;
+    vertices = mesh->vertices;
+    state.ResumeTiming();
+
+    mesh_optimizer::OptimizeVertexFetch(indices, vertices);
+  }
+  state.SetBytesProcessed(state.iterations() * mesh->vertices.size() *
+                          sizeof(Vertex3DWithTex));
+}
+
+}  // namespace
+}  // namespace lighter::common
+
+int main(int argc, char* argv[]) {
+  using namespace lighter::common;
+
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+
+  Mesh mesh;
+  const std::string obj_path = absl::GetFlag(FLAGS_obj_path);
+  if (obj_path.empty()) {
+    mesh = GenerateShuffledGridMesh(absl::GetFlag(FLAGS_grid_size));
+  } else {
+    ObjFile file{obj_path, kObjFileIndexBase,
+                 util::GetNumHardwareThreads()};
+    mesh.indices = std::move(file.indices);
+    mesh.vertices = std::move(file.vertices);
+  }
+  LOG_INFO << absl::StreamFormat("Optimizing mesh with %d vertices and %d "
+                                 "triangles", mesh.vertices.size(),
+                                 mesh.indices.size() / 3);
+
+  benchmark::RegisterBenchmark("BM_OptimizeVertexCache",
+                               BM_OptimizeVertexCache, &mesh)
+      ->Unit(benchmark::kMillisecond);
+  // Arguments are thresholds in percentage.
+  benchmark::RegisterBenchmark("BM_OptimizeOverdraw",
+                               BM_OptimizeOverdraw, &mesh)
+      ->ArgName("threshold")->Arg(100)->Arg(105)->Arg(120)
+      ->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark("BM_OptimizeVertexFetch",
+                               BM_OptimizeVertexFetch, &mesh)
+      ->Unit(benchmark::kMillisecond);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
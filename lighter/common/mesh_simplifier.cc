@@ -0,0 +1,571 @@
+//
+//  mesh_simplifier.cc
+//
+//  Created by Pujun Lun on 6/18/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/mesh_simplifier.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+#include "lighter/common/util.h"
+#include "third_party/absl/container/flat_hash_map.h"
+#include "third_party/absl/strings/str_format.h"
+
+namespace lighter::common::mesh_simplifier {
+namespace {
+
+// Edges along borders and seams are weighted more, so that they are less
+// likely to be moved.
+constexpr double kBorderWeight = 10.0;
+
+// Symmetric 4x4 matrix that measures the sum of squared distances to a set of
+// planes, weighted by the area of triangles on those planes.
+class Quadric {
+ public:
+  Quadric() = default;
+
+  // Constructs the quadric of the plane dot('normal', p) + 'distance' = 0.
+  // 'normal' must be normalized.
+  Quadric(const glm::dvec3& normal, double distance, double weight)
+      : a00_{normal.x * normal.x * weight}, a01_{normal.x * normal.y * weight},
+        a02_{normal.x * normal.z * weight}, a11_{normal.y * normal.y * weight},
+        a12_{normal.y * normal.z * weight}, a22_{normal.z * normal.z * weight},
+        b0_{normal.x * distance * weight}, b1_{normal.y * distance * weight},
+        b2_{normal.z * distance * weight}, c_{distance * distance * weight},
+        weight_{weight} {}
+
+  Quadric& operator+=(const Quadric& other) {
+    a00_ += other.a00_; a01_ += other.a01_; a02_ += other.a02_;
+    a11_ += other.a11_; a12_ += other.a12_; a22_ += other.a22_;
+    b0_ += other.b0_; b1_ += other.b1_; b2_ += other.b2_;
+    c_ += other.c_;
+    weight_ += other.weight_;
+    return *this;
+  }
+
+  // Returns the weighted sum of squared distances from 'p' to planes.
+  double Evaluate(const glm::dvec3& p) const {
+    const double result =
+        a00_ * p.x * p.x + a11_ * p.y * p.y + a22_ * p.z * p.z +
+        2.0 * (a01_ * p.x * p.y + a02_ * p.x * p.z + a12_ * p.y * p.z) +
+        2.0 * (b0_ * p.x + b1_ * p.y + b2_ * p.z) + c_;
+    // Rounding errors may make the result slightly negative.
+    return std::max(result, 0.0);
+  }
+
+  // Accessors.
+  double weight() const { return weight_; }
+
+ private:
+  double a00_ = 0.0, a01_ = 0.0, a02_ = 0.0, a11_ = 0.0, a12_ = 0.0,
+         a22_ = 0.0;
+  double b0_ = 0.0, b1_ = 0.0, b2_ = 0.0;
+  double c_ = 0.0;
+  double weight_ = 0.0;
+};
+
+// Collapses edges of a mesh progressively. Topology is analyzed on indices, so
+// that seams (where vertices at the same position have different attributes)
+// look like borders, while quadrics are accumulated per position.
+class Simplifier {
+ public:
+  Simplifier(absl::Span<const uint32_t> indices,
+             absl::Span<const glm::vec3> positions);
+
+  // This class is neither copyable nor movable.
+  Simplifier(const Simplifier&) = delete;
+  Simplifier& operator=(const Simplifier&) = delete;
+
+  // Collapses edges until there are at most 'target_index_count' indices or no
+  // edge can be collapsed. Returns the current level of detail.
+  LevelOfDetail Run(size_t target_index_count);
+
+ private:
+  // Kinds of vertices, which determine how they can be collapsed.
+  enum class VertexKind {
+    // Can collapse into any neighbor.
+    kManifold,
+    // On an open border. Can only collapse along the border.
+    kBorder,
+    // On a seam, i.e. shares the position with exactly one other vertex, and
+    // both have one incoming and one outgoing open edge. Can only collapse
+    // along the seam, together with the other vertex.
+    kSeam,
+    // Cannot collapse.
+    kLocked,
+  };
+
+  // An edge that may collapse from vertex 'from' into vertex 'to'.
+  struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+  };
+
+  // Sentinel values of 'open_out_' and 'open_in_'.
+  static constexpr uint32_t kNoEdge = std::numeric_limits<uint32_t>::max();
+  static constexpr uint32_t kMultipleEdges = kNoEdge - 1;
+
+  // Populates 'position_ids_' and 'next_wedges_'.
+  void BuildPositionIds();
+
+  // Populates 'quadrics_' with triangle planes and border planes.
+  void BuildQuadrics();
+
+  // Populates 'triangle_offsets_' and 'triangles_' with the current indices.
+  void BuildAdjacency();
+
+  // Populates 'open_edges_', 'open_out_', 'open_in_' and 'kinds_' with the
+  // current indices.
+  void ClassifyVertices();
+
+  // Returns collapses allowed for the current indices, sorted by cost.
+  std::vector<Collapse> GetCollapses() const;
+
+  // Returns the vertex that 'vertex' should collapse into if the seam vertex
+  // 'from' collapses into 'to'. 'vertex' must be the other vertex at the
+  // position of 'from'.
+  uint32_t GetSeamTarget(uint32_t from, uint32_t to, uint32_t vertex) const;
+
+  // Returns whether collapsing 'from' into 'to' would flip any triangle.
+  // Populates 'num_removed_triangles' with the number of triangles that would
+  // become degenerate.
+  bool WouldFlip(uint32_t from, uint32_t to, int* num_removed_triangles) const;
+
+  // Performs one pass of collapses. Returns false if nothing collapsed.
+  bool RunPass(size_t target_index_count);
+
+  // Returns triangles that use vertices at 'position_id'.
+  absl::Span<const uint32_t> GetTriangles(uint32_t position_id) const {
+    return absl::MakeConstSpan(triangles_).subspan(
+        triangle_offsets_[position_id],
+        triangle_offsets_[position_id + 1] - triangle_offsets_[position_id]);
+  }
+
+  // Positions of vertices, indexed by vertex indices.
+  const absl::Span<const glm::vec3> positions_;
+
+  // Current indices.
+  std::vector<uint32_t> indices_;
+
+  // Maps each vertex to the first vertex with the same position.
+  std::vector<uint32_t> position_ids_;
+
+  // Links vertices with the same position into a circular list.
+  std::vector<uint32_t> next_wedges_;
+
+  // Quadrics indexed by position IDs.
+  std::vector<Quadric> quadrics_;
+
+  // Triangles using each position ID, in the compressed sparse row form.
+  std::vector<uint32_t> triangle_offsets_;
+  std::vector<uint32_t> triangles_;
+
+  // Whether the edge starting at each corner is open, i.e. no triangle
+  // contains it in the reverse direction.
+  std::vector<bool> open_edges_;
+
+  // Targets and sources of open edges of each vertex.
+  std::vector<uint32_t> open_out_;
+  std::vector<uint32_t> open_in_;
+
+  // Kind of each vertex.
+  std::vector<VertexKind> kinds_;
+
+  // Largest cost of collapses performed so far.
+  double max_cost_ = 0.0;
+};
+
+Simplifier::Simplifier(absl::Span<const uint32_t> indices,
+                       absl::Span<const glm::vec3> positions)
+    : positions_{positions}, indices_{indices.begin(), indices.end()} {
+  ASSERT_TRUE(indices.size() % 3 == 0,
+              absl::StrFormat("Number of indices (%d) is not a multiple of 3",
+                              indices.size()));
+  for (uint32_t index : indices) {
+    ASSERT_TRUE(index < positions.size(),
+                absl::StrFormat("Index %d out of range (%d vertices)",
+                                index, positions.size()));
+  }
+  BuildPositionIds();
+  BuildQuadrics();
+}
+
+void Simplifier::BuildPositionIds() {
+  const auto num_vertices = static_cast<uint32_t>(positions_.size());
+  position_ids_.resize(num_vertices);
+  next_wedges_.resize(num_vertices);
+  // Positions are compared bitwise, since vertices split at seams have exactly
+  // the same position.
+  absl::flat_hash_map<std::array<uint32_t, 3>, uint32_t> first_vertices;
+  first_vertices.reserve(num_vertices);
+  for (uint32_t vertex = 0; vertex < num_vertices; ++vertex) {
+    std::array<uint32_t, 3> key;
+    std::memcpy(key.data(), &positions_[vertex], sizeof(key));
+    const auto [iter, inserted] = first_vertices.insert({key, vertex});
+    const uint32_t first = iter->second;
+    position_ids_[vertex] = first;
+    if (inserted) {
+      next_wedges_[vertex] = vertex;
+    } else {
+      next_wedges_[vertex] = next_wedges_[first];
+      next_wedges_[first] = vertex;
+    }
+  }
+}
+
+void Simplifier::BuildQuadrics() {
+  quadrics_.resize(positions_.size());
+  for (size_t i = 0; i < indices_.size(); i += 3) {
+    const std::array<glm::dvec3, 3> p{glm::dvec3{positions_[indices_[i]]},
+                                      glm::dvec3{positions_[indices_[i + 1]]},
+                                      glm::dvec3{positions_[indices_[i + 2]]}};
+    const glm::dvec3 cross = glm::cross(p[1] - p[0], p[2] - p[0]);
+    const double double_area = glm::length(cross);
+    if (double_area == 0.0) {
+      continue;
+    }
+    const glm::dvec3 normal = cross / double_area;
+    const Quadric quadric{normal, -glm::dot(normal, p[0]), double_area / 2.0};
+    for (int corner = 0; corner < 3; ++corner) {
+      quadrics_[position_ids_[indices_[i + corner]]] += quadric;
+    }
+  }
+
+  // Add planes that are perpendicular to triangles and contain open edges.
+  BuildAdjacency();
+  ClassifyVertices();
+  for (size_t i = 0; i < indices_.size(); i += 3) {
+    for (int corner = 0; corner < 3; ++corner) {
+      if (!open_edges_[i + corner]) {
+        continue;
+      }
+      const uint32_t from = indices_[i + corner];
+      const uint32_t to = indices_[i + (corner + 1) % 3];
+      const glm::dvec3 p0{positions_[from]};
+      const glm::dvec3 p1{positions_[to]};
+      const glm::dvec3 p2{positions_[indices_[i + (corner + 2) % 3]]};
+      const glm::dvec3 edge = p1 - p0;
+      const double length = glm::length(edge);
+      const glm::dvec3 plane_normal =
+          glm::cross(edge, glm::cross(edge, p2 - p0));
+      const double plane_normal_length = glm::length(plane_normal);
+      if (length == 0.0 || plane_normal_length == 0.0) {
+        continue;
+      }
+      const glm::dvec3 normal = plane_normal / plane_normal_length;
+      const Quadric quadric{normal, -glm::dot(normal, p0),
+                            length * length * kBorderWeight};
+      quadrics_[position_ids_[from]] += quadric;
+      quadrics_[position_ids_[to]] += quadric;
+    }
+  }
+}
+
+void Simplifier::BuildAdjacency() {
+  triangle_offsets_.assign(positions_.size() + 1, 0);
+  for (uint32_t index : indices_) {
+    ++triangle_offsets_[position_ids_[index] + 1];
+  }
+  std::partial_sum(triangle_offsets_.begin(), triangle_offsets_.end(),
+                   triangle_offsets_.begin());
+  triangles_.resize(indices_.size());
+  std::vector<uint32_t> cursors{triangle_offsets_.begin(),
+                                triangle_offsets_.end() - 1};
+  for (size_t i = 0; i < indices_.size(); ++i) {
+    triangles_[cursors[position_ids_[indices_[i]]]++] = i / 3;
+  }
+}
+
+void Simplifier::ClassifyVertices() {
+  const size_t num_vertices = positions_.size();
+  open_out_.assign(num_vertices, kNoEdge);
+  open_in_.assign(num_vertices, kNoEdge);
+  open_edges_.assign(indices_.size(), false);
+  kinds_.assign(num_vertices, VertexKind::kManifold);
+
+  // Returns whether the triangle contains the edge from 'from' to 'to'.
+  const auto has_edge = [this](uint32_t triangle, uint32_t from, uint32_t to) {
+    const uint32_t* corners = &indices_[triangle * 3];
+    for (int corner = 0; corner < 3; ++corner) {
+      if (corners[corner] == from && corners[(corner + 1) % 3] == to) {
+        return true;
+      }
+    }
+    return false;
+  };
+  const auto record_edge = [](uint32_t vertex, uint32_t* edge) {
+    *edge = *edge == kNoEdge ? vertex : kMultipleEdges;
+  };
+
+  for (size_t i = 0; i < indices_.size(); i += 3) {
+    for (int corner = 0; corner < 3; ++corner) {
+      const uint32_t from = indices_[i + corner];
+      const uint32_t to = indices_[i + (corner + 1) % 3];
+      int num_same = 0;
+      bool has_reverse = false;
+      for (uint32_t triangle : GetTriangles(position_ids_[to])) {
+        num_same += has_edge(triangle, from, to);
+        has_reverse |= has_edge(triangle, to, from);
+      }
+      if (num_same > 1) {
+        // Non-manifold edge.
+        kinds_[from] = kinds_[to] = VertexKind::kLocked;
+      }
+      if (!has_reverse) {
+        open_edges_[i + corner] = true;
+        record_edge(to, &open_out_[from]);
+        record_edge(from, &open_in_[to]);
+      }
+    }
+  }
+
+  const auto is_single_edge = [](uint32_t edge) {
+    return edge != kNoEdge && edge != kMultipleEdges;
+  };
+  for (uint32_t vertex = 0; vertex < num_vertices; ++vertex) {
+    if (kinds_[vertex] == VertexKind::kLocked) {
+      continue;
+    }
+    const uint32_t other = next_wedges_[vertex];
+    const bool has_open_edges =
+        open_out_[vertex] != kNoEdge || open_in_[vertex] != kNoEdge;
+    const bool is_simple_border = is_single_edge(open_out_[vertex]) &&
+                                  is_single_edge(open_in_[vertex]);
+    if (other == vertex) {
+      if (has_open_edges) {
+        kinds_[vertex] =
+            is_simple_border ? VertexKind::kBorder : VertexKind::kLocked;
+      }
+    } else if (next_wedges_[other] == vertex && is_simple_border &&
+               is_single_edge(open_out_[other]) &&
+               is_single_edge(open_in_[other]) &&
+               position_ids_[open_out_[vertex]] ==
+                   position_ids_[open_in_[other]] &&
+               position_ids_[open_in_[vertex]] ==
+                   position_ids_[open_out_[other]]) {
+      // Both sides of the seam go along the same path.
+      kinds_[vertex] = VertexKind::kSeam;
+    } else {
+      kinds_[vertex] = VertexKind::kLocked;
+    }
+  }
+  // Vertices at the same position must be collapsed together, hence if any of
+  // them is locked, all of them are locked.
+  for (uint32_t vertex = 0; vertex < num_vertices; ++vertex) {
+    if (kinds_[vertex] == VertexKind::kLocked) {
+      for (uint32_t other = next_wedges_[vertex]; other != vertex;
+           other = next_wedges_[other]) {
+        kinds_[other] = VertexKind::kLocked;
+      }
+    }
+  }
+}
+
+std::vector<Simplifier::Collapse> Simplifier::GetCollapses() const {
+  std::vector<Collapse> collapses;
+  for (size_t i = 0; i < indices_.size(); i += 3) {
+    for (int corner = 0; corner < 3; ++corner) {
+      const uint32_t v0 = indices_[i + corner];
+      const uint32_t v1 = indices_[i + (corner + 1) % 3];
+      // Consider both directions of each edge.
+      for (const auto& [from, to] : {std::pair{v0, v1}, std::pair{v1, v0}}) {
+        if (position_ids_[from] == position_ids_[to]) {
+          continue;
+        }
+        bool allowed = false;
+        switch (kinds_[from]) {
+          case VertexKind::kManifold:
+            allowed = true;
+            break;
+          case VertexKind::kBorder:
+          case VertexKind::kSeam:
+            allowed = open_out_[from] == to || open_in_[from] == to;
+            break;
+          case VertexKind::kLocked:
+            break;
+        }
+        if (!allowed) {
+          continue;
+        }
+        Quadric quadric = quadrics_[position_ids_[from]];
+        quadric += quadrics_[position_ids_[to]];
+        const double weight = std::max(quadric.weight(),
+                                       std::numeric_limits<double>::min());
+        collapses.push_back({
+            from, to, quadric.Evaluate(glm::dvec3{positions_[to]}) / weight});
+      }
+    }
+  }
+  std::sort(collapses.begin(), collapses.end(),
+            [](const Collapse& lhs, const Collapse& rhs) {
+              return lhs.cost < rhs.cost;
+            });
+  return collapses;
+}
+
+uint32_t Simplifier::GetSeamTarget(uint32_t from, uint32_t to,
+                                   uint32_t vertex) const {
+  // The other side of the seam goes in the opposite direction.
+  return open_out_[from] == to ? open_in_[vertex] : open_out_[vertex];
+}
+
+bool Simplifier::WouldFlip(uint32_t from, uint32_t to,
+                           int* num_removed_triangles) const {
+  const uint32_t from_id = position_ids_[from];
+  const uint32_t to_id = position_ids_[to];
+  const glm::vec3& new_pos = positions_[to];
+  *num_removed_triangles = 0;
+  for (uint32_t triangle : GetTriangles(from_id)) {
+    std::array<glm::vec3, 3> old_pos, moved_pos;
+    bool is_removed = false;
+    for (int corner = 0; corner < 3; ++corner) {
+      const uint32_t vertex = indices_[triangle * 3 + corner];
+      old_pos[corner] = positions_[vertex];
+      moved_pos[corner] =
+          position_ids_[vertex] == from_id ? new_pos : old_pos[corner];
+      is_removed |= position_ids_[vertex] == to_id;
+    }
+    if (is_removed) {
+      ++*num_removed_triangles;
+      continue;
+    }
+    const glm::vec3 old_normal =
+        glm::cross(old_pos[1] - old_pos[0], old_pos[2] - old_pos[0]);
+    const glm::vec3 new_normal =
+        glm::cross(moved_pos[1] - moved_pos[0], moved_pos[2] - moved_pos[0]);
+    if (glm::dot(old_normal, new_normal) <= 0.0f) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Simplifier::RunPass(size_t target_index_count) {
+  BuildAdjacency();
+  ClassifyVertices();
+  const std::vector<Collapse> collapses = GetCollapses();
+
+  // Each position can be touched by at most one collapse in a pass, so that
+  // adjacency and flip checks stay valid.
+  std::vector<bool> locked(positions_.size(), false);
+  std::vector<uint32_t> remap(positions_.size());
+  std::iota(remap.begin(), remap.end(), 0);
+  const size_t num_target_triangles = target_index_count / 3;
+  size_t num_triangles = indices_.size() / 3;
+  bool collapsed = false;
+  if (collapses.empty()) {
+    return false;
+  }
+
+  // Most collapses remove two triangles. Since many cheap collapses will be
+  // skipped due to locking, we don't proceed to much more expensive ones in the
+  // same pass, and leave them to following passes instead.
+  const size_t goal = std::min((num_triangles - num_target_triangles) / 2,
+                               collapses.size() - 1);
+  const double max_cost_in_pass = collapses[goal].cost * 1.5;
+
+  for (const Collapse& collapse : collapses) {
+    if (num_triangles <= num_target_triangles ||
+        (collapsed && collapse.cost > max_cost_in_pass)) {
+      break;
+    }
+    const uint32_t from_id = position_ids_[collapse.from];
+    const uint32_t to_id = position_ids_[collapse.to];
+    if (locked[from_id] || locked[to_id]) {
+      continue;
+    }
+    int num_removed_triangles;
+    if (WouldFlip(collapse.from, collapse.to, &num_removed_triangles)) {
+      continue;
+    }
+
+    remap[collapse.from] = collapse.to;
+    if (kinds_[collapse.from] == VertexKind::kSeam) {
+      const uint32_t other = next_wedges_[collapse.from];
+      remap[other] = GetSeamTarget(collapse.from, collapse.to, other);
+    }
+    quadrics_[to_id] += quadrics_[from_id];
+    max_cost_ = std::max(max_cost_, collapse.cost);
+    num_triangles -= num_removed_triangles;
+    collapsed = true;
+
+    // Lock the one-ring of 'from_id', since its triangles are changed.
+    for (uint32_t triangle : GetTriangles(from_id)) {
+      for (int corner = 0; corner < 3; ++corner) {
+        locked[position_ids_[indices_[triangle * 3 + corner]]] = true;
+      }
+    }
+  }
+  if (!collapsed) {
+    return false;
+  }
+
+  // Apply the remapping and remove degenerate triangles.
+  size_t num_kept = 0;
+  for (size_t i = 0; i < indices_.size(); i += 3) {
+    const uint32_t v0 = remap[indices_[i]];
+    const uint32_t v1 = remap[indices_[i + 1]];
+    const uint32_t v2 = remap[indices_[i + 2]];
+    if (position_ids_[v0] == position_ids_[v1] ||
+        position_ids_[v1] == position_ids_[v2] ||
+        position_ids_[v2] == position_ids_[v0]) {
+      continue;
+    }
+    indices_[num_kept++] = v0;
+    indices_[num_kept++] = v1;
+    indices_[num_kept++] = v2;
+  }
+  indices_.resize(num_kept);
+  return true;
+}
+
+LevelOfDetail Simplifier::Run(size_t target_index_count) {
+  while (indices_.size() > target_index_count) {
+    if (!RunPass(target_index_count)) {
+      break;
+    }
+  }
+  return LevelOfDetail{indices_, static_cast<float>(std::sqrt(max_cost_))};
+}
+
+}  // namespace
+
+LevelOfDetail Simplify(absl::Span<const uint32_t> indices,
+                       absl::Span<const glm::vec3> positions,
+                       size_t target_index_count) {
+  return Simplifier{indices, positions}.Run(target_index_count);
+}
+
+std::vector<LevelOfDetail> GenerateLodChain(
+    absl::Span<const uint32_t> indices, absl::Span<const glm::vec3> positions,
+    absl::Span<const float> ratios) {
+  Simplifier simplifier{indices, positions};
+  std::vector<LevelOfDetail> lods;
+  lods.reserve(ratios.size());
+  size_t prev_index_count = indices.size();
+  for (float ratio : ratios) {
+    ASSERT_TRUE(ratio > 0.0f && ratio < 1.0f,
+                absl::StrFormat("Invalid ratio %f", ratio));
+    const auto target_index_count =
+        static_cast<size_t>(indices.size() / 3 * ratio) * 3;
+    ASSERT_TRUE(target_index_count <= prev_index_count,
+                "Ratios must be in decreasing order");
+    LevelOfDetail lod = simplifier.Run(target_index_count);
+    if (lod.indices.size() == prev_index_count) {
+      break;
+    }
+    prev_index_count = lod.indices.size();
+    lods.push_back(std::move(lod));
+  }
+  return lods;
+}
+
+}  // namespace lighter::common::mesh_simplifier
@@ -0,0 +1,71 @@
+//
+//  mesh_simplifier.h
+//
+//  Created by Pujun Lun on 6/18/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#ifndef LIGHTER_COMMON_MESH_SIMPLIFIER_H
+#define LIGHTER_COMMON_MESH_SIMPLIFIER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "third_party/absl/types/span.h"
+#include "third_party/glm/glm.hpp"
+
+namespace lighter::common::mesh_simplifier {
+
+// Default ratios of triangles kept in each level of detail.
+constexpr float kDefaultLodRatios[] = {0.5f, 0.25f, 0.1f};
+
+// One level of detail of a mesh. Vertices are shared with the original mesh,
+// hence only indices are stored.
+struct LevelOfDetail {
+  std::vector<uint32_t> indices;
+
+  // Approximate distance between this level and the original surface, in the
+  // same unit as vertex positions. This can be projected to the screen to
+  // decide which level to use.
+  float error;
+};
+
+// Simplifies the mesh so that it has at most 'target_index_count' indices, by
+// collapsing edges in the order of quadric error (Garland and Heckbert,
+// "Surface Simplification Using Quadric Error Metrics"). Each edge collapses
+// into one of its endpoints, hence no new vertex is created. Vertices at
+// different indices but with the same position are treated as one vertex, so
+// that attribute seams stay closed. Borders and seams are preserved by only
+// collapsing along them. The result may have more indices than the target if
+// the mesh cannot be simplified further without changing its topology.
+LevelOfDetail Simplify(absl::Span<const uint32_t> indices,
+                       absl::Span<const glm::vec3> positions,
+                       size_t target_index_count);
+
+// Generates a chain of levels of detail. Element i of the returned vector keeps
+// about 'ratios[i]' of the triangles in 'indices'. 'ratios' must be in
+// decreasing order and in range (0, 1). Levels are simplified from the previous
+// one, but errors are still measured against the original mesh. Generation
+// stops early if a level cannot be simplified any further.
+std::vector<LevelOfDetail> GenerateLodChain(
+    absl::Span<const uint32_t> indices, absl::Span<const glm::vec3> positions,
+    absl::Span<const float> ratios = kDefaultLodRatios);
+
+// Convenience function for meshes whose vertices have a 'pos' member of type
+// glm::vec3, such as ModelLoader::MeshData and ObjFile.
+template <typename VertexType>
+std::vector<LevelOfDetail> GenerateLodChain(
+    absl::Span<const uint32_t> indices,
+    absl::Span<const VertexType> vertices,
+    absl::Span<const float> ratios = kDefaultLodRatios) {
+  std::vector<glm::vec3> positions;
+  positions.reserve(vertices.size());
+  for (const auto& vertex : vertices) {
+    positions.push_back(vertex.pos);
+  }
+  return GenerateLodChain(indices, positions, ratios);
+}
+
+}  // namespace lighter::common::mesh_simplifier
+
+#endif  // LIGHTER_COMMON_MESH_SIMPLIFIER_H
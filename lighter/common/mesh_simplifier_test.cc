@@ -0,0 +1,266 @@
+//
+//  mesh_simplifier_test.cc
+//
+//  Created by Pujun Lun on 6/18/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/mesh_simplifier.h"
+
+#include <cmath>
+#include <iterator>
+#include <set>
+#include <tuple>
+#include <vector>
+
+#include "third_party/glm/gtc/constants.hpp"
+
+#ifdef ASSERT_TRUE
+#undef ASSERT_TRUE
+#endif
+#ifdef ASSERT_FALSE
+#undef ASSERT_FALSE
+#endif
+#include "third_party/gtest/gtest.h"
+
+namespace lighter::common::mesh_simplifier {
+namespace {
+
+using Position = std::tuple<float, float, float>;
+using Edge = std::pair<Position, Position>;
+
+struct Mesh {
+  std::vector<glm::vec3> positions;
+  std::vector<uint32_t> indices;
+};
+
+// A unit sphere with 'num_rings' rings and 'num_segments' segments. All
+// vertices are shared, hence the mesh is closed.
+Mesh CreateSphere(int num_rings, int num_segments) {
+  Mesh mesh;
+  const uint32_t north_pole = 0;
+  mesh.positions.push_back(glm::vec3{0.0f, 1.0f, 0.0f});
+  for (int ring = 1; ring < num_rings; ++ring) {
+    const float phi = glm::pi<float>() * ring / num_rings;
+    for (int segment = 0; segment < num_segments; ++segment) {
+      const float theta = glm::two_pi<float>() * segment / num_segments;
+      mesh.positions.push_back(glm::vec3{std::sin(phi) * std::cos(theta),
+                                         std::cos(phi),
+                                         std::sin(phi) * std::sin(theta)});
+    }
+  }
+  const auto south_pole = static_cast<uint32_t>(mesh.positions.size());
+  mesh.positions.push_back(glm::vec3{0.0f, -1.0f, 0.0f});
+
+  const auto get_index = [num_segments](int ring, int segment) {
+    return static_cast<uint32_t>(1 + (ring - 1) * num_segments +
+                                 segment % num_segments);
+  };
+  for (int segment = 0; segment < num_segments; ++segment) {
+    mesh.indices.insert(mesh.indices.end(), {
+        north_pole, get_index(1, segment + 1), get_index(1, segment)});
+    mesh.indices.insert(mesh.indices.end(), {
+        south_pole, get_index(num_rings - 1, segment),
+        get_index(num_rings - 1, segment + 1)});
+  }
+  for (int ring = 1; ring < num_rings - 1; ++ring) {
+    for (int segment = 0; segment < num_segments; ++segment) {
+      const uint32_t v0 = get_index(ring, segment);
+      const uint32_t v1 = get_index(ring, segment + 1);
+      const uint32_t v2 = get_index(ring + 1, segment);
+      const uint32_t v3 = get_index(ring + 1, segment + 1);
+      mesh.indices.insert(mesh.indices.end(), {v0, v1, v3, v0, v3, v2});
+    }
+  }
+  return mesh;
+}
+
+// A bumpy grid with 'size' * 'size' quads in range [-1, 1] on the XY plane.
+// If 'split_at_seam' is true, vertices at X = 0 are duplicated, and the right
+// half of the grid uses the duplicates, as if texture coordinates were
+// discontinuous there.
+Mesh CreateBumpyGrid(int size, bool split_at_seam) {
+  Mesh mesh;
+  const auto get_position = [size](int x, int y) {
+    const glm::vec2 pos =
+        glm::vec2{static_cast<float>(x), static_cast<float>(y)} /
+            (size / 2.0f) - 1.0f;
+    return glm::vec3{pos, 0.1f * std::sin(pos.x * 5.0f) *
+                          std::cos(pos.y * 3.0f)};
+  };
+  for (int y = 0; y <= size; ++y) {
+    for (int x = 0; x <= size; ++x) {
+      mesh.positions.push_back(get_position(x, y));
+    }
+  }
+  const int seam_x = size / 2;
+  std::vector<uint32_t> seam_duplicates(size + 1);
+  for (int y = 0; y <= size; ++y) {
+    seam_duplicates[y] = split_at_seam
+        ? static_cast<uint32_t>(mesh.positions.size())
+        : static_cast<uint32_t>(y * (size + 1) + seam_x);
+    if (split_at_seam) {
+      mesh.positions.push_back(get_position(seam_x, y));
+    }
+  }
+
+  const auto get_index = [size, seam_x, &seam_duplicates](
+                             int x, int y, bool is_right_half) {
+    return is_right_half && x == seam_x
+        ? seam_duplicates[y] : static_cast<uint32_t>(y * (size + 1) + x);
+  };
+  for (int y = 0; y < size; ++y) {
+    for (int x = 0; x < size; ++x) {
+      const bool is_right_half = x >= seam_x;
+      const uint32_t v0 = get_index(x, y, is_right_half);
+      const uint32_t v1 = get_index(x + 1, y, is_right_half);
+      const uint32_t v2 = get_index(x, y + 1, is_right_half);
+      const uint32_t v3 = get_index(x + 1, y + 1, is_right_half);
+      mesh.indices.insert(mesh.indices.end(), {v0, v1, v3, v0, v3, v2});
+    }
+  }
+  return mesh;
+}
+
+Position ToTuple(const glm::vec3& pos) { return {pos.x, pos.y, pos.z}; }
+
+// Returns edges that are not shared by two triangles, where vertices at the
+// same position are treated as one vertex.
+std::set<Edge> GetOpenEdges(absl::Span<const uint32_t> indices,
+                            absl::Span<const glm::vec3> positions) {
+  std::multiset<Edge> edges;
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    for (int j = 0; j < 3; ++j) {
+      edges.insert({ToTuple(positions[indices[i + j]]),
+                    ToTuple(positions[indices[i + (j + 1) % 3]])});
+    }
+  }
+  std::set<Edge> open_edges;
+  for (const Edge& edge : edges) {
+    if (edges.count({edge.second, edge.first}) == 0) {
+      open_edges.insert(edge);
+    }
+  }
+  return open_edges;
+}
+
+// Returns whether 'pos' is on the border of the grid created by
+// CreateBumpyGrid().
+bool IsOnGridBorder(const Position& pos) {
+  return std::abs(std::get<0>(pos)) == 1.0f ||
+         std::abs(std::get<1>(pos)) == 1.0f;
+}
+
+// Returns whether both ends of 'edge' are on the same side of the grid created
+// by CreateBumpyGrid().
+bool IsAlongGridBorder(const Edge& edge) {
+  const auto& [x0, y0, z0] = edge.first;
+  const auto& [x1, y1, z1] = edge.second;
+  return (std::abs(x0) == 1.0f && x0 == x1) ||
+         (std::abs(y0) == 1.0f && y0 == y1);
+}
+
+TEST(MeshSimplifierTest, ReachTargetRatios) {
+  const Mesh sphere = CreateSphere(/*num_rings=*/32, /*num_segments=*/64);
+  const size_t num_triangles = sphere.indices.size() / 3;
+  const std::vector<LevelOfDetail> lods =
+      GenerateLodChain(sphere.indices, sphere.positions);
+
+  ASSERT_EQ(lods.size(), std::size(kDefaultLodRatios));
+  for (size_t i = 0; i < lods.size(); ++i) {
+    const float ratio =
+        static_cast<float>(lods[i].indices.size() / 3) / num_triangles;
+    EXPECT_LE(ratio, kDefaultLodRatios[i] * 1.05f) << "Level " << i;
+    EXPECT_GE(ratio, kDefaultLodRatios[i] * 0.9f) << "Level " << i;
+    EXPECT_EQ(lods[i].indices.size() % 3, 0);
+  }
+}
+
+TEST(MeshSimplifierTest, ErrorsNeverDecrease) {
+  const Mesh sphere = CreateSphere(/*num_rings=*/32, /*num_segments=*/64);
+  const std::vector<LevelOfDetail> lods =
+      GenerateLodChain(sphere.indices, sphere.positions);
+
+  ASSERT_FALSE(lods.empty());
+  EXPECT_GE(lods[0].error, 0.0f);
+  for (size_t i = 1; i < lods.size(); ++i) {
+    EXPECT_GE(lods[i].error, lods[i - 1].error) << "Level " << i;
+  }
+  // All vertices of the original mesh are on the unit sphere.
+  EXPECT_LT(lods.back().error, 0.5f);
+}
+
+TEST(MeshSimplifierTest, PreserveBorders) {
+  const Mesh grid = CreateBumpyGrid(/*size=*/32, /*split_at_seam=*/false);
+  const LevelOfDetail lod =
+      Simplify(grid.indices, grid.positions, grid.indices.size() / 4);
+  ASSERT_LT(lod.indices.size(), grid.indices.size() / 2);
+
+  // Corners survive, and the outline stays the same.
+  const std::set<uint32_t> vertices{lod.indices.begin(), lod.indices.end()};
+  const uint32_t size = 32;
+  for (const uint32_t corner : {0u, size, size * (size + 1),
+                                size * (size + 1) + size}) {
+    EXPECT_EQ(vertices.count(corner), 1) << "Corner " << corner;
+  }
+  const std::set<Edge> open_edges = GetOpenEdges(lod.indices, grid.positions);
+  ASSERT_FALSE(open_edges.empty());
+  for (const Edge& edge : open_edges) {
+    EXPECT_TRUE(IsAlongGridBorder(edge));
+  }
+}
+
+TEST(MeshSimplifierTest, PreserveSeams) {
+  const Mesh grid = CreateBumpyGrid(/*size=*/32, /*split_at_seam=*/true);
+  const LevelOfDetail lod =
+      Simplify(grid.indices, grid.positions, grid.indices.size() / 4);
+  ASSERT_LT(lod.indices.size(), grid.indices.size() / 2);
+
+  // Both sides of the seam move together, hence the seam does not open up.
+  for (const Edge& edge : GetOpenEdges(lod.indices, grid.positions)) {
+    EXPECT_TRUE(IsAlongGridBorder(edge));
+  }
+
+  // Vertices on both sides of the seam survive where it meets the border.
+  const std::set<uint32_t> vertices{lod.indices.begin(), lod.indices.end()};
+  const uint32_t size = 32;
+  const uint32_t num_grid_vertices = (size + 1) * (size + 1);
+  for (const uint32_t vertex : {size / 2, size * (size + 1) + size / 2,
+                                num_grid_vertices,
+                                num_grid_vertices + size}) {
+    EXPECT_EQ(vertices.count(vertex), 1) << "Vertex " << vertex;
+    EXPECT_TRUE(IsOnGridBorder(ToTuple(grid.positions[vertex])));
+  }
+
+  // No triangle uses vertices from both sides of the seam.
+  for (size_t i = 0; i < lod.indices.size(); i += 3) {
+    bool uses_left = false, uses_right = false;
+    for (int j = 0; j < 3; ++j) {
+      const uint32_t vertex = lod.indices[i + j];
+      const float x = grid.positions[vertex].x;
+      if (vertex >= num_grid_vertices || x > 0.0f) {
+        uses_right = true;
+      } else if (x < 0.0f) {
+        uses_left = true;
+      }
+    }
+    EXPECT_FALSE(uses_left && uses_right) << "Triangle " << i / 3;
+  }
+}
+
+TEST(MeshSimplifierTest, Deterministic) {
+  const Mesh grid = CreateBumpyGrid(/*size=*/32, /*split_at_seam=*/true);
+  const std::vector<LevelOfDetail> lods0 =
+      GenerateLodChain(grid.indices, grid.positions);
+  const std::vector<LevelOfDetail> lods1 =
+      GenerateLodChain(grid.indices, grid.positions);
+
+  ASSERT_EQ(lods0.size(), lods1.size());
+  for (size_t i = 0; i < lods0.size(); ++i) {
+    EXPECT_EQ(lods0[i].indices, lods1[i].indices) << "Level " << i;
+    EXPECT_EQ(lods0[i].error, lods1[i].error) << "Level " << i;
+  }
+}
+
+}  // namespace
+}  // namespace lighter::common::mesh_simplifier
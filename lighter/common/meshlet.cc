@@ -0,0 +1,245 @@
+//
+//  meshlet.cc
+//
+//  Created by Pujun Lun on 6/17/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+#include "lighter/common/util.h"
+#include "third_party/absl/strings/str_format.h"
+
+namespace lighter::common {
+namespace {
+
+// Computes the bounding sphere and normal cone of 'meshlet', whose indices are
+// in 'indices'.
+void ComputeBounds(absl::Span<const uint32_t> indices,
+                   absl::Span<const glm::vec3> positions, Meshlet* meshlet) {
+  const auto meshlet_indices =
+      indices.subspan(meshlet->first_index, meshlet->num_indices);
+
+  // The bounding sphere is centered at the center of the bounding box. This is
+  // not optimal, but good enough for culling.
+  glm::vec3 min_pos{std::numeric_limits<float>::max()};
+  glm::vec3 max_pos{std::numeric_limits<float>::lowest()};
+  for (uint32_t index : meshlet_indices) {
+    min_pos = glm::min(min_pos, positions[index]);
+    max_pos = glm::max(max_pos, positions[index]);
+  }
+  meshlet->center = (min_pos + max_pos) / 2.0f;
+  meshlet->radius = 0.0f;
+  for (uint32_t index : meshlet_indices) {
+    meshlet->radius = std::max(
+        meshlet->radius, glm::length(positions[index] - meshlet->center));
+  }
+
+  // The axis of the normal cone is the average of triangle normals. Degenerate
+  // triangles are ignored since they are never visible.
+  std::vector<glm::vec3> normals;
+  normals.reserve(meshlet_indices.size() / 3);
+  glm::vec3 normal_sum{0.0f};
+  for (int i = 0; i < meshlet_indices.size(); i += 3) {
+    const glm::vec3& p0 = positions[meshlet_indices[i]];
+    const glm::vec3& p1 = positions[meshlet_indices[i + 1]];
+    const glm::vec3& p2 = positions[meshlet_indices[i + 2]];
+    const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+    const float length = glm::length(normal);
+    if (length > 0.0f) {
+      normals.push_back(normal / length);
+      normal_sum += normals.back();
+    }
+  }
+
+  meshlet->cone_axis = glm::vec3{0.0f, 0.0f, 1.0f};
+  meshlet->cone_cutoff = 1.0f;
+  const float sum_length = glm::length(normal_sum);
+  if (sum_length == 0.0f) {
+    return;
+  }
+  meshlet->cone_axis = normal_sum / sum_length;
+  float min_cos = 1.0f;
+  for (const glm::vec3& normal : normals) {
+    min_cos = std::min(min_cos, glm::dot(normal, meshlet->cone_axis));
+  }
+  // If the cone is wider than a hemisphere, some triangles always face the
+  // camera. Otherwise, the half angle of the cone of view directions in which
+  // all triangles are back-facing is (90 - a) degrees, where 'a' is the half
+  // angle of the normal cone. We store the cosine of that angle, which is
+  // sin(a).
+  if (min_cos > 0.0f) {
+    meshlet->cone_cutoff = std::sqrt(1.0f - min_cos * min_cos);
+  }
+}
+
+}  // namespace
+
+MeshletMesh MeshletBuilder::Build(absl::Span<const uint32_t> indices,
+                                  absl::Span<const glm::vec3> positions) const {
+  ASSERT_TRUE(options_.max_vertices >= 3 && options_.max_triangles >= 1,
+              absl::StrFormat("Invalid meshlet limits: %d vertices and %d "
+                              "triangles", options_.max_vertices,
+                              options_.max_triangles));
+  ASSERT_TRUE(indices.size() % 3 == 0,
+              absl::StrFormat("Number of indices (%d) is not a multiple of 3",
+                              indices.size()));
+  const size_t num_vertices = positions.size();
+  for (uint32_t index : indices) {
+    ASSERT_TRUE(index < num_vertices,
+                absl::StrFormat("Index %d out of range (%d vertices)",
+                                index, num_vertices));
+  }
+
+  // Build the vertex-triangle adjacency in the compressed sparse row form.
+  // Triangles using vertex 'v' are stored in range
+  // ['adjacency_offsets[v]', 'adjacency_offsets[v + 1]') of 'adjacency'.
+  const size_t num_triangles = indices.size() / 3;
+  std::vector<uint32_t> adjacency_offsets(num_vertices + 1, 0);
+  for (uint32_t index : indices) {
+    ++adjacency_offsets[index + 1];
+  }
+  std::partial_sum(adjacency_offsets.begin(), adjacency_offsets.end(),
+                   adjacency_offsets.begin());
+  std::vector<uint32_t> adjacency(indices.size());
+  {
+    std::vector<uint32_t> cursors{adjacency_offsets.begin(),
+                                  adjacency_offsets.end() - 1};
+    for (size_t i = 0; i < indices.size(); ++i) {
+      adjacency[cursors[indices[i]]++] = i / 3;
+    }
+  }
+
+  MeshletMesh mesh;
+  mesh.indices.reserve(indices.size());
+
+  // 'vertex_meshlets[v]' is the index of the last meshlet that uses vertex 'v'.
+  constexpr uint32_t kNoMeshlet = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> vertex_meshlets(num_vertices, kNoMeshlet);
+  std::vector<bool> emitted(num_triangles, false);
+  // Unemitted triangles adjacent to the current meshlet. May have duplicates.
+  std::vector<uint32_t> candidates;
+
+  for (size_t seed = 0; seed < num_triangles; ++seed) {
+    if (emitted[seed]) {
+      continue;
+    }
+
+    const auto meshlet_index = static_cast<uint32_t>(mesh.meshlets.size());
+    Meshlet& meshlet = mesh.meshlets.emplace_back();
+    meshlet.first_index = mesh.indices.size();
+    meshlet.num_indices = 0;
+    meshlet.num_vertices = 0;
+    candidates.clear();
+
+    int64_t triangle = seed;
+    while (triangle >= 0) {
+      for (int corner = 0; corner < 3; ++corner) {
+        const uint32_t vertex = indices[triangle * 3 + corner];
+        if (vertex_meshlets[vertex] != meshlet_index) {
+          vertex_meshlets[vertex] = meshlet_index;
+          ++meshlet.num_vertices;
+        }
+        mesh.indices.push_back(vertex);
+        for (uint32_t i = adjacency_offsets[vertex];
+             i < adjacency_offsets[vertex + 1]; ++i) {
+          if (!emitted[adjacency[i]]) {
+            candidates.push_back(adjacency[i]);
+          }
+        }
+      }
+      emitted[triangle] = true;
+      meshlet.num_indices += 3;
+      if (meshlet.num_indices / 3 == options_.max_triangles) {
+        break;
+      }
+
+      // Pick the candidate that adds the fewest new vertices. Emitted
+      // candidates are removed along the way.
+      triangle = -1;
+      int best_num_new_vertices = std::numeric_limits<int>::max();
+      const int vertex_budget = options_.max_vertices - meshlet.num_vertices;
+      size_t num_kept = 0;
+      for (uint32_t candidate : candidates) {
+        if (emitted[candidate]) {
+          continue;
+        }
+        candidates[num_kept++] = candidate;
+        int num_new_vertices = 0;
+        for (int corner = 0; corner < 3; ++corner) {
+          const uint32_t vertex = indices[candidate * 3 + corner];
+          num_new_vertices += vertex_meshlets[vertex] != meshlet_index;
+        }
+        if (num_new_vertices <= vertex_budget &&
+            num_new_vertices < best_num_new_vertices) {
+          best_num_new_vertices = num_new_vertices;
+          triangle = candidate;
+        }
+      }
+      candidates.resize(num_kept);
+    }
+
+    ComputeBounds(mesh.indices, positions, &meshlet);
+  }
+
+  return mesh;
+}
+
+MeshletMesh MeshletBuilder::Build(
+    const ModelLoader::MeshData& mesh_data) const {
+  std::vector<glm::vec3> positions;
+  positions.reserve(mesh_data.vertices.size());
+  for (const auto& vertex : mesh_data.vertices) {
+    positions.push_back(vertex.pos);
+  }
+  return Build(mesh_data.indices, positions);
+}
+
+MeshletCuller::MeshletCuller(const Camera& camera, const glm::mat4& model)
+    : frustum_planes_{camera.GetFrustumPlanes(model)},
+      camera_pos_{glm::inverse(model) * glm::vec4{camera.position(), 1.0f}} {}
+
+bool MeshletCuller::IsVisible(const Meshlet& meshlet) const {
+  const glm::vec4 center{meshlet.center, 1.0f};
+  for (const glm::vec4& plane : frustum_planes_) {
+    if (glm::dot(plane, center) < -meshlet.radius) {
+      return false;
+    }
+  }
+
+  // All triangles face away from the camera if the view direction is within
+  // the cone of back-facing directions. This is tested against the bounding
+  // sphere so that it holds for all points within the meshlet.
+  const glm::vec3 view_dir = meshlet.center - camera_pos_;
+  return glm::dot(view_dir, meshlet.cone_axis) <
+         meshlet.cone_cutoff * glm::length(view_dir) + meshlet.radius;
+}
+
+void MeshletCuller::AppendDrawCommands(
+    absl::Span<const Meshlet> meshlets,
+    uint32_t instance_count, uint32_t first_instance,
+    std::vector<DrawIndexedIndirectCommand>* commands) const {
+  bool can_merge = false;
+  for (const Meshlet& meshlet : meshlets) {
+    if (!IsVisible(meshlet)) {
+      can_merge = false;
+      continue;
+    }
+    if (can_merge && commands->back().first_index +
+                         commands->back().index_count == meshlet.first_index) {
+      commands->back().index_count += meshlet.num_indices;
+    } else {
+      commands->push_back({meshlet.num_indices, instance_count,
+                           meshlet.first_index, /*vertex_offset=*/0,
+                           first_instance});
+    }
+    can_merge = true;
+  }
+}
+
+}  // namespace lighter::common
@@ -0,0 +1,127 @@
+//
+//  meshlet.h
+//
+//  Created by Pujun Lun on 6/17/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#ifndef LIGHTER_COMMON_MESHLET_H
+#define LIGHTER_COMMON_MESHLET_H
+
+#include <cstdint>
+#include <vector>
+
+#include "lighter/common/bounds.h"
+#include "lighter/common/camera.h"
+#include "lighter/common/file.h"
+#include "lighter/common/model_loader.h"
+#include "third_party/absl/types/span.h"
+#include "third_party/glm/glm.hpp"
+
+namespace lighter::common {
+
+// Matches the layout of VkDrawIndexedIndirectCommand, so that these can be
+// copied to indirect draw buffers directly.
+struct DrawIndexedIndirectCommand {
+  uint32_t index_count;
+  uint32_t instance_count;
+  uint32_t first_index;
+  int32_t vertex_offset;
+  uint32_t first_instance;
+};
+
+// A cluster of adjacent triangles, with data used for culling.
+struct Meshlet {
+  // Range of indices in MeshletMesh::indices.
+  uint32_t first_index;
+  uint32_t num_indices;
+
+  // Number of unique vertices referenced by this meshlet.
+  uint32_t num_vertices;
+
+  // Bounding sphere.
+  glm::vec3 center;
+  float radius;
+
+  // Normal cone. Normals of all triangles are within the cone around
+  // 'cone_axis', assuming front faces are counter-clockwise. 'cone_cutoff' is the sine of the half angle of the cone, and
+  // it is 1 if the cone is too wide to be useful for culling.
+  glm::vec3 cone_axis;
+  float cone_cutoff;
+};
+
+// A mesh whose triangles are reordered so that each meshlet occupies a
+// contiguous range of indices. Vertices are not changed, hence the vertex
+// buffer of the original mesh can be used directly.
+struct MeshletMesh {
+  std::vector<uint32_t> indices;
+  std::vector<Meshlet> meshlets;
+};
+
+// Builds meshlets and computes culling data.
+class MeshletBuilder {
+ public:
+  // Limits of each meshlet. Defaults are recommended for mesh shaders.
+  struct Options {
+    int max_vertices = 64;
+    int max_triangles = 124;
+  };
+
+  explicit MeshletBuilder(const Options& options) : options_{options} {}
+
+  // This class is neither copyable nor movable.
+  MeshletBuilder(const MeshletBuilder&) = delete;
+  MeshletBuilder& operator=(const MeshletBuilder&) = delete;
+
+  // Splits triangles in 'indices' into meshlets. Each meshlet is grown from a
+  // seed triangle by greedily adding adjacent triangles that share the most
+  // vertices with it, until a limit in 'options_' is reached or there is no
+  // more adjacent triangle. Triangles are best ordered by
+  // mesh_optimizer::OptimizeVertexCache() beforehand, since seeds are picked in
+  // the order of 'indices'.
+  MeshletMesh Build(absl::Span<const uint32_t> indices,
+                    absl::Span<const glm::vec3> positions) const;
+
+  // Convenience function for meshes loaded by ModelLoader.
+  MeshletMesh Build(const ModelLoader::MeshData& mesh_data) const;
+
+ private:
+  // Limits of each meshlet.
+  const Options options_;
+};
+
+// Culls meshlets of a mesh on the CPU. Meshlets are culled if their bounding
+// spheres are outside of the view frustum, or if all of their triangles face
+// away from the camera.
+class MeshletCuller {
+ public:
+  // 'model' transforms the mesh to the world space. It must be invertible, and
+  // should not mirror the mesh, since that would flip the winding order.
+  MeshletCuller(const Camera& camera, const glm::mat4& model);
+
+  // This class is neither copyable nor movable.
+  MeshletCuller(const MeshletCuller&) = delete;
+  MeshletCuller& operator=(const MeshletCuller&) = delete;
+
+  // Returns whether 'meshlet' is potentially visible.
+  bool IsVisible(const Meshlet& meshlet) const;
+
+  // Appends draw commands of meshlets that are potentially visible to
+  // 'commands'. Adjacent visible meshlets are merged into one command. Each
+  // command draws 'instance_count' instances starting from 'first_instance'.
+  void AppendDrawCommands(absl::Span<const Meshlet> meshlets,
+                          uint32_t instance_count, uint32_t first_instance,
+                          std::vector<DrawIndexedIndirectCommand>* commands)
+      const;
+
+ private:
+  // Frustum planes in the object space.
+  const FrustumPlanes frustum_planes_;
+
+  // Camera position in the object space.
+  const glm::vec3 camera_pos_;
+};
+
+}  // namespace lighter::common
+
+#endif  // LIGHTER_COMMON_MESHLET_H
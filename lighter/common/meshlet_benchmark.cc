@@ -0,0 +1,158 @@
+//
+//  meshlet_benchmark.cc
+//
+//  Created by Pujun Lun on 6/17/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include <cmath>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lighter/common/camera.h"
+#include "lighter/common/file.h"
+#include "lighter/common/mesh_optimizer.h"
+#include "lighter/common/meshlet.h"
+#include "lighter/common/util.h"
+#include "third_party/absl/flags/flag.h"
+#include "third_party/absl/flags/parse.h"
+#include "third_party/absl/strings/str_format.h"
+#include "third_party/benchmark/benchmark.h"
+#include "third_party/glm/glm.hpp"
+#include "third_party/glm/gtc/constants.hpp"
+
+ABSL_FLAG(std::string, obj_path, "",
+          "Path to the .obj file to build meshlets for. If not specified, a "
+          "sphere mesh will be generated");
+ABSL_FLAG(int, sphere_resolution, 512,
+          "Number of segments along each of latitude and longitude of the "
+          "generated sphere mesh");
+
+namespace lighter::common {
+namespace {
+
+// Index base used by .obj files.
+constexpr int kObjFileIndexBase = 1;
+
+// Mesh data to build meshlets for.
+struct Mesh {
+  std::vector<uint32_t> indices;
+  std::vector<glm::vec3> positions;
+};
+
+// Returns a unit sphere centered at the origin, whose front faces point
+// outwards.
+Mesh GenerateSphereMesh(int resolution) {
+  Mesh mesh;
+  for (int lat = 0; lat <= resolution; ++lat) {
+    const float theta = glm::pi<float>() * lat / resolution;
+    for (int lon = 0; lon <= resolution; ++lon) {
+      const float phi = glm::two_pi<float>() * lon / resolution;
+      mesh.positions.push_back({std::sin(theta) * std::cos(phi),
+                                std::cos(theta),
+                                -std::sin(theta) * std::sin(phi)});
+    }
+  }
+  for (int lat = 0; lat < resolution; ++lat) {
+    for (int lon = 0; lon < resolution; ++lon) {
+      const uint32_t index = lat * (resolution + 1) + lon;
+      const uint32_t below = index + resolution + 1;
+      mesh.indices.insert(mesh.indices.end(), {index, below, below + 1,
+                                               index, below + 1, index + 1});
+    }
+  }
+  mesh_optimizer::OptimizeVertexCache(absl::MakeSpan(mesh.indices),
+                                      mesh.positions.size());
+  return mesh;
+}
+
+void BM_BuildMeshlets(benchmark::State& state, const Mesh* mesh) {
+  const MeshletBuilder builder{{/*max_vertices=*/static_cast<int>(
+                                    state.range(0)),
+                                /*max_triangles=*/static_cast<int>(
+                                    state.range(1))}};
+  size_t num_meshlets = 0;
+  for (auto _ : state) {
+    const MeshletMesh meshlet_mesh =
+        builder.Build(mesh->indices, mesh->positions);
+    num_meshlets = meshlet_mesh.meshlets.size();
+  }
+  state.counters["meshlets"] = num_meshlets;
+  state.counters["triangles_per_meshlet"] =
+      mesh->indices.size() / 3.0 / num_meshlets;
+  state.counters["triangles"] = benchmark::Counter(
+      mesh->indices.size() / 3, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void BM_CullMeshlets(benchmark::State& state, const Mesh* mesh) {
+  const MeshletBuilder builder{MeshletBuilder::Options{}};
+  const MeshletMesh meshlet_mesh =
+      builder.Build(mesh->indices, mesh->positions);
+
+  // Look at the sphere from outside, so that roughly half of meshlets are
+  // back-facing, and part of the sphere is out of the view frustum.
+  Camera::Config config;
+  config.position = glm::vec3{0.0f, 0.0f, 2.0f};
+  config.look_at = glm::vec3{0.5f, 0.0f, 0.0f};
+  const PerspectiveCamera camera{config, {/*field_of_view_y=*/45.0f,
+                                          /*aspect_ratio=*/1.0f}};
+
+  std::vector<DrawIndexedIndirectCommand> commands;
+  size_t num_visible_indices = 0;
+  for (auto _ : state) {
+    commands.clear();
+    const MeshletCuller culler{camera, glm::mat4{1.0f}};
+    culler.AppendDrawCommands(meshlet_mesh.meshlets, /*instance_count=*/1,
+                              /*first_instance=*/0, &commands);
+    benchmark::DoNotOptimize(commands.data());
+  }
+  for (const auto& command : commands) {
+    num_visible_indices += command.index_count;
+  }
+  state.counters["commands"] = commands.size();
+  state.counters["visible_ratio"] =
+      static_cast<double>(num_visible_indices) / meshlet_mesh.indices.size();
+  state.counters["meshlets"] = benchmark::Counter(
+      meshlet_mesh.meshlets.size(),
+      benchmark::Counter::kIsIterationInvariantRate);
+}
+
+}  // namespace
+}  // namespace lighter::common
+
+int main(int argc, char* argv[]) {
+  using namespace lighter::common;
+
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+
+  Mesh mesh;
+  const std::string obj_path = absl::GetFlag(FLAGS_obj_path);
+  if (obj_path.empty()) {
+    mesh = GenerateSphereMesh(absl::GetFlag(FLAGS_sphere_resolution));
+  } else {
+    ObjFile file{obj_path, kObjFileIndexBase,
+                 util::GetNumHardwareThreads()};
+    mesh.positions.reserve(file.vertices.size());
+    for (const auto& vertex : file.vertices) {
+      mesh.positions.push_back(vertex.pos);
+    }
+    mesh.indices = std::move(file.indices);
+    mesh_optimizer::OptimizeVertexCache(absl::MakeSpan(mesh.indices),
+                                        mesh.positions.size());
+  }
+  LOG_INFO << absl::StreamFormat("Building meshlets for mesh with %d vertices "
+                                 "and %d triangles", mesh.positions.size(),
+                                 mesh.indices.size() / 3);
+
+  // Arguments are the maximum number of vertices and triangles per meshlet.
+  benchmark::RegisterBenchmark("BM_BuildMeshlets", BM_BuildMeshlets, &mesh)
+      ->ArgNames({"max_vertices", "max_triangles"})
+      ->Args({64, 124})->Args({128, 256})
+      ->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark("BM_CullMeshlets", BM_CullMeshlets, &mesh)
+      ->Unit(benchmark::kMicrosecond);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
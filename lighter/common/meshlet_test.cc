@@ -0,0 +1,185 @@
+//
+//  meshlet_test.cc
+//
+//  Created by Pujun Lun on 6/17/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/meshlet.h"
+
+#include <set>
+#include <tuple>
+#include <vector>
+
+#include "lighter/common/camera.h"
+#include "third_party/glm/gtc/matrix_transform.hpp"
+
+#ifdef ASSERT_TRUE
+#undef ASSERT_TRUE
+#endif
+#ifdef ASSERT_FALSE
+#undef ASSERT_FALSE
+#endif
+#include "third_party/gtest/gtest.h"
+
+namespace lighter::common {
+namespace {
+
+using Triangle = std::tuple<uint32_t, uint32_t, uint32_t>;
+
+// A grid on the XY plane facing +Z, with 'size' * 'size' quads in range
+// [-1, 1].
+struct Grid {
+  explicit Grid(int size) {
+    for (int y = 0; y <= size; ++y) {
+      for (int x = 0; x <= size; ++x) {
+        positions.push_back(
+            glm::vec3{glm::vec2{x, y} / (size / 2.0f) - 1.0f, 0.0f});
+      }
+    }
+    for (int y = 0; y < size; ++y) {
+      for (int x = 0; x < size; ++x) {
+        const uint32_t v0 = y * (size + 1) + x;
+        const uint32_t v1 = v0 + 1;
+        const uint32_t v2 = v0 + size + 1;
+        const uint32_t v3 = v2 + 1;
+        indices.insert(indices.end(), {v0, v1, v3, v0, v3, v2});
+      }
+    }
+  }
+
+  std::vector<glm::vec3> positions;
+  std::vector<uint32_t> indices;
+};
+
+std::multiset<Triangle> GetTriangles(absl::Span<const uint32_t> indices) {
+  std::multiset<Triangle> triangles;
+  for (int i = 0; i < indices.size(); i += 3) {
+    triangles.insert({indices[i], indices[i + 1], indices[i + 2]});
+  }
+  return triangles;
+}
+
+PerspectiveCamera CreateCamera(const glm::vec3& position,
+                               const glm::vec3& look_at) {
+  Camera::Config config;
+  config.position = position;
+  config.look_at = look_at;
+  return PerspectiveCamera{config, {/*field_of_view_y=*/45.0f,
+                                    /*aspect_ratio=*/1.0f}};
+}
+
+TEST(MeshletBuilderTest, RespectLimits) {
+  const Grid grid{/*size=*/32};
+  const MeshletBuilder builder{{/*max_vertices=*/32, /*max_triangles=*/40}};
+  const MeshletMesh mesh = builder.Build(grid.indices, grid.positions);
+
+  ASSERT_FALSE(mesh.meshlets.empty());
+  uint32_t next_index = 0;
+  for (const Meshlet& meshlet : mesh.meshlets) {
+    EXPECT_EQ(meshlet.first_index, next_index);
+    EXPECT_GT(meshlet.num_indices, 0);
+    EXPECT_LE(meshlet.num_indices / 3, 40);
+    EXPECT_LE(meshlet.num_vertices, 32);
+
+    const std::set<uint32_t> vertices{
+        mesh.indices.begin() + meshlet.first_index,
+        mesh.indices.begin() + meshlet.first_index + meshlet.num_indices};
+    EXPECT_EQ(vertices.size(), meshlet.num_vertices);
+    next_index += meshlet.num_indices;
+  }
+  EXPECT_EQ(next_index, mesh.indices.size());
+}
+
+TEST(MeshletBuilderTest, PreserveTriangles) {
+  const Grid grid{/*size=*/20};
+  const MeshletBuilder builder{MeshletBuilder::Options{}};
+  const MeshletMesh mesh = builder.Build(grid.indices, grid.positions);
+  EXPECT_EQ(GetTriangles(mesh.indices), GetTriangles(grid.indices));
+}
+
+TEST(MeshletBuilderTest, ComputeBounds) {
+  const Grid grid{/*size=*/20};
+  const MeshletBuilder builder{MeshletBuilder::Options{}};
+  const MeshletMesh mesh = builder.Build(grid.indices, grid.positions);
+
+  for (const Meshlet& meshlet : mesh.meshlets) {
+    for (uint32_t i = 0; i < meshlet.num_indices; ++i) {
+      const glm::vec3& pos =
+          grid.positions[mesh.indices[meshlet.first_index + i]];
+      EXPECT_LE(glm::length(pos - meshlet.center), meshlet.radius + 1e-5f);
+    }
+    // All triangles of a flat grid face +Z.
+    EXPECT_NEAR(meshlet.cone_axis.z, 1.0f, 1e-5f);
+    EXPECT_NEAR(meshlet.cone_cutoff, 0.0f, 1e-3f);
+  }
+}
+
+TEST(MeshletCullerTest, CullBackFacing) {
+  const Grid grid{/*size=*/8};
+  const MeshletBuilder builder{MeshletBuilder::Options{}};
+  const MeshletMesh mesh = builder.Build(grid.indices, grid.positions);
+
+  const auto front_camera = CreateCamera({0.0f, 0.0f, 5.0f}, glm::vec3{0.0f});
+  const MeshletCuller front_culler{front_camera, glm::mat4{1.0f}};
+  for (const Meshlet& meshlet : mesh.meshlets) {
+    EXPECT_TRUE(front_culler.IsVisible(meshlet));
+  }
+
+  const auto back_camera = CreateCamera({0.0f, 0.0f, -5.0f}, glm::vec3{0.0f});
+  const MeshletCuller back_culler{back_camera, glm::mat4{1.0f}};
+  for (const Meshlet& meshlet : mesh.meshlets) {
+    EXPECT_FALSE(back_culler.IsVisible(meshlet));
+  }
+}
+
+TEST(MeshletCullerTest, CullOutsideFrustum) {
+  const Grid grid{/*size=*/8};
+  const MeshletBuilder builder{MeshletBuilder::Options{}};
+  const MeshletMesh mesh = builder.Build(grid.indices, grid.positions);
+
+  // The grid is behind the camera.
+  const auto camera = CreateCamera({0.0f, 0.0f, 5.0f}, {0.0f, 0.0f, 10.0f});
+  const MeshletCuller culler{camera, glm::mat4{1.0f}};
+  for (const Meshlet& meshlet : mesh.meshlets) {
+    EXPECT_FALSE(culler.IsVisible(meshlet));
+  }
+
+  // The grid is moved far away by the model matrix.
+  const auto front_camera = CreateCamera({0.0f, 0.0f, 5.0f}, glm::vec3{0.0f});
+  const glm::mat4 model =
+      glm::translate(glm::mat4{1.0f}, glm::vec3{100.0f, 0.0f, 0.0f});
+  const MeshletCuller model_culler{front_camera, model};
+  for (const Meshlet& meshlet : mesh.meshlets) {
+    EXPECT_FALSE(model_culler.IsVisible(meshlet));
+  }
+}
+
+TEST(MeshletCullerTest, MergeDrawCommands) {
+  const Grid grid{/*size=*/16};
+  const MeshletBuilder builder{{/*max_vertices=*/16, /*max_triangles=*/16}};
+  const MeshletMesh mesh = builder.Build(grid.indices, grid.positions);
+  ASSERT_GT(mesh.meshlets.size(), 1);
+
+  const auto camera = CreateCamera({0.0f, 0.0f, 5.0f}, glm::vec3{0.0f});
+  const MeshletCuller culler{camera, glm::mat4{1.0f}};
+  std::vector<DrawIndexedIndirectCommand> commands;
+  culler.AppendDrawCommands(mesh.meshlets, /*instance_count=*/2,
+                            /*first_instance=*/1, &commands);
+
+  // All meshlets are visible, hence they should be merged into one command.
+  ASSERT_EQ(commands.size(), 1);
+  EXPECT_EQ(commands[0].index_count, mesh.indices.size());
+  EXPECT_EQ(commands[0].instance_count, 2);
+  EXPECT_EQ(commands[0].first_index, 0);
+  EXPECT_EQ(commands[0].vertex_offset, 0);
+  EXPECT_EQ(commands[0].first_instance, 1);
+
+  // Commands appended earlier should not be merged with new ones.
+  culler.AppendDrawCommands(mesh.meshlets, /*instance_count=*/1,
+                            /*first_instance=*/0, &commands);
+  EXPECT_EQ(commands.size(), 2);
+}
+
+}  // namespace
+}  // namespace lighter::common
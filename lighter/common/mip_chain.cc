@@ -0,0 +1,584 @@
+//
+//  mip_chain.cc
+//
+//  Created by Pujun Lun on 6/22/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/mip_chain.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+
+#include "lighter/common/pixel_conversion.h"
+#include "lighter/common/util.h"
+#include "third_party/absl/strings/str_format.h"
+#include "third_party/absl/strings/str_join.h"
+#include "third_party/picosha2/picosha2.h"
+
+#if defined(__AVX2__)
+#define LIGHTER_USE_AVX2
+#include <immintrin.h>
+#endif  // __AVX2__
+
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LIGHTER_USE_SSE
+#include <xmmintrin.h>
+#endif  // __SSE__ || _M_X64 || _M_IX86_FP
+
+namespace lighter::common {
+namespace {
+
+namespace stdfs = std::filesystem;
+
+using Filter = MipChain::Filter;
+
+// "MIPS" in little endian. This also helps detect caches written on platforms
+// of different endianness.
+constexpr uint32_t kMagic = 0x5350494D;
+
+// Must be bumped whenever the layout of cache files or the output of filters
+// changes.
+constexpr uint32_t kVersion = 1;
+
+// Offset of each level is aligned to this, which also satisfies the alignment
+// required for copying data from buffers to images.
+constexpr size_t kLevelAlignment = 16;
+
+// Radius of windowed sinc filters, in texels of the downsampled level.
+constexpr float kSincRadius = 3.0f;
+
+// Shape parameter of the Kaiser window.
+constexpr double kKaiserAlpha = 4.0;
+
+// Downsampling is split into tasks that process at least this number of
+// texels, since the overhead of threads outweighs the benefit for small levels.
+constexpr int kMinTexelsPerTask = 1 << 16;
+
+static_assert(std::tuple_size_v<MipChain::SourceHash> ==
+                  picosha2::k_digest_size,
+              "Unexpected size of SHA256 digest");
+
+// Header of cache files. Levels are stored after 'data_offset' in order, and
+// the offset of each level is aligned to kLevelAlignment.
+struct Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t channel;
+  uint32_t layer;
+  MipChain::SourceHash source_hash;
+  uint64_t data_offset;
+  uint64_t file_size;
+};
+
+// Returns 'offset' rounded up to the next multiple of kLevelAlignment.
+size_t AlignOffset(size_t offset) {
+  return (offset + kLevelAlignment - 1) / kLevelAlignment * kLevelAlignment;
+}
+
+// Returns all levels of an image.
+std::vector<MipChain::Level> ComputeLevels(int width, int height,
+                                           int channel) {
+  const int num_levels = MipChain::GetNumLevels(width, height);
+  std::vector<MipChain::Level> levels;
+  levels.reserve(num_levels);
+  for (int level = 0; level < num_levels; ++level) {
+    levels.push_back({width, height,
+                      static_cast<size_t>(width) * height * channel});
+    width = std::max(width / 2, 1);
+    height = std::max(height / 2, 1);
+  }
+  return levels;
+}
+
+// Returns offsets of 'levels' relative to the beginning of level data, and the
+// total size of level data as the last element.
+std::vector<size_t> ComputeLevelOffsets(
+    absl::Span<const MipChain::Level> levels, int layer) {
+  std::vector<size_t> offsets;
+  offsets.reserve(levels.size() + 1);
+  size_t offset = 0;
+  for (const auto& level : levels) {
+    offsets.push_back(offset);
+    offset = AlignOffset(offset + level.layer_size * layer);
+  }
+  offsets.push_back(offset);
+  return offsets;
+}
+
+// Returns sin(pi * x) / (pi * x).
+double Sinc(double x) {
+  if (std::abs(x) < 1e-6) {
+    return 1.0;
+  }
+  x *= M_PI;
+  return std::sin(x) / x;
+}
+
+// Returns the zeroth order modified Bessel function of the first kind, which is
+// used by the Kaiser window.
+double BesselI0(double x) {
+  double sum = 1.0, term = 1.0;
+  const double quarter_x_squared = x * x / 4.0;
+  for (int k = 1; k < 32 && term > sum * 1e-12; ++k) {
+    term *= quarter_x_squared / (k * k);
+    sum += term;
+  }
+  return sum;
+}
+
+// Returns the radius of 'filter', in texels of the downsampled level.
+float GetFilterRadius(Filter filter) {
+  return filter == Filter::kBox ? 0.5f : kSincRadius;
+}
+
+// Evaluates 'filter' at 'x', which is in texels of the downsampled level.
+double EvaluateFilter(Filter filter, double x) {
+  x = std::abs(x);
+  switch (filter) {
+    case Filter::kBox:
+      // Texels that lie exactly on the boundary are shared by two texels of
+      // the downsampled level.
+      return x < 0.5 ? 1.0 : (x == 0.5 ? 0.5 : 0.0);
+
+    case Filter::kKaiser: {
+      if (x >= kSincRadius) {
+        return 0.0;
+      }
+      const double t = x / kSincRadius;
+      return Sinc(x) * BesselI0(kKaiserAlpha * std::sqrt(1.0 - t * t)) /
+             BesselI0(kKaiserAlpha);
+    }
+
+    case Filter::kLanczos:
+      return x < kSincRadius ? Sinc(x) * Sinc(x / kSincRadius) : 0.0;
+  }
+  FATAL("Unrecognized filter");
+}
+
+// Weights for resampling a line of texels. Each texel of the destination is the
+// weighted sum of 'num_taps' texels of the source. Indices are clamped to the
+// edge, and unused taps have zero weights.
+struct ResampleWeights {
+  ResampleWeights(Filter filter, int src_size, int dst_size) {
+    // The filter is stretched to cover all texels of the source.
+    const double scale = static_cast<double>(src_size) / dst_size;
+    const double support = GetFilterRadius(filter) * scale;
+    num_taps = static_cast<int>(std::floor(support * 2.0)) + 1;
+    indices.resize(static_cast<size_t>(dst_size) * num_taps);
+    weights.resize(indices.size());
+
+    for (int i = 0; i < dst_size; ++i) {
+      const double center = (i + 0.5) * scale;
+      const int first = static_cast<int>(std::ceil(center - support - 0.5));
+      double sum = 0.0;
+      for (int tap = 0; tap < num_taps; ++tap) {
+        const int index = first + tap;
+        const double weight =
+            EvaluateFilter(filter, (index + 0.5 - center) / scale);
+        indices[i * num_taps + tap] = std::clamp(index, 0, src_size - 1);
+        weights[i * num_taps + tap] = static_cast<float>(weight);
+        sum += weight;
+      }
+      for (int tap = 0; tap < num_taps; ++tap) {
+        weights[i * num_taps + tap] /= static_cast<float>(sum);
+      }
+    }
+  }
+
+  int num_taps;
+  std::vector<int> indices;
+  std::vector<float> weights;
+};
+
+// Resamples one row of 'src' horizontally to 'dst'.
+void ResampleRow(const ResampleWeights& weights, int channel, int dst_width,
+                 const float* src, float* dst) {
+  const int num_taps = weights.num_taps;
+#ifdef LIGHTER_USE_SSE
+  // Each texel with 4 channels fits in one register.
+  if (channel == image::kRgbaImageChannel) {
+    for (int x = 0; x < dst_width; ++x) {
+      const int* indices = &weights.indices[x * num_taps];
+      const float* tap_weights = &weights.weights[x * num_taps];
+      __m128 sum = _mm_setzero_ps();
+      for (int tap = 0; tap < num_taps; ++tap) {
+        sum = _mm_add_ps(sum,
+                         _mm_mul_ps(_mm_set1_ps(tap_weights[tap]),
+                                    _mm_loadu_ps(src + indices[tap] * 4)));
+      }
+      _mm_storeu_ps(dst + x * 4, sum);
+    }
+    return;
+  }
+#endif  // LIGHTER_USE_SSE
+
+  for (int x = 0; x < dst_width; ++x) {
+    const int* indices = &weights.indices[x * num_taps];
+    const float* tap_weights = &weights.weights[x * num_taps];
+    for (int c = 0; c < channel; ++c) {
+      float sum = 0.0f;
+      for (int tap = 0; tap < num_taps; ++tap) {
+        sum += tap_weights[tap] * src[indices[tap] * channel + c];
+      }
+      dst[x * channel + c] = sum;
+    }
+  }
+}
+
+// Resamples row 'y' of the destination vertically from 'src', where each row
+// has 'row_length' floats. Results are clamped to [0, 1], so that ringing of
+// sinc filters does not accumulate over levels.
+void ResampleColumn(const ResampleWeights& weights, int y, int row_length,
+                    const float* src, float* dst) {
+  const int num_taps = weights.num_taps;
+  const int* indices = &weights.indices[y * num_taps];
+  const float* tap_weights = &weights.weights[y * num_taps];
+
+  int begin = 0;
+#ifdef LIGHTER_USE_AVX2
+  const __m256 zero_256 = _mm256_setzero_ps();
+  const __m256 one_256 = _mm256_set1_ps(1.0f);
+  for (; begin + 8 <= row_length; begin += 8) {
+    __m256 sum = _mm256_setzero_ps();
+    for (int tap = 0; tap < num_taps; ++tap) {
+      const float* row = src + static_cast<size_t>(indices[tap]) * row_length;
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(tap_weights[tap]),
+                                             _mm256_loadu_ps(row + begin)));
+    }
+    _mm256_storeu_ps(dst + begin,
+                     _mm256_min_ps(_mm256_max_ps(sum, zero_256), one_256));
+  }
+#endif  // LIGHTER_USE_AVX2
+
+#ifdef LIGHTER_USE_SSE
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  for (; begin + 4 <= row_length; begin += 4) {
+    __m128 sum = _mm_setzero_ps();
+    for (int tap = 0; tap < num_taps; ++tap) {
+      const float* row = src + static_cast<size_t>(indices[tap]) * row_length;
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(tap_weights[tap]),
+                                       _mm_loadu_ps(row + begin)));
+    }
+    _mm_storeu_ps(dst + begin, _mm_min_ps(_mm_max_ps(sum, zero), one));
+  }
+#endif  // LIGHTER_USE_SSE
+
+  for (int i = begin; i < row_length; ++i) {
+    float sum = 0.0f;
+    for (int tap = 0; tap < num_taps; ++tap) {
+      sum += tap_weights[tap] *
+             src[static_cast<size_t>(indices[tap]) * row_length + i];
+    }
+    dst[i] = std::clamp(sum, 0.0f, 1.0f);
+  }
+}
+
+// Splits 'num_rows' rows into tasks and runs them in parallel. 'row_length' is
+// the number of floats in each row. 'process' is called with the range of
+// rows to process.
+void ParallelForRows(int num_rows, int row_length,
+                     const std::function<void(int, int)>& process) {
+  const int max_num_tasks = std::max(
+      static_cast<int>(static_cast<int64_t>(num_rows) * row_length /
+                       kMinTexelsPerTask), 1);
+  const int num_tasks = std::min({max_num_tasks, num_rows,
+                                  util::GetNumHardwareThreads()});
+  const int rows_per_task = (num_rows + num_tasks - 1) / num_tasks;
+  util::ParallelFor(num_tasks, [&](int task) {
+    const int begin = task * rows_per_task;
+    process(begin, std::min(begin + rows_per_task, num_rows));
+  });
+}
+
+// Converts 8-bit texels to floats in linear space.
+void ConvertToLinear(const MipChain::Options& options, int channel,
+                     int num_texels, const uint8_t* src, float* dst) {
+  if (options.is_srgb) {
+    pixel_conversion::SrgbToLinear(src, num_texels, channel, dst);
+  } else {
+    pixel_conversion::Unorm8ToFloat(src, num_texels * channel, dst);
+  }
+}
+
+// Converts floats in linear space back to 8-bit texels.
+void ConvertFromLinear(const MipChain::Options& options, int channel,
+                       int num_texels, const float* src, uint8_t* dst) {
+  if (options.is_srgb) {
+    pixel_conversion::LinearToSrgb(src, num_texels, channel, dst);
+  } else {
+    pixel_conversion::FloatToUnorm8(src, num_texels * channel, dst);
+  }
+}
+
+// Downsamples one layer of 'src_level' stored in 'src' to 'dst_level'.
+// Results are stored in 'dst' as floats and in 'dst_bytes' as 8-bit texels.
+// 'temp' must be large enough to hold the result of the horizontal pass.
+void Downsample(const MipChain::Options& options, int channel,
+                const MipChain::Level& src_level,
+                const MipChain::Level& dst_level,
+                const float* src, float* temp, float* dst,
+                uint8_t* dst_bytes) {
+  const ResampleWeights horizontal_weights{options.filter, src_level.width,
+                                           dst_level.width};
+  const ResampleWeights vertical_weights{options.filter, src_level.height,
+                                         dst_level.height};
+  const int src_row_length = src_level.width * channel;
+  const int dst_row_length = dst_level.width * channel;
+
+  ParallelForRows(src_level.height, dst_row_length, [&](int begin, int end) {
+    for (int y = begin; y < end; ++y) {
+      ResampleRow(horizontal_weights, channel, dst_level.width,
+                  src + static_cast<size_t>(y) * src_row_length,
+                  temp + static_cast<size_t>(y) * dst_row_length);
+    }
+  });
+  ParallelForRows(dst_level.height, dst_row_length, [&](int begin, int end) {
+    for (int y = begin; y < end; ++y) {
+      const size_t offset = static_cast<size_t>(y) * dst_row_length;
+      ResampleColumn(vertical_weights, y, dst_row_length, temp, dst + offset);
+      ConvertFromLinear(options, channel, dst_level.width, dst + offset,
+                        dst_bytes + offset);
+    }
+  });
+}
+
+}  // namespace
+
+int MipChain::GetNumLevels(int width, int height) {
+  int num_levels = 1;
+  for (int size = std::max(width, height); size > 1; size /= 2) {
+    ++num_levels;
+  }
+  return num_levels;
+}
+
+std::unique_ptr<MipChain> MipChain::LoadImageFiles(
+    absl::Span<const std::string> paths, const Options& options) {
+  const SourceHash source_hash = ComputeSourceHash(paths, options);
+  const std::string cache_path = GetDefaultCachePath(paths);
+  if (auto mip_chain = LoadFromFile(cache_path, source_hash)) {
+    return mip_chain;
+  }
+
+  LOG_INFO << absl::StreamFormat("Generating mip chain for '%s'", paths[0]);
+  const Image image{paths};
+  auto mip_chain = Generate(image, options, source_hash);
+  mip_chain->WriteToFile(cache_path);
+  return mip_chain;
+}
+
+MipChain::SourceHash MipChain::ComputeSourceHash(
+    absl::Span<const std::string> source_paths, const Options& options) {
+  picosha2::hash256_one_by_one hasher;
+  for (const auto& path : source_paths) {
+    const RawData source_data{path, RawData::Mode::kMemoryMapped};
+    hasher.process(source_data.data, source_data.data + source_data.size);
+  }
+  const std::string options_string =
+      absl::StrFormat("MipChain filter=%d srgb=%d",
+                      static_cast<int>(options.filter), options.is_srgb);
+  hasher.process(options_string.begin(), options_string.end());
+  hasher.finish();
+
+  SourceHash hash;
+  hasher.get_hash_bytes(hash.begin(), hash.end());
+  return hash;
+}
+
+std::string MipChain::GetDefaultCachePath(
+    absl::Span<const std::string> source_paths) {
+  // Different source files may have the same name, hence we also append the
+  // hash of absolute paths.
+  std::vector<std::string> absolute_paths;
+  absolute_paths.reserve(source_paths.size());
+  for (const auto& path : source_paths) {
+    absolute_paths.push_back(stdfs::absolute(path).string());
+  }
+  const std::string path_hash =
+      picosha2::hash256_hex_string(absl::StrJoin(absolute_paths, "\n"));
+  const stdfs::path cache_path =
+      stdfs::temp_directory_path() / "lighter" / "mip_cache" /
+      absl::StrFormat("%s.%s.mips",
+                      stdfs::path{source_paths[0]}.filename().string(),
+                      path_hash.substr(/*pos=*/0, /*n=*/16));
+  return cache_path.string();
+}
+
+std::unique_ptr<MipChain> MipChain::LoadFromFile(
+    std::string_view cache_path, const SourceHash& source_hash) {
+  std::error_code error_code;
+  if (!stdfs::is_regular_file(cache_path, error_code)) {
+    return nullptr;
+  }
+
+  std::unique_ptr<MipChain> mip_chain{new MipChain};
+  mip_chain->file_data_ =
+      std::make_unique<RawData>(cache_path, RawData::Mode::kMemoryMapped);
+  if (!mip_chain->Parse(mip_chain->file_data_->GetSpan(), source_hash)) {
+    LOG_INFO << absl::StreamFormat("Mip chain cache '%s' is stale", cache_path);
+    return nullptr;
+  }
+  return mip_chain;
+}
+
+std::unique_ptr<MipChain> MipChain::Generate(const Image& image,
+                                             const Options& options,
+                                             const SourceHash& source_hash) {
+  return Generate(image.dimension(), image.data_ptrs(), options, source_hash);
+}
+
+std::unique_ptr<MipChain> MipChain::Generate(
+    const Image::Dimension& dimension,
+    absl::Span<const void* const> layer_datas, const Options& options,
+    const SourceHash& source_hash) {
+  const int channel = dimension.channel;
+  const int layer = static_cast<int>(layer_datas.size());
+  ASSERT_TRUE(channel == image::kBwImageChannel
+                  || channel == image::kRgbaImageChannel,
+              absl::StrFormat("Unsupported number of channels: %d", channel));
+  ASSERT_TRUE(layer == image::kSingleImageLayer
+                  || layer == image::kCubemapImageLayer,
+              absl::StrFormat("Unsupported number of images: %d", layer));
+
+  const std::vector<Level> levels =
+      ComputeLevels(dimension.width, dimension.height, channel);
+  const std::vector<size_t> offsets = ComputeLevelOffsets(levels, layer);
+
+  Header header{};
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.width = dimension.width;
+  header.height = dimension.height;
+  header.channel = channel;
+  header.layer = layer;
+  header.source_hash = source_hash;
+  header.data_offset = AlignOffset(sizeof(Header));
+  header.file_size = header.data_offset + offsets.back();
+
+  // Paddings between levels are zero.
+  std::unique_ptr<MipChain> mip_chain{new MipChain};
+  std::vector<char>& buffer = mip_chain->buffer_;
+  buffer.resize(header.file_size);
+  std::memcpy(buffer.data(), &header, sizeof(header));
+  const auto get_level_data = [&](int level, int layer_index) {
+    return reinterpret_cast<uint8_t*>(buffer.data()) + header.data_offset +
+           offsets[level] + levels[level].layer_size * layer_index;
+  };
+
+  // The first level is copied as is. Each following level is downsampled from
+  // the previous level in linear space, which avoids accumulating errors of
+  // quantization.
+  std::vector<float> src, dst, temp;
+  if (levels.size() > 1) {
+    src.resize(levels[0].width * levels[0].height * channel);
+    dst.resize(levels[1].width * levels[1].height * channel);
+    temp.resize(levels[1].width * levels[0].height * channel);
+  }
+  for (int layer_index = 0; layer_index < layer; ++layer_index) {
+    const auto* layer_data = static_cast<const uint8_t*>(
+        layer_datas[layer_index]);
+    std::memcpy(get_level_data(/*level=*/0, layer_index), layer_data,
+                levels[0].layer_size);
+    if (levels.size() == 1) {
+      continue;
+    }
+
+    ConvertToLinear(options, channel, levels[0].width * levels[0].height,
+                    layer_data, src.data());
+    for (int level = 1; level < levels.size(); ++level) {
+      Downsample(options, channel, levels[level - 1], levels[level],
+                 src.data(), temp.data(), dst.data(),
+                 get_level_data(level, layer_index));
+      std::swap(src, dst);
+    }
+    // 'src' may hold the smaller buffer after swapping.
+    src.resize(levels[0].width * levels[0].height * channel);
+  }
+
+  ASSERT_TRUE(mip_chain->Parse(buffer, source_hash),
+              "Failed to parse the mip chain just generated");
+  return mip_chain;
+}
+
+bool MipChain::WriteToFile(std::string_view cache_path) const {
+  // Caching is only an optimization, hence we don't throw exceptions here.
+  const stdfs::path path{cache_path};
+  const stdfs::path temp_path = path.string() + ".tmp";
+  std::error_code error_code;
+  stdfs::create_directories(path.parent_path(), error_code);
+  {
+    std::ofstream file{temp_path,
+                       std::ios::out | std::ios::binary | std::ios::trunc};
+    if (file) {
+      file.write(data_.data(), data_.size());
+    }
+    if (!file) {
+      LOG_ERROR << absl::StreamFormat("Failed to write mip chain cache '%s'",
+                                      temp_path.string());
+      return false;
+    }
+  }
+  stdfs::rename(temp_path, path, error_code);
+  if (error_code) {
+    LOG_ERROR << absl::StreamFormat("Failed to rename '%s' to '%s': %s",
+                                    temp_path.string(), path.string(),
+                                    error_code.message());
+    stdfs::remove(temp_path, error_code);
+    return false;
+  }
+  return true;
+}
+
+bool MipChain::Parse(absl::Span<const char> data,
+                     const SourceHash& source_hash) {
+  if (data.size() < sizeof(Header)) {
+    return false;
+  }
+  Header header;
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != kMagic || header.version != kVersion ||
+      header.source_hash != source_hash || header.file_size != data.size() ||
+      header.width == 0 || header.height == 0 ||
+      (header.channel != image::kBwImageChannel &&
+       header.channel != image::kRgbaImageChannel) ||
+      (header.layer != image::kSingleImageLayer &&
+       header.layer != image::kCubemapImageLayer)) {
+    return false;
+  }
+
+  std::vector<Level> levels =
+      ComputeLevels(header.width, header.height, header.channel);
+  const std::vector<size_t> offsets = ComputeLevelOffsets(levels,
+                                                          header.layer);
+  if (header.data_offset != AlignOffset(sizeof(Header)) ||
+      header.file_size != header.data_offset + offsets.back()) {
+    return false;
+  }
+
+  std::vector<const void*> data_ptrs;
+  data_ptrs.reserve(levels.size() * header.layer);
+  for (int level = 0; level < levels.size(); ++level) {
+    for (int layer = 0; layer < header.layer; ++layer) {
+      data_ptrs.push_back(data.data() + header.data_offset + offsets[level] +
+                          levels[level].layer_size * layer);
+    }
+  }
+
+  data_ = data;
+  channel_ = header.channel;
+  layer_ = header.layer;
+  levels_ = std::move(levels);
+  data_ptrs_ = std::move(data_ptrs);
+  return true;
+}
+
+}  // namespace lighter::common
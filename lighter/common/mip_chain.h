@@ -0,0 +1,149 @@
+//
+//  mip_chain.h
+//
+//  Created by Pujun Lun on 6/22/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#ifndef LIGHTER_COMMON_MIP_CHAIN_H
+#define LIGHTER_COMMON_MIP_CHAIN_H
+
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lighter/common/file.h"
+#include "lighter/common/image.h"
+#include "third_party/absl/types/span.h"
+
+namespace lighter::common {
+
+// Mip chain of an 8-bit image generated on the CPU, so that all levels can be
+// uploaded to the device at once. Levels are generated by resampling the
+// previous level with separable filters, and the extent of each level is half
+// of the previous one (rounded down, at least 1), down to 1x1.
+// All levels of all layers are stored in one contiguous blob, ordered by level
+// and then by layer, which can be written to and memory mapped from cache
+// files. Each cache file records the hash of its source, and it will be
+// treated as stale if the source or options change.
+class MipChain {
+ public:
+  // SHA256 of source files and options used for generating the mip chain.
+  using SourceHash = std::array<unsigned char, 32>;
+
+  // Filters used for downsampling. kBox averages texels covered by each
+  // texel of the next level. kKaiser and kLanczos are windowed sinc filters
+  // with a radius of 3 texels, which keep images sharper.
+  enum class Filter { kBox, kKaiser, kLanczos };
+
+  struct Options {
+    Filter filter = Filter::kKaiser;
+
+    // If true, color channels are treated as sRGB encoded and filtered in
+    // linear space. The last channel of 4-channel images is treated as alpha,
+    // which is always linear. This should only be set for images that hold
+    // colors, such as diffuse textures, but not for data such as normals or
+    // specular intensities.
+    bool is_srgb = false;
+  };
+
+  // Describes one level. 'layer_size' is the size of data of each layer in
+  // bytes, which are tightly packed.
+  struct Level {
+    int width;
+    int height;
+    size_t layer_size;
+  };
+
+  // Returns the number of levels of the full mip chain of an image.
+  static int GetNumLevels(int width, int height);
+
+  // Loads images from files with common::Image and generates the mip chain, or
+  // loads it from the cache if it is up-to-date. 'paths' has the same
+  // requirement as the constructor of common::Image.
+  static std::unique_ptr<MipChain> LoadImageFiles(
+      absl::Span<const std::string> paths, const Options& options);
+
+  // Returns the hash of files at 'source_paths' and 'options'.
+  static SourceHash ComputeSourceHash(
+      absl::Span<const std::string> source_paths, const Options& options);
+
+  // Returns the default path to the cache file of 'source_paths', which is
+  // located in the temporary directory.
+  static std::string GetDefaultCachePath(
+      absl::Span<const std::string> source_paths);
+
+  // Loads the mip chain from the cache file at 'cache_path'. Returns nullptr if
+  // the file does not exist, or it is not valid for the source with
+  // 'source_hash'.
+  static std::unique_ptr<MipChain> LoadFromFile(std::string_view cache_path,
+                                                const SourceHash& source_hash);
+
+  // Generates the mip chain of 'image', or of images described by 'dimension'
+  // and 'layer_datas'. Only 1 or 4 channels are supported. Data is copied,
+  // hence the source doesn't need to outlive the returned object.
+  // Downsampling is parallelized over rows of each level.
+  static std::unique_ptr<MipChain> Generate(
+      const Image& image, const Options& options,
+      const SourceHash& source_hash = {});
+  static std::unique_ptr<MipChain> Generate(
+      const Image::Dimension& dimension,
+      absl::Span<const void* const> layer_datas, const Options& options,
+      const SourceHash& source_hash = {});
+
+  // This class is neither copyable nor movable.
+  MipChain(const MipChain&) = delete;
+  MipChain& operator=(const MipChain&) = delete;
+
+  // Writes the mip chain to 'cache_path'. The file is first written to a
+  // temporary path and then renamed, so readers never see a partially written
+  // file. Returns false if failed, in which case the cache file is left
+  // unchanged.
+  bool WriteToFile(std::string_view cache_path) const;
+
+  // Returns the pointer to data of 'layer' of 'level'.
+  const void* GetData(int level, int layer) const {
+    return data_ptrs_[level * this->layer() + layer];
+  }
+
+  // Accessors.
+  int width() const { return levels_[0].width; }
+  int height() const { return levels_[0].height; }
+  int channel() const { return channel_; }
+  int layer() const { return layer_; }
+  int num_levels() const { return static_cast<int>(levels_.size()); }
+  const std::vector<Level>& levels() const { return levels_; }
+  // Pointers to data of each layer of each level, ordered by level and then by
+  // layer.
+  const std::vector<const void*>& data_ptrs() const { return data_ptrs_; }
+
+ private:
+  // Interprets 'data' as the content of a cache file. Returns false if it is
+  // malformed or not valid for the source with 'source_hash'.
+  bool Parse(absl::Span<const char> data, const SourceHash& source_hash);
+
+  MipChain() = default;
+
+  // Holds the content of the cache file if loaded from disk.
+  std::unique_ptr<RawData> file_data_;
+
+  // Holds the content of the cache file if generated in memory.
+  std::vector<char> buffer_;
+
+  // Content of the cache file, pointing to either 'file_data_' or 'buffer_'.
+  absl::Span<const char> data_;
+
+  // Number of channels and layers.
+  int channel_ = 0;
+  int layer_ = 0;
+
+  // Views into 'data_'.
+  std::vector<Level> levels_;
+  std::vector<const void*> data_ptrs_;
+};
+
+}  // namespace lighter::common
+
+#endif  // LIGHTER_COMMON_MIP_CHAIN_H
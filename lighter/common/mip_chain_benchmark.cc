@@ -0,0 +1,82 @@
+//
+//  mip_chain_benchmark.cc
+//
+//  Created by Pujun Lun on 6/22/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include <random>
+#include <vector>
+
+#include "lighter/common/image.h"
+#include "lighter/common/mip_chain.h"
+#include "third_party/absl/flags/flag.h"
+#include "third_party/absl/flags/parse.h"
+#include "third_party/absl/strings/str_cat.h"
+#include "third_party/benchmark/benchmark.h"
+
+ABSL_FLAG(int, image_size, 2048, "Width and height of the image");
+
+namespace lighter::common {
+namespace {
+
+// Square RGBA image filled with random texels.
+struct RandomImage {
+  explicit RandomImage(int size)
+      : dimension{size, size, image::kRgbaImageChannel,
+                  image::kSingleImageLayer} {
+    std::mt19937 rand_gen{/*seed=*/0};
+    std::uniform_int_distribution<int> dist{0, 255};
+    pixels.resize(size * size * image::kRgbaImageChannel);
+    for (uint8_t& value : pixels) {
+      value = static_cast<uint8_t>(dist(rand_gen));
+    }
+  }
+
+  Image::Dimension dimension;
+  std::vector<uint8_t> pixels;
+};
+
+void BM_GenerateMipChain(benchmark::State& state, const RandomImage* image,
+                         MipChain::Options options) {
+  const void* data = image->pixels.data();
+  for (auto _ : state) {
+    const auto mip_chain = MipChain::Generate(image->dimension, {&data, 1},
+                                              options);
+    benchmark::DoNotOptimize(mip_chain->data_ptrs().data());
+  }
+  state.SetItemsProcessed(state.iterations() * image->dimension.width *
+                          image->dimension.height);
+}
+
+}  // namespace
+}  // namespace lighter::common
+
+int main(int argc, char* argv[]) {
+  using namespace lighter::common;
+
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+
+  const RandomImage image{absl::GetFlag(FLAGS_image_size)};
+  const struct {
+    const char* name;
+    MipChain::Filter filter;
+  } filters[]{
+      {"Box", MipChain::Filter::kBox},
+      {"Kaiser", MipChain::Filter::kKaiser},
+      {"Lanczos", MipChain::Filter::kLanczos},
+  };
+  for (const auto& [name, filter] : filters) {
+    for (const bool is_srgb : {false, true}) {
+      benchmark::RegisterBenchmark(
+          absl::StrCat("BM_GenerateMipChain/", name,
+                       is_srgb ? "/Srgb" : "/Linear").c_str(),
+          BM_GenerateMipChain, &image, MipChain::Options{filter, is_srgb})
+          ->Unit(benchmark::kMillisecond)
+          ->UseRealTime();
+    }
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
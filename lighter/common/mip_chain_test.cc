@@ -0,0 +1,159 @@
+//
+//  mip_chain_test.cc
+//
+//  Created by Pujun Lun on 6/22/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/mip_chain.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include "lighter/common/image.h"
+
+#ifdef ASSERT_TRUE
+#undef ASSERT_TRUE
+#endif
+#ifdef ASSERT_FALSE
+#undef ASSERT_FALSE
+#endif
+#include "third_party/gtest/gtest.h"
+
+namespace lighter::common {
+namespace {
+
+constexpr MipChain::Filter kFilters[]{
+    MipChain::Filter::kBox, MipChain::Filter::kKaiser,
+    MipChain::Filter::kLanczos};
+
+// Returns the texel at ('x', 'y') of 'layer' of 'level'.
+const uint8_t* GetTexel(const MipChain& mip_chain, int level, int layer,
+                        int x, int y) {
+  const auto& extent = mip_chain.levels()[level];
+  return static_cast<const uint8_t*>(mip_chain.GetData(level, layer)) +
+         (y * extent.width + x) * mip_chain.channel();
+}
+
+TEST(MipChainTest, LevelExtents) {
+  EXPECT_EQ(MipChain::GetNumLevels(1, 1), 1);
+  EXPECT_EQ(MipChain::GetNumLevels(256, 256), 9);
+  EXPECT_EQ(MipChain::GetNumLevels(300, 7), 9);
+
+  const std::vector<uint8_t> pixels(300 * 7, 0);
+  const auto mip_chain = MipChain::Generate(
+      Image::Dimension{300, 7, image::kBwImageChannel, /*layer=*/1},
+      {pixels.data()}, MipChain::Options{});
+  ASSERT_EQ(mip_chain->num_levels(), 9);
+  const std::pair<int, int> expected_extents[]{
+      {300, 7}, {150, 3}, {75, 1}, {37, 1}, {18, 1}, {9, 1}, {4, 1}, {2, 1},
+      {1, 1}};
+  for (int level = 0; level < mip_chain->num_levels(); ++level) {
+    const auto& extent = mip_chain->levels()[level];
+    EXPECT_EQ(extent.width, expected_extents[level].first);
+    EXPECT_EQ(extent.height, expected_extents[level].second);
+    EXPECT_EQ(extent.layer_size, extent.width * extent.height);
+    // Levels must be aligned for copying to images.
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(mip_chain->GetData(level, 0)) % 4,
+              0);
+  }
+}
+
+TEST(MipChainTest, ConstantImageStaysConstant) {
+  constexpr int kWidth = 37, kHeight = 20;
+  const uint8_t texel[]{200, 10, 97, 128};
+  std::vector<uint8_t> pixels;
+  for (int i = 0; i < kWidth * kHeight; ++i) {
+    pixels.insert(pixels.end(), std::begin(texel), std::end(texel));
+  }
+  for (const auto filter : kFilters) {
+    const auto mip_chain = MipChain::Generate(
+        Image::Dimension{kWidth, kHeight, image::kRgbaImageChannel, 1},
+        {pixels.data()}, MipChain::Options{filter, /*is_srgb=*/true});
+    for (int level = 0; level < mip_chain->num_levels(); ++level) {
+      const auto& extent = mip_chain->levels()[level];
+      for (int y = 0; y < extent.height; ++y) {
+        for (int x = 0; x < extent.width; ++x) {
+          ASSERT_EQ(std::memcmp(GetTexel(*mip_chain, level, 0, x, y), texel,
+                                sizeof(texel)), 0)
+              << "Filter " << static_cast<int>(filter) << " level " << level;
+        }
+      }
+    }
+  }
+}
+
+TEST(MipChainTest, BoxFilterIsGammaCorrect) {
+  // Black and white stripes with alpha 0 and 255.
+  constexpr int kSize = 4;
+  std::vector<uint8_t> pixels;
+  for (int y = 0; y < kSize; ++y) {
+    for (int x = 0; x < kSize; ++x) {
+      const uint8_t value = x % 2 == 0 ? 0 : 255;
+      pixels.insert(pixels.end(), {value, value, value, value});
+    }
+  }
+
+  const MipChain::Options srgb_options{MipChain::Filter::kBox,
+                                       /*is_srgb=*/true};
+  const auto srgb_mip_chain = MipChain::Generate(
+      Image::Dimension{kSize, kSize, image::kRgbaImageChannel, 1},
+      {pixels.data()}, srgb_options);
+  // Linear 0.5 is encoded as 188 in sRGB, while alpha stays linear.
+  const uint8_t* texel = GetTexel(*srgb_mip_chain, /*level=*/1, 0, 0, 0);
+  EXPECT_EQ(texel[0], 188);
+  EXPECT_EQ(texel[3], 128);
+
+  const MipChain::Options linear_options{MipChain::Filter::kBox,
+                                         /*is_srgb=*/false};
+  const auto linear_mip_chain = MipChain::Generate(
+      Image::Dimension{kSize, kSize, image::kRgbaImageChannel, 1},
+      {pixels.data()}, linear_options);
+  texel = GetTexel(*linear_mip_chain, /*level=*/1, 0, 0, 0);
+  EXPECT_EQ(texel[0], 128);
+  EXPECT_EQ(texel[3], 128);
+}
+
+TEST(MipChainTest, CacheRoundTrip) {
+  constexpr int kSize = 16;
+  std::vector<std::vector<uint8_t>> layers;
+  std::vector<const void*> layer_datas;
+  for (int layer = 0; layer < image::kCubemapImageLayer; ++layer) {
+    auto& pixels = layers.emplace_back();
+    for (int i = 0; i < kSize * kSize; ++i) {
+      pixels.push_back(static_cast<uint8_t>(i * (layer + 1)));
+    }
+    layer_datas.push_back(pixels.data());
+  }
+
+  const MipChain::SourceHash source_hash{1, 2, 3};
+  const auto mip_chain = MipChain::Generate(
+      Image::Dimension{kSize, kSize, image::kBwImageChannel,
+                       image::kCubemapImageLayer},
+      layer_datas, MipChain::Options{}, source_hash);
+  const std::string cache_path =
+      (std::filesystem::temp_directory_path() / "mip_chain_test.mips")
+          .string();
+  ASSERT_TRUE(mip_chain->WriteToFile(cache_path));
+
+  EXPECT_EQ(MipChain::LoadFromFile(cache_path, /*source_hash=*/{}), nullptr);
+  const auto loaded = MipChain::LoadFromFile(cache_path, source_hash);
+  ASSERT_NE(loaded, nullptr);
+  ASSERT_EQ(loaded->num_levels(), mip_chain->num_levels());
+  EXPECT_EQ(loaded->layer(), image::kCubemapImageLayer);
+  for (int level = 0; level < loaded->num_levels(); ++level) {
+    for (int layer = 0; layer < loaded->layer(); ++layer) {
+      EXPECT_EQ(std::memcmp(loaded->GetData(level, layer),
+                            mip_chain->GetData(level, layer),
+                            loaded->levels()[level].layer_size), 0);
+    }
+  }
+  EXPECT_EQ(std::memcmp(loaded->GetData(0, 2), layers[2].data(),
+                        layers[2].size()), 0);
+  std::filesystem::remove(cache_path);
+}
+
+}  // namespace
+}  // namespace lighter::common
@@ -7,6 +7,7 @@
 
 #include "lighter/common/model_loader.h"
 
+#include "lighter/common/mesh_optimizer.h"
 #include "lighter/common/util.h"
 #include "third_party/absl/strings/str_format.h"
 #include "third_party/assimp/Importer.hpp"
@@ -33,7 +34,8 @@ aiTextureType TextureTypeToAssimpType(ModelLoader::TextureType type) {
 }  // namespace
 
 ModelLoader::ModelLoader(const std::string& model_path,
-                         const std::string& texture_dir) {
+                         const std::string& texture_dir,
+                         bool optimize_meshes) {
   constexpr unsigned int flags = aiProcess_Triangulate
                                      | aiProcess_GenNormals
                                      | aiProcess_PreTransformVertices
@@ -47,6 +49,14 @@ ModelLoader::ModelLoader(const std::string& model_path,
                                importer.GetErrorString()));
 
   ProcessNode(texture_dir, scene->mRootNode, scene);
+
+  if (optimize_meshes) {
+    const mesh_optimizer::Options options{.optimize_overdraw = true};
+    for (MeshData& mesh_data : mesh_datas_) {
+      mesh_optimizer::OptimizeMesh(options, mesh_data.indices,
+                                   mesh_data.vertices);
+    }
+  }
 }
 
 void ModelLoader::ProcessNode(const std::string& directory,
@@ -102,7 +112,9 @@ ModelLoader::MeshData ModelLoader::LoadMesh(const std::string& directory,
     LoadTextures(directory, material, TextureType::kReflection, &textures);
   }
 
-  return MeshData{std::move(vertices), std::move(indices), std::move(textures)};
+  const Aabb bounds = Aabb::FromVertices<Vertex3DWithTex>(vertices);
+  return MeshData{std::move(vertices), std::move(indices), bounds,
+                  std::move(textures)};
 }
 
 void ModelLoader::LoadTextures(const std::string& directory,
@@ -51,13 +51,19 @@ class ModelLoader {
     std::vector<Vertex3DWithTex> vertices;
     std::vector<uint32_t> indices;
 
+    // Bounding box of 'vertices'.
+    Aabb bounds;
+
     // Textures information of the mesh.
     std::vector<TextureInfo> textures;
   };
 
   // Loads the model from 'model_path' and textures from 'texture_dir', assuming
-  // all textures are in the same directory.
-  ModelLoader(const std::string& model_path, const std::string& texture_dir);
+  // all textures are in the same directory. If 'optimize_meshes' is true,
+  // triangles and vertices of each mesh will be reordered for rendering
+  // efficiency. See mesh_optimizer::OptimizeMesh().
+  ModelLoader(const std::string& model_path, const std::string& texture_dir,
+              bool optimize_meshes = false);
 
   // This class is neither copyable nor movable.
   ModelLoader(const ModelLoader&) = delete;
@@ -0,0 +1,305 @@
+//
+//  obj_file_benchmark.cc
+//
+//  Created by Pujun Lun on 6/13/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "lighter/common/file.h"
+#include "lighter/common/util.h"
+#include "third_party/absl/container/flat_hash_map.h"
+#include "third_party/absl/flags/flag.h"
+#include "third_party/absl/flags/parse.h"
+#include "third_party/absl/strings/str_format.h"
+#include "third_party/absl/strings/str_split.h"
+#include "third_party/benchmark/benchmark.h"
+#include "third_party/glm/glm.hpp"
+
+ABSL_FLAG(std::string, obj_path, "",
+          "Path to the .obj file to load. If not specified, a grid mesh will "
+          "be generated");
+ABSL_FLAG(int, grid_size, 512,
+          "Number of vertices on each side of the generated grid mesh");
+
+namespace lighter::common {
+namespace {
+
+namespace stdfs = std::filesystem;
+
+// Index base used by .obj files.
+constexpr int kObjFileIndexBase = 1;
+
+// The previous implementation of ObjFile, which reads the file line by line and
+// splits each line into strings. This is only kept for comparison.
+struct LegacyObjFile {
+  // Splits the given 'text' by 'delimiter', while 'num_segments' is the
+  // expected length of results.
+  static std::vector<std::string> SplitText(std::string_view text,
+                                            char delimiter, int num_segments) {
+    const std::vector<std::string> segments =
+        absl::StrSplit(text, delimiter, absl::SkipWhitespace{});
+    ASSERT_TRUE(segments.size() == num_segments, "Invalid number of segments");
+    return segments;
+  }
+
+  // Multi-threading is not supported, hence 'num_threads' is ignored.
+  LegacyObjFile(std::string_view path, int index_base, int /*num_threads*/) {
+    std::ifstream file{path.data(), std::ios::in | std::ios::binary};
+    ASSERT_TRUE(file, absl::StrFormat("Failed to open file '%s'", path));
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> tex_coords;
+    absl::flat_hash_map<std::string, uint32_t> loaded_vertices;
+
+    std::string line;
+    while (std::getline(file, line)) {
+      const size_t non_space = line.find_first_not_of(' ');
+      if (non_space == std::string::npos || line[0] == '#') {
+        continue;
+      }
+
+      if (line[non_space] == 'v') {
+        switch (line[non_space + 1]) {
+          case ' ': {
+            const auto nums = SplitText(line.substr(non_space + 2), ' ', 3);
+            positions.push_back(
+                glm::vec3{stof(nums[0]), stof(nums[1]), stof(nums[2])});
+            break;
+          }
+          case 'n': {
+            const auto nums = SplitText(line.substr(non_space + 3), ' ', 3);
+            normals.push_back(
+                glm::vec3{stof(nums[0]), stof(nums[1]), stof(nums[2])});
+            break;
+          }
+          case 't': {
+            const auto nums = SplitText(line.substr(non_space + 3), ' ', 2);
+            tex_coords.push_back(glm::vec2{stof(nums[0]), stof(nums[1])});
+            break;
+          }
+        }
+      } else if (line[non_space] == 'f') {
+        for (const auto& seg : SplitText(line.substr(non_space + 2), ' ', 3)) {
+          const auto iter = loaded_vertices.find(seg);
+          if (iter != loaded_vertices.end()) {
+            indices.push_back(iter->second);
+          } else {
+            indices.push_back(vertices.size());
+            loaded_vertices[seg] = vertices.size();
+            const auto idxs = SplitText(seg, '/', 3);
+            vertices.push_back(Vertex3DWithTex{
+                positions.at(stoi(idxs[0]) - index_base),
+                normals.at(stoi(idxs[2]) - index_base),
+                tex_coords.at(stoi(idxs[1]) - index_base),
+            });
+          }
+        }
+      }
+    }
+  }
+
+  std::vector<uint32_t> indices;
+  std::vector<Vertex3DWithTex> vertices;
+};
+
+// Writes a wavy grid mesh with 'grid_size' * 'grid_size' vertices to 'path'.
+// Faces are triangles in the "v/vt/vn" form, so that the legacy implementation
+// can also load it.
+void WriteGridObjFile(const stdfs::path& path, int grid_size) {
+  std::FILE* file = std::fopen(path.string().c_str(), "w");
+  ASSERT_NON_NULL(file, absl::StrFormat("Failed to create '%s'",
+                                        path.string()));
+
+  const float step = 1.0f / static_cast<float>(grid_size - 1);
+  for (int row = 0; row < grid_size; ++row) {
+    for (int col = 0; col < grid_size; ++col) {
+      const float x = col * step;
+      const float y = row * step;
+      const float z = 0.1f * std::sin(x * 20.0f) * std::cos(y * 20.0f);
+      absl::FPrintF(file, "v %.6f %.6f %.6f\nvt %.6f %.6f\n"
+                          "vn %.6f %.6f %.6f\n", x, y, z, x, y, 0.0f, 0.0f,
+                    1.0f);
+    }
+  }
+
+  const auto get_index = [grid_size](int row, int col) {
+    return row * grid_size + col + kObjFileIndexBase;
+  };
+  for (int row = 0; row < grid_size - 1; ++row) {
+    for (int col = 0; col < grid_size - 1; ++col) {
+      const int i0 = get_index(row, col);
+      const int i1 = get_index(row, col + 1);
+      const int i2 = get_index(row + 1, col + 1);
+      const int i3 = get_index(row + 1, col);
+      absl::FPrintF(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n",
+                    i0, i0, i0, i1, i1, i1, i2, i2, i2);
+      absl::FPrintF(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n",
+                    i0, i0, i0, i2, i2, i2, i3, i3, i3);
+    }
+  }
+  std::fclose(file);
+}
+
+// Indices of attributes used by one face vertex.
+struct FaceVertexIndices {
+  template <typename H>
+  friend H AbslHashValue(H hash, const FaceVertexIndices& indices) {
+    return H::combine(std::move(hash),
+                      indices.pos, indices.tex_coord, indices.norm);
+  }
+
+  friend bool operator==(const FaceVertexIndices& lhs,
+                         const FaceVertexIndices& rhs) {
+    return lhs.pos == rhs.pos && lhs.tex_coord == rhs.tex_coord &&
+           lhs.norm == rhs.norm;
+  }
+
+  int pos;
+  int tex_coord;
+  int norm;
+};
+
+// Keys of face vertices in different forms, used for benchmarking vertex
+// deduplication without parsing.
+struct DeduplicationKeys {
+  // "pos/tex_coord/norm" text, as used by the legacy implementation.
+  std::vector<std::string> texts;
+  // Separate indices.
+  std::vector<FaceVertexIndices> indices;
+  // Indices packed into 64-bit integers, 21 bits each.
+  std::vector<uint64_t> packed;
+};
+
+// Returns keys of face vertices of the grid mesh written by WriteGridObjFile().
+DeduplicationKeys GenerateGridDeduplicationKeys(int grid_size) {
+  DeduplicationKeys keys;
+  const auto add_key = [grid_size, &keys](int row, int col) {
+    const int index = row * grid_size + col;
+    keys.texts.push_back(absl::StrFormat("%d/%d/%d", index, index, index));
+    keys.indices.push_back({index, index, index});
+    const auto packed = static_cast<uint64_t>(index + 1);
+    keys.packed.push_back(packed << 42 | packed << 21 | packed);
+  };
+  for (int row = 0; row < grid_size - 1; ++row) {
+    for (int col = 0; col < grid_size - 1; ++col) {
+      add_key(row, col);
+      add_key(row, col + 1);
+      add_key(row + 1, col + 1);
+      add_key(row, col);
+      add_key(row + 1, col + 1);
+      add_key(row + 1, col);
+    }
+  }
+  return keys;
+}
+
+// Deduplicates face vertices identified by 'keys'. If the first argument of
+// the benchmark is non-zero, the hash map will reserve space for all unique
+// vertices beforehand.
+template <typename KeyType>
+void BM_DeduplicateVertices(benchmark::State& state,
+                            const std::vector<KeyType>* keys,
+                            size_t num_unique_vertices) {
+  const bool should_reserve = state.range(0) != 0;
+  for (auto _ : state) {
+    absl::flat_hash_map<KeyType, uint32_t> loaded_vertices;
+    if (should_reserve) {
+      loaded_vertices.reserve(num_unique_vertices);
+    }
+    std::vector<uint32_t> indices;
+    indices.reserve(keys->size());
+    for (const KeyType& key : *keys) {
+      const auto [iter, inserted] = loaded_vertices.insert(
+          {key, static_cast<uint32_t>(loaded_vertices.size())});
+      indices.push_back(iter->second);
+    }
+    benchmark::DoNotOptimize(indices.data());
+  }
+  state.SetItemsProcessed(
+      static_cast<int64_t>(state.iterations() * keys->size()));
+}
+
+// Loads the file at 'path' with FileType, and reports the throughput in terms
+// of both bytes and loaded vertices. The number of threads is passed in as the
+// first argument of the benchmark.
+template <typename FileType>
+void BM_LoadObjFile(benchmark::State& state, const std::string* path) {
+  const auto num_threads = static_cast<int>(state.range(0));
+  size_t num_vertices = 0;
+  for (auto _ : state) {
+    const FileType file{*path, kObjFileIndexBase, num_threads};
+    benchmark::DoNotOptimize(file.indices.data());
+    num_vertices += file.vertices.size();
+  }
+  state.SetBytesProcessed(
+      static_cast<int64_t>(state.iterations() * stdfs::file_size(*path)));
+  state.counters["vertices"] = benchmark::Counter(
+      static_cast<double>(num_vertices), benchmark::Counter::kIsRate);
+}
+
+}  // namespace
+}  // namespace lighter::common
+
+int main(int argc, char* argv[]) {
+  namespace stdfs = std::filesystem;
+  using namespace lighter::common;
+
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+
+  const int grid_size = absl::GetFlag(FLAGS_grid_size);
+  std::string obj_path = absl::GetFlag(FLAGS_obj_path);
+  const bool generate_file = obj_path.empty();
+  if (generate_file) {
+    const stdfs::path path =
+        stdfs::temp_directory_path() / "obj_file_benchmark.obj";
+    WriteGridObjFile(path, grid_size);
+    obj_path = path.string();
+  }
+  LOG_INFO << absl::StreamFormat("Loading '%s' (%d bytes)",
+                                 obj_path, stdfs::file_size(obj_path));
+
+  // Wall time is used since the work may be distributed to multiple threads.
+  const int max_num_threads = util::GetNumHardwareThreads();
+  benchmark::RegisterBenchmark("BM_LoadObjFile/Legacy",
+                               BM_LoadObjFile<LegacyObjFile>, &obj_path)
+      ->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+  benchmark::RegisterBenchmark("BM_LoadObjFile/ObjFile",
+                               BM_LoadObjFile<ObjFile>, &obj_path)
+      ->RangeMultiplier(2)->Range(1, max_num_threads)
+      ->Unit(benchmark::kMillisecond)->UseRealTime();
+  benchmark::RegisterBenchmark("BM_LoadObjFile/ObjFilePosOnly",
+                               BM_LoadObjFile<ObjFilePosOnly>, &obj_path)
+      ->RangeMultiplier(2)->Range(1, max_num_threads)
+      ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+  const DeduplicationKeys keys = GenerateGridDeduplicationKeys(grid_size);
+  const size_t num_unique_vertices = grid_size * grid_size;
+  benchmark::RegisterBenchmark("BM_DeduplicateVertices/Text",
+                               BM_DeduplicateVertices<std::string>,
+                               &keys.texts, num_unique_vertices)
+      ->ArgName("reserve")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark("BM_DeduplicateVertices/Indices",
+                               BM_DeduplicateVertices<FaceVertexIndices>,
+                               &keys.indices, num_unique_vertices)
+      ->ArgName("reserve")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark("BM_DeduplicateVertices/Packed",
+                               BM_DeduplicateVertices<uint64_t>,
+                               &keys.packed, num_unique_vertices)
+      ->ArgName("reserve")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+  benchmark::RunSpecifiedBenchmarks();
+
+  if (generate_file) {
+    stdfs::remove(obj_path);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+//
+//  obj_file_test.cc
+//
+//  Created by Pujun Lun on 6/30/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "lighter/common/bounds.h"
+#include "lighter/common/file.h"
+#include "third_party/absl/strings/str_format.h"
+
+#ifdef ASSERT_TRUE
+#undef ASSERT_TRUE
+#endif
+#ifdef ASSERT_FALSE
+#undef ASSERT_FALSE
+#endif
+#include "third_party/gtest/gtest.h"
+
+namespace lighter::common {
+namespace {
+
+constexpr int kIndexBase = 1;
+constexpr int kNumThreads = 4;
+
+// Files larger than this are split into multiple chunks when loaded with
+// kNumThreads threads.
+constexpr size_t kMinMultiChunkFileSize = 8 << 20;
+
+// Returns a path in the temporary directory.
+std::string GetTempPath(const std::string& file_name) {
+  return (std::filesystem::temp_directory_path() / file_name).string();
+}
+
+// Writes 'content' to the file at 'path'.
+void WriteFile(const std::string& path, const std::string& content) {
+  std::ofstream file{path, std::ios::binary};
+  file << content;
+}
+
+// Returns the content of a .obj file made of 'num_blocks' blocks. Each block
+// defines its own attributes, and references them with relative and absolute
+// indices in all forms of face vertices, including n-gons. Some numbers have
+// leading zeros, and some lines end with CRLF.
+std::string GenerateObjFile(int num_blocks) {
+  constexpr int kNumPositionsPerBlock = 5;
+  constexpr int kNumTexCoordsPerBlock = 4;
+  constexpr int kNumNormalsPerBlock = 2;
+
+  std::string content = "# Generated by obj_file_test\nmtllib test.mtl\n";
+  for (int block = 0; block < num_blocks; ++block) {
+    const char* line_end = block % 2 == 0 ? "\n" : "\r\n";
+    const int pos = block * kNumPositionsPerBlock + kIndexBase;
+    const int tex = block * kNumTexCoordsPerBlock + kIndexBase;
+    const int norm = block * kNumNormalsPerBlock + kIndexBase;
+    const float x = static_cast<float>(block % 1000);
+    const float y = static_cast<float>(block / 1000);
+
+    absl::StrAppendFormat(&content, "o Block%d%s", block, line_end);
+    absl::StrAppendFormat(&content, "v %g %g 0.0%s", x, y, line_end);
+    absl::StrAppendFormat(&content, "v %g %g 00.000%s", x + 1.0f, y, line_end);
+    absl::StrAppendFormat(&content, "v %g %g 0%s", x + 1.0f, y + 1.0f,
+                          line_end);
+    absl::StrAppendFormat(&content, "v %g %g 0.5 1.0%s", x, y + 1.0f,
+                          line_end);
+    absl::StrAppendFormat(&content, "v %g %g -0.5%s", x + 0.5f, y + 2.0f,
+                          line_end);
+    absl::StrAppendFormat(&content, "vt 0.0 0.0%s", line_end);
+    absl::StrAppendFormat(&content, "vt 1.0 0.0%s", line_end);
+    absl::StrAppendFormat(&content, "vt 1.0 1.0 0.0%s", line_end);
+    absl::StrAppendFormat(&content, "vt 0.%03d 1.0%s", block % 1000,
+                          line_end);
+    absl::StrAppendFormat(&content, "vn 0.0 0.0 1.0%s", line_end);
+    absl::StrAppendFormat(&content, "vn 0.0 1.0 0.0%s", line_end);
+    absl::StrAppendFormat(&content, "usemtl Material%d%s", block % 3,
+                          line_end);
+    absl::StrAppendFormat(&content, "s off%s", line_end);
+
+    // "v/vt/vn" with relative indices.
+    absl::StrAppendFormat(&content, "f -5/-4/-2 -4/-3/-2 -3/-2/-2%s",
+                          line_end);
+    // "v//vn" quad with absolute indices, some of which have leading zeros.
+    absl::StrAppendFormat(&content, "f %d//%d %07d//%d %d//%d %d//%07d%s",
+                          pos, norm + 1, pos + 1, norm + 1, pos + 2, norm + 1,
+                          pos + 3, norm + 1, line_end);
+    // "v/vt" with mixed relative and absolute indices.
+    absl::StrAppendFormat(&content, "f %d/-4 -3/%d -1/-1%s",
+                          pos + 1, tex + 2, line_end);
+    // "v" pentagon.
+    absl::StrAppendFormat(&content, "f  %d  %d\t%d %d   %d %s",
+                          pos, pos + 1, pos + 2, pos + 4, pos + 3, line_end);
+  }
+  return content;
+}
+
+void ExpectSameVertices(const std::vector<Vertex3DWithTex>& lhs,
+                        const std::vector<Vertex3DWithTex>& rhs) {
+  ASSERT_EQ(lhs.size(), rhs.size());
+  for (size_t i = 0; i < lhs.size(); ++i) {
+    EXPECT_EQ(lhs[i].pos, rhs[i].pos) << "Vertex " << i;
+    EXPECT_EQ(lhs[i].norm, rhs[i].norm) << "Vertex " << i;
+    EXPECT_EQ(lhs[i].tex_coord, rhs[i].tex_coord) << "Vertex " << i;
+  }
+}
+
+void ExpectSameVertices(const std::vector<Vertex3DPosOnly>& lhs,
+                        const std::vector<Vertex3DPosOnly>& rhs) {
+  ASSERT_EQ(lhs.size(), rhs.size());
+  for (size_t i = 0; i < lhs.size(); ++i) {
+    EXPECT_EQ(lhs[i].pos, rhs[i].pos) << "Vertex " << i;
+  }
+}
+
+void ExpectSameBounds(const Aabb& lhs, const Aabb& rhs) {
+  EXPECT_EQ(lhs.min, rhs.min);
+  EXPECT_EQ(lhs.max, rhs.max);
+}
+
+TEST(ObjFileTest, ParseFaceVertexForms) {
+  const std::string path = GetTempPath("obj_file_test_forms.obj");
+  WriteFile(path, GenerateObjFile(/*num_blocks=*/2));
+  const ObjFile obj_file{path, kIndexBase};
+  std::filesystem::remove(path);
+
+  // Each block has 1 + 2 + 1 + 3 triangles after triangulation.
+  constexpr size_t kNumTrianglesPerBlock = 7;
+  ASSERT_EQ(obj_file.indices.size(), 2 * kNumTrianglesPerBlock * 3);
+  const auto get_vertex = [&obj_file](size_t index) -> const Vertex3DWithTex& {
+    return obj_file.vertices[obj_file.indices[index]];
+  };
+
+  // First face of the second block uses relative indices, which are resolved
+  // against attributes defined so far.
+  const size_t second_block_index = kNumTrianglesPerBlock * 3;
+  EXPECT_EQ(get_vertex(second_block_index).pos,
+            (glm::vec3{1.0f, 0.0f, 0.0f}));
+  EXPECT_EQ(get_vertex(second_block_index).norm,
+            (glm::vec3{0.0f, 0.0f, 1.0f}));
+  EXPECT_EQ(get_vertex(second_block_index + 1).pos,
+            (glm::vec3{2.0f, 0.0f, 0.0f}));
+
+  // "v//vn" leaves texture coordinates zero.
+  EXPECT_EQ(get_vertex(second_block_index + 3).tex_coord, glm::vec2{0.0f});
+  EXPECT_EQ(get_vertex(second_block_index + 3).norm,
+            (glm::vec3{0.0f, 1.0f, 0.0f}));
+
+  // "v/vt" leaves normals zero.
+  EXPECT_EQ(get_vertex(second_block_index + 9).norm, glm::vec3{0.0f});
+
+  // The pentagon is triangulated as a fan around its first vertex.
+  for (size_t triangle = 4; triangle < kNumTrianglesPerBlock; ++triangle) {
+    EXPECT_EQ(get_vertex(second_block_index + triangle * 3).pos,
+              (glm::vec3{1.0f, 0.0f, 0.0f}));
+  }
+  EXPECT_EQ(get_vertex(second_block_index + 4 * 3 + 2).pos,
+            (glm::vec3{2.0f, 1.0f, 0.0f}));
+  EXPECT_EQ(get_vertex(second_block_index + 5 * 3 + 2).pos,
+            (glm::vec3{1.5f, 2.0f, -0.5f}));
+  EXPECT_EQ(get_vertex(second_block_index + 6 * 3 + 2).pos,
+            (glm::vec3{1.0f, 1.0f, 0.5f}));
+}
+
+TEST(ObjFileTest, ParallelMatchesSerial) {
+  const std::string content = GenerateObjFile(/*num_blocks=*/40000);
+  ASSERT_GT(content.size(), kMinMultiChunkFileSize);
+  const std::string path = GetTempPath("obj_file_test_parallel.obj");
+  WriteFile(path, content);
+
+  const ObjFile serial{path, kIndexBase, /*num_threads=*/1};
+  const ObjFile parallel{path, kIndexBase, kNumThreads};
+  EXPECT_EQ(parallel.indices, serial.indices);
+  ExpectSameVertices(parallel.vertices, serial.vertices);
+  ExpectSameBounds(parallel.bounds, serial.bounds);
+
+  const ObjFilePosOnly serial_pos_only{path, kIndexBase, /*num_threads=*/1};
+  const ObjFilePosOnly parallel_pos_only{path, kIndexBase, kNumThreads};
+  EXPECT_EQ(parallel_pos_only.indices, serial_pos_only.indices);
+  ExpectSameVertices(parallel_pos_only.vertices, serial_pos_only.vertices);
+  ExpectSameBounds(parallel_pos_only.bounds, serial_pos_only.bounds);
+
+  std::filesystem::remove(path);
+}
+
+}  // namespace
+}  // namespace lighter::common
@@ -0,0 +1,137 @@
+//
+//  packing.cc
+//
+//  Created by Pujun Lun on 6/16/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/packing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace lighter::common::packing {
+namespace {
+
+// Reinterprets bits of a float as an integer, and vice versa.
+uint32_t FloatToBits(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+float BitsToFloat(uint32_t bits) {
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Returns 1 for non-negative values, and -1 otherwise.
+glm::vec2 SignNotZero(const glm::vec2& v) {
+  return {v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f};
+}
+
+}  // namespace
+
+uint16_t FloatToHalf(float value) {
+  // Exponent bias of floats is 127, and that of half floats is 15. Half floats
+  // have 10 mantissa bits, while floats have 23.
+  constexpr uint32_t kFloatInfinity = 255U << 23;
+  constexpr uint32_t kHalfOverflow = (127U + 16U) << 23;
+  constexpr uint32_t kHalfMinNormal = (127U - 14U) << 23;
+  // Adding this to a float shifts its mantissa, so that the lower bits hold
+  // the mantissa of the corresponding half subnormal.
+  constexpr uint32_t kSubnormalMagic = ((127U - 15U) + (23U - 10U) + 1U) << 23;
+
+  uint32_t bits = FloatToBits(value);
+  const uint32_t sign = bits & 0x80000000U;
+  bits ^= sign;
+
+  uint32_t half;
+  if (bits >= kHalfOverflow) {
+    // Infinity or NaN.
+    half = bits > kFloatInfinity ? 0x7E00U : 0x7C00U;
+  } else if (bits < kHalfMinNormal) {
+    // Subnormal or zero. The addition performs rounding for us.
+    half = FloatToBits(BitsToFloat(bits) + BitsToFloat(kSubnormalMagic)) -
+           kSubnormalMagic;
+  } else {
+    // Rebias the exponent, and round the mantissa to nearest even.
+    const uint32_t mantissa_odd = (bits >> 13) & 1U;
+    bits += ((15U - 127U) << 23) + 0xFFFU + mantissa_odd;
+    half = bits >> 13;
+  }
+  return static_cast<uint16_t>(half | (sign >> 16));
+}
+
+float HalfToFloat(uint16_t value) {
+  constexpr uint32_t kShiftedExponent = 0x7C00U << 13;
+  constexpr uint32_t kSubnormalMagic = 113U << 23;
+
+  uint32_t bits = (value & 0x7FFFU) << 13;
+  const uint32_t exponent = bits & kShiftedExponent;
+  bits += (127U - 15U) << 23;
+  if (exponent == kShiftedExponent) {
+    // Infinity or NaN.
+    bits += (128U - 16U) << 23;
+  } else if (exponent == 0) {
+    // Subnormal or zero. Renormalize with float arithmetic.
+    bits = FloatToBits(BitsToFloat(bits + (1U << 23)) -
+                       BitsToFloat(kSubnormalMagic));
+  }
+  return BitsToFloat(bits | (static_cast<uint32_t>(value & 0x8000U) << 16));
+}
+
+int8_t FloatToSnorm8(float value) {
+  return static_cast<int8_t>(
+      std::lround(std::clamp(value, -1.0f, 1.0f) * 127.0f));
+}
+
+int16_t FloatToSnorm16(float value) {
+  return static_cast<int16_t>(
+      std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+uint16_t FloatToUnorm16(float value) {
+  return static_cast<uint16_t>(
+      std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+float Snorm8ToFloat(int8_t value) {
+  return std::max(value / 127.0f, -1.0f);
+}
+
+float Snorm16ToFloat(int16_t value) {
+  return std::max(value / 32767.0f, -1.0f);
+}
+
+float Unorm16ToFloat(uint16_t value) {
+  return value / 65535.0f;
+}
+
+glm::vec2 EncodeOctahedral(const glm::vec3& unit_vector) {
+  const glm::vec3 v =
+      unit_vector / (std::abs(unit_vector.x) + std::abs(unit_vector.y) +
+                     std::abs(unit_vector.z));
+  const glm::vec2 xy{v.x, v.y};
+  if (v.z >= 0.0f) {
+    return xy;
+  }
+  // Fold the lower hemisphere over the diagonals.
+  return (1.0f - glm::abs(glm::vec2{xy.y, xy.x})) * SignNotZero(xy);
+}
+
+glm::vec3 DecodeOctahedral(const glm::vec2& encoded) {
+  glm::vec3 v{encoded, 1.0f - std::abs(encoded.x) - std::abs(encoded.y)};
+  if (v.z < 0.0f) {
+    const glm::vec2 xy{v.x, v.y};
+    const glm::vec2 unfolded =
+        (1.0f - glm::abs(glm::vec2{xy.y, xy.x})) * SignNotZero(xy);
+    v.x = unfolded.x;
+    v.y = unfolded.y;
+  }
+  return glm::normalize(v);
+}
+
+}  // namespace lighter::common::packing
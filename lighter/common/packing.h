@@ -0,0 +1,45 @@
+//
+//  packing.h
+//
+//  Created by Pujun Lun on 6/16/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#ifndef LIGHTER_COMMON_PACKING_H
+#define LIGHTER_COMMON_PACKING_H
+
+#include <cstdint>
+
+#include "third_party/glm/glm.hpp"
+
+namespace lighter::common::packing {
+
+// Converts between 32-bit floats and IEEE 754 half-precision floats. Values are
+// rounded to nearest even. Values out of the range of half floats become
+// infinity, and NaN is preserved.
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t value);
+
+// Converts floats to normalized integers, following the conversion rules in
+// the Vulkan specification. Values are clamped to [-1, 1] for signed types and
+// [0, 1] for unsigned types.
+int8_t FloatToSnorm8(float value);
+int16_t FloatToSnorm16(float value);
+uint16_t FloatToUnorm16(float value);
+
+// Converts normalized integers back to floats.
+float Snorm8ToFloat(int8_t value);
+float Snorm16ToFloat(int16_t value);
+float Unorm16ToFloat(uint16_t value);
+
+// Maps a unit vector onto the octahedron and unfolds it to a square, so that it
+// can be stored with two values in range [-1, 1] (Cigolle et al., "A Survey of
+// Efficient Representations for Independent Unit Vectors").
+glm::vec2 EncodeOctahedral(const glm::vec3& unit_vector);
+
+// Reverses EncodeOctahedral(). The returned vector is normalized.
+glm::vec3 DecodeOctahedral(const glm::vec2& encoded);
+
+}  // namespace lighter::common::packing
+
+#endif  // LIGHTER_COMMON_PACKING_H
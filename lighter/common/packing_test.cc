@@ -0,0 +1,288 @@
+//
+//  packing_test.cc
+//
+//  Created by Pujun Lun on 6/16/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/packing.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+
+#include "lighter/common/file.h"
+
+#ifdef ASSERT_TRUE
+#undef ASSERT_TRUE
+#endif
+#ifdef ASSERT_FALSE
+#undef ASSERT_FALSE
+#endif
+#include "third_party/gtest/gtest.h"
+
+namespace lighter::common {
+namespace {
+
+constexpr int kNumSamples = 100000;
+
+// Maximum angle in radians between a unit vector and itself after octahedral
+// encoding, snorm16 quantization and decoding.
+constexpr float kMaxOctahedralSnorm16Error = 1e-4f;
+
+// Returns the angle in radians between unit vectors 'lhs' and 'rhs'. This is
+// more precise than the arc cosine of the dot product for small angles.
+float GetAngle(const glm::vec3& lhs, const glm::vec3& rhs) {
+  return std::atan2(glm::length(glm::cross(lhs, rhs)), glm::dot(lhs, rhs));
+}
+
+// Returns 'unit_vector' after octahedral encoding and decoding. If 'quantize'
+// is true, the encoded vector is also quantized to snorm16, as done for vertex
+// normals.
+glm::vec3 RoundTripOctahedral(const glm::vec3& unit_vector, bool quantize) {
+  glm::vec2 encoded = packing::EncodeOctahedral(unit_vector);
+  EXPECT_LE(std::abs(encoded.x), 1.0f);
+  EXPECT_LE(std::abs(encoded.y), 1.0f);
+  if (quantize) {
+    encoded = {packing::Snorm16ToFloat(packing::FloatToSnorm16(encoded.x)),
+               packing::Snorm16ToFloat(packing::FloatToSnorm16(encoded.y))};
+  }
+  return packing::DecodeOctahedral(encoded);
+}
+
+TEST(PackingTest, HalfExactValues) {
+  for (const float value : {0.0f, 1.0f, -2.0f, 0.5f, 1024.0f, 65504.0f,
+                            /*min normal=*/std::ldexp(1.0f, -14),
+                            /*min subnormal=*/std::ldexp(1.0f, -24)}) {
+    EXPECT_EQ(packing::HalfToFloat(packing::FloatToHalf(value)), value);
+    EXPECT_EQ(packing::HalfToFloat(packing::FloatToHalf(-value)), -value);
+  }
+  EXPECT_EQ(packing::FloatToHalf(0.0f), 0x0000);
+  EXPECT_EQ(packing::FloatToHalf(-0.0f), 0x8000);
+  EXPECT_EQ(packing::FloatToHalf(1.0f), 0x3C00);
+  EXPECT_EQ(packing::FloatToHalf(65504.0f), 0x7BFF);
+}
+
+TEST(PackingTest, HalfRoundToNearestEven) {
+  // Half floats have 10 mantissa bits, hence the spacing around 1 is 2^-10.
+  const float ulp = std::ldexp(1.0f, -10);
+  EXPECT_EQ(packing::HalfToFloat(packing::FloatToHalf(1.0f + ulp * 0.5f)),
+            1.0f);
+  EXPECT_EQ(packing::HalfToFloat(packing::FloatToHalf(1.0f + ulp * 1.5f)),
+            1.0f + ulp * 2.0f);
+  EXPECT_EQ(packing::HalfToFloat(packing::FloatToHalf(1.0f + ulp * 0.6f)),
+            1.0f + ulp);
+}
+
+TEST(PackingTest, HalfSpecialValues) {
+  constexpr float kInfinity = std::numeric_limits<float>::infinity();
+  EXPECT_EQ(packing::HalfToFloat(packing::FloatToHalf(kInfinity)), kInfinity);
+  EXPECT_EQ(packing::HalfToFloat(packing::FloatToHalf(-kInfinity)),
+            -kInfinity);
+  EXPECT_EQ(packing::HalfToFloat(packing::FloatToHalf(1e6f)), kInfinity);
+  EXPECT_EQ(packing::HalfToFloat(packing::FloatToHalf(-1e6f)), -kInfinity);
+  EXPECT_TRUE(std::isnan(packing::HalfToFloat(
+      packing::FloatToHalf(std::numeric_limits<float>::quiet_NaN()))));
+}
+
+TEST(PackingTest, HalfRoundTripAllValues) {
+  for (uint32_t bits = 0; bits <= 0xFFFFU; ++bits) {
+    const auto half = static_cast<uint16_t>(bits);
+    const float value = packing::HalfToFloat(half);
+    if (std::isnan(value)) {
+      EXPECT_EQ(half & 0x7C00U, 0x7C00U) << "Half " << bits;
+      continue;
+    }
+    EXPECT_EQ(packing::FloatToHalf(value), half) << "Half " << bits;
+  }
+}
+
+TEST(PackingTest, HalfErrorBound) {
+  std::mt19937 rand_gen{0};
+  std::uniform_real_distribution<float> dist{-60000.0f, 60000.0f};
+  // Normal half floats have 11 significant bits, and rounding loses at most
+  // half of the last one.
+  const float max_relative_error = std::ldexp(1.0f, -11);
+  for (int i = 0; i < kNumSamples; ++i) {
+    const float value = dist(rand_gen);
+    if (std::abs(value) < std::ldexp(1.0f, -14)) {
+      continue;
+    }
+    const float restored = packing::HalfToFloat(packing::FloatToHalf(value));
+    EXPECT_LE(std::abs(restored - value), std::abs(value) * max_relative_error)
+        << "Value " << value;
+  }
+}
+
+TEST(PackingTest, NormalizedIntegerEndpoints) {
+  EXPECT_EQ(packing::FloatToSnorm8(1.0f), 127);
+  EXPECT_EQ(packing::FloatToSnorm8(-1.0f), -127);
+  EXPECT_EQ(packing::FloatToSnorm8(0.0f), 0);
+  EXPECT_EQ(packing::FloatToSnorm16(1.0f), 32767);
+  EXPECT_EQ(packing::FloatToSnorm16(-1.0f), -32767);
+  EXPECT_EQ(packing::FloatToSnorm16(0.0f), 0);
+  EXPECT_EQ(packing::FloatToUnorm16(1.0f), 65535);
+  EXPECT_EQ(packing::FloatToUnorm16(0.0f), 0);
+
+  // Values out of range are clamped.
+  EXPECT_EQ(packing::FloatToSnorm8(2.0f), 127);
+  EXPECT_EQ(packing::FloatToSnorm8(-2.0f), -127);
+  EXPECT_EQ(packing::FloatToSnorm16(2.0f), 32767);
+  EXPECT_EQ(packing::FloatToSnorm16(-2.0f), -32767);
+  EXPECT_EQ(packing::FloatToUnorm16(2.0f), 65535);
+  EXPECT_EQ(packing::FloatToUnorm16(-1.0f), 0);
+
+  // The most negative integers also map to -1.
+  EXPECT_EQ(packing::Snorm8ToFloat(-128), -1.0f);
+  EXPECT_EQ(packing::Snorm16ToFloat(-32768), -1.0f);
+}
+
+TEST(PackingTest, NormalizedIntegerRoundTripAllValues) {
+  for (int value = -127; value <= 127; ++value) {
+    const auto snorm8 = static_cast<int8_t>(value);
+    EXPECT_EQ(packing::FloatToSnorm8(packing::Snorm8ToFloat(snorm8)), snorm8);
+  }
+  for (int value = -32767; value <= 32767; ++value) {
+    const auto snorm16 = static_cast<int16_t>(value);
+    EXPECT_EQ(packing::FloatToSnorm16(packing::Snorm16ToFloat(snorm16)),
+              snorm16);
+  }
+  for (int value = 0; value <= 65535; ++value) {
+    const auto unorm16 = static_cast<uint16_t>(value);
+    EXPECT_EQ(packing::FloatToUnorm16(packing::Unorm16ToFloat(unorm16)),
+              unorm16);
+  }
+}
+
+TEST(PackingTest, NormalizedIntegerErrorBound) {
+  std::mt19937 rand_gen{0};
+  std::uniform_real_distribution<float> dist{-1.0f, 1.0f};
+  // Rounding loses at most half of the step, plus float rounding errors.
+  constexpr float kEpsilon = 1e-7f;
+  for (int i = 0; i < kNumSamples; ++i) {
+    const float snorm = dist(rand_gen);
+    EXPECT_LE(std::abs(packing::Snorm8ToFloat(packing::FloatToSnorm8(snorm)) -
+                       snorm),
+              0.5f / 127.0f + kEpsilon) << "Value " << snorm;
+    EXPECT_LE(std::abs(packing::Snorm16ToFloat(packing::FloatToSnorm16(snorm)) -
+                       snorm),
+              0.5f / 32767.0f + kEpsilon) << "Value " << snorm;
+
+    const float unorm = std::abs(snorm);
+    EXPECT_LE(std::abs(packing::Unorm16ToFloat(packing::FloatToUnorm16(unorm)) -
+                       unorm),
+              0.5f / 65535.0f + kEpsilon) << "Value " << unorm;
+  }
+}
+
+TEST(PackingTest, OctahedralPoles) {
+  // The +Z pole is at the center of the square, and the -Z pole is folded to
+  // its corners.
+  EXPECT_EQ(packing::EncodeOctahedral({0.0f, 0.0f, 1.0f}), glm::vec2{0.0f});
+  EXPECT_EQ(glm::abs(packing::EncodeOctahedral({0.0f, 0.0f, -1.0f})),
+            glm::vec2{1.0f});
+  for (const glm::vec2& corner : {glm::vec2{1.0f, 1.0f}, glm::vec2{-1.0f, 1.0f},
+                                  glm::vec2{1.0f, -1.0f},
+                                  glm::vec2{-1.0f, -1.0f}}) {
+    EXPECT_EQ(packing::DecodeOctahedral(corner),
+              (glm::vec3{0.0f, 0.0f, -1.0f}));
+  }
+
+  for (const bool quantize : {false, true}) {
+    for (const float z : {1.0f, -1.0f}) {
+      const glm::vec3 pole{0.0f, 0.0f, z};
+      EXPECT_LE(GetAngle(RoundTripOctahedral(pole, quantize), pole),
+                kMaxOctahedralSnorm16Error)
+          << "Pole " << z << ", quantize " << quantize;
+    }
+  }
+}
+
+TEST(PackingTest, OctahedralFoldEdges) {
+  // The equator lies on the edges of the inner diamond, where the lower
+  // hemisphere is folded. Vectors slightly below the equator are folded to the
+  // other side of the edges.
+  const float diagonal = std::sqrt(0.5f);
+  const glm::vec3 unit_vectors[]{
+      {1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f},
+      {0.0f, 1.0f, 0.0f}, {0.0f, -1.0f, 0.0f},
+      {diagonal, diagonal, 0.0f}, {-diagonal, diagonal, 0.0f},
+      {diagonal, -diagonal, 0.0f}, {-diagonal, -diagonal, 0.0f},
+      glm::normalize(glm::vec3{1.0f, 1.0f, 1e-3f}),
+      glm::normalize(glm::vec3{1.0f, 1.0f, -1e-3f}),
+      glm::normalize(glm::vec3{-1.0f, 0.5f, -1e-3f}),
+      glm::normalize(glm::vec3{0.5f, -1.0f, -1e-3f}),
+  };
+  for (const glm::vec3& unit_vector : unit_vectors) {
+    const glm::vec2 encoded = packing::EncodeOctahedral(unit_vector);
+    if (unit_vector.z == 0.0f) {
+      EXPECT_FLOAT_EQ(std::abs(encoded.x) + std::abs(encoded.y), 1.0f);
+    }
+    for (const bool quantize : {false, true}) {
+      EXPECT_LE(GetAngle(RoundTripOctahedral(unit_vector, quantize),
+                         unit_vector),
+                kMaxOctahedralSnorm16Error)
+          << "Vector (" << unit_vector.x << ", " << unit_vector.y << ", "
+          << unit_vector.z << "), quantize " << quantize;
+    }
+  }
+}
+
+TEST(PackingTest, OctahedralErrorBound) {
+  std::mt19937 rand_gen{0};
+  std::normal_distribution<float> dist;
+  for (int i = 0; i < kNumSamples; ++i) {
+    const glm::vec3 unit_vector = glm::normalize(
+        glm::vec3{dist(rand_gen), dist(rand_gen), dist(rand_gen)});
+    EXPECT_LE(GetAngle(RoundTripOctahedral(unit_vector, /*quantize=*/false),
+                       unit_vector),
+              1e-5f);
+    EXPECT_LE(GetAngle(RoundTripOctahedral(unit_vector, /*quantize=*/true),
+                       unit_vector),
+              kMaxOctahedralSnorm16Error);
+  }
+}
+
+TEST(PackingTest, PositionQuantization) {
+  const glm::vec3 min_pos{-3.0f, 10.0f, 5.0f};
+  const glm::vec3 max_pos{1.0f, 30.0f, 5.0f};
+  const auto quantization = PositionQuantization::Create(min_pos, max_pos);
+  EXPECT_EQ(quantization.scale.x, 2.0f);
+  EXPECT_EQ(quantization.scale.y, 10.0f);
+  EXPECT_GT(quantization.scale.z, 0.0f);
+  EXPECT_EQ(quantization.bias, (glm::vec3{-1.0f, 20.0f, 5.0f}));
+
+  const auto restore = [&quantization](const glm::vec3& pos) {
+    const Vertex3DQuantized quantized =
+        Vertex3DQuantized::Create({pos, /*norm=*/glm::vec3{0.0f, 0.0f, 1.0f},
+                                   /*tex_coord=*/glm::vec2{0.0f}},
+                                  quantization);
+    EXPECT_EQ(quantized.pos.values[3], 32767);
+    const glm::vec3 restored{packing::Snorm16ToFloat(quantized.pos.values[0]),
+                             packing::Snorm16ToFloat(quantized.pos.values[1]),
+                             packing::Snorm16ToFloat(quantized.pos.values[2])};
+    return restored * quantization.scale + quantization.bias;
+  };
+
+  // Corners of the box are restored exactly, and the flat axis is preserved.
+  EXPECT_EQ(restore(min_pos), min_pos);
+  EXPECT_EQ(restore(max_pos), max_pos);
+
+  std::mt19937 rand_gen{0};
+  std::uniform_real_distribution<float> dist{0.0f, 1.0f};
+  // Rounding loses at most half of the step, plus float rounding errors.
+  const glm::vec3 max_error = quantization.scale * (0.5f / 32767.0f) + 1e-5f;
+  for (int i = 0; i < kNumSamples; ++i) {
+    const glm::vec3 pos = glm::mix(
+        min_pos, max_pos,
+        glm::vec3{dist(rand_gen), dist(rand_gen), dist(rand_gen)});
+    const glm::vec3 error = glm::abs(restore(pos) - pos);
+    for (int axis = 0; axis < 3; ++axis) {
+      EXPECT_LE(error[axis], max_error[axis]) << "Axis " << axis;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace lighter::common
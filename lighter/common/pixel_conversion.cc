@@ -0,0 +1,330 @@
+//
+//  pixel_conversion.cc
+//
+//  Created by Pujun Lun on 6/22/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/pixel_conversion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "lighter/common/packing.h"
+#include "lighter/common/util.h"
+#include "third_party/absl/strings/str_format.h"
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+#define LIGHTER_USE_SSSE3
+#include <tmmintrin.h>
+#endif  // __SSSE3__ || __AVX2__
+
+#if defined(__AVX2__)
+#define LIGHTER_USE_AVX2
+#include <immintrin.h>
+#endif  // __AVX2__
+
+#if defined(__F16C__)
+#define LIGHTER_USE_F16C
+#include <immintrin.h>
+#endif  // __F16C__
+
+namespace lighter::common::pixel_conversion {
+namespace {
+
+constexpr int kNumValuesPerByte = 256;
+
+// LinearToSrgb() looks up buckets indexed by the exponent and the highest
+// 'kNumBucketMantissaBits' mantissa bits of inputs. Inputs smaller than
+// 'kMinBucketValue' are all encoded as 0.
+constexpr int kNumBucketMantissaBits = 8;
+constexpr int kBucketShift = 23 - kNumBucketMantissaBits;
+constexpr uint32_t kMinBucketValueBits = (127u - 14u) << 23;
+constexpr float kMinBucketValue = 1.0f / (1 << 14);
+
+uint32_t FloatToBits(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+float BitsToFloat(uint32_t bits) {
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+int GetBucketIndex(float value) {
+  return static_cast<int>((FloatToBits(value) - kMinBucketValueBits) >>
+                          kBucketShift);
+}
+
+// Decodes a sRGB encoded value in range [0, 1].
+double DecodeSrgb(double value) {
+  return value <= 0.04045 ? value / 12.92
+                          : std::pow((value + 0.055) / 1.055, 2.4);
+}
+
+// Converts a float to the nearest 8-bit unsigned normalized integer. NaN is
+// converted to 0.
+uint8_t FloatToUnorm8Value(float value) {
+  value = value > 0.0f ? value : 0.0f;
+  value = value < 1.0f ? value : 1.0f;
+  return static_cast<uint8_t>(value * 255.0f + 0.5f);
+}
+
+// Lookup tables shared by all conversions.
+struct Tables {
+  Tables() {
+    for (int i = 0; i < kNumValuesPerByte; ++i) {
+      unorm_to_float[i] = static_cast<float>(i) / 255.0f;
+      srgb_to_linear[i] = static_cast<float>(DecodeSrgb(i / 255.0));
+      unorm_to_half[i] = packing::FloatToHalf(unorm_to_float[i]);
+    }
+
+    // 'srgb_thresholds[i]' is the smallest linear value that is encoded as
+    // i + 1, i.e. the decoded value of the midpoint between i and i + 1.
+    for (int i = 0; i < kNumValuesPerByte - 1; ++i) {
+      srgb_thresholds[i] =
+          static_cast<float>(DecodeSrgb((i + 0.5) / 255.0));
+    }
+    srgb_thresholds.back() = std::numeric_limits<float>::infinity();
+
+    // Each bucket stores the number of thresholds that are not greater than
+    // the start of it. Buckets are small enough to contain at most one
+    // threshold, so the result only needs one more comparison.
+    const int num_buckets = GetBucketIndex(1.0f) + 1;
+    bucket_bases.resize(num_buckets);
+    int base = 0;
+    for (int bucket = 0; bucket < num_buckets; ++bucket) {
+      const uint32_t start_bits =
+          kMinBucketValueBits + (static_cast<uint32_t>(bucket) << kBucketShift);
+      while (srgb_thresholds[base] <= BitsToFloat(start_bits)) {
+        ++base;
+      }
+      bucket_bases[bucket] = static_cast<uint8_t>(base);
+
+      const float next_start =
+          BitsToFloat(start_bits + (uint32_t{1} << kBucketShift));
+      ASSERT_TRUE(base + 1 >= kNumValuesPerByte ||
+                      srgb_thresholds[base + 1] >= next_start,
+                  absl::StrFormat("Bucket %d contains more than one threshold",
+                                  bucket));
+    }
+  }
+
+  std::array<float, kNumValuesPerByte> unorm_to_float;
+  std::array<float, kNumValuesPerByte> srgb_to_linear;
+  std::array<uint16_t, kNumValuesPerByte> unorm_to_half;
+  std::array<float, kNumValuesPerByte> srgb_thresholds;
+  std::vector<uint8_t> bucket_bases;
+};
+
+const Tables& GetTables() {
+  static const auto* tables = new Tables{};
+  return *tables;
+}
+
+uint8_t LinearToSrgbValue(const Tables& tables, float value) {
+  value = value > kMinBucketValue ? value : kMinBucketValue;
+  value = value < 1.0f ? value : 1.0f;
+  const int base = tables.bucket_bases[GetBucketIndex(value)];
+  return static_cast<uint8_t>(base + (value >= tables.srgb_thresholds[base]));
+}
+
+// Returns whether the last channel of pixels should be treated as alpha.
+bool HasAlphaChannel(int channel) {
+  ASSERT_TRUE(channel >= 1 && channel <= 4,
+              absl::StrFormat("Unsupported number of channels: %d", channel));
+  return channel == 2 || channel == 4;
+}
+
+}  // namespace
+
+void ExpandRgbToRgba(const uint8_t* rgb, size_t num_pixels, uint8_t* rgba,
+                     uint8_t alpha) {
+  // Pixels are processed from the back, so that converting in place never
+  // overwrites pixels that have not been read.
+  size_t num_simd_pixels = 0;
+#ifdef LIGHTER_USE_SSSE3
+  // Each iteration loads 16 bytes but only uses 12 of them, hence the last two
+  // pixels are left to the scalar loop to avoid reading out of bounds.
+  if (num_pixels >= 2) {
+    num_simd_pixels = (num_pixels - 2) / 4 * 4;
+  }
+#endif  // LIGHTER_USE_SSSE3
+
+  for (size_t i = num_pixels; i > num_simd_pixels; --i) {
+    const uint8_t* src = rgb + (i - 1) * 3;
+    const uint8_t r = src[0], g = src[1], b = src[2];
+    uint8_t* dst = rgba + (i - 1) * 4;
+    dst[0] = r;
+    dst[1] = g;
+    dst[2] = b;
+    dst[3] = alpha;
+  }
+
+#ifdef LIGHTER_USE_SSSE3
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1,
+                                        6, 7, 8, -1, 9, 10, 11, -1);
+  const __m128i alpha_mask =
+      _mm_set1_epi32(static_cast<int>(uint32_t{alpha} << 24));
+  for (size_t i = num_simd_pixels; i > 0; i -= 4) {
+    const __m128i src = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(rgb + (i - 4) * 3));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + (i - 4) * 4),
+                     _mm_or_si128(_mm_shuffle_epi8(src, shuffle), alpha_mask));
+  }
+#endif  // LIGHTER_USE_SSSE3
+}
+
+void FlipVertically(const void* src, size_t row_size, int num_rows, void* dst) {
+  auto* dst_bytes = static_cast<uint8_t*>(dst);
+  if (src == dst) {
+    for (int row = 0; row < num_rows / 2; ++row) {
+      uint8_t* upper = dst_bytes + row_size * row;
+      std::swap_ranges(upper, upper + row_size,
+                       dst_bytes + row_size * (num_rows - row - 1));
+    }
+    return;
+  }
+
+  const auto* src_bytes = static_cast<const uint8_t*>(src);
+  for (int row = 0; row < num_rows; ++row) {
+    std::memcpy(dst_bytes + row_size * row,
+                src_bytes + row_size * (num_rows - row - 1), row_size);
+  }
+}
+
+void SwizzleChannels(const std::array<int, 4>& order, size_t num_pixels,
+                     uint8_t* pixels) {
+  for (int index : order) {
+    ASSERT_TRUE(index >= 0 && index < 4,
+                absl::StrFormat("Invalid channel index: %d", index));
+  }
+
+  size_t num_simd_pixels = 0;
+#ifdef LIGHTER_USE_SSSE3
+  alignas(32) std::array<int8_t, 32> indices;
+  for (int i = 0; i < static_cast<int>(indices.size()); ++i) {
+    // Shuffles of AVX2 do not cross 128-bit lanes, hence indices are relative
+    // to each lane.
+    indices[i] = static_cast<int8_t>((i % 16) / 4 * 4 + order[i % 4]);
+  }
+
+#ifdef LIGHTER_USE_AVX2
+  const __m256i shuffle_256 =
+      _mm256_load_si256(reinterpret_cast<const __m256i*>(indices.data()));
+  for (; num_simd_pixels + 8 <= num_pixels; num_simd_pixels += 8) {
+    auto* data = reinterpret_cast<__m256i*>(pixels + num_simd_pixels * 4);
+    _mm256_storeu_si256(
+        data, _mm256_shuffle_epi8(_mm256_loadu_si256(data), shuffle_256));
+  }
+#endif  // LIGHTER_USE_AVX2
+
+  const __m128i shuffle =
+      _mm_load_si128(reinterpret_cast<const __m128i*>(indices.data()));
+  for (; num_simd_pixels + 4 <= num_pixels; num_simd_pixels += 4) {
+    auto* data = reinterpret_cast<__m128i*>(pixels + num_simd_pixels * 4);
+    _mm_storeu_si128(data, _mm_shuffle_epi8(_mm_loadu_si128(data), shuffle));
+  }
+#endif  // LIGHTER_USE_SSSE3
+
+  for (size_t i = num_simd_pixels; i < num_pixels; ++i) {
+    uint8_t* pixel = pixels + i * 4;
+    const std::array<uint8_t, 4> original{pixel[0], pixel[1], pixel[2],
+                                          pixel[3]};
+    for (int c = 0; c < 4; ++c) {
+      pixel[c] = original[order[c]];
+    }
+  }
+}
+
+void SrgbToLinear(const uint8_t* src, size_t num_pixels, int channel,
+                  float* dst) {
+  const Tables& tables = GetTables();
+  const int num_color_channels = HasAlphaChannel(channel) ? channel - 1
+                                                          : channel;
+  for (size_t i = 0; i < num_pixels; ++i) {
+    for (int c = 0; c < num_color_channels; ++c) {
+      dst[c] = tables.srgb_to_linear[src[c]];
+    }
+    if (num_color_channels != channel) {
+      dst[num_color_channels] = tables.unorm_to_float[src[num_color_channels]];
+    }
+    src += channel;
+    dst += channel;
+  }
+}
+
+void LinearToSrgb(const float* src, size_t num_pixels, int channel,
+                  uint8_t* dst) {
+  const Tables& tables = GetTables();
+  const int num_color_channels = HasAlphaChannel(channel) ? channel - 1
+                                                          : channel;
+  for (size_t i = 0; i < num_pixels; ++i) {
+    for (int c = 0; c < num_color_channels; ++c) {
+      dst[c] = LinearToSrgbValue(tables, src[c]);
+    }
+    if (num_color_channels != channel) {
+      dst[num_color_channels] = FloatToUnorm8Value(src[num_color_channels]);
+    }
+    src += channel;
+    dst += channel;
+  }
+}
+
+void Unorm8ToFloat(const uint8_t* src, size_t num_values, float* dst) {
+  const Tables& tables = GetTables();
+  for (size_t i = 0; i < num_values; ++i) {
+    dst[i] = tables.unorm_to_float[src[i]];
+  }
+}
+
+void FloatToUnorm8(const float* src, size_t num_values, uint8_t* dst) {
+  for (size_t i = 0; i < num_values; ++i) {
+    dst[i] = FloatToUnorm8Value(src[i]);
+  }
+}
+
+void Unorm8ToHalf(const uint8_t* src, size_t num_values, uint16_t* dst) {
+  const Tables& tables = GetTables();
+  for (size_t i = 0; i < num_values; ++i) {
+    dst[i] = tables.unorm_to_half[src[i]];
+  }
+}
+
+void HalfToUnorm8(const uint16_t* src, size_t num_values, uint8_t* dst) {
+  size_t num_simd_values = 0;
+#ifdef LIGHTER_USE_F16C
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 scale = _mm_set1_ps(255.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  // Note that the second operand is returned if either operand is NaN, hence
+  // NaN is converted to 0, which matches FloatToUnorm8Value().
+  const auto to_int = [&](__m128 value) {
+    value = _mm_min_ps(_mm_max_ps(value, zero), one);
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, scale), half));
+  };
+  for (; num_simd_values + 8 <= num_values; num_simd_values += 8) {
+    const __m128i halves = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(src + num_simd_values));
+    const __m128i low = to_int(_mm_cvtph_ps(halves));
+    const __m128i high = to_int(_mm_cvtph_ps(_mm_unpackhi_epi64(halves,
+                                                                halves)));
+    const __m128i words = _mm_packs_epi32(low, high);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + num_simd_values),
+                     _mm_packus_epi16(words, words));
+  }
+#endif  // LIGHTER_USE_F16C
+
+  for (size_t i = num_simd_values; i < num_values; ++i) {
+    dst[i] = FloatToUnorm8Value(packing::HalfToFloat(src[i]));
+  }
+}
+
+}  // namespace lighter::common::pixel_conversion
@@ -0,0 +1,59 @@
+//
+//  pixel_conversion.h
+//
+//  Created by Pujun Lun on 6/22/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#ifndef LIGHTER_COMMON_PIXEL_CONVERSION_H
+#define LIGHTER_COMMON_PIXEL_CONVERSION_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Conversion kernels for 8-bit image data. SIMD implementations are selected at
+// compile time: SSSE3 is used if available (e.g. 'bazel build --config=avx2'),
+// and F16C is used for half float conversions if available. Otherwise, scalar
+// implementations are used, which produce the same results.
+namespace lighter::common::pixel_conversion {
+
+// Expands 'num_pixels' RGB pixels in 'rgb' to RGBA pixels in 'rgba', filling
+// the alpha channel with 'alpha'. 'rgba' must hold 4 * 'num_pixels' bytes. It
+// may be the same as 'rgb' for converting in place, but other kinds of overlap
+// are not allowed.
+void ExpandRgbToRgba(const uint8_t* rgb, size_t num_pixels, uint8_t* rgba,
+                     uint8_t alpha = 255);
+
+// Copies 'num_rows' rows of 'row_size' bytes from 'src' to 'dst' in reverse
+// order. If 'src' is the same as 'dst', rows are swapped in place. Other kinds
+// of overlap are not allowed.
+void FlipVertically(const void* src, size_t row_size, int num_rows, void* dst);
+
+// Reorders channels of 'num_pixels' RGBA pixels in place. Channel 'i' of each
+// output pixel is channel 'order[i]' of the input pixel, hence {2, 1, 0, 3}
+// converts between RGBA and BGRA.
+void SwizzleChannels(const std::array<int, 4>& order, size_t num_pixels,
+                     uint8_t* pixels);
+
+// Converts 'num_pixels' pixels with 'channel' channels between sRGB encoded
+// 8-bit values and linear floats in range [0, 1]. If 'channel' is 2 or 4, the
+// last channel is treated as alpha and converted without the transfer function.
+// LinearToSrgb() clamps inputs and rounds to the nearest 8-bit value, hence it
+// exactly reverses SrgbToLinear().
+void SrgbToLinear(const uint8_t* src, size_t num_pixels, int channel,
+                  float* dst);
+void LinearToSrgb(const float* src, size_t num_pixels, int channel,
+                  uint8_t* dst);
+
+// Converts 'num_values' values between 8-bit unsigned normalized integers and
+// floats or half floats, following the conversion rules in the Vulkan
+// specification.
+void Unorm8ToFloat(const uint8_t* src, size_t num_values, float* dst);
+void FloatToUnorm8(const float* src, size_t num_values, uint8_t* dst);
+void Unorm8ToHalf(const uint8_t* src, size_t num_values, uint16_t* dst);
+void HalfToUnorm8(const uint16_t* src, size_t num_values, uint8_t* dst);
+
+}  // namespace lighter::common::pixel_conversion
+
+#endif  // LIGHTER_COMMON_PIXEL_CONVERSION_H
@@ -0,0 +1,220 @@
+//
+//  pixel_conversion_benchmark.cc
+//
+//  Created by Pujun Lun on 6/22/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "lighter/common/memory_pool.h"
+#include "lighter/common/pixel_conversion.h"
+#include "third_party/absl/flags/flag.h"
+#include "third_party/absl/flags/parse.h"
+#include "third_party/absl/strings/str_cat.h"
+#include "third_party/benchmark/benchmark.h"
+// The implementation of stb_image is compiled in //lighter/common:image, which
+// allocates memory from memory_pool.
+#include "third_party/stb/stb_image.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "third_party/stb/stb_image_write.h"
+
+ABSL_FLAG(int, image_size, 1024, "Width and height of images");
+
+namespace lighter::common::pixel_conversion {
+namespace {
+
+constexpr int kRgbChannel = 3;
+constexpr int kRgbaChannel = 4;
+
+// Square RGB image with smooth gradients and some noise, so that it compresses
+// like a real texture.
+std::vector<uint8_t> CreateRgbImage(int size) {
+  std::mt19937 rand_gen{/*seed=*/0};
+  std::uniform_int_distribution<int> noise_dist{-8, 8};
+  std::vector<uint8_t> pixels;
+  pixels.reserve(size * size * kRgbChannel);
+  for (int y = 0; y < size; ++y) {
+    for (int x = 0; x < size; ++x) {
+      for (int base : {x * 255 / size, y * 255 / size, (x + y) * 127 / size}) {
+        pixels.push_back(
+            static_cast<uint8_t>(std::clamp(base + noise_dist(rand_gen),
+                                            0, 255)));
+      }
+    }
+  }
+  return pixels;
+}
+
+void AppendToVector(void* context, void* data, int size) {
+  auto* bytes = static_cast<std::vector<uint8_t>*>(context);
+  const auto* begin = static_cast<const uint8_t*>(data);
+  bytes->insert(bytes->end(), begin, begin + size);
+}
+
+// Image files encoded in memory.
+struct EncodedImages {
+  explicit EncodedImages(int size) {
+    const std::vector<uint8_t> pixels = CreateRgbImage(size);
+    stbi_write_png_to_func(AppendToVector, &png, size, size, kRgbChannel,
+                           pixels.data(), /*stride_in_bytes=*/0);
+    stbi_write_jpg_to_func(AppendToVector, &jpg, size, size, kRgbChannel,
+                           pixels.data(), /*quality=*/90);
+  }
+
+  std::vector<uint8_t> png;
+  std::vector<uint8_t> jpg;
+};
+
+// Previous way of loading RGB images: the image is decoded once to get the
+// number of channels, and then decoded again with 4 channels.
+void BM_DecodeTwice(benchmark::State& state,
+                    const std::vector<uint8_t>* file) {
+  int width, height, channel;
+  for (auto _ : state) {
+    stbi_uc* data = stbi_load_from_memory(
+        file->data(), static_cast<int>(file->size()),
+        &width, &height, &channel, STBI_default);
+    stbi_image_free(data);
+    data = stbi_load_from_memory(
+        file->data(), static_cast<int>(file->size()),
+        &width, &height, &channel, STBI_rgb_alpha);
+    benchmark::DoNotOptimize(data);
+    stbi_image_free(data);
+  }
+  state.SetItemsProcessed(state.iterations() * width * height);
+}
+
+// Current way of loading RGB images: the image is decoded once and expanded
+// in place.
+void BM_DecodeOnceAndExpand(benchmark::State& state,
+                            const std::vector<uint8_t>* file) {
+  int width, height, channel;
+  for (auto _ : state) {
+    stbi_uc* data = stbi_load_from_memory(
+        file->data(), static_cast<int>(file->size()),
+        &width, &height, &channel, STBI_default);
+    const size_t num_pixels = width * height;
+    data = static_cast<stbi_uc*>(
+        memory_pool::Reallocate(data, num_pixels * kRgbaChannel));
+    ExpandRgbToRgba(data, num_pixels, data);
+    benchmark::DoNotOptimize(data);
+    stbi_image_free(data);
+  }
+  state.SetItemsProcessed(state.iterations() * width * height);
+}
+
+void BM_ExpandRgbToRgba(benchmark::State& state, int size) {
+  const size_t num_pixels = size * size;
+  const std::vector<uint8_t> rgb = CreateRgbImage(size);
+  std::vector<uint8_t> rgba(num_pixels * kRgbaChannel);
+  for (auto _ : state) {
+    ExpandRgbToRgba(rgb.data(), num_pixels, rgba.data());
+    benchmark::DoNotOptimize(rgba.data());
+  }
+  state.SetBytesProcessed(state.iterations() * rgba.size());
+}
+
+void BM_FlipVertically(benchmark::State& state, int size) {
+  std::vector<uint8_t> pixels(size * size * kRgbaChannel);
+  for (auto _ : state) {
+    FlipVertically(pixels.data(), size * kRgbaChannel, size, pixels.data());
+    benchmark::DoNotOptimize(pixels.data());
+  }
+  state.SetBytesProcessed(state.iterations() * pixels.size());
+}
+
+void BM_SwizzleChannels(benchmark::State& state, int size) {
+  const size_t num_pixels = size * size;
+  std::vector<uint8_t> pixels(num_pixels * kRgbaChannel);
+  for (auto _ : state) {
+    SwizzleChannels({2, 1, 0, 3}, num_pixels, pixels.data());
+    benchmark::DoNotOptimize(pixels.data());
+  }
+  state.SetBytesProcessed(state.iterations() * pixels.size());
+}
+
+void BM_SrgbToLinear(benchmark::State& state, int size) {
+  const size_t num_pixels = size * size;
+  const std::vector<uint8_t> srgb(num_pixels * kRgbaChannel, 128);
+  std::vector<float> linear(srgb.size());
+  for (auto _ : state) {
+    SrgbToLinear(srgb.data(), num_pixels, kRgbaChannel, linear.data());
+    benchmark::DoNotOptimize(linear.data());
+  }
+  state.SetItemsProcessed(state.iterations() * num_pixels);
+}
+
+void BM_LinearToSrgb(benchmark::State& state, int size) {
+  const size_t num_pixels = size * size;
+  std::vector<float> linear(num_pixels * kRgbaChannel);
+  for (size_t i = 0; i < linear.size(); ++i) {
+    linear[i] = static_cast<float>(i % 1000) / 1000.0f;
+  }
+  std::vector<uint8_t> srgb(linear.size());
+  for (auto _ : state) {
+    LinearToSrgb(linear.data(), num_pixels, kRgbaChannel, srgb.data());
+    benchmark::DoNotOptimize(srgb.data());
+  }
+  state.SetItemsProcessed(state.iterations() * num_pixels);
+}
+
+void BM_HalfToUnorm8(benchmark::State& state, int size) {
+  const size_t num_values = size * size * kRgbaChannel;
+  std::vector<uint8_t> unorm(num_values);
+  for (size_t i = 0; i < num_values; ++i) {
+    unorm[i] = static_cast<uint8_t>(i);
+  }
+  std::vector<uint16_t> halves(num_values);
+  Unorm8ToHalf(unorm.data(), num_values, halves.data());
+  for (auto _ : state) {
+    HalfToUnorm8(halves.data(), num_values, unorm.data());
+    benchmark::DoNotOptimize(unorm.data());
+  }
+  state.SetItemsProcessed(state.iterations() * num_values);
+}
+
+}  // namespace
+}  // namespace lighter::common::pixel_conversion
+
+int main(int argc, char* argv[]) {
+  using namespace lighter::common::pixel_conversion;
+
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+
+  const int image_size = absl::GetFlag(FLAGS_image_size);
+  const EncodedImages images{image_size};
+  for (const auto& [format, file] : {std::make_pair("Png", &images.png),
+                                     std::make_pair("Jpg", &images.jpg)}) {
+    benchmark::RegisterBenchmark(
+        absl::StrCat("BM_DecodeTwice/", format).c_str(), BM_DecodeTwice, file)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(
+        absl::StrCat("BM_DecodeOnceAndExpand/", format).c_str(),
+        BM_DecodeOnceAndExpand, file)
+        ->Unit(benchmark::kMillisecond);
+  }
+
+  benchmark::RegisterBenchmark("BM_ExpandRgbToRgba", BM_ExpandRgbToRgba,
+                               image_size)
+      ->Unit(benchmark::kMicrosecond);
+  benchmark::RegisterBenchmark("BM_FlipVertically", BM_FlipVertically,
+                               image_size)
+      ->Unit(benchmark::kMicrosecond);
+  benchmark::RegisterBenchmark("BM_SwizzleChannels", BM_SwizzleChannels,
+                               image_size)
+      ->Unit(benchmark::kMicrosecond);
+  benchmark::RegisterBenchmark("BM_SrgbToLinear", BM_SrgbToLinear, image_size)
+      ->Unit(benchmark::kMicrosecond);
+  benchmark::RegisterBenchmark("BM_LinearToSrgb", BM_LinearToSrgb, image_size)
+      ->Unit(benchmark::kMicrosecond);
+  benchmark::RegisterBenchmark("BM_HalfToUnorm8", BM_HalfToUnorm8, image_size)
+      ->Unit(benchmark::kMicrosecond);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
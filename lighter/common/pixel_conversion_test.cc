@@ -0,0 +1,178 @@
+//
+//  pixel_conversion_test.cc
+//
+//  Created by Pujun Lun on 6/22/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/pixel_conversion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "lighter/common/packing.h"
+
+#ifdef ASSERT_TRUE
+#undef ASSERT_TRUE
+#endif
+#ifdef ASSERT_FALSE
+#undef ASSERT_FALSE
+#endif
+#include "third_party/gtest/gtest.h"
+
+namespace lighter::common::pixel_conversion {
+namespace {
+
+// Not a multiple of any SIMD width, so that remainders are also tested.
+constexpr int kNumPixels = 1003;
+
+std::vector<uint8_t> GetRandomBytes(int num_bytes) {
+  std::mt19937 rand_gen{/*seed=*/0};
+  std::uniform_int_distribution<int> dist{0, 255};
+  std::vector<uint8_t> bytes(num_bytes);
+  for (uint8_t& byte : bytes) {
+    byte = static_cast<uint8_t>(dist(rand_gen));
+  }
+  return bytes;
+}
+
+TEST(PixelConversionTest, ExpandRgbToRgba) {
+  const std::vector<uint8_t> rgb = GetRandomBytes(kNumPixels * 3);
+  std::vector<uint8_t> expected;
+  for (int i = 0; i < kNumPixels; ++i) {
+    expected.insert(expected.end(), {rgb[i * 3], rgb[i * 3 + 1],
+                                     rgb[i * 3 + 2], 200});
+  }
+
+  std::vector<uint8_t> rgba(kNumPixels * 4);
+  ExpandRgbToRgba(rgb.data(), kNumPixels, rgba.data(), /*alpha=*/200);
+  EXPECT_EQ(rgba, expected);
+
+  std::vector<uint8_t> in_place = rgb;
+  in_place.resize(kNumPixels * 4);
+  ExpandRgbToRgba(in_place.data(), kNumPixels, in_place.data(), /*alpha=*/200);
+  EXPECT_EQ(in_place, expected);
+}
+
+TEST(PixelConversionTest, FlipVertically) {
+  constexpr int kRowSize = 7;
+  for (int num_rows : {1, 4, 5}) {
+    const std::vector<uint8_t> src = GetRandomBytes(kRowSize * num_rows);
+    std::vector<uint8_t> expected;
+    for (int row = num_rows - 1; row >= 0; --row) {
+      expected.insert(expected.end(), src.begin() + kRowSize * row,
+                      src.begin() + kRowSize * (row + 1));
+    }
+
+    std::vector<uint8_t> dst(src.size());
+    FlipVertically(src.data(), kRowSize, num_rows, dst.data());
+    EXPECT_EQ(dst, expected);
+
+    std::vector<uint8_t> in_place = src;
+    FlipVertically(in_place.data(), kRowSize, num_rows, in_place.data());
+    EXPECT_EQ(in_place, expected);
+  }
+}
+
+TEST(PixelConversionTest, SwizzleChannels) {
+  const std::vector<uint8_t> pixels = GetRandomBytes(kNumPixels * 4);
+  for (const std::array<int, 4>& order :
+       {std::array<int, 4>{2, 1, 0, 3}, std::array<int, 4>{3, 3, 0, 1}}) {
+    std::vector<uint8_t> expected;
+    for (int i = 0; i < kNumPixels; ++i) {
+      for (int c = 0; c < 4; ++c) {
+        expected.push_back(pixels[i * 4 + order[c]]);
+      }
+    }
+
+    std::vector<uint8_t> swizzled = pixels;
+    SwizzleChannels(order, kNumPixels, swizzled.data());
+    EXPECT_EQ(swizzled, expected);
+  }
+}
+
+TEST(PixelConversionTest, SrgbRoundTrip) {
+  std::vector<uint8_t> srgb(256 * 4);
+  for (int i = 0; i < 256; ++i) {
+    for (int c = 0; c < 4; ++c) {
+      srgb[i * 4 + c] = static_cast<uint8_t>(i);
+    }
+  }
+  std::vector<float> linear(srgb.size());
+  SrgbToLinear(srgb.data(), /*num_pixels=*/256, /*channel=*/4, linear.data());
+  for (int i = 0; i < 256; ++i) {
+    // Alpha is not affected by the transfer function.
+    EXPECT_FLOAT_EQ(linear[i * 4 + 3], i / 255.0f);
+  }
+  EXPECT_FLOAT_EQ(linear[0], 0.0f);
+  EXPECT_NEAR(linear[128 * 4], 0.2158605f, 1e-6f);
+  EXPECT_FLOAT_EQ(linear[255 * 4], 1.0f);
+
+  std::vector<uint8_t> round_trip(srgb.size());
+  LinearToSrgb(linear.data(), /*num_pixels=*/256, /*channel=*/4,
+               round_trip.data());
+  EXPECT_EQ(round_trip, srgb);
+}
+
+TEST(PixelConversionTest, LinearToSrgbRoundsToNearest) {
+  const auto encode = [](double value) {
+    value = std::clamp(value, 0.0, 1.0);
+    const double encoded = value <= 0.0031308
+        ? value * 12.92 : 1.055 * std::pow(value, 1.0 / 2.4) - 0.055;
+    return static_cast<int>(std::lround(encoded * 255.0));
+  };
+
+  std::mt19937 rand_gen{/*seed=*/0};
+  std::uniform_real_distribution<float> dist{-0.1f, 1.1f};
+  std::vector<float> linear(kNumPixels);
+  for (float& value : linear) {
+    value = dist(rand_gen);
+  }
+  // Small values that are close to the linear segment of the curve.
+  for (int i = 0; i < 100; ++i) {
+    linear[i] = i * 1e-5f;
+  }
+  linear[100] = std::numeric_limits<float>::quiet_NaN();
+
+  std::vector<uint8_t> srgb(kNumPixels);
+  LinearToSrgb(linear.data(), kNumPixels, /*channel=*/1, srgb.data());
+  EXPECT_EQ(srgb[100], 0);
+  for (int i = 0; i < kNumPixels; ++i) {
+    if (i != 100) {
+      EXPECT_EQ(srgb[i], encode(linear[i])) << "Input: " << linear[i];
+    }
+  }
+}
+
+TEST(PixelConversionTest, HalfConversion) {
+  std::vector<uint8_t> unorm(256);
+  for (int i = 0; i < 256; ++i) {
+    unorm[i] = static_cast<uint8_t>(i);
+  }
+  std::vector<uint16_t> halves(unorm.size());
+  Unorm8ToHalf(unorm.data(), unorm.size(), halves.data());
+  for (int i = 0; i < 256; ++i) {
+    EXPECT_EQ(halves[i], packing::FloatToHalf(i / 255.0f));
+  }
+
+  // Append values that should be clamped.
+  for (float value : {-1.0f, 2.0f, std::numeric_limits<float>::infinity(),
+                      std::numeric_limits<float>::quiet_NaN()}) {
+    halves.push_back(packing::FloatToHalf(value));
+  }
+  std::vector<uint8_t> round_trip(halves.size());
+  HalfToUnorm8(halves.data(), halves.size(), round_trip.data());
+  for (int i = 0; i < 256; ++i) {
+    EXPECT_EQ(round_trip[i], i);
+  }
+  EXPECT_EQ(round_trip[256], 0);
+  EXPECT_EQ(round_trip[257], 255);
+  EXPECT_EQ(round_trip[258], 255);
+  EXPECT_EQ(round_trip[259], 0);
+}
+
+}  // namespace
+}  // namespace lighter::common::pixel_conversion
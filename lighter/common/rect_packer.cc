@@ -0,0 +1,231 @@
+//
+//  rect_packer.cc
+//
+//  Created by Pujun Lun on 6/29/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/rect_packer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+#include "lighter/common/util.h"
+#include "third_party/absl/strings/str_format.h"
+
+namespace lighter::common {
+namespace {
+
+// Returns indices of 'sizes' sorted from the tallest to the shortest. Ties are
+// broken by preferring the wider one.
+std::vector<int> GetInsertionOrder(absl::Span<const glm::ivec2> sizes) {
+  std::vector<int> order(sizes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&sizes](int lhs, int rhs) {
+    return sizes[lhs].y != sizes[rhs].y ? sizes[lhs].y > sizes[rhs].y
+                                        : sizes[lhs].x > sizes[rhs].x;
+  });
+  return order;
+}
+
+}  // namespace
+
+RectPacker::RectPacker(const Config& config) : config_{config} {
+  ASSERT_TRUE(config_.padding >= 0,
+              absl::StrFormat("Padding must be non-negative, while %d provided",
+                              config_.padding));
+  ASSERT_TRUE(glm::all(glm::greaterThan(config_.page_size,
+                                        glm::ivec2{config_.padding * 2})),
+              absl::StrFormat("Page size (%d, %d) is too small for padding %d",
+                              config_.page_size.x, config_.page_size.y,
+                              config_.padding));
+}
+
+std::optional<RectPacker::Placement> RectPacker::Insert(
+    const glm::ivec2& size) {
+  ASSERT_TRUE(glm::all(glm::greaterThanEqual(size, glm::ivec2{0})) &&
+              glm::all(glm::lessThanEqual(
+                  size + config_.padding * 2, config_.page_size)),
+              absl::StrFormat("Rectangle of size (%d, %d) does not fit in page "
+                              "of size (%d, %d) with padding %d",
+                              size.x, size.y, config_.page_size.x,
+                              config_.page_size.y, config_.padding));
+  // Rectangles with zero area do not take any space.
+  if (size.x == 0 || size.y == 0) {
+    if (pages_.empty()) {
+      pages_.push_back(CreatePage());
+    }
+    return Placement{/*page=*/0, glm::ivec2{config_.padding}};
+  }
+
+  const glm::ivec2 padded_size = size + config_.padding;
+  for (int page = 0; page < pages_.size(); ++page) {
+    if (const auto offset = InsertIntoPage(padded_size, &pages_[page])) {
+      pages_[page].used_area += static_cast<int64_t>(size.x) * size.y;
+      return Placement{page, offset.value()};
+    }
+  }
+
+  if (config_.max_num_pages > 0 && pages_.size() >= config_.max_num_pages) {
+    return std::nullopt;
+  }
+  pages_.push_back(CreatePage());
+  const auto offset = InsertIntoPage(padded_size, &pages_.back());
+  pages_.back().used_area += static_cast<int64_t>(size.x) * size.y;
+  return Placement{num_pages() - 1, offset.value()};
+}
+
+std::vector<RectPacker::Placement> RectPacker::InsertAll(
+    absl::Span<const glm::ivec2> sizes) {
+  std::vector<Placement> placements(sizes.size());
+  for (const int index : GetInsertionOrder(sizes)) {
+    const auto placement = Insert(sizes[index]);
+    ASSERT_HAS_VALUE(placement,
+                     absl::StrFormat("Failed to pack %d rectangles into %d "
+                                     "pages", sizes.size(),
+                                     config_.max_num_pages));
+    placements[index] = placement.value();
+  }
+  return placements;
+}
+
+void RectPacker::ClearPage(int page) {
+  pages_.at(page) = CreatePage();
+}
+
+float RectPacker::GetOccupancy() const {
+  if (pages_.empty()) {
+    return 0.0f;
+  }
+  int64_t used_area = 0;
+  for (const auto& page : pages_) {
+    used_area += page.used_area;
+  }
+  const auto page_area =
+      static_cast<int64_t>(config_.page_size.x) * config_.page_size.y;
+  return static_cast<float>(used_area) / (page_area * pages_.size());
+}
+
+RectPacker::Page RectPacker::CreatePage() const {
+  const int padding = config_.padding;
+  return Page{
+      /*skyline=*/{SkylineSegment{padding, padding,
+                                  config_.page_size.x - padding}},
+      /*used_area=*/0,
+      /*used_extent=*/glm::ivec2{padding},
+  };
+}
+
+std::optional<glm::ivec2> RectPacker::InsertIntoPage(
+    const glm::ivec2& padded_size, Page* page) const {
+  auto& skyline = page->skyline;
+
+  // Find the segment where the top edge of the rectangle would be the lowest if
+  // the rectangle is aligned with the left end of that segment. Ties are broken
+  // by preferring the leftmost one.
+  int best_index = -1;
+  glm::ivec2 best_offset{0, std::numeric_limits<int>::max()};
+  for (int i = 0; i < skyline.size(); ++i) {
+    const int x = skyline[i].x;
+    if (x + padded_size.x > config_.page_size.x) {
+      break;
+    }
+    int y = 0;
+    for (int j = i, covered_width = 0; covered_width < padded_size.x; ++j) {
+      y = std::max(y, skyline[j].y);
+      covered_width += skyline[j].width;
+    }
+    if (y + padded_size.y <= config_.page_size.y && y < best_offset.y) {
+      best_index = i;
+      best_offset = glm::ivec2{x, y};
+    }
+  }
+  if (best_index == -1) {
+    return std::nullopt;
+  }
+
+  // Raise the skyline above the rectangle. Segments that are fully covered are
+  // removed, and the one partially covered is shortened.
+  const int right = best_offset.x + padded_size.x;
+  skyline.insert(skyline.begin() + best_index,
+                 SkylineSegment{best_offset.x, best_offset.y + padded_size.y,
+                                padded_size.x});
+  const auto first_covered = skyline.begin() + best_index + 1;
+  auto last_covered = first_covered;
+  while (last_covered != skyline.end() &&
+         last_covered->x + last_covered->width <= right) {
+    ++last_covered;
+  }
+  if (last_covered != skyline.end() && last_covered->x < right) {
+    last_covered->width -= right - last_covered->x;
+    last_covered->x = right;
+  }
+  skyline.erase(first_covered, last_covered);
+
+  // Merge adjacent segments at the same height.
+  int num_merged = 0;
+  for (int i = 1; i < skyline.size(); ++i) {
+    if (skyline[i].y == skyline[num_merged].y) {
+      skyline[num_merged].width += skyline[i].width;
+    } else {
+      skyline[++num_merged] = skyline[i];
+    }
+  }
+  skyline.resize(num_merged + 1);
+
+  page->used_extent =
+      glm::max(page->used_extent, best_offset + padded_size);
+  return best_offset;
+}
+
+SinglePagePacking PackIntoSinglePage(absl::Span<const glm::ivec2> sizes,
+                                     int padding, int max_dimension) {
+  if (sizes.empty()) {
+    return SinglePagePacking{glm::ivec2{padding * 2 + 1}, /*placements=*/{}};
+  }
+
+  int64_t total_area = 0;
+  int min_width = padding * 2 + 1;
+  for (const auto& size : sizes) {
+    total_area += static_cast<int64_t>(size.x + padding) * (size.y + padding);
+    min_width = std::max(min_width, size.x + padding * 2);
+  }
+
+  // The page is as tall as allowed, so that only the width is searched. Since
+  // rectangles are packed from the bottom, the used height will be about the
+  // same as the width if the width is close to the square root of the area.
+  constexpr float kWidthGrowthFactor = 1.25f;
+  const std::vector<int> order = GetInsertionOrder(sizes);
+  int width = std::max(
+      min_width, static_cast<int>(std::ceil(std::sqrt(total_area))));
+  while (true) {
+    width = std::min(width, max_dimension);
+    RectPacker packer{RectPacker::Config{
+        glm::ivec2{width, max_dimension}, padding, /*max_num_pages=*/1}};
+    std::vector<RectPacker::Placement> placements(sizes.size());
+    bool succeeded = true;
+    for (const int index : order) {
+      const auto placement = packer.Insert(sizes[index]);
+      if (!placement.has_value()) {
+        succeeded = false;
+        break;
+      }
+      placements[index] = placement.value();
+    }
+
+    if (succeeded) {
+      return SinglePagePacking{
+          glm::max(packer.GetUsedExtent(/*page=*/0), glm::ivec2{1}),
+          std::move(placements)};
+    }
+    ASSERT_TRUE(width < max_dimension,
+                absl::StrFormat("Failed to pack %d rectangles into one page "
+                                "with maximum dimension %d",
+                                sizes.size(), max_dimension));
+    width = static_cast<int>(width * kWidthGrowthFactor) + 1;
+  }
+}
+
+}  // namespace lighter::common
@@ -0,0 +1,136 @@
+//
+//  rect_packer.h
+//
+//  Created by Pujun Lun on 6/29/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#ifndef LIGHTER_COMMON_RECT_PACKER_H
+#define LIGHTER_COMMON_RECT_PACKER_H
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "third_party/absl/types/span.h"
+#include "third_party/glm/glm.hpp"
+
+namespace lighter::common {
+
+// Packs rectangles into pages of a fixed size, which is useful for building
+// texture atlases. Each page is packed with the skyline bottom-left algorithm:
+// the top edge of packed rectangles is tracked as a list of horizontal
+// segments, and each rectangle is placed where its top edge would be the
+// lowest. Rectangles are not rotated.
+// All sizes and offsets are in number of pixels.
+class RectPacker {
+ public:
+  struct Config {
+    glm::ivec2 page_size;
+
+    // Number of pixels kept empty between any two rectangles, and between
+    // rectangles and borders of pages, so that sampling one rectangle with
+    // linear filtering will not pick up pixels of another one.
+    int padding = 0;
+
+    // If positive, Insert() will fail instead of opening more pages.
+    int max_num_pages = 0;
+  };
+
+  // Location of a packed rectangle.
+  struct Placement {
+    // Index of the page that the rectangle is on.
+    int page;
+
+    // Coordinate of the corner with the smallest X and Y.
+    glm::ivec2 offset;
+  };
+
+  explicit RectPacker(const Config& config);
+
+  // This class is only movable.
+  RectPacker(RectPacker&&) noexcept = default;
+  RectPacker& operator=(RectPacker&&) noexcept = default;
+
+  // Packs a rectangle of 'size' into the first page that has room for it. If
+  // no page has room, a new page will be opened, unless that would exceed
+  // 'max_num_pages', in which case this returns std::nullopt.
+  // 'size' must fit in an empty page. Rectangles with zero area do not take any
+  // space.
+  std::optional<Placement> Insert(const glm::ivec2& size);
+
+  // Packs all rectangles of 'sizes', and returns placements in the same order.
+  // Rectangles are inserted from the tallest to the shortest, which leaves less
+  // wasted space under the skyline than inserting them in the given order.
+  // All rectangles must be packed, hence if 'max_num_pages' is positive, it
+  // must be large enough.
+  std::vector<Placement> InsertAll(absl::Span<const glm::ivec2> sizes);
+
+  // Empties 'page', so that its space can be reused. Placements previously
+  // returned for this page will no longer be valid.
+  void ClearPage(int page);
+
+  // Returns the ratio of the area covered by packed rectangles, excluding
+  // padding, to the total area of all pages.
+  float GetOccupancy() const;
+
+  // Returns the extent of the smallest region that starts from the origin and
+  // encloses all rectangles packed on 'page', including padding.
+  const glm::ivec2& GetUsedExtent(int page) const {
+    return pages_.at(page).used_extent;
+  }
+
+  // Accessors.
+  const Config& config() const { return config_; }
+  int num_pages() const { return pages_.size(); }
+
+ private:
+  // A horizontal segment of the skyline. The space below 'y' within
+  // ['x', 'x' + 'width') is considered used.
+  struct SkylineSegment {
+    int x;
+    int y;
+    int width;
+  };
+
+  struct Page {
+    // Segments are sorted by X and cover the full width of the page.
+    std::vector<SkylineSegment> skyline;
+    int64_t used_area;
+    glm::ivec2 used_extent;
+  };
+
+  // Returns an empty page.
+  Page CreatePage() const;
+
+  // Packs a rectangle whose size, including padding, is 'padded_size' into
+  // 'page', and returns its offset. Returns std::nullopt if 'page' does not
+  // have room for it.
+  std::optional<glm::ivec2> InsertIntoPage(const glm::ivec2& padded_size,
+                                           Page* page) const;
+
+  // Configurations of pages.
+  Config config_;
+
+  // Pages that have been opened.
+  std::vector<Page> pages_;
+};
+
+// Result of PackIntoSinglePage().
+struct SinglePagePacking {
+  glm::ivec2 page_size;
+  std::vector<RectPacker::Placement> placements;
+};
+
+// Packs all rectangles of 'sizes' into one page, whose width and height are
+// not greater than 'max_dimension'. The width starts from the square root of
+// the total area and grows until all rectangles fit, and the page is then
+// shrunk to enclose packed rectangles tightly. Placements are in the same order as
+// 'sizes'. If rectangles do not fit even in the largest page, this will throw a
+// runtime exception.
+SinglePagePacking PackIntoSinglePage(absl::Span<const glm::ivec2> sizes,
+                                     int padding, int max_dimension);
+
+}  // namespace lighter::common
+
+#endif  // LIGHTER_COMMON_RECT_PACKER_H
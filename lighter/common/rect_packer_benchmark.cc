@@ -0,0 +1,116 @@
+//
+//  rect_packer_benchmark.cc
+//
+//  Created by Pujun Lun on 6/29/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include <random>
+#include <vector>
+
+#include "lighter/common/rect_packer.h"
+#include "third_party/absl/flags/flag.h"
+#include "third_party/absl/flags/parse.h"
+#include "third_party/benchmark/benchmark.h"
+#include "third_party/glm/glm.hpp"
+
+ABSL_FLAG(int, font_height, 64, "Height of generated glyphs in pixels");
+ABSL_FLAG(int, padding, 2, "Padding between packed rectangles in pixels");
+ABSL_FLAG(int, page_size, 1024, "Width and height of pages in pixels");
+
+namespace lighter::common {
+namespace {
+
+// Maximum width and height of the packed page. This is the minimum value of
+// maxImageDimension2D guaranteed by Vulkan.
+constexpr int kMaxDimension = 4096;
+
+// Returns sizes of 'num_glyphs' rectangles that resemble glyphs rendered with
+// 'font_height'. Widths and heights vary widely, as those of glyphs do.
+std::vector<glm::ivec2> GenerateGlyphSizes(int num_glyphs, int font_height) {
+  std::mt19937 rand_gen{/*seed=*/0};
+  std::uniform_int_distribution<int> width_dist{font_height / 8,
+                                                font_height * 3 / 4};
+  std::uniform_int_distribution<int> height_dist{font_height / 4, font_height};
+  std::vector<glm::ivec2> sizes(num_glyphs);
+  for (auto& size : sizes) {
+    size = glm::ivec2{width_dist(rand_gen), height_dist(rand_gen)};
+  }
+  return sizes;
+}
+
+// Returns the total area of 'sizes'.
+double GetTotalArea(const std::vector<glm::ivec2>& sizes) {
+  double area = 0.0;
+  for (const auto& size : sizes) {
+    area += static_cast<double>(size.x) * size.y;
+  }
+  return area;
+}
+
+// Packs glyphs into one page, as CharLoader does. Also reports the width that
+// the atlas would have if glyphs were laid out in one row.
+void BM_PackIntoSinglePage(benchmark::State& state) {
+  const int padding = absl::GetFlag(FLAGS_padding);
+  const auto sizes = GenerateGlyphSizes(
+      state.range(0), absl::GetFlag(FLAGS_font_height));
+  SinglePagePacking packing;
+  for (auto _ : state) {
+    packing = PackIntoSinglePage(sizes, padding, kMaxDimension);
+    benchmark::DoNotOptimize(packing.placements.data());
+  }
+
+  int row_width = 0;
+  for (const auto& size : sizes) {
+    row_width += size.x + padding;
+  }
+  state.counters["occupancy"] =
+      GetTotalArea(sizes) / packing.page_size.x / packing.page_size.y;
+  state.counters["width"] = packing.page_size.x;
+  state.counters["height"] = packing.page_size.y;
+  state.counters["row_width"] = row_width;
+  state.SetItemsProcessed(state.iterations() * sizes.size());
+}
+
+// Packs glyphs into pages of a fixed size, as a glyph cache does.
+void BM_InsertIntoPages(benchmark::State& state) {
+  const RectPacker::Config config{
+      glm::ivec2{absl::GetFlag(FLAGS_page_size)},
+      absl::GetFlag(FLAGS_padding)};
+  const auto sizes = GenerateGlyphSizes(
+      state.range(0), absl::GetFlag(FLAGS_font_height));
+  float occupancy = 0.0f;
+  int num_pages = 0;
+  for (auto _ : state) {
+    RectPacker packer{config};
+    for (const auto& size : sizes) {
+      benchmark::DoNotOptimize(packer.Insert(size));
+    }
+    occupancy = packer.GetOccupancy();
+    num_pages = packer.num_pages();
+  }
+  state.counters["occupancy"] = occupancy;
+  state.counters["pages"] = num_pages;
+  state.SetItemsProcessed(state.iterations() * sizes.size());
+}
+
+}  // namespace
+}  // namespace lighter::common
+
+int main(int argc, char* argv[]) {
+  using namespace lighter::common;
+
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+
+  // Arguments are the number of glyphs, which range from printable ASCII
+  // characters to a common CJK character set.
+  benchmark::RegisterBenchmark("BM_PackIntoSinglePage", BM_PackIntoSinglePage)
+      ->ArgName("glyphs")->Arg(95)->Arg(1000)->Arg(3500)
+      ->Unit(benchmark::kMicrosecond);
+  benchmark::RegisterBenchmark("BM_InsertIntoPages", BM_InsertIntoPages)
+      ->ArgName("glyphs")->Arg(95)->Arg(1000)->Arg(3500)
+      ->Unit(benchmark::kMicrosecond);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
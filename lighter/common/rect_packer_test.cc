@@ -0,0 +1,115 @@
+//
+//  rect_packer_test.cc
+//
+//  Created by Pujun Lun on 6/29/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/rect_packer.h"
+
+#include <random>
+#include <vector>
+
+#include "third_party/glm/glm.hpp"
+#include "third_party/gtest/gtest.h"
+
+namespace lighter::common {
+namespace {
+
+using Placement = RectPacker::Placement;
+
+// Returns 'num_rects' rectangles with random sizes in range [1, 'max_size'].
+std::vector<glm::ivec2> GenerateSizes(int num_rects, int max_size) {
+  std::mt19937 generator{/*seed=*/0};
+  std::uniform_int_distribution<int> distribution{1, max_size};
+  std::vector<glm::ivec2> sizes(num_rects);
+  for (auto& size : sizes) {
+    size = glm::ivec2{distribution(generator), distribution(generator)};
+  }
+  return sizes;
+}
+
+// Expects all rectangles to be within pages and kept 'padding' apart from each
+// other and from borders of pages.
+void ExpectValidPlacements(absl::Span<const glm::ivec2> sizes,
+                           absl::Span<const Placement> placements,
+                           const glm::ivec2& page_size, int padding) {
+  ASSERT_EQ(sizes.size(), placements.size());
+  for (int i = 0; i < sizes.size(); ++i) {
+    const glm::ivec2 min = placements[i].offset;
+    const glm::ivec2 max = min + sizes[i];
+    EXPECT_TRUE(glm::all(glm::greaterThanEqual(min, glm::ivec2{padding})));
+    EXPECT_TRUE(glm::all(glm::lessThanEqual(max + padding, page_size)));
+
+    for (int j = i + 1; j < sizes.size(); ++j) {
+      if (placements[i].page != placements[j].page) {
+        continue;
+      }
+      const glm::ivec2 other_min = placements[j].offset - padding;
+      const glm::ivec2 other_max = placements[j].offset + sizes[j] + padding;
+      const bool overlaps = glm::all(glm::lessThan(min, other_max)) &&
+                            glm::all(glm::greaterThan(max, other_min));
+      EXPECT_FALSE(overlaps) << "Rectangles " << i << " and " << j;
+    }
+  }
+}
+
+TEST(RectPackerTest, NoOverlap) {
+  const glm::ivec2 page_size{256, 256};
+  constexpr int kPadding = 2;
+  RectPacker packer{{page_size, kPadding}};
+  const auto sizes = GenerateSizes(/*num_rects=*/300, /*max_size=*/32);
+  const auto placements = packer.InsertAll(sizes);
+  ExpectValidPlacements(sizes, placements, page_size, kPadding);
+  EXPECT_GT(packer.num_pages(), 1);
+  EXPECT_GT(packer.GetOccupancy(), 0.5f);
+}
+
+TEST(RectPackerTest, FillRows) {
+  RectPacker packer{{/*page_size=*/glm::ivec2{4, 4}}};
+  for (int y = 0; y < 4; y += 2) {
+    for (int x = 0; x < 4; x += 2) {
+      const auto placement = packer.Insert(glm::ivec2{2, 2});
+      ASSERT_TRUE(placement.has_value());
+      EXPECT_EQ(placement->page, 0);
+      EXPECT_EQ(placement->offset, (glm::ivec2{x, y}));
+    }
+  }
+  EXPECT_FLOAT_EQ(packer.GetOccupancy(), 1.0f);
+  EXPECT_EQ(packer.Insert(glm::ivec2{1, 1})->page, 1);
+}
+
+TEST(RectPackerTest, MaxNumPages) {
+  RectPacker packer{{/*page_size=*/glm::ivec2{10, 10}, /*padding=*/1,
+                     /*max_num_pages=*/2}};
+  EXPECT_TRUE(packer.Insert(glm::ivec2{8, 8}).has_value());
+  EXPECT_TRUE(packer.Insert(glm::ivec2{8, 8}).has_value());
+  EXPECT_FALSE(packer.Insert(glm::ivec2{8, 8}).has_value());
+  EXPECT_EQ(packer.num_pages(), 2);
+
+  packer.ClearPage(/*page=*/0);
+  const auto placement = packer.Insert(glm::ivec2{8, 8});
+  ASSERT_TRUE(placement.has_value());
+  EXPECT_EQ(placement->page, 0);
+  EXPECT_EQ(placement->offset, glm::ivec2{1});
+}
+
+TEST(RectPackerTest, SinglePage) {
+  constexpr int kPadding = 1;
+  constexpr int kMaxDimension = 4096;
+  const auto sizes = GenerateSizes(/*num_rects=*/200, /*max_size=*/40);
+  const SinglePagePacking packing =
+      PackIntoSinglePage(sizes, kPadding, kMaxDimension);
+  ExpectValidPlacements(sizes, packing.placements, packing.page_size,
+                        kPadding);
+  for (const auto& placement : packing.placements) {
+    EXPECT_EQ(placement.page, 0);
+  }
+
+  // The page should be roughly square.
+  EXPECT_LT(packing.page_size.x, packing.page_size.y * 2);
+  EXPECT_LT(packing.page_size.y, packing.page_size.x * 2);
+}
+
+}  // namespace
+}  // namespace lighter::common
@@ -9,6 +9,7 @@
 #define LIGHTER_COMMON_REF_COUNT_H
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 
@@ -74,6 +75,27 @@ class RefCountedObject {
     return RefCountedObject{identifier, ref_counted_object.object.get()};
   }
 
+  // Returns the object with 'identifier' and increases its reference count if
+  // it is still living in the objects pool. Otherwise, returns std::nullopt.
+  static std::optional<RefCountedObject> GetIfExists(
+      const std::string& identifier) {
+    const auto iter = ref_count_map().find(identifier);
+    if (iter == ref_count_map().end()) {
+      return std::nullopt;
+    }
+#ifndef NDEBUG
+    LOG_INFO << "Cache hit: " << identifier;
+#endif  // !NDEBUG
+    auto& ref_counted_object = iter->second;
+    ++ref_counted_object.ref_count;
+    return RefCountedObject{identifier, ref_counted_object.object.get()};
+  }
+
+  // Returns true if the object with 'identifier' is living in the objects pool.
+  static bool Contains(const std::string& identifier) {
+    return ref_count_map().contains(identifier);
+  }
+
   // This class is only movable.
   RefCountedObject(RefCountedObject&& rhs) noexcept {
     identifier_ = std::move(rhs.identifier_);
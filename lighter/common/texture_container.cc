@@ -0,0 +1,323 @@
+//
+//  texture_container.cc
+//
+//  Created by Pujun Lun on 6/25/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/texture_container.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "lighter/common/util.h"
+#include "third_party/absl/strings/match.h"
+#include "third_party/absl/strings/str_format.h"
+
+namespace lighter::common {
+namespace {
+
+namespace stdfs = std::filesystem;
+
+using Format = TextureContainer::Format;
+
+// "LTEX" in little endian. This also helps detect files written on platforms
+// of different endianness.
+constexpr uint32_t kMagic = 0x5845544C;
+
+// Must be bumped whenever the layout of files changes.
+constexpr uint32_t kVersion = 1;
+
+// Offset of each level is aligned to this, which also satisfies the alignment
+// required for copying data from buffers to images.
+constexpr size_t kLevelAlignment = 16;
+
+// Header of files. It is followed by 'num_levels' instances of LevelIndex, and
+// then data of levels.
+struct Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t layer;
+  uint32_t num_levels;
+  uint32_t padding;
+  uint64_t file_size;
+};
+
+// Locates data of one level. Data of all layers starts at 'offset' relative to
+// the beginning of the file.
+struct LevelIndex {
+  uint64_t offset;
+  uint64_t layer_size;
+};
+
+// Returns 'offset' rounded up to the next multiple of kLevelAlignment.
+size_t AlignOffset(size_t offset) {
+  return (offset + kLevelAlignment - 1) / kLevelAlignment * kLevelAlignment;
+}
+
+// Returns the size of data of a 'width' x 'height' image in 'format'.
+size_t GetLayerSize(Format format, int width, int height) {
+  const auto bc_format = TextureContainer::GetBlockCompressionFormat(format);
+  if (bc_format.has_value()) {
+    return block_compression::GetEncodedSize(bc_format.value(), width, height);
+  }
+  return static_cast<size_t>(width) * height *
+         TextureContainer::GetNumChannels(format);
+}
+
+// Returns the first 'num_levels' levels of an image in 'format'.
+std::vector<TextureContainer::Level> ComputeLevels(Format format, int width,
+                                                   int height,
+                                                   int num_levels) {
+  std::vector<TextureContainer::Level> levels;
+  levels.reserve(num_levels);
+  for (int level = 0; level < num_levels; ++level) {
+    levels.push_back({width, height, GetLayerSize(format, width, height)});
+    width = std::max(width / 2, 1);
+    height = std::max(height / 2, 1);
+  }
+  return levels;
+}
+
+// Returns the format of uncompressed images with 'channel' channels.
+Format GetUncompressedFormat(int channel) {
+  switch (channel) {
+    case image::kBwImageChannel:
+      return Format::kR8;
+    case image::kRgbaImageChannel:
+      return Format::kRgba8;
+    default:
+      FATAL(absl::StrFormat("Unsupported number of channels: %d", channel));
+  }
+}
+
+// Returns the format that 'format' corresponds to.
+Format GetCompressedFormat(block_compression::Format format) {
+  switch (format) {
+    case block_compression::Format::kBc1:
+      return Format::kBc1;
+    case block_compression::Format::kBc3:
+      return Format::kBc3;
+    case block_compression::Format::kBc4:
+      return Format::kBc4;
+    case block_compression::Format::kBc5:
+      return Format::kBc5;
+    case block_compression::Format::kBc7:
+      return Format::kBc7;
+  }
+  FATAL("Unrecognized format");
+}
+
+}  // namespace
+
+bool TextureContainer::IsTextureContainerPath(std::string_view path) {
+  return absl::EndsWith(path, kFileExtension);
+}
+
+std::optional<block_compression::Format>
+TextureContainer::GetBlockCompressionFormat(Format format) {
+  switch (format) {
+    case Format::kR8:
+    case Format::kRgba8:
+      return std::nullopt;
+    case Format::kBc1:
+      return block_compression::Format::kBc1;
+    case Format::kBc3:
+      return block_compression::Format::kBc3;
+    case Format::kBc4:
+      return block_compression::Format::kBc4;
+    case Format::kBc5:
+      return block_compression::Format::kBc5;
+    case Format::kBc7:
+      return block_compression::Format::kBc7;
+  }
+  FATAL("Unrecognized format");
+}
+
+int TextureContainer::GetNumChannels(Format format) {
+  switch (format) {
+    case Format::kR8:
+      return image::kBwImageChannel;
+    case Format::kRgba8:
+      return image::kRgbaImageChannel;
+    default:
+      return block_compression::GetNumChannels(
+          GetBlockCompressionFormat(format).value());
+  }
+}
+
+std::unique_ptr<TextureContainer> TextureContainer::LoadFromFile(
+    std::string_view path) {
+  std::unique_ptr<TextureContainer> container{new TextureContainer};
+  container->file_data_ =
+      std::make_unique<RawData>(path, RawData::Mode::kMemoryMapped);
+  ASSERT_TRUE(container->Parse(container->file_data_->GetSpan()),
+              absl::StrFormat("Malformed texture container '%s'", path));
+  return container;
+}
+
+std::unique_ptr<TextureContainer> TextureContainer::Create(
+    const Image& image) {
+  return Create(GetUncompressedFormat(image.channel()), image.width(),
+                image.height(), image.layer(), /*num_levels=*/1,
+                image.data_ptrs());
+}
+
+std::unique_ptr<TextureContainer> TextureContainer::Create(
+    const MipChain& mip_chain) {
+  return Create(GetUncompressedFormat(mip_chain.channel()), mip_chain.width(),
+                mip_chain.height(), mip_chain.layer(), mip_chain.num_levels(),
+                mip_chain.data_ptrs());
+}
+
+std::unique_ptr<TextureContainer> TextureContainer::Create(
+    const CompressedImage& compressed_image) {
+  return Create(GetCompressedFormat(compressed_image.format()),
+                compressed_image.width(), compressed_image.height(),
+                compressed_image.layer(), compressed_image.num_levels(),
+                compressed_image.data_ptrs());
+}
+
+std::unique_ptr<TextureContainer> TextureContainer::Create(
+    Format format, int width, int height, int layer, int num_levels,
+    absl::Span<const void* const> datas) {
+  ASSERT_TRUE(layer == image::kSingleImageLayer
+                  || layer == image::kCubemapImageLayer,
+              absl::StrFormat("Unsupported number of images: %d", layer));
+  ASSERT_TRUE(datas.size() == static_cast<size_t>(num_levels) * layer,
+              absl::StrFormat("Expecting %d images, while %d provided",
+                              num_levels * layer, datas.size()));
+
+  const std::vector<Level> levels = ComputeLevels(format, width, height,
+                                                  num_levels);
+  std::vector<LevelIndex> level_indices;
+  level_indices.reserve(num_levels);
+  size_t offset = AlignOffset(sizeof(Header) +
+                              sizeof(LevelIndex) * num_levels);
+  for (const auto& level : levels) {
+    level_indices.push_back({offset, level.layer_size});
+    offset = AlignOffset(offset + level.layer_size * layer);
+  }
+
+  Header header{};
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.format = static_cast<uint32_t>(format);
+  header.width = width;
+  header.height = height;
+  header.layer = layer;
+  header.num_levels = num_levels;
+  header.file_size = offset;
+
+  // Paddings between levels are zero.
+  std::unique_ptr<TextureContainer> container{new TextureContainer};
+  std::vector<char>& buffer = container->buffer_;
+  buffer.resize(header.file_size);
+  std::memcpy(buffer.data(), &header, sizeof(header));
+  std::memcpy(buffer.data() + sizeof(header), level_indices.data(),
+              sizeof(LevelIndex) * level_indices.size());
+  for (int level = 0; level < num_levels; ++level) {
+    const size_t layer_size = levels[level].layer_size;
+    for (int layer_index = 0; layer_index < layer; ++layer_index) {
+      std::memcpy(buffer.data() + level_indices[level].offset +
+                      layer_size * layer_index,
+                  datas[level * layer + layer_index], layer_size);
+    }
+  }
+
+  ASSERT_TRUE(container->Parse(buffer),
+              "Failed to parse the texture container just created");
+  return container;
+}
+
+bool TextureContainer::WriteToFile(std::string_view path) const {
+  const stdfs::path file_path{path};
+  const stdfs::path temp_path = file_path.string() + ".tmp";
+  std::error_code error_code;
+  if (file_path.has_parent_path()) {
+    stdfs::create_directories(file_path.parent_path(), error_code);
+  }
+  {
+    std::ofstream file{temp_path,
+                       std::ios::out | std::ios::binary | std::ios::trunc};
+    if (file) {
+      file.write(data_.data(), data_.size());
+    }
+    if (!file) {
+      LOG_ERROR << absl::StreamFormat("Failed to write texture container '%s'",
+                                      temp_path.string());
+      return false;
+    }
+  }
+  stdfs::rename(temp_path, file_path, error_code);
+  if (error_code) {
+    LOG_ERROR << absl::StreamFormat("Failed to rename '%s' to '%s': %s",
+                                    temp_path.string(), file_path.string(),
+                                    error_code.message());
+    stdfs::remove(temp_path, error_code);
+    return false;
+  }
+  return true;
+}
+
+bool TextureContainer::Parse(absl::Span<const char> data) {
+  if (data.size() < sizeof(Header)) {
+    return false;
+  }
+  Header header;
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != kMagic || header.version != kVersion ||
+      header.file_size != data.size() ||
+      header.format > static_cast<uint32_t>(Format::kBc7) ||
+      header.width == 0 || header.height == 0 ||
+      (header.layer != image::kSingleImageLayer &&
+       header.layer != image::kCubemapImageLayer) ||
+      header.num_levels == 0 ||
+      static_cast<int>(header.num_levels) >
+          MipChain::GetNumLevels(header.width, header.height) ||
+      data.size() < sizeof(Header) + sizeof(LevelIndex) * header.num_levels) {
+    return false;
+  }
+
+  const auto format = static_cast<Format>(header.format);
+  std::vector<Level> levels = ComputeLevels(format, header.width,
+                                            header.height, header.num_levels);
+  std::vector<LevelIndex> level_indices(header.num_levels);
+  std::memcpy(level_indices.data(), data.data() + sizeof(Header),
+              sizeof(LevelIndex) * level_indices.size());
+
+  // Levels must be aligned, in order, and within the file, so that pointers
+  // into the file can be used for uploading directly.
+  std::vector<const void*> data_ptrs;
+  data_ptrs.reserve(levels.size() * header.layer);
+  uint64_t min_offset = sizeof(Header) + sizeof(LevelIndex) * header.num_levels;
+  for (int level = 0; level < levels.size(); ++level) {
+    const LevelIndex& index = level_indices[level];
+    const uint64_t level_size = index.layer_size * header.layer;
+    if (index.layer_size != levels[level].layer_size ||
+        index.offset % kLevelAlignment != 0 || index.offset < min_offset ||
+        index.offset > header.file_size ||
+        level_size > header.file_size - index.offset) {
+      return false;
+    }
+    for (int layer = 0; layer < header.layer; ++layer) {
+      data_ptrs.push_back(data.data() + index.offset +
+                          index.layer_size * layer);
+    }
+    min_offset = index.offset + level_size;
+  }
+
+  data_ = data;
+  format_ = format;
+  layer_ = header.layer;
+  levels_ = std::move(levels);
+  data_ptrs_ = std::move(data_ptrs);
+  return true;
+}
+
+}  // namespace lighter::common
@@ -0,0 +1,143 @@
+//
+//  texture_container.h
+//
+//  Created by Pujun Lun on 6/25/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#ifndef LIGHTER_COMMON_TEXTURE_CONTAINER_H
+#define LIGHTER_COMMON_TEXTURE_CONTAINER_H
+
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "lighter/common/block_compression.h"
+#include "lighter/common/compressed_image.h"
+#include "lighter/common/file.h"
+#include "lighter/common/image.h"
+#include "lighter/common/mip_chain.h"
+#include "third_party/absl/types/span.h"
+
+namespace lighter::common {
+
+// GPU-ready texture file, similar to KTX2. It stores the format, extent, all
+// layers (6 for cubemaps) and all mip levels, so that textures can be uploaded
+// without decoding. Files are produced offline from PNG/JPEG images (see
+// lighter/texture_converter), and are memory mapped when loaded, hence data
+// pointers point into the mapping and data is only copied once, from the
+// mapping to staging buffers.
+// The file starts with a header, followed by a level index that records the
+// offset and size of each level. Unlike KTX2, levels are stored from the
+// largest to the smallest, and layers of each level are stored contiguously,
+// which is the order that textures are uploaded in. The offset of each level
+// is aligned to 16 bytes, which satisfies the alignment required for copying
+// data from buffers to images of any supported format.
+class TextureContainer {
+ public:
+  // Formats of texels. Uncompressed formats are 8-bit per channel.
+  enum class Format { kR8, kRgba8, kBc1, kBc3, kBc4, kBc5, kBc7 };
+
+  // Describes one level. 'layer_size' is the size of data of each layer in
+  // bytes, which are tightly packed.
+  struct Level {
+    int width;
+    int height;
+    size_t layer_size;
+  };
+
+  // Extension of texture container files.
+  static constexpr std::string_view kFileExtension = ".ltex";
+
+  // Returns true if 'path' has kFileExtension.
+  static bool IsTextureContainerPath(std::string_view path);
+
+  // Returns the block-compressed format that 'format' corresponds to, or
+  // std::nullopt if 'format' is not block-compressed.
+  static std::optional<block_compression::Format> GetBlockCompressionFormat(
+      Format format);
+
+  // Returns the number of channels of texels decoded from 'format'.
+  static int GetNumChannels(Format format);
+
+  // Loads the texture container from the file at 'path' by memory mapping it.
+  // An exception will be thrown if the file is malformed.
+  static std::unique_ptr<TextureContainer> LoadFromFile(std::string_view path);
+
+  // Creates a texture container that holds the only level of 'image', all
+  // levels of 'mip_chain', or all levels of 'compressed_image'. Data is copied,
+  // hence the source doesn't need to outlive the returned object.
+  static std::unique_ptr<TextureContainer> Create(const Image& image);
+  static std::unique_ptr<TextureContainer> Create(const MipChain& mip_chain);
+  static std::unique_ptr<TextureContainer> Create(
+      const CompressedImage& compressed_image);
+
+  // This class is neither copyable nor movable.
+  TextureContainer(const TextureContainer&) = delete;
+  TextureContainer& operator=(const TextureContainer&) = delete;
+
+  // Writes the texture container to 'path'. The file is first written to a
+  // temporary path and then renamed, so readers never see a partially written
+  // file. Returns false if failed.
+  bool WriteToFile(std::string_view path) const;
+
+  // Returns the pointer to data of 'layer' of 'level'.
+  const void* GetData(int level, int layer) const {
+    return data_ptrs_[level * this->layer() + layer];
+  }
+
+  // Returns true if texels are block-compressed.
+  bool is_block_compressed() const {
+    return GetBlockCompressionFormat(format_).has_value();
+  }
+
+  // Accessors.
+  Format format() const { return format_; }
+  int width() const { return levels_[0].width; }
+  int height() const { return levels_[0].height; }
+  int channel() const { return GetNumChannels(format_); }
+  int layer() const { return layer_; }
+  int num_levels() const { return static_cast<int>(levels_.size()); }
+  const std::vector<Level>& levels() const { return levels_; }
+  // Pointers to data of each layer of each level, ordered by level and then by
+  // layer.
+  const std::vector<const void*>& data_ptrs() const { return data_ptrs_; }
+
+ private:
+  // Creates a texture container that holds 'num_levels' levels of images in
+  // 'format'. 'width' and 'height' are the extent of the first level. 'datas'
+  // is ordered in the same way as 'data_ptrs_'.
+  static std::unique_ptr<TextureContainer> Create(
+      Format format, int width, int height, int layer, int num_levels,
+      absl::Span<const void* const> datas);
+
+  // Interprets 'data' as the content of a texture container file. Returns
+  // false if it is malformed.
+  bool Parse(absl::Span<const char> data);
+
+  TextureContainer() = default;
+
+  // Holds the content of the file if loaded from disk.
+  std::unique_ptr<RawData> file_data_;
+
+  // Holds the content of the file if created in memory.
+  std::vector<char> buffer_;
+
+  // Content of the file, pointing to either 'file_data_' or 'buffer_'.
+  absl::Span<const char> data_;
+
+  // Format of texels.
+  Format format_ = Format::kRgba8;
+
+  // Number of layers.
+  int layer_ = 0;
+
+  // Views into 'data_'.
+  std::vector<Level> levels_;
+  std::vector<const void*> data_ptrs_;
+};
+
+}  // namespace lighter::common
+
+#endif  // LIGHTER_COMMON_TEXTURE_CONTAINER_H
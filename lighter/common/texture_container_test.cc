@@ -0,0 +1,125 @@
+//
+//  texture_container_test.cc
+//
+//  Created by Pujun Lun on 6/25/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/texture_container.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "lighter/common/compressed_image.h"
+#include "lighter/common/image.h"
+#include "lighter/common/mip_chain.h"
+
+#ifdef ASSERT_TRUE
+#undef ASSERT_TRUE
+#endif
+#ifdef ASSERT_FALSE
+#undef ASSERT_FALSE
+#endif
+#include "third_party/gtest/gtest.h"
+
+namespace lighter::common {
+namespace {
+
+using Format = TextureContainer::Format;
+
+// Returns a cubemap mip chain of 'size' x 'size' texels with 'channel'
+// channels.
+std::unique_ptr<MipChain> CreateMipChain(int size, int channel) {
+  std::vector<std::vector<uint8_t>> layers;
+  std::vector<const void*> layer_datas;
+  for (int layer = 0; layer < image::kCubemapImageLayer; ++layer) {
+    auto& pixels = layers.emplace_back();
+    for (int i = 0; i < size * size * channel; ++i) {
+      pixels.push_back(static_cast<uint8_t>(i * (layer + 1)));
+    }
+    layer_datas.push_back(pixels.data());
+  }
+  return MipChain::Generate(
+      Image::Dimension{size, size, channel, image::kCubemapImageLayer},
+      layer_datas, MipChain::Options{});
+}
+
+// Returns a path in the temporary directory.
+std::string GetTempPath(const std::string& file_name) {
+  return (std::filesystem::temp_directory_path() / file_name).string();
+}
+
+// Writes 'container' to a file, loads it back and checks that the content is
+// unchanged.
+void ExpectRoundTrip(const TextureContainer& container) {
+  const std::string path = GetTempPath("texture_container_test.ltex");
+  ASSERT_TRUE(container.WriteToFile(path));
+  const auto loaded = TextureContainer::LoadFromFile(path);
+  EXPECT_EQ(loaded->format(), container.format());
+  EXPECT_EQ(loaded->width(), container.width());
+  EXPECT_EQ(loaded->height(), container.height());
+  EXPECT_EQ(loaded->layer(), container.layer());
+  ASSERT_EQ(loaded->num_levels(), container.num_levels());
+  for (int level = 0; level < loaded->num_levels(); ++level) {
+    const size_t layer_size = loaded->levels()[level].layer_size;
+    EXPECT_EQ(layer_size, container.levels()[level].layer_size);
+    // Levels must be aligned for copying to images.
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(loaded->GetData(level, 0)) % 16, 0);
+    for (int layer = 0; layer < loaded->layer(); ++layer) {
+      EXPECT_EQ(std::memcmp(loaded->GetData(level, layer),
+                            container.GetData(level, layer), layer_size), 0);
+    }
+  }
+  std::filesystem::remove(path);
+}
+
+TEST(TextureContainerTest, UncompressedMipChain) {
+  const auto mip_chain = CreateMipChain(/*size=*/30, image::kRgbaImageChannel);
+  const auto container = TextureContainer::Create(*mip_chain);
+  EXPECT_EQ(container->format(), Format::kRgba8);
+  EXPECT_FALSE(container->is_block_compressed());
+  EXPECT_EQ(container->num_levels(), mip_chain->num_levels());
+  for (int level = 0; level < container->num_levels(); ++level) {
+    for (int layer = 0; layer < container->layer(); ++layer) {
+      EXPECT_EQ(std::memcmp(container->GetData(level, layer),
+                            mip_chain->GetData(level, layer),
+                            mip_chain->levels()[level].layer_size), 0);
+    }
+  }
+  ExpectRoundTrip(*container);
+}
+
+TEST(TextureContainerTest, CompressedMipChain) {
+  const auto mip_chain = CreateMipChain(/*size=*/16, image::kBwImageChannel);
+  const auto compressed_image =
+      CompressedImage::Encode(*mip_chain, CompressedImage::Options{});
+  const auto container = TextureContainer::Create(*compressed_image);
+  EXPECT_EQ(container->format(), Format::kBc4);
+  EXPECT_TRUE(container->is_block_compressed());
+  EXPECT_EQ(container->channel(), image::kBwImageChannel);
+  ExpectRoundTrip(*container);
+}
+
+TEST(TextureContainerTest, RejectMalformedFiles) {
+  const auto mip_chain = CreateMipChain(/*size=*/8, image::kBwImageChannel);
+  const auto container = TextureContainer::Create(*mip_chain);
+  const std::string path = GetTempPath("texture_container_test_bad.ltex");
+  ASSERT_TRUE(container->WriteToFile(path));
+
+  // Truncate the file.
+  std::filesystem::resize_file(path,
+                               std::filesystem::file_size(path) - 1);
+  EXPECT_ANY_THROW(TextureContainer::LoadFromFile(path));
+  std::filesystem::remove(path);
+}
+
+TEST(TextureContainerTest, FileExtension) {
+  EXPECT_TRUE(TextureContainer::IsTextureContainerPath("a/b/sky.ltex"));
+  EXPECT_FALSE(TextureContainer::IsTextureContainerPath("a/b/sky.png"));
+}
+
+}  // namespace
+}  // namespace lighter::common
@@ -0,0 +1,88 @@
+//
+//  utf8.cc
+//
+//  Created by Pujun Lun on 6/30/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/utf8.h"
+
+#include <cstdint>
+
+namespace lighter::common::utf8 {
+namespace {
+
+// Largest codepoint defined by Unicode.
+constexpr char32_t kMaxCodepoint = 0x10FFFF;
+
+// Range of surrogates, which are not valid codepoints on their own.
+constexpr char32_t kMinSurrogate = 0xD800;
+constexpr char32_t kMaxSurrogate = 0xDFFF;
+
+// Returns true if 'byte' is a continuation byte, i.e. 0b10xxxxxx.
+inline bool IsContinuationByte(uint8_t byte) { return (byte & 0xC0U) == 0x80U; }
+
+}  // namespace
+
+char32_t DecodeNext(std::string_view text, int* pos) {
+  const auto lead = static_cast<uint8_t>(text[*pos]);
+  if (lead < 0x80U) {
+    ++*pos;
+    return lead;
+  }
+
+  // Number of continuation bytes, and the smallest codepoint that needs this
+  // many bytes, which is used to reject overlong encodings.
+  int num_continuation_bytes;
+  char32_t min_codepoint;
+  char32_t codepoint;
+  if ((lead & 0xE0U) == 0xC0U) {
+    num_continuation_bytes = 1;
+    min_codepoint = 0x80;
+    codepoint = lead & 0x1FU;
+  } else if ((lead & 0xF0U) == 0xE0U) {
+    num_continuation_bytes = 2;
+    min_codepoint = 0x800;
+    codepoint = lead & 0x0FU;
+  } else if ((lead & 0xF8U) == 0xF0U) {
+    num_continuation_bytes = 3;
+    min_codepoint = 0x10000;
+    codepoint = lead & 0x07U;
+  } else {
+    ++*pos;
+    return kReplacementCodepoint;
+  }
+
+  if (*pos + num_continuation_bytes >= static_cast<int>(text.size())) {
+    ++*pos;
+    return kReplacementCodepoint;
+  }
+  for (int i = 1; i <= num_continuation_bytes; ++i) {
+    const auto byte = static_cast<uint8_t>(text[*pos + i]);
+    if (!IsContinuationByte(byte)) {
+      ++*pos;
+      return kReplacementCodepoint;
+    }
+    codepoint = (codepoint << 6U) | (byte & 0x3FU);
+  }
+
+  if (codepoint < min_codepoint || codepoint > kMaxCodepoint ||
+      (codepoint >= kMinSurrogate && codepoint <= kMaxSurrogate)) {
+    ++*pos;
+    return kReplacementCodepoint;
+  }
+  *pos += num_continuation_bytes + 1;
+  return codepoint;
+}
+
+std::u32string Decode(std::string_view text) {
+  std::u32string codepoints;
+  codepoints.reserve(text.size());
+  int pos = 0;
+  while (pos < text.size()) {
+    codepoints.push_back(DecodeNext(text, &pos));
+  }
+  return codepoints;
+}
+
+}  // namespace lighter::common::utf8
@@ -0,0 +1,31 @@
+//
+//  utf8.h
+//
+//  Created by Pujun Lun on 6/30/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#ifndef LIGHTER_COMMON_UTF8_H
+#define LIGHTER_COMMON_UTF8_H
+
+#include <string>
+#include <string_view>
+
+namespace lighter::common::utf8 {
+
+// Codepoint that replaces malformed sequences when decoding.
+constexpr char32_t kReplacementCodepoint = 0xFFFD;
+
+// Decodes the codepoint that starts at byte '*pos' of 'text', and advances
+// '*pos' to the start of the next codepoint. '*pos' must be less than the size
+// of 'text'. Malformed sequences, including overlong encodings, surrogates and
+// truncated sequences, are decoded as kReplacementCodepoint, and only their
+// first byte is consumed, so that decoding can resynchronize.
+char32_t DecodeNext(std::string_view text, int* pos);
+
+// Decodes all codepoints of 'text'.
+std::u32string Decode(std::string_view text);
+
+}  // namespace lighter::common::utf8
+
+#endif  // LIGHTER_COMMON_UTF8_H
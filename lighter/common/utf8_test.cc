@@ -0,0 +1,49 @@
+//
+//  utf8_test.cc
+//
+//  Created by Pujun Lun on 6/30/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/common/utf8.h"
+
+#include "third_party/gtest/gtest.h"
+
+namespace lighter::common::utf8 {
+namespace {
+
+TEST(Utf8Test, DecodeValidSequences) {
+  // 1, 2, 3 and 4 bytes respectively.
+  EXPECT_EQ(Decode("a\xC3\xA9\xE4\xB8\xAD\xF0\x9F\x98\x80"),
+            (std::u32string{U'a', 0xE9, 0x4E2D, 0x1F600}));
+  EXPECT_EQ(Decode(""), std::u32string{});
+}
+
+TEST(Utf8Test, ReplaceMalformedSequences) {
+  constexpr char32_t kReplacement = kReplacementCodepoint;
+  // Stray continuation byte.
+  EXPECT_EQ(Decode("\x80" "a"), (std::u32string{kReplacement, U'a'}));
+  // Truncated sequence.
+  EXPECT_EQ(Decode("\xE4\xB8"), (std::u32string{kReplacement, kReplacement}));
+  // Missing continuation byte.
+  EXPECT_EQ(Decode("\xC3" "a"), (std::u32string{kReplacement, U'a'}));
+  // Overlong encoding of '/'.
+  EXPECT_EQ(Decode("\xC0\xAF"), (std::u32string{kReplacement, kReplacement}));
+  // Surrogate.
+  EXPECT_EQ(Decode("\xED\xA0\x80"),
+            (std::u32string{kReplacement, kReplacement, kReplacement}));
+  // Beyond the largest codepoint.
+  EXPECT_EQ(Decode("\xF4\x90\x80\x80").front(), kReplacement);
+}
+
+TEST(Utf8Test, DecodeNextAdvancesPosition) {
+  const std::string_view text = "\xC3\xA9z";
+  int pos = 0;
+  EXPECT_EQ(DecodeNext(text, &pos), 0xE9);
+  EXPECT_EQ(pos, 2);
+  EXPECT_EQ(DecodeNext(text, &pos), U'z');
+  EXPECT_EQ(pos, 3);
+}
+
+}  // namespace
+}  // namespace lighter::common::utf8
@@ -7,10 +7,13 @@
 
 #include "lighter/common/util.h"
 
+#include <atomic>
 #include <chrono>
 #include <ctime>
+#include <exception>
 #include <iomanip>
 #include <sstream>
+#include <thread>
 
 namespace lighter::common::util {
 
@@ -28,4 +31,97 @@ std::string GetCurrentTime() {
   return stream.str();
 }
 
+int GetNumHardwareThreads() {
+  // std::thread::hardware_concurrency() may return 0 if it is not computable.
+  return std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+}
+
+namespace {
+
+// Whether ParallelFor() should run tasks sequentially on the current thread.
+// This is true while the thread is running a task of ParallelFor(), or while a
+// ScopedSequentialExecution is alive on it.
+thread_local bool should_run_sequentially = false;
+
+}  // namespace
+
+ScopedSequentialExecution::ScopedSequentialExecution()
+    : previous_value_{should_run_sequentially} {
+  should_run_sequentially = true;
+}
+
+ScopedSequentialExecution::~ScopedSequentialExecution() {
+  should_run_sequentially = previous_value_;
+}
+
+void ParallelFor(int num_tasks, const std::function<void(int)>& task) {
+  if (num_tasks <= 1) {
+    if (num_tasks == 1) {
+      // Keep the contract that nested tasks run sequentially, even though
+      // this single task runs on the calling thread.
+      const ScopedSequentialExecution sequential_execution;
+      task(0);
+    }
+    return;
+  }
+
+  // Exceptions can't cross thread boundaries, so we store them and rethrow
+  // after all threads finish. Tasks that call ParallelFor() again run nested
+  // tasks sequentially, so that threads are not multiplied.
+  std::vector<std::exception_ptr> exceptions(num_tasks);
+  const auto run_task = [&task, &exceptions](int index) {
+    const ScopedSequentialExecution sequential_execution;
+    try {
+      task(index);
+    } catch (...) {
+      exceptions[index] = std::current_exception();
+    }
+  };
+
+  if (should_run_sequentially) {
+    for (int i = 0; i < num_tasks; ++i) {
+      run_task(i);
+    }
+  } else {
+    // The calling thread also runs one of the tasks.
+    std::vector<std::thread> threads;
+    threads.reserve(num_tasks - 1);
+    for (int i = 1; i < num_tasks; ++i) {
+      threads.emplace_back(run_task, i);
+    }
+    run_task(0);
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  for (const auto& exception : exceptions) {
+    if (exception != nullptr) {
+      std::rethrow_exception(exception);
+    }
+  }
+}
+
+void ParallelForWithWorkers(int num_tasks, int num_workers,
+                            const std::function<void(int)>& task) {
+  num_workers = std::clamp(num_workers, 1, std::max(num_tasks, 1));
+  std::atomic<int> next_index{0};
+  std::vector<std::exception_ptr> exceptions(num_tasks);
+  ParallelFor(num_workers, [&](int /*worker*/) {
+    for (int index = next_index++; index < num_tasks; index = next_index++) {
+      try {
+        task(index);
+      } catch (...) {
+        exceptions[index] = std::current_exception();
+      }
+    }
+  });
+
+  for (const auto& exception : exceptions) {
+    if (exception != nullptr) {
+      std::rethrow_exception(exception);
+    }
+  }
+}
+
 }  // namespace lighter::common::util
@@ -98,6 +98,46 @@ class Logger {
   std::ostream& os_;
 };
 
+// Returns the number of threads that can run concurrently, which is at least 1.
+int GetNumHardwareThreads();
+
+// While an instance of this class is alive, ParallelFor() and
+// ParallelForWithWorkers() called on the same thread run all tasks sequentially
+// on that thread. This should be used by long-lived worker threads that are
+// already running in parallel, so that nested parallel loops do not spawn
+// another set of threads per worker.
+class ScopedSequentialExecution {
+ public:
+  ScopedSequentialExecution();
+
+  // This class is neither copyable nor movable.
+  ScopedSequentialExecution(const ScopedSequentialExecution&) = delete;
+  ScopedSequentialExecution& operator=(const ScopedSequentialExecution&) =
+      delete;
+
+  ~ScopedSequentialExecution();
+
+ private:
+  // Whether tasks were run sequentially before this instance is constructed.
+  const bool previous_value_;
+};
+
+// Calls 'task' with each index in range [0, 'num_tasks'). Each task runs on a
+// separate thread, and this function returns after all of them finish. If any
+// task throws an exception, it will be rethrown on the calling thread.
+// If this is called from a task of another ParallelFor(), or while a
+// ScopedSequentialExecution is alive on the calling thread, tasks run
+// sequentially on the calling thread instead.
+void ParallelFor(int num_tasks, const std::function<void(int)>& task);
+
+// Calls 'task' with each index in range [0, 'num_tasks') on at most
+// 'num_workers' threads, including the calling thread. Each worker keeps taking
+// the next index until none is left, which balances the load if tasks take
+// different amounts of time. Exceptions are handled in the same way as
+// ParallelFor().
+void ParallelForWithWorkers(int num_tasks, int num_workers,
+                            const std::function<void(int)>& task);
+
 namespace internal {
 
 template <typename ContainerType>
@@ -0,0 +1,113 @@
+//
+//  vertex_stream_benchmark.cc
+//
+//  Created by Pujun Lun on 6/19/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include <random>
+#include <vector>
+
+#include "lighter/common/file.h"
+#include "third_party/absl/flags/flag.h"
+#include "third_party/absl/flags/parse.h"
+#include "third_party/benchmark/benchmark.h"
+#include "third_party/glm/glm.hpp"
+
+ABSL_FLAG(int, num_vertices, 1 << 20, "Number of vertices to convert");
+
+namespace lighter::common {
+namespace {
+
+// Returns 'num_vertices' vertices with random attributes.
+std::vector<Vertex3DWithTex> GenerateVertices(int num_vertices) {
+  std::mt19937 rand_gen{/*seed=*/0};
+  std::uniform_real_distribution<float> dist{-1.0f, 1.0f};
+  std::vector<Vertex3DWithTex> vertices(num_vertices);
+  for (auto& vertex : vertices) {
+    vertex.pos = {dist(rand_gen), dist(rand_gen), dist(rand_gen)};
+    vertex.norm = glm::normalize(
+        glm::vec3{dist(rand_gen), dist(rand_gen), dist(rand_gen)});
+    vertex.tex_coord = {dist(rand_gen), dist(rand_gen)};
+  }
+  return vertices;
+}
+
+void BM_SplitVertices(benchmark::State& state,
+                      const std::vector<Vertex3DWithTex>* vertices) {
+  for (auto _ : state) {
+    const SplitVertexStreams streams = SplitVertices(*vertices);
+    benchmark::DoNotOptimize(streams.positions.data());
+    benchmark::DoNotOptimize(streams.attributes.data());
+  }
+  state.SetItemsProcessed(state.iterations() * vertices->size());
+  state.SetBytesProcessed(state.iterations() * vertices->size() *
+                          sizeof(Vertex3DWithTex));
+}
+
+void BM_InterleaveVertices(benchmark::State& state,
+                           const std::vector<Vertex3DWithTex>* vertices) {
+  const SplitVertexStreams streams = SplitVertices(*vertices);
+  for (auto _ : state) {
+    const std::vector<Vertex3DWithTex> interleaved =
+        InterleaveVertices(streams.positions, streams.attributes);
+    benchmark::DoNotOptimize(interleaved.data());
+  }
+  state.SetItemsProcessed(state.iterations() * vertices->size());
+  state.SetBytesProcessed(state.iterations() * vertices->size() *
+                          sizeof(Vertex3DWithTex));
+}
+
+// Reads positions only, which is what a depth-only pass does, to compare the
+// memory traffic of interleaved and split layouts.
+void BM_ReadInterleavedPositions(benchmark::State& state,
+                                 const std::vector<Vertex3DWithTex>* vertices) {
+  for (auto _ : state) {
+    glm::vec3 sum{0.0f};
+    for (const auto& vertex : *vertices) {
+      sum += vertex.pos;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * vertices->size());
+}
+
+void BM_ReadSplitPositions(benchmark::State& state,
+                           const std::vector<Vertex3DWithTex>* vertices) {
+  const SplitVertexStreams streams = SplitVertices(*vertices);
+  for (auto _ : state) {
+    glm::vec3 sum{0.0f};
+    for (const auto& vertex : streams.positions) {
+      sum += vertex.pos;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * vertices->size());
+}
+
+}  // namespace
+}  // namespace lighter::common
+
+int main(int argc, char* argv[]) {
+  using namespace lighter::common;
+
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+
+  const std::vector<Vertex3DWithTex> vertices =
+      GenerateVertices(absl::GetFlag(FLAGS_num_vertices));
+  benchmark::RegisterBenchmark("BM_SplitVertices", BM_SplitVertices,
+                               &vertices)
+      ->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark("BM_InterleaveVertices", BM_InterleaveVertices,
+                               &vertices)
+      ->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark("BM_ReadInterleavedPositions",
+                               BM_ReadInterleavedPositions, &vertices)
+      ->Unit(benchmark::kMicrosecond);
+  benchmark::RegisterBenchmark("BM_ReadSplitPositions", BM_ReadSplitPositions,
+                               &vertices)
+      ->Unit(benchmark::kMicrosecond);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
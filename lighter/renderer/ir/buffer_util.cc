@@ -22,6 +22,21 @@ DataFormat GetDataFormat<glm::vec2>() { return DataFormat::kSFloat32Vec2; }
 template <>
 DataFormat GetDataFormat<glm::vec3>() { return DataFormat::kSFloat32Vec3; }
 
+template <>
+DataFormat GetDataFormat<common::HalfVec2>() {
+  return DataFormat::kSFloat16Vec2;
+}
+
+template <>
+DataFormat GetDataFormat<common::Snorm16Vec2>() {
+  return DataFormat::kSNorm16Vec2;
+}
+
+template <>
+DataFormat GetDataFormat<common::Snorm16Vec4>() {
+  return DataFormat::kSNorm16Vec4;
+}
+
 }  // namespace
 
 #define CREATE_ATTRIBUTE(type, member, location) \
@@ -62,6 +77,24 @@ std::vector<VertexBufferView::Attribute> CreateAttributesForVertex3DWithTex(
   };
 }
 
+std::vector<VertexBufferView::Attribute> CreateAttributesForVertex3DCompressed(
+    int loc_pos, int loc_norm, int loc_tex_coord) {
+  return {
+      CREATE_ATTRIBUTE(common::Vertex3DCompressed, pos, loc_pos),
+      CREATE_ATTRIBUTE(common::Vertex3DCompressed, norm, loc_norm),
+      CREATE_ATTRIBUTE(common::Vertex3DCompressed, tex_coord, loc_tex_coord),
+  };
+}
+
+std::vector<VertexBufferView::Attribute> CreateAttributesForVertex3DQuantized(
+    int loc_pos, int loc_norm, int loc_tex_coord) {
+  return {
+      CREATE_ATTRIBUTE(common::Vertex3DQuantized, pos, loc_pos),
+      CREATE_ATTRIBUTE(common::Vertex3DQuantized, norm, loc_norm),
+      CREATE_ATTRIBUTE(common::Vertex3DQuantized, tex_coord, loc_tex_coord),
+  };
+}
+
 #undef CREATE_ATTRIBUTE
 
 }  // namespace lighter::renderer::ir::buffer
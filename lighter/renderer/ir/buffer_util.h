@@ -29,6 +29,12 @@ std::vector<VertexBufferView::Attribute> CreateAttributesForVertex3DWithColor(
 std::vector<VertexBufferView::Attribute> CreateAttributesForVertex3DWithTex(
     int loc_pos, int loc_norm, int loc_tex_coord);
 
+std::vector<VertexBufferView::Attribute> CreateAttributesForVertex3DCompressed(
+    int loc_pos, int loc_norm, int loc_tex_coord);
+
+std::vector<VertexBufferView::Attribute> CreateAttributesForVertex3DQuantized(
+    int loc_pos, int loc_norm, int loc_tex_coord);
+
 }  // namespace lighter::renderer::ir::buffer
 
 #endif  // LIGHTER_RENDERER_IR_BUFFER_UTIL_H
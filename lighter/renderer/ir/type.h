@@ -10,11 +10,22 @@
 
 namespace lighter::renderer::ir {
 
+// Formats of vertex attributes. Except for 32-bit floats, only formats with 2
+// and 4 components are listed, since formats with 3 components are not widely
+// supported for vertex buffers.
 enum class DataFormat {
   kSFloat32,
   kSFloat32Vec2,
   kSFloat32Vec3,
   kSFloat32Vec4,
+  kSFloat16Vec2,
+  kSFloat16Vec4,
+  kSNorm8Vec2,
+  kSNorm8Vec4,
+  kSNorm16Vec2,
+  kSNorm16Vec4,
+  kUNorm16Vec2,
+  kUNorm16Vec4,
 };
 
 // Specifies the rate at which vertex attributes are pulled from the buffer.
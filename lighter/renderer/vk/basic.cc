@@ -408,9 +408,12 @@ Device::Device(const Context* context, bool enable_validation,
   #endif  // VK_KHR_PORTABILITY_SUBSET_EXTENSION_NAME
 
   // Request support for anisotropy filtering. This should be safe as we have
-  // checked that during physical device creation.
+  // checked that during physical device creation. Block-compressed textures
+  // are optional, hence only requested if available.
   const auto required_features = intl::PhysicalDeviceFeatures{}
-      .setSamplerAnisotropy(true);
+      .setSamplerAnisotropy(true)
+      .setTextureCompressionBC(
+          physical_device->getFeatures().textureCompressionBC);
   const auto device_create_info = intl::DeviceCreateInfo{}
       .setQueueCreateInfos(queue_create_infos)
       .setPEnabledLayerNames(required_layers)
@@ -80,6 +80,25 @@ intl::Format ChooseColorImageFormat(const Context& context, int channel,
   }
 }
 
+// Returns the image format of block-compressed 'format'.
+intl::Format ConvertCompressedImageFormat(
+    common::block_compression::Format format) {
+  using common::block_compression::Format;
+  switch (format) {
+    case Format::kBc1:
+      return intl::Format::eBc1RgbUnormBlock;
+    case Format::kBc3:
+      return intl::Format::eBc3UnormBlock;
+    case Format::kBc4:
+      return intl::Format::eBc4UnormBlock;
+    case Format::kBc5:
+      return intl::Format::eBc5UnormBlock;
+    case Format::kBc7:
+      return intl::Format::eBc7UnormBlock;
+  }
+  FATAL("Unrecognized format");
+}
+
 intl::Format ChooseDepthStencilImageFormat(const Context& context) {
   const auto format = FindImageFormatWithFeature(
       context, {intl::Format::eD24UnormS8Uint, intl::Format::eD32SfloatS8Uint},
@@ -152,6 +171,27 @@ std::unique_ptr<DeviceImage> GeneralDeviceImage::CreateColorImage(
       CAST_TO_UINT(dimension.layer), MultisamplingMode::kNone, usages));
 }
 
+std::unique_ptr<DeviceImage> GeneralDeviceImage::CreateColorImage(
+    const SharedContext& context, std::string_view name,
+    const common::CompressedImage& image,
+    absl::Span<const ImageUsage> usages) {
+  const intl::Format format = ConvertCompressedImageFormat(image.format());
+  ASSERT_TRUE(
+      FindImageFormatWithFeature(
+          *context, {format},
+          intl::FormatFeatureFlagBits::eSampledImage |
+              intl::FormatFeatureFlagBits::eSampledImageFilterLinear)
+          .has_value(),
+      absl::StrFormat("Block-compressed format %d is not supported",
+                      static_cast<int>(image.format())));
+  ASSERT_FALSE(ImageUsage::IsLinearAccessed(usages),
+               "Block-compressed images can't be linearly accessed");
+  return absl::WrapUnique(new GeneralDeviceImage(
+      context, name, format, util::CreateExtent(image.width(), image.height()),
+      CAST_TO_UINT(image.num_levels()), CAST_TO_UINT(image.layer()),
+      MultisamplingMode::kNone, usages));
+}
+
 std::unique_ptr<DeviceImage> GeneralDeviceImage::CreateDepthStencilImage(
     const SharedContext& context, std::string_view name,
     const intl::Extent2D& extent, MultisamplingMode multisampling_mode,
@@ -11,6 +11,7 @@
 #include <memory>
 #include <string_view>
 
+#include "lighter/common/compressed_image.h"
 #include "lighter/common/image.h"
 #include "lighter/common/util.h"
 #include "lighter/renderer/ir/image.h"
@@ -61,6 +62,13 @@ class GeneralDeviceImage : public WithSharedContext,
       const common::Image& image, bool generate_mipmaps,
       absl::Span<const ir::ImageUsage> usages);
 
+  // Creates an image that holds all levels of 'image' in its block-compressed
+  // format. The device must support sampling images in that format.
+  static std::unique_ptr<DeviceImage> CreateColorImage(
+      const SharedContext& context, std::string_view name,
+      const common::CompressedImage& image,
+      absl::Span<const ir::ImageUsage> usages);
+
   static std::unique_ptr<DeviceImage> CreateDepthStencilImage(
       const SharedContext& context, std::string_view name,
       const intl::Extent2D& extent, ir::MultisamplingMode multisampling_mode,
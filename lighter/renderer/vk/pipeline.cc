@@ -270,7 +270,8 @@ intl::PipelineColorBlendStateCreateInfo GetColorBlendStateCreateInfo(
 ShaderModule::ShaderModule(const SharedContext& context,
                            std::string_view file_path)
     : WithSharedContext{context} {
-  const auto raw_data = std::make_unique<common::RawData>(file_path);
+  const auto raw_data = std::make_unique<common::RawData>(
+      file_path, common::RawData::Mode::kMemoryMapped);
   const auto shader_module_create_info = intl::ShaderModuleCreateInfo{}
       .setCodeSize(raw_data->size)
       .setPCode(reinterpret_cast<const uint32_t*>(raw_data->data));
@@ -31,6 +31,14 @@ intl::Format ConvertDataFormat(DataFormat format) {
     CONVERT_ALIAS(SFloat32Vec2, R32G32Sfloat);
     CONVERT_ALIAS(SFloat32Vec3, R32G32B32Sfloat);
     CONVERT_ALIAS(SFloat32Vec4, R32G32B32A32Sfloat);
+    CONVERT_ALIAS(SFloat16Vec2, R16G16Sfloat);
+    CONVERT_ALIAS(SFloat16Vec4, R16G16B16A16Sfloat);
+    CONVERT_ALIAS(SNorm8Vec2, R8G8Snorm);
+    CONVERT_ALIAS(SNorm8Vec4, R8G8B8A8Snorm);
+    CONVERT_ALIAS(SNorm16Vec2, R16G16Snorm);
+    CONVERT_ALIAS(SNorm16Vec4, R16G16B16A16Snorm);
+    CONVERT_ALIAS(UNorm16Vec2, R16G16Unorm);
+    CONVERT_ALIAS(UNorm16Vec4, R16G16B16A16Unorm);
   }
   #undef CONVERT_ALIAS
 }
@@ -7,7 +7,11 @@
 
 #include "lighter/renderer/vulkan/extension/model.h"
 
+#include <algorithm>
+#include <optional>
+
 #include "lighter/common/file.h"
+#include "lighter/common/mesh_cache.h"
 #include "lighter/renderer/ir/image_usage.h"
 #include "third_party/absl/strings/str_format.h"
 
@@ -16,21 +20,94 @@ namespace renderer {
 namespace vulkan {
 namespace {
 
+using common::Vertex3DCompressed;
+using common::Vertex3DNormTex;
+using common::Vertex3DPosOnly;
+using common::Vertex3DQuantized;
 using common::Vertex3DWithTex;
 using VertexInfo = PerVertexBuffer::NoShareIndicesDataInfo;
 
+// Vertex streams are bound to consecutive binding points starting from this,
+// followed by per-instance buffers.
 constexpr uint32_t kPerVertexBufferBindingPoint = 0;
-constexpr uint32_t kPerInstanceBufferBindingPointBase = 1;
 
-// Visits variants of TextureSource and constructs a texture from 'source'.
+// Number of per-vertex attributes, which doesn't depend on the vertex format.
+constexpr uint32_t kNumPerVertexAttributes = 3;
+
+// Returns true if textures of 'type' hold sRGB encoded colors. Other types
+// hold linear data, such as specular intensities.
+bool IsSrgbTexture(ModelBuilder::TextureType type) {
+  using TextureType = ModelBuilder::TextureType;
+  return type == TextureType::kDiffuse || type == TextureType::kCubemap;
+}
+
+// Returns textures at 'source_paths' in the same order. 'texture_types' holds
+// the type of each texture, which determines its color space. If
+// 'texture_streamer' is not nullptr, textures are requested from it with
+// 'priority', and this returns immediately. Otherwise, textures of the same
+// color space are loaded at once, so that they are decoded concurrently.
+std::vector<SharedTexture> LoadSharedTextures(
+    const SharedBasicContext& context, TextureStreamer* texture_streamer,
+    TextureStreamer::Priority priority,
+    absl::Span<const SharedTexture::SourcePath> source_paths,
+    absl::Span<const ModelBuilder::TextureType> texture_types) {
+  ASSERT_TRUE(source_paths.size() == texture_types.size(),
+              absl::StrFormat("Number of texture types (%d) does not match "
+                              "number of source paths (%d)",
+                              texture_types.size(), source_paths.size()));
+  const auto image_usages = {ImageUsage::GetSampledInFragmentShaderUsage()};
+  const int num_textures = static_cast<int>(source_paths.size());
+  if (texture_streamer != nullptr) {
+    std::vector<SharedTexture> textures;
+    textures.reserve(num_textures);
+    for (int i = 0; i < num_textures; ++i) {
+      textures.push_back(texture_streamer->Request(
+          source_paths[i], image_usages, ImageSampler::Config{},
+          IsSrgbTexture(texture_types[i]), priority));
+    }
+    return textures;
+  }
+
+  std::vector<std::optional<SharedTexture>> textures(num_textures);
+  for (const bool is_srgb : {true, false}) {
+    std::vector<int> indices;
+    std::vector<SharedTexture::SourcePath> paths;
+    for (int i = 0; i < num_textures; ++i) {
+      if (IsSrgbTexture(texture_types[i]) == is_srgb) {
+        indices.push_back(i);
+        paths.push_back(source_paths[i]);
+      }
+    }
+    if (paths.empty()) {
+      continue;
+    }
+    std::vector<SharedTexture> loaded_textures = SharedTexture::LoadTextures(
+        context, paths, image_usages, ImageSampler::Config{}, is_srgb);
+    for (int i = 0; i < indices.size(); ++i) {
+      textures[indices[i]] = std::move(loaded_textures[i]);
+    }
+  }
+
+  std::vector<SharedTexture> ordered_textures;
+  ordered_textures.reserve(num_textures);
+  for (auto& texture : textures) {
+    ordered_textures.push_back(std::move(texture).value());
+  }
+  return ordered_textures;
+}
+
+// Visits variants of TextureSource and constructs a texture of 'type' from
+// 'source'.
 std::unique_ptr<SamplableImage> CreateTexture(
-    const SharedBasicContext& context,
+    const SharedBasicContext& context, TextureStreamer* texture_streamer,
+    TextureStreamer::Priority priority, ModelBuilder::TextureType type,
     const ModelBuilder::TextureSource& source) {
   if (std::holds_alternative<SharedTexture::SourcePath>(source)) {
-    const auto image_usages = {ImageUsage::GetSampledInFragmentShaderUsage()};
-    return std::make_unique<SharedTexture>(
-        context, std::get<SharedTexture::SourcePath>(source),
-        image_usages, ImageSampler::Config{});
+    return std::make_unique<SharedTexture>(std::move(LoadSharedTextures(
+        context, texture_streamer, priority,
+        absl::MakeConstSpan(&std::get<SharedTexture::SourcePath>(source), 1),
+        absl::MakeConstSpan(&type, 1))
+            .front()));
   } else if (std::holds_alternative<OffscreenImagePtr>(source)) {
     return std::make_unique<UnownedOffscreenTexture>(
         std::get<OffscreenImagePtr>(source));
@@ -104,22 +181,196 @@ std::vector<VkPushConstantRange> CreatePushConstantRanges(
   return ranges;
 }
 
+// Returns data infos of indices of levels of detail of 'mesh'.
+std::vector<PerVertexBuffer::VertexDataInfo> GetLodIndices(
+    const common::MeshCache::Mesh& mesh) {
+  std::vector<PerVertexBuffer::VertexDataInfo> lod_indices;
+  lod_indices.reserve(mesh.lods.size());
+  for (const auto& lod : mesh.lods) {
+    lod_indices.push_back(PerVertexBuffer::VertexDataInfo{lod.indices});
+  }
+  return lod_indices;
+}
+
+// Returns errors of each level of detail of 'meshes'. Since meshes that have
+// fewer levels are rendered with their coarsest level, the error of each level
+// is the largest among all meshes, taking that into account.
+std::vector<float> GetLodErrors(
+    absl::Span<const common::MeshCache::Mesh> meshes) {
+  size_t num_lods = 0;
+  for (const auto& mesh : meshes) {
+    num_lods = std::max(num_lods, mesh.lods.size());
+  }
+  std::vector<float> lod_errors(num_lods + 1, 0.0f);
+  for (const auto& mesh : meshes) {
+    for (int lod = 1; lod < lod_errors.size(); ++lod) {
+      const int mesh_lod = std::min(lod, static_cast<int>(mesh.lods.size()));
+      if (mesh_lod > 0) {
+        lod_errors[lod] = std::max(lod_errors[lod],
+                                   mesh.lods[mesh_lod - 1].error);
+      }
+    }
+  }
+  return lod_errors;
+}
+
+// Returns the bounding box of all 'meshes'.
+common::Aabb GetBounds(absl::Span<const common::MeshCache::Mesh> meshes) {
+  common::Aabb bounds = common::Aabb::Empty();
+  for (const auto& mesh : meshes) {
+    bounds.Expand(common::Aabb::FromVertices(mesh.vertices));
+  }
+  return bounds;
+}
+
+// Returns the quantization that restores positions of 'vertex_format', where
+// 'bounds' contains all vertices.
+common::PositionQuantization GetPositionQuantization(
+    ModelBuilder::VertexFormat vertex_format, const common::Aabb& bounds) {
+  if (vertex_format == ModelBuilder::VertexFormat::kQuantized &&
+      glm::all(glm::lessThanEqual(bounds.min, bounds.max))) {
+    return common::PositionQuantization::Create(bounds.min, bounds.max);
+  }
+  return {/*scale=*/glm::vec3{1.0f}, /*bias=*/glm::vec3{0.0f}};
+}
+
+// Creates a vertex buffer that holds indices and vertices of 'meshes'.
+// Vertices are copied to the device directly if 'vertex_format' is kFull.
+// Otherwise, they are converted first. 'position_quantization' is only used if
+// 'vertex_format' is kQuantized.
+std::unique_ptr<StaticPerVertexBuffer> CreateVertexBuffer(
+    const SharedBasicContext& context,
+    absl::Span<const common::MeshCache::Mesh> meshes,
+    ModelBuilder::VertexFormat vertex_format,
+    const common::PositionQuantization& position_quantization) {
+  std::vector<VertexInfo::PerMeshInfo> per_mesh_infos;
+  per_mesh_infos.reserve(meshes.size());
+  switch (vertex_format) {
+    case ModelBuilder::VertexFormat::kFull: {
+      for (const auto& mesh : meshes) {
+        per_mesh_infos.push_back(VertexInfo::PerMeshInfo{
+            PerVertexBuffer::VertexDataInfo{mesh.indices},
+            PerVertexBuffer::VertexDataInfo{mesh.vertices},
+            GetLodIndices(mesh),
+        });
+      }
+      return std::make_unique<StaticPerVertexBuffer>(
+          context, VertexInfo{std::move(per_mesh_infos)},
+          pipeline::GetVertexAttributes<Vertex3DWithTex>());
+    }
+    case ModelBuilder::VertexFormat::kCompressed: {
+      // Converted vertices only need to live until copied to the device.
+      std::vector<std::vector<Vertex3DCompressed>> compressed_vertices;
+      compressed_vertices.reserve(meshes.size());
+      for (const auto& mesh : meshes) {
+        compressed_vertices.push_back(common::CompressVertices(mesh.vertices));
+        per_mesh_infos.push_back(VertexInfo::PerMeshInfo{
+            PerVertexBuffer::VertexDataInfo{mesh.indices},
+            PerVertexBuffer::VertexDataInfo{compressed_vertices.back()},
+            GetLodIndices(mesh),
+        });
+      }
+      return std::make_unique<StaticPerVertexBuffer>(
+          context, VertexInfo{std::move(per_mesh_infos)},
+          pipeline::GetVertexAttributes<Vertex3DCompressed>());
+    }
+    case ModelBuilder::VertexFormat::kQuantized: {
+      // Converted vertices only need to live until copied to the device.
+      std::vector<std::vector<Vertex3DQuantized>> quantized_vertices;
+      quantized_vertices.reserve(meshes.size());
+      for (const auto& mesh : meshes) {
+        auto& vertices = quantized_vertices.emplace_back();
+        vertices.reserve(mesh.vertices.size());
+        for (const auto& vertex : mesh.vertices) {
+          vertices.push_back(
+              Vertex3DQuantized::Create(vertex, position_quantization));
+        }
+        per_mesh_infos.push_back(VertexInfo::PerMeshInfo{
+            PerVertexBuffer::VertexDataInfo{mesh.indices},
+            PerVertexBuffer::VertexDataInfo{vertices},
+            GetLodIndices(mesh),
+        });
+      }
+      return std::make_unique<StaticPerVertexBuffer>(
+          context, VertexInfo{std::move(per_mesh_infos)},
+          pipeline::GetVertexAttributes<Vertex3DQuantized>());
+    }
+    case ModelBuilder::VertexFormat::kSplitPosition: {
+      // Split vertices only need to live until copied to the device.
+      std::vector<common::SplitVertexStreams> split_vertices;
+      split_vertices.reserve(meshes.size());
+      for (const auto& mesh : meshes) {
+        split_vertices.push_back(common::SplitVertices(mesh.vertices));
+        per_mesh_infos.push_back(VertexInfo::PerMeshInfo{
+            PerVertexBuffer::VertexDataInfo{mesh.indices},
+            PerVertexBuffer::VertexDataInfo{split_vertices.back().positions},
+            GetLodIndices(mesh),
+            /*extra_vertex_streams=*/{PerVertexBuffer::VertexDataInfo{
+                split_vertices.back().attributes}},
+        });
+      }
+      std::vector<std::vector<VertexBuffer::Attribute>> per_stream_attributes;
+      per_stream_attributes.push_back(
+          pipeline::GetVertexAttributes<Vertex3DPosOnly>());
+      per_stream_attributes.push_back(
+          pipeline::GetVertexAttributes<Vertex3DNormTex>());
+      return std::make_unique<StaticPerVertexBuffer>(
+          context, VertexInfo{std::move(per_mesh_infos)},
+          std::move(per_stream_attributes));
+    }
+  }
+}
+
+// Returns the size of each vertex in each stream of 'vertex_format'.
+std::vector<uint32_t> GetVertexStreamStrides(
+    ModelBuilder::VertexFormat vertex_format) {
+  switch (vertex_format) {
+    case ModelBuilder::VertexFormat::kFull:
+      return {sizeof(Vertex3DWithTex)};
+    case ModelBuilder::VertexFormat::kCompressed:
+      return {sizeof(Vertex3DCompressed)};
+    case ModelBuilder::VertexFormat::kQuantized:
+      return {sizeof(Vertex3DQuantized)};
+    case ModelBuilder::VertexFormat::kSplitPosition:
+      return {sizeof(Vertex3DPosOnly), sizeof(Vertex3DNormTex)};
+  }
+}
+
+// Returns the binding point of the first per-instance buffer, which follows
+// all vertex streams of 'per_vertex_buffer'.
+uint32_t GetPerInstanceBufferBindingPointBase(
+    const PerVertexBuffer& per_vertex_buffer) {
+  return kPerVertexBufferBindingPoint + per_vertex_buffer.num_vertex_streams();
+}
+
 // Updates 'pipeline_builder' with vertex input bindings and attributes,
-// assuming per-vertex data is of type Vertex3DWithTex.
+// assuming per-vertex data is in 'vertex_format'. If 'position_only' is true,
+// only the position attribute will be declared.
 void SetPipelineVertexInput(
     const PerVertexBuffer& per_vertex_buffer,
+    ModelBuilder::VertexFormat vertex_format, bool position_only,
     const std::vector<const PerInstanceBuffer*>& per_instance_buffers,
     GraphicsPipelineBuilder* pipeline_builder) {
+  const std::vector<uint32_t> strides = GetVertexStreamStrides(vertex_format);
+  const int num_streams = position_only ? 1 : strides.size();
   uint32_t attribute_start_location = 0;
+  for (int stream = 0; stream < num_streams; ++stream) {
+    auto per_vertex_attributes = per_vertex_buffer.GetStreamAttributes(
+        stream, attribute_start_location);
+    if (position_only) {
+      // Position is always the first attribute.
+      per_vertex_attributes.resize(1);
+    }
+    attribute_start_location += per_vertex_attributes.size();
+    pipeline_builder->AddVertexInput(
+        kPerVertexBufferBindingPoint + stream,
+        pipeline::GetBindingDescription(strides[stream], /*instancing=*/false),
+        std::move(per_vertex_attributes));
+  }
 
-  auto per_vertex_attributes =
-      per_vertex_buffer.GetAttributes(attribute_start_location);
-  attribute_start_location += per_vertex_attributes.size();
-  pipeline_builder->AddVertexInput(
-      kPerVertexBufferBindingPoint,
-      pipeline::GetPerVertexBindingDescription<Vertex3DWithTex>(),
-      std::move(per_vertex_attributes));
-
+  attribute_start_location = kNumPerVertexAttributes;
+  const uint32_t per_instance_binding_point_base =
+      GetPerInstanceBufferBindingPointBase(per_vertex_buffer);
   for (int i = 0; i < per_instance_buffers.size(); ++i) {
     ASSERT_NON_NULL(per_instance_buffers[i],
                     "Per-instance vertex buffer not provided");
@@ -130,7 +381,7 @@ void SetPipelineVertexInput(
         per_instance_buffers[i]->GetAttributes(attribute_start_location);
     attribute_start_location += per_instance_attributes.size();
     pipeline_builder->AddVertexInput(
-        kPerInstanceBufferBindingPointBase + i,
+        per_instance_binding_point_base + i,
         std::move(per_instance_binding), std::move(per_instance_attributes));
   }
 }
@@ -138,59 +389,100 @@ void SetPipelineVertexInput(
 } /* namespace */
 
 void ModelBuilder::SingleMeshResource::LoadMesh(ModelBuilder* builder) const {
-  // Load indices and vertices.
-  const common::ObjFile file{obj_file_path_, obj_file_index_base_};
-  VertexInfo vertex_info{
-      /*per_mesh_infos=*/{{
-          PerVertexBuffer::VertexDataInfo{file.indices},
-          PerVertexBuffer::VertexDataInfo{file.vertices},
-      }},
-  };
-  builder->vertex_buffer_ = std::make_unique<StaticPerVertexBuffer>(
-      builder->context_, std::move(vertex_info),
-      pipeline::GetVertexAttributes<Vertex3DWithTex>());
+  // Load indices and vertices. They are copied to the device directly from the
+  // mesh cache, which is memory mapped if it is up-to-date.
+  const auto mesh_cache = common::MeshCache::LoadObjFile(
+      obj_file_path_, obj_file_index_base_, optimize_mesh_, lod_ratios_);
+  const absl::Span<const common::MeshCache::Mesh> meshes{
+      &mesh_cache->meshes().front(), 1};
+  builder->bounds_ = GetBounds(meshes);
+  builder->position_quantization_ =
+      GetPositionQuantization(vertex_format_, builder->bounds_);
+  builder->vertex_buffer_ =
+      CreateVertexBuffer(builder->context_, meshes, vertex_format_,
+                         builder->position_quantization_);
+  builder->vertex_format_ = vertex_format_;
+  builder->lod_errors_ = GetLodErrors(meshes);
+
+  // Load textures. Textures from files are loaded at once, so that they are
+  // decoded concurrently, unless they are streamed.
+  std::vector<SharedTexture::SourcePath> texture_paths;
+  std::vector<TextureType> texture_types;
+  for (const auto& pair : tex_source_map_) {
+    for (const auto& source : pair.second) {
+      if (const auto* source_path =
+              std::get_if<SharedTexture::SourcePath>(&source);
+          source_path != nullptr) {
+        texture_paths.push_back(*source_path);
+        texture_types.push_back(pair.first);
+      }
+    }
+  }
+  std::vector<SharedTexture> textures = LoadSharedTextures(
+      builder->context_, builder->texture_streamer_,
+      builder->texture_priority_, texture_paths, texture_types);
 
-  // Load textures.
   auto& mesh_textures = builder->mesh_textures_;
   mesh_textures.push_back({});
+  int texture_index = 0;
   for (const auto& pair : tex_source_map_) {
     const auto type_index = static_cast<int>(pair.first);
     const auto& sources = pair.second;
     mesh_textures.back()[type_index].reserve(sources.size());
     for (const auto& source : sources) {
-      mesh_textures.back()[type_index].push_back(
-          CreateTexture(builder->context_, source));
+      if (std::holds_alternative<SharedTexture::SourcePath>(source)) {
+        mesh_textures.back()[type_index].push_back(
+            std::make_unique<SharedTexture>(
+                std::move(textures[texture_index++])));
+      } else {
+        mesh_textures.back()[type_index].push_back(
+            CreateTexture(builder->context_, builder->texture_streamer_,
+                          builder->texture_priority_, pair.first, source));
+      }
     }
   }
 }
 
 void ModelBuilder::MultiMeshResource::LoadMesh(ModelBuilder* builder) const {
-  // Load indices and vertices.
-  const common::ModelLoader loader{model_path_, texture_dir_};
-  std::vector<VertexInfo::PerMeshInfo> per_mesh_infos;
-  per_mesh_infos.reserve(loader.mesh_datas().size());
-  for (const auto& mesh_data : loader.mesh_datas()) {
-    per_mesh_infos.push_back(VertexInfo::PerMeshInfo{
-        PerVertexBuffer::VertexDataInfo{mesh_data.indices},
-        PerVertexBuffer::VertexDataInfo{mesh_data.vertices},
-    });
+  // Load indices and vertices. They are copied to the device directly from the
+  // mesh cache, which is memory mapped if it is up-to-date.
+  const auto mesh_cache = common::MeshCache::LoadModel(
+      model_path_, texture_dir_, optimize_meshes_, lod_ratios_);
+  const auto& meshes = mesh_cache->meshes();
+  builder->bounds_ = GetBounds(meshes);
+  builder->position_quantization_ =
+      GetPositionQuantization(vertex_format_, builder->bounds_);
+  builder->vertex_buffer_ =
+      CreateVertexBuffer(builder->context_, meshes, vertex_format_,
+                         builder->position_quantization_);
+  builder->vertex_format_ = vertex_format_;
+  builder->lod_errors_ = GetLodErrors(meshes);
+
+  // Load textures. Textures of all meshes are loaded at once, so that they are
+  // decoded concurrently, unless they are streamed.
+  std::vector<SharedTexture::SourcePath> texture_paths;
+  std::vector<TextureType> texture_types;
+  for (const auto& mesh : meshes) {
+    for (const auto& texture : mesh.textures) {
+      texture_paths.push_back(
+          absl::StrFormat("%s/%s", texture_dir_, texture.path));
+      texture_types.push_back(texture.type);
+    }
   }
-  builder->vertex_buffer_ = std::make_unique<StaticPerVertexBuffer>(
-      builder->context_, VertexInfo{std::move(per_mesh_infos)},
-      pipeline::GetVertexAttributes<Vertex3DWithTex>());
+  std::vector<SharedTexture> textures = LoadSharedTextures(
+      builder->context_, builder->texture_streamer_,
+      builder->texture_priority_, texture_paths, texture_types);
 
-  // Load textures.
-  const auto image_usages = {ImageUsage::GetSampledInFragmentShaderUsage()};
   auto& mesh_textures = builder->mesh_textures_;
-  mesh_textures.reserve(loader.mesh_datas().size());
-  for (const auto& mesh_data : loader.mesh_datas()) {
+  mesh_textures.reserve(meshes.size());
+  int texture_index = 0;
+  for (const auto& mesh : meshes) {
     mesh_textures.push_back({});
-    for (const auto& texture : mesh_data.textures) {
-      const auto type_index = static_cast<int>(texture.texture_type);
+    for (const auto& texture : mesh.textures) {
+      const auto type_index = static_cast<int>(texture.type);
       mesh_textures.back()[type_index].push_back(
           std::make_unique<SharedTexture>(
-              builder->context_, texture.path, image_usages,
-              ImageSampler::Config{}));
+              std::move(textures[texture_index++])));
     }
   }
 }
@@ -199,10 +491,14 @@ ModelBuilder::ModelBuilder(SharedBasicContext context,
                            std::string&& name,
                            int num_frames_in_flight,
                            float viewport_aspect_ratio,
-                           const ModelResource& resource)
+                           const ModelResource& resource,
+                           TextureStreamer* texture_streamer,
+                           TextureStreamer::Priority texture_priority)
     : context_{std::move(FATAL_IF_NULL(context))},
       num_frames_in_flight_{num_frames_in_flight},
       viewport_aspect_ratio_{viewport_aspect_ratio},
+      texture_streamer_{texture_streamer},
+      texture_priority_{texture_priority},
       uniform_buffer_info_maps_(num_frames_in_flight_),
       pipeline_builder_{std::make_unique<GraphicsPipelineBuilder>(context_)} {
   pipeline_builder_->SetPipelineName(std::move(name));
@@ -212,7 +508,8 @@ ModelBuilder::ModelBuilder(SharedBasicContext context,
 ModelBuilder& ModelBuilder::AddSharedTexture(
     TextureType type, const TextureSource& texture_source) {
   shared_textures_[static_cast<int>(type)].push_back(
-      CreateTexture(context_, texture_source));
+      CreateTexture(context_, texture_streamer_, texture_priority_, type,
+                    texture_source));
   return *this;
 }
 
@@ -228,6 +525,11 @@ ModelBuilder& ModelBuilder::AddPerInstanceBuffer(
   return *this;
 }
 
+ModelBuilder& ModelBuilder::UsePositionOnlyInput() {
+  position_only_ = true;
+  return *this;
+}
+
 ModelBuilder& ModelBuilder::AddUniformBinding(
     VkShaderStageFlags shader_stage,
     std::vector<Descriptor::Info::Binding>&& bindings) {
@@ -318,17 +620,20 @@ std::unique_ptr<Model> ModelBuilder::Build() {
       push_constant_infos_.has_value()
           ? CreatePushConstantRanges(push_constant_infos_.value())
           : std::vector<VkPushConstantRange>{});
-  SetPipelineVertexInput(*vertex_buffer_, per_instance_buffers_,
-                         pipeline_builder_.get());
+  SetPipelineVertexInput(*vertex_buffer_, vertex_format_, position_only_,
+                         per_instance_buffers_, pipeline_builder_.get());
 
   uniform_descriptor_infos_.clear();
   uniform_buffer_info_maps_.clear();
 
   return std::unique_ptr<Model>{new Model{
-      context_, viewport_aspect_ratio_, std::move(vertex_buffer_),
+      context_, viewport_aspect_ratio_, texture_streamer_,
+      std::move(vertex_buffer_),
+      std::move(lod_errors_), bounds_, position_quantization_, position_only_,
       std::move(per_instance_buffers_), std::move(push_constant_infos_),
       std::move(shared_textures_), std::move(mesh_textures_),
-      std::move(descriptors), std::move(pipeline_builder_)}};
+      std::move(texture_binding_map_), std::move(descriptors),
+      std::move(pipeline_builder_)}};
 }
 
 void Model::Update(bool is_object_opaque, const VkExtent2D& frame_size,
@@ -351,12 +656,19 @@ void Model::Update(bool is_object_opaque, const VkExtent2D& frame_size,
 }
 
 void Model::Draw(const VkCommandBuffer& command_buffer,
-                 int frame, uint32_t instance_count) const {
+                 int frame, uint32_t instance_count,
+                 int lod, int first_instance) const {
   ASSERT_NON_NULL(pipeline_, "Update() must have been called");
+  if (texture_streamer_ != nullptr) {
+    UpdateTextureDescriptors(frame);
+  }
   pipeline_->Bind(command_buffer);
+  const uint32_t per_instance_binding_point_base =
+      GetPerInstanceBufferBindingPointBase(*vertex_buffer_);
   for (int i = 0; i < per_instance_buffers_.size(); ++i) {
     per_instance_buffers_[i]->Bind(
-        command_buffer, kPerInstanceBufferBindingPointBase + i, /*offset=*/0);
+        command_buffer, per_instance_binding_point_base + i,
+        /*offset=*/first_instance);
   }
   if (push_constant_info_.has_value()) {
     for (const auto& info : push_constant_info_->infos) {
@@ -369,8 +681,36 @@ void Model::Draw(const VkCommandBuffer& command_buffer,
     descriptors_[frame][mesh_index]->Bind(command_buffer, pipeline_->layout(),
                                           pipeline_->binding_point());
     vertex_buffer_->Draw(command_buffer, kPerVertexBufferBindingPoint,
-                         mesh_index, instance_count);
+                         mesh_index, instance_count, lod,
+                         /*bind_all_streams=*/!position_only_);
+  }
+}
+
+void Model::UpdateTextureDescriptors(int frame) const {
+  const uint64_t generation = texture_streamer_->generation();
+  if (texture_generations_[frame] == generation) {
+    return;
+  }
+  texture_generations_[frame] = generation;
+
+  Descriptor::Info descriptor_info;
+  for (int mesh_index = 0; mesh_index < mesh_textures_.size(); ++mesh_index) {
+    Descriptor::ImageInfoMap image_info_map;
+    CreateTextureInfo(texture_binding_map_, mesh_textures_[mesh_index],
+                      shared_textures_, &descriptor_info, &image_info_map);
+    descriptors_[frame][mesh_index]->UpdateImageInfos(
+        Image::GetDescriptorTypeForSampling(), image_info_map);
+  }
+}
+
+int Model::SelectLevelOfDetail(float pixels_per_unit,
+                               float max_pixel_error) const {
+  int lod = 0;
+  while (lod + 1 < lod_errors_.size() &&
+         lod_errors_[lod + 1] * pixels_per_unit <= max_pixel_error) {
+    ++lod;
   }
+  return lod;
 }
 
 } /* namespace vulkan */
@@ -9,6 +9,7 @@
 #define LIGHTER_RENDERER_VULKAN_EXTENSION_MODEL_H
 
 #include <array>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <optional>
@@ -16,6 +17,8 @@
 #include <variant>
 #include <vector>
 
+#include "lighter/common/bounds.h"
+#include "lighter/common/file.h"
 #include "lighter/common/model_loader.h"
 #include "lighter/common/util.h"
 #include "lighter/renderer/vulkan/wrapper/basic_context.h"
@@ -25,6 +28,7 @@
 #include "lighter/renderer/vulkan/wrapper/pipeline.h"
 #include "lighter/renderer/vulkan/wrapper/pipeline_util.h"
 #include "lighter/renderer/vulkan/wrapper/render_pass.h"
+#include "lighter/renderer/vulkan/wrapper/texture_streamer.h"
 #include "third_party/absl/container/flat_hash_map.h"
 #include "third_party/vulkan/vulkan.h"
 
@@ -67,6 +71,28 @@ class ModelBuilder {
   using TextureSourceMap = absl::flat_hash_map<
       TextureType, std::vector<TextureSource>, common::util::EnumClassHash>;
 
+  // Layout of per-vertex data.
+  enum class VertexFormat {
+    // common::Vertex3DWithTex.
+    kFull,
+    // common::Vertex3DCompressed, which takes less memory and bandwidth.
+    // Shaders will receive normals as octahedral-encoded vec2, and should
+    // decode them as described in the comments of that struct.
+    kCompressed,
+    // common::Vertex3DQuantized, which takes even less memory and bandwidth
+    // than kCompressed. Normals are encoded in the same way as kCompressed.
+    // Positions of all meshes are quantized with the same
+    // common::PositionQuantization, which is returned by
+    // Model::position_quantization(), and shaders should restore them with it,
+    // usually passed in a uniform buffer or push constant.
+    kQuantized,
+    // Same attributes as kFull, but positions are stored in a separate stream
+    // of common::Vertex3DPosOnly, and the rest in a stream of
+    // common::Vertex3DNormTex. Models that use position-only input will only
+    // fetch 12 bytes per vertex.
+    kSplitPosition,
+  };
+
   // Interface of model resource classes.
   class ModelResource {
    public:
@@ -79,15 +105,24 @@ class ModelBuilder {
 
   // Contains information required for loading one mesh from the Wavefront .obj
   // file at 'obj_file_path' and textures in 'tex_source_map' using a
-  // lightweight .obj file loader.
+  // lightweight .obj file loader. If 'optimize_mesh' is true, triangles and
+  // vertices will be reordered for rendering efficiency. Vertices will be
+  // converted to 'vertex_format'. If 'lod_ratios' is not empty, levels of
+  // detail will be generated as described in common::MeshCache::LoadObjFile().
   class SingleMeshResource : public ModelResource {
    public:
     SingleMeshResource(std::string&& obj_file_path,
                        int obj_file_index_base,
-                       TextureSourceMap&& tex_source_map)
+                       TextureSourceMap&& tex_source_map,
+                       bool optimize_mesh = false,
+                       VertexFormat vertex_format = VertexFormat::kFull,
+                       std::vector<float>&& lod_ratios = {})
         : obj_file_path_{std::move(obj_file_path)},
           obj_file_index_base_{obj_file_index_base},
-          tex_source_map_{std::move(tex_source_map)} {}
+          tex_source_map_{std::move(tex_source_map)},
+          optimize_mesh_{optimize_mesh},
+          vertex_format_{vertex_format},
+          lod_ratios_{std::move(lod_ratios)} {}
 
     // Overrides.
     void LoadMesh(ModelBuilder* builder) const override;
@@ -96,15 +131,28 @@ class ModelBuilder {
     const std::string obj_file_path_;
     const int obj_file_index_base_;
     const TextureSourceMap tex_source_map_;
+    const bool optimize_mesh_;
+    const VertexFormat vertex_format_;
+    const std::vector<float> lod_ratios_;
   };
 
   // Contains information required for loading the model from 'model_path' and
-  // textures from 'texture_dir' using Assimp.
+  // textures from 'texture_dir' using Assimp. If 'optimize_meshes' is true,
+  // triangles and vertices of each mesh will be reordered for rendering
+  // efficiency. Vertices will be converted to 'vertex_format'. If 'lod_ratios'
+  // is not empty, levels of detail will be generated for each mesh as described
+  // in common::MeshCache::LoadModel().
   class MultiMeshResource : public ModelResource {
    public:
-    MultiMeshResource(std::string&& model_path, std::string&& texture_dir)
+    MultiMeshResource(std::string&& model_path, std::string&& texture_dir,
+                      bool optimize_meshes = false,
+                      VertexFormat vertex_format = VertexFormat::kFull,
+                      std::vector<float>&& lod_ratios = {})
         : model_path_{std::move(model_path)},
-          texture_dir_{std::move(texture_dir)} {}
+          texture_dir_{std::move(texture_dir)},
+          optimize_meshes_{optimize_meshes},
+          vertex_format_{vertex_format},
+          lod_ratios_{std::move(lod_ratios)} {}
 
     // Overrides.
     void LoadMesh(ModelBuilder* builder) const override;
@@ -112,6 +160,9 @@ class ModelBuilder {
    private:
     const std::string model_path_;
     const std::string texture_dir_;
+    const bool optimize_meshes_;
+    const VertexFormat vertex_format_;
+    const std::vector<float> lod_ratios_;
   };
 
   // Contains information for pushing constants. We assume that in each frame,
@@ -133,11 +184,18 @@ class ModelBuilder {
   // When the frame is resized, the aspect ratio of viewport will always be
   // 'viewport_aspect_ratio'. If any offscreen images are used in 'resource',
   // the user is responsible for keeping the existence of them.
+  // If 'texture_streamer' is not nullptr, textures loaded from files, including
+  // those added by AddSharedTexture(), are requested from it with
+  // 'texture_priority', so that the builder does not wait for them. Placeholders
+  // are bound until they are resident. The user is responsible for keeping the
+  // existence of 'texture_streamer' until the model is destructed.
   ModelBuilder(SharedBasicContext context,
                std::string&& name,
                int num_frames_in_flight,
                float viewport_aspect_ratio,
-               const ModelResource& resource);
+               const ModelResource& resource,
+               TextureStreamer* texture_streamer = nullptr,
+               TextureStreamer::Priority texture_priority = 0);
 
   // This class is neither copyable nor movable.
   ModelBuilder(const ModelBuilder&) = delete;
@@ -155,11 +213,18 @@ class ModelBuilder {
 
   // Adds a per-instance vertex buffer.
   // The user is responsible for keeping the existence of the buffer.
-  // Note that this class assumes the per-vertex data type is Vertex3DWithTex,
-  // hence vertex attributes of user-provided per-instance buffers will be bound
-  // to locations starting from 3.
+  // Note that per-vertex data always has 3 attributes regardless of
+  // VertexFormat, hence vertex attributes of user-provided per-instance buffers
+  // will be bound to locations starting from 3, even if position-only input is
+  // used.
   ModelBuilder& AddPerInstanceBuffer(const PerInstanceBuffer* buffer);
 
+  // Only passes vertex positions to shaders, at location 0. This is intended
+  // for pipelines that don't need other attributes, such as depth-only and
+  // shadow passes. If per-vertex data is in VertexFormat::kSplitPosition, only
+  // the position stream will be bound when rendering.
+  ModelBuilder& UsePositionOnlyInput();
+
   // Declares how many uniform data should be expected at each binding point.
   ModelBuilder& AddUniformBinding(
       VkShaderStageFlags shader_stage,
@@ -201,9 +266,31 @@ class ModelBuilder {
   // the object does not change when the size of framebuffers changes.
   const float viewport_aspect_ratio_;
 
+  // Streams textures from files if not nullptr.
+  TextureStreamer* const texture_streamer_;
+
+  // Priority of requests to 'texture_streamer_'.
+  const TextureStreamer::Priority texture_priority_;
+
   // Holds per-vertex data.
   std::unique_ptr<StaticPerVertexBuffer> vertex_buffer_;
 
+  // Layout of data in 'vertex_buffer_'.
+  VertexFormat vertex_format_ = VertexFormat::kFull;
+
+  // Errors of levels of detail stored in 'vertex_buffer_'.
+  std::vector<float> lod_errors_;
+
+  // Bounding box of all meshes in the model space.
+  common::Aabb bounds_ = common::Aabb::Empty();
+
+  // Restores positions stored in 'vertex_buffer_'.
+  common::PositionQuantization position_quantization_{
+      /*scale=*/glm::vec3{1.0f}, /*bias=*/glm::vec3{0.0f}};
+
+  // Whether only vertex positions are passed to shaders.
+  bool position_only_ = false;
+
   // Each element stores textures used for the mesh at the same index.
   std::vector<TexturesPerMesh> mesh_textures_;
 
@@ -259,10 +346,33 @@ class Model {
               const RenderPass& render_pass, uint32_t subpass_index,
               bool flip_viewport_y = true);
 
-  // Renders the model.
+  // Renders the model. 'lod' selects the level of detail of meshes, where 0
+  // refers to the original meshes. Per-instance data will be read starting
+  // from the instance at 'first_instance', so that instances rendered with
+  // different levels of detail can be stored in the same buffers.
   // This should be called when 'command_buffer' is recording commands.
   void Draw(const VkCommandBuffer& command_buffer,
-            int frame, uint32_t instance_count) const;
+            int frame, uint32_t instance_count,
+            int lod = 0, int first_instance = 0) const;
+
+  // Returns the coarsest level of detail whose error does not exceed
+  // 'max_pixel_error' on the screen, where 'pixels_per_unit' is the number of
+  // pixels covered by one unit of the model space at where the model is
+  // rendered.
+  int SelectLevelOfDetail(float pixels_per_unit, float max_pixel_error) const;
+
+  // Returns the number of levels of detail, including the original meshes.
+  int num_levels_of_detail() const { return lod_errors_.size(); }
+
+  // Returns the bounding box of all meshes in the model space.
+  const common::Aabb& bounds() const { return bounds_; }
+
+  // Returns the quantization that restores positions passed to shaders to the
+  // model space, if the vertex format is VertexFormat::kQuantized. Otherwise,
+  // positions are not quantized, and this is the identity transform.
+  const common::PositionQuantization& position_quantization() const {
+    return position_quantization_;
+  }
 
  private:
   friend std::unique_ptr<Model> ModelBuilder::Build();
@@ -273,23 +383,43 @@ class Model {
 
   Model(SharedBasicContext context,
         float viewport_aspect_ratio,
+        const TextureStreamer* texture_streamer,
         std::unique_ptr<StaticPerVertexBuffer>&& vertex_buffer,
+        std::vector<float>&& lod_errors, const common::Aabb& bounds,
+        const common::PositionQuantization& position_quantization,
+        bool position_only,
         std::vector<const PerInstanceBuffer*>&& per_instance_buffers,
         std::optional<PushConstantInfos>&& push_constant_info,
         TexturesPerMesh&& shared_textures,
         std::vector<TexturesPerMesh>&& mesh_textures,
+        ModelBuilder::BindingPointMap&& texture_binding_map,
         std::vector<DescriptorsPerFrame>&& descriptors,
         std::unique_ptr<GraphicsPipelineBuilder>&& pipeline_builder)
       : context_{std::move(FATAL_IF_NULL(context))},
         viewport_aspect_ratio_{viewport_aspect_ratio},
+        texture_streamer_{texture_streamer},
         vertex_buffer_{std::move(vertex_buffer)},
+        lod_errors_{std::move(lod_errors)},
+        bounds_{bounds},
+        position_quantization_{position_quantization},
+        position_only_{position_only},
         per_instance_buffers_{std::move(per_instance_buffers)},
         push_constant_info_{std::move(push_constant_info)},
         shared_textures_{std::move(shared_textures)},
         mesh_textures_{std::move(mesh_textures)},
+        texture_binding_map_{std::move(texture_binding_map)},
         descriptors_{std::move(descriptors)},
+        texture_generations_(
+            descriptors_.size(),
+            texture_streamer_ != nullptr ? texture_streamer_->generation() : 0),
         pipeline_builder_{std::move(pipeline_builder)} {}
 
+  // Rewrites texture descriptors of 'frame' if any streamed texture has become
+  // resident since they were last written. Descriptors of 'frame' are not used
+  // by the device when commands of 'frame' are being recorded, hence they can
+  // be updated in place.
+  void UpdateTextureDescriptors(int frame) const;
+
   // Pointer to context.
   const SharedBasicContext context_;
 
@@ -297,9 +427,27 @@ class Model {
   // the object does not change when the size of framebuffers changes.
   const float viewport_aspect_ratio_;
 
+  // Streams textures from files if not nullptr.
+  const TextureStreamer* const texture_streamer_;
+
   // Holds per-vertex data.
   const std::unique_ptr<StaticPerVertexBuffer> vertex_buffer_;
 
+  // Errors of levels of detail stored in 'vertex_buffer_', in the same unit as
+  // vertex positions. The first element is 0, which refers to the original
+  // meshes. Each following element is the largest error of that level among
+  // all meshes.
+  const std::vector<float> lod_errors_;
+
+  // Bounding box of all meshes in the model space.
+  const common::Aabb bounds_;
+
+  // Restores positions stored in 'vertex_buffer_'.
+  const common::PositionQuantization position_quantization_;
+
+  // Whether only vertex positions are passed to shaders.
+  const bool position_only_;
+
   // Stores per-instance vertex data.
   const std::vector<const PerInstanceBuffer*> per_instance_buffers_;
 
@@ -312,9 +460,16 @@ class Model {
   // Each element stores textures used for the mesh at the same index.
   const std::vector<TexturesPerMesh> mesh_textures_;
 
+  // Maps each texture type to its binding point.
+  const ModelBuilder::BindingPointMap texture_binding_map_;
+
   // Each element is the descriptor used for the mesh at the same index.
   const std::vector<DescriptorsPerFrame> descriptors_;
 
+  // Each element is TextureStreamer::generation() when texture descriptors of
+  // the frame at the same index were last written.
+  mutable std::vector<uint64_t> texture_generations_;
+
   // The pipeline builder is preserved, so that the user may update it without
   // rebuilding the entire model.
   std::unique_ptr<GraphicsPipelineBuilder> pipeline_builder_;
@@ -11,10 +11,10 @@
 #include <algorithm>
 
 #include "lighter/common/graphics_api.h"
+#include "lighter/common/utf8.h"
 #include "lighter/renderer/util.h"
 #include "lighter/renderer/vulkan/wrapper/pipeline_util.h"
 #include "lighter/renderer/vulkan/wrapper/util.h"
-#include "third_party/absl/strings/str_format.h"
 #include "third_party/glm/glm.hpp"
 
 namespace lighter {
@@ -28,6 +28,11 @@ enum BindingPoint { kUniformBufferBindingPoint = 0, kTextureBindingPoint };
 
 constexpr uint32_t kVertexBufferBindingPoint = 0;
 
+// DynamicText drops glyph runs that are not used in the latest frame once it
+// has cached more than this number of them, so that texts that keep changing
+// will not exhaust the memory.
+constexpr int kMaxNumGlyphRuns = 1024;
+
 /* BEGIN: Consistent with uniform blocks defined in shaders. */
 
 struct TextRenderInfo {
@@ -75,6 +80,25 @@ const std::vector<Descriptor::Info>& GetDescriptorInfos() {
   return *descriptor_infos;
 }
 
+// Returns the path to the fragment shader that renders texts from textures
+// that store glyphs in 'glyph_mode'.
+std::string GetTextFragShaderPath(Text::GlyphMode glyph_mode) {
+  switch (glyph_mode) {
+    case Text::GlyphMode::kBitmap:
+      return "text/text.frag";
+    case Text::GlyphMode::kSignedDistanceField:
+      return "text/text_sdf.frag";
+  }
+}
+
+// Returns the configuration of glyph atlases. Pages used by any frame in flight
+// will not be evicted.
+GlyphAtlas::Config GetGlyphAtlasConfig(int num_frames_in_flight) {
+  GlyphAtlas::Config config;
+  config.num_frames_to_retain = num_frames_in_flight;
+  return config;
+}
+
 // Returns a copy of 'value', but removes the minus sign of 'value.x' if exists.
 inline glm::vec2 SetXPositive(const glm::vec2& value) {
   return glm::vec2{std::abs(value.x), value.y};
@@ -85,7 +109,8 @@ inline glm::vec2 SetXPositive(const glm::vec2& value) {
 Text::Text(const SharedBasicContext& context,
            std::string&& pipeline_name,
            int num_frames_in_flight,
-           float viewport_aspect_ratio)
+           float viewport_aspect_ratio,
+           GlyphMode glyph_mode)
     : viewport_aspect_ratio_{viewport_aspect_ratio},
       vertex_buffer_{context, text::GetVertexDataSize(/*num_rects=*/1),
                      pipeline::GetVertexAttributes<Vertex2D>()},
@@ -101,7 +126,8 @@ Text::Text(const SharedBasicContext& context,
                      "text/char.vert", common::api::GraphicsApi::kVulkan))
       .SetShader(VK_SHADER_STAGE_FRAGMENT_BIT,
                  common::file::GetShaderBinaryPath(
-                     "text/text.frag", common::api::GraphicsApi::kVulkan));
+                     GetTextFragShaderPath(glyph_mode),
+                     common::api::GraphicsApi::kVulkan));
 }
 
 void Text::Update(const VkExtent2D& frame_size,
@@ -125,18 +151,38 @@ int Text::UpdateBuffers(int frame, const glm::vec3& color, float alpha) {
       glm::vec4(color, alpha);
   uniform_buffer_.Flush(frame);
 
-  constexpr int kNumVerticesPerMesh = text::kNumVerticesPerRect;
-  const auto num_meshes = static_cast<int>(vertices_to_draw_.size()) /
-                          kNumVerticesPerMesh;
-  vertex_buffer_.CopyHostData(PerVertexBuffer::ShareIndicesDataInfo{
-      num_meshes,
-      /*per_mesh_vertices=*/{vertices_to_draw_, kNumVerticesPerMesh},
-      /*shared_indices=*/
-      {PerVertexBuffer::VertexDataInfo{text::GetIndicesPerRect()}},
+  const auto num_rects = static_cast<int>(vertices_to_draw_.size()) /
+                         text::kNumVerticesPerRect;
+  if (num_rects == 0) {
+    return 0;
+  }
+
+  // All rectangles are stored as one mesh, so that they can be rendered with
+  // one draw call.
+  const int num_indices = text::kNumIndicesPerRect * num_rects;
+  if (num_indices > indices_.size()) {
+    indices_ = text::GetIndicesForRects(
+        std::max(num_rects, static_cast<int>(indices_.size()) /
+                                text::kNumIndicesPerRect * 2));
+  }
+  vertex_buffer_.CopyHostData(PerVertexBuffer::NoShareIndicesDataInfo{
+      /*per_mesh_infos=*/{{
+          PerVertexBuffer::VertexDataInfo{
+              absl::MakeConstSpan(indices_.data(), num_indices)},
+          PerVertexBuffer::VertexDataInfo{vertices_to_draw_},
+      }},
   });
   vertices_to_draw_.clear();
 
-  return num_meshes;
+  return num_rects;
+}
+
+void Text::DrawRects(const VkCommandBuffer& command_buffer,
+                     int num_rects) const {
+  if (num_rects > 0) {
+    vertex_buffer_.Draw(command_buffer, kVertexBufferBindingPoint,
+                        /*mesh_index=*/0, /*instance_count=*/1);
+  }
 }
 
 void Text::SetPipelineLayout(const VkDescriptorSetLayout& layout) {
@@ -151,32 +197,43 @@ StaticText::StaticText(const SharedBasicContext& context,
                        int num_frames_in_flight,
                        float viewport_aspect_ratio,
                        absl::Span<const std::string> texts,
-                       Font font, int font_height)
-    : Text{context, "Static text", num_frames_in_flight, viewport_aspect_ratio},
-      text_loader_{context, texts, font, font_height} {
+                       Font font, int font_height, GlyphMode glyph_mode)
+    : Text{context, "Static text", num_frames_in_flight, viewport_aspect_ratio,
+           /*glyph_mode=*/GlyphMode::kBitmap},
+      text_loader_{context, texts, font, font_height, glyph_mode} {
+  const Descriptor::ImageInfoMap image_info_map{{
+      kTextureBindingPoint,
+      {text_loader_.atlas_image().GetDescriptorInfoForSampling()}}};
   descriptors_.reserve(num_frames_in_flight);
   for (int frame = 0; frame < num_frames_in_flight; ++frame) {
     descriptors_.push_back(
-        std::make_unique<DynamicDescriptor>(context, GetDescriptorInfos()));
+        std::make_unique<StaticDescriptor>(context, GetDescriptorInfos()));
+    descriptors_[frame]->UpdateBufferInfos(
+        UniformBuffer::GetDescriptorType(),
+        /*buffer_info_map=*/{{
+            kUniformBufferBindingPoint,
+            {GetUniformBufferDescriptorInfo(frame)},
+        }});
+    descriptors_[frame]->UpdateImageInfos(
+        Image::GetDescriptorTypeForSampling(), image_info_map);
   }
   SetPipelineLayout(descriptors_[0]->layout());
 }
 
 glm::vec2 StaticText::AddText(int text_index, float height, float base_x,
                               float base_y, Align align) {
-  texts_to_draw_.push_back(text_index);
   const auto& texture_info = text_loader_.texture_info(text_index);
   // If 'height' is negative, we should avoid to negate X-axis of ratio.
   const glm::vec2 ratio = SetXPositive(
-      glm::vec2{texture_info.aspect_ratio / viewport_aspect_ratio(), 1.0f} *
-      (height / 1.0f));
-  const float width_in_frame = 1.0f * ratio.x;
+      glm::vec2{1.0f / viewport_aspect_ratio(), 1.0f} * height);
+  const float width_in_frame = texture_info.advance_x * ratio.x;
   const float offset_x = GetOffsetX(base_x, align, width_in_frame);
   text::AppendCharPosAndTexCoord(
-      /*pos_bottom_left=*/{offset_x, base_y - texture_info.base_y * ratio.y},
-      /*pos_increment=*/glm::vec2{1.0f} * ratio,
-      /*tex_coord_bottom_left=*/glm::vec2{0.0f},
-      /*tex_coord_increment=*/glm::vec2{1.0f},
+      /*pos_bottom_left=*/
+      glm::vec2{offset_x, base_y} + texture_info.bounds_bottom_left * ratio,
+      /*pos_increment=*/texture_info.bounds_size * ratio,
+      /*tex_coord_bottom_left=*/texture_info.tex_coord_bottom_left,
+      /*tex_coord_increment=*/texture_info.tex_coord_size,
       mutable_vertices());
 
   return glm::vec2{offset_x, offset_x + width_in_frame};
@@ -184,51 +241,26 @@ glm::vec2 StaticText::AddText(int text_index, float height, float base_x,
 
 void StaticText::Draw(const VkCommandBuffer& command_buffer,
                       int frame, const glm::vec3& color, float alpha) {
-  const int num_texts = UpdateBuffers(frame, color, alpha);
-  ASSERT_TRUE(num_texts == texts_to_draw_.size(),
-              absl::StrFormat("Expected number of texts: %d vs %d",
-                              num_texts, texts_to_draw_.size()));
+  const int num_rects = UpdateBuffers(frame, color, alpha);
   pipeline().Bind(command_buffer);
-  for (int i = 0; i < num_texts; ++i) {
-    UpdateDescriptor(command_buffer, frame, texts_to_draw_[i]);
-    vertex_buffer().Draw(command_buffer, kVertexBufferBindingPoint,
-                         /*mesh_index=*/i, /*instance_count=*/1);
-  }
-  texts_to_draw_.clear();
-}
-
-void StaticText::UpdateDescriptor(const VkCommandBuffer& command_buffer,
-                                  int frame, int text_index) {
-  descriptors_[frame]->PushBufferInfos(
-      command_buffer, pipeline().layout(), pipeline().binding_point(),
-      UniformBuffer::GetDescriptorType(),
-      /*buffer_info_map=*/{{
-          kUniformBufferBindingPoint,
-          {GetUniformBufferDescriptorInfo(frame)},
-      }}
-  );
-  descriptors_[frame]->PushImageInfos(
-      command_buffer, pipeline().layout(), pipeline().binding_point(),
-      Image::GetDescriptorTypeForSampling(),
-      /*image_info_map=*/{{
-          kTextureBindingPoint,
-          {text_loader_.texture_info(text_index).image
-               ->GetDescriptorInfoForSampling()},
-      }}
-  );
+  descriptors_[frame]->Bind(command_buffer, pipeline().layout(),
+                            pipeline().binding_point());
+  DrawRects(command_buffer, num_rects);
 }
 
 DynamicText::DynamicText(const SharedBasicContext& context,
                          int num_frames_in_flight,
                          float viewport_aspect_ratio,
                          absl::Span<const std::string> texts,
-                         Font font, int font_height)
+                         Font font, int font_height, GlyphMode glyph_mode)
     : Text{context, "Dynamic text", num_frames_in_flight,
-           viewport_aspect_ratio},
-      char_loader_{context, texts, font, font_height} {
+           viewport_aspect_ratio, glyph_mode},
+      glyph_atlas_{context, num_frames_in_flight, texts, font, font_height,
+                   glyph_mode, GetGlyphAtlasConfig(num_frames_in_flight)},
+      num_atlas_evictions_{glyph_atlas_.num_evictions()} {
   const Descriptor::ImageInfoMap image_info_map{{
       kTextureBindingPoint,
-      {char_loader_.atlas_image()->GetDescriptorInfoForSampling()}}};
+      {glyph_atlas_.atlas_image().GetDescriptorInfoForSampling()}}};
   descriptors_.reserve(num_frames_in_flight);
   for (int frame = 0; frame < num_frames_in_flight; ++frame) {
     descriptors_.push_back(
@@ -247,38 +279,83 @@ DynamicText::DynamicText(const SharedBasicContext& context,
 
 glm::vec2 DynamicText::AddText(const std::string& text, float height,
                                float base_x, float base_y, Align align) {
-  // If 'height' is negative, we should avoid to negate X-axis of ratio.
-  const glm::vec2 ratio = SetXPositive(
-      glm::vec2{char_loader_.GetAspectRatio() / viewport_aspect_ratio(), 1.0f} *
-      (height / 1.0f));
-  float total_width_in_tex_coord = 0.0f;
-  for (const auto character : text) {
-    if (character == ' ') {
-      total_width_in_tex_coord += char_loader_.space_advance();
-    } else {
-      const auto& texture_info = char_loader_.char_texture_info(character);
-      total_width_in_tex_coord += texture_info.advance_x;
+  GlyphRunKey key{text, height, align};
+  auto iter = glyph_runs_.find(key);
+  if (iter == glyph_runs_.end()) {
+    GlyphRun glyph_run = LayOutText(text, height, align);
+    // Loading glyphs may have evicted pages used by cached glyph runs. Glyph
+    // runs added in this frame are not affected, since their pages are used.
+    if (glyph_atlas_.num_evictions() != num_atlas_evictions_) {
+      glyph_runs_.clear();
+      num_atlas_evictions_ = glyph_atlas_.num_evictions();
+    }
+    iter = glyph_runs_.insert({std::move(key), std::move(glyph_run)}).first;
+  } else {
+    for (const int page : iter->second.pages) {
+      glyph_atlas_.MarkPageUsed(page);
     }
   }
 
-  const float initial_offset_x = GetOffsetX(base_x, align,
-                                            total_width_in_tex_coord * ratio.x);
-  const float final_offset_x = text::LoadCharsVertexData(
-      text, char_loader_, ratio, initial_offset_x, base_y, mutable_vertices());
-
-  return glm::vec2{initial_offset_x, final_offset_x};
+  GlyphRun& glyph_run = iter->second;
+  glyph_run.last_used_frame = frame_count_;
+  text::AppendTranslatedVertices(glyph_run.vertices, {base_x, base_y},
+                                 mutable_vertices());
+  return glyph_run.boundary + base_x;
 }
 
 void DynamicText::Draw(const VkCommandBuffer& command_buffer,
                        int frame, const glm::vec3& color, float alpha) {
-  const int num_chars = UpdateBuffers(frame, color, alpha);
+  const int num_rects = UpdateBuffers(frame, color, alpha);
   pipeline().Bind(command_buffer);
   descriptors_[frame]->Bind(command_buffer, pipeline().layout(),
                             pipeline().binding_point());
-  for (int i = 0; i < num_chars; ++i) {
-    vertex_buffer().Draw(command_buffer, kVertexBufferBindingPoint,
-                         /*mesh_index=*/i, /*instance_count=*/1);
+  DrawRects(command_buffer, num_rects);
+  glyph_atlas_.NextFrame();
+
+  if (glyph_runs_.size() > kMaxNumGlyphRuns) {
+    for (auto iter = glyph_runs_.begin(); iter != glyph_runs_.end();) {
+      if (iter->second.last_used_frame != frame_count_) {
+        glyph_runs_.erase(iter++);
+      } else {
+        ++iter;
+      }
+    }
+  }
+  ++frame_count_;
+}
+
+DynamicText::GlyphRun DynamicText::LayOutText(const std::string& text,
+                                              float height, Align align) {
+  // If 'height' is negative, we should avoid to negate X-axis of ratio.
+  // Glyph metrics are normalized by the height of the tallest glyph, hence
+  // scaling them by 'height' makes that glyph exactly 'height' tall.
+  const glm::vec2 ratio = SetXPositive(
+      glm::vec2{1.0f / viewport_aspect_ratio(), 1.0f} * height);
+  const std::u32string codepoints = common::utf8::Decode(text);
+  glyph_atlas_.LoadGlyphs(codepoints);
+  float total_width_in_tex_coord = 0.0f;
+  for (const auto codepoint : codepoints) {
+    total_width_in_tex_coord +=
+        glyph_atlas_.GetCharTextureInfo(codepoint).advance_x;
+  }
+
+  GlyphRun glyph_run;
+  const float initial_offset_x = GetOffsetX(/*base_x=*/0.0f, align,
+                                            total_width_in_tex_coord * ratio.x);
+  const float final_offset_x = text::LoadCharsVertexData(
+      codepoints, &glyph_atlas_, ratio, initial_offset_x, /*base_y=*/0.0f,
+      &glyph_run.vertices);
+  glyph_run.boundary = glm::vec2{initial_offset_x, final_offset_x};
+
+  for (const auto codepoint : codepoints) {
+    const int page = glyph_atlas_.GetPage(codepoint);
+    if (page != common::GlyphCache::kNoPage &&
+        std::find(glyph_run.pages.begin(), glyph_run.pages.end(), page) ==
+            glyph_run.pages.end()) {
+      glyph_run.pages.push_back(page);
+    }
   }
+  return glyph_run;
 }
 
 } /* namespace vulkan */
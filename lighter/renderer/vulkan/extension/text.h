@@ -8,9 +8,11 @@
 #ifndef LIGHTER_RENDERER_VULKAN_EXTENSION_TEXT_H
 #define LIGHTER_RENDERER_VULKAN_EXTENSION_TEXT_H
 
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
+#include <tuple>
 #include <vector>
 
 #include "lighter/common/file.h"
@@ -21,6 +23,7 @@
 #include "lighter/renderer/vulkan/wrapper/descriptor.h"
 #include "lighter/renderer/vulkan/wrapper/pipeline.h"
 #include "lighter/renderer/vulkan/wrapper/render_pass.h"
+#include "third_party/absl/container/flat_hash_map.h"
 #include "third_party/absl/types/span.h"
 #include "third_party/glm/glm.hpp"
 
@@ -30,11 +33,14 @@ namespace vulkan {
 
 // This is the base class of all text renderer classes. The user should use it
 // through derived classes. It gathers common members of renderers.
+// All texts added in a frame are sampled from one texture, and rendered with
+// one draw call.
 // Update() must have been called before calling Draw() for the first time, and
 // whenever the render pass is changed.
 class Text {
  public:
   using Font = CharLoader::Font;
+  using GlyphMode = CharLoader::GlyphMode;
 
   // We only support the horizontal layout for now.
   enum class Align { kLeft, kCenter, kRight };
@@ -61,16 +67,23 @@ class Text {
 
  protected:
   // When the frame is resized, the aspect ratio of viewport will always be
-  // 'viewport_aspect_ratio'.
+  // 'viewport_aspect_ratio'. 'glyph_mode' determines what is stored in textures
+  // bound by derived classes.
   Text(const SharedBasicContext& context,
        std::string&& pipeline_name,
        int num_frames_in_flight,
-       float viewport_aspect_ratio);
+       float viewport_aspect_ratio,
+       GlyphMode glyph_mode);
 
   // Updates uniform buffer and vertex buffer, and returns the number of
-  // meshes to render. 'vertices_to_draw_' will be cleared after calling this.
+  // rectangles to render. 'vertices_to_draw_' will be cleared after calling
+  // this.
   int UpdateBuffers(int frame, const glm::vec3& color, float alpha);
 
+  // Renders 'num_rects' rectangles uploaded by UpdateBuffers() with one draw
+  // call. This should be called when 'command_buffer' is recording commands.
+  void DrawRects(const VkCommandBuffer& command_buffer, int num_rects) const;
+
   // Sets layout of graphics pipeline.
   void SetPipelineLayout(const VkDescriptorSetLayout& layout);
 
@@ -79,7 +92,6 @@ class Text {
 
   // Accessors.
   float viewport_aspect_ratio() const { return viewport_aspect_ratio_; }
-  const PerVertexBuffer& vertex_buffer() const { return vertex_buffer_; }
   const Pipeline& pipeline() const {
     ASSERT_NON_NULL(pipeline_, "Update() must have been called");
     return *pipeline_;
@@ -96,6 +108,10 @@ class Text {
   // Vertices of added texts.
   std::vector<common::Vertex2D> vertices_to_draw_;
 
+  // Indices for rendering rectangles in 'vertices_to_draw_'. This only grows,
+  // and a prefix of it is used in each frame.
+  std::vector<uint32_t> indices_;
+
   // Vertex buffer for rendering bounding boxes of characters or texts.
   DynamicPerVertexBuffer vertex_buffer_;
 
@@ -107,16 +123,20 @@ class Text {
   std::unique_ptr<Pipeline> pipeline_;
 };
 
-// This class renders each elements of 'texts' to one texture, so that later
-// when the user wants to render any of them, this renderer only needs to bind
-// the corresponding texture. This is backed by TextLoader.
+// This class renders all elements of 'texts' to one atlas texture, so that
+// later when the user wants to render any of them, this renderer only needs to
+// sample the corresponding region. This is backed by TextLoader.
+// 'glyph_mode' only affects how text textures are generated. Since they have
+// a fixed resolution, texts should not be rendered much larger than
+// 'font_height' in either mode.
 class StaticText : public Text {
  public:
   StaticText(const SharedBasicContext& context,
              int num_frames_in_flight,
              float viewport_aspect_ratio,
              absl::Span<const std::string> texts,
-             Font font, int font_height);
+             Font font, int font_height,
+             GlyphMode glyph_mode = GlyphMode::kBitmap);
 
   // This class is neither copyable nor movable.
   StaticText(const StaticText&) = delete;
@@ -136,57 +156,101 @@ class StaticText : public Text {
             int frame, const glm::vec3& color, float alpha) override;
 
  private:
-  // Updates the descriptor for rendering the text at 'text_index'.
-  // This should be called when 'command_buffer' is recording commands.
-  void UpdateDescriptor(const VkCommandBuffer& command_buffer,
-                        int frame, int text_index);
-
-  // Renders each text (containing multiple characters) to one texture.
+  // Renders all texts (containing multiple characters) to one texture.
   TextLoader text_loader_;
 
   // Descriptors indexed by frame.
-  std::vector<std::unique_ptr<DynamicDescriptor>> descriptors_;
-
-  // Indices of texts to draw. This can contain duplicates.
-  std::vector<int> texts_to_draw_;
+  std::vector<std::unique_ptr<StaticDescriptor>> descriptors_;
 };
 
-// This class renders all characters in 'texts' to one texture, so that when the
-// user wants to render any combination of those characters, this renderer only
-// needs to bind that texture. This is backed by CharLoader.
+// This class renders characters onto one texture on demand, so that this
+// renderer only needs to bind that texture to render any text. Texts are
+// encoded in UTF-8, and may contain any characters supported by the font.
+// Characters in 'texts' are loaded when constructed, and the tallest of them
+// determines the scale of all characters. This is backed by GlyphAtlas.
+// If 'glyph_mode' is GlyphMode::kSignedDistanceField, texts stay crisp at any
+// size, hence one renderer with a small 'font_height' can serve all sizes.
+// Texts that have been laid out are cached by the string, height and
+// alignment, so that texts added in every frame, such as labels of user
+// interfaces, are only laid out once.
 class DynamicText : public Text {
  public:
   DynamicText(const SharedBasicContext& context,
               int num_frames_in_flight,
               float viewport_aspect_ratio,
               absl::Span<const std::string> texts,
-              Font font, int font_height);
+              Font font, int font_height,
+              GlyphMode glyph_mode = GlyphMode::kBitmap);
 
   // This class is neither copyable nor movable.
   DynamicText(const DynamicText&) = delete;
   DynamicText& operator=(const DynamicText&) = delete;
 
   // Creates vertex data for rendering 'text', and returns left and right
-  // boundary of the rendered text. Each character must have been included in
-  // 'texts' passed to the constructor. 'base_x', 'base_y' and returned values
-  // are in range [0.0, 1.0], while 'height' is in range [-1.0, 1.0].
+  // boundary of the rendered text. Characters that are not loaded yet will be
+  // loaded, and copied to the device when Upload() is called. 'base_x',
+  // 'base_y' and returned values are in range [0.0, 1.0], while 'height' is in
+  // range [-1.0, 1.0].
   // Every character will keep its original aspect ratio. The vertex data will
   // be cleared after calling Draw(), hence the user should add all texts again
   // before the next call to Draw().
   glm::vec2 AddText(const std::string& text, float height, float base_x,
                     float base_y, Align align);
 
+  // Records commands that copy characters loaded by AddText() to the device.
+  // This must be called after all texts of 'frame' are added, and before the
+  // render pass in which Draw() is called, since copies can't be recorded
+  // inside render passes. 'command_buffer' must be submitted to the graphics
+  // queue.
+  void Upload(const VkCommandBuffer& command_buffer, int frame) {
+    glyph_atlas_.Upload(command_buffer, frame);
+  }
+
   // Overrides.
   void Draw(const VkCommandBuffer& command_buffer,
             int frame, const glm::vec3& color, float alpha) override;
 
  private:
-  // Renders all characters that may be used onto one big texture, so that we
-  // only need to bind that texture to render different combinations of chars.
-  CharLoader char_loader_;
+  // Identifies a text laid out by LayOutText().
+  using GlyphRunKey = std::tuple<std::string, float, Align>;
+
+  // Vertex data of a text laid out at 'base_x' and 'base_y' both being 0.0.
+  struct GlyphRun {
+    // Vertex data of all characters.
+    std::vector<common::Vertex2D> vertices;
+
+    // Left and right boundary of the text.
+    glm::vec2 boundary;
+
+    // Pages of 'glyph_atlas_' that hold glyphs of the text.
+    std::vector<int> pages;
+
+    // Frame in which this glyph run was added for the last time.
+    uint64_t last_used_frame;
+  };
+
+  // Lays out 'text' with 'height' and 'align'. Characters that are not loaded
+  // yet will be loaded.
+  GlyphRun LayOutText(const std::string& text, float height, Align align);
+
+  // Renders characters onto one big texture on demand, so that we only need to
+  // bind that texture to render different combinations of chars.
+  GlyphAtlas glyph_atlas_;
 
   // Descriptors indexed by frame.
   std::vector<std::unique_ptr<StaticDescriptor>> descriptors_;
+
+  // Texts that have been laid out. Since glyph runs refer to locations of
+  // glyphs on 'glyph_atlas_', all of them are dropped once any page of it is
+  // evicted.
+  absl::flat_hash_map<GlyphRunKey, GlyphRun> glyph_runs_;
+
+  // Number of pages evicted from 'glyph_atlas_' when 'glyph_runs_' was last
+  // validated.
+  int num_atlas_evictions_;
+
+  // Number of frames drawn so far.
+  uint64_t frame_count_ = 0;
 };
 
 } /* namespace vulkan */
@@ -11,6 +11,8 @@
 
 #include "lighter/common/graphics_api.h"
 #include "lighter/common/image.h"
+#include "lighter/common/rect_packer.h"
+#include "lighter/common/utf8.h"
 #include "lighter/renderer/ir/image_usage.h"
 #include "lighter/renderer/vulkan/extension/graphics_pass.h"
 #include "lighter/renderer/vulkan/wrapper/command.h"
@@ -42,18 +44,33 @@ std::string GetFontPath(CharLoader::Font font) {
   }
 }
 
-// Returns the interval between two adjacent characters on the character atlas
-// image in number of pixels. We add this interval so that when sampling one
-// character, other characters will not affect the result due to numeric errors.
-int GetIntervalBetweenChars(const common::CharLib& char_lib) {
-  constexpr int kCharWidthToIntervalRatio = 100;
-  int total_width = 0;
+// Number of pixels between two adjacent characters on the character atlas
+// image. We add this padding so that when sampling one character, other
+// characters will not affect the result due to numeric errors.
+constexpr int kPaddingBetweenChars = 2;
+
+// Returns the height of the tallest character (excluding space) in 'char_lib'.
+// Padding around glyph images is not counted.
+int GetLineHeight(const common::CharLib& char_lib) {
+  ASSERT_NON_EMPTY(char_lib.char_info_map(), "No character loaded");
+  int height = 0;
   for (const auto& pair : char_lib.char_info_map()) {
     if (pair.first != ' ') {
-      total_width += pair.second.image->width();
+      height = std::max(height, pair.second.image.height());
     }
   }
-  return std::max(total_width / kCharWidthToIntervalRatio, 1);
+  return std::max(height - char_lib.glyph_padding() * 2, 1);
+}
+
+// Returns the path to the fragment shader that renders characters from the
+// character atlas image.
+std::string GetCharFragShaderPath(CharLoader::GlyphMode glyph_mode) {
+  switch (glyph_mode) {
+    case CharLoader::GlyphMode::kBitmap:
+      return "text/char.frag";
+    case CharLoader::GlyphMode::kSignedDistanceField:
+      return "text/char_sdf.frag";
+  }
 }
 
 // Returns descriptor infos for rendering characters.
@@ -103,7 +120,8 @@ std::unique_ptr<GraphicsPipelineBuilder> CreatePipelineBuilder(
     std::string&& pipeline_name,
     const PerVertexBuffer& vertex_buffer,
     const VkDescriptorSetLayout& descriptor_layout,
-    bool enable_color_blend) {
+    bool enable_color_blend,
+    const std::string& frag_shader_path) {
   auto pipeline_builder = std::make_unique<GraphicsPipelineBuilder>(context);
 
   (*pipeline_builder)
@@ -118,7 +136,7 @@ std::unique_ptr<GraphicsPipelineBuilder> CreatePipelineBuilder(
                      "text/char.vert", common::api::GraphicsApi::kVulkan))
       .SetShader(VK_SHADER_STAGE_FRAGMENT_BIT,
                  common::file::GetShaderBinaryPath(
-                     "text/char.frag", common::api::GraphicsApi::kVulkan));
+                     frag_shader_path, common::api::GraphicsApi::kVulkan));
 
   return pipeline_builder;
 }
@@ -148,26 +166,45 @@ inline glm::vec2 NormalizePos(const glm::vec2& coordinate) {
   return coordinate * 2.0f - 1.0f;
 }
 
+// Appends the vertex data of a character described by 'texture_info' to the
+// end of 'vertices', and returns the X offset of the next character.
+float AppendCharVertexData(const CharLoader::CharTextureInfo& texture_info,
+                           const glm::vec2& ratio, float offset_x,
+                           float base_y, std::vector<Vertex2D>* vertices) {
+  const glm::vec2& size = texture_info.size;
+  text::AppendCharPosAndTexCoord(
+      /*pos_bottom_left=*/
+      {offset_x + texture_info.bearing.x * ratio.x,
+       base_y + (texture_info.bearing.y - size.y) * ratio.y},
+      /*pos_increment=*/size * ratio,
+      /*tex_coord_bottom_left=*/texture_info.tex_coord_bottom_left,
+      /*tex_coord_increment=*/texture_info.tex_coord_size,
+      vertices);
+  return offset_x + texture_info.advance_x * ratio.x;
+}
+
 } /* namespace */
 
 CharLoader::CharLoader(const SharedBasicContext& context,
                        absl::Span<const std::string> texts,
-                       Font font, int font_height) {
+                       Font font, int font_height, GlyphMode glyph_mode)
+    : glyph_mode_{glyph_mode} {
   CharImageMap char_image_map;
   {
     const common::CharLib char_lib{
-        texts, GetFontPath(font), font_height, /*flip_y=*/true};
-    const int interval_between_chars = GetIntervalBetweenChars(char_lib);
+        texts, GetFontPath(font), font_height, /*flip_y=*/true, glyph_mode_};
+    const int line_height = GetLineHeight(char_lib);
     const auto image_usages = {ImageUsage::GetRenderTargetUsage(0),
                                ImageUsage::GetSampledInFragmentShaderUsage()};
     char_atlas_image_ = std::make_unique<OffscreenImage>(
-        context, GetCharAtlasImageExtent(char_lib, interval_between_chars),
+        context,
+        PackCharAtlas(
+            char_lib, line_height,
+            context->physical_device_limits().maxImageDimension2D),
         common::image::kBwImageChannel, image_usages, GetTextSamplerConfig(),
         /*use_high_precision=*/false);
-    space_advance_x_ = GetSpaceAdvanceX(char_lib, *char_atlas_image_);
-    CreateCharTextures(context, char_lib, interval_between_chars,
-                       *char_atlas_image_, &char_image_map,
-                       &char_texture_info_map_);
+    space_advance_x_ = GetSpaceAdvanceX(char_lib, line_height);
+    CreateCharTextures(context, char_lib, &char_image_map);
   }
 
   std::vector<char> char_merge_order;
@@ -184,9 +221,12 @@ CharLoader::CharLoader(const SharedBasicContext& context,
   const auto render_pass = BuildRenderPass(*char_atlas_image_,
                                            render_pass_builder.get());
 
+  // Glyph images are copied to the atlas image as is, no matter whether they
+  // store coverage or distances.
   auto pipeline_builder =
       CreatePipelineBuilder(context, "Char loader", *vertex_buffer,
-                            descriptor->layout(), /*enable_color_blend=*/false);
+                            descriptor->layout(), /*enable_color_blend=*/false,
+                            GetCharFragShaderPath(GlyphMode::kBitmap));
   const auto pipeline = BuildPipeline(*char_atlas_image_, **render_pass,
                                       pipeline_builder.get());
 
@@ -216,66 +256,67 @@ CharLoader::CharLoader(const SharedBasicContext& context,
       });
 }
 
-VkExtent2D CharLoader::GetCharAtlasImageExtent(
-    const common::CharLib& char_lib, int interval_between_chars) const {
-  ASSERT_NON_EMPTY(char_lib.char_info_map(), "No character loaded");
-  int total_width = 0, height = 0;
+VkExtent2D CharLoader::PackCharAtlas(const common::CharLib& char_lib,
+                                     int line_height, int max_dimension) {
+  std::vector<char> chars;
+  std::vector<glm::ivec2> glyph_sizes;
+  chars.reserve(char_lib.char_info_map().size());
+  glyph_sizes.reserve(char_lib.char_info_map().size());
   for (const auto& pair : char_lib.char_info_map()) {
     if (pair.first != ' ') {
-      total_width += pair.second.image->width() + interval_between_chars;
-      height = std::max(height, pair.second.image->height());
+      chars.push_back(pair.first);
+      glyph_sizes.push_back(
+          glm::ivec2{pair.second.image.width(), pair.second.image.height()});
     }
   }
-  total_width -= interval_between_chars;
+
+  const common::SinglePagePacking packing = common::PackIntoSinglePage(
+      glyph_sizes, kPaddingBetweenChars, max_dimension);
+  const glm::vec2 tex_coord_ratio = 1.0f / glm::vec2{packing.page_size};
+  const float layout_ratio = 1.0f / static_cast<float>(line_height);
+  for (int i = 0; i < chars.size(); ++i) {
+    const auto& char_info = char_lib.char_info_map().find(chars[i])->second;
+    const glm::vec2 glyph_size{glyph_sizes[i]};
+    char_texture_info_map_.insert({chars[i], CharTextureInfo{
+        /*size=*/glyph_size * layout_ratio,
+        /*bearing=*/glm::vec2{char_info.bearing} * layout_ratio,
+        /*advance_x=*/static_cast<float>(char_info.advance.x) * layout_ratio,
+        /*tex_coord_bottom_left=*/
+        glm::vec2{packing.placements[i].offset} * tex_coord_ratio,
+        /*tex_coord_size=*/glyph_size * tex_coord_ratio,
+    }});
+  }
+
   return VkExtent2D{
-      static_cast<uint32_t>(total_width),
-      static_cast<uint32_t>(height),
+      static_cast<uint32_t>(packing.page_size.x),
+      static_cast<uint32_t>(packing.page_size.y),
   };
 }
 
 std::optional<float> CharLoader::GetSpaceAdvanceX(
-    const common::CharLib& char_lib, const Image& target_image) const {
+    const common::CharLib& char_lib, int line_height) const {
   const auto iter = char_lib.char_info_map().find(' ');
   std::optional<float> space_advance;
   if (iter != char_lib.char_info_map().end()) {
-    space_advance = static_cast<float>(iter->second.advance.x) /
-                    target_image.extent().width;
+    space_advance = static_cast<float>(iter->second.advance.x) / line_height;
   }
   return space_advance;
 }
 
-void CharLoader::CreateCharTextures(
-    const SharedBasicContext& context,
-    const common::CharLib& char_lib,
-    int interval_between_chars, const Image& target_image,
-    CharImageMap* char_image_map,
-    CharTextureInfoMap* char_texture_info_map) const {
-  const glm::vec2 ratio = 1.0f / util::ExtentToVec(target_image.extent());
-  const float normalized_interval =
-      static_cast<float>(interval_between_chars) * ratio.x;
+void CharLoader::CreateCharTextures(const SharedBasicContext& context,
+                                    const common::CharLib& char_lib,
+                                    CharImageMap* char_image_map) const {
   const auto image_usages = {ImageUsage::GetSampledInFragmentShaderUsage()};
-
-  float offset_x = 0.0f;
   for (const auto& pair : char_lib.char_info_map()) {
-    const char character = pair.first;
-    if (character == ' ') {
+    if (pair.first == ' ') {
       continue;
     }
-
-    const auto& char_info = pair.second;
-    const auto advance_x = static_cast<float>(char_info.advance.x) * ratio.x;
-    const glm::vec2 size =
-        glm::vec2{char_info.image->width(), char_info.image->height()} * ratio;
-    const glm::vec2 bearing = glm::vec2{char_info.bearing} * ratio;
-    char_texture_info_map->insert({
-        character, CharTextureInfo{size, bearing, offset_x, advance_x}});
     char_image_map->insert({
-        character,
+        pair.first,
         std::make_unique<TextureImage>(context, /*generate_mipmaps=*/false,
-                                       *char_info.image, image_usages,
+                                       pair.second.image, image_usages,
                                        GetTextSamplerConfig()),
     });
-    offset_x += size.x + normalized_interval;
   }
 }
 
@@ -286,10 +327,11 @@ std::unique_ptr<StaticPerVertexBuffer> CharLoader::CreateVertexBuffer(
   vertices.reserve(text::kNumVerticesPerRect * char_merge_order.size());
   for (const auto character : char_merge_order) {
     const auto& texture_info = char_texture_info_map_.find(character)->second;
+    // The viewport covers the full atlas image, hence positions on it are the
+    // same as texture coordinates.
     text::AppendCharPosAndTexCoord(
-        /*pos_bottom_left=*/
-        {texture_info.offset_x, 0.0f},
-        /*pos_increment=*/texture_info.size,
+        /*pos_bottom_left=*/texture_info.tex_coord_bottom_left,
+        /*pos_increment=*/texture_info.tex_coord_size,
         /*tex_coord_bottom_left=*/glm::vec2{0.0f},
         /*tex_coord_increment=*/glm::vec2{1.0f},
         &vertices);
@@ -307,106 +349,255 @@ std::unique_ptr<StaticPerVertexBuffer> CharLoader::CreateVertexBuffer(
   );
 }
 
-TextLoader::TextLoader(const SharedBasicContext& context,
-                       absl::Span<const std::string> texts,
-                       CharLoader::Font font, int font_height) {
-  const auto& longest_text = std::max_element(
-      texts.begin(), texts.end(),
-      [](const std::string& lhs, const std::string& rhs) {
-        return lhs.length() > rhs.length();
-      });
-  DynamicPerVertexBuffer vertex_buffer{
-      context, text::GetVertexDataSize(longest_text->length()),
-      pipeline::GetVertexAttributes<Vertex2D>()};
+GlyphAtlas::GlyphAtlas(const SharedBasicContext& context,
+                       int num_frames_in_flight,
+                       absl::Span<const std::string> texts_to_preload,
+                       CharLoader::Font font, int font_height,
+                       GlyphMode glyph_mode, const Config& config)
+    : glyph_cache_{GetFontPath(font), font_height, glyph_mode, config},
+      staging_buffers_(num_frames_in_flight) {
+  // Pages are stacked vertically on the atlas image.
+  const glm::ivec2 atlas_size{config.page_size.x,
+                              config.page_size.y * config.max_num_pages};
+  const auto max_dimension =
+      static_cast<int>(context->physical_device_limits().maxImageDimension2D);
+  ASSERT_TRUE(glm::all(glm::lessThanEqual(atlas_size,
+                                          glm::ivec2{max_dimension})),
+              absl::StrFormat("Atlas of size (%d, %d) exceeds the maximum "
+                              "image dimension %d",
+                              atlas_size.x, atlas_size.y, max_dimension));
+
+  std::vector<char32_t> codepoints;
+  for (const auto& text : texts_to_preload) {
+    const std::u32string decoded = common::utf8::Decode(text);
+    codepoints.insert(codepoints.end(), decoded.begin(), decoded.end());
+  }
+  glyph_cache_.LoadGlyphs(codepoints);
+  int tallest_height = 0;
+  for (const auto codepoint : codepoints) {
+    tallest_height =
+        std::max(tallest_height, glyph_cache_.GetGlyph(codepoint).size.y);
+  }
+  line_height_ = tallest_height > 0
+                     ? tallest_height - glyph_cache_.glyph_padding() * 2
+                     : font_height;
+  line_height_ = std::max(line_height_, 1.0f);
+
+  // Preloaded glyphs are written to the initial content of the atlas image, so
+  // that they need not be uploaded with Upload().
+  std::vector<uint8_t> pixels(
+      static_cast<size_t>(atlas_size.x) * atlas_size.y, 0);
+  for (const auto& dirty_region : glyph_cache_.FlushDirtyRegions()) {
+    const int base_y =
+        dirty_region.offset.y + config.page_size.y * dirty_region.page;
+    for (int row = 0; row < dirty_region.extent.y; ++row) {
+      std::copy_n(
+          dirty_region.pixels.data() +
+              static_cast<size_t>(row) * dirty_region.extent.x,
+          dirty_region.extent.x,
+          pixels.data() + static_cast<size_t>(base_y + row) * atlas_size.x +
+              dirty_region.offset.x);
+    }
+  }
+  const common::Image atlas_image{atlas_size.x, atlas_size.y,
+                                  common::image::kBwImageChannel,
+                                  pixels.data(), /*flip_y=*/false};
+  const auto image_usages = {ImageUsage::GetSampledInFragmentShaderUsage()};
+  atlas_image_ = std::make_unique<TextureImage>(
+      context, /*generate_mipmaps=*/false, atlas_image, image_usages,
+      GetTextSamplerConfig());
+}
 
-  auto descriptor = std::make_unique<StaticDescriptor>(
-      context, CreateDescriptorInfos());
-  auto render_pass_builder = CreateRenderPassBuilder(context);
-  // Advance can be negative, and thus bounding boxes of characters may have
-  // overlap, hence we need to enable color blending.
-  auto pipeline_builder =
-      CreatePipelineBuilder(context, "Text loader", vertex_buffer,
-                            descriptor->layout(), /*enable_color_blend=*/true);
+CharLoader::CharTextureInfo GlyphAtlas::GetCharTextureInfo(
+    char32_t codepoint) {
+  const common::GlyphCache::GlyphInfo glyph_info =
+      glyph_cache_.GetGlyph(codepoint);
+  const glm::ivec2& page_size = glyph_cache_.config().page_size;
+  const glm::vec2 tex_coord_ratio =
+      1.0f / glm::vec2{page_size.x,
+                       page_size.y * glyph_cache_.config().max_num_pages};
+  const glm::ivec2 offset_on_atlas{
+      glyph_info.offset.x,
+      glyph_info.offset.y + page_size.y * std::max(glyph_info.page, 0)};
+  const float layout_ratio = 1.0f / line_height_;
+  return CharLoader::CharTextureInfo{
+      /*size=*/glm::vec2{glyph_info.size} * layout_ratio,
+      /*bearing=*/glm::vec2{glyph_info.bearing} * layout_ratio,
+      /*advance_x=*/static_cast<float>(glyph_info.advance.x) * layout_ratio,
+      /*tex_coord_bottom_left=*/glm::vec2{offset_on_atlas} * tex_coord_ratio,
+      /*tex_coord_size=*/glm::vec2{glyph_info.size} * tex_coord_ratio,
+  };
+}
 
-  const CharLoader char_loader{context, texts, font, font_height};
-  text_texture_infos_.reserve(texts.size());
-  for (const auto& text : texts) {
-    text_texture_infos_.push_back(
-        CreateTextTexture(context, text, font_height, char_loader,
-                          descriptor.get(), render_pass_builder.get(),
-                          pipeline_builder.get(), &vertex_buffer));
+void GlyphAtlas::Upload(const VkCommandBuffer& command_buffer, int frame) {
+  // Commands previously recorded for 'frame' have finished, hence the staging
+  // buffer they used can be released.
+  staging_buffers_[frame].reset();
+  const std::vector<common::GlyphCache::DirtyRegion> dirty_regions =
+      glyph_cache_.FlushDirtyRegions();
+  if (dirty_regions.empty()) {
+    return;
+  }
+
+  const int page_height = glyph_cache_.config().page_size.y;
+  std::vector<TextureImage::Region> regions;
+  regions.reserve(dirty_regions.size());
+  for (const auto& dirty_region : dirty_regions) {
+    regions.push_back(TextureImage::Region{
+        VkOffset2D{
+            dirty_region.offset.x,
+            dirty_region.offset.y + page_height * dirty_region.page,
+        },
+        VkExtent2D{
+            static_cast<uint32_t>(dirty_region.extent.x),
+            static_cast<uint32_t>(dirty_region.extent.y),
+        },
+        dirty_region.pixels,
+    });
   }
+  staging_buffers_[frame] =
+      atlas_image_->RecordUpdateRegions(command_buffer, regions);
 }
 
-TextLoader::TextTextureInfo TextLoader::CreateTextTexture(
-    const SharedBasicContext& context,
-    const std::string& text, int font_height,
-    const CharLoader& char_loader,
-    StaticDescriptor* descriptor,
-    RenderPassBuilder* render_pass_builder,
-    GraphicsPipelineBuilder* pipeline_builder,
-    DynamicPerVertexBuffer* vertex_buffer) const {
-  float total_advance_x = 0.0f;
-  float highest_base_y = 0.0f;
-  for (const auto character : text) {
-    if (character == ' ') {
-      total_advance_x += char_loader.space_advance();
-    } else {
+TextLoader::TextLoader(const SharedBasicContext& context,
+                       absl::Span<const std::string> texts,
+                       CharLoader::Font font, int font_height,
+                       CharLoader::GlyphMode glyph_mode) {
+  const CharLoader char_loader{context, texts, font, font_height, glyph_mode};
+
+  // In the coordinate of character glyphs, the line height is 1.0, and glyphs
+  // may extend beyond the advance and the line height, for example if they
+  // have negative bearings or are italic. Each text occupies a region that
+  // covers its advance and bounding boxes of all its glyphs, which is scaled by
+  // 'font_height' on the atlas image.
+  std::vector<float> advance_xs;
+  std::vector<glm::vec2> bounds_bottom_lefts;
+  std::vector<glm::ivec2> text_sizes;
+  advance_xs.reserve(texts.size());
+  bounds_bottom_lefts.reserve(texts.size());
+  text_sizes.reserve(texts.size());
+  for (const auto& text : texts) {
+    float offset_x = 0.0f;
+    glm::vec2 min_bound{0.0f};
+    glm::vec2 max_bound{0.0f};
+    for (const auto character : text) {
+      if (character == ' ') {
+        offset_x += char_loader.space_advance();
+        continue;
+      }
       const auto& texture_info = char_loader.char_texture_info(character);
-      total_advance_x += texture_info.advance_x;
-      highest_base_y = std::max(highest_base_y,
-                                texture_info.size.y - texture_info.bearing.y);
+      const glm::vec2 glyph_bottom_left{
+          offset_x + texture_info.bearing.x,
+          texture_info.bearing.y - texture_info.size.y};
+      min_bound = glm::min(min_bound, glyph_bottom_left);
+      max_bound = glm::max(max_bound, glyph_bottom_left + texture_info.size);
+      offset_x += texture_info.advance_x;
     }
+    max_bound.x = std::max(max_bound.x, offset_x);
+    advance_xs.push_back(offset_x);
+    bounds_bottom_lefts.push_back(min_bound);
+    text_sizes.push_back(glm::max(
+        glm::ivec2{glm::ceil((max_bound - min_bound) *
+                             static_cast<float>(font_height))},
+        glm::ivec2{1}));
+  }
+
+  const common::SinglePagePacking packing = common::PackIntoSinglePage(
+      text_sizes, kPaddingBetweenChars,
+      context->physical_device_limits().maxImageDimension2D);
+  const glm::vec2 tex_coord_ratio = 1.0f / glm::vec2{packing.page_size};
+  text_texture_infos_.reserve(texts.size());
+  for (int i = 0; i < texts.size(); ++i) {
+    text_texture_infos_.push_back(TextTextureInfo{
+        advance_xs[i],
+        bounds_bottom_lefts[i],
+        /*bounds_size=*/
+        glm::vec2{text_sizes[i]} / static_cast<float>(font_height),
+        /*tex_coord_bottom_left=*/
+        glm::vec2{packing.placements[i].offset} * tex_coord_ratio,
+        /*tex_coord_size=*/glm::vec2{text_sizes[i]} * tex_coord_ratio,
+    });
   }
 
-  // In the coordinate of character atlas image, the width of 'text' is
-  // 'total_advance_x' and the height is 1.0. Note that the character atlas
-  // image itself is also rescaled in the horizontal direction, hence we
-  // should also consider its aspect ratio. The height of text texture will be
-  // made 'font_height'.
-  const glm::vec2 ratio = 1.0f / glm::vec2{total_advance_x, 1.0f};
-  const VkExtent2D text_image_extent{
-      static_cast<uint32_t>((total_advance_x * char_loader.GetAspectRatio()) *
-                            (static_cast<float>(font_height) / 1.0f)),
-      static_cast<uint32_t>(font_height),
-  };
-  const float base_y = highest_base_y;
   const auto image_usages = {ImageUsage::GetRenderTargetUsage(0),
                              ImageUsage::GetSampledInFragmentShaderUsage()};
-  auto text_image = std::make_unique<OffscreenImage>(
-      context, text_image_extent, common::image::kBwImageChannel, image_usages,
-      GetTextSamplerConfig(), /*use_high_precision=*/false);
+  text_atlas_image_ = std::make_unique<OffscreenImage>(
+      context,
+      VkExtent2D{static_cast<uint32_t>(packing.page_size.x),
+                 static_cast<uint32_t>(packing.page_size.y)},
+      common::image::kBwImageChannel, image_usages, GetTextSamplerConfig(),
+      /*use_high_precision=*/false);
+  RenderTexts(context, texts, char_loader);
+}
 
+void TextLoader::RenderTexts(const SharedBasicContext& context,
+                             absl::Span<const std::string> texts,
+                             const CharLoader& char_loader) const {
+  // The viewport covers the full atlas image, hence positions on it are the
+  // same as texture coordinates. Glyphs are laid out as if each text were
+  // rendered to an image of its own, which is then mapped to its region, so
+  // that the bounds of the text in the coordinate of character glyphs match
+  // the region.
   std::vector<Vertex2D> vertices;
-  text::LoadCharsVertexData(text, char_loader, ratio, /*initial_offset_x=*/0.0f,
-                            base_y, &vertices);
-  vertex_buffer->CopyHostData(PerVertexBuffer::ShareIndicesDataInfo{
-      /*num_meshes=*/static_cast<int>(text.length()),
-      /*per_mesh_vertices=*/
-      {vertices, /*num_units_per_mesh=*/text::kNumVerticesPerRect},
-      /*shared_indices=*/
-      {PerVertexBuffer::VertexDataInfo{text::GetIndicesPerRect()}},
-  });
+  for (int i = 0; i < texts.size(); ++i) {
+    const TextTextureInfo& info = text_texture_infos_[i];
+    const glm::vec2 ratio = info.tex_coord_size / info.bounds_size;
+    const glm::vec2 origin =
+        info.tex_coord_bottom_left - info.bounds_bottom_left * ratio;
+    text::LoadCharsVertexData(texts[i], char_loader, ratio,
+                              /*initial_offset_x=*/origin.x,
+                              /*base_y=*/origin.y, &vertices);
+  }
+  const int num_rects =
+      static_cast<int>(vertices.size()) / text::kNumVerticesPerRect;
 
+  auto descriptor = std::make_unique<StaticDescriptor>(
+      context, CreateDescriptorInfos());
   descriptor->UpdateImageInfos(
       Image::GetDescriptorTypeForSampling(),
       /*image_info_map=*/{
           {kImageBindingPoint,
            {char_loader.atlas_image()->GetDescriptorInfoForSampling()}},
   });
-  const auto render_pass = BuildRenderPass(*text_image, render_pass_builder);
-  const auto pipeline = BuildPipeline(*text_image, **render_pass,
-                                      pipeline_builder);
+
+  // Vertex buffer can't be empty, even if all texts only contain spaces.
+  const std::vector<uint32_t> indices =
+      text::GetIndicesForRects(std::max(num_rects, 1));
+  vertices.resize(std::max(num_rects, 1) * text::kNumVerticesPerRect);
+  const StaticPerVertexBuffer vertex_buffer{
+      context,
+      PerVertexBuffer::NoShareIndicesDataInfo{
+          /*per_mesh_infos=*/{{
+              PerVertexBuffer::VertexDataInfo{indices},
+              PerVertexBuffer::VertexDataInfo{vertices},
+          }},
+      },
+      pipeline::GetVertexAttributes<Vertex2D>()};
+
+  auto render_pass_builder = CreateRenderPassBuilder(context);
+  const auto render_pass = BuildRenderPass(*text_atlas_image_,
+                                           render_pass_builder.get());
+
+  // Advance can be negative, and thus bounding boxes of characters may have
+  // overlap, hence we need to enable color blending. Distances are converted to
+  // coverage before blending.
+  auto pipeline_builder = CreatePipelineBuilder(
+      context, "Text loader", vertex_buffer, descriptor->layout(),
+      /*enable_color_blend=*/true,
+      GetCharFragShaderPath(char_loader.glyph_mode()));
+  const auto pipeline = BuildPipeline(*text_atlas_image_, **render_pass,
+                                      pipeline_builder.get());
 
   const std::vector<RenderPass::RenderOp> render_ops{
       [&](const VkCommandBuffer& command_buffer) {
+        if (num_rects == 0) {
+          return;
+        }
         pipeline->Bind(command_buffer);
         descriptor->Bind(command_buffer, pipeline->layout(),
                          pipeline->binding_point());
-        for (int i = 0; i < text.length(); ++i) {
-          vertex_buffer->Draw(command_buffer, kVertexBufferBindingPoint,
-                              /*mesh_index=*/i, /*instance_count=*/1);
-        }
+        vertex_buffer.Draw(command_buffer, kVertexBufferBindingPoint,
+                           /*mesh_index=*/0, /*instance_count=*/1);
       },
   };
 
@@ -415,19 +606,30 @@ TextLoader::TextTextureInfo TextLoader::CreateTextTexture(
       [&render_pass, &render_ops](const VkCommandBuffer& command_buffer) {
         render_pass->Run(command_buffer, /*framebuffer_index=*/0, render_ops);
       });
-
-  return TextTextureInfo{util::GetAspectRatio(text_image_extent), base_y,
-                         std::move(text_image)};
 }
 
 namespace text {
 
-const std::array<uint32_t, kNumIndicesPerRect>& GetIndicesPerRect() {
+const std::array<uint16_t, kNumIndicesPerRect>& GetIndicesPerRect() {
   static const auto* indices_per_rect =
-      new std::array<uint32_t, kNumIndicesPerRect>{0, 1, 2, 0, 2, 3};
+      new std::array<uint16_t, kNumIndicesPerRect>{0, 1, 2, 0, 2, 3};
   return *indices_per_rect;
 }
 
+std::vector<uint32_t> GetIndicesForRects(int num_rects) {
+  const auto& indices_per_rect = GetIndicesPerRect();
+  std::vector<uint32_t> indices;
+  indices.reserve(kNumIndicesPerRect * num_rects);
+  for (int rect = 0; rect < num_rects; ++rect) {
+    const auto base_vertex =
+        static_cast<uint32_t>(kNumVerticesPerRect * rect);
+    for (const auto index : indices_per_rect) {
+      indices.push_back(base_vertex + index);
+    }
+  }
+  return indices;
+}
+
 void AppendCharPosAndTexCoord(const glm::vec2& pos_bottom_left,
                               const glm::vec2& pos_increment,
                               const glm::vec2& tex_coord_bottom_left,
@@ -455,6 +657,18 @@ void AppendCharPosAndTexCoord(const glm::vec2& pos_bottom_left,
   });
 }
 
+void AppendTranslatedVertices(absl::Span<const Vertex2D> source,
+                              const glm::vec2& offset,
+                              std::vector<Vertex2D>* vertices) {
+  // Positions are normalized from range [0.0, 1.0] to [-1.0, 1.0].
+  const glm::vec2 normalized_offset = offset * 2.0f;
+  vertices->reserve(vertices->size() + source.size());
+  for (const auto& vertex : source) {
+    vertices->push_back(
+        Vertex2D{vertex.pos + normalized_offset, vertex.tex_coord});
+  }
+}
+
 float LoadCharsVertexData(const std::string& text,
                           const CharLoader& char_loader, const glm::vec2& ratio,
                           float initial_offset_x, float base_y,
@@ -467,18 +681,29 @@ float LoadCharsVertexData(const std::string& text,
       offset_x += char_loader.space_advance() * ratio.x;
       continue;
     }
-    const auto& texture_info = char_loader.char_texture_info(character);
-    const glm::vec2& size_in_tex = texture_info.size;
-    text::AppendCharPosAndTexCoord(
-        /*pos_bottom_left=*/
-        {offset_x + texture_info.bearing.x * ratio.x,
-         base_y + (texture_info.bearing.y - size_in_tex.y) * ratio.y},
-        /*pos_increment=*/size_in_tex * ratio,
-        /*tex_coord_bottom_left=*/
-        {texture_info.offset_x, 0.0f},
-        /*tex_coord_increment=*/size_in_tex,
-        vertices);
-    offset_x += texture_info.advance_x * ratio.x;
+    offset_x = AppendCharVertexData(char_loader.char_texture_info(character),
+                                    ratio, offset_x, base_y, vertices);
+  }
+  return offset_x;
+}
+
+float LoadCharsVertexData(absl::Span<const char32_t> codepoints,
+                          GlyphAtlas* glyph_atlas, const glm::vec2& ratio,
+                          float initial_offset_x, float base_y,
+                          std::vector<Vertex2D>* vertices) {
+  float offset_x = initial_offset_x;
+  vertices->reserve(
+      vertices->size() + text::kNumVerticesPerRect * codepoints.size());
+  for (const auto codepoint : codepoints) {
+    const CharLoader::CharTextureInfo texture_info =
+        glyph_atlas->GetCharTextureInfo(codepoint);
+    // Characters like space have no glyph to render.
+    if (texture_info.size.x == 0.0f || texture_info.size.y == 0.0f) {
+      offset_x += texture_info.advance_x * ratio.x;
+      continue;
+    }
+    offset_x = AppendCharVertexData(texture_info, ratio, offset_x, base_y,
+                                    vertices);
   }
   return offset_x;
 }
@@ -16,6 +16,7 @@
 
 #include "lighter/common/char_lib.h"
 #include "lighter/common/file.h"
+#include "lighter/common/glyph_cache.h"
 #include "lighter/common/util.h"
 #include "lighter/renderer/vulkan/wrapper/buffer.h"
 #include "lighter/renderer/vulkan/wrapper/basic_context.h"
@@ -33,24 +34,36 @@ namespace vulkan {
 
 // This class is used to render all characters that might be used later onto
 // a font atlas image, so that we can render those characters in any combination
-// with only one render call, binding only one texture. The user can query the
-// glyph information of each character from char_texture_info_map(). Note that
-// we don't render the space character onto the character atlas image. To query
-// the advance of space, the user should include at least one space in any of
-// 'texts', and call space_advance().
+// with only one render call, binding only one texture. Glyphs are packed onto
+// the atlas image with common::RectPacker, so that the atlas image stays within
+// the limit of image dimension even if many characters are loaded. The user can
+// query the glyph information of each character from char_texture_info_map().
+// Note that we don't render the space character onto the character atlas image.
+// To query the advance of space, the user should include at least one space in
+// any of 'texts', and call space_advance().
+// If glyphs are loaded as signed distance fields, the atlas image stores
+// distances instead of coverage, and should be sampled with shaders that
+// threshold distances, such as text/char_sdf.frag. Glyphs in such an atlas can
+// be rendered crisply at sizes much larger than 'font_height'.
 // For now we only support the horizontal layout.
 class CharLoader {
  public:
   // Fonts that are supported.
   enum class Font { kGeorgia, kOstrich };
 
-  // Contains the information about the glyph of a character on the
-  // 'char_atlas_image_'. All numbers are in range [0.0, 1.0].
+  using GlyphMode = common::CharLib::GlyphMode;
+
+  // Contains the information about the glyph of a character. 'size',
+  // 'bearing' and 'advance_x' are normalized by the height of the tallest
+  // glyph, so that they do not depend on how glyphs are laid out on
+  // 'char_atlas_image_'. 'tex_coord_bottom_left' and 'tex_coord_size' locate
+  // the glyph on 'char_atlas_image_', and are in range [0.0, 1.0].
   struct CharTextureInfo {
     glm::vec2 size;
     glm::vec2 bearing;
-    float offset_x;
     float advance_x;
+    glm::vec2 tex_coord_bottom_left;
+    glm::vec2 tex_coord_size;
   };
 
   // Maps each character to its texture information.
@@ -60,18 +73,15 @@ class CharLoader {
   // loader. Note that this does not mean the user can only use this to render
   // elements of 'texts'. The user may use any combination of these characters.
   CharLoader(const SharedBasicContext& context,
-             absl::Span<const std::string> texts, Font font, int font_height);
+             absl::Span<const std::string> texts, Font font, int font_height,
+             GlyphMode glyph_mode = GlyphMode::kBitmap);
 
   // This class is neither copyable nor movable.
   CharLoader(const CharLoader&) = delete;
   CharLoader& operator=(const CharLoader&) = delete;
 
-  // Returns the aspect ratio of the character atlas image.
-  float GetAspectRatio() const {
-    return util::GetAspectRatio(char_atlas_image_->extent());
-  }
-
   // Accessors.
+  GlyphMode glyph_mode() const { return glyph_mode_; }
   OffscreenImagePtr atlas_image() const { return char_atlas_image_.get(); }
   float space_advance() const {
     ASSERT_HAS_VALUE(space_advance_x_, "Space is not loaded");
@@ -91,25 +101,23 @@ class CharLoader {
   // Maps each character to its texture image.
   using CharImageMap = absl::flat_hash_map<char, std::unique_ptr<TextureImage>>;
 
-  // Computes the extent of 'char_atlas_image_'. The width will be the total
-  // width of characters (excluding space) in 'char_lib', and the height will be
-  // the same to that of the tallest character.
-  VkExtent2D GetCharAtlasImageExtent(const common::CharLib& char_lib,
-                                     int interval_between_chars) const;
+  // Packs glyphs of characters loaded in 'char_lib', excluding the space
+  // character, into an image whose width and height are not greater than
+  // 'max_dimension', and populates 'char_texture_info_map_'. Returns the extent
+  // of that image.
+  VkExtent2D PackCharAtlas(const common::CharLib& char_lib, int line_height,
+                           int max_dimension);
 
   // Returns the horizontal advance of space character. If space is not loaded
   // in 'char_lib', returns std::nullopt.
   std::optional<float> GetSpaceAdvanceX(const common::CharLib& char_lib,
-                                        const Image& target_image) const;
+                                        int line_height) const;
 
-  // Populates 'char_texture_map' and 'char_texture_info_map' with characters
-  // loaded in 'char_lib', excluding the space character.
-  void CreateCharTextures(
-      const SharedBasicContext& context,
-      const common::CharLib& char_lib,
-      int interval_between_chars, const Image& target_image,
-      CharImageMap* char_texture_map,
-      CharTextureInfoMap* char_texture_info_map) const;
+  // Populates 'char_image_map' with characters loaded in 'char_lib', excluding
+  // the space character.
+  void CreateCharTextures(const SharedBasicContext& context,
+                          const common::CharLib& char_lib,
+                          CharImageMap* char_image_map) const;
 
   // Creates a vertex buffer for rendering characters in 'char_merge_order',
   // which should not include the space character.
@@ -117,6 +125,9 @@ class CharLoader {
       const SharedBasicContext& context,
       const std::vector<char>& char_merge_order) const;
 
+  // Determines what is stored in 'char_atlas_image_'.
+  const GlyphMode glyph_mode_;
+
   // Character atlas image.
   std::unique_ptr<OffscreenImage> char_atlas_image_;
 
@@ -128,45 +139,137 @@ class CharLoader {
   CharTextureInfoMap char_texture_info_map_;
 };
 
-// This class is used to render each element of 'texts' onto one texture, so
-// that later we only need to bind one texture to render any element of 'texts'.
+// This class loads glyphs onto a font atlas image on demand, so that texts can
+// contain any characters supported by the font, without knowing them in
+// advance. It is backed by common::GlyphCache, whose pages are stacked
+// vertically on the atlas image, and the least recently used page is evicted
+// when all pages are full. Only regions of pages that have been modified are
+// copied to the device when Upload() is called.
+// Glyph information is normalized in the same way as CharLoader.
+class GlyphAtlas {
+ public:
+  using GlyphMode = CharLoader::GlyphMode;
+  using Config = common::GlyphCache::Config;
+
+  // Glyphs of 'texts_to_preload' are loaded when constructed. The height of the
+  // tallest one of them is used as the line height to normalize glyph
+  // information, same as CharLoader. If 'texts_to_preload' has no visible
+  // glyph, 'font_height' is used instead.
+  GlyphAtlas(const SharedBasicContext& context, int num_frames_in_flight,
+             absl::Span<const std::string> texts_to_preload,
+             CharLoader::Font font, int font_height, GlyphMode glyph_mode,
+             const Config& config);
+
+  // This class is neither copyable nor movable.
+  GlyphAtlas(const GlyphAtlas&) = delete;
+  GlyphAtlas& operator=(const GlyphAtlas&) = delete;
+
+  // Loads glyphs of all codepoints in 'codepoints' that are not cached yet.
+  void LoadGlyphs(absl::Span<const char32_t> codepoints) {
+    glyph_cache_.LoadGlyphs(codepoints);
+  }
+
+  // Returns the glyph information of 'codepoint', which will be loaded if not
+  // cached yet. 'size' is zero for characters that need not be rendered, such
+  // as space.
+  CharLoader::CharTextureInfo GetCharTextureInfo(char32_t codepoint);
+
+  // Returns the page that holds the glyph of 'codepoint', which will be loaded
+  // if not cached yet. Returns common::GlyphCache::kNoPage if the glyph need
+  // not be rendered.
+  int GetPage(char32_t codepoint) {
+    return glyph_cache_.GetGlyph(codepoint).page;
+  }
+
+  // Marks 'page' as used in the current frame, so that it will not be evicted
+  // while glyphs on it are rendered without calling GetCharTextureInfo().
+  void MarkPageUsed(int page) { glyph_cache_.MarkPageUsed(page); }
+
+  // Records commands that copy regions of the atlas image modified since the
+  // last call to the device. This must be called after all glyphs used in
+  // 'frame' are queried, and before commands that render 'frame' are recorded.
+  // 'command_buffer' must be submitted to the graphics queue, and must not be
+  // inside a render pass. The staging buffer used for 'frame' is released when
+  // this is called for 'frame' again, by which time the device must have
+  // finished executing commands previously recorded for it.
+  void Upload(const VkCommandBuffer& command_buffer, int frame);
+
+  // Should be called once per frame, so that the least recently used page can
+  // be determined.
+  void NextFrame() { glyph_cache_.NextFrame(); }
+
+  // Accessors.
+  GlyphMode glyph_mode() const { return glyph_cache_.glyph_mode(); }
+  int num_evictions() const { return glyph_cache_.num_evictions(); }
+  const TextureImage& atlas_image() const { return *atlas_image_; }
+
+ private:
+  // Loads and packs glyphs on the host.
+  common::GlyphCache glyph_cache_;
+
+  // Height of the tallest preloaded glyph, excluding padding, in pixels.
+  float line_height_;
+
+  // Character atlas image.
+  std::unique_ptr<TextureImage> atlas_image_;
+
+  // Staging buffers used by commands recorded by Upload(), indexed by frame.
+  std::vector<std::unique_ptr<ImageStagingBuffer>> staging_buffers_;
+};
+
+// This class is used to render all elements of 'texts' onto one atlas image, so
+// that later we only need to bind one texture to render any combination of
+// elements of 'texts'. Texts are packed onto the atlas image with
+// common::RectPacker.
 // For now we only support the horizontal layout.
 class TextLoader {
  public:
-  // Contains information required for rendering a text.
+  // Contains information required for rendering a text. Except for texture
+  // coordinates, values are in the coordinate of character glyphs, where the
+  // line height is 1.0 and the origin is where the text starts on the baseline.
+  // 'advance_x' is the total advance of the text, which should be used for
+  // alignment. 'bounds_bottom_left' and 'bounds_size' locate the region that
+  // covers all glyphs, which may extend beyond the advance and the line height.
+  // 'tex_coord_bottom_left' and 'tex_coord_size' locate that region on the
+  // atlas image, and are in range [0.0, 1.0].
   struct TextTextureInfo {
-    float aspect_ratio;
-    float base_y;
-    std::unique_ptr<OffscreenImage> image;
+    float advance_x;
+    glm::vec2 bounds_bottom_left;
+    glm::vec2 bounds_size;
+    glm::vec2 tex_coord_bottom_left;
+    glm::vec2 tex_coord_size;
   };
 
-  // The loader will be able to render any of 'texts'.
+  // The loader will be able to render any of 'texts'. 'glyph_mode' determines
+  // how the intermediate character atlas is generated. The text atlas image
+  // always stores coverage.
   TextLoader(const SharedBasicContext& context,
              absl::Span<const std::string> texts,
-             CharLoader::Font font, int font_height);
+             CharLoader::Font font, int font_height,
+             CharLoader::GlyphMode glyph_mode = CharLoader::GlyphMode::kBitmap);
 
   // This class is neither copyable nor movable.
   TextLoader(const TextLoader&) = delete;
   TextLoader& operator=(const TextLoader&) = delete;
 
   // Accessors.
+  const OffscreenImage& atlas_image() const { return *text_atlas_image_; }
   const TextTextureInfo& texture_info(int text_index) const {
     return text_texture_infos_.at(text_index);
   }
 
  private:
-  // Creates texture for 'text'.
-  TextTextureInfo CreateTextTexture(
-      const SharedBasicContext& context,
-      const std::string& text, int font_height,
-      const CharLoader& char_loader,
-      StaticDescriptor* descriptor,
-      RenderPassBuilder* render_pass_builder,
-      GraphicsPipelineBuilder* pipeline_builder,
-      DynamicPerVertexBuffer* vertex_buffer) const;
+  // Renders all 'texts' onto 'text_atlas_image_' with one draw call, where
+  // 'text_texture_infos_' must have been populated.
+  void RenderTexts(const SharedBasicContext& context,
+                   absl::Span<const std::string> texts,
+                   const CharLoader& char_loader) const;
 
   // Texture information of each element of 'texts' passed to the constructor.
   std::vector<TextTextureInfo> text_texture_infos_;
+
+  // Text atlas image.
+  std::unique_ptr<OffscreenImage> text_atlas_image_;
 };
 
 namespace text {
@@ -175,10 +278,15 @@ constexpr int kNumVerticesPerRect = 4;
 constexpr int kNumIndicesPerRect = 6;
 
 // Returns indices used for drawing a rectangle.
-const std::array<uint32_t, kNumIndicesPerRect>& GetIndicesPerRect();
+const std::array<uint16_t, kNumIndicesPerRect>& GetIndicesPerRect();
+
+// Returns indices used for drawing 'num_rects' rectangles whose vertices are
+// stored one after another, so that all of them can be drawn with one call.
+std::vector<uint32_t> GetIndicesForRects(int num_rects);
 
 // Returns the data size used for vertex buffer. Is is assumed that indices will
-// be shared and each vertex data is of type Vertex2D.
+// be shared and each vertex data is of type Vertex2D. Note that the size of
+// indices is a multiple of 4, hence no padding is needed before vertices.
 inline size_t GetVertexDataSize(int num_rects) {
   return sizeof(GetIndicesPerRect()[0]) * kNumIndicesPerRect +
          sizeof(common::Vertex2D) * kNumVerticesPerRect * num_rects;
@@ -192,6 +300,13 @@ void AppendCharPosAndTexCoord(const glm::vec2& pos_bottom_left,
                               const glm::vec2& tex_coord_increment,
                               std::vector<common::Vertex2D>* vertices);
 
+// Appends 'source' to the end of 'vertices', translating positions by 'offset'.
+// 'offset' is in the same space as positions passed to
+// AppendCharPosAndTexCoord(), and will be normalized internally.
+void AppendTranslatedVertices(absl::Span<const common::Vertex2D> source,
+                              const glm::vec2& offset,
+                              std::vector<common::Vertex2D>* vertices);
+
 // Appends the vertex data of characters in 'text' to the end of 'vertices',
 // and returns the right boundary of rendered text (i.e. final X offset).
 float LoadCharsVertexData(const std::string& text,
@@ -199,6 +314,13 @@ float LoadCharsVertexData(const std::string& text,
                           float initial_offset_x, float base_y,
                           std::vector<common::Vertex2D>* vertices);
 
+// Same as above, but characters are 'codepoints', whose glyphs are queried from
+// 'glyph_atlas'.
+float LoadCharsVertexData(absl::Span<const char32_t> codepoints,
+                          GlyphAtlas* glyph_atlas, const glm::vec2& ratio,
+                          float initial_offset_x, float base_y,
+                          std::vector<common::Vertex2D>* vertices);
+
 } /* namespace text */
 } /* namespace vulkan */
 } /* namespace renderer */
@@ -323,6 +323,12 @@ Device::Device(const BasicContext* context,
   VkPhysicalDeviceFeatures required_features{};
   required_features.samplerAnisotropy = VK_TRUE;
 
+  // Request support for block-compressed textures if available. This is
+  // optional, since we fall back to uncompressed textures otherwise.
+  VkPhysicalDeviceFeatures feature_support;
+  vkGetPhysicalDeviceFeatures(*context_->physical_device(), &feature_support);
+  required_features.textureCompressionBC = feature_support.textureCompressionBC;
+
   // Request support for negative-height viewport and pushing descriptors.
   std::vector<const char*> device_extensions{
       VK_KHR_MAINTENANCE1_EXTENSION_NAME,
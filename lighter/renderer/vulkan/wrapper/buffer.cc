@@ -7,16 +7,68 @@
 
 #include "lighter/renderer/vulkan/wrapper/buffer.h"
 
+#include <algorithm>
 #include <cstring>
+#include <iterator>
 
 #include "lighter/renderer/vulkan/wrapper/command.h"
 #include "third_party/absl/strings/str_format.h"
+#include "third_party/absl/types/span.h"
 
 namespace lighter {
 namespace renderer {
 namespace vulkan {
 namespace {
 
+// Offsets of indices and vertices of each mesh are aligned to this, which
+// satisfies the alignment requirements of both index types and all vertex
+// attribute formats we use.
+constexpr VkDeviceSize kMeshDataAlignment = 4;
+
+// Returns 'offset' rounded up to the next multiple of kMeshDataAlignment.
+VkDeviceSize AlignMeshDataOffset(VkDeviceSize offset) {
+  return (offset + kMeshDataAlignment - 1) / kMeshDataAlignment *
+         kMeshDataAlignment;
+}
+
+// Wraps 'attributes' of a single vertex stream.
+std::vector<std::vector<VertexBuffer::Attribute>> ToPerStreamAttributes(
+    std::vector<VertexBuffer::Attribute>&& attributes) {
+  std::vector<std::vector<VertexBuffer::Attribute>> per_stream_attributes;
+  per_stream_attributes.push_back(std::move(attributes));
+  return per_stream_attributes;
+}
+
+// Returns descriptions of 'attributes', whose locations start from
+// 'start_location'. The 'binding' field will not be set.
+std::vector<VkVertexInputAttributeDescription> CreateAttributeDescriptions(
+    absl::Span<const VertexBuffer::Attribute> attributes,
+    uint32_t start_location) {
+  std::vector<VkVertexInputAttributeDescription> descriptions;
+  descriptions.reserve(attributes.size());
+  for (const auto& attribute : attributes) {
+    descriptions.push_back(VkVertexInputAttributeDescription{
+        start_location++,
+        /*binding=*/0,  // To be updated.
+        attribute.format,
+        attribute.offset,
+    });
+  }
+  return descriptions;
+}
+
+// Returns the index type to use for 'indices'.
+VkIndexType GetIndexType(const PerVertexBuffer::VertexDataInfo& indices) {
+  switch (indices.unit_size) {
+    case sizeof(uint16_t):
+      return VK_INDEX_TYPE_UINT16;
+    case sizeof(uint32_t):
+      return VK_INDEX_TYPE_UINT32;
+    default:
+      FATAL(absl::StrFormat("Unsupported index size: %d", indices.unit_size));
+  }
+}
+
 // Creates a buffer of 'data_size' for 'buffer_usages'
 VkBuffer CreateBuffer(const BasicContext& context,
                       VkDeviceSize data_size,
@@ -116,17 +168,7 @@ void StagingBuffer::CopyToBuffer(const VkBuffer& target) const {
 
 std::vector<VkVertexInputAttributeDescription> VertexBuffer::GetAttributes(
     uint32_t start_location) const {
-  std::vector<VkVertexInputAttributeDescription> descriptions;
-  descriptions.reserve(attributes_.size());
-  for (const auto& attribute : attributes_) {
-    descriptions.push_back(VkVertexInputAttributeDescription{
-        start_location++,
-        /*binding=*/0,  // To be updated.
-        attribute.format,
-        attribute.offset,
-    });
-  }
-  return descriptions;
+  return CreateAttributeDescriptions(attributes_, start_location);
 }
 
 void VertexBuffer::DrawWithoutBuffer(
@@ -217,12 +259,14 @@ Buffer::CopyInfos PerVertexBuffer::ShareIndicesDataInfo::CreateCopyInfos(
   mesh_infos.reserve(num_meshes_);
 
   constexpr int kIndicesOffset = 0;
+  const VkIndexType index_type = GetIndexType(shared_indices_);
   const VkDeviceSize initial_vertices_offset =
-      kIndicesOffset + shared_indices_.size_per_mesh;
+      AlignMeshDataOffset(kIndicesOffset + shared_indices_.size_per_mesh);
   VkDeviceSize vertices_offset = initial_vertices_offset;
   for (int i = 0; i < num_meshes_; ++i) {
     mesh_infos.push_back(MeshDataInfosWithIndices::Info{
         static_cast<uint32_t>(shared_indices_.num_units_per_mesh),
+        index_type,
         kIndicesOffset,
         vertices_offset,
     });
@@ -248,8 +292,11 @@ Buffer::CopyInfos PerVertexBuffer::ShareIndicesDataInfo::CreateCopyInfos(
 
 Buffer::CopyInfos PerVertexBuffer::NoShareIndicesDataInfo::CreateCopyInfos(
     PerVertexBuffer* buffer) const {
-  // Vertex buffer layout (@ refers to the index of mesh):
-  // | indices@0 | vertices@0 | indices@1 | vertices@1 | ...
+  // Vertex buffer layout (@ refers to the index of mesh, # refers to the index
+  // of level of detail, $ refers to the index of vertex stream):
+  // | indices@0 | lod indices@0#1 | ... | vertices@0$0 | vertices@0$1 | ...
+  // | indices@1 | ...
+  // Each chunk starts at an offset aligned to kMeshDataAlignment.
   auto& mesh_infos = buffer->mutable_mesh_data_infos()
                            ->emplace<MeshDataInfosWithIndices>().infos;
   mesh_infos.reserve(per_mesh_infos_.size());
@@ -260,23 +307,68 @@ Buffer::CopyInfos PerVertexBuffer::NoShareIndicesDataInfo::CreateCopyInfos(
   for (const auto& mesh_info : per_mesh_infos_) {
     const size_t indices_data_size = mesh_info.indices.size_per_mesh;
     const size_t vertices_data_size = mesh_info.vertices.size_per_mesh;
-    const VkDeviceSize vertices_offset = indices_offset + indices_data_size;
-    mesh_infos.push_back(MeshDataInfosWithIndices::Info{
-        static_cast<uint32_t>(mesh_info.indices.num_units_per_mesh),
-        indices_offset,
-        vertices_offset,
-    });
+    const VkIndexType index_type = GetIndexType(mesh_info.indices);
     copy_infos.push_back(Buffer::CopyInfo{
         mesh_info.indices.data,
         indices_data_size,
         indices_offset,
     });
+
+    std::vector<MeshDataInfosWithIndices::LodInfo> lod_infos;
+    lod_infos.reserve(mesh_info.lod_indices.size());
+    VkDeviceSize lod_indices_offset =
+        AlignMeshDataOffset(indices_offset + indices_data_size);
+    for (const auto& lod_indices : mesh_info.lod_indices) {
+      ASSERT_TRUE(GetIndexType(lod_indices) == index_type,
+                  "Levels of detail must have the same index type as the mesh");
+      lod_infos.push_back(MeshDataInfosWithIndices::LodInfo{
+          static_cast<uint32_t>(lod_indices.num_units_per_mesh),
+          lod_indices_offset,
+      });
+      copy_infos.push_back(Buffer::CopyInfo{
+          lod_indices.data,
+          lod_indices.size_per_mesh,
+          lod_indices_offset,
+      });
+      lod_indices_offset =
+          AlignMeshDataOffset(lod_indices_offset + lod_indices.size_per_mesh);
+    }
+
+    const VkDeviceSize vertices_offset = lod_indices_offset;
     copy_infos.push_back(Buffer::CopyInfo{
         mesh_info.vertices.data,
         vertices_data_size,
         vertices_offset,
     });
-    indices_offset += indices_data_size + vertices_data_size;
+
+    std::vector<VkDeviceSize> extra_vertices_offsets;
+    extra_vertices_offsets.reserve(mesh_info.extra_vertex_streams.size());
+    VkDeviceSize next_offset =
+        AlignMeshDataOffset(vertices_offset + vertices_data_size);
+    for (const auto& stream : mesh_info.extra_vertex_streams) {
+      ASSERT_TRUE(
+          stream.num_units_per_mesh == mesh_info.vertices.num_units_per_mesh,
+          absl::StrFormat("Vertex streams have different number of vertices "
+                          "(%d vs %d)", stream.num_units_per_mesh,
+                          mesh_info.vertices.num_units_per_mesh));
+      extra_vertices_offsets.push_back(next_offset);
+      copy_infos.push_back(Buffer::CopyInfo{
+          stream.data,
+          stream.size_per_mesh,
+          next_offset,
+      });
+      next_offset = AlignMeshDataOffset(next_offset + stream.size_per_mesh);
+    }
+
+    mesh_infos.push_back(MeshDataInfosWithIndices::Info{
+        static_cast<uint32_t>(mesh_info.indices.num_units_per_mesh),
+        index_type,
+        indices_offset,
+        vertices_offset,
+        std::move(lod_infos),
+        std::move(extra_vertices_offsets),
+    });
+    indices_offset = next_offset;
   }
 
   return Buffer::CopyInfos{
@@ -285,9 +377,19 @@ Buffer::CopyInfos PerVertexBuffer::NoShareIndicesDataInfo::CreateCopyInfos(
   };
 }
 
+PerVertexBuffer::PerVertexBuffer(
+    SharedBasicContext context,
+    std::vector<std::vector<Attribute>>&& per_stream_attributes)
+    : VertexBuffer{std::move(context),
+                   std::move(per_stream_attributes.front())},
+      extra_stream_attributes_{
+          std::make_move_iterator(per_stream_attributes.begin() + 1),
+          std::make_move_iterator(per_stream_attributes.end())} {}
+
 void PerVertexBuffer::Draw(const VkCommandBuffer& command_buffer,
-                           uint32_t binding_point,
-                           int mesh_index, uint32_t instance_count) const {
+                           uint32_t binding_point, int mesh_index,
+                           uint32_t instance_count, int lod,
+                           bool bind_all_streams) const {
   if (const auto* mesh_on_indices =
           std::get_if<MeshDataInfosNoIndices>(&mesh_data_infos_);
       mesh_on_indices != nullptr) {
@@ -300,19 +402,59 @@ void PerVertexBuffer::Draw(const VkCommandBuffer& command_buffer,
                  std::get_if<MeshDataInfosWithIndices>(&mesh_data_infos_);
              mesh_with_indices != nullptr) {
     const auto& mesh_info = mesh_with_indices->infos[mesh_index];
-    vkCmdBindIndexBuffer(command_buffer, buffer(), mesh_info.indices_offset,
-                         VK_INDEX_TYPE_UINT32);
+    uint32_t indices_count = mesh_info.indices_count;
+    VkDeviceSize indices_offset = mesh_info.indices_offset;
+    lod = std::min(lod, static_cast<int>(mesh_info.lods.size()));
+    if (lod > 0) {
+      const auto& lod_info = mesh_info.lods[lod - 1];
+      indices_count = lod_info.indices_count;
+      indices_offset = lod_info.indices_offset;
+    }
+    vkCmdBindIndexBuffer(command_buffer, buffer(), indices_offset,
+                         mesh_info.index_type);
     vkCmdBindVertexBuffers(command_buffer, binding_point, /*bindingCount=*/1,
                            &buffer(), &mesh_info.vertices_offset);
-    vkCmdDrawIndexed(command_buffer, mesh_info.indices_count, instance_count,
+    if (bind_all_streams) {
+      for (int i = 0; i < mesh_info.extra_vertices_offsets.size(); ++i) {
+        vkCmdBindVertexBuffers(command_buffer, binding_point + i + 1,
+                               /*bindingCount=*/1, &buffer(),
+                               &mesh_info.extra_vertices_offsets[i]);
+      }
+    }
+    vkCmdDrawIndexed(command_buffer, indices_count, instance_count,
                      /*firstIndex=*/0, /*vertexOffset=*/0, /*firstInstance=*/0);
   }
 }
 
+std::vector<VkVertexInputAttributeDescription>
+PerVertexBuffer::GetStreamAttributes(int stream_index,
+                                     uint32_t start_location) const {
+  if (stream_index == 0) {
+    return GetAttributes(start_location);
+  }
+  return CreateAttributeDescriptions(
+      extra_stream_attributes_.at(stream_index - 1), start_location);
+}
+
+int PerVertexBuffer::GetNumLevelsOfDetail(int mesh_index) const {
+  if (const auto* mesh_with_indices =
+          std::get_if<MeshDataInfosWithIndices>(&mesh_data_infos_);
+      mesh_with_indices != nullptr) {
+    return mesh_with_indices->infos[mesh_index].lods.size() + 1;
+  }
+  return 1;
+}
+
 StaticPerVertexBuffer::StaticPerVertexBuffer(
     SharedBasicContext context, const BufferDataInfo& info,
     std::vector<Attribute>&& attributes)
-    : PerVertexBuffer{std::move(context), std::move(attributes)} {
+    : StaticPerVertexBuffer{std::move(context), info,
+                            ToPerStreamAttributes(std::move(attributes))} {}
+
+StaticPerVertexBuffer::StaticPerVertexBuffer(
+    SharedBasicContext context, const BufferDataInfo& info,
+    std::vector<std::vector<Attribute>>&& per_stream_attributes)
+    : PerVertexBuffer{std::move(context), std::move(per_stream_attributes)} {
   const CopyInfos copy_infos = info.CreateCopyInfos(this);
   CreateBufferAndMemory(copy_infos.total_size, /*is_dynamic=*/false,
                         info.has_index_data());
@@ -351,12 +493,13 @@ StaticPerInstanceBuffer::StaticPerInstanceBuffer(
 }
 
 void DynamicPerInstanceBuffer::CopyHostData(
-    const void* data, uint32_t num_instances) {
-  const uint32_t total_size = per_instance_data_size() * num_instances;
+    const void* data, uint32_t num_instances, uint32_t first_instance) {
+  const uint32_t offset = per_instance_data_size() * first_instance;
+  const uint32_t data_size = per_instance_data_size() * num_instances;
   const CopyInfos copy_infos{
-      total_size, /*copy_infos=*/{CopyInfo{data, total_size, /*offset=*/0}},
+      offset + data_size, /*copy_infos=*/{CopyInfo{data, data_size, offset}},
   };
-  Reserve(total_size);
+  Reserve(copy_infos.total_size);
   CopyHostToBuffer(*context_, /*map_offset=*/0, /*map_size=*/buffer_size(),
                    device_memory(), copy_infos.copy_infos);
 }
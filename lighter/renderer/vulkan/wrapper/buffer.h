@@ -216,7 +216,8 @@ class PerVertexBuffer : public VertexBuffer {
     VertexDataInfo(const Container& container, int num_units_per_mesh)
         : data{container.data()},
           num_units_per_mesh{num_units_per_mesh},
-          size_per_mesh{sizeof(container[0]) * num_units_per_mesh} {}
+          size_per_mesh{sizeof(container[0]) * num_units_per_mesh},
+          unit_size{sizeof(container[0])} {}
 
     // Assuming all the data in 'container' is used for one mesh.
     template <typename Container>
@@ -225,9 +226,22 @@ class PerVertexBuffer : public VertexBuffer {
               container,
               /*num_units_per_mesh=*/static_cast<int>(container.size())} {}
 
+    // Assuming all the data in the container held by 'variant' is used for one
+    // mesh. This is used for indices that may be stored in different types,
+    // such as common::Indices and common::IndicesView.
+    template <typename... Containers>
+    explicit VertexDataInfo(const std::variant<Containers...>& variant)
+        : VertexDataInfo{std::visit(
+              [](const auto& container) { return VertexDataInfo{container}; },
+              variant)} {}
+
     const void* data;
     int num_units_per_mesh;
     size_t size_per_mesh;
+
+    // Size of each unit. If this is used for index data, it determines the
+    // index type, which can be either uint16_t or uint32_t.
+    size_t unit_size;
   };
 
   // Interface of different forms of buffer data info.
@@ -283,10 +297,17 @@ class PerVertexBuffer : public VertexBuffer {
   // Each mesh may have different number of indices and vertices.
   class NoShareIndicesDataInfo : public BufferDataInfo {
    public:
-    // Holds data information for each mesh.
+    // Holds data information for each mesh. 'lod_indices' holds indices of
+    // coarser levels of detail, which share 'vertices' with the mesh. They must
+    // have the same index type as 'indices'. If vertex attributes are stored
+    // in multiple streams, 'vertices' is the first stream, and the rest are
+    // stored in 'extra_vertex_streams'. All streams must have the same number
+    // of vertices.
     struct PerMeshInfo {
       VertexDataInfo indices;
       VertexDataInfo vertices;
+      std::vector<VertexDataInfo> lod_indices = {};
+      std::vector<VertexDataInfo> extra_vertex_streams = {};
     };
 
     explicit NoShareIndicesDataInfo(std::vector<PerMeshInfo>&& per_mesh_infos)
@@ -305,14 +326,41 @@ class PerVertexBuffer : public VertexBuffer {
   PerVertexBuffer& operator=(const PerVertexBuffer&) = delete;
 
   // Renders one mesh with 'mesh_index' for 'instance_count' times.
+  // If the mesh has levels of detail, 'lod' selects which one to render, where
+  // 0 refers to the original mesh. It will be clamped to the coarsest level
+  // available, so meshes with different numbers of levels can be rendered with
+  // the same 'lod'.
+  // If vertex attributes are stored in multiple streams, they are bound to
+  // consecutive binding points starting from 'binding_point'. If
+  // 'bind_all_streams' is false, only the first stream will be bound, which is
+  // useful for pipelines that only read positions.
   // This should be called when 'command_buffer' is recording commands.
   void Draw(const VkCommandBuffer& command_buffer, uint32_t binding_point,
-            int mesh_index, uint32_t instance_count) const;
+            int mesh_index, uint32_t instance_count, int lod = 0,
+            bool bind_all_streams = true) const;
+
+  // Returns attributes of the vertex stream at 'stream_index'. Attributes of
+  // the first stream are the same as those returned by GetAttributes().
+  std::vector<VkVertexInputAttributeDescription>
+  GetStreamAttributes(int stream_index, uint32_t start_location) const;
+
+  // Returns the number of vertex streams of each mesh.
+  int num_vertex_streams() const {
+    return extra_stream_attributes_.size() + 1;
+  }
+  // Returns the number of levels of detail of the mesh with 'mesh_index',
+  // including the original mesh.
+  int GetNumLevelsOfDetail(int mesh_index) const;
 
  protected:
   // Inherits constructor.
   using VertexBuffer::VertexBuffer;
 
+  // Each element of 'per_stream_attributes' holds attributes of the vertex
+  // stream at the same index.
+  PerVertexBuffer(SharedBasicContext context,
+                  std::vector<std::vector<Attribute>>&& per_stream_attributes);
+
   // Holds the number of vertices in each mesh and the data size offset within
   // the vertex buffer.
   struct MeshDataInfosNoIndices {
@@ -324,12 +372,21 @@ class PerVertexBuffer : public VertexBuffer {
   };
 
   // Holds the number of indices in each mesh and the data size offset within
-  // the vertex buffer.
+  // the vertex buffer. Levels of detail use the same index type and vertices.
+  // 'vertices_offset' is the offset of the first vertex stream, and offsets of
+  // the rest are stored in 'extra_vertices_offsets'.
   struct MeshDataInfosWithIndices {
+    struct LodInfo {
+      uint32_t indices_count;
+      VkDeviceSize indices_offset;
+    };
     struct Info {
       uint32_t indices_count;
+      VkIndexType index_type;
       VkDeviceSize indices_offset;
       VkDeviceSize vertices_offset;
+      std::vector<LodInfo> lods = {};
+      std::vector<VkDeviceSize> extra_vertices_offsets = {};
     };
     std::vector<Info> infos;
   };
@@ -343,6 +400,10 @@ class PerVertexBuffer : public VertexBuffer {
  private:
   // Holds data information for all meshes stored in the vertex buffer.
   MeshDataInfos mesh_data_infos_;
+
+  // Attributes of vertex streams other than the first one, whose attributes
+  // are stored in 'attributes_'.
+  std::vector<std::vector<Attribute>> extra_stream_attributes_;
 };
 
 // This class creates a vertex buffer that stores static data, which will be
@@ -352,6 +413,13 @@ class StaticPerVertexBuffer : public PerVertexBuffer {
   StaticPerVertexBuffer(SharedBasicContext context, const BufferDataInfo& info,
                         std::vector<Attribute>&& attributes);
 
+  // Used when vertex attributes are stored in multiple streams. Each element
+  // of 'per_stream_attributes' holds attributes of the stream at the same
+  // index.
+  StaticPerVertexBuffer(
+      SharedBasicContext context, const BufferDataInfo& info,
+      std::vector<std::vector<Attribute>>&& per_stream_attributes);
+
   // This class is neither copyable nor movable.
   StaticPerVertexBuffer(const StaticPerVertexBuffer&) = delete;
   StaticPerVertexBuffer& operator=(const StaticPerVertexBuffer&) = delete;
@@ -455,14 +523,19 @@ class DynamicPerInstanceBuffer : public PerInstanceBuffer,
   DynamicPerInstanceBuffer(const DynamicPerInstanceBuffer&) = delete;
   DynamicPerInstanceBuffer& operator=(const DynamicPerInstanceBuffer&) = delete;
 
-  // Copies host data to device. If the device buffer allocated previously is
-  // not large enough to hold the new data, it will be recreated internally.
-  void CopyHostData(const void* data, uint32_t num_instances);
+  // Copies host data to device, starting from the instance at 'first_instance'.
+  // Other instances are not touched, so that the user can store data of
+  // different frames in disjoint ranges, and update the range of one frame
+  // while the device may be reading others. If the device buffer allocated
+  // previously is not large enough to hold the new data, it will be recreated
+  // internally, and data copied previously will be discarded.
+  void CopyHostData(const void* data, uint32_t num_instances,
+                    uint32_t first_instance = 0);
 
   // Convenience method to copy all elements of 'container' to the device.
   template <typename Container>
-  void CopyHostData(const Container& container) {
-    CopyHostData(container.data(), CONTAINER_SIZE(container));
+  void CopyHostData(const Container& container, uint32_t first_instance = 0) {
+    CopyHostData(container.data(), CONTAINER_SIZE(container), first_instance);
   }
 };
 
@@ -8,10 +8,14 @@
 #include "lighter/renderer/vulkan/wrapper/image.h"
 
 #include <algorithm>
+#include <memory>
+#include <optional>
 #include <vector>
 
 #include "lighter/renderer/vulkan/wrapper/command.h"
 #include "lighter/renderer/vulkan/wrapper/image_util.h"
+#include "third_party/absl/container/flat_hash_set.h"
+#include "third_party/absl/strings/str_cat.h"
 #include "third_party/absl/strings/str_format.h"
 
 namespace lighter {
@@ -133,6 +137,51 @@ VkSampleCountFlagBits GetMaxSampleCount(VkSampleCountFlags sample_counts) {
   FATAL("Multisampling is not supported by hardware");
 }
 
+// Returns the size of each block in bytes if 'format' is block-compressed.
+// Otherwise, returns std::nullopt.
+std::optional<int> GetCompressedBlockSize(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC4_SNORM_BLOCK:
+      return 8;
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+    case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+      return 16;
+    default:
+      return std::nullopt;
+  }
+}
+
+// Returns the image format of block-compressed 'format'.
+VkFormat GetCompressedImageFormat(common::block_compression::Format format) {
+  using common::block_compression::Format;
+  switch (format) {
+    case Format::kBc1:
+      return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case Format::kBc3:
+      return VK_FORMAT_BC3_UNORM_BLOCK;
+    case Format::kBc4:
+      return VK_FORMAT_BC4_UNORM_BLOCK;
+    case Format::kBc5:
+      return VK_FORMAT_BC5_UNORM_BLOCK;
+    case Format::kBc7:
+      return VK_FORMAT_BC7_UNORM_BLOCK;
+  }
+  FATAL("Unrecognized format");
+}
+
 // Creates a TextureBuffer::Info object, assuming all images have the same
 // properties as the given 'sample_image'. The size of 'image_datas' can only be
 // either 1 or 6 (for cubemaps)
@@ -150,6 +199,61 @@ TextureImage::Info CreateTextureBufferInfo(
   };
 }
 
+// Creates a TextureBuffer::Info object that contains all levels of
+// 'mip_chain'.
+TextureImage::Info CreateTextureBufferInfo(
+    const BasicContext& context,
+    const common::MipChain& mip_chain,
+    absl::Span<const ImageUsage> usages) {
+  return TextureImage::Info{
+      mip_chain.data_ptrs(),
+      FindColorImageFormat(context, mip_chain.channel(), usages),
+      static_cast<uint32_t>(mip_chain.width()),
+      static_cast<uint32_t>(mip_chain.height()),
+      static_cast<uint32_t>(mip_chain.channel()),
+      usages,
+      static_cast<uint32_t>(mip_chain.num_levels()),
+  };
+}
+
+// Creates a TextureBuffer::Info object that contains all levels of
+// 'compressed_image'.
+TextureImage::Info CreateTextureBufferInfo(
+    const common::CompressedImage& compressed_image,
+    absl::Span<const ImageUsage> usages) {
+  return TextureImage::Info{
+      compressed_image.data_ptrs(),
+      GetCompressedImageFormat(compressed_image.format()),
+      static_cast<uint32_t>(compressed_image.width()),
+      static_cast<uint32_t>(compressed_image.height()),
+      static_cast<uint32_t>(common::block_compression::GetNumChannels(
+          compressed_image.format())),
+      usages,
+      static_cast<uint32_t>(compressed_image.num_levels()),
+  };
+}
+
+// Creates a TextureBuffer::Info object that contains all levels of
+// 'container'.
+TextureImage::Info CreateTextureBufferInfo(
+    const BasicContext& context,
+    const common::TextureContainer& container,
+    absl::Span<const ImageUsage> usages) {
+  const auto bc_format =
+      common::TextureContainer::GetBlockCompressionFormat(container.format());
+  return TextureImage::Info{
+      container.data_ptrs(),
+      bc_format.has_value()
+          ? GetCompressedImageFormat(bc_format.value())
+          : FindColorImageFormat(context, container.channel(), usages),
+      static_cast<uint32_t>(container.width()),
+      static_cast<uint32_t>(container.height()),
+      static_cast<uint32_t>(container.channel()),
+      usages,
+      static_cast<uint32_t>(container.num_levels()),
+  };
+}
+
 // Creates an image that can be used by the graphics queue.
 VkImage CreateImage(const BasicContext& context,
                     const ImageConfig& config,
@@ -235,6 +339,33 @@ void WaitForImageMemoryBarrier(
       &barrier);
 }
 
+// Returns a barrier that transitions the layout of all 'mip_levels' and
+// 'layer_count' of 'image' without transferring the queue family ownership.
+VkImageMemoryBarrier CreateLayoutTransitionBarrier(
+    const VkImage& image, uint32_t mip_levels, uint32_t layer_count,
+    VkImageAspectFlags image_aspect, uint32_t queue_family_index,
+    const std::array<VkImageLayout, 2>& image_layouts,
+    const std::array<VkAccessFlags, 2>& access_flags) {
+  return VkImageMemoryBarrier{
+      VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      /*pNext=*/nullptr,
+      access_flags[0],
+      access_flags[1],
+      image_layouts[0],
+      image_layouts[1],
+      /*srcQueueFamilyIndex=*/queue_family_index,
+      /*dstQueueFamilyIndex=*/queue_family_index,
+      image,
+      VkImageSubresourceRange{
+          image_aspect,
+          /*baseMipLevel=*/0,
+          mip_levels,
+          /*baseArrayLayer=*/0,
+          layer_count,
+      },
+  };
+}
+
 // Transitions image layout using the transfer queue.
 void TransitionImageLayout(
     const SharedBasicContext& context,
@@ -246,154 +377,57 @@ void TransitionImageLayout(
   const auto& transfer_queue = context->queues().transfer_queue();
   const OneTimeCommand command{context, &transfer_queue};
   command.Run([&](const VkCommandBuffer& command_buffer) {
-    const VkImageMemoryBarrier barrier{
-        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        /*pNext=*/nullptr,
-        access_flags[0],
-        access_flags[1],
-        image_layouts[0],
-        image_layouts[1],
-        /*srcQueueFamilyIndex=*/transfer_queue.family_index,
-        /*dstQueueFamilyIndex=*/transfer_queue.family_index,
-        image,
-        VkImageSubresourceRange{
-            image_aspect,
-            /*baseMipLevel=*/0,
-            image_config.mip_levels,
-            /*baseArrayLayer=*/0,
-            image_config.layer_count,
-        },
-    };
+    const VkImageMemoryBarrier barrier = CreateLayoutTransitionBarrier(
+        image, image_config.mip_levels, image_config.layer_count,
+        image_aspect, transfer_queue.family_index, image_layouts,
+        access_flags);
     WaitForImageMemoryBarrier(barrier, command_buffer, pipeline_stages);
   });
 }
 
-// Converts 2D dimension to 3D offset, where the expanded dimension is set to 1.
-inline VkOffset3D ExtentToOffset(const VkExtent2D& extent) {
-  return VkOffset3D{
-      static_cast<int32_t>(extent.width),
-      static_cast<int32_t>(extent.height),
-      /*z=*/1,
-  };
-}
-
 // Expands one dimension for 'extent', where the expanded dimension is set to 1.
 inline VkExtent3D ExpandDimension(const VkExtent2D& extent) {
   return {extent.width, extent.height, /*depth=*/1};
 }
 
-// Returns extents of mipmaps. The original extent will not be included.
-std::vector<VkExtent2D> GenerateMipmapExtents(const VkExtent3D& image_extent) {
-  const int largest_dim = std::max(image_extent.width, image_extent.height);
-  const int mip_levels = std::floor(static_cast<float>(std::log2(largest_dim)));
-  std::vector<VkExtent2D> mipmap_extents(mip_levels);
-  VkExtent2D extent{image_extent.width, image_extent.height};
-  for (int level = 0; level < mip_levels; ++level) {
-    extent.width = extent.width > 1 ? extent.width / 2 : 1;
-    extent.height = extent.height > 1 ? extent.height / 2 : 1;
-    mipmap_extents[level] = extent;
-  }
-  return mipmap_extents;
-}
-
-// Generates mipmaps for 'image' using the transfer queue.
-void GenerateMipmaps(const SharedBasicContext& context,
-                     const VkImage& image, VkFormat image_format,
-                     const VkExtent3D& image_extent,
-                     const std::vector<VkExtent2D>& mipmap_extents) {
-  VkFormatProperties properties;
-  vkGetPhysicalDeviceFormatProperties(*context->physical_device(),
-                                      image_format, &properties);
-  ASSERT_TRUE(properties.optimalTilingFeatures &
-                  VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT,
-              "Image format does not support linear blitting");
-
-  const auto& transfer_queue = context->queues().transfer_queue();
-  const OneTimeCommand command{context, &transfer_queue};
-  command.Run([&](const VkCommandBuffer& command_buffer) {
-    VkImageMemoryBarrier barrier{
-        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        /*pNext=*/nullptr,
-        /*srcAccessMask=*/0,  // To be updated.
-        /*dstAccessMask=*/0,  // To be updated.
-        /*oldLayout=*/VK_IMAGE_LAYOUT_UNDEFINED,  // To be updated.
-        /*newLayout=*/VK_IMAGE_LAYOUT_UNDEFINED,  // To be updated.
-        /*srcQueueFamilyIndex=*/transfer_queue.family_index,
-        /*dstQueueFamilyIndex=*/transfer_queue.family_index,
-        image,
-        VkImageSubresourceRange{
-            VK_IMAGE_ASPECT_COLOR_BIT,
-            /*baseMipLevel=*/0,  // To be updated.
-            /*levelCount=*/1,
-            /*baseArrayLayer=*/0,
-            /*layerCount=*/1,
-        },
-    };
+// Returns the extent of 'level' of an image whose extent is 'width' x 'height'.
+inline VkExtent2D GetMipLevelExtent(uint32_t width, uint32_t height,
+                                    uint32_t level) {
+  return {std::max(width >> level, 1u), std::max(height >> level, 1u)};
+}
 
-    uint32_t dst_level = 1;
-    VkExtent2D prev_extent{image_extent.width, image_extent.height};
-    for (const auto& extent : mipmap_extents) {
-      const uint32_t src_level = dst_level - 1;
-
-      // Transition the layout of previous layer to TRANSFER_SRC_OPTIMAL.
-      barrier.subresourceRange.baseMipLevel = src_level;
-      barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-      barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-      barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-      WaitForImageMemoryBarrier(barrier, command_buffer,
-                                {VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                 VK_PIPELINE_STAGE_TRANSFER_BIT});
-
-      // Blit the previous level to next level after transitioning is done.
-      const VkImageBlit image_blit{
-          /*srcSubresource=*/VkImageSubresourceLayers{
-              VK_IMAGE_ASPECT_COLOR_BIT,
-              /*mipLevel=*/src_level,
-              /*baseArrayLayer=*/0,
-              /*layerCount=*/1,
-          },
-          /*srcOffsets=*/{
-              VkOffset3D{/*x=*/0, /*y=*/0, /*z=*/0},
-              ExtentToOffset(prev_extent),
-          },
-          /*dstSubresource=*/VkImageSubresourceLayers{
-              VK_IMAGE_ASPECT_COLOR_BIT,
-              /*mipLevel=*/dst_level,
-              /*baseArrayLayer=*/0,
-              /*layerCount=*/1,
-          },
-          /*dstOffsets=*/{
-              VkOffset3D{/*x=*/0, /*y=*/0, /*z=*/0},
-              ExtentToOffset(extent),
-          },
-      };
-
-      vkCmdBlitImage(command_buffer,
-                     /*srcImage=*/image,
-                     /*srcImageLayout=*/VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                     /*dstImage=*/image,
-                     /*dstImageLayout=*/VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                     /*regionCount=*/1, &image_blit, VK_FILTER_LINEAR);
-
-      ++dst_level;
-      prev_extent = extent;
-    }
+// Returns the size of data of each layer of the mip level with 'extent'
+// described by 'info'. Partial blocks at edges occupy full blocks.
+VkDeviceSize GetLayerDataSize(const TextureImage::Info& info,
+                              const VkExtent2D& extent) {
+  if (const auto block_size = GetCompressedBlockSize(info.format);
+      block_size.has_value()) {
+    constexpr uint32_t kBlockDim = common::block_compression::kBlockDim;
+    return static_cast<VkDeviceSize>((extent.width + kBlockDim - 1) /
+                                     kBlockDim) *
+           ((extent.height + kBlockDim - 1) / kBlockDim) * block_size.value();
+  }
+  return static_cast<VkDeviceSize>(extent.width) * extent.height *
+         info.channel;
+}
 
-    // Transition the layout of all levels to SHADER_READ_ONLY_OPTIMAL.
-    for (uint32_t level = 0; level < mipmap_extents.size() + 1; ++level) {
-      barrier.subresourceRange.baseMipLevel = level;
-      barrier.oldLayout = level == mipmap_extents.size()
-                              ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-                              : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-      barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-      barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-      WaitForImageMemoryBarrier(barrier, command_buffer,
-                                {VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                 VK_PIPELINE_STAGE_TRANSFER_BIT});
-    }
-  });
+// Returns offsets of data of each mip level described by 'info' in the staging
+// buffer, followed by the total data size. vkCmdCopyBufferToImage() requires
+// offsets to be multiples of 4 bytes, or of the block size for block-compressed
+// formats, hence we align them to 16 bytes.
+std::vector<VkDeviceSize> GetMipLevelOffsets(const TextureImage::Info& info) {
+  constexpr VkDeviceSize kOffsetAlignment = 16;
+  std::vector<VkDeviceSize> offsets(info.mip_levels + 1);
+  VkDeviceSize offset = 0;
+  for (uint32_t level = 0; level < info.mip_levels; ++level) {
+    offsets[level] = offset;
+    const VkExtent2D extent = GetMipLevelExtent(info.width, info.height, level);
+    offset += GetLayerDataSize(info, extent) * info.GetLayerCount();
+    offset = (offset + kOffsetAlignment - 1) / kOffsetAlignment *
+             kOffsetAlignment;
+  }
+  offsets.back() = offset;
+  return offsets;
 }
 
 // Creates an image view to specify the usage of image data.
@@ -482,58 +516,77 @@ VkSampler CreateSampler(const BasicContext& context,
 
 } /* namespace */
 
-void ImageStagingBuffer::CopyToImage(const VkImage& target,
-                                     const VkExtent3D& image_extent,
-                                     uint32_t image_layer_count) const {
+void ImageStagingBuffer::CopyToImage(
+    const VkImage& target, absl::Span<const VkBufferImageCopy> regions) const {
   const OneTimeCommand command{context_, &context_->queues().transfer_queue()};
   command.Run([&](const VkCommandBuffer& command_buffer) {
-    const VkBufferImageCopy region{
-        // First three parameters specify pixels layout in buffer.
-        // Setting all of them to 0 means pixels are tightly packed.
-        /*bufferOffset=*/0,
-        /*bufferRowLength=*/0,
-        /*bufferImageHeight=*/0,
-        VkImageSubresourceLayers{
-            VK_IMAGE_ASPECT_COLOR_BIT,
-            /*mipLevel=*/0,
-            /*baseArrayLayer=*/0,
-            image_layer_count,
-        },
-        VkOffset3D{/*x=*/0, /*y=*/0, /*z=*/0},
-        image_extent,
-    };
-    vkCmdCopyBufferToImage(command_buffer, buffer(), target,
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                           /*regionCount=*/1, &region);
+    RecordCopyToImage(command_buffer, target, regions);
   });
 }
 
+void ImageStagingBuffer::RecordCopyToImage(
+    const VkCommandBuffer& command_buffer, const VkImage& target,
+    absl::Span<const VkBufferImageCopy> regions) const {
+  vkCmdCopyBufferToImage(command_buffer, buffer(), target,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         CONTAINER_SIZE(regions), regions.data());
+}
+
 ImageSampler::ImageSampler(SharedBasicContext context,
                            int mip_levels, const Config& config)
     : context_{std::move(FATAL_IF_NULL(context))},
       sampler_{CreateSampler(*context_, mip_levels, config)} {}
 
 Buffer::CopyInfos TextureImage::Info::GetCopyInfos() const {
-  const VkDeviceSize single_image_data_size = width * height * channel;
-  const VkDeviceSize total_data_size = single_image_data_size * datas.size();
+  const std::vector<VkDeviceSize> level_offsets = GetMipLevelOffsets(*this);
+  const uint32_t layer_count = GetLayerCount();
   std::vector<Buffer::CopyInfo> copy_infos(datas.size());
-  for (int i = 0; i < copy_infos.size(); ++i) {
-    copy_infos[i] = {datas[i], single_image_data_size,
-                     /*offset=*/single_image_data_size * i};
+  for (uint32_t level = 0; level < mip_levels; ++level) {
+    const VkExtent2D extent = GetMipLevelExtent(width, height, level);
+    const VkDeviceSize layer_data_size = GetLayerDataSize(*this, extent);
+    for (uint32_t layer = 0; layer < layer_count; ++layer) {
+      const uint32_t index = level * layer_count + layer;
+      copy_infos[index] = {
+          datas[index], layer_data_size,
+          /*offset=*/level_offsets[level] + layer_data_size * layer};
+    }
+  }
+  return {level_offsets.back(), std::move(copy_infos)};
+}
+
+std::vector<VkBufferImageCopy> TextureImage::Info::GetCopyRegions() const {
+  const std::vector<VkDeviceSize> level_offsets = GetMipLevelOffsets(*this);
+  std::vector<VkBufferImageCopy> regions(mip_levels);
+  for (uint32_t level = 0; level < mip_levels; ++level) {
+    regions[level] = VkBufferImageCopy{
+        level_offsets[level],
+        // Setting these two parameters to 0 means pixels are tightly packed.
+        /*bufferRowLength=*/0,
+        /*bufferImageHeight=*/0,
+        VkImageSubresourceLayers{
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            /*mipLevel=*/level,
+            /*baseArrayLayer=*/0,
+            GetLayerCount(),
+        },
+        VkOffset3D{/*x=*/0, /*y=*/0, /*z=*/0},
+        ExpandDimension(GetMipLevelExtent(width, height, level)),
+    };
   }
-  return {total_data_size, std::move(copy_infos)};
+  return regions;
 }
 
 TextureImage::TextureImage(SharedBasicContext context,
                            bool generate_mipmaps,
                            const ImageSampler::Config& sampler_config,
-                           const Info& info)
+                           const Info& info,
+                           TextureUploadBatch* upload_batch)
     : Image{std::move(FATAL_IF_NULL(context)), info.GetExtent2D(), info.format},
-      buffer_{context_, generate_mipmaps, info},
+      buffer_{context_, generate_mipmaps, info, upload_batch},
       sampler_{context_, buffer_.mip_levels(), sampler_config} {
   set_image_view(CreateImageView(
       *context_, buffer_.image(), format_, VK_IMAGE_ASPECT_COLOR_BIT,
-      buffer_.mip_levels(), /*layer_count=*/CONTAINER_SIZE(info.datas)));
+      buffer_.mip_levels(), info.GetLayerCount()));
 }
 
 TextureImage::TextureImage(const SharedBasicContext& context,
@@ -545,25 +598,153 @@ TextureImage::TextureImage(const SharedBasicContext& context,
                    CreateTextureBufferInfo(*FATAL_IF_NULL(context), image,
                                            usages)} {}
 
+TextureImage::TextureImage(const SharedBasicContext& context,
+                           const common::MipChain& mip_chain,
+                           absl::Span<const ImageUsage> usages,
+                           const ImageSampler::Config& sampler_config,
+                           TextureUploadBatch* upload_batch)
+    : TextureImage{context, /*generate_mipmaps=*/false, sampler_config,
+                   CreateTextureBufferInfo(*FATAL_IF_NULL(context), mip_chain,
+                                           usages),
+                   upload_batch} {}
+
+TextureImage::TextureImage(const SharedBasicContext& context,
+                           const common::CompressedImage& compressed_image,
+                           absl::Span<const ImageUsage> usages,
+                           const ImageSampler::Config& sampler_config,
+                           TextureUploadBatch* upload_batch)
+    : TextureImage{context, /*generate_mipmaps=*/false, sampler_config,
+                   CreateTextureBufferInfo(compressed_image, usages),
+                   upload_batch} {}
+
+TextureImage::TextureImage(const SharedBasicContext& context,
+                           const common::TextureContainer& container,
+                           absl::Span<const ImageUsage> usages,
+                           const ImageSampler::Config& sampler_config,
+                           TextureUploadBatch* upload_batch)
+    : TextureImage{context, /*generate_mipmaps=*/false, sampler_config,
+                   CreateTextureBufferInfo(*FATAL_IF_NULL(context), container,
+                                           usages),
+                   upload_batch} {}
+
+bool TextureImage::SupportsCompressedFormat(
+    const BasicContext& context, common::block_compression::Format format) {
+  return FindImageFormatWithFeature(
+      context, {GetCompressedImageFormat(format)},
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+          VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT).has_value();
+}
+
+std::unique_ptr<ImageStagingBuffer> TextureImage::RecordUpdateRegions(
+    const VkCommandBuffer& command_buffer,
+    absl::Span<const Region> regions) const {
+  ASSERT_TRUE(buffer_.mip_levels() == kSingleMipLevel,
+              "Only images with one mip level can be updated");
+  if (regions.empty()) {
+    return nullptr;
+  }
+
+  // Data of each region starts at an offset that is a multiple of 4 bytes, as
+  // required by vkCmdCopyBufferToImage().
+  constexpr VkDeviceSize kOffsetAlignment = 4;
+  Buffer::CopyInfos copy_infos{/*total_size=*/0, /*copy_infos=*/{}};
+  std::vector<VkBufferImageCopy> copy_regions;
+  copy_infos.copy_infos.reserve(regions.size());
+  copy_regions.reserve(regions.size());
+  for (const auto& region : regions) {
+    const VkDeviceSize offset = copy_infos.total_size;
+    copy_infos.copy_infos.push_back(
+        {region.data.data(), region.data.size(), offset});
+    copy_regions.push_back(VkBufferImageCopy{
+        offset,
+        // Setting these two parameters to 0 means pixels are tightly packed.
+        /*bufferRowLength=*/0,
+        /*bufferImageHeight=*/0,
+        VkImageSubresourceLayers{
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            /*mipLevel=*/0,
+            /*baseArrayLayer=*/0,
+            kSingleImageLayer,
+        },
+        VkOffset3D{region.offset.x, region.offset.y, /*z=*/0},
+        ExpandDimension(region.extent),
+    });
+    copy_infos.total_size = (offset + region.data.size() +
+                             kOffsetAlignment - 1) /
+                            kOffsetAlignment * kOffsetAlignment;
+  }
+
+  // Transition from and back to the layout for sampling, so that pixels out of
+  // 'regions' are preserved. Commands are executed on the graphics queue in
+  // submission order, hence the first barrier also waits for frames submitted
+  // earlier that are still sampling the image.
+  auto staging_buffer =
+      std::make_unique<ImageStagingBuffer>(context_, copy_infos);
+  const uint32_t queue_family_index =
+      context_->queues().graphics_queue().family_index;
+  WaitForImageMemoryBarrier(
+      CreateLayoutTransitionBarrier(
+          image(), kSingleMipLevel, kSingleImageLayer,
+          VK_IMAGE_ASPECT_COLOR_BIT, queue_family_index,
+          {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL},
+          {VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT}),
+      command_buffer,
+      {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+       VK_PIPELINE_STAGE_TRANSFER_BIT});
+  staging_buffer->RecordCopyToImage(command_buffer, image(), copy_regions);
+  WaitForImageMemoryBarrier(
+      CreateLayoutTransitionBarrier(
+          image(), kSingleMipLevel, kSingleImageLayer,
+          VK_IMAGE_ASPECT_COLOR_BIT, queue_family_index,
+          {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+          {VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT}),
+      command_buffer,
+      {VK_PIPELINE_STAGE_TRANSFER_BIT,
+       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT});
+  return staging_buffer;
+}
+
 TextureImage::TextureBuffer::TextureBuffer(
-    SharedBasicContext context, bool generate_mipmaps, const Info& info)
+    SharedBasicContext context, bool generate_mipmaps, const Info& info,
+    TextureUploadBatch* upload_batch)
     : ImageBuffer{std::move(FATAL_IF_NULL(context))} {
   const VkExtent3D image_extent = info.GetExtent3D();
-  const auto layer_count = CONTAINER_SIZE(info.datas);
+  const auto layer_count = info.GetLayerCount();
   ASSERT_TRUE(layer_count == kSingleImageLayer ||
                   layer_count == kCubemapImageLayer,
               absl::StrFormat("Invalid number of images: %d", layer_count));
-
-  ImageConfig image_config;
-  image_config.layer_count = CONTAINER_SIZE(info.datas);
-
-  // Generate mipmap extents if requested.
-  std::vector<VkExtent2D> mipmap_extents;
+  ASSERT_TRUE(layer_count * info.mip_levels == info.datas.size(),
+              absl::StrFormat("Expecting data of %d mip levels, while %d "
+                              "pointers are provided",
+                              info.mip_levels, info.datas.size()));
+
+  // Generate mipmaps on the host if requested, so that all levels can be
+  // copied to the device at once.
+  std::unique_ptr<common::MipChain> mip_chain;
+  Info info_to_copy = info;
   if (generate_mipmaps) {
-    mipmap_extents = GenerateMipmapExtents(image_extent);
-    mip_levels_ = image_config.mip_levels = mipmap_extents.size() + 1;
+    ASSERT_TRUE(info.mip_levels == kSingleMipLevel,
+                "Mipmaps are already provided");
+    ASSERT_FALSE(GetCompressedBlockSize(info.format).has_value(),
+                 "Cannot generate mipmaps for block-compressed images");
+    common::MipChain::Options options;
+    options.is_srgb = info.is_srgb;
+    mip_chain = common::MipChain::Generate(
+        common::Image::Dimension{static_cast<int>(info.width),
+                                 static_cast<int>(info.height),
+                                 static_cast<int>(info.channel),
+                                 static_cast<int>(layer_count)},
+        info.datas, options);
+    info_to_copy.datas = mip_chain->data_ptrs();
+    info_to_copy.mip_levels = mip_chain->num_levels();
   }
 
+  ImageConfig image_config;
+  image_config.layer_count = layer_count;
+  mip_levels_ = image_config.mip_levels = info_to_copy.mip_levels;
+
   // Create image buffer.
   VkImageCreateFlags create_flags = nullflag;
   if (layer_count == kCubemapImageLayer) {
@@ -573,69 +754,291 @@ TextureImage::TextureBuffer::TextureBuffer(
   auto usage_flags = image::GetImageUsageFlags(info.usages);
   usage_flags |= VK_IMAGE_USAGE_SAMPLED_BIT;
   usage_flags |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-  if (generate_mipmaps) {
-    usage_flags |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-  }
 
   set_image(CreateImage(*context_, image_config, create_flags, info.format,
                         image_extent, usage_flags));
   set_device_memory(CreateImageMemory(
       *context_, image(), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
 
-  // Copy data from host to image buffer via staging buffer.
+  if (upload_batch != nullptr) {
+    upload_batch->Add(image(), info_to_copy, std::move(mip_chain));
+    return;
+  }
+
+  // Copy data of all levels from host to image buffer via staging buffer.
   TransitionImageLayout(
       context_, image(), image_config, VK_IMAGE_ASPECT_COLOR_BIT,
       {VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL},
       {kNullAccessFlag, VK_ACCESS_TRANSFER_WRITE_BIT},
       {VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT});
 
-  const ImageStagingBuffer staging_buffer{context_, info.GetCopyInfos()};
-  staging_buffer.CopyToImage(image(), image_extent, image_config.layer_count);
+  const ImageStagingBuffer staging_buffer{context_,
+                                          info_to_copy.GetCopyInfos()};
+  staging_buffer.CopyToImage(image(), info_to_copy.GetCopyRegions());
 
-  if (generate_mipmaps) {
-    GenerateMipmaps(context_, image(), info.format,
-                    image_extent, mipmap_extents);
-  } else {
-    TransitionImageLayout(
-        context_, image(), image_config, VK_IMAGE_ASPECT_COLOR_BIT,
-        {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
-        {VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT},
-        {VK_PIPELINE_STAGE_TRANSFER_BIT,
-         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT});
+  TransitionImageLayout(
+      context_, image(), image_config, VK_IMAGE_ASPECT_COLOR_BIT,
+      {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+      {VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT},
+      {VK_PIPELINE_STAGE_TRANSFER_BIT,
+       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT});
+}
+
+void TextureUploadBatch::Add(const VkImage& image,
+                             const TextureImage::Info& info,
+                             std::unique_ptr<common::MipChain>&& mip_chain) {
+  // Data of each texture starts at an offset that is a multiple of 16 bytes,
+  // since the total size returned by GetCopyInfos() is aligned.
+  Buffer::CopyInfos copy_infos = info.GetCopyInfos();
+  for (auto& copy_info : copy_infos.copy_infos) {
+    copy_info.offset += data_size_;
+    copy_infos_.push_back(copy_info);
+  }
+  std::vector<VkBufferImageCopy> regions = info.GetCopyRegions();
+  for (auto& region : regions) {
+    region.bufferOffset += data_size_;
+  }
+  data_size_ += copy_infos.total_size;
+  uploads_.push_back(Upload{image, info.mip_levels, info.GetLayerCount(),
+                            std::move(regions)});
+  if (mip_chain != nullptr) {
+    mip_chains_.push_back(std::move(mip_chain));
+  }
+}
+
+void TextureUploadBatch::Submit() {
+  if (uploads_.empty()) {
+    return;
   }
+
+  const ImageStagingBuffer staging_buffer{
+      context_, Buffer::CopyInfos{data_size_, std::move(copy_infos_)}};
+  const auto& transfer_queue = context_->queues().transfer_queue();
+  const OneTimeCommand command{context_, &transfer_queue};
+  command.Run([&](const VkCommandBuffer& command_buffer) {
+    for (const auto& upload : uploads_) {
+      WaitForImageMemoryBarrier(
+          CreateLayoutTransitionBarrier(
+              upload.image, upload.mip_levels, upload.layer_count,
+              VK_IMAGE_ASPECT_COLOR_BIT, transfer_queue.family_index,
+              {VK_IMAGE_LAYOUT_UNDEFINED,
+               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL},
+              {kNullAccessFlag, VK_ACCESS_TRANSFER_WRITE_BIT}),
+          command_buffer,
+          {VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT});
+      staging_buffer.RecordCopyToImage(command_buffer, upload.image,
+                                       upload.regions);
+      WaitForImageMemoryBarrier(
+          CreateLayoutTransitionBarrier(
+              upload.image, upload.mip_levels, upload.layer_count,
+              VK_IMAGE_ASPECT_COLOR_BIT, transfer_queue.family_index,
+              {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+              {VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT}),
+          command_buffer,
+          {VK_PIPELINE_STAGE_TRANSFER_BIT,
+           VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT});
+    }
+  });
+
+  data_size_ = 0;
+  copy_infos_.clear();
+  uploads_.clear();
+  mip_chains_.clear();
+}
+
+std::vector<SharedTexture> SharedTexture::LoadTextures(
+    const SharedBasicContext& context,
+    absl::Span<const SourcePath> source_paths,
+    absl::Span<const ImageUsage> usages,
+    const ImageSampler::Config& sampler_config,
+    bool is_srgb) {
+  FATAL_IF_NULL(context);
+  context->RegisterAutoReleasePool<SharedTexture::RefCountedTexture>("texture");
+
+  // Find textures that need to be loaded, skipping duplicates.
+  std::vector<int> indices_to_load;
+  absl::flat_hash_set<std::string> identifiers_to_load;
+  for (int i = 0; i < source_paths.size(); ++i) {
+    const std::string& identifier = GetIdentifier(source_paths[i]);
+    if (!RefCountedTexture::Contains(identifier) &&
+        identifiers_to_load.insert(identifier).second) {
+      indices_to_load.push_back(i);
+    }
+  }
+
+  const int num_textures_to_load = static_cast<int>(indices_to_load.size());
+  const bool use_compression = ShouldCompress(*context, usages);
+  std::vector<HostTexture> host_textures(num_textures_to_load);
+  common::util::ParallelForWithWorkers(
+      num_textures_to_load, common::util::GetNumHardwareThreads(),
+      [&](int index) {
+        host_textures[index] = LoadHostTexture(
+            source_paths[indices_to_load[index]], use_compression, is_srgb);
+      });
+
+  // Hold uploaded textures until all of them are referenced by the returned
+  // objects, so that they are not released in between. Data of all textures is
+  // copied to the device with one submission, after which host data can be
+  // released.
+  TextureUploadBatch upload_batch{context};
+  std::vector<RefCountedTexture> uploaded_textures;
+  uploaded_textures.reserve(num_textures_to_load);
+  for (int index = 0; index < num_textures_to_load; ++index) {
+    uploaded_textures.push_back(UploadTexture(
+        context, GetIdentifier(source_paths[indices_to_load[index]]),
+        host_textures[index], usages, sampler_config, &upload_batch));
+  }
+  upload_batch.Submit();
+  host_textures.clear();
+
+  std::vector<SharedTexture> textures;
+  textures.reserve(source_paths.size());
+  for (const auto& source_path : source_paths) {
+    textures.push_back(SharedTexture{
+        GetTexture(context, source_path, usages, sampler_config, is_srgb)});
+  }
+  return textures;
 }
 
 SharedTexture::RefCountedTexture SharedTexture::GetTexture(
     const SharedBasicContext& context,
     const SourcePath& source_path,
     absl::Span<const ImageUsage> usages,
-    const ImageSampler::Config& sampler_config) {
+    const ImageSampler::Config& sampler_config,
+    bool is_srgb) {
   FATAL_IF_NULL(context);
   context->RegisterAutoReleasePool<SharedTexture::RefCountedTexture>("texture");
 
-  bool generate_mipmaps;
-  const std::string* identifier;
-  std::unique_ptr<common::Image> image;
+  const std::string& identifier = GetIdentifier(source_path);
+  if (auto texture = RefCountedTexture::GetIfExists(identifier)) {
+    return std::move(texture).value();
+  }
+  const HostTexture host_texture =
+      LoadHostTexture(source_path, ShouldCompress(*context, usages), is_srgb);
+  return UploadTexture(context, identifier, host_texture, usages,
+                       sampler_config);
+}
 
+bool SharedTexture::is_resident() const {
+  if (const auto* streamed_texture =
+          std::get_if<std::shared_ptr<const StreamedTexture>>(&texture_);
+      streamed_texture != nullptr) {
+    return (*streamed_texture)->texture.has_value();
+  }
+  return true;
+}
+
+const TextureImage& SharedTexture::texture() const {
+  if (const auto* streamed_texture =
+          std::get_if<std::shared_ptr<const StreamedTexture>>(&texture_);
+      streamed_texture != nullptr) {
+    const StreamedTexture& state = **streamed_texture;
+    return state.texture.has_value() ? *state.texture.value()
+                                     : *state.placeholder;
+  }
+  return *std::get<RefCountedTexture>(texture_);
+}
+
+const std::string& SharedTexture::GetIdentifier(const SourcePath& source_path) {
+  if (const auto* single_tex_path = std::get_if<SingleTexPath>(&source_path);
+      single_tex_path != nullptr) {
+    return *single_tex_path;
+  } else if (const auto* cubemap_path = std::get_if<CubemapPath>(&source_path);
+             cubemap_path != nullptr) {
+    return cubemap_path->directory;
+  } else {
+    FATAL("Unrecognized variant type");
+  }
+}
+
+bool SharedTexture::ShouldCompress(const BasicContext& context,
+                                   absl::Span<const ImageUsage> usages) {
+  // Textures are block-compressed if the device supports formats used by
+  // common::CompressedImage by default. Block-compressed images can't be
+  // linearly accessed.
+  using common::block_compression::Format;
+  return !ImageUsage::IsLinearAccessed(usages) &&
+         TextureImage::SupportsCompressedFormat(context, Format::kBc4) &&
+         TextureImage::SupportsCompressedFormat(context, Format::kBc7);
+}
+
+SharedTexture::HostTexture SharedTexture::LoadHostTexture(
+    const SourcePath& source_path, bool use_compression, bool is_srgb) {
   if (const auto* single_tex_path = std::get_if<SingleTexPath>(&source_path);
       single_tex_path != nullptr) {
-    generate_mipmaps = true;
-    identifier = single_tex_path;
-    image = std::make_unique<common::Image>(*single_tex_path);
+    if (common::TextureContainer::IsTextureContainerPath(*single_tex_path)) {
+      return common::TextureContainer::LoadFromFile(*single_tex_path);
+    }
+    common::MipChain::Options mip_options;
+    mip_options.is_srgb = is_srgb;
+    if (use_compression) {
+      return common::CompressedImage::LoadImageFiles(
+          {*single_tex_path}, mip_options, common::CompressedImage::Options{});
+    }
+    return common::MipChain::LoadImageFiles({*single_tex_path}, mip_options);
   } else if (const auto* cubemap_path = std::get_if<CubemapPath>(&source_path);
              cubemap_path != nullptr) {
-    generate_mipmaps = false;
-    identifier = &cubemap_path->directory;
-    image = std::make_unique<common::Image>(cubemap_path->directory,
-                                            cubemap_path->files);
+    if (use_compression) {
+      std::vector<std::string> paths;
+      paths.reserve(cubemap_path->files.size());
+      for (const auto& file : cubemap_path->files) {
+        paths.push_back(absl::StrCat(cubemap_path->directory, "/", file));
+      }
+      return common::CompressedImage::LoadImageFiles(
+          paths, /*mip_options=*/std::nullopt,
+          common::CompressedImage::Options{});
+    }
+    return std::make_unique<common::Image>(cubemap_path->directory,
+                                           cubemap_path->files);
   } else {
     FATAL("Unrecognized variant type");
   }
+}
 
-  return RefCountedTexture::Get(
-      *identifier, context, generate_mipmaps, sampler_config,
-      CreateTextureBufferInfo(*context, *image, usages));
+SharedTexture::RefCountedTexture SharedTexture::UploadTexture(
+    const SharedBasicContext& context, const std::string& identifier,
+    const HostTexture& host_texture, absl::Span<const ImageUsage> usages,
+    const ImageSampler::Config& sampler_config,
+    TextureUploadBatch* upload_batch) {
+  if (const auto* container =
+          std::get_if<std::unique_ptr<common::TextureContainer>>(
+              &host_texture);
+      container != nullptr) {
+    const auto bc_format = common::TextureContainer::GetBlockCompressionFormat(
+        (*container)->format());
+    if (bc_format.has_value()) {
+      ASSERT_TRUE(
+          TextureImage::SupportsCompressedFormat(*context, bc_format.value()),
+          absl::StrFormat("Format of texture container '%s' is not supported "
+                          "by the device", identifier));
+      ASSERT_FALSE(ImageUsage::IsLinearAccessed(usages),
+                   "Block-compressed textures can't be linearly accessed");
+    }
+    return RefCountedTexture::Get(identifier, context, **container, usages,
+                                  sampler_config, upload_batch);
+  } else if (const auto* compressed_image =
+                 std::get_if<std::unique_ptr<common::CompressedImage>>(
+                     &host_texture);
+             compressed_image != nullptr) {
+    return RefCountedTexture::Get(identifier, context, **compressed_image,
+                                  usages, sampler_config, upload_batch);
+  } else if (const auto* mip_chain =
+                 std::get_if<std::unique_ptr<common::MipChain>>(
+                     &host_texture);
+             mip_chain != nullptr) {
+    return RefCountedTexture::Get(identifier, context, **mip_chain, usages,
+                                  sampler_config, upload_batch);
+  } else if (const auto* image =
+                 std::get_if<std::unique_ptr<common::Image>>(&host_texture);
+             image != nullptr) {
+    return RefCountedTexture::Get(
+        identifier, context, /*generate_mipmaps=*/false, sampler_config,
+        CreateTextureBufferInfo(*context, **image, usages), upload_batch);
+  } else {
+    FATAL("Unrecognized variant type");
+  }
 }
 
 OffscreenImage::OffscreenImage(SharedBasicContext context,
@@ -11,11 +11,17 @@
 #include <array>
 #include <memory>
 #include <optional>
+#include <string>
 #include <variant>
+#include <vector>
 
+#include "lighter/common/block_compression.h"
+#include "lighter/common/compressed_image.h"
 #include "lighter/common/file.h"
 #include "lighter/common/image.h"
+#include "lighter/common/mip_chain.h"
 #include "lighter/common/ref_count.h"
+#include "lighter/common/texture_container.h"
 #include "lighter/common/util.h"
 #include "lighter/renderer/ir/image_usage.h"
 #include "lighter/renderer/vulkan/wrapper/basic_context.h"
@@ -44,9 +50,17 @@ class ImageStagingBuffer : public StagingBuffer {
   ImageStagingBuffer& operator=(const ImageStagingBuffer&) = delete;
 
   // Copies image data from this buffer to the targeted image, assuming the
-  // layout of 'target' is TRANSFER_DST_OPTIMAL.
-  void CopyToImage(const VkImage& target, const VkExtent3D& image_extent,
-                   uint32_t image_layer_count) const;
+  // layout of 'target' is TRANSFER_DST_OPTIMAL. All 'regions' are copied with
+  // one command.
+  void CopyToImage(const VkImage& target,
+                   absl::Span<const VkBufferImageCopy> regions) const;
+
+  // Same as CopyToImage(), but only records the copy command, so that the user
+  // can submit copies to multiple images at once.
+  // This should be called when 'command_buffer' is recording commands.
+  void RecordCopyToImage(const VkCommandBuffer& command_buffer,
+                         const VkImage& target,
+                         absl::Span<const VkBufferImageCopy> regions) const;
 };
 
 // This is the base class of buffers storing images. The user should use it
@@ -195,35 +209,63 @@ class SamplableImage {
   }
 };
 
-// This class copies a texture image on the host to device via a staging buffer,
-// and generates mipmaps if requested.
+// Forward declarations.
+class TextureStreamer;
+class TextureUploadBatch;
+
+// This class copies a texture image on the host to device via a staging buffer.
+// If mipmaps are requested, they are generated on the host with
+// common::MipChain, so that all levels are copied with one staging transfer.
+// If 'upload_batch' is provided to the constructor, data is not copied until
+// TextureUploadBatch::Submit() is called, and the texture must not be used
+// before that.
 // If the image is loaded from a file, the user should not directly instantiate
 // this class, but use SharedTexture which avoids loading the same file twice.
 class TextureImage : public Image, public SamplableImage {
  public:
-  // Description of the image data. The size of 'datas' can only be either 1
-  // or 6 (for cubemaps), otherwise, the constructor will throw an exception.
+  // Description of the image data. 'datas' holds pointers to data of each
+  // layer of each mip level, ordered by level and then by layer. The number of
+  // layers can only be either 1 or 6 (for cubemaps), otherwise, the constructor
+  // will throw an exception. If 'format' is block-compressed, 'datas' should
+  // point to encoded blocks, and 'channel' is ignored.
   struct Info{
     // Returns the extent of image.
     VkExtent2D GetExtent2D() const { return {width, height}; }
     VkExtent3D GetExtent3D() const { return {width, height, /*depth=*/1}; }
 
+    // Returns the number of layers.
+    uint32_t GetLayerCount() const {
+      return static_cast<uint32_t>(datas.size()) / mip_levels;
+    }
+
     // Returns an instance of CopyInfos that can be used for copying image data
-    // from the host to device memory.
+    // from the host to device memory. Data of each level starts at an offset
+    // that is a multiple of 4, as required by vkCmdCopyBufferToImage().
     Buffer::CopyInfos GetCopyInfos() const;
 
+    // Returns regions for copying data laid out by GetCopyInfos() from a buffer
+    // to the image, one for each mip level.
+    std::vector<VkBufferImageCopy> GetCopyRegions() const;
+
     absl::Span<const void* const> datas;
     VkFormat format;
     uint32_t width;
     uint32_t height;
     uint32_t channel;
     absl::Span<const ImageUsage> usages;
+    uint32_t mip_levels = kSingleMipLevel;
+
+    // If true, color channels are treated as sRGB encoded when generating
+    // mipmaps. See common::MipChain::Options::is_srgb.
+    bool is_srgb = false;
   };
 
+  // If 'generate_mipmaps' is true, 'info' must contain only one mip level.
   TextureImage(SharedBasicContext context,
                bool generate_mipmaps,
                const ImageSampler::Config& sampler_config,
-               const Info& info);
+               const Info& info,
+               TextureUploadBatch* upload_batch = nullptr);
 
   TextureImage(const SharedBasicContext& context,
                bool generate_mipmaps,
@@ -231,10 +273,61 @@ class TextureImage : public Image, public SamplableImage {
                absl::Span<const ImageUsage> usages,
                const ImageSampler::Config& sampler_config);
 
+  // Copies all levels of 'mip_chain' to the device.
+  TextureImage(const SharedBasicContext& context,
+               const common::MipChain& mip_chain,
+               absl::Span<const ImageUsage> usages,
+               const ImageSampler::Config& sampler_config,
+               TextureUploadBatch* upload_batch = nullptr);
+
+  // Copies all levels of 'compressed_image' to the device without decoding.
+  // The user should check SupportsCompressedFormat() beforehand.
+  TextureImage(const SharedBasicContext& context,
+               const common::CompressedImage& compressed_image,
+               absl::Span<const ImageUsage> usages,
+               const ImageSampler::Config& sampler_config,
+               TextureUploadBatch* upload_batch = nullptr);
+
+  // Copies all levels of 'container' to the device. Since data pointers of
+  // 'container' point into the memory mapped file, data is only copied once to
+  // the staging buffer. If the format is block-compressed, the user should
+  // check SupportsCompressedFormat() beforehand.
+  TextureImage(const SharedBasicContext& context,
+               const common::TextureContainer& container,
+               absl::Span<const ImageUsage> usages,
+               const ImageSampler::Config& sampler_config,
+               TextureUploadBatch* upload_batch = nullptr);
+
+  // Returns true if images in block-compressed 'format' can be sampled with
+  // linear filtering on the device.
+  static bool SupportsCompressedFormat(
+      const BasicContext& context, common::block_compression::Format format);
+
   // This class is neither copyable nor movable.
   TextureImage(const TextureImage&) = delete;
   TextureImage& operator=(const TextureImage&) = delete;
 
+  // A rectangular region of the image, and host data to copy to it. 'data'
+  // holds tightly packed pixels of the region.
+  struct Region {
+    VkOffset2D offset;
+    VkExtent2D extent;
+    absl::Span<const uint8_t> data;
+  };
+
+  // Records commands that copy 'regions' from the host to the image, which
+  // must have only one mip level and one layer. Other pixels are preserved.
+  // All regions are copied through the returned staging buffer, which must be
+  // kept alive until the recorded commands finish executing. Returns nullptr if
+  // 'regions' is empty.
+  // Since the image is transitioned out of the layout for sampling and back,
+  // 'command_buffer' must be submitted to the graphics queue, and this must not
+  // be called inside a render pass. Recorded barriers wait for preceding reads
+  // in fragment shaders, and make new pixels visible to following ones.
+  std::unique_ptr<ImageStagingBuffer> RecordUpdateRegions(
+      const VkCommandBuffer& command_buffer,
+      absl::Span<const Region> regions) const;
+
   // Overrides.
   const VkImage& image() const override { return buffer_.image(); }
   VkDescriptorImageInfo GetDescriptorInfo(VkImageLayout layout) const override {
@@ -249,7 +342,8 @@ class TextureImage : public Image, public SamplableImage {
   class TextureBuffer : public ImageBuffer {
    public:
     TextureBuffer(SharedBasicContext context,
-                  bool generate_mipmaps, const Info& info);
+                  bool generate_mipmaps, const Info& info,
+                  TextureUploadBatch* upload_batch);
 
     // This class is neither copyable nor movable.
     TextureBuffer(const TextureBuffer&) = delete;
@@ -270,13 +364,77 @@ class TextureImage : public Image, public SamplableImage {
   const ImageSampler sampler_;
 };
 
+// This class collects copies of texture data from the host to the device, so
+// that multiple textures can be uploaded with one staging buffer and one
+// command submission, instead of waiting for the transfer queue to become idle
+// several times for each texture. Host data referenced by textures added to
+// the batch must outlive Submit().
+class TextureUploadBatch {
+ public:
+  explicit TextureUploadBatch(SharedBasicContext context)
+      : context_{std::move(FATAL_IF_NULL(context))} {}
+
+  // This class is neither copyable nor movable.
+  TextureUploadBatch(const TextureUploadBatch&) = delete;
+  TextureUploadBatch& operator=(const TextureUploadBatch&) = delete;
+
+  // Copies data of all textures added since the last call to the device,
+  // transitions their layouts for sampling, and waits for completion.
+  void Submit();
+
+  // Accessors.
+  bool empty() const { return uploads_.empty(); }
+  VkDeviceSize data_size() const { return data_size_; }
+
+ private:
+  friend class TextureImage;
+
+  // Describes copies to one image.
+  struct Upload {
+    VkImage image;
+    uint32_t mip_levels;
+    uint32_t layer_count;
+    std::vector<VkBufferImageCopy> regions;
+  };
+
+  // Adds copies of data described by 'info' to 'image'. If mipmaps are
+  // generated on the host, 'mip_chain' holds them, and it will be kept alive
+  // until Submit() is called.
+  void Add(const VkImage& image, const TextureImage::Info& info,
+           std::unique_ptr<common::MipChain>&& mip_chain);
+
+  // Pointer to context.
+  const SharedBasicContext context_;
+
+  // Total size of data to copy.
+  VkDeviceSize data_size_ = 0;
+
+  // Host data to copy to the staging buffer.
+  std::vector<Buffer::CopyInfo> copy_infos_;
+
+  // Copies to each image.
+  std::vector<Upload> uploads_;
+
+  // Mipmaps generated on the host.
+  std::vector<std::unique_ptr<common::MipChain>> mip_chains_;
+};
+
 // This class references to a texture image on the device, which is reference
 // counted. The texture image in the internal resource pool is identified by a
 // string. For single images, the file path will be used as identifier, while
 // for cubemaps, the directory will be used as identifier. The user may create
 // multiple instances of this class with the same path, and they will reference
 // to the same resource in the pool.
-// Mipmaps will be generated for single images, not for cubemaps.
+// Mipmaps will be generated for single images, not for cubemaps. They are
+// generated on the host and cached on disk by common::MipChain.
+// If the device supports block-compressed formats, textures are encoded with
+// common::CompressedImage, which is also cached on disk, and uploaded without
+// decoding. This reduces device memory usage and bandwidth by 4x.
+// Single image paths with common::TextureContainer::kFileExtension are loaded
+// as texture containers, which may hold either a single image or a cubemap,
+// and are uploaded as is.
+// Instances can also be obtained from TextureStreamer::Request(), which returns
+// immediately, and refers to a placeholder until the texture is resident.
 class SharedTexture : public SamplableImage {
  public:
   // The user should either provide one file path for a single image, or a
@@ -289,28 +447,94 @@ class SharedTexture : public SamplableImage {
   };
   using SourcePath = std::variant<SingleTexPath, CubemapPath>;
 
+  // If 'is_srgb' is true, color channels are treated as sRGB encoded when
+  // generating mipmaps. This should only be set for textures that hold colors.
+  // Since textures are identified by paths in the resource pool, the same file
+  // should always be requested with the same 'is_srgb'.
   SharedTexture(const SharedBasicContext& context,
                 const SourcePath& source_path,
                 absl::Span<const ImageUsage> usages,
-                const ImageSampler::Config& sampler_config)
-      : texture_{GetTexture(context, source_path, usages, sampler_config)} {}
+                const ImageSampler::Config& sampler_config,
+                bool is_srgb)
+      : texture_{GetTexture(context, source_path, usages, sampler_config,
+                            is_srgb)} {}
 
   // This class is only movable.
   SharedTexture(SharedTexture&&) noexcept = default;
   SharedTexture& operator=(SharedTexture&&) noexcept = default;
 
+  // Returns textures at 'source_paths' in the same order. Textures that are not
+  // in the resource pool yet are first loaded on the host concurrently by a
+  // pool of worker threads, which includes decoding, generating mipmaps,
+  // compressing and reading caches, and then uploaded to the device in one
+  // batch on the calling thread. This is faster than constructing textures one
+  // by one when loading many textures at once, such as all textures of a model.
+  static std::vector<SharedTexture> LoadTextures(
+      const SharedBasicContext& context,
+      absl::Span<const SourcePath> source_paths,
+      absl::Span<const ImageUsage> usages,
+      const ImageSampler::Config& sampler_config,
+      bool is_srgb);
+
+  // Returns false if this refers to a placeholder of a streamed texture.
+  bool is_resident() const;
+
   // Overrides.
   VkDescriptorImageInfo GetDescriptorInfo(VkImageLayout layout) const override {
-    return texture_->GetDescriptorInfo(layout);
+    return texture().GetDescriptorInfo(layout);
   }
 
   // Overloads.
-  const Image* operator->() const { return texture_.operator->(); }
+  const Image* operator->() const { return &texture(); }
 
  private:
+  friend class TextureStreamer;
+
   // Reference counted texture.
   using RefCountedTexture = common::RefCountedObject<TextureImage>;
 
+  // Texture that is being streamed by TextureStreamer. 'placeholder' is used
+  // until 'texture' is populated, which happens when the texture is resident.
+  struct StreamedTexture {
+    std::shared_ptr<const TextureImage> placeholder;
+    std::optional<RefCountedTexture> texture;
+  };
+
+  // Texture data loaded on the host, which is ready for uploading.
+  using HostTexture = std::variant<std::unique_ptr<common::TextureContainer>,
+                                   std::unique_ptr<common::CompressedImage>,
+                                   std::unique_ptr<common::MipChain>,
+                                   std::unique_ptr<common::Image>>;
+
+  explicit SharedTexture(RefCountedTexture&& texture)
+      : texture_{std::move(texture)} {}
+
+  explicit SharedTexture(std::shared_ptr<const StreamedTexture>&& texture)
+      : texture_{std::move(texture)} {}
+
+  // Returns the identifier of the texture at 'source_path' in the resource
+  // pool. For single images, the file path is used, while for cubemaps, the
+  // directory is used.
+  static const std::string& GetIdentifier(const SourcePath& source_path);
+
+  // Returns true if textures with 'usages' should be block-compressed.
+  static bool ShouldCompress(const BasicContext& context,
+                             absl::Span<const ImageUsage> usages);
+
+  // Loads the texture at 'source_path' on the host. This does not access the
+  // device, hence it can be called on any thread.
+  static HostTexture LoadHostTexture(const SourcePath& source_path,
+                                     bool use_compression, bool is_srgb);
+
+  // Uploads 'host_texture' to the device, and adds it to the resource pool with
+  // 'identifier'. If 'upload_batch' is not nullptr, data is not copied until it
+  // is submitted, and 'host_texture' must be kept alive until then.
+  static RefCountedTexture UploadTexture(
+      const SharedBasicContext& context, const std::string& identifier,
+      const HostTexture& host_texture, absl::Span<const ImageUsage> usages,
+      const ImageSampler::Config& sampler_config,
+      TextureUploadBatch* upload_batch = nullptr);
+
   // Returns a reference to a reference counted texture image. If this image has
   // no other holder, it will be loaded from the file. Otherwise, this returns
   // a reference to an existing resource on the device.
@@ -318,10 +542,15 @@ class SharedTexture : public SamplableImage {
       const SharedBasicContext& context,
       const SourcePath& source_path,
       absl::Span<const ImageUsage> usages,
-      const ImageSampler::Config& sampler_config);
+      const ImageSampler::Config& sampler_config,
+      bool is_srgb);
+
+  // Returns the texture image to sample from.
+  const TextureImage& texture() const;
 
-  // Reference counted texture image.
-  RefCountedTexture texture_;
+  // Reference counted texture image, or a texture being streamed.
+  std::variant<RefCountedTexture, std::shared_ptr<const StreamedTexture>>
+      texture_;
 };
 
 // This class creates an image that can be used for offscreen rendering and
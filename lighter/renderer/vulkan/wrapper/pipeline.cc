@@ -121,7 +121,8 @@ ShaderModule::ShaderModule(SharedBasicContext context,
     : context_{std::move(FATAL_IF_NULL(context))} {
   context_->RegisterAutoReleasePool<RefCountedShaderModule>("shader");
 
-  const auto raw_data = std::make_unique<common::RawData>(file_path);
+  const auto raw_data = std::make_unique<common::RawData>(
+      file_path, common::RawData::Mode::kMemoryMapped);
   const VkShaderModuleCreateInfo module_info{
       VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
       /*pNext=*/nullptr,
@@ -8,6 +8,7 @@
 #include "lighter/renderer/vulkan/wrapper/pipeline_util.h"
 
 #include <algorithm>
+#include <array>
 #include <iterator>
 
 #include "lighter/common/util.h"
@@ -21,21 +22,41 @@ namespace {
 
 // Returns the format to use for 'attribute'.
 VkFormat ChooseFormat(common::VertexAttribute attribute) {
-  ASSERT_TRUE(attribute.data_type == common::VertexAttribute::DataType::kFloat,
-              "Can only handle float");
-
-  switch (attribute.length) {
-    case 1:
-      return VK_FORMAT_R32_SFLOAT;
-    case 2:
-      return VK_FORMAT_R32G32_SFLOAT;
-    case 3:
-      return VK_FORMAT_R32G32B32_SFLOAT;
-    case 4:
-      return VK_FORMAT_R32G32B32A32_SFLOAT;
-    default:
-      FATAL(absl::StrFormat("Length must be in range [1, 4], while %d provided",
-                            attribute.length));
+  using DataType = common::VertexAttribute::DataType;
+  ASSERT_TRUE(attribute.length >= 1 && attribute.length <= 4,
+              absl::StrFormat("Length must be in range [1, 4], while %d "
+                              "provided", attribute.length));
+
+  // Formats are indexed by length - 1.
+  using Formats = std::array<VkFormat, 4>;
+  static constexpr Formats kFloatFormats{
+      VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT,
+      VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+  static constexpr Formats kHalfFloatFormats{
+      VK_FORMAT_R16_SFLOAT, VK_FORMAT_R16G16_SFLOAT,
+      VK_FORMAT_R16G16B16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT};
+  static constexpr Formats kSnorm8Formats{
+      VK_FORMAT_R8_SNORM, VK_FORMAT_R8G8_SNORM,
+      VK_FORMAT_R8G8B8_SNORM, VK_FORMAT_R8G8B8A8_SNORM};
+  static constexpr Formats kSnorm16Formats{
+      VK_FORMAT_R16_SNORM, VK_FORMAT_R16G16_SNORM,
+      VK_FORMAT_R16G16B16_SNORM, VK_FORMAT_R16G16B16A16_SNORM};
+  static constexpr Formats kUnorm16Formats{
+      VK_FORMAT_R16_UNORM, VK_FORMAT_R16G16_UNORM,
+      VK_FORMAT_R16G16B16_UNORM, VK_FORMAT_R16G16B16A16_UNORM};
+
+  const int index = attribute.length - 1;
+  switch (attribute.data_type) {
+    case DataType::kFloat:
+      return kFloatFormats[index];
+    case DataType::kHalfFloat:
+      return kHalfFloatFormats[index];
+    case DataType::kSnorm8:
+      return kSnorm8Formats[index];
+    case DataType::kSnorm16:
+      return kSnorm16Formats[index];
+    case DataType::kUnorm16:
+      return kUnorm16Formats[index];
   }
 }
 
@@ -0,0 +1,279 @@
+//
+//  texture_streamer.cc
+//
+//  Created by Pujun Lun on 6/28/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include "lighter/renderer/vulkan/wrapper/texture_streamer.h"
+
+#include <array>
+#include <iterator>
+#include <optional>
+#include <utility>
+#include <variant>
+
+#include "lighter/common/image.h"
+#include "lighter/common/util.h"
+
+namespace lighter {
+namespace renderer {
+namespace vulkan {
+namespace {
+
+// Color of placeholder textures, which is an opaque mid-gray.
+constexpr std::array<unsigned char, common::image::kRgbaImageChannel>
+    kPlaceholderColor{128, 128, 128, 255};
+
+// Returns a 1x1 texture filled with kPlaceholderColor, which has 'layer_count'
+// layers.
+std::shared_ptr<const TextureImage> CreatePlaceholder(
+    const SharedBasicContext& context, int layer_count) {
+  const std::vector<const void*> layer_datas(layer_count,
+                                             kPlaceholderColor.data());
+  const common::Image image{/*width=*/1, /*height=*/1,
+                            common::image::kRgbaImageChannel, layer_datas,
+                            /*flip_y=*/false};
+  const auto usages = {ImageUsage::GetSampledInFragmentShaderUsage()};
+  return std::make_shared<const TextureImage>(
+      context, /*generate_mipmaps=*/false, image, usages,
+      ImageSampler::Config{});
+}
+
+} /* namespace */
+
+TextureStreamer::TextureStreamer(SharedBasicContext context,
+                                 const Options& options)
+    : context_{std::move(FATAL_IF_NULL(context))},
+      max_upload_size_per_update_{options.max_upload_size_per_update},
+      single_image_placeholder_{
+          CreatePlaceholder(context_, common::image::kSingleImageLayer)},
+      cubemap_placeholder_{
+          CreatePlaceholder(context_, common::image::kCubemapImageLayer)} {
+  context_->RegisterAutoReleasePool<SharedTexture::RefCountedTexture>(
+      "texture");
+  const int num_workers = options.num_workers > 0
+                              ? options.num_workers
+                              : common::util::GetNumHardwareThreads();
+  workers_.reserve(num_workers);
+  for (int i = 0; i < num_workers; ++i) {
+    workers_.emplace_back([this]() { ServeRequests(); });
+  }
+}
+
+TextureStreamer::~TextureStreamer() {
+  {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    should_stop_ = true;
+  }
+  request_cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+SharedTexture TextureStreamer::Request(
+    const SharedTexture::SourcePath& source_path,
+    absl::Span<const ImageUsage> usages,
+    const ImageSampler::Config& sampler_config,
+    bool is_srgb, Priority priority) {
+  const std::string& identifier = SharedTexture::GetIdentifier(source_path);
+  if (auto texture =
+          SharedTexture::RefCountedTexture::GetIfExists(identifier)) {
+    return SharedTexture{std::move(texture).value()};
+  }
+
+  const std::lock_guard<std::mutex> lock{mutex_};
+  const auto iter = pending_requests_.find(identifier);
+  if (iter == pending_requests_.end()) {
+    auto texture = CreateStreamedTexture(source_path);
+    pending_requests_.insert({identifier, PendingRequest{
+        texture,
+        source_path,
+        std::vector<ImageUsage>(usages.begin(), usages.end()),
+        sampler_config,
+        SharedTexture::ShouldCompress(*context_, usages),
+        is_srgb,
+        priority,
+        /*is_loading=*/false,
+    }});
+    EnqueueRequest(identifier, priority);
+    return SharedTexture{std::move(texture)};
+  }
+
+  PendingRequest& request = iter->second;
+  if (!request.is_loading && priority > request.priority) {
+    request.priority = priority;
+    EnqueueRequest(identifier, priority);
+  }
+  auto texture = request.texture.lock();
+  if (texture == nullptr) {
+    // All textures returned for the previous request have been destructed.
+    texture = CreateStreamedTexture(source_path);
+    request.texture = texture;
+  }
+  return SharedTexture{std::move(texture)};
+}
+
+int TextureStreamer::Update() {
+  std::vector<LoadedTexture> loaded_textures;
+  {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    if (exception_ != nullptr) {
+      std::rethrow_exception(std::exchange(exception_, nullptr));
+    }
+    loaded_textures = std::move(loaded_textures_);
+    loaded_textures_.clear();
+  }
+  if (loaded_textures.empty()) {
+    return 0;
+  }
+
+  // Host data referenced by 'upload_batch' is held by 'loaded_textures' until
+  // the batch is submitted.
+  struct UploadedTexture {
+    std::shared_ptr<StreamedTexture> texture;
+    SharedTexture::RefCountedTexture uploaded;
+  };
+  TextureUploadBatch upload_batch{context_};
+  std::vector<UploadedTexture> uploaded_textures;
+  int num_processed = 0;
+  for (; num_processed < loaded_textures.size(); ++num_processed) {
+    if (upload_batch.data_size() >= max_upload_size_per_update_) {
+      break;
+    }
+
+    const LoadedTexture& loaded_texture = loaded_textures[num_processed];
+    PendingRequest request;
+    {
+      const std::lock_guard<std::mutex> lock{mutex_};
+      const auto iter = pending_requests_.find(loaded_texture.identifier);
+      request = std::move(iter->second);
+      pending_requests_.erase(iter);
+    }
+    auto texture = request.texture.lock();
+    if (texture == nullptr) {
+      continue;
+    }
+    uploaded_textures.push_back(UploadedTexture{
+        std::move(texture),
+        SharedTexture::UploadTexture(
+            context_, loaded_texture.identifier, loaded_texture.host_texture,
+            request.usages, request.sampler_config, &upload_batch),
+    });
+  }
+  upload_batch.Submit();
+
+  // Textures that exceed the size limit will be uploaded in the next call.
+  if (num_processed < loaded_textures.size()) {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    loaded_textures_.insert(
+        loaded_textures_.begin(),
+        std::make_move_iterator(loaded_textures.begin() + num_processed),
+        std::make_move_iterator(loaded_textures.end()));
+  }
+
+  for (auto& uploaded_texture : uploaded_textures) {
+    uploaded_texture.texture->texture.emplace(
+        std::move(uploaded_texture.uploaded));
+  }
+  if (!uploaded_textures.empty()) {
+    ++generation_;
+  }
+  return static_cast<int>(uploaded_textures.size());
+}
+
+void TextureStreamer::Flush() {
+  while (true) {
+    Update();
+    std::unique_lock<std::mutex> lock{mutex_};
+    if (pending_requests_.empty()) {
+      return;
+    }
+    loaded_cv_.wait(lock, [this]() {
+      return !loaded_textures_.empty() || exception_ != nullptr ||
+             pending_requests_.empty();
+    });
+  }
+}
+
+std::shared_ptr<TextureStreamer::StreamedTexture>
+TextureStreamer::CreateStreamedTexture(
+    const SharedTexture::SourcePath& source_path) const {
+  const bool is_cubemap =
+      std::holds_alternative<SharedTexture::CubemapPath>(source_path);
+  return std::make_shared<StreamedTexture>(StreamedTexture{
+      is_cubemap ? cubemap_placeholder_ : single_image_placeholder_,
+      /*texture=*/std::nullopt,
+  });
+}
+
+void TextureStreamer::EnqueueRequest(const std::string& identifier,
+                                     Priority priority) {
+  request_queue_.push(QueuedRequest{priority, next_sequence_++, identifier});
+  request_cv_.notify_one();
+}
+
+void TextureStreamer::ServeRequests() {
+  // Workers already load textures in parallel, hence mipmap generation and
+  // compression should not spawn more threads on each of them.
+  const common::util::ScopedSequentialExecution sequential_execution;
+  while (true) {
+    std::string identifier;
+    SharedTexture::SourcePath source_path;
+    bool use_compression;
+    bool is_srgb;
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      request_cv_.wait(lock, [this]() {
+        return should_stop_ || !request_queue_.empty();
+      });
+      if (should_stop_) {
+        return;
+      }
+
+      QueuedRequest queued_request = request_queue_.top();
+      request_queue_.pop();
+      const auto iter = pending_requests_.find(queued_request.identifier);
+      if (iter == pending_requests_.end() || iter->second.is_loading ||
+          iter->second.priority != queued_request.priority) {
+        // This is a stale element.
+        continue;
+      }
+      if (iter->second.texture.expired()) {
+        // Cancelled.
+        pending_requests_.erase(iter);
+        loaded_cv_.notify_all();
+        continue;
+      }
+      iter->second.is_loading = true;
+      identifier = std::move(queued_request.identifier);
+      source_path = iter->second.source_path;
+      use_compression = iter->second.use_compression;
+      is_srgb = iter->second.is_srgb;
+    }
+
+    try {
+      LoadedTexture loaded_texture{
+          identifier,
+          SharedTexture::LoadHostTexture(source_path, use_compression,
+                                         is_srgb),
+      };
+      const std::lock_guard<std::mutex> lock{mutex_};
+      loaded_textures_.push_back(std::move(loaded_texture));
+    } catch (...) {
+      // Drop the failed request, so that Flush() does not wait for it, and it
+      // can be requested again.
+      const std::lock_guard<std::mutex> lock{mutex_};
+      pending_requests_.erase(identifier);
+      if (exception_ == nullptr) {
+        exception_ = std::current_exception();
+      }
+    }
+    loaded_cv_.notify_all();
+  }
+}
+
+} /* namespace vulkan */
+} /* namespace renderer */
+} /* namespace lighter */
@@ -0,0 +1,194 @@
+//
+//  texture_streamer.h
+//
+//  Created by Pujun Lun on 6/28/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#ifndef LIGHTER_RENDERER_VULKAN_WRAPPER_TEXTURE_STREAMER_H
+#define LIGHTER_RENDERER_VULKAN_WRAPPER_TEXTURE_STREAMER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lighter/renderer/ir/image_usage.h"
+#include "lighter/renderer/vulkan/wrapper/basic_context.h"
+#include "lighter/renderer/vulkan/wrapper/image.h"
+#include "third_party/absl/container/flat_hash_map.h"
+#include "third_party/absl/types/span.h"
+#include "third_party/vulkan/vulkan.h"
+
+namespace lighter {
+namespace renderer {
+namespace vulkan {
+
+// This class loads textures from files and uploads them to the device
+// asynchronously, so that the program does not stall on texture loads.
+// Requests are kept in a priority queue, and served by a pool of worker threads
+// that read, decode and compress textures on the host. Textures loaded on the
+// host are uploaded in batches when Update() is called. Until a texture becomes
+// resident on the device, SharedTexture returned by Request() refers to a
+// placeholder texture that has the same view type (2D or cube), so that it can
+// be bound to descriptors right away.
+// Texture containers are assumed to hold single images until loaded.
+// Except for the internal worker threads, this class should only be accessed
+// on the thread that submits commands to the device.
+class TextureStreamer {
+ public:
+  // Requests with higher priority are served first. Requests with the same
+  // priority are served in the order they are made.
+  using Priority = int;
+
+  struct Options {
+    // Number of worker threads. If not positive, the number of hardware threads
+    // will be used.
+    int num_workers = 0;
+
+    // Each call of Update() stops adding textures to the upload batch once
+    // this many bytes are collected, so that one frame does not take too long.
+    // At least one texture will be uploaded in each call.
+    VkDeviceSize max_upload_size_per_update = 64 * 1024 * 1024;
+  };
+
+  explicit TextureStreamer(SharedBasicContext context,
+                           const Options& options = Options{});
+
+  // This class is neither copyable nor movable.
+  TextureStreamer(const TextureStreamer&) = delete;
+  TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+  // Stops worker threads. Requests that are not resident yet are discarded,
+  // and textures returned for them keep referring to placeholders.
+  ~TextureStreamer();
+
+  // Returns a texture at 'source_path' without waiting for it to be loaded. If
+  // the texture is already in the resource pool of SharedTexture, it is
+  // returned directly. Otherwise, the returned texture refers to a placeholder
+  // until the texture is uploaded by Update(). Requesting the same texture
+  // again before it is resident raises its priority if 'priority' is higher.
+  // If all textures returned for a request are destructed before the texture
+  // is resident, the request will be cancelled. 'is_srgb' has the same meaning
+  // as in the constructor of SharedTexture.
+  SharedTexture Request(const SharedTexture::SourcePath& source_path,
+                        absl::Span<const ImageUsage> usages,
+                        const ImageSampler::Config& sampler_config,
+                        bool is_srgb, Priority priority = 0);
+
+  // Uploads textures that have been loaded on the host, and returns the number
+  // of textures that become resident. Exceptions thrown when loading textures
+  // are rethrown here. Failed requests are dropped, hence textures returned
+  // for them keep referring to placeholders, and they may be requested again. This should be called once per frame, and must not be
+  // called while any command buffer that binds streamed textures is recording.
+  int Update();
+
+  // Blocks until all requested textures are resident.
+  void Flush();
+
+  // Accessors.
+  // Incremented whenever textures become resident. The user can compare it
+  // with a previous value to tell whether descriptors need to be updated.
+  uint64_t generation() const { return generation_; }
+
+ private:
+  using StreamedTexture = SharedTexture::StreamedTexture;
+
+  // A request that has not been uploaded yet.
+  struct PendingRequest {
+    std::weak_ptr<StreamedTexture> texture;
+    SharedTexture::SourcePath source_path;
+    std::vector<ImageUsage> usages;
+    ImageSampler::Config sampler_config;
+    bool use_compression;
+    bool is_srgb;
+    Priority priority;
+    bool is_loading;
+  };
+
+  // An element of 'request_queue_'. If the priority of a request is raised, a
+  // new element will be pushed, and the stale one will be skipped.
+  struct QueuedRequest {
+    // Returns true if 'rhs' should be served before this.
+    bool operator<(const QueuedRequest& rhs) const {
+      return priority != rhs.priority ? priority < rhs.priority
+                                      : sequence > rhs.sequence;
+    }
+
+    Priority priority;
+    uint64_t sequence;
+    std::string identifier;
+  };
+
+  // A texture that has been loaded on the host.
+  struct LoadedTexture {
+    std::string identifier;
+    SharedTexture::HostTexture host_texture;
+  };
+
+  // Returns a new streamed texture that refers to the placeholder appropriate
+  // for 'source_path'.
+  std::shared_ptr<StreamedTexture> CreateStreamedTexture(
+      const SharedTexture::SourcePath& source_path) const;
+
+  // Pushes the request of 'identifier' to 'request_queue_'. 'mutex_' must be
+  // held when calling this.
+  void EnqueueRequest(const std::string& identifier, Priority priority);
+
+  // Serves requests until 'should_stop_' is set. This runs on worker threads.
+  void ServeRequests();
+
+  // Pointer to context.
+  const SharedBasicContext context_;
+
+  // Maximum size of each upload batch.
+  const VkDeviceSize max_upload_size_per_update_;
+
+  // Placeholder textures.
+  std::shared_ptr<const TextureImage> single_image_placeholder_;
+  std::shared_ptr<const TextureImage> cubemap_placeholder_;
+
+  // Guards all members below except for 'generation_' and 'workers_'.
+  std::mutex mutex_;
+
+  // Notifies worker threads of new requests or stopping.
+  std::condition_variable request_cv_;
+
+  // Notifies Flush() of loaded textures or exceptions.
+  std::condition_variable loaded_cv_;
+
+  // Maps identifiers to requests that have not been uploaded yet.
+  absl::flat_hash_map<std::string, PendingRequest> pending_requests_;
+
+  // Requests waiting to be loaded on the host.
+  std::priority_queue<QueuedRequest> request_queue_;
+
+  // Used to order requests with the same priority.
+  uint64_t next_sequence_ = 0;
+
+  // Textures loaded on the host, waiting to be uploaded.
+  std::vector<LoadedTexture> loaded_textures_;
+
+  // Exception thrown by worker threads, which will be rethrown by Update().
+  std::exception_ptr exception_;
+
+  // Whether worker threads should stop.
+  bool should_stop_ = false;
+
+  // Incremented whenever textures become resident.
+  uint64_t generation_ = 0;
+
+  // Worker threads.
+  std::vector<std::thread> workers_;
+};
+
+} /* namespace vulkan */
+} /* namespace renderer */
+} /* namespace lighter */
+
+#endif /* LIGHTER_RENDERER_VULKAN_WRAPPER_TEXTURE_STREAMER_H */
@@ -4,20 +4,38 @@ layout(std140, binding = 0) uniform TransVert {
   mat4 view_model;
   mat4 proj_view_model;
   mat4 view_model_inv_trs;
+  // Restores quantized positions: pos = in_pos.xyz * pos_scale + pos_bias.
+  vec4 pos_scale;
+  vec4 pos_bias;
 } trans_vert;
 
-layout(location = 0) in vec3 in_pos;
-layout(location = 1) in vec3 in_norm;
+// Vertices are in the quantized format, where the position and the normal are
+// normalized from snorm16, and texture coordinates are converted from half.
+layout(location = 0) in vec4 in_pos;
+layout(location = 1) in vec2 in_norm;
 layout(location = 2) in vec2 in_tex_coord;
 
 layout(location = 0) out vec3 pos_view;
 layout(location = 1) out vec3 norm_view;
 layout(location = 2) out vec2 tex_coord;
 
+// Decodes the octahedral-encoded normal.
+vec3 DecodeNormal(vec2 encoded) {
+  vec3 norm = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+  if (norm.z < 0.0) {
+    norm.xy = (1.0 - abs(norm.yx)) * vec2(norm.x >= 0.0 ? 1.0 : -1.0,
+                                          norm.y >= 0.0 ? 1.0 : -1.0);
+  }
+  return normalize(norm);
+}
+
 void main() {
-  gl_Position = trans_vert.proj_view_model * vec4(in_pos, 1.0);
-  pos_view = (trans_vert.view_model * vec4(in_pos, 1.0)).xyz;
-  norm_view = (trans_vert.view_model_inv_trs * vec4(in_norm, 0.0)).xyz;
+  const vec4 pos = vec4(in_pos.xyz * trans_vert.pos_scale.xyz +
+                        trans_vert.pos_bias.xyz, 1.0);
+  gl_Position = trans_vert.proj_view_model * pos;
+  pos_view = (trans_vert.view_model * pos).xyz;
+  norm_view = (trans_vert.view_model_inv_trs *
+               vec4(DecodeNormal(in_norm), 0.0)).xyz;
   norm_view = normalize(norm_view);
   tex_coord = in_tex_coord;
 }
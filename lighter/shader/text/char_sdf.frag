@@ -0,0 +1,17 @@
+#version 460 core
+
+// Samples a signed distance field glyph atlas, and outputs the coverage.
+
+layout(binding = 0) uniform sampler2D tex_sampler;
+
+layout(location = 0) in vec2 tex_coord;
+
+layout(location = 0) out float frag_color;
+
+void main() {
+  // The outline is at 0.5. Smoothing over the distance change across one pixel
+  // keeps edges antialiased regardless of how much the glyph is scaled.
+  float dist = texture(tex_sampler, tex_coord).r;
+  float width = fwidth(dist);
+  frag_color = smoothstep(0.5 - width, 0.5 + width, dist);
+}
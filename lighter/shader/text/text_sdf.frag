@@ -0,0 +1,22 @@
+#version 460 core
+
+// Renders text with a signed distance field glyph atlas.
+
+layout(std140, binding = 0) uniform TextRenderInfo {
+  vec4 color_alpha;
+} text_render_info;
+
+layout(binding = 1) uniform sampler2D tex_sampler;
+
+layout(location = 0) in vec2 tex_coord;
+
+layout(location = 0) out vec4 frag_color;
+
+void main() {
+  // The outline is at 0.5. Smoothing over the distance change across one pixel
+  // keeps edges antialiased regardless of how much the glyph is scaled.
+  float dist = texture(tex_sampler, tex_coord).r;
+  float width = fwidth(dist);
+  frag_color = text_render_info.color_alpha *
+               smoothstep(0.5 - width, 0.5 + width, dist);
+}
@@ -174,7 +174,8 @@ FileHash CompilerRunner::CompileIfNeeded(
   }
 
   // Compile shader.
-  const common::RawData source_data{source_path.string()};
+  const common::RawData source_data{source_path.string(),
+                                    common::RawData::Mode::kMemoryMapped};
   const std::unique_ptr<CompilationResult> result = compiler_.Compile(
       /*shader_tag=*/source_path.filename().string(), shader_kind,
       source_data.GetSpan(), *options_array_[api_index]);
@@ -0,0 +1,159 @@
+//
+//  convert_texture.cc
+//
+//  Created by Pujun Lun on 6/25/21.
+//  Copyright © 2019 Pujun Lun. All rights reserved.
+//
+
+#include <exception>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "lighter/common/block_compression.h"
+#include "lighter/common/compressed_image.h"
+#include "lighter/common/image.h"
+#include "lighter/common/mip_chain.h"
+#include "lighter/common/texture_container.h"
+#include "lighter/common/util.h"
+#include "third_party/absl/flags/flag.h"
+#include "third_party/absl/flags/parse.h"
+#include "third_party/absl/strings/str_format.h"
+
+ABSL_FLAG(std::vector<std::string>, input, {},
+          "Comma separated paths to PNG/JPEG images. Either 1 path for a "
+          "single image, or 6 paths (PosX, NegX, PosY, NegY, PosZ, NegZ) for "
+          "a cubemap");
+ABSL_FLAG(std::string, output, "",
+          "Path to the output texture container, usually ending with '.ltex'");
+ABSL_FLAG(std::string, format, "auto",
+          "Texel format (auto/none/bc1/bc3/bc4/bc5/bc7). 'auto' uses BC4 for "
+          "single-channel images and BC7 for others, and 'none' keeps texels "
+          "uncompressed");
+ABSL_FLAG(std::string, quality, "high",
+          "Quality of block compression (fast/high)");
+ABSL_FLAG(bool, mipmaps, true, "Whether to generate the full mip chain");
+ABSL_FLAG(std::string, filter, "kaiser",
+          "Filter used for generating mipmaps (box/kaiser/lanczos)");
+ABSL_FLAG(bool, srgb, true,
+          "Whether color channels are sRGB encoded, in which case mipmaps are "
+          "filtered in linear space");
+
+namespace lighter::texture_converter {
+namespace {
+
+using common::CompressedImage;
+using common::MipChain;
+using common::TextureContainer;
+
+// Returns the compression options specified by 'format' and 'quality', or
+// std::nullopt if texels should not be compressed.
+std::optional<CompressedImage::Options> GetCompressionOptions(
+    const std::string& format, const std::string& quality) {
+  using common::block_compression::Format;
+  using common::block_compression::Quality;
+
+  CompressedImage::Options options;
+  if (quality == "fast") {
+    options.quality = Quality::kFast;
+  } else if (quality == "high") {
+    options.quality = Quality::kHigh;
+  } else {
+    FATAL("--quality must either be 'fast' or 'high'");
+  }
+
+  if (format == "none") {
+    return std::nullopt;
+  } else if (format == "auto") {
+    options.format = std::nullopt;
+  } else if (format == "bc1") {
+    options.format = Format::kBc1;
+  } else if (format == "bc3") {
+    options.format = Format::kBc3;
+  } else if (format == "bc4") {
+    options.format = Format::kBc4;
+  } else if (format == "bc5") {
+    options.format = Format::kBc5;
+  } else if (format == "bc7") {
+    options.format = Format::kBc7;
+  } else {
+    FATAL(absl::StrFormat("Unrecognized format: %s", format));
+  }
+  return options;
+}
+
+// Returns the filter specified by 'filter'.
+MipChain::Filter GetFilter(const std::string& filter) {
+  if (filter == "box") {
+    return MipChain::Filter::kBox;
+  } else if (filter == "kaiser") {
+    return MipChain::Filter::kKaiser;
+  } else if (filter == "lanczos") {
+    return MipChain::Filter::kLanczos;
+  }
+  FATAL("--filter must either be 'box', 'kaiser' or 'lanczos'");
+}
+
+// Loads images at 'paths', generates mipmaps and compresses texels if
+// requested, and returns the texture container that holds the result.
+std::unique_ptr<TextureContainer> ConvertTexture(
+    const std::vector<std::string>& paths,
+    const std::optional<MipChain::Options>& mip_options,
+    const std::optional<CompressedImage::Options>& compression_options) {
+  const common::Image image{paths};
+  std::unique_ptr<MipChain> mip_chain;
+  if (mip_options.has_value()) {
+    mip_chain = MipChain::Generate(image, mip_options.value());
+  }
+
+  if (!compression_options.has_value()) {
+    return mip_chain != nullptr ? TextureContainer::Create(*mip_chain)
+                                : TextureContainer::Create(image);
+  }
+  const auto compressed_image =
+      mip_chain != nullptr
+          ? CompressedImage::Encode(*mip_chain, compression_options.value())
+          : CompressedImage::Encode(image, compression_options.value());
+  return TextureContainer::Create(*compressed_image);
+}
+
+}  // namespace
+}  // namespace lighter::texture_converter
+
+int main(int argc, char* argv[]) {
+  using namespace lighter::texture_converter;
+
+  try {
+    absl::ParseCommandLine(argc, argv);
+
+    const std::vector<std::string> paths = absl::GetFlag(FLAGS_input);
+    ASSERT_TRUE(paths.size() == lighter::common::image::kSingleImageLayer ||
+                    paths.size() == lighter::common::image::kCubemapImageLayer,
+                "Please specify either 1 or 6 images with --input");
+    const std::string output = absl::GetFlag(FLAGS_output);
+    ASSERT_FALSE(output.empty(), "Please specify the output with --output");
+
+    std::optional<MipChain::Options> mip_options;
+    if (absl::GetFlag(FLAGS_mipmaps)) {
+      mip_options = MipChain::Options{GetFilter(absl::GetFlag(FLAGS_filter)),
+                                      absl::GetFlag(FLAGS_srgb)};
+    }
+    const auto compression_options = GetCompressionOptions(
+        absl::GetFlag(FLAGS_format), absl::GetFlag(FLAGS_quality));
+
+    const auto container = ConvertTexture(paths, mip_options,
+                                          compression_options);
+    ASSERT_TRUE(container->WriteToFile(output),
+                absl::StrFormat("Failed to write to '%s'", output));
+    LOG_INFO << absl::StreamFormat(
+        "Wrote %dx%d texture with %d layers and %d levels to '%s'",
+        container->width(), container->height(), container->layer(),
+        container->num_levels(), output);
+  } catch (const std::exception& e) {
+    LOG_INFO << e.what();
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
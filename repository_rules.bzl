@@ -76,6 +76,22 @@ def gtest_archive(sha256, strip_prefix, url):
         build_file_content = _CC_LIBRARY_ALL_SRCS.format("gtest_include"),
     )
 
+def benchmark_archive(sha256, strip_prefix, url):
+    http_archive(
+        name = "lib-benchmark",
+        sha256 = sha256,
+        strip_prefix = strip_prefix,
+        url = url,
+    )
+
+    http_archive(
+        name = "lib-benchmark-include",
+        sha256 = sha256,
+        strip_prefix = paths.join(strip_prefix, "include"),
+        url = url,
+        build_file_content = _CC_LIBRARY_ALL_SRCS.format("benchmark_include"),
+    )
+
 # TODO: rules_foreign_cc doesn't work on Windows yet.
 def external_windows_archive(name, strip_prefix, build_file):
     http_archive(